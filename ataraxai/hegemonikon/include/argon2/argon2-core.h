@@ -27,6 +27,8 @@ const uint32_t ARGON2_VERSION_NUMBER = 0x10;
 const uint32_t ARGON2_BLOCK_SIZE = 1024;
 const uint32_t ARGON2_WORDS_IN_BLOCK = ARGON2_BLOCK_SIZE / sizeof (uint64_t);
 const uint32_t ARGON2_QWORDS_IN_BLOCK = ARGON2_WORDS_IN_BLOCK / 2;
+const uint32_t ARGON2_HWORDS_IN_BLOCK = ARGON2_WORDS_IN_BLOCK / 4;
+const uint32_t ARGON2_512BIT_WORDS_IN_BLOCK = ARGON2_WORDS_IN_BLOCK / 8;
 
 /* Number of pseudo-random values generated by one call to Blake in Argon2i  to generate reference block positions*/
 const uint32_t ARGON2_ADDRESSES_IN_BLOCK = (ARGON2_BLOCK_SIZE * sizeof (uint8_t) / sizeof (uint64_t));
@@ -54,8 +56,9 @@ const uint32_t ARGON2_SBOX_MASK = ARGON2_SBOX_SIZE / 2 - 1;
 /*
  * Structure for the (1KB) memory block implemented as 128 64-bit words.
  * Memory blocks can be copied, XORed. Internal words can be accessed by [] (no bounds checking).
+ * Cache-line aligned so that the SIMD kernels can use aligned loads on the running state.
  */
-struct block {
+struct alignas(64) block {
     uint64_t v[ARGON2_WORDS_IN_BLOCK];
 
     block() { //default ctor
@@ -256,4 +259,70 @@ int Argon2Core(Argon2_Context* context, Argon2_type type);
  */
 void GenerateSbox(Argon2_instance_t* instance);
 
+
+/*************************Argon2 block compression kernels**************************************************/
+
+/* SIMD implementations of the block compression used by the optimized core */
+enum Argon2_kernel {
+    Argon2_kernel_sse2=0,
+    Argon2_kernel_avx2=1,
+    Argon2_kernel_avx512=2
+};
+
+/*
+ * Compresses the reference block into the running state, all kernels produce the same bytes
+ * @param state Pointer to the just produced block. Content will be updated(!)
+ * @param ref_block Pointer to the reference block (may alias @next_block)
+ * @param next_block Pointer to the block to be constructed
+ * @param Sbox Pointer to the Sbox (used in Argon2_ds only)
+ * @pre all block pointers must be valid
+ */
+typedef void (*FillBlockKernel)(block* state, const block* ref_block, block* next_block, const uint64_t* Sbox);
+
+void FillBlockSSE2(block* state, const block* ref_block, block* next_block, const uint64_t* Sbox);
+void FillBlockAVX2(block* state, const block* ref_block, block* next_block, const uint64_t* Sbox);
+void FillBlockAVX512(block* state, const block* ref_block, block* next_block, const uint64_t* Sbox);
+
+/*
+ * Tells if @kernel is built in and can run on this CPU (CPUID and OS register support)
+ * @param kernel Kernel to check
+ */
+bool Argon2KernelSupported(Argon2_kernel kernel);
+
+/*
+ * Kernel used by FillSegment(); the widest supported one unless overridden by Argon2SelectKernel()
+ */
+Argon2_kernel Argon2ActiveKernel();
+
+/*
+ * Forces the kernel used by the following derivations (tests and benchmarks)
+ * @param kernel Kernel to use
+ * @return false, and the active kernel is kept, if @kernel is not supported
+ */
+bool Argon2SelectKernel(Argon2_kernel kernel);
+
+/*
+ * Human readable name of @kernel, for logs
+ */
+const char* Argon2KernelName(Argon2_kernel kernel);
+
+/*
+ * S-box mixing of Argon2ds, shared by all kernels
+ * @param x First word of the block XORed with its last word
+ * @param Sbox Pointer to the Sbox
+ * @return Value added to the first and last words of the new block
+ */
+inline uint64_t SboxMix(uint64_t x, const uint64_t* Sbox) {
+    for (int i = 0; i < 6 * 16; ++i) {
+        uint32_t x1 = x >> 32;
+        uint32_t x2 = x & 0xFFFFFFFF;
+        uint64_t y = Sbox[x1 & ARGON2_SBOX_MASK];
+        uint64_t z = Sbox[(x2 & ARGON2_SBOX_MASK) + ARGON2_SBOX_SIZE / 2];
+        x = (uint64_t) x1 * (uint64_t) x2;
+        x += y;
+        x ^= z;
+    }
+    return x;
+}
+
 #endif
@@ -159,4 +159,273 @@ static BLAKE2_INLINE __m128i fBlaMka(__m128i x, __m128i y) {
         UNDIAGONALIZE(A0, B0, C0, D0, A1, B1, C1, D1);                         \
     } while ((void)0, 0)
 
+/*
+ * AVX2 rounds: a __m256i holds four 64-bit words, so one BLAKE2_ROUND_*_AVX2 covers two
+ * rows (_1) or two columns (_2) of the block. Only available in a unit built with AVX2.
+ */
+#if defined(__AVX2__)
+
+#define rotr32_avx2(x) _mm256_shuffle_epi32((x), _MM_SHUFFLE(2, 3, 0, 1))
+#define rotr24_avx2(x)                                                         \
+    _mm256_shuffle_epi8((x), _mm256_setr_epi8(3, 4, 5, 6, 7, 0, 1, 2, 11, 12,  \
+                                              13, 14, 15, 8, 9, 10, 3, 4, 5,   \
+                                              6, 7, 0, 1, 2, 11, 12, 13, 14,   \
+                                              15, 8, 9, 10))
+#define rotr16_avx2(x)                                                         \
+    _mm256_shuffle_epi8((x), _mm256_setr_epi8(2, 3, 4, 5, 6, 7, 0, 1, 10, 11,  \
+                                              12, 13, 14, 15, 8, 9, 2, 3, 4,   \
+                                              5, 6, 7, 0, 1, 10, 11, 12, 13,   \
+                                              14, 15, 8, 9))
+#define rotr63_avx2(x)                                                         \
+    _mm256_xor_si256(_mm256_srli_epi64((x), 63), _mm256_add_epi64((x), (x)))
+
+static BLAKE2_INLINE __m256i fBlaMka_avx2(__m256i x, __m256i y) {
+    const __m256i z = _mm256_mul_epu32(x, y);
+    return _mm256_add_epi64(_mm256_add_epi64(x, y), _mm256_add_epi64(z, z));
+}
+
+#define G1_AVX2(A0, A1, B0, B1, C0, C1, D0, D1)                                \
+    do {                                                                       \
+        A0 = fBlaMka_avx2(A0, B0);                                             \
+        A1 = fBlaMka_avx2(A1, B1);                                             \
+                                                                               \
+        D0 = rotr32_avx2(_mm256_xor_si256(D0, A0));                            \
+        D1 = rotr32_avx2(_mm256_xor_si256(D1, A1));                            \
+                                                                               \
+        C0 = fBlaMka_avx2(C0, D0);                                             \
+        C1 = fBlaMka_avx2(C1, D1);                                             \
+                                                                               \
+        B0 = rotr24_avx2(_mm256_xor_si256(B0, C0));                            \
+        B1 = rotr24_avx2(_mm256_xor_si256(B1, C1));                            \
+    } while ((void)0, 0)
+
+#define G2_AVX2(A0, A1, B0, B1, C0, C1, D0, D1)                                \
+    do {                                                                       \
+        A0 = fBlaMka_avx2(A0, B0);                                             \
+        A1 = fBlaMka_avx2(A1, B1);                                             \
+                                                                               \
+        D0 = rotr16_avx2(_mm256_xor_si256(D0, A0));                            \
+        D1 = rotr16_avx2(_mm256_xor_si256(D1, A1));                            \
+                                                                               \
+        C0 = fBlaMka_avx2(C0, D0);                                             \
+        C1 = fBlaMka_avx2(C1, D1);                                             \
+                                                                               \
+        B0 = rotr63_avx2(_mm256_xor_si256(B0, C0));                            \
+        B1 = rotr63_avx2(_mm256_xor_si256(B1, C1));                            \
+    } while ((void)0, 0)
+
+#define DIAGONALIZE_1_AVX2(A0, B0, C0, D0, A1, B1, C1, D1)                     \
+    do {                                                                       \
+        B0 = _mm256_permute4x64_epi64(B0, _MM_SHUFFLE(0, 3, 2, 1));            \
+        C0 = _mm256_permute4x64_epi64(C0, _MM_SHUFFLE(1, 0, 3, 2));            \
+        D0 = _mm256_permute4x64_epi64(D0, _MM_SHUFFLE(2, 1, 0, 3));            \
+                                                                               \
+        B1 = _mm256_permute4x64_epi64(B1, _MM_SHUFFLE(0, 3, 2, 1));            \
+        C1 = _mm256_permute4x64_epi64(C1, _MM_SHUFFLE(1, 0, 3, 2));            \
+        D1 = _mm256_permute4x64_epi64(D1, _MM_SHUFFLE(2, 1, 0, 3));            \
+    } while ((void)0, 0)
+
+#define UNDIAGONALIZE_1_AVX2(A0, B0, C0, D0, A1, B1, C1, D1)                   \
+    do {                                                                       \
+        B0 = _mm256_permute4x64_epi64(B0, _MM_SHUFFLE(2, 1, 0, 3));            \
+        C0 = _mm256_permute4x64_epi64(C0, _MM_SHUFFLE(1, 0, 3, 2));            \
+        D0 = _mm256_permute4x64_epi64(D0, _MM_SHUFFLE(0, 3, 2, 1));            \
+                                                                               \
+        B1 = _mm256_permute4x64_epi64(B1, _MM_SHUFFLE(2, 1, 0, 3));            \
+        C1 = _mm256_permute4x64_epi64(C1, _MM_SHUFFLE(1, 0, 3, 2));            \
+        D1 = _mm256_permute4x64_epi64(D1, _MM_SHUFFLE(0, 3, 2, 1));            \
+    } while ((void)0, 0)
+
+#define DIAGONALIZE_2_AVX2(A0, A1, B0, B1, C0, C1, D0, D1)                     \
+    do {                                                                       \
+        __m256i t0 = _mm256_blend_epi32(B0, B1, 0xCC);                         \
+        __m256i t1 = _mm256_blend_epi32(B0, B1, 0x33);                         \
+        B1 = _mm256_permute4x64_epi64(t0, _MM_SHUFFLE(2, 3, 0, 1));            \
+        B0 = _mm256_permute4x64_epi64(t1, _MM_SHUFFLE(2, 3, 0, 1));            \
+                                                                               \
+        t0 = C0;                                                               \
+        C0 = C1;                                                               \
+        C1 = t0;                                                               \
+                                                                               \
+        t0 = _mm256_blend_epi32(D0, D1, 0xCC);                                 \
+        t1 = _mm256_blend_epi32(D0, D1, 0x33);                                 \
+        D0 = _mm256_permute4x64_epi64(t0, _MM_SHUFFLE(2, 3, 0, 1));            \
+        D1 = _mm256_permute4x64_epi64(t1, _MM_SHUFFLE(2, 3, 0, 1));            \
+    } while ((void)0, 0)
+
+#define UNDIAGONALIZE_2_AVX2(A0, A1, B0, B1, C0, C1, D0, D1)                   \
+    do {                                                                       \
+        __m256i t0 = _mm256_blend_epi32(B0, B1, 0xCC);                         \
+        __m256i t1 = _mm256_blend_epi32(B0, B1, 0x33);                         \
+        B0 = _mm256_permute4x64_epi64(t0, _MM_SHUFFLE(2, 3, 0, 1));            \
+        B1 = _mm256_permute4x64_epi64(t1, _MM_SHUFFLE(2, 3, 0, 1));            \
+                                                                               \
+        t0 = C0;                                                               \
+        C0 = C1;                                                               \
+        C1 = t0;                                                               \
+                                                                               \
+        t0 = _mm256_blend_epi32(D0, D1, 0x33);                                 \
+        t1 = _mm256_blend_epi32(D0, D1, 0xCC);                                 \
+        D0 = _mm256_permute4x64_epi64(t0, _MM_SHUFFLE(2, 3, 0, 1));            \
+        D1 = _mm256_permute4x64_epi64(t1, _MM_SHUFFLE(2, 3, 0, 1));            \
+    } while ((void)0, 0)
+
+#define BLAKE2_ROUND_1_AVX2(A0, A1, B0, B1, C0, C1, D0, D1)                    \
+    do {                                                                       \
+        G1_AVX2(A0, A1, B0, B1, C0, C1, D0, D1);                               \
+        G2_AVX2(A0, A1, B0, B1, C0, C1, D0, D1);                               \
+                                                                               \
+        DIAGONALIZE_1_AVX2(A0, B0, C0, D0, A1, B1, C1, D1);                    \
+                                                                               \
+        G1_AVX2(A0, A1, B0, B1, C0, C1, D0, D1);                               \
+        G2_AVX2(A0, A1, B0, B1, C0, C1, D0, D1);                               \
+                                                                               \
+        UNDIAGONALIZE_1_AVX2(A0, B0, C0, D0, A1, B1, C1, D1);                  \
+    } while ((void)0, 0)
+
+#define BLAKE2_ROUND_2_AVX2(A0, A1, B0, B1, C0, C1, D0, D1)                    \
+    do {                                                                       \
+        G1_AVX2(A0, A1, B0, B1, C0, C1, D0, D1);                               \
+        G2_AVX2(A0, A1, B0, B1, C0, C1, D0, D1);                               \
+                                                                               \
+        DIAGONALIZE_2_AVX2(A0, A1, B0, B1, C0, C1, D0, D1);                    \
+                                                                               \
+        G1_AVX2(A0, A1, B0, B1, C0, C1, D0, D1);                               \
+        G2_AVX2(A0, A1, B0, B1, C0, C1, D0, D1);                               \
+                                                                               \
+        UNDIAGONALIZE_2_AVX2(A0, A1, B0, B1, C0, C1, D0, D1);                  \
+    } while ((void)0, 0)
+
+#endif /* __AVX2__ */
+
+/*
+ * AVX-512F rounds: a __m512i holds eight 64-bit words and rotations are native
+ * (vprorq). Only available in a unit built with AVX-512F.
+ */
+#if defined(__AVX512F__)
+
+static BLAKE2_INLINE __m512i fBlaMka_avx512(__m512i x, __m512i y) {
+    const __m512i z = _mm512_mul_epu32(x, y);
+    return _mm512_add_epi64(_mm512_add_epi64(x, y), _mm512_add_epi64(z, z));
+}
+
+#define G1_AVX512(A0, B0, C0, D0, A1, B1, C1, D1)                              \
+    do {                                                                       \
+        A0 = fBlaMka_avx512(A0, B0);                                           \
+        A1 = fBlaMka_avx512(A1, B1);                                           \
+                                                                               \
+        D0 = _mm512_ror_epi64(_mm512_xor_si512(D0, A0), 32);                   \
+        D1 = _mm512_ror_epi64(_mm512_xor_si512(D1, A1), 32);                   \
+                                                                               \
+        C0 = fBlaMka_avx512(C0, D0);                                           \
+        C1 = fBlaMka_avx512(C1, D1);                                           \
+                                                                               \
+        B0 = _mm512_ror_epi64(_mm512_xor_si512(B0, C0), 24);                   \
+        B1 = _mm512_ror_epi64(_mm512_xor_si512(B1, C1), 24);                   \
+    } while ((void)0, 0)
+
+#define G2_AVX512(A0, B0, C0, D0, A1, B1, C1, D1)                              \
+    do {                                                                       \
+        A0 = fBlaMka_avx512(A0, B0);                                           \
+        A1 = fBlaMka_avx512(A1, B1);                                           \
+                                                                               \
+        D0 = _mm512_ror_epi64(_mm512_xor_si512(D0, A0), 16);                   \
+        D1 = _mm512_ror_epi64(_mm512_xor_si512(D1, A1), 16);                   \
+                                                                               \
+        C0 = fBlaMka_avx512(C0, D0);                                           \
+        C1 = fBlaMka_avx512(C1, D1);                                           \
+                                                                               \
+        B0 = _mm512_ror_epi64(_mm512_xor_si512(B0, C0), 63);                   \
+        B1 = _mm512_ror_epi64(_mm512_xor_si512(B1, C1), 63);                   \
+    } while ((void)0, 0)
+
+#define DIAGONALIZE_AVX512(A0, B0, C0, D0, A1, B1, C1, D1)                     \
+    do {                                                                       \
+        B0 = _mm512_permutex_epi64(B0, _MM_SHUFFLE(0, 3, 2, 1));               \
+        B1 = _mm512_permutex_epi64(B1, _MM_SHUFFLE(0, 3, 2, 1));               \
+                                                                               \
+        C0 = _mm512_permutex_epi64(C0, _MM_SHUFFLE(1, 0, 3, 2));               \
+        C1 = _mm512_permutex_epi64(C1, _MM_SHUFFLE(1, 0, 3, 2));               \
+                                                                               \
+        D0 = _mm512_permutex_epi64(D0, _MM_SHUFFLE(2, 1, 0, 3));               \
+        D1 = _mm512_permutex_epi64(D1, _MM_SHUFFLE(2, 1, 0, 3));               \
+    } while ((void)0, 0)
+
+#define UNDIAGONALIZE_AVX512(A0, B0, C0, D0, A1, B1, C1, D1)                   \
+    do {                                                                       \
+        B0 = _mm512_permutex_epi64(B0, _MM_SHUFFLE(2, 1, 0, 3));               \
+        B1 = _mm512_permutex_epi64(B1, _MM_SHUFFLE(2, 1, 0, 3));               \
+                                                                               \
+        C0 = _mm512_permutex_epi64(C0, _MM_SHUFFLE(1, 0, 3, 2));               \
+        C1 = _mm512_permutex_epi64(C1, _MM_SHUFFLE(1, 0, 3, 2));               \
+                                                                               \
+        D0 = _mm512_permutex_epi64(D0, _MM_SHUFFLE(0, 3, 2, 1));               \
+        D1 = _mm512_permutex_epi64(D1, _MM_SHUFFLE(0, 3, 2, 1));               \
+    } while ((void)0, 0)
+
+#define BLAKE2_ROUND_AVX512(A0, B0, C0, D0, A1, B1, C1, D1)                    \
+    do {                                                                       \
+        G1_AVX512(A0, B0, C0, D0, A1, B1, C1, D1);                             \
+        G2_AVX512(A0, B0, C0, D0, A1, B1, C1, D1);                             \
+                                                                               \
+        DIAGONALIZE_AVX512(A0, B0, C0, D0, A1, B1, C1, D1);                    \
+                                                                               \
+        G1_AVX512(A0, B0, C0, D0, A1, B1, C1, D1);                             \
+        G2_AVX512(A0, B0, C0, D0, A1, B1, C1, D1);                             \
+                                                                               \
+        UNDIAGONALIZE_AVX512(A0, B0, C0, D0, A1, B1, C1, D1);                  \
+    } while ((void)0, 0)
+
+/* Exchanges the upper 256 bits of A0 with the lower 256 bits of A1 */
+#define SWAP_HALVES_AVX512(A0, A1)                                             \
+    do {                                                                       \
+        __m512i t0 = _mm512_shuffle_i64x2(A0, A1, _MM_SHUFFLE(1, 0, 1, 0));    \
+        __m512i t1 = _mm512_shuffle_i64x2(A0, A1, _MM_SHUFFLE(3, 2, 3, 2));    \
+        A0 = t0;                                                               \
+        A1 = t1;                                                               \
+    } while ((void)0, 0)
+
+#define SWAP_QUARTERS_AVX512(A0, A1)                                           \
+    do {                                                                       \
+        SWAP_HALVES_AVX512(A0, A1);                                            \
+        A0 = _mm512_permutexvar_epi64(_mm512_setr_epi64(0, 1, 4, 5, 2, 3, 6, 7), A0); \
+        A1 = _mm512_permutexvar_epi64(_mm512_setr_epi64(0, 1, 4, 5, 2, 3, 6, 7), A1); \
+    } while ((void)0, 0)
+
+#define UNSWAP_QUARTERS_AVX512(A0, A1)                                         \
+    do {                                                                       \
+        A0 = _mm512_permutexvar_epi64(_mm512_setr_epi64(0, 1, 4, 5, 2, 3, 6, 7), A0); \
+        A1 = _mm512_permutexvar_epi64(_mm512_setr_epi64(0, 1, 4, 5, 2, 3, 6, 7), A1); \
+        SWAP_HALVES_AVX512(A0, A1);                                            \
+    } while ((void)0, 0)
+
+#define BLAKE2_ROUND_1_AVX512(A0, C0, B0, D0, A1, C1, B1, D1)                  \
+    do {                                                                       \
+        SWAP_HALVES_AVX512(A0, B0);                                            \
+        SWAP_HALVES_AVX512(C0, D0);                                            \
+        SWAP_HALVES_AVX512(A1, B1);                                            \
+        SWAP_HALVES_AVX512(C1, D1);                                            \
+        BLAKE2_ROUND_AVX512(A0, B0, C0, D0, A1, B1, C1, D1);                   \
+        SWAP_HALVES_AVX512(A0, B0);                                            \
+        SWAP_HALVES_AVX512(C0, D0);                                            \
+        SWAP_HALVES_AVX512(A1, B1);                                            \
+        SWAP_HALVES_AVX512(C1, D1);                                            \
+    } while ((void)0, 0)
+
+#define BLAKE2_ROUND_2_AVX512(A0, A1, B0, B1, C0, C1, D0, D1)                  \
+    do {                                                                       \
+        SWAP_QUARTERS_AVX512(A0, A1);                                          \
+        SWAP_QUARTERS_AVX512(B0, B1);                                          \
+        SWAP_QUARTERS_AVX512(C0, C1);                                          \
+        SWAP_QUARTERS_AVX512(D0, D1);                                          \
+        BLAKE2_ROUND_AVX512(A0, B0, C0, D0, A1, B1, C1, D1);                   \
+        UNSWAP_QUARTERS_AVX512(A0, A1);                                        \
+        UNSWAP_QUARTERS_AVX512(B0, B1);                                        \
+        UNSWAP_QUARTERS_AVX512(C0, C1);                                        \
+        UNSWAP_QUARTERS_AVX512(D0, D1);                                        \
+    } while ((void)0, 0)
+
+#endif /* __AVX512F__ */
+
+
 #endif
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "whisper_interface.hh"
+
+/**
+ * @brief Outcome of one file of a batch transcription.
+ *
+ * `text` joins the texts of `segments`, without timestamps.
+ */
+struct HegemonikonTranscriptionResult
+{
+    size_t index = 0;
+    std::string path;
+    std::string text;
+    std::vector<HegemonikonWhisperSegment> segments;
+    std::string error;
+    double audio_seconds = 0.0;
+    double transcribe_ms = 0.0;
+
+    bool ok() const { return error.empty(); }
+
+    std::string to_string() const
+    {
+        return "HegemonikonTranscriptionResult(index=" + std::to_string(index) +
+               ", path='" + path +
+               "', n_segments=" + std::to_string(segments.size()) +
+               ", ok=" + (ok() ? "true" : "false") +
+               ", error='" + error +
+               "', audio_seconds=" + std::to_string(audio_seconds) +
+               ", transcribe_ms=" + std::to_string(transcribe_ms) + ")";
+    }
+};
+
+using transcription_result_callback_t = std::function<void(const HegemonikonTranscriptionResult &)>;
+
+/**
+ * @brief Transcribes a list of audio files with decoding and inference overlapped.
+ *
+ * Decoder threads open the files in order and resample them into per-file queues of at
+ * most MAX_QUEUED_SAMPLES, staying at most `n_decoders` files ahead of the transcription;
+ * whisper workers take the files in order and transcribe them from their queues with
+ * WhisperInterface::transcribe_stream_segments. Short files are thus fully decoded before whisper
+ * reaches them, and long ones stream through a bounded buffer.
+ *
+ * One worker is usually enough: transcribe_stream_segments already spreads a long file over
+ * HegemonikonWhisperModelParams::n_processors states. More workers transcribe several
+ * files at once, each with up to n_processors states.
+ */
+class AudioBatchTranscriber
+{
+public:
+    static constexpr size_t MAX_QUEUED_SAMPLES = WhisperInterface::SAMPLE_RATE * 60;
+
+    AudioBatchTranscriber(std::shared_ptr<WhisperInterface> whisper, size_t n_decoders = 2, size_t n_workers = 1);
+    ~AudioBatchTranscriber();
+
+    AudioBatchTranscriber(const AudioBatchTranscriber &) = delete;
+    AudioBatchTranscriber &operator=(const AudioBatchTranscriber &) = delete;
+
+    std::vector<HegemonikonTranscriptionResult> run(const std::vector<std::string> &audio_file_paths,
+                                                    const HegemonikonWhisperGenerationParams &params,
+                                                    const transcription_result_callback_t &on_result = nullptr);
+
+private:
+    struct Channel;
+
+    std::shared_ptr<WhisperInterface> whisper_;
+    size_t n_decoders_;
+    size_t n_workers_;
+
+    std::mutex mutex_;
+    std::condition_variable progress_;
+    std::vector<std::unique_ptr<Channel>> channels_;
+    size_t next_decode_ = 0;
+    size_t next_transcribe_ = 0;
+
+    void decode_files(const std::vector<std::string> &paths);
+    void transcribe_files(const std::vector<std::string> &paths, const HegemonikonWhisperGenerationParams &params,
+                          std::vector<HegemonikonTranscriptionResult> &results,
+                          const transcription_result_callback_t &on_result, std::mutex &result_mutex);
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+struct ma_decoder;
+
+/**
+ * @brief Decodes an audio file to 16 kHz mono float PCM, a buffer at a time.
+ *
+ * Wraps a miniaudio decoder that resamples and downmixes on the fly, so memory use does
+ * not depend on the length of the file. Files whose length the container does not report
+ * are decoded until their end like any other.
+ */
+class AudioFileDecoder
+{
+public:
+    static constexpr uint32_t SAMPLE_RATE = 16000;
+
+    AudioFileDecoder();
+    ~AudioFileDecoder();
+
+    AudioFileDecoder(const AudioFileDecoder &) = delete;
+    AudioFileDecoder &operator=(const AudioFileDecoder &) = delete;
+
+    bool open(const std::string &path);
+    void close();
+    bool is_open() const { return decoder_ != nullptr; }
+
+    size_t read(float *buffer, size_t max_samples);
+
+    uint64_t samples_read() const { return samples_read_; }
+    bool failed() const { return failed_; }
+    const std::string &error() const { return error_; }
+
+private:
+    std::unique_ptr<ma_decoder> decoder_;
+    std::string path_;
+    uint64_t samples_read_ = 0;
+    bool failed_ = false;
+    std::string error_;
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Sample formats delivered by capture devices that AudioFormatConverter reads.
+ */
+enum class AudioSampleFormat
+{
+    S16,
+    F32
+};
+
+/**
+ * @brief Converts interleaved device audio to the 16 kHz mono floats whisper expects.
+ *
+ * Samples go through three stages: int16 to float (SSE2 or NEON when available), downmix
+ * of the channels to mono (vectorized for stereo) and streaming linear resampling to
+ * 16 kHz; when downsampling, a windowed-sinc low-pass at 7 kHz runs first against
+ * aliasing. The state of the filter and the resampler carries over between calls, so a
+ * stream can be converted one device period at a time. Scratch buffers are allocated
+ * upfront: convert() never allocates, which keeps it usable from an audio callback.
+ */
+class AudioFormatConverter
+{
+public:
+    static constexpr uint32_t TARGET_SAMPLE_RATE = 16000;
+    static constexpr size_t MAX_BLOCK_FRAMES = 4096;
+
+    AudioFormatConverter(AudioSampleFormat format, uint32_t n_channels, uint32_t sample_rate);
+
+    AudioSampleFormat format() const { return format_; }
+    uint32_t n_channels() const { return n_channels_; }
+    uint32_t sample_rate() const { return sample_rate_; }
+
+    size_t max_output(size_t n_frames) const;
+    size_t convert(const void *input, size_t n_frames, float *output);
+    void reset();
+
+    static void s16_to_f32(const int16_t *input, float *output, size_t n_samples);
+    static void downmix(const float *input, size_t n_frames, uint32_t n_channels, float *output);
+
+private:
+    AudioSampleFormat format_;
+    uint32_t n_channels_;
+    uint32_t sample_rate_;
+    double step_;
+    std::vector<float> taps_;
+
+    // Resampler position in the input of the current block; in [-1, 0) it interpolates
+    // from last_, the final filtered sample of the previous block.
+    double position_ = 0.0;
+    float last_ = 0.0f;
+
+    std::vector<float> interleaved_;
+    // The last taps_.size() - 1 mono samples of the previous block, then the current block.
+    std::vector<float> mono_;
+    std::vector<float> filtered_;
+
+    size_t convert_block(const void *input, size_t n_frames, float *output);
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Lock-free ring of float samples between one producer and one consumer thread.
+ *
+ * Made for the capture callback of an audio device, which must neither lock nor allocate:
+ * write() and read() only touch two atomic positions. When the ring is full, write()
+ * drops the samples that do not fit and counts them, rather than waiting for the reader.
+ */
+class AudioRingBuffer
+{
+public:
+    explicit AudioRingBuffer(size_t min_capacity);
+
+    AudioRingBuffer(const AudioRingBuffer &) = delete;
+    AudioRingBuffer &operator=(const AudioRingBuffer &) = delete;
+
+    size_t capacity() const { return buffer_.size(); }
+
+    size_t write(const float *samples, size_t n_samples);
+    size_t read(float *buffer, size_t max_samples);
+
+    size_t read_available() const;
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    std::vector<float> buffer_;
+    size_t mask_;
+
+    // Positions only grow; the ring holds write_pos_ - read_pos_ samples. Kept on separate
+    // cache lines so that the producer and the consumer do not invalidate each other.
+    alignas(64) std::atomic<size_t> write_pos_{0};
+    alignas(64) std::atomic<size_t> read_pos_{0};
+    alignas(64) std::atomic<uint64_t> dropped_{0};
+};
@@ -1,3 +1,5 @@
+#pragma once
+
 #include <string>
 #include <vector>
 #include <cstdlib>
@@ -20,6 +22,15 @@
 #include <winreg.h>
 #endif
 
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define HEGEMONIKON_X86 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
 struct CPUInfo
 {
     std::string cpu_model;
@@ -35,7 +46,7 @@ struct CPUInfo
           architecture("Unknown"), cache_size("Unknown"), flags("Unknown") {}
 };
 
-std::ostream &operator<<(std::ostream &os, const CPUInfo &info)
+inline std::ostream &operator<<(std::ostream &os, const CPUInfo &info)
 {
     os << "CPU Model: " << info.cpu_model << "\n"
        << "  Cores: " << info.num_cores << "\n"
@@ -118,7 +129,7 @@ struct CPUInfoCollection
         SYSTEM_INFO sysInfo;
         GetSystemInfo(&sysInfo);
 
-        cpu_info info;
+        CPUInfo info;
         info.num_cores = sysInfo.dwNumberOfProcessors;
 
         HKEY hKey;
@@ -143,7 +154,7 @@ struct CPUInfoCollection
     void set_macos_cpu_info()
     {
 #ifdef __APPLE__
-        cpu_info info;
+        CPUInfo info;
 
         // CPU model
         char model[256];
@@ -202,3 +213,77 @@ struct CPUInfoCollection
 #endif
     }
 };
+
+
+/*
+ * SIMD extensions usable by this process: reported by CPUID and with their registers
+ * saved by the OS (XGETBV), read once and cached. Used to pick kernels at runtime.
+ */
+struct CPUFeatures
+{
+    bool sse2 = false;
+    bool ssse3 = false;
+    bool avx2 = false;
+    bool avx512f = false;
+
+    static const CPUFeatures &detect()
+    {
+        static const CPUFeatures features = probe();
+        return features;
+    }
+
+private:
+    static CPUFeatures probe()
+    {
+        CPUFeatures features;
+#ifdef HEGEMONIKON_X86
+        unsigned int regs[4] = {0, 0, 0, 0};
+        if (!cpuid(0, 0, regs))
+            return features;
+        const unsigned int max_leaf = regs[0];
+
+        cpuid(1, 0, regs);
+        features.sse2 = (regs[3] & (1u << 26)) != 0;
+        features.ssse3 = (regs[2] & (1u << 9)) != 0;
+        const bool osxsave = (regs[2] & (1u << 27)) != 0;
+        if (!osxsave || max_leaf < 7)
+            return features;
+
+        // XMM|YMM state for AVX2, plus opmask and ZMM state for AVX-512
+        const unsigned long long xcr0 = xgetbv();
+        const bool os_avx = (xcr0 & 0x6) == 0x6;
+        const bool os_avx512 = (xcr0 & 0xE6) == 0xE6;
+
+        cpuid(7, 0, regs);
+        features.avx2 = os_avx && (regs[1] & (1u << 5)) != 0;
+        features.avx512f = os_avx512 && (regs[1] & (1u << 16)) != 0;
+#endif
+        return features;
+    }
+
+#ifdef HEGEMONIKON_X86
+    static bool cpuid(unsigned int leaf, unsigned int subleaf, unsigned int regs[4])
+    {
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuidex(info, static_cast<int>(leaf), static_cast<int>(subleaf));
+        for (int i = 0; i < 4; ++i)
+            regs[i] = static_cast<unsigned int>(info[i]);
+        return true;
+#else
+        return __get_cpuid_count(leaf, subleaf, &regs[0], &regs[1], &regs[2], &regs[3]) != 0;
+#endif
+    }
+
+    static unsigned long long xgetbv()
+    {
+#if defined(_MSC_VER)
+        return _xgetbv(0);
+#else
+        unsigned int lo = 0, hi = 0;
+        __asm__ __volatile__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+        return (static_cast<unsigned long long>(hi) << 32) | lo;
+#endif
+    }
+#endif
+};
@@ -1,4 +1,7 @@
+#pragma once
+
 #include <string>
+#include <sstream>
 #include <vector>
 
 #include <cstdlib>
@@ -27,7 +30,7 @@ struct GPUInfo
     }
 };
 
-std::ostream &operator<<(std::ostream &os, const GPUInfo &info)
+inline std::ostream &operator<<(std::ostream &os, const GPUInfo &info)
 {
     os << "GPU Name: " << info.name << "\n"
        << "  Vendor: " << info.vendor << "\n"
@@ -87,7 +90,7 @@ struct GPUInfoCollection
             std::getline(iss, ram_str, ',');
             std::getline(iss, driver, ',');
 
-            gpu_info info;
+            GPUInfo info;
             info.name = name;
             info.memory_total_MB = std::stoul(ram_str) / (1024 * 1024);
             info.driver_version = driver;
@@ -106,7 +109,7 @@ struct GPUInfoCollection
             return;
 
         char buffer[256];
-        gpu_info info;
+        GPUInfo info;
         while (fgets(buffer, sizeof(buffer), pipe))
         {
             std::string line(buffer);
@@ -140,3 +143,33 @@ struct GPUInfoCollection
 #endif
     }
 };
+
+/**
+ * @brief Memory in use on the NVIDIA GPUs, summed over the devices, as reported by nvidia-smi.
+ *
+ * The figure is device-wide, other processes included: compare two readings to measure
+ * what a model takes. Returns 0 when nvidia-smi is not available.
+ */
+inline size_t get_gpu_memory_used_MB()
+{
+#if defined(__linux__) || defined(_WIN32)
+#ifdef _WIN32
+    FILE *pipe = POPEN("nvidia-smi --query-gpu=memory.used --format=csv,noheader,nounits 2>NUL", "r");
+#else
+    FILE *pipe = POPEN("nvidia-smi --query-gpu=memory.used --format=csv,noheader,nounits 2>/dev/null", "r");
+#endif
+    if (!pipe)
+        return 0;
+
+    size_t used_MB = 0;
+    char buffer[128];
+    while (fgets(buffer, sizeof(buffer), pipe))
+    {
+        used_MB += std::strtoul(buffer, nullptr, 10);
+    }
+    PCLOSE(pipe);
+    return used_MB;
+#else
+    return 0;
+#endif
+}
@@ -1,4 +1,8 @@
+#pragma once
+
+#include <atomic>
 #include <string>
+#include <sstream>
 #include <vector>
 #include <chrono>
 #include <iostream>
@@ -9,7 +13,7 @@
 using namespace std::chrono;
 
 #include <thread>
-unsigned int num_cores = std::thread::hardware_concurrency();
+inline unsigned int num_cores = std::thread::hardware_concurrency();
 
 
 #if defined(_WIN32)
@@ -21,7 +25,7 @@ unsigned int num_cores = std::thread::hardware_concurrency();
 
 
 
-long get_memory_usage_linux()
+inline long get_memory_usage_linux()
 {
     std::ifstream status_file("/proc/self/status");
     std::string line;
@@ -41,7 +45,7 @@ long get_memory_usage_linux()
 #include <mach/mach.h>
 #include <filesystem>
 
-long get_memory_usage_macos()
+inline long get_memory_usage_macos()
 {
     mach_task_basic_info_data_t task_info_data;
     mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
@@ -53,7 +57,7 @@ long get_memory_usage_macos()
 }
 #endif
 
-long get_current_memory_usage()
+inline long get_current_memory_usage()
 {
 #if defined(_WIN32)
     PROCESS_MEMORY_COUNTERS_EX pmc;
@@ -66,4 +70,54 @@ long get_current_memory_usage()
 #else
     return 0;
 #endif
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Polls the resident memory of the process on a background thread and keeps
+ * the largest value, from construction to stop().
+ */
+class PeakMemorySampler
+{
+public:
+    explicit PeakMemorySampler(std::chrono::milliseconds period = std::chrono::milliseconds(20))
+        : start_bytes_(get_current_memory_usage()), peak_bytes_(start_bytes_)
+    {
+        thread_ = std::thread([this, period]()
+                              {
+            while (running_.load())
+            {
+                const long current = get_current_memory_usage();
+                if (current > peak_bytes_.load())
+                {
+                    peak_bytes_.store(current);
+                }
+                std::this_thread::sleep_for(period);
+            } });
+    }
+
+    ~PeakMemorySampler()
+    {
+        stop();
+    }
+
+    PeakMemorySampler(const PeakMemorySampler &) = delete;
+    PeakMemorySampler &operator=(const PeakMemorySampler &) = delete;
+
+    void stop()
+    {
+        running_.store(false);
+        if (thread_.joinable())
+        {
+            thread_.join();
+        }
+    }
+
+    double start_mb() const { return static_cast<double>(start_bytes_) / (1024.0 * 1024.0); }
+    double peak_mb() const { return static_cast<double>(peak_bytes_.load()) / (1024.0 * 1024.0); }
+
+private:
+    const long start_bytes_;
+    std::atomic<long> peak_bytes_;
+    std::atomic<bool> running_{true};
+    std::thread thread_;
+};
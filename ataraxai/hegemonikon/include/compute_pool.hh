@@ -0,0 +1,205 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct ggml_threadpool;
+
+/**
+ * @brief Inference engines sharing the CPU through the compute pool.
+ */
+enum class ComputeEngine
+{
+    Llama,
+    Whisper
+};
+
+/**
+ * @brief One physical core; SMT siblings are represented by their first logical CPU.
+ */
+struct HegemonikonCpuCore
+{
+    int32_t cpu = -1;
+    int32_t core_id = -1;
+    int32_t package = 0;
+    int32_t numa_node = 0;
+    bool efficiency = false;
+};
+
+/**
+ * @brief Physical cores available to this process, with their core type and NUMA node.
+ *
+ * Detection reads sysfs on Linux (hybrid Intel `cpu_atom` cores and ARM `cpu_capacity`
+ * identify efficiency cores) and the perflevel sysctls on macOS; elsewhere every logical
+ * CPU is reported as a performance core on node 0. Only CPUs in the affinity mask of the
+ * process are listed.
+ */
+struct HegemonikonCpuTopology
+{
+    std::vector<HegemonikonCpuCore> cores;
+    int32_t n_logical_cpus = 0;
+    int32_t n_numa_nodes = 1;
+
+    static HegemonikonCpuTopology detect();
+
+    size_t n_performance_cores() const;
+    size_t n_efficiency_cores() const;
+
+    std::string to_string() const
+    {
+        return "HegemonikonCpuTopology(physical_cores=" + std::to_string(cores.size()) +
+               ", performance_cores=" + std::to_string(n_performance_cores()) +
+               ", efficiency_cores=" + std::to_string(n_efficiency_cores()) +
+               ", logical_cpus=" + std::to_string(n_logical_cpus) +
+               ", numa_nodes=" + std::to_string(n_numa_nodes) + ")";
+    }
+};
+
+/**
+ * @brief Quotas and counters of the compute pool.
+ */
+struct HegemonikonComputePoolStats
+{
+    int32_t n_threads = 0;
+    int32_t llama_quota = 0;
+    int32_t whisper_quota = 0;
+    int32_t llama_threads = 0;
+    int32_t whisper_threads = 0;
+    uint64_t llama_leases = 0;
+    uint64_t whisper_leases = 0;
+    uint64_t borrowed_leases = 0;
+    bool pinned = false;
+    int32_t numa_node = -1;
+
+    std::string to_string() const
+    {
+        return "HegemonikonComputePoolStats(n_threads=" + std::to_string(n_threads) +
+               ", llama_quota=" + std::to_string(llama_quota) +
+               ", whisper_quota=" + std::to_string(whisper_quota) +
+               ", llama_threads=" + std::to_string(llama_threads) +
+               ", whisper_threads=" + std::to_string(whisper_threads) +
+               ", llama_leases=" + std::to_string(llama_leases) +
+               ", whisper_leases=" + std::to_string(whisper_leases) +
+               ", borrowed_leases=" + std::to_string(borrowed_leases) +
+               ", pinned=" + (pinned ? "true" : "false") +
+               ", numa_node=" + std::to_string(numa_node) + ")";
+    }
+};
+
+class ComputePool;
+
+/**
+ * @brief Right to run one engine on a number of the pool's cores until destroyed.
+ *
+ * Llama takes a lease per decode step and runs on the ggml threadpool it carries; whisper
+ * takes one per transcription and, when pinning is enabled, binds the calling thread (and
+ * so the workers whisper spawns from it) to the lease CPUs with bind_current_thread().
+ */
+class ComputeLease
+{
+public:
+    ComputeLease() = default;
+    ~ComputeLease();
+
+    ComputeLease(ComputeLease &&other) noexcept;
+    ComputeLease &operator=(ComputeLease &&other) noexcept;
+    ComputeLease(const ComputeLease &) = delete;
+    ComputeLease &operator=(const ComputeLease &) = delete;
+
+    int32_t n_threads() const { return n_threads_; }
+    bool borrowed() const { return borrowed_; }
+    const std::vector<int32_t> &cpus() const { return cpus_; }
+
+    /**
+     * @brief The ggml threadpool llama contexts run on, nullptr for whisper leases.
+     */
+    const std::shared_ptr<ggml_threadpool> &threadpool() const { return threadpool_; }
+
+    bool bind_current_thread();
+
+private:
+    friend class ComputePool;
+
+    void release();
+
+    ComputePool *pool_ = nullptr;
+    ComputeEngine engine_ = ComputeEngine::Llama;
+    int32_t n_threads_ = 0;
+    bool borrowed_ = false;
+    std::vector<int32_t> cpus_;
+    std::shared_ptr<ggml_threadpool> threadpool_;
+    std::vector<uint8_t> saved_affinity_;
+};
+
+/**
+ * @brief Process-wide arbiter of the CPU cores used by llama and whisper.
+ *
+ * Cores are ordered with the performance cores first. Llama always runs on the
+ * performance cores, through a ggml threadpool sized for all of them; whisper runs on
+ * the tail of the order, i.e. on the efficiency cores of hybrid CPUs. Each engine has a
+ * quota it is guaranteed while both run; an idle engine lends its cores to the other.
+ * Llama re-reads its share at every decode step, so it gives borrowed cores back as soon
+ * as a transcription starts. Whisper fixes its thread count when a transcription starts,
+ * borrowing llama's cores only if llama has not run for a short grace period.
+ *
+ * Pinning and the NUMA node restriction are off by default; when enabled, llama's
+ * threads are pinned one per core and whisper's workers inherit the lease CPUs.
+ */
+class ComputePool
+{
+public:
+    static constexpr int64_t DEFAULT_IDLE_GRACE_MS = 250;
+
+    static std::shared_ptr<ComputePool> shared();
+
+    explicit ComputePool(HegemonikonCpuTopology topology = HegemonikonCpuTopology::detect());
+    ~ComputePool();
+
+    ComputePool(const ComputePool &) = delete;
+    ComputePool &operator=(const ComputePool &) = delete;
+
+    void configure(bool pin_threads, int32_t numa_node = -1);
+    void set_quota(ComputeEngine engine, int32_t n_threads);
+    int32_t get_quota(ComputeEngine engine) const;
+    void set_idle_grace_ms(int64_t grace_ms);
+
+    ComputeLease acquire(ComputeEngine engine, int32_t max_threads = 0);
+
+    int32_t size() const;
+    HegemonikonCpuTopology get_topology() const;
+    HegemonikonComputePoolStats get_stats() const;
+
+private:
+    friend class ComputeLease;
+
+    using clock = std::chrono::steady_clock;
+
+    HegemonikonCpuTopology topology_;
+    std::vector<int32_t> cpus_;
+    size_t n_llama_cpus_ = 0;
+    int32_t llama_quota_ = 0;
+    int32_t whisper_quota_ = 0;
+    bool llama_quota_set_ = false;
+    bool whisper_quota_set_ = false;
+    bool pin_threads_ = false;
+    int32_t numa_node_ = -1;
+    int64_t idle_grace_ms_ = DEFAULT_IDLE_GRACE_MS;
+
+    int32_t llama_active_ = 0;
+    int32_t whisper_threads_ = 0;
+    int32_t last_llama_threads_ = 0;
+    clock::time_point last_llama_release_{};
+    std::shared_ptr<ggml_threadpool> threadpool_;
+    bool threadpool_failed_ = false;
+    HegemonikonComputePoolStats stats_;
+
+    mutable std::mutex mutex_;
+
+    void layout_locked();
+    std::shared_ptr<ggml_threadpool> threadpool_locked();
+    void release(ComputeEngine engine, int32_t n_threads);
+};
@@ -1,3 +1,2 @@
 #pragma once
-#include "benchmarker/benchmarker.hh"
-#include "benchmarker/model_benchmarker.hh"
\ No newline at end of file
+#include "model_benchmarker.hh"#include "whisper_benchmarker.hh"
@@ -1,11 +1,29 @@
 #pragma once
 
+#include <atomic>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <memory>
+#include <future>
+#include <mutex>
+#include <thread>
 
 #include "llama_interface.hh"
+#include "llama_batch_scheduler.hh"
+#include "llama_context_pool.hh"
+#include "llama_model_registry.hh"
+#include "llama_tuning_store.hh"
+#include "metrics_registry.hh"
+#include "hegemonikon_log.hh"
+#include "trace_recorder.hh"
+#include "llama_token_stream.hh"
+#include "thread_pool.hh"
 #include "whisper_interface.hh"
+#include "whisper_stream_session.hh"
+#include "audio_batch_transcriber.hh"
+#include "transcript_prefiller.hh"
+#include "transcription_cache.hh"
 
 class CoreAIService
 {
@@ -18,31 +36,175 @@ public:
 
     virtual bool initialize_llama_model(const HegemonikonLlamaModelParams &llama_model_params_);
 
+    std::shared_ptr<LlamaLoadStatus> initialize_llama_model_async(const HegemonikonLlamaModelParams &llama_model_params_);
+
     virtual void unload_llama_model();
 
     virtual bool is_llama_model_loaded() const;
 
     std::string process_prompt(const std::string &prompt_text, const HegemonikonGenerationParams &llama_generation_params_);
 
+    std::string process_prompt(const std::string &prompt_text, const HegemonikonGenerationParams &llama_generation_params_,
+                               std::shared_ptr<LlamaRequestHandle> handle);
+
     std::vector<int32_t> tokenization(const std::string &text);
     std::string detokenization(const std::vector<int32_t> &tokens) const;
 
+    HegemonikonTokenBatch tokenize_batch(const std::vector<std::string_view> &texts);
+
+    bool initialize_embedding_model(const HegemonikonLlamaModelParams &embedding_model_params_);
+
+    void unload_embedding_model();
+
+    bool is_embedding_model_loaded() const;
+
+    HegemonikonEmbeddingBatch embed(const std::vector<std::string_view> &texts, bool normalize = true);
+
+    std::vector<int32_t> count_tokens(const std::vector<std::string_view> &texts);
+
     bool stream_prompt(const std::string &prompt_text,
                        const HegemonikonGenerationParams &llama_generation_params,
                        llama_token_callback callback);
 
+    bool stream_prompt(const std::string &prompt_text,
+                       const HegemonikonGenerationParams &llama_generation_params,
+                       llama_token_callback callback,
+                       std::shared_ptr<LlamaRequestHandle> handle);
+
+    bool stream_prompt(const std::string &prompt_text,
+                       const HegemonikonGenerationParams &llama_generation_params,
+                       llama_token_callback callback,
+                       std::shared_ptr<LlamaRequestHandle> handle,
+                       std::string &error);
+
+    std::unique_ptr<LlamaTokenStream> open_prompt_stream(const std::string &prompt_text,
+                                                         const HegemonikonGenerationParams &llama_generation_params);
+
+    std::future<HegemonikonGenerationResult> submit_prompt(const std::string &prompt_text,
+                                                           const HegemonikonGenerationParams &llama_generation_params,
+                                                           llama_token_callback on_piece = nullptr,
+                                                           std::shared_ptr<LlamaRequestHandle> handle = nullptr);
+
+    HegemonikonGenerationResult process_prompt_batched(const std::string &prompt_text,
+                                                       const HegemonikonGenerationParams &llama_generation_params,
+                                                       std::shared_ptr<LlamaRequestHandle> handle = nullptr);
+
+    HegemonikonSchedulerStats get_llama_scheduler_stats() const;
+
+    void configure_llama_context_pool(size_t n_contexts, int32_t n_ctx = 0);
+
+    HegemonikonContextPoolStats get_llama_context_pool_stats() const;
+
+    bool reset_llama_session(const std::string &session_id);
+
+    void clear_llama_sessions();
+
+    bool save_llama_session(const std::string &session_id, const std::string &directory,
+                            const SecureKey *key = nullptr);
+
+    int32_t restore_llama_session(const std::string &prompt_text,
+                                  const HegemonikonGenerationParams &llama_generation_params,
+                                  const std::string &directory, const SecureKey *key = nullptr);
+
+    HegemonikonPrefixCacheStats get_llama_prefix_cache_stats() const;
+
+    void clear_llama_prefix_cache();
+
+    HegemonikonSpeculativeStats get_llama_speculative_stats() const;
+
+    bool preload_llama_model(const HegemonikonLlamaModelParams &llama_model_params_);
+
+    bool is_llama_model_resident(const HegemonikonLlamaModelParams &llama_model_params_) const;
+
+    bool pin_llama_model(const HegemonikonLlamaModelParams &llama_model_params_, bool pinned = true);
+
+    bool evict_llama_model(const HegemonikonLlamaModelParams &llama_model_params_);
+
+    bool enable_tuned_llama_params(const std::string &store_path);
+
+    void disable_tuned_llama_params();
+
+    HegemonikonLlamaModelParams resolve_llama_model_params(const HegemonikonLlamaModelParams &llama_model_params_) const;
+
+    void set_llama_memory_budget(uint64_t ram_budget_bytes, uint64_t vram_budget_bytes);
+
+    HegemonikonModelRegistryStats get_llama_registry_stats() const;
+
+    void set_compute_quota(ComputeEngine engine, int32_t n_threads);
+
+    void configure_compute_pool(bool pin_threads, int32_t numa_node = -1);
+
+    HegemonikonComputePoolStats get_compute_pool_stats() const;
+
+    HegemonikonCpuTopology get_cpu_topology() const;
+
+    HegemonikonMetricsSnapshot get_metrics() const;
+
+    std::string export_metrics_prometheus() const;
+
+    void reset_metrics();
+
+    static void start_trace(size_t events_per_thread = TraceRecorder::DEFAULT_EVENTS_PER_THREAD);
+
+    static void stop_trace();
+
+    static bool write_trace(const std::string &path);
+
+    static HegemonikonTraceStats get_trace_stats();
+
+    static void set_log_level(HegemonikonLogLevel level);
+
+    static HegemonikonLogLevel get_log_level();
+
     bool initialize_whisper_model(const HegemonikonWhisperModelParams &whisper_model_params_);
 
     void unload_whisper_model();
 
+    static void release_resident_whisper_model();
+
+    bool warm_up_whisper_model(const HegemonikonWhisperGenerationParams &whisper_transcription_params);
+
     bool is_whisper_model_loaded() const;
 
     std::string transcribe_audio_pcm(const std::vector<float> &pcm_f32_data,
                                      const HegemonikonWhisperGenerationParams &whisper_transcription_params);
 
+    std::string transcribe_audio_pcm(const float *pcm_f32_data, size_t n_samples,
+                                     const HegemonikonWhisperGenerationParams &whisper_transcription_params);
+
     std::string transcribe_audio_file(const std::string &audio_file_path,
                                       const HegemonikonWhisperGenerationParams &whisper_transcription_params);
 
+    HegemonikonTranscription transcribe_audio_pcm_segments(const float *pcm_f32_data, size_t n_samples,
+                                                           const HegemonikonWhisperGenerationParams &whisper_transcription_params);
+
+    HegemonikonTranscription transcribe_audio_file_segments(const std::string &audio_file_path,
+                                                            const HegemonikonWhisperGenerationParams &whisper_transcription_params);
+
+    std::vector<HegemonikonTranscriptionResult> transcribe_batch(const std::vector<std::string> &audio_file_paths,
+                                                                 const HegemonikonWhisperGenerationParams &whisper_transcription_params,
+                                                                 const transcription_result_callback_t &on_result = nullptr,
+                                                                 size_t n_decoders = 2, size_t n_workers = 1);
+
+    HegemonikonAudioPromptResult transcribe_and_generate(const std::string &audio_file_path,
+                                                         const HegemonikonWhisperGenerationParams &whisper_transcription_params,
+                                                         const std::string &prompt_prefix,
+                                                         const std::string &prompt_suffix,
+                                                         const HegemonikonGenerationParams &llama_generation_params,
+                                                         llama_token_callback on_piece = nullptr);
+
+    bool enable_transcription_cache(const std::string &directory,
+                                    uint64_t max_bytes = TranscriptionCache::DEFAULT_MAX_BYTES);
+
+    void disable_transcription_cache();
+
+    size_t clear_transcription_cache();
+
+    HegemonikonTranscriptionCacheStats get_transcription_cache_stats() const;
+
+    std::unique_ptr<WhisperStreamSession> open_transcription_stream(const HegemonikonWhisperGenerationParams &whisper_transcription_params,
+                                                                    whisper_segment_callback_t on_segment);
+
     static void initialize_global_backends();
 
     static void free_global_backends();
@@ -50,14 +212,17 @@ public:
     /**
      * @brief Sets the Llama interface for this service.
      *
-     * Transfers ownership of the provided LlamaInterface instance to this service,
-     * replacing any previously set interface.
+     * Transfers ownership of the provided LlamaInterface instance to this service. The
+     * active model is unloaded and the next initialize_llama_model call of a model that
+     * is not resident loads into this instance.
      *
      * @param llama_interface A unique pointer to a LlamaInterface instance.
      */
     void set_llama_interface(std::unique_ptr<LlamaInterface> llama_interface)
     {
-        llama_interface_ = std::move(llama_interface);
+        unload_llama_model();
+        std::lock_guard<std::mutex> lock(llama_interface_mutex_);
+        spare_llama_interface_ = std::move(llama_interface);
     }
 
     /**
@@ -70,18 +235,77 @@ public:
      */
     void set_whisper_interface(std::unique_ptr<WhisperInterface> whisper_interface)
     {
+        std::lock_guard<std::mutex> lock(whisper_interface_mutex_);
         whisper_interface_ = std::move(whisper_interface);
+        if (whisper_interface_)
+        {
+            whisper_interface_->set_compute_pool(compute_pool_);
+            whisper_interface_->set_metrics(metrics_);
+        }
     }
 
 private:
-    std::unique_ptr<LlamaInterface> llama_interface_;
-    std::unique_ptr<WhisperInterface> whisper_interface_;
+    std::shared_ptr<ComputePool> compute_pool_ = ComputePool::shared();
+    std::shared_ptr<MetricsRegistry> metrics_ = std::make_shared<MetricsRegistry>();
+    std::shared_ptr<LlamaInterface> llama_interface_;
+    std::shared_ptr<LlamaInterface> spare_llama_interface_;
+    mutable std::mutex llama_interface_mutex_;
+    LlamaModelRegistry llama_registry_;
+    std::shared_ptr<LlamaTuningStore> llama_tuning_store_;
+    mutable std::mutex llama_tuning_store_mutex_;
+    std::shared_ptr<WhisperInterface> whisper_interface_;
+    mutable std::mutex whisper_interface_mutex_;
+    TranscriptionCache transcription_cache_;
+    std::atomic<uint64_t> audio_prompt_counter_{0};
+
+    std::shared_ptr<LlamaInterface> embedding_interface_;
+    mutable std::mutex embedding_interface_mutex_;
+
+    std::unique_ptr<LlamaBatchScheduler> llama_scheduler_;
+    std::shared_ptr<LlamaInterface> llama_scheduler_model_;
+    mutable std::mutex llama_scheduler_mutex_;
+
+    std::shared_ptr<LlamaContextPool> llama_context_pool_;
+    size_t llama_context_pool_size_ = 1;
+    int32_t llama_context_pool_n_ctx_ = 0;
+    mutable std::mutex llama_context_pool_mutex_;
+
+    std::thread llama_load_thread_;
+    std::mutex llama_load_thread_mutex_;
+
+    std::unique_ptr<ThreadPool> tokenizer_pool_;
+    std::mutex tokenizer_pool_mutex_;
 
-    bool llama_model_loaded_ = false;
     bool whisper_model_loaded_ = false;
 
     HegemonikonLlamaModelParams llama_model_params;
     HegemonikonWhisperModelParams whisper_model_params;
 
-    std::vector<float> convert_audio_file_to_pcm_f32(const std::string &audio_file_path);
+    bool activate_llama_model(const HegemonikonLlamaModelParams &llama_model_params_,
+                              std::shared_ptr<LlamaLoadStatus> status);
+
+    void join_llama_load_thread();
+
+    void stop_llama_scheduler();
+
+    void drain_llama_scheduler();
+
+    void stop_llama_context_pool();
+
+    std::shared_ptr<LlamaContextPool> get_llama_context_pool(const std::shared_ptr<LlamaInterface> &llama);
+
+    std::shared_ptr<LlamaInterface> get_active_llama_interface() const;
+
+    std::shared_ptr<WhisperInterface> get_loaded_whisper_interface() const;
+
+    bool lookup_cached_transcription(const std::string &audio_file_path,
+                                     const HegemonikonWhisperModelParams &model_params,
+                                     const HegemonikonWhisperGenerationParams &whisper_transcription_params,
+                                     std::string &key, HegemonikonTranscription &transcription);
+
+    std::shared_ptr<LlamaInterface> take_spare_llama_interface();
+
+    void claim_spare_llama_interface(const std::shared_ptr<LlamaInterface> &model);
+
+    ThreadPool *get_tokenizer_pool();
 };
\ No newline at end of file
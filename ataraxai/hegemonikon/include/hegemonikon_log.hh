@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+
+/**
+ * @brief Verbosity of the console messages of the native core.
+ *
+ * Errors and warnings are printed by default. Info covers model loads, unloads and
+ * warm-ups; Debug covers per-request chatter (VAD results, KV-cache evictions) and the
+ * informational logs of llama.cpp.
+ */
+enum class HegemonikonLogLevel
+{
+    Off,
+    Error,
+    Warning,
+    Info,
+    Debug
+};
+
+/**
+ * @brief Process-wide log level, checked before building a console message.
+ *
+ * @code
+ * if (HegemonikonLog::enabled(HegemonikonLogLevel::Debug))
+ * {
+ *     std::cerr << "..." << std::endl;
+ * }
+ * @endcode
+ */
+class HegemonikonLog
+{
+public:
+    static void set_level(HegemonikonLogLevel level)
+    {
+        storage().store(static_cast<int>(level), std::memory_order_relaxed);
+    }
+
+    static HegemonikonLogLevel level()
+    {
+        return static_cast<HegemonikonLogLevel>(storage().load(std::memory_order_relaxed));
+    }
+
+    static bool enabled(HegemonikonLogLevel level)
+    {
+        return level != HegemonikonLogLevel::Off &&
+               static_cast<int>(level) <= storage().load(std::memory_order_relaxed);
+    }
+
+private:
+    static std::atomic<int> &storage()
+    {
+        static std::atomic<int> level{static_cast<int>(HegemonikonLogLevel::Warning)};
+        return level;
+    }
+};
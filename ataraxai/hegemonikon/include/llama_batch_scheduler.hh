@@ -0,0 +1,185 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "llama_interface.hh"
+
+/**
+ * @brief Queue counters of one scheduling class.
+ *
+ * Wait times go from submit() to admission; the average and percentile cover the last
+ * WAIT_SAMPLES admissions of the class.
+ */
+struct HegemonikonPriorityClassStats
+{
+    static constexpr size_t WAIT_SAMPLES = 256;
+
+    uint32_t queued_requests = 0;
+    uint64_t requests_admitted = 0;
+    uint64_t preemptions = 0;
+    double queue_wait_ms_avg = 0.0;
+    double queue_wait_ms_p95 = 0.0;
+    double queue_wait_ms_max = 0.0;
+
+    std::string to_string() const
+    {
+        return "HegemonikonPriorityClassStats(queued_requests=" + std::to_string(queued_requests) +
+               ", requests_admitted=" + std::to_string(requests_admitted) +
+               ", preemptions=" + std::to_string(preemptions) +
+               ", queue_wait_ms_avg=" + std::to_string(queue_wait_ms_avg) +
+               ", queue_wait_ms_p95=" + std::to_string(queue_wait_ms_p95) +
+               ", queue_wait_ms_max=" + std::to_string(queue_wait_ms_max) + ")";
+    }
+};
+
+/**
+ * @brief Throughput counters of the batching scheduler.
+ */
+struct HegemonikonSchedulerStats
+{
+    uint64_t requests_submitted = 0;
+    uint64_t requests_completed = 0;
+    uint64_t decode_steps = 0;
+    uint64_t tokens_decoded = 0;
+    uint64_t tokens_generated = 0;
+    uint32_t active_sequences = 0;
+    uint32_t queued_requests = 0;
+    uint32_t parked_sequences = 0;
+    uint64_t preemptions = 0;
+    uint64_t resumptions = 0;
+    double busy_time_ms = 0.0;
+    HegemonikonPriorityClassStats interactive;
+    HegemonikonPriorityClassStats batch;
+    HegemonikonPriorityClassStats background;
+
+    HegemonikonPriorityClassStats &for_priority(LlamaRequestPriority priority)
+    {
+        return priority == LlamaRequestPriority::Background ? background
+               : priority == LlamaRequestPriority::Batch    ? batch
+                                                            : interactive;
+    }
+
+    /**
+     * @brief Aggregate generation throughput over the time the scheduler was decoding.
+     */
+    double tokens_per_second() const
+    {
+        return busy_time_ms > 0.0 ? tokens_generated * 1000.0 / busy_time_ms : 0.0;
+    }
+
+    std::string to_string() const
+    {
+        return "HegemonikonSchedulerStats(requests_submitted=" + std::to_string(requests_submitted) +
+               ", requests_completed=" + std::to_string(requests_completed) +
+               ", decode_steps=" + std::to_string(decode_steps) +
+               ", tokens_decoded=" + std::to_string(tokens_decoded) +
+               ", tokens_generated=" + std::to_string(tokens_generated) +
+               ", active_sequences=" + std::to_string(active_sequences) +
+               ", queued_requests=" + std::to_string(queued_requests) +
+               ", parked_sequences=" + std::to_string(parked_sequences) +
+               ", preemptions=" + std::to_string(preemptions) +
+               ", resumptions=" + std::to_string(resumptions) +
+               ", tokens_per_second=" + std::to_string(tokens_per_second()) + ")";
+    }
+};
+
+/**
+ * @brief Continuous-batching scheduler over a single LlamaInterface.
+ *
+ * Requests are queued by submit() and admitted by a worker thread as long as KV-cache
+ * sequences are available. Each iteration packs one decode token per active sequence
+ * plus prefill chunks of newly admitted ones into a single llama_decode, so concurrent
+ * requests share the device instead of running one after the other. Finished sequences
+ * are retired immediately and their futures resolved without stalling the others.
+ *
+ * Requests are queued per HegemonikonGenerationParams::priority and admitted class by
+ * class, first come first served within a class. While an interactive sequence is
+ * decoding, background sequences are held out of the decode steps so they add nothing
+ * to its inter-token latency. When a request finds no free sequence, the most recently
+ * admitted background sequence of lower priority is parked: its KV state is copied to
+ * host memory and its sequence handed over. Parked sequences resume, ahead of queued
+ * requests of their class, as soon as a sequence is free again.
+ */
+class LlamaBatchScheduler
+{
+public:
+    explicit LlamaBatchScheduler(LlamaInterface &llama_interface, uint32_t max_active = 0);
+    ~LlamaBatchScheduler();
+
+    LlamaBatchScheduler(const LlamaBatchScheduler &) = delete;
+    LlamaBatchScheduler &operator=(const LlamaBatchScheduler &) = delete;
+
+    std::future<HegemonikonGenerationResult> submit(const std::string &prompt_text,
+                                                    const HegemonikonGenerationParams &params,
+                                                    llama_token_callback on_piece = nullptr,
+                                                    std::shared_ptr<LlamaRequestHandle> handle = nullptr);
+
+    void stop();
+
+    void drain();
+
+    bool is_running() const { return running_.load(); }
+
+    HegemonikonSchedulerStats get_stats() const;
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    struct PendingRequest
+    {
+        std::string prompt_text;
+        HegemonikonGenerationParams params;
+        llama_token_callback on_piece;
+        std::shared_ptr<LlamaRequestHandle> handle;
+        std::promise<HegemonikonGenerationResult> promise;
+        clock::time_point submitted_at;
+    };
+
+    struct ActiveRequest
+    {
+        std::unique_ptr<LlamaGenerationSequence> sequence;
+        std::promise<HegemonikonGenerationResult> promise;
+        uint64_t admission = 0;
+    };
+
+    struct WaitSamples
+    {
+        std::vector<double> samples;
+        size_t next = 0;
+        double max_ms = 0.0;
+    };
+
+    LlamaInterface &llama_interface_;
+    uint32_t max_active_;
+
+    mutable std::mutex queue_mutex_;
+    std::condition_variable queue_cv_;
+    std::array<std::deque<PendingRequest>, LLAMA_REQUEST_PRIORITY_COUNT> queues_;
+    std::vector<ActiveRequest> active_;
+    uint64_t admission_counter_ = 0;
+
+    std::atomic<bool> running_{true};
+    std::atomic<bool> draining_{false};
+    std::thread worker_;
+
+    mutable std::mutex stats_mutex_;
+    HegemonikonSchedulerStats stats_;
+    std::array<WaitSamples, LLAMA_REQUEST_PRIORITY_COUNT> wait_samples_;
+
+    void run();
+    void admit_pending();
+    void retire_finished();
+    void poll_held(const std::vector<LlamaGenerationSequence *> &held);
+    bool queues_empty_locked() const;
+    void record_wait(LlamaRequestPriority priority, double wait_ms);
+};
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "llama_interface.hh"
+
+/**
+ * @brief Occupancy counters of a context pool.
+ */
+struct HegemonikonContextPoolStats
+{
+    uint32_t n_contexts = 0;
+    uint32_t n_ctx = 0;
+    uint32_t contexts_leased = 0;
+    uint64_t leases = 0;
+    uint64_t session_hits = 0;
+    uint64_t waits = 0;
+    double wait_time_ms = 0.0;
+
+    std::string to_string() const
+    {
+        return "HegemonikonContextPoolStats(n_contexts=" + std::to_string(n_contexts) +
+               ", n_ctx=" + std::to_string(n_ctx) +
+               ", contexts_leased=" + std::to_string(contexts_leased) +
+               ", leases=" + std::to_string(leases) +
+               ", session_hits=" + std::to_string(session_hits) +
+               ", waits=" + std::to_string(waits) +
+               ", wait_time_ms=" + std::to_string(wait_time_ms) + ")";
+    }
+};
+
+class LlamaContextPool;
+
+/**
+ * @brief Exclusive use of one context of a LlamaContextPool.
+ *
+ * The context goes back to the pool when the lease is destroyed. An empty lease (from a
+ * failed try_acquire) converts to false.
+ */
+class LlamaContextLease
+{
+public:
+    LlamaContextLease() = default;
+    LlamaContextLease(LlamaContextLease &&other) noexcept;
+    LlamaContextLease &operator=(LlamaContextLease &&other) noexcept;
+    LlamaContextLease(const LlamaContextLease &) = delete;
+    LlamaContextLease &operator=(const LlamaContextLease &) = delete;
+    ~LlamaContextLease();
+
+    LlamaInterface *get() const { return interface_.get(); }
+    LlamaInterface *operator->() const { return interface_.get(); }
+    explicit operator bool() const { return interface_ != nullptr; }
+    size_t index() const { return index_; }
+
+    void release();
+
+private:
+    friend class LlamaContextPool;
+
+    LlamaContextLease(LlamaContextPool *pool, std::shared_ptr<LlamaInterface> interface, size_t index)
+        : pool_(pool), interface_(std::move(interface)), index_(index) {}
+
+    LlamaContextPool *pool_ = nullptr;
+    std::shared_ptr<LlamaInterface> interface_;
+    size_t index_ = 0;
+};
+
+/**
+ * @brief Several llama contexts over one loaded model, leased to concurrent callers.
+ *
+ * A LlamaInterface serializes its requests on one context. The pool adds contexts that
+ * share the weights of the primary interface (see LlamaInterface::share_model), each with
+ * its own KV cache, sessions and prefix cache, so that independent requests run in
+ * parallel instead of queueing. Memory grows by one KV cache and compute buffer per
+ * context, not by a copy of the model.
+ *
+ * The primary interface is context 0 and keeps its own n_ctx; the other contexts use the
+ * n_ctx given to the constructor. acquire() prefers the context that already holds the KV
+ * cache of the request's session, so a chat keeps reusing its cached history, and waits
+ * for it when it is busy rather than rebuilding the history elsewhere.
+ *
+ * The pool must outlive its leases.
+ */
+class LlamaContextPool
+{
+public:
+    LlamaContextPool(std::shared_ptr<LlamaInterface> primary, size_t n_contexts, int32_t n_ctx = 0);
+    ~LlamaContextPool();
+
+    LlamaContextPool(const LlamaContextPool &) = delete;
+    LlamaContextPool &operator=(const LlamaContextPool &) = delete;
+
+    LlamaContextLease acquire(const std::string &session_id = "");
+    LlamaContextLease try_acquire(const std::string &session_id = "");
+
+    size_t size() const;
+    const std::shared_ptr<LlamaInterface> &primary() const { return primary_; }
+    std::vector<std::shared_ptr<LlamaInterface>> contexts() const;
+
+    HegemonikonContextPoolStats get_stats() const;
+
+private:
+    friend class LlamaContextLease;
+
+    struct Entry
+    {
+        std::shared_ptr<LlamaInterface> interface;
+        bool leased = false;
+    };
+
+    std::shared_ptr<LlamaInterface> primary_;
+    std::shared_ptr<MetricsRegistry> metrics_;
+    std::vector<Entry> entries_;
+    int32_t n_ctx_ = 0;
+
+    mutable std::mutex mutex_;
+    std::condition_variable released_;
+    HegemonikonContextPoolStats stats_;
+
+    size_t find_session(const std::string &session_id) const;
+    bool pick_locked(size_t owner, size_t &index) const;
+    LlamaContextLease lease_locked(size_t index, size_t owner);
+    void give_back(size_t index);
+};
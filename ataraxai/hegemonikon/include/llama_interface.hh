@@ -1,10 +1,26 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
+#include <chrono>
 #include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
 #include <llama.h>
 #include <stdexcept>
+#include "llama_piece_table.hh"
+#include "compute_pool.hh"
+#include "metrics_registry.hh"
+#include "llama_load_status.hh"
+#include "llama_ngram_lookup.hh"
+#include "llama_prefix_cache.hh"
+#include "llama_request_handle.hh"
+#include "llama_session_snapshot.hh"
+#include "llama_stop_matcher.hh"
+#include "thread_pool.hh"
 // #include <model_benchmarker.hh>
 
 struct llama_model;
@@ -12,6 +28,7 @@ struct llama_context;
 struct llama_context_params;
 
 using llama_token_callback = std::function<bool(const std::string &token_text)>;
+using llama_prefill_callback = std::function<bool(size_t n_past, size_t n_total)>;
 
 
 struct HegemonikonLlamaModelParams
@@ -20,11 +37,25 @@ struct HegemonikonLlamaModelParams
     int32_t n_ctx = 2048;
     int32_t n_gpu_layers = 0;
     int32_t main_gpu = 0;
-    int32_t n_batch = 1;
+    int32_t n_batch = 512;
+    int32_t n_ubatch = 512;
     bool tensor_split = false;
     bool vocab_only = false;
-    bool use_map = false;
+    bool use_map = true;
     bool use_mlock = false;
+    bool warmup = true;
+    int32_t n_seq_max = 4;
+    int32_t prefix_cache_slots = 2;
+    int32_t prefix_cache_max_tokens = 2048;
+    std::string draft_model_path;
+    int32_t draft_n_gpu_layers = 0;
+    std::string cache_type_k = "f16";
+    std::string cache_type_v = "f16";
+    bool embeddings = false;
+    std::string pooling_type;
+    std::string flash_attn = "auto";
+    int32_t n_threads = 0;
+    int32_t n_threads_batch = 0;
 
     HegemonikonLlamaModelParams() = default;
 
@@ -35,14 +66,15 @@ struct HegemonikonLlamaModelParams
      * @param ctx          Context size (number of tokens to keep in context), default is 2048.
      * @param gpu_layers   Number of layers to offload to GPU, default is 0 (CPU only).
      * @param main_gpu     Index of the main GPU to use, default is 0.
+     * @param n_batch      Logical batch size of the context (max tokens per llama_decode), default is 512.
      * @param split        Whether to split tensors across multiple GPUs, default is false.
      * @param only         Load only the vocabulary without model weights, default is false.
-     * @param map          Use memory-mapped file for model loading, default is false.
+     * @param map          Use memory-mapped file for model loading, default is true.
      * @param mlock        Lock model memory to prevent swapping, default is false.
      */
     HegemonikonLlamaModelParams(const std::string &path, int32_t ctx = 2048, int32_t gpu_layers = 0,
-                     int32_t main_gpu = 0, int32_t n_batch = 1, bool split = false, bool only = false,
-                     bool map = false, bool mlock = false)
+                     int32_t main_gpu = 0, int32_t n_batch = 512, bool split = false, bool only = false,
+                     bool map = true, bool mlock = false)
         : model_path(path), n_ctx(ctx), n_gpu_layers(gpu_layers), main_gpu(main_gpu),
           n_batch(n_batch), tensor_split(split), vocab_only(only), use_map(map), use_mlock(mlock) {}
 
@@ -80,7 +112,8 @@ struct HegemonikonLlamaModelParams
      * This method configures how many layers of the model should be processed on the GPU,
      * which can help optimize performance depending on the available hardware.
      *
-     * @param gpu_layers The number of layers to offload to the GPU.
+     * @param gpu_layers The number of layers to offload to the GPU, or -1 to let
+     *                   LlamaOffloadPlanner pick it from the free device memory at load time.
      * @return Reference to the current HegemonikonLlamaModelParams object for method chaining.
      */
     HegemonikonLlamaModelParams &set_n_gpu_layers(int32_t gpu_layers)
@@ -163,6 +196,192 @@ struct HegemonikonLlamaModelParams
         return *this;
     }
 
+    /**
+     * @brief Sets whether a one-token decode is run right after loading.
+     *
+     * The warm-up absorbs the lazy initialization of the compute backends (kernel
+     * compilation, buffer allocation, first page faults) so the first user request does
+     * not pay for it.
+     *
+     * @param enable Whether to warm the model up after loading.
+     * @return Reference to the current HegemonikonLlamaModelParams object for method chaining.
+     */
+    HegemonikonLlamaModelParams &set_warmup(bool enable)
+    {
+        warmup = enable;
+        return *this;
+    }
+
+    /**
+     * @brief Sets the logical batch size of the context.
+     *
+     * This is the maximum number of tokens submitted to a single llama_decode call,
+     * which bounds the size of each prefill chunk. It is clamped to n_ctx at load time.
+     *
+     * @param batch The logical batch size (at least 1).
+     * @return Reference to the current HegemonikonLlamaModelParams object for method chaining.
+     */
+    HegemonikonLlamaModelParams &set_n_batch(int32_t batch)
+    {
+        n_batch = batch;
+        return *this;
+    }
+
+    /**
+     * @brief Sets the physical batch size of the context.
+     *
+     * llama.cpp splits each logical batch into micro-batches of this size. It is also
+     * the prefill budget of a step that carries in-flight decodes. Clamped to n_batch.
+     *
+     * @param ubatch The physical batch size (at least 1).
+     * @return Reference to the current HegemonikonLlamaModelParams object for method chaining.
+     */
+    HegemonikonLlamaModelParams &set_n_ubatch(int32_t ubatch)
+    {
+        n_ubatch = ubatch;
+        return *this;
+    }
+
+    /**
+     * @brief Sets the maximum number of KV-cache sequences held by the context.
+     *
+     * Each chat session keeps its own sequence in the shared KV cache, so this
+     * bounds how many conversations can be resident before the least recently
+     * used one is evicted.
+     *
+     * @param seq_max The number of sequences (at least 1).
+     * @return Reference to the current HegemonikonLlamaModelParams object for method chaining.
+     */
+    HegemonikonLlamaModelParams &set_n_seq_max(int32_t seq_max)
+    {
+        n_seq_max = seq_max;
+        return *this;
+    }
+
+    /**
+     * @brief Sets how many shared prompt prefixes can be cached at once.
+     *
+     * Each cached prefix occupies one reserved KV-cache sequence on top of n_seq_max.
+     * Setting this to 0 disables the prefix cache.
+     *
+     * @param slots The number of reserved prefix sequences.
+     * @return Reference to the current HegemonikonLlamaModelParams object for method chaining.
+     */
+    HegemonikonLlamaModelParams &set_prefix_cache_slots(int32_t slots)
+    {
+        prefix_cache_slots = slots;
+        return *this;
+    }
+
+    /**
+     * @brief Sets the total number of tokens the prefix cache may keep in the KV cache.
+     *
+     * @param max_tokens The token budget shared by all cached prefixes.
+     * @return Reference to the current HegemonikonLlamaModelParams object for method chaining.
+     */
+    HegemonikonLlamaModelParams &set_prefix_cache_max_tokens(int32_t max_tokens)
+    {
+        prefix_cache_max_tokens = max_tokens;
+        return *this;
+    }
+
+    /**
+     * @brief Sets the draft model used for speculative decoding.
+     *
+     * The draft must be a small GGUF sharing the vocabulary of the main model. When set,
+     * it proposes tokens that the main model verifies in a single batched decode, which
+     * raises the decode rate without changing the sampled output distribution.
+     *
+     * @param path Path to the draft model, or an empty string to disable speculation.
+     * @return Reference to the current HegemonikonLlamaModelParams object for method chaining.
+     */
+    HegemonikonLlamaModelParams &set_draft_model_path(const std::string &path)
+    {
+        draft_model_path = path;
+        return *this;
+    }
+
+    /**
+     * @brief Sets the number of draft model layers offloaded to the GPU.
+     *
+     * @param gpu_layers The number of layers to offload (0 keeps the draft on the CPU).
+     * @return Reference to the current HegemonikonLlamaModelParams object for method chaining.
+     */
+    HegemonikonLlamaModelParams &set_draft_n_gpu_layers(int32_t gpu_layers)
+    {
+        draft_n_gpu_layers = gpu_layers;
+        return *this;
+    }
+
+    /**
+     * @brief Sets the data types of the KV cache.
+     *
+     * Quantized caches ("q8_0", "q5_1", "q5_0", "q4_1", "q4_0", "iq4_nl") halve to quarter
+     * the memory of the default "f16" cache, so a longer context fits in the same RAM or
+     * VRAM; "q8_0" is close to lossless. A quantized V cache requires flash attention,
+     * which is then enabled.
+     *
+     * @param type_k Type of the K cache ("f32", "f16", "bf16" or one of the quantized types).
+     * @param type_v Type of the V cache.
+     * @return Reference to the current HegemonikonLlamaModelParams object for method chaining.
+     */
+    HegemonikonLlamaModelParams &set_cache_types(const std::string &type_k, const std::string &type_v)
+    {
+        cache_type_k = type_k;
+        cache_type_v = type_v;
+        return *this;
+    }
+
+    /**
+     * @brief Loads the model as an embedding model instead of a generative one.
+     *
+     * The context then returns one pooled vector per sequence, which is what
+     * LlamaInterface::embed_batch packs many chunks into a single decode for. An
+     * embedding context cannot generate text, so it is meant for a dedicated GGUF
+     * (e.g. a BERT or nomic-embed model) loaded next to the chat model.
+     *
+     * @param enable  Whether to create an embedding context.
+     * @param pooling "mean", "cls" or "last", or an empty string for the pooling stored in the model.
+     * @return Reference to the current HegemonikonLlamaModelParams object for method chaining.
+     */
+    HegemonikonLlamaModelParams &set_embeddings(bool enable, const std::string &pooling = "")
+    {
+        embeddings = enable;
+        pooling_type = pooling;
+        return *this;
+    }
+
+    /**
+     * @brief Sets whether the context uses flash attention.
+     *
+     * @param mode "auto" (default) lets llama.cpp enable it where the backend supports it,
+     *             "on" forces it and "off" disables it; "off" cannot be combined with a
+     *             quantized V cache.
+     * @return Reference to the current HegemonikonLlamaModelParams object for method chaining.
+     */
+    HegemonikonLlamaModelParams &set_flash_attn(const std::string &mode)
+    {
+        flash_attn = mode;
+        return *this;
+    }
+
+    /**
+     * @brief Sets the default number of threads of the context.
+     *
+     * Requests can still raise the single-token thread count with
+     * HegemonikonGenerationParams::n_threads.
+     *
+     * @param threads       Threads of single-token decodes, 0 for half the logical CPUs.
+     * @param threads_batch Threads of prompt decodes, 0 for all the logical CPUs.
+     * @return Reference to the current HegemonikonLlamaModelParams object for method chaining.
+     */
+    HegemonikonLlamaModelParams &set_n_threads(int32_t threads, int32_t threads_batch = 0)
+    {
+        n_threads = threads;
+        n_threads_batch = threads_batch;
+        return *this;
+    }
+
     /**
      * @brief Equality operator for HegemonikonLlamaModelParams.
      *
@@ -180,10 +399,24 @@ struct HegemonikonLlamaModelParams
                n_gpu_layers == other.n_gpu_layers &&
                main_gpu == other.main_gpu &&
                n_batch == other.n_batch &&
+               n_ubatch == other.n_ubatch &&
                tensor_split == other.tensor_split &&
                vocab_only == other.vocab_only &&
                use_map == other.use_map &&
-               use_mlock == other.use_mlock;
+               use_mlock == other.use_mlock &&
+               warmup == other.warmup &&
+               n_seq_max == other.n_seq_max &&
+               prefix_cache_slots == other.prefix_cache_slots &&
+               prefix_cache_max_tokens == other.prefix_cache_max_tokens &&
+               draft_model_path == other.draft_model_path &&
+               draft_n_gpu_layers == other.draft_n_gpu_layers &&
+               cache_type_k == other.cache_type_k &&
+               cache_type_v == other.cache_type_v &&
+               embeddings == other.embeddings &&
+               pooling_type == other.pooling_type &&
+               flash_attn == other.flash_attn &&
+               n_threads == other.n_threads &&
+               n_threads_batch == other.n_threads_batch;
     }
 
     /**
@@ -216,10 +449,24 @@ struct HegemonikonLlamaModelParams
                std::hash<int32_t>()(n_gpu_layers) ^
                std::hash<int32_t>()(main_gpu) ^
                std::hash<int32_t>()(n_batch) ^
+               std::hash<int32_t>()(n_ubatch) ^
                std::hash<bool>()(tensor_split) ^
                std::hash<bool>()(vocab_only) ^
                std::hash<bool>()(use_map) ^
-               std::hash<bool>()(use_mlock);
+               std::hash<bool>()(use_mlock) ^
+               (std::hash<bool>()(warmup) << 1) ^
+               std::hash<int32_t>()(n_seq_max) ^
+               std::hash<int32_t>()(prefix_cache_slots) ^
+               std::hash<int32_t>()(prefix_cache_max_tokens) ^
+               std::hash<std::string>()(draft_model_path) ^
+               std::hash<int32_t>()(draft_n_gpu_layers) ^
+               std::hash<std::string>()(cache_type_k) ^
+               (std::hash<std::string>()(cache_type_v) << 1) ^
+               (std::hash<bool>()(embeddings) << 2) ^
+               (std::hash<std::string>()(pooling_type) << 3) ^
+               (std::hash<std::string>()(flash_attn) << 4) ^
+               (std::hash<int32_t>()(n_threads) << 5) ^
+               (std::hash<int32_t>()(n_threads_batch) << 6);
     }
 
     /**
@@ -237,13 +484,55 @@ struct HegemonikonLlamaModelParams
                ", n_gpu_layers=" + std::to_string(n_gpu_layers) +
                ", main_gpu=" + std::to_string(main_gpu) +
                ", n_batch=" + std::to_string(n_batch) +
+               ", n_ubatch=" + std::to_string(n_ubatch) +
                ", tensor_split=" + (tensor_split ? "true" : "false") +
                ", vocab_only=" + (vocab_only ? "true" : "false") +
                ", use_map=" + (use_map ? "true" : "false") +
-               ", use_mlock=" + (use_mlock ? "true" : "false") + ")";
+               ", use_mlock=" + (use_mlock ? "true" : "false") +
+               ", warmup=" + (warmup ? "true" : "false") +
+               ", n_seq_max=" + std::to_string(n_seq_max) +
+               ", prefix_cache_slots=" + std::to_string(prefix_cache_slots) +
+               ", prefix_cache_max_tokens=" + std::to_string(prefix_cache_max_tokens) +
+               ", draft_model_path='" + draft_model_path +
+               "', draft_n_gpu_layers=" + std::to_string(draft_n_gpu_layers) +
+               ", cache_type_k='" + cache_type_k +
+               "', cache_type_v='" + cache_type_v +
+               "', embeddings=" + (embeddings ? "true" : "false") +
+               ", pooling_type='" + pooling_type +
+               "', flash_attn='" + flash_attn +
+               "', n_threads=" + std::to_string(n_threads) +
+               ", n_threads_batch=" + std::to_string(n_threads_batch) + ")";
     }
 };
 
+/**
+ * @brief Scheduling class of a generation request, highest priority first.
+ *
+ * LlamaBatchScheduler admits queued requests class by class. Interactive requests hold
+ * background sequences back and, when no KV-cache sequence is free, preempt them.
+ */
+enum class LlamaRequestPriority
+{
+    Interactive = 0,
+    Batch = 1,
+    Background = 2
+};
+
+constexpr size_t LLAMA_REQUEST_PRIORITY_COUNT = 3;
+
+inline const char *priority_name(LlamaRequestPriority priority)
+{
+    switch (priority)
+    {
+    case LlamaRequestPriority::Batch:
+        return "batch";
+    case LlamaRequestPriority::Background:
+        return "background";
+    default:
+        return "interactive";
+    }
+}
+
 struct HegemonikonGenerationParams
 {
     int32_t n_predict = 128;
@@ -255,10 +544,20 @@ struct HegemonikonGenerationParams
     float penalty_freq = 0.0f;
     float penalty_present = 0.0f;
     std::vector<std::string> stop_sequences;
-    int32_t n_batch = 1024;
+    int32_t n_batch = 512;
     int32_t n_threads = 0;
     bool add_bos = true;
     bool parse_special = false;
+    std::string session_id;
+    int32_t n_draft = 4;
+    int32_t timeout_ms = 0;
+    bool context_shift = false;
+    int32_t n_keep = 0;
+    LlamaRequestPriority priority = LlamaRequestPriority::Interactive;
+    bool prompt_lookup = false;
+    int32_t n_lookup_draft = 8;
+    int32_t lookup_ngram_min = 2;
+    int32_t lookup_ngram_max = 4;
 
     HegemonikonGenerationParams() = default;
 
@@ -271,13 +570,13 @@ struct HegemonikonGenerationParams
      * @param top_p           Nucleus sampling probability threshold (default: 0.95f).
      * @param repeat_penalty  Penalty for repeated tokens to reduce repetition (default: 1.1f).
      * @param stop_seqs       List of stop sequences to terminate generation early (default: empty).
-     * @param batch_size      Number of tokens to process in a batch (default: 512).
+     * @param batch_size      Maximum prompt tokens prefilled per decode step, 0 for the context n_batch (default: 512).
      * @param threads         Number of threads to use for generation (default: 0, meaning auto-detect).
      */
     HegemonikonGenerationParams(int32_t predict, float temperature = 0.8f, int32_t top_k = 40,
                      float top_p = 0.95f, float repeat_penalty = 1.1f, int32_t penalty_last_n = 64,
                      float penalty_freq = 0.0f, float penalty_present = 0.0f,
-                     std::vector<std::string> stop_seqs = {}, int32_t batch_size = 1024,
+                     std::vector<std::string> stop_seqs = {}, int32_t batch_size = 512,
                      int32_t threads = 0)
         : n_predict(predict), temperature(temperature), top_k(top_k), top_p(top_p),
           repeat_penalty(repeat_penalty), penalty_last_n(penalty_last_n),
@@ -309,7 +608,17 @@ struct HegemonikonGenerationParams
                penalty_present == other.penalty_present &&
                stop_sequences == other.stop_sequences &&
                n_batch == other.n_batch &&
-               n_threads == other.n_threads;
+               n_threads == other.n_threads &&
+               session_id == other.session_id &&
+               n_draft == other.n_draft &&
+               timeout_ms == other.timeout_ms &&
+               context_shift == other.context_shift &&
+               n_keep == other.n_keep &&
+               priority == other.priority &&
+               prompt_lookup == other.prompt_lookup &&
+               n_lookup_draft == other.n_lookup_draft &&
+               lookup_ngram_min == other.lookup_ngram_min &&
+               lookup_ngram_max == other.lookup_ngram_max;
     }
 
     /**
@@ -346,7 +655,17 @@ struct HegemonikonGenerationParams
                         std::hash<float>()(penalty_freq) ^
                         std::hash<float>()(penalty_present) ^
                         std::hash<int32_t>()(n_batch) ^
-                        std::hash<int32_t>()(n_threads);
+                        std::hash<int32_t>()(n_threads) ^
+                        std::hash<std::string>()(session_id) ^
+                        std::hash<int32_t>()(n_draft) ^
+                        std::hash<int32_t>()(timeout_ms) ^
+                        std::hash<bool>()(context_shift) ^
+                        (std::hash<int32_t>()(n_keep) << 1) ^
+                        (std::hash<int32_t>()(static_cast<int32_t>(priority)) << 2) ^
+                        (std::hash<bool>()(prompt_lookup) << 3) ^
+                        (std::hash<int32_t>()(n_lookup_draft) << 4) ^
+                        (std::hash<int32_t>()(lookup_ngram_min) << 5) ^
+                        (std::hash<int32_t>()(lookup_ngram_max) << 6);
         for (const auto &s : stop_sequences)
             h ^= std::hash<std::string>()(s);
         return h;
@@ -380,7 +699,17 @@ struct HegemonikonGenerationParams
                 seqs.pop_back(), seqs.pop_back(); // remove trailing comma and space
             return seqs;
         }() + "], n_batch=" +
-               std::to_string(n_batch) + ", n_threads=" + std::to_string(n_threads) + ")";
+               std::to_string(n_batch) + ", n_threads=" + std::to_string(n_threads) +
+               ", session_id='" + session_id +
+               "', n_draft=" + std::to_string(n_draft) +
+               ", timeout_ms=" + std::to_string(timeout_ms) +
+               ", context_shift=" + (context_shift ? "true" : "false") +
+               ", n_keep=" + std::to_string(n_keep) +
+               ", priority=" + priority_name(priority) +
+               ", prompt_lookup=" + (prompt_lookup ? "true" : "false") +
+               ", n_lookup_draft=" + std::to_string(n_lookup_draft) +
+               ", lookup_ngram_min=" + std::to_string(lookup_ngram_min) +
+               ", lookup_ngram_max=" + std::to_string(lookup_ngram_max) + ")";
     }
 
     // #ifndef NO_PYBIND
@@ -479,12 +808,13 @@ struct HegemonikonGenerationParams
     }
 
     /**
-     * @brief Sets the batch size for generation.
+     * @brief Sets the prefill chunk size for generation.
      *
-     * This method updates the n_batch parameter with the specified batch size.
-     * It enables method chaining by returning a reference to the current HegemonikonGenerationParams object.
+     * Long prompts are prefilled in chunks of at most this many tokens, one chunk per
+     * decode step, so other sequences can be decoded in between. The chunk is further
+     * capped by the context n_batch; 0 uses the context n_batch.
      *
-     * @param batch_size The desired batch size for generation.
+     * @param batch_size The desired chunk size for prefill.
      * @return Reference to the updated HegemonikonGenerationParams object.
      */
     HegemonikonGenerationParams &set_n_batch(int32_t batch_size)
@@ -507,6 +837,280 @@ struct HegemonikonGenerationParams
         n_threads = threads;
         return *this;
     }
+
+    /**
+     * @brief Sets the conversation session used for KV-cache reuse.
+     *
+     * Requests sharing a session id keep their KV cache between calls, so only
+     * the part of the prompt that differs from the previous turn is prefilled.
+     * An empty id runs the request statelessly.
+     *
+     * @param id The session identifier.
+     * @return Reference to the current HegemonikonGenerationParams object for method chaining.
+     */
+    HegemonikonGenerationParams &set_session_id(const std::string &id)
+    {
+        session_id = id;
+        return *this;
+    }
+
+    /**
+     * @brief Sets how many tokens the draft model proposes per speculative step.
+     *
+     * Only used when a draft model is loaded. Larger values pay off when the draft
+     * agrees often with the main model; 0 disables speculation for this request.
+     *
+     * @param draft The maximum number of drafted tokens per step.
+     * @return Reference to the current HegemonikonGenerationParams object for method chaining.
+     */
+    HegemonikonGenerationParams &set_n_draft(int32_t draft)
+    {
+        n_draft = draft;
+        return *this;
+    }
+
+    /**
+     * @brief Sets a wall-clock budget for the request.
+     *
+     * The generation stops at the first decode step past the deadline, returning what
+     * has been generated so far. Counted from the moment the request starts.
+     *
+     * @param timeout The budget in milliseconds, 0 for no limit.
+     * @return Reference to the current HegemonikonGenerationParams object for method chaining.
+     */
+    HegemonikonGenerationParams &set_timeout_ms(int32_t timeout)
+    {
+        timeout_ms = timeout;
+        return *this;
+    }
+
+    /**
+     * @brief Enables the sliding context window for this request.
+     *
+     * Instead of failing on a prompt longer than the context, or stopping when the
+     * context fills up during generation, the first `keep` tokens (typically the system
+     * prompt) are kept and the oldest tokens after them are discarded, half of the
+     * remaining window at a time. The positions of the tokens that follow are shifted
+     * down in the KV cache, so nothing is prefilled again.
+     *
+     * @param enable Whether to shift the context instead of stopping.
+     * @param keep   Number of leading tokens never discarded; the BOS token is always kept.
+     * @return Reference to the current HegemonikonGenerationParams object for method chaining.
+     */
+    HegemonikonGenerationParams &set_context_shift(bool enable, int32_t keep = 0)
+    {
+        context_shift = enable;
+        n_keep = keep;
+        return *this;
+    }
+
+    /**
+     * @brief Sets the scheduling class of the request on the batching scheduler.
+     *
+     * Background work (summaries, RAG indexing) should not delay what the user is
+     * waiting for: its sequences are held while interactive requests decode and are
+     * parked to host memory when an interactive request needs their KV-cache sequence.
+     *
+     * @param request_priority The scheduling class.
+     * @return Reference to the current HegemonikonGenerationParams object for method chaining.
+     */
+    HegemonikonGenerationParams &set_priority(LlamaRequestPriority request_priority)
+    {
+        priority = request_priority;
+        return *this;
+    }
+
+    /**
+     * @brief Enables prompt-lookup decoding for this request.
+     *
+     * When the last `ngram_min` to `ngram_max` tokens appeared earlier in the context
+     * (the prompt, typically a retrieved passage, or the output so far), the tokens that
+     * followed them are proposed as a draft and verified by the model in one decode, as
+     * with a draft model but without one. Pays off when the answer copies long spans of
+     * the prompt (RAG, summaries, code edits). Only used while the request decodes alone;
+     * tried before the draft model when both are available.
+     *
+     * @param enable     Whether to look up drafts in the context.
+     * @param draft      Maximum number of tokens proposed per step.
+     * @param ngram_min  Shortest run of tokens that must match.
+     * @param ngram_max  Longest run of tokens matched, tried first.
+     * @return Reference to the current HegemonikonGenerationParams object for method chaining.
+     */
+    HegemonikonGenerationParams &set_prompt_lookup(bool enable, int32_t draft = 8, int32_t ngram_min = 2,
+                                                   int32_t ngram_max = 4)
+    {
+        prompt_lookup = enable;
+        n_lookup_draft = draft;
+        lookup_ngram_min = ngram_min;
+        lookup_ngram_max = ngram_max;
+        return *this;
+    }
+};
+
+/**
+ * @brief Outcome of a single generation request.
+ */
+struct HegemonikonGenerationResult
+{
+    std::string text;
+    bool success = false;
+    int32_t tokens_generated = 0;
+    int32_t prompt_tokens = 0;
+    int32_t reused_tokens = 0;
+    double ttft_ms = 0.0;
+    double decode_duration_ms = 0.0;
+    int32_t draft_tokens = 0;
+    int32_t accepted_draft_tokens = 0;
+    int32_t lookup_draft_tokens = 0;
+    int32_t accepted_lookup_tokens = 0;
+    int32_t discarded_tokens = 0;
+    std::string finish_reason;
+
+    std::string to_string() const
+    {
+        return "HegemonikonGenerationResult(success=" + std::string(success ? "true" : "false") +
+               ", finish_reason='" + finish_reason + "'" +
+               ", tokens_generated=" + std::to_string(tokens_generated) +
+               ", prompt_tokens=" + std::to_string(prompt_tokens) +
+               ", reused_tokens=" + std::to_string(reused_tokens) +
+               ", ttft_ms=" + std::to_string(ttft_ms) +
+               ", decode_duration_ms=" + std::to_string(decode_duration_ms) +
+               ", draft_tokens=" + std::to_string(draft_tokens) +
+               ", accepted_draft_tokens=" + std::to_string(accepted_draft_tokens) +
+               ", lookup_draft_tokens=" + std::to_string(lookup_draft_tokens) +
+               ", accepted_lookup_tokens=" + std::to_string(accepted_lookup_tokens) +
+               ", discarded_tokens=" + std::to_string(discarded_tokens) + ")";
+    }
+};
+
+/**
+ * @brief Cumulative counters of speculative decoding with a draft model.
+ */
+struct HegemonikonSpeculativeStats
+{
+    uint64_t verify_steps = 0;
+    uint64_t drafted_tokens = 0;
+    uint64_t accepted_tokens = 0;
+
+    /**
+     * @brief Fraction of drafted tokens accepted by the main model.
+     */
+    double acceptance_rate() const
+    {
+        return drafted_tokens > 0 ? static_cast<double>(accepted_tokens) / drafted_tokens : 0.0;
+    }
+
+    /**
+     * @brief Average number of drafted tokens accepted per verification step.
+     */
+    double avg_accepted_length() const
+    {
+        return verify_steps > 0 ? static_cast<double>(accepted_tokens) / verify_steps : 0.0;
+    }
+
+    std::string to_string() const
+    {
+        return "HegemonikonSpeculativeStats(verify_steps=" + std::to_string(verify_steps) +
+               ", drafted_tokens=" + std::to_string(drafted_tokens) +
+               ", accepted_tokens=" + std::to_string(accepted_tokens) +
+               ", acceptance_rate=" + std::to_string(acceptance_rate()) + ")";
+    }
+};
+
+/**
+ * @brief Host and device memory held by a loaded model, weights and KV cache included.
+ */
+struct HegemonikonModelFootprint
+{
+    uint64_t ram_bytes = 0;
+    uint64_t vram_bytes = 0;
+
+    uint64_t total_bytes() const { return ram_bytes + vram_bytes; }
+
+    std::string to_string() const
+    {
+        return "HegemonikonModelFootprint(ram_bytes=" + std::to_string(ram_bytes) +
+               ", vram_bytes=" + std::to_string(vram_bytes) + ")";
+    }
+};
+
+/**
+ * @brief Tokens of several texts packed into one flat array.
+ *
+ * The tokens of text `i` are `tokens[offsets[i] .. offsets[i + 1])`, so `offsets` has one
+ * more entry than there are texts. A text that failed to tokenize has an empty range.
+ */
+struct HegemonikonTokenBatch
+{
+    std::vector<int32_t> tokens;
+    std::vector<int64_t> offsets;
+
+    size_t size() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+};
+
+/**
+ * @brief Embeddings of several texts as one row-major float matrix.
+ *
+ * Row `i` is `data[i * n_embd .. (i + 1) * n_embd)`. Texts longer than the batch of the
+ * embedding context are truncated; `n_truncated` counts them. A text that could not be
+ * embedded leaves a zero row and is reported in `n_failed`.
+ */
+struct HegemonikonEmbeddingBatch
+{
+    std::vector<float> data;
+    int32_t n_embd = 0;
+    int32_t n_truncated = 0;
+    int32_t n_failed = 0;
+
+    size_t size() const { return n_embd > 0 ? data.size() / static_cast<size_t>(n_embd) : 0; }
+};
+
+/**
+ * @brief State of one in-flight generation bound to a KV-cache sequence.
+ *
+ * Created by LlamaInterface::start_sequence and advanced by LlamaInterface::decode_step,
+ * which lets several sequences share each llama_decode call. A sequence first prefills
+ * its prompt (possibly over several steps), then decodes one token per step until it
+ * is finished. When `on_piece` is set it receives every generated piece as soon as it is
+ * sampled, minus any text held back as a potential stop-sequence prefix; returning
+ * false from it ends the generation. `on_prefill` is called after each
+ * prefill chunk with the progress through the prompt; returning false cancels the request.
+ * An optional `handle` lets the owner cancel the request or bound it in time from any thread.
+ * A parked sequence (see LlamaInterface::park_sequence) holds its KV state in `parked_state`
+ * instead of a KV-cache sequence and must be resumed before taking part in a decode step.
+ */
+struct LlamaGenerationSequence
+{
+    HegemonikonGenerationParams params;
+    llama_token_callback on_piece;
+    llama_prefill_callback on_prefill;
+    std::shared_ptr<LlamaRequestHandle> handle;
+    std::string slot_key;
+    bool stateless = true;
+    bool fresh = false;
+
+    std::vector<llama_token> prompt_tokens;
+    size_t n_past = 0;
+    llama_seq_id seq_id = -1;
+    llama_sampler *sampler = nullptr;
+    llama_token pending_token = LLAMA_TOKEN_NULL;
+    int32_t logits_index = -1;
+    LlamaStopMatcher stop_matcher;
+    LlamaUtf8Accumulator utf8;
+    LlamaNgramLookup lookup;
+
+    HegemonikonGenerationResult result;
+    std::chrono::high_resolution_clock::time_point start_time;
+    MetricsRegistry::clock::time_point last_token_time;
+    double tokenize_duration_ms = 0.0;
+    bool finished = false;
+    bool released = false;
+
+    bool parked = false;
+    std::vector<uint8_t> parked_state;
+    std::vector<llama_token> parked_tokens;
+
+    bool is_prefilling() const { return n_past < prompt_tokens.size(); }
 };
 
 class LlamaContextWrapper
@@ -551,18 +1155,23 @@ public:
     LlamaInterface();
     LlamaInterface(LlamaInterface &&other) noexcept;
     LlamaInterface &operator=(LlamaInterface &&other) noexcept;
-    ~LlamaInterface();
+    virtual ~LlamaInterface();
 
     virtual bool load_model(const HegemonikonLlamaModelParams &params);
+    bool share_model(const LlamaInterface &source, int32_t n_ctx = 0);
     virtual void unload_model();
     bool is_model_loaded() const;
-    llama_sampler *create_sampler(const HegemonikonGenerationParams &params);
+    static llama_sampler *create_sampler(const HegemonikonGenerationParams &params);
     bool check_stop_sequences(const std::string &text, const std::vector<std::string> &stop_sequences);
     int get_context_size() const;
     int get_vocab_size() const;
     std::string get_model_info() const;
     std::vector<int32_t> tokenization(const std::string &text) const;
     std::string detokenization(const std::vector<int32_t> &tokens) const;
+    HegemonikonTokenBatch tokenize_batch(const std::vector<std::string_view> &texts, ThreadPool *pool,
+                                         bool add_bos = true, bool special = false) const;
+    std::vector<int32_t> count_tokens_batch(const std::vector<std::string_view> &texts, ThreadPool *pool,
+                                            bool add_bos = true, bool special = false) const;
     virtual std::string generate_completion(const std::string &prompt_text, const HegemonikonGenerationParams &params, double &ttft_ms,
         double &decode_duration_ms,
         int32_t &tokens_generated);
@@ -570,17 +1179,105 @@ public:
                                                const HegemonikonGenerationParams &params,
                                                llama_token_callback callback);
     std::vector<float> get_embeddings(const std::string &text);
+    HegemonikonEmbeddingBatch embed_batch(const std::vector<std::string_view> &texts, bool normalize = true,
+                                          ThreadPool *pool = nullptr);
+    int32_t get_embedding_size() const;
+
+    virtual HegemonikonGenerationResult run_generation(const std::string &prompt_text,
+                                                       const HegemonikonGenerationParams &params,
+                                                       llama_token_callback on_piece = nullptr,
+                                                       std::shared_ptr<LlamaRequestHandle> handle = nullptr);
+
+    std::unique_ptr<LlamaGenerationSequence> start_sequence(const std::string &prompt_text,
+                                                            const HegemonikonGenerationParams &params,
+                                                            llama_token_callback on_piece = nullptr,
+                                                            std::shared_ptr<LlamaRequestHandle> handle = nullptr);
+    int32_t decode_step(const std::vector<LlamaGenerationSequence *> &sequences);
+    void finish_sequence(LlamaGenerationSequence &sequence);
+    bool park_sequence(LlamaGenerationSequence &sequence);
+    bool resume_sequence(LlamaGenerationSequence &sequence);
+    bool poll_interrupt(LlamaGenerationSequence &sequence);
+    uint32_t get_max_sequences() const;
 
+    bool reset_session(const std::string &session_id);
+    void clear_sessions();
+    size_t get_session_count() const;
+    bool has_session(const std::string &session_id) const;
+    bool save_session_snapshot(const std::string &session_id, const std::string &directory,
+                               const SecureKey *key = nullptr);
+    int32_t restore_session_snapshot(const std::string &prompt_text, const HegemonikonGenerationParams &params,
+                                     const std::string &directory, const SecureKey *key = nullptr);
+    virtual int32_t prefill_session(const std::string &prompt_text, const HegemonikonGenerationParams &params,
+                                    size_t n_hold_back = 0);
+    uint64_t get_model_fingerprint() const;
+    HegemonikonPrefixCacheStats get_prefix_cache_stats() const;
+    void clear_prefix_cache();
+    bool has_draft_model() const;
+    HegemonikonSpeculativeStats get_speculative_stats() const;
+    void reset_speculative_stats();
+
+    virtual HegemonikonModelFootprint get_memory_footprint() const;
+    void set_load_status(std::shared_ptr<LlamaLoadStatus> status);
+    void set_compute_pool(std::shared_ptr<ComputePool> pool);
+    std::shared_ptr<ComputePool> get_compute_pool() const;
+    void set_metrics(std::shared_ptr<MetricsRegistry> metrics);
+    std::shared_ptr<MetricsRegistry> get_metrics() const;
+    static HegemonikonModelFootprint estimate_memory_footprint(const HegemonikonLlamaModelParams &params);
+    static bool parse_cache_type(const std::string &name, ggml_type &type);
+    static bool parse_pooling_type(const std::string &name, enum llama_pooling_type &type);
+    static bool parse_flash_attn_type(const std::string &name, enum llama_flash_attn_type &type);
+    static double cache_type_bytes(const std::string &name);
 
     static void init_backend();
     static void free_backend();
 
 private:
+    /**
+     * @brief A KV-cache sequence together with the tokens it currently holds.
+     *
+     * `tokens` mirrors exactly what has been decoded into the sequence, which is
+     * what lets a new prompt be diffed against the cache. `draft_tokens` does the
+     * same for the sequence of the same id in the draft context. The first `n_shared`
+     * positions may be held by KV cells shared with other sequences through the
+     * prefix cache.
+     */
+    struct LlamaSequenceSlot
+    {
+        llama_seq_id seq_id = -1;
+        std::vector<llama_token> tokens;
+        std::vector<llama_token> draft_tokens;
+        size_t n_shared = 0;
+        uint64_t last_used = 0;
+        bool busy = false;
+    };
+
     llama_model *model_ = nullptr;
+    std::shared_ptr<llama_model> shared_model_;
     llama_context *ctx_ = nullptr;
     const llama_vocab *vocab_ = nullptr;
 
+    llama_model *draft_model_ = nullptr;
+    llama_context *draft_ctx_ = nullptr;
+    llama_sampler *draft_sampler_ = nullptr;
+    HegemonikonSpeculativeStats speculative_stats_;
+    std::vector<LlamaGenerationSequence *> abort_watch_;
+
     HegemonikonLlamaModelParams current_model_params_;
+    std::shared_ptr<LlamaLoadStatus> load_status_;
+
+    std::shared_ptr<ComputePool> compute_pool_;
+    std::shared_ptr<ggml_threadpool> attached_threadpool_;
+    std::shared_ptr<MetricsRegistry> metrics_;
+    int32_t default_n_threads_ = 1;
+    int32_t default_n_threads_batch_ = 1;
+
+    std::unordered_map<std::string, LlamaSequenceSlot> sessions_;
+    std::vector<llama_seq_id> free_seq_ids_;
+    uint64_t session_clock_ = 0;
+    uint64_t stateless_counter_ = 0;
+    LlamaPrefixCache prefix_cache_;
+    std::unique_ptr<LlamaPieceTable> piece_table_;
+    mutable std::mutex context_mutex_;
 
     static constexpr double FAST_TTFT_MS = 200.0;
     static constexpr double ACCEPTABLE_TTFT_MS = 500.0;
@@ -588,8 +1285,39 @@ private:
     static constexpr double GOOD_TOKENS_PER_SEC = 15.0;
 
     std::vector<int32_t> tokenize(const std::string &text, bool add_bos, bool special) const;
+    int32_t tokenize_into(std::string_view text, bool add_bos, bool special, std::vector<llama_token> &out) const;
     std::string detokenize_token(int32_t token) const;
     std::string detokenize_sequence(const std::vector<int32_t> &tokens) const;
 
     llama_sampler *create_default_sampler(const HegemonikonGenerationParams &params);
+
+    void reset_sequence_pool();
+    LlamaSequenceSlot *acquire_sequence(const std::string &key, bool stateless);
+    void release_sequence(const std::string &key);
+    bool evict_lru_session();
+    void cache_prompt_prefix(LlamaSequenceSlot &slot);
+    void finish_sequence_locked(LlamaGenerationSequence &sequence);
+    bool sample_sequence(LlamaGenerationSequence &sequence);
+    bool accept_token(LlamaGenerationSequence &sequence, llama_token token);
+    bool interrupt_if_requested(LlamaGenerationSequence &sequence);
+    ComputeLease acquire_compute_locked(const std::vector<LlamaGenerationSequence *> &sequences);
+    static bool abort_callback(void *data);
+    bool load_draft_model(const llama_context_params &ctx_p);
+    void unload_draft_model();
+    void unload_model_locked();
+    bool create_context(llama_context_params &ctx_p);
+    void warm_up();
+    static bool load_progress_callback(float progress, void *data);
+    static void prefetch_model_file(const std::string &path);
+    bool sync_draft(LlamaSequenceSlot &slot, llama_token next_token);
+    size_t shift_context(LlamaSequenceSlot &slot, int32_t n_keep);
+    size_t keep_length(int32_t n_keep) const;
+    int32_t draft_limit(const LlamaGenerationSequence &sequence, const LlamaSequenceSlot &slot, int32_t n_max) const;
+    int32_t verify_drafts(LlamaGenerationSequence &sequence, LlamaSequenceSlot &slot,
+                          const std::vector<llama_token> &drafted, int32_t &n_accepted, bool &active);
+    int32_t speculative_step(LlamaGenerationSequence &sequence);
+    int32_t lookup_step(LlamaGenerationSequence &sequence);
+    void decode_embeddings_locked(llama_batch &batch, const HegemonikonTokenBatch &tokens,
+                                  const std::vector<std::pair<size_t, int32_t>> &rows, bool normalize,
+                                  HegemonikonEmbeddingBatch &out);
 };
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "llama_interface.hh"
+
+class CoreAIService;
+
+/**
+ * @brief Simulated users of a load benchmark.
+ *
+ * Each client sends `requests_per_client` requests. With `arrival_rate` 0 the clients are
+ * closed-loop: a client sends its next request as soon as the previous one completed.
+ * Otherwise requests arrive as a Poisson process of `arrival_rate` requests per second per
+ * client, whether or not the previous ones completed. Prompt and output lengths are drawn
+ * uniformly from their ranges; prompts are built from `prompts` (a default corpus when
+ * empty) up to the drawn number of tokens, and `n_predict` is set to the drawn output length.
+ */
+struct HegemonikonLoadProfile
+{
+    std::vector<int32_t> concurrency_levels = {1, 2, 4, 8};
+    int32_t requests_per_client = 4;
+    double arrival_rate = 0.0;
+    int32_t min_prompt_tokens = 32;
+    int32_t max_prompt_tokens = 256;
+    int32_t min_output_tokens = 32;
+    int32_t max_output_tokens = 128;
+    bool use_scheduler = true;
+    uint32_t seed = 42;
+    HegemonikonGenerationParams generation_params;
+    std::vector<std::string> prompts;
+
+    std::string to_string() const
+    {
+        std::string levels;
+        for (size_t i = 0; i < concurrency_levels.size(); ++i)
+        {
+            levels += (i > 0 ? "," : "") + std::to_string(concurrency_levels[i]);
+        }
+        return "HegemonikonLoadProfile(concurrency_levels=[" + levels + "]" +
+               ", requests_per_client=" + std::to_string(requests_per_client) +
+               ", arrival_rate=" + std::to_string(arrival_rate) +
+               ", prompt_tokens=" + std::to_string(min_prompt_tokens) + "-" + std::to_string(max_prompt_tokens) +
+               ", output_tokens=" + std::to_string(min_output_tokens) + "-" + std::to_string(max_output_tokens) +
+               ", use_scheduler=" + (use_scheduler ? "true" : "false") +
+               ", seed=" + std::to_string(seed) + ")";
+    }
+};
+
+/**
+ * @brief Latency percentiles of one quantity, in milliseconds.
+ */
+struct HegemonikonLatencyPercentiles
+{
+    uint64_t count = 0;
+    double mean_ms = 0.0;
+    double p50_ms = 0.0;
+    double p95_ms = 0.0;
+    double p99_ms = 0.0;
+    double max_ms = 0.0;
+
+    static HegemonikonLatencyPercentiles from_samples(std::vector<double> samples_ms);
+
+    std::string to_string() const
+    {
+        return "HegemonikonLatencyPercentiles(count=" + std::to_string(count) +
+               ", mean_ms=" + std::to_string(mean_ms) +
+               ", p50_ms=" + std::to_string(p50_ms) +
+               ", p95_ms=" + std::to_string(p95_ms) +
+               ", p99_ms=" + std::to_string(p99_ms) +
+               ", max_ms=" + std::to_string(max_ms) + ")";
+    }
+};
+
+/**
+ * @brief Throughput and latencies measured at one concurrency level.
+ *
+ * Inter-token latencies are the gaps between the pieces streamed to a client, so a
+ * piece that completes a multi-byte character counts once. Memory is the resident set
+ * of the process, sampled during the level.
+ */
+struct HegemonikonLoadLevelResult
+{
+    int32_t concurrency = 0;
+    uint64_t requests = 0;
+    uint64_t failed_requests = 0;
+    uint64_t prompt_tokens = 0;
+    uint64_t generated_tokens = 0;
+    double duration_s = 0.0;
+    double tokens_per_second = 0.0;
+    double requests_per_second = 0.0;
+    HegemonikonLatencyPercentiles ttft;
+    HegemonikonLatencyPercentiles inter_token;
+    HegemonikonLatencyPercentiles end_to_end;
+    double start_memory_mb = 0.0;
+    double peak_memory_mb = 0.0;
+
+    std::string to_string() const
+    {
+        return "HegemonikonLoadLevelResult(concurrency=" + std::to_string(concurrency) +
+               ", requests=" + std::to_string(requests) +
+               ", failed_requests=" + std::to_string(failed_requests) +
+               ", tokens_per_second=" + std::to_string(tokens_per_second) +
+               ", requests_per_second=" + std::to_string(requests_per_second) +
+               ", ttft_p50_ms=" + std::to_string(ttft.p50_ms) +
+               ", ttft_p99_ms=" + std::to_string(ttft.p99_ms) +
+               ", inter_token_p50_ms=" + std::to_string(inter_token.p50_ms) +
+               ", inter_token_p99_ms=" + std::to_string(inter_token.p99_ms) +
+               ", peak_memory_mb=" + std::to_string(peak_memory_mb) + ")";
+    }
+};
+
+struct HegemonikonLoadBenchmarkResult
+{
+    bool success = false;
+    std::string errorMessage;
+    std::vector<HegemonikonLoadLevelResult> levels;
+
+    std::string to_csv() const;
+};
+
+/**
+ * @brief Drives simulated concurrent clients against a CoreAIService.
+ *
+ * The service must have a chat model loaded. Requests go through submit_prompt (the
+ * batching scheduler) or, with `use_scheduler` false, through stream_prompt on the
+ * client threads (the context pool when configured). Levels run one after the other;
+ * the prompts of a level are prepared before it starts so tokenization is not measured.
+ */
+class LlamaLoadBenchmarker
+{
+public:
+    explicit LlamaLoadBenchmarker(CoreAIService &service);
+
+    HegemonikonLoadBenchmarkResult run(const HegemonikonLoadProfile &profile);
+
+    void request_cancellation();
+
+private:
+    struct Request
+    {
+        std::string prompt;
+        HegemonikonGenerationParams params;
+        int32_t prompt_tokens = 0;
+        double arrival_s = 0.0;
+    };
+
+    struct Sample
+    {
+        bool success = false;
+        int32_t prompt_tokens = 0;
+        int32_t generated_tokens = 0;
+        int32_t n_pieces = 0;
+        double ttft_ms = 0.0;
+        double end_to_end_ms = 0.0;
+        std::vector<double> inter_token_ms;
+    };
+
+    CoreAIService &service_;
+    std::atomic<bool> cancellation_requested_{false};
+
+    std::string make_prompt(const std::vector<std::string> &corpus, size_t offset, int32_t n_tokens);
+    HegemonikonLoadLevelResult run_level(const HegemonikonLoadProfile &profile, int32_t concurrency,
+                                         const std::vector<std::vector<Request>> &clients);
+    Sample run_request(const Request &request, bool use_scheduler);
+};
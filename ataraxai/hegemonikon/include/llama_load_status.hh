@@ -0,0 +1,135 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+
+/**
+ * @brief Phase of an asynchronous model load.
+ */
+enum class LlamaLoadState
+{
+    Pending,
+    Loading,
+    WarmingUp,
+    Ready,
+    Failed,
+    Cancelled
+};
+
+/**
+ * @brief Progress and outcome of an asynchronous model load.
+ *
+ * Shared between the thread running the load and the caller (typically the UI), who can
+ * poll progress(), block in wait() or abort the load with cancel(). The load reports
+ * file progress through the llama progress callback, which is also where cancellation
+ * takes effect.
+ */
+class LlamaLoadStatus
+{
+public:
+    /**
+     * @brief Asks the load to stop; takes effect at the next progress report.
+     */
+    void cancel() { cancelled_.store(true, std::memory_order_relaxed); }
+
+    bool is_cancelled() const { return cancelled_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Fraction of the model file loaded, from 0 to 1.
+     */
+    float progress() const { return progress_.load(std::memory_order_relaxed); }
+
+    LlamaLoadState state() const { return state_.load(std::memory_order_relaxed); }
+
+    bool is_done() const
+    {
+        const LlamaLoadState s = state();
+        return s == LlamaLoadState::Ready || s == LlamaLoadState::Failed || s == LlamaLoadState::Cancelled;
+    }
+
+    bool succeeded() const { return state() == LlamaLoadState::Ready; }
+
+    std::string error() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return error_;
+    }
+
+    /**
+     * @brief Blocks until the load is done.
+     *
+     * @param timeout_ms Maximum time to wait in milliseconds, negative to wait forever.
+     * @return true if the load is done.
+     */
+    bool wait(double timeout_ms = -1.0) const
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto done = [this]()
+        { return is_done(); };
+        if (timeout_ms < 0.0)
+        {
+            cv_.wait(lock, done);
+            return true;
+        }
+        return cv_.wait_for(lock, std::chrono::duration<double, std::milli>(timeout_ms), done);
+    }
+
+    void set_progress(float progress) { progress_.store(progress, std::memory_order_relaxed); }
+
+    void set_state(LlamaLoadState state) { state_.store(state, std::memory_order_relaxed); }
+
+    /**
+     * @brief Records the outcome and wakes up the waiters.
+     *
+     * @param ok    Whether the model is ready.
+     * @param error Error message when `ok` is false.
+     */
+    void finish(bool ok, const std::string &error = "")
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            error_ = ok ? std::string() : error;
+            if (ok)
+            {
+                progress_.store(1.0f, std::memory_order_relaxed);
+            }
+            state_.store(ok ? LlamaLoadState::Ready : (is_cancelled() ? LlamaLoadState::Cancelled : LlamaLoadState::Failed),
+                         std::memory_order_relaxed);
+        }
+        cv_.notify_all();
+    }
+
+    /**
+     * @brief Name of a load state, as exposed to Python.
+     */
+    static const char *state_name(LlamaLoadState state)
+    {
+        switch (state)
+        {
+        case LlamaLoadState::Pending:
+            return "pending";
+        case LlamaLoadState::Loading:
+            return "loading";
+        case LlamaLoadState::WarmingUp:
+            return "warming_up";
+        case LlamaLoadState::Ready:
+            return "ready";
+        case LlamaLoadState::Failed:
+            return "failed";
+        case LlamaLoadState::Cancelled:
+            return "cancelled";
+        }
+        return "unknown";
+    }
+
+private:
+    std::atomic<bool> cancelled_{false};
+    std::atomic<float> progress_{0.0f};
+    std::atomic<LlamaLoadState> state_{LlamaLoadState::Pending};
+    std::string error_;
+    mutable std::mutex mutex_;
+    mutable std::condition_variable cv_;
+};
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "llama_interface.hh"
+
+/**
+ * @brief What a llama microbenchmark measures, in the spirit of llama-bench.
+ *
+ * Prefill tests decode `n` prompt tokens in n_batch chunks into an empty KV cache (ppN).
+ * Decode tests generate `n_generate` tokens one at a time after `depth` tokens of KV fill
+ * (tgN@dD); the fill is not timed. Prompt and generated tokens are random, so no sampler
+ * runs in either. Sampler tests time llama_sampler_sample alone on the logits of the
+ * last decode, for the greedy sampler and for the default chain of `sampler_params`.
+ * `repetitions` is per prefill and decode test; each sampler test calls the sampler
+ * `sampler_iterations` times.
+ */
+struct HegemonikonMicrobenchParams
+{
+    HegemonikonLlamaModelParams model_params;
+    std::vector<int32_t> prompt_lengths = {512, 2048};
+    int32_t n_generate = 128;
+    std::vector<int32_t> depths = {0, 4096, 16384};
+    int32_t repetitions = 3;
+    int32_t sampler_iterations = 1000;
+    HegemonikonGenerationParams sampler_params;
+    uint32_t seed = 42;
+
+    std::string to_string() const
+    {
+        auto join = [](const std::vector<int32_t> &values)
+        {
+            std::string out;
+            for (size_t i = 0; i < values.size(); ++i)
+            {
+                out += (i > 0 ? "," : "") + std::to_string(values[i]);
+            }
+            return out;
+        };
+        return "HegemonikonMicrobenchParams(model_path='" + model_params.model_path +
+               "', prompt_lengths=[" + join(prompt_lengths) + "]" +
+               ", n_generate=" + std::to_string(n_generate) +
+               ", depths=[" + join(depths) + "]" +
+               ", repetitions=" + std::to_string(repetitions) +
+               ", sampler_iterations=" + std::to_string(sampler_iterations) +
+               ", seed=" + std::to_string(seed) + ")";
+    }
+};
+
+/**
+ * @brief Timings of one microbenchmark test.
+ *
+ * `test` names it like llama-bench does (pp512, tg128@d4096) or sampler_greedy and
+ * sampler_chain. For sampler tests `n_tokens` is the number of calls per sample (one
+ * repetition) and the throughput is in samples per second.
+ */
+struct HegemonikonMicrobenchSample
+{
+    std::string test;
+    std::string kind;
+    int32_t n_tokens = 0;
+    int32_t depth = 0;
+    std::vector<double> samples_ms;
+    double avg_ms = 0.0;
+    double stdev_ms = 0.0;
+    double tokens_per_second = 0.0;
+    double stdev_tokens_per_second = 0.0;
+
+    void calculate_statistics();
+
+    std::string to_string() const
+    {
+        return "HegemonikonMicrobenchSample(test=" + test +
+               ", avg_ms=" + std::to_string(avg_ms) +
+               ", stdev_ms=" + std::to_string(stdev_ms) +
+               ", tokens_per_second=" + std::to_string(tokens_per_second) +
+               ", stdev_tokens_per_second=" + std::to_string(stdev_tokens_per_second) + ")";
+    }
+};
+
+/**
+ * @brief Results of a microbenchmark run with what identifies the build and machine.
+ */
+struct HegemonikonMicrobenchReport
+{
+    bool success = false;
+    std::string errorMessage;
+    std::string model_path;
+    std::string model_description;
+    uint64_t model_size_bytes = 0;
+    uint64_t model_n_params = 0;
+    std::string llama_cpp_version;
+    std::string system_info;
+    int32_t n_threads = 0;
+    int32_t n_threads_batch = 0;
+    int32_t n_gpu_layers = 0;
+    int32_t n_batch = 0;
+    int32_t n_ubatch = 0;
+    std::string cache_type_k;
+    std::string cache_type_v;
+    std::string flash_attn;
+    std::vector<HegemonikonMicrobenchSample> samples;
+
+    std::string to_json() const;
+};
+
+/**
+ * @brief In-process prefill, decode and sampler microbenchmarks of a llama model.
+ *
+ * The model and its context are created directly with the llama.cpp API from the
+ * model parameters, without the sessions, prefix cache and scheduling of
+ * LlamaInterface, so the timings are those of llama.cpp itself and can be compared
+ * across llama.cpp versions.
+ */
+class LlamaMicrobench
+{
+public:
+    static HegemonikonMicrobenchReport run(const HegemonikonMicrobenchParams &params);
+
+    static bool write_report(const HegemonikonMicrobenchReport &report, const std::string &path);
+};
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "llama_interface.hh"
+
+/**
+ * @brief Counters and memory accounting of the model registry.
+ */
+struct HegemonikonModelRegistryStats
+{
+    uint32_t resident_models = 0;
+    uint32_t pinned_models = 0;
+    uint32_t models_in_use = 0;
+    uint64_t ram_bytes = 0;
+    uint64_t vram_bytes = 0;
+    uint64_t ram_budget_bytes = 0;
+    uint64_t vram_budget_bytes = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    uint64_t load_failures = 0;
+
+    std::string to_string() const
+    {
+        return "HegemonikonModelRegistryStats(resident_models=" + std::to_string(resident_models) +
+               ", pinned_models=" + std::to_string(pinned_models) +
+               ", models_in_use=" + std::to_string(models_in_use) +
+               ", ram_bytes=" + std::to_string(ram_bytes) +
+               ", vram_bytes=" + std::to_string(vram_bytes) +
+               ", ram_budget_bytes=" + std::to_string(ram_budget_bytes) +
+               ", vram_budget_bytes=" + std::to_string(vram_budget_bytes) +
+               ", hits=" + std::to_string(hits) +
+               ", misses=" + std::to_string(misses) +
+               ", evictions=" + std::to_string(evictions) +
+               ", load_failures=" + std::to_string(load_failures) + ")";
+    }
+};
+
+/**
+ * @brief Keeps several Llama models resident under a RAM/VRAM budget.
+ *
+ * Models are keyed by HegemonikonLlamaModelParams::hash(), so asking again for a model
+ * that is still resident returns it without reloading. When loading a new model would
+ * exceed the budget, the least recently used models are unloaded first. A model is never
+ * evicted while it is pinned or while anyone outside the registry still holds the
+ * shared pointer returned by acquire(), which is what keeps in-flight requests safe.
+ * A budget of 0 means unlimited.
+ */
+class LlamaModelRegistry
+{
+public:
+    using factory_t = std::function<std::shared_ptr<LlamaInterface>()>;
+
+    explicit LlamaModelRegistry(factory_t factory = nullptr);
+    ~LlamaModelRegistry();
+
+    LlamaModelRegistry(const LlamaModelRegistry &) = delete;
+    LlamaModelRegistry &operator=(const LlamaModelRegistry &) = delete;
+
+    void set_factory(factory_t factory);
+    void set_budget(uint64_t ram_budget_bytes, uint64_t vram_budget_bytes);
+
+    std::shared_ptr<LlamaInterface> acquire(const HegemonikonLlamaModelParams &params,
+                                            std::shared_ptr<LlamaLoadStatus> status = nullptr);
+
+    bool contains(const HegemonikonLlamaModelParams &params) const;
+    bool set_pinned(const HegemonikonLlamaModelParams &params, bool pinned);
+    bool evict(const HegemonikonLlamaModelParams &params);
+    std::shared_ptr<LlamaInterface> detach(const HegemonikonLlamaModelParams &params);
+    size_t clear();
+
+    size_t size() const;
+    HegemonikonModelRegistryStats get_stats() const;
+
+private:
+    struct Entry
+    {
+        HegemonikonLlamaModelParams params;
+        std::shared_ptr<LlamaInterface> model;
+        HegemonikonModelFootprint footprint;
+        uint64_t last_used = 0;
+        bool pinned = false;
+    };
+
+    factory_t factory_;
+    std::unordered_map<size_t, Entry> entries_;
+    uint64_t ram_budget_bytes_ = 0;
+    uint64_t vram_budget_bytes_ = 0;
+    uint64_t clock_ = 0;
+    HegemonikonModelRegistryStats stats_;
+
+    mutable std::mutex mutex_;
+    std::mutex load_mutex_;
+
+    bool fits(const HegemonikonModelFootprint &extra) const;
+    bool make_room(const HegemonikonModelFootprint &extra, size_t keep_key,
+                   std::vector<std::shared_ptr<LlamaInterface>> &evicted);
+    void remove_locked(std::unordered_map<size_t, Entry>::iterator it,
+                       std::vector<std::shared_ptr<LlamaInterface>> &evicted);
+    static void unload_all(std::vector<std::shared_ptr<LlamaInterface>> &evicted);
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <llama.h>
+
+/**
+ * @brief N-gram index over the tokens of a sequence, for prompt-lookup decoding.
+ *
+ * Every n-gram of `ngram_min` to `ngram_max` tokens is indexed with the position of the
+ * token that followed its latest occurrence. When the last tokens of the sequence
+ * appeared earlier (typically in a retrieved passage of the prompt), draft() proposes
+ * the tokens that followed them, trying the longest n-gram first. No model is involved:
+ * the proposal is only a guess, to be verified by the main model.
+ *
+ * An n-gram is only indexed once the token after it is known, so the trailing n-gram of
+ * the sequence never matches itself. Appending a token costs one hash-map update per n-gram length.
+ */
+class LlamaNgramLookup
+{
+public:
+    static constexpr size_t MAX_NGRAM = 8;
+
+    LlamaNgramLookup() : LlamaNgramLookup(2, 4) {}
+    LlamaNgramLookup(size_t ngram_min, size_t ngram_max);
+
+    void configure(size_t ngram_min, size_t ngram_max);
+    void reset();
+
+    void push(llama_token token);
+    void sync(const std::vector<llama_token> &tokens);
+
+    size_t draft(size_t n_max, std::vector<llama_token> &out) const;
+
+    size_t size() const { return tokens_.size(); }
+    size_t ngram_min() const { return ngram_min_; }
+    size_t ngram_max() const { return ngram_max_; }
+
+private:
+    size_t ngram_min_ = 1;
+    size_t ngram_max_ = 1;
+    std::vector<llama_token> tokens_;
+    // index_[n - ngram_min_]: hash of an n-gram -> position of the token that followed it
+    std::vector<std::unordered_map<uint64_t, uint32_t>> index_;
+
+    static uint64_t hash(const llama_token *tokens, size_t n);
+};
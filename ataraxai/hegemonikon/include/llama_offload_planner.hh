@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "llama_interface.hh"
+
+/**
+ * @brief A device llama.cpp can offload layers to, with its memory at query time.
+ */
+struct HegemonikonGpuDevice
+{
+    std::string name;
+    std::string description;
+    uint64_t free_bytes = 0;
+    uint64_t total_bytes = 0;
+
+    std::string to_string() const
+    {
+        return "HegemonikonGpuDevice(name='" + name + "', description='" + description +
+               "', free_bytes=" + std::to_string(free_bytes) +
+               ", total_bytes=" + std::to_string(total_bytes) + ")";
+    }
+};
+
+/**
+ * @brief Shape and tensor sizes of a GGUF model, read from its metadata only.
+ *
+ * `layer_bytes[i]` is the size of the `blk.i.*` tensors. The token embeddings stay in host
+ * memory whatever the offload; the output tensors are offloaded only when every repeating
+ * layer is, i.e. when n_gpu_layers exceeds n_layer.
+ */
+struct HegemonikonGgufModelInfo
+{
+    std::string architecture;
+    int32_t n_layer = 0;
+    int32_t n_embd = 0;
+    int32_t n_head = 0;
+    int32_t n_head_kv = 0;
+    int32_t n_embd_head_k = 0;
+    int32_t n_embd_head_v = 0;
+    int32_t n_vocab = 0;
+    std::vector<uint64_t> layer_bytes;
+    uint64_t input_bytes = 0;
+    uint64_t output_bytes = 0;
+
+    uint64_t weights_bytes() const
+    {
+        uint64_t total = input_bytes + output_bytes;
+        for (uint64_t bytes : layer_bytes)
+        {
+            total += bytes;
+        }
+        return total;
+    }
+
+    std::string to_string() const
+    {
+        return "HegemonikonGgufModelInfo(architecture='" + architecture +
+               "', n_layer=" + std::to_string(n_layer) +
+               ", n_embd=" + std::to_string(n_embd) +
+               ", n_head=" + std::to_string(n_head) +
+               ", n_head_kv=" + std::to_string(n_head_kv) +
+               ", n_vocab=" + std::to_string(n_vocab) +
+               ", weights_bytes=" + std::to_string(weights_bytes()) + ")";
+    }
+};
+
+/**
+ * @brief Offload decision made by LlamaOffloadPlanner, with the reasoning behind it.
+ *
+ * `device_bytes[d]` is the memory the plan expects on device `d` (same order as the
+ * devices it was planned for), weights, KV cache and compute buffer included.
+ */
+struct HegemonikonOffloadPlan
+{
+    int32_t n_gpu_layers = 0;
+    int32_t n_layer = 0;
+    int32_t main_gpu = 0;
+    bool tensor_split = false;
+    bool full_offload = false;
+    uint64_t weights_bytes = 0;
+    uint64_t kv_bytes = 0;
+    uint64_t compute_bytes = 0;
+    uint64_t host_bytes = 0;
+    std::vector<uint64_t> device_bytes;
+    std::vector<std::string> reasons;
+
+    /**
+     * @brief Copies the plan into model parameters.
+     *
+     * @param params The parameters to update.
+     * @return The parameters with n_gpu_layers, main_gpu and tensor_split set from the plan.
+     */
+    HegemonikonLlamaModelParams apply(HegemonikonLlamaModelParams params) const
+    {
+        params.n_gpu_layers = n_gpu_layers;
+        params.main_gpu = main_gpu;
+        params.tensor_split = tensor_split;
+        return params;
+    }
+
+    std::string to_string() const
+    {
+        std::string text = "HegemonikonOffloadPlan(n_gpu_layers=" + std::to_string(n_gpu_layers) +
+                           "/" + std::to_string(n_layer) +
+                           ", main_gpu=" + std::to_string(main_gpu) +
+                           ", tensor_split=" + (tensor_split ? "true" : "false") +
+                           ", weights_bytes=" + std::to_string(weights_bytes) +
+                           ", kv_bytes=" + std::to_string(kv_bytes) +
+                           ", compute_bytes=" + std::to_string(compute_bytes) +
+                           ", host_bytes=" + std::to_string(host_bytes) + ", device_bytes=[";
+        for (size_t i = 0; i < device_bytes.size(); ++i)
+        {
+            text += (i ? ", " : "") + std::to_string(device_bytes[i]);
+        }
+        return text + "])";
+    }
+};
+
+/**
+ * @brief Picks n_gpu_layers, main_gpu and the layer split for a model and a context size.
+ *
+ * Each layer costs its weights plus its share of the KV cache for `n_ctx` at the configured
+ * cache types; the main device also holds the compute buffer, and the output tensors once
+ * everything is offloaded. The planner keeps as many trailing layers as fit in the free memory of the
+ * devices minus a headroom (llama.cpp offloads the last layers first). A single device is
+ * preferred; layers are split across devices, in proportion to their free memory as
+ * llama.cpp does, only when that offloads more of the model.
+ */
+class LlamaOffloadPlanner
+{
+public:
+    static constexpr uint64_t DEFAULT_HEADROOM_BYTES = 512ull * 1024 * 1024;
+
+    static bool read_model_info(const std::string &model_path, HegemonikonGgufModelInfo &info);
+
+    static std::vector<HegemonikonGpuDevice> query_devices();
+
+    static HegemonikonOffloadPlan plan(const HegemonikonGgufModelInfo &info,
+                                       const HegemonikonLlamaModelParams &params,
+                                       const std::vector<HegemonikonGpuDevice> &devices,
+                                       uint64_t headroom_bytes = DEFAULT_HEADROOM_BYTES);
+
+    static HegemonikonOffloadPlan plan(const HegemonikonLlamaModelParams &params,
+                                       uint64_t headroom_bytes = DEFAULT_HEADROOM_BYTES);
+
+    static uint64_t kv_bytes_per_layer(const HegemonikonGgufModelInfo &info, int32_t n_ctx,
+                                       const std::string &type_k = "f16", const std::string &type_v = "f16");
+
+    static uint64_t compute_buffer_bytes(const HegemonikonGgufModelInfo &info, const HegemonikonLlamaModelParams &params);
+
+private:
+    static bool fits_on(const std::vector<uint64_t> &budgets, const std::vector<double> &shares,
+                        uint64_t layers_bytes, uint64_t main_extra_bytes, size_t main_device,
+                        std::vector<uint64_t> &device_bytes);
+};
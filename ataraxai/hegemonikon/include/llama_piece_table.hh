@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <llama.h>
+
+/**
+ * @brief Contiguous table of the text piece of every vocabulary token.
+ *
+ * All pieces live in one byte arena indexed by an offsets array, so turning a token into
+ * text is a bounds check and a memcpy instead of a llama_token_to_piece call and a
+ * temporary string. The table is bound to a vocabulary at load time and filled on first
+ * use; building is thread-safe and happens once.
+ */
+class LlamaPieceTable
+{
+public:
+    explicit LlamaPieceTable(const llama_vocab *vocab);
+
+    LlamaPieceTable(const LlamaPieceTable &) = delete;
+    LlamaPieceTable &operator=(const LlamaPieceTable &) = delete;
+
+    std::string_view piece(llama_token token) const;
+    bool append(llama_token token, std::string &out) const;
+    bool detokenize(const llama_token *tokens, size_t n_tokens, std::string &out) const;
+
+    size_t size() const;
+    size_t arena_bytes() const;
+
+private:
+    const llama_vocab *vocab_;
+    mutable std::once_flag built_;
+    mutable std::vector<uint32_t> offsets_;
+    mutable std::string arena_;
+
+    void ensure_built() const;
+};
+
+/**
+ * @brief Buffers bytes until they form complete UTF-8 code points.
+ *
+ * Tokens frequently split multi-byte characters; streaming such a piece as-is would hand
+ * consumers a broken character. push() only releases whole code points and keeps the
+ * incomplete tail for the next piece. Invalid lead bytes are passed through unchanged so
+ * that nothing is lost.
+ */
+class LlamaUtf8Accumulator
+{
+public:
+    /**
+     * @brief Appends bytes and moves every complete code point to `complete`.
+     *
+     * @param bytes    The next piece of text.
+     * @param complete Receives the text that ends on a code point boundary (appended).
+     */
+    void push(std::string_view bytes, std::string &complete)
+    {
+        pending_.append(bytes.data(), bytes.size());
+        const size_t n_ready = complete_length(pending_);
+        complete.append(pending_, 0, n_ready);
+        pending_.erase(0, n_ready);
+    }
+
+    /**
+     * @brief Returns whatever incomplete bytes are still buffered and clears the buffer.
+     */
+    std::string flush()
+    {
+        std::string tail;
+        tail.swap(pending_);
+        return tail;
+    }
+
+    size_t pending() const { return pending_.size(); }
+
+    /**
+     * @brief Length of the longest prefix of `text` that does not end inside a code point.
+     */
+    static size_t complete_length(std::string_view text)
+    {
+        const size_t n = text.size();
+        // A code point is at most 4 bytes, so only the last 3 bytes can start an incomplete one.
+        for (size_t back = 1; back <= 3 && back <= n; ++back)
+        {
+            const unsigned char c = static_cast<unsigned char>(text[n - back]);
+            if ((c & 0xC0) == 0x80)
+            {
+                continue;
+            }
+            size_t expected = 1;
+            if ((c & 0xE0) == 0xC0)
+                expected = 2;
+            else if ((c & 0xF0) == 0xE0)
+                expected = 3;
+            else if ((c & 0xF8) == 0xF0)
+                expected = 4;
+            return expected > back ? n - back : n;
+        }
+        return n;
+    }
+
+private:
+    std::string pending_;
+};
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <llama.h>
+
+/**
+ * @brief Counters describing the effectiveness of the prefix cache.
+ */
+struct HegemonikonPrefixCacheStats
+{
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t reused_tokens = 0;
+    uint64_t cached_tokens = 0;
+    uint64_t entries = 0;
+    uint64_t evictions = 0;
+
+    std::string to_string() const
+    {
+        return "HegemonikonPrefixCacheStats(hits=" + std::to_string(hits) +
+               ", misses=" + std::to_string(misses) +
+               ", reused_tokens=" + std::to_string(reused_tokens) +
+               ", cached_tokens=" + std::to_string(cached_tokens) +
+               ", entries=" + std::to_string(entries) +
+               ", evictions=" + std::to_string(evictions) + ")";
+    }
+};
+
+/**
+ * @brief Result of a prefix cache lookup.
+ *
+ * `seq_id` is the reserved sequence holding the KV state of the first `n_tokens`
+ * prompt tokens, or -1 when nothing matched.
+ */
+struct LlamaPrefixMatch
+{
+    llama_seq_id seq_id = -1;
+    size_t n_tokens = 0;
+};
+
+/**
+ * @brief Bookkeeping for KV-cache prefixes kept in reserved sequences.
+ *
+ * Prefixes are indexed by a rolling hash computed over fixed-size token blocks, so a
+ * prompt matches an entry on its longest block-aligned common prefix. A prefix becomes
+ * an entry once two consecutive prompts are seen to share it. The class only
+ * decides which sequence holds what; the caller performs the actual KV operations
+ * (`llama_memory_seq_cp` / `llama_memory_seq_rm`) on the ids it returns.
+ */
+class LlamaPrefixCache
+{
+public:
+    static constexpr size_t DEFAULT_BLOCK_SIZE = 32;
+
+    LlamaPrefixCache() = default;
+
+    void configure(const std::vector<llama_seq_id> &seq_ids, size_t max_tokens,
+                   size_t block_size = DEFAULT_BLOCK_SIZE);
+
+    LlamaPrefixMatch lookup(const std::vector<llama_token> &tokens, size_t n_max);
+
+    size_t insert(const std::vector<llama_token> &tokens, size_t n_tokens,
+                  llama_seq_id &seq_id, std::vector<llama_seq_id> &evicted);
+
+    llama_seq_id evict_lru();
+
+    std::vector<llama_seq_id> clear();
+
+    bool enabled() const { return !entries_.empty() && max_tokens_ >= block_size_; }
+    size_t block_size() const { return block_size_; }
+    size_t aligned_length(size_t n_tokens) const;
+
+    HegemonikonPrefixCacheStats get_stats() const;
+
+private:
+    struct Entry
+    {
+        llama_seq_id seq_id = -1;
+        std::vector<llama_token> tokens;
+        std::vector<uint64_t> block_hashes;
+        uint64_t last_used = 0;
+    };
+
+    std::vector<Entry> entries_;
+    std::vector<uint64_t> last_prompt_hashes_;
+    size_t max_tokens_ = 0;
+    size_t block_size_ = DEFAULT_BLOCK_SIZE;
+    size_t cached_tokens_ = 0;
+    uint64_t clock_ = 0;
+
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+    uint64_t reused_tokens_ = 0;
+    uint64_t evictions_ = 0;
+
+    std::vector<uint64_t> block_hashes(const std::vector<llama_token> &tokens, size_t n_tokens) const;
+    Entry *lru_entry();
+    void release(Entry &entry);
+};
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+/**
+ * @brief Why a request was interrupted before its natural end.
+ */
+enum class LlamaInterruptReason
+{
+    None,
+    Cancelled,
+    Deadline,
+    TokenLimit
+};
+
+/**
+ * @brief Shared control block of a generation request.
+ *
+ * The owner of a request (a Python coroutine, an HTTP handler, the token stream) keeps a
+ * reference and can cancel it or bound it by wall-clock time or generated tokens at any
+ * moment, from any thread. The generation loop checks the handle between decode steps,
+ * and the llama abort callback checks it inside a decode, so compute is released within
+ * one step of the request being abandoned.
+ */
+class LlamaRequestHandle
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    /**
+     * @brief Asks the request to stop as soon as possible.
+     */
+    void cancel() { cancelled_.store(true, std::memory_order_relaxed); }
+
+    bool is_cancelled() const { return cancelled_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Sets an absolute wall-clock deadline.
+     */
+    void set_deadline(clock::time_point deadline)
+    {
+        deadline_ns_.store(std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count(),
+                           std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Sets a deadline relative to now.
+     *
+     * @param timeout_ms Milliseconds from now; 0 or less removes the deadline.
+     */
+    void set_timeout_ms(double timeout_ms)
+    {
+        if (timeout_ms <= 0.0)
+        {
+            deadline_ns_.store(0, std::memory_order_relaxed);
+            return;
+        }
+        set_deadline(clock::now() + std::chrono::duration_cast<clock::duration>(
+                                        std::chrono::duration<double, std::milli>(timeout_ms)));
+    }
+
+    bool has_deadline() const { return deadline_ns_.load(std::memory_order_relaxed) != 0; }
+
+    /**
+     * @brief Caps the number of generated tokens, on top of n_predict.
+     *
+     * @param max_tokens The token budget; 0 or less removes the limit.
+     */
+    void set_token_limit(int32_t max_tokens) { token_limit_.store(max_tokens > 0 ? max_tokens : 0, std::memory_order_relaxed); }
+
+    /**
+     * @brief Checks whether the request must stop.
+     *
+     * @param tokens_generated Number of tokens generated so far.
+     * @return The reason to stop, or LlamaInterruptReason::None to continue.
+     */
+    LlamaInterruptReason check(int32_t tokens_generated) const
+    {
+        if (cancelled_.load(std::memory_order_relaxed))
+        {
+            return LlamaInterruptReason::Cancelled;
+        }
+        const int32_t limit = token_limit_.load(std::memory_order_relaxed);
+        if (limit > 0 && tokens_generated >= limit)
+        {
+            return LlamaInterruptReason::TokenLimit;
+        }
+        const int64_t deadline = deadline_ns_.load(std::memory_order_relaxed);
+        if (deadline != 0 &&
+            std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now().time_since_epoch()).count() >= deadline)
+        {
+            return LlamaInterruptReason::Deadline;
+        }
+        return LlamaInterruptReason::None;
+    }
+
+private:
+    std::atomic<bool> cancelled_{false};
+    std::atomic<int64_t> deadline_ns_{0};
+    std::atomic<int32_t> token_limit_{0};
+};
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <llama.h>
+
+class SecureKey;
+
+/**
+ * @brief Header of a KV session snapshot file, readable without the key.
+ */
+struct HegemonikonSessionSnapshotInfo
+{
+    std::string path;
+    uint64_t model_hash = 0;
+    uint64_t prefix_hash = 0;
+    uint32_t n_tokens = 0;
+    uint64_t state_bytes = 0;
+    bool encrypted = false;
+
+    std::string to_string() const
+    {
+        return "HegemonikonSessionSnapshotInfo(path='" + path +
+               "', model_hash=" + std::to_string(model_hash) +
+               ", prefix_hash=" + std::to_string(prefix_hash) +
+               ", n_tokens=" + std::to_string(n_tokens) +
+               ", state_bytes=" + std::to_string(state_bytes) +
+               ", encrypted=" + (encrypted ? "true" : "false") + ")";
+    }
+};
+
+/**
+ * @brief On-disk format of the per-sequence KV state of a chat session.
+ *
+ * A snapshot holds the tokens of a sequence followed by the bytes returned by
+ * `llama_state_seq_get_data`. Files are named `<model_hash>-<prefix_hash>.kvsnap`, so a
+ * directory can hold the snapshots of several models and conversations side by side;
+ * find_best() picks the longest snapshot whose tokens start a given prompt.
+ *
+ * With a key, the tokens and state are encrypted with a BLAKE2b keystream (counter mode
+ * under a random nonce) and authenticated with keyed BLAKE2b over header and ciphertext;
+ * the prefix hash is then keyed too, so file names reveal nothing about the conversation.
+ * Encryption and MAC keys are derived from the caller's key, which may be 1 to 64 bytes.
+ * The class only deals with files; LlamaInterface moves the state in and out of llama.
+ */
+class LlamaSessionSnapshot
+{
+public:
+    static constexpr const char *FILE_EXTENSION = ".kvsnap";
+
+    static uint64_t hash_tokens(const llama_token *tokens, size_t n_tokens, const SecureKey *key = nullptr);
+
+    static std::string file_name(uint64_t model_hash, uint64_t prefix_hash);
+
+    static bool write(const std::string &directory, uint64_t model_hash,
+                      const std::vector<llama_token> &tokens, const std::vector<uint8_t> &state,
+                      const SecureKey *key, std::string &path, std::string &error);
+
+    static bool read_info(const std::string &path, HegemonikonSessionSnapshotInfo &info);
+
+    static bool read(const std::string &path, uint64_t model_hash, const SecureKey *key,
+                     std::vector<llama_token> &tokens, std::vector<uint8_t> &state, std::string &error);
+
+    static bool find_best(const std::string &directory, uint64_t model_hash,
+                          const std::vector<llama_token> &prompt, const SecureKey *key,
+                          HegemonikonSessionSnapshotInfo &best);
+
+    static std::vector<HegemonikonSessionSnapshotInfo> list(const std::string &directory, uint64_t model_hash);
+
+    static size_t remove_for_model(const std::string &directory, uint64_t model_hash);
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Streaming multi-pattern matcher for generation stop sequences.
+ *
+ * An Aho-Corasick automaton is built once from the stop sequences of a request and then
+ * fed the generated pieces one by one, so each piece costs O(piece length) regardless of
+ * how long the output is or how many stop strings there are. Matches spanning token
+ * boundaries are found naturally since the automaton state carries over between pieces.
+ *
+ * The matcher also decides what can be streamed: text that is still a prefix of some stop
+ * sequence is held back until it either completes a match (and is dropped) or diverges
+ * (and is released), so streamed output never has to be retracted.
+ */
+class LlamaStopMatcher
+{
+public:
+    LlamaStopMatcher() = default;
+    explicit LlamaStopMatcher(const std::vector<std::string> &stop_sequences);
+
+    void configure(const std::vector<std::string> &stop_sequences);
+
+    bool feed(const std::string &piece, std::string &emitted);
+    std::string flush();
+    void reset();
+
+    bool matches_suffix(const std::string &text) const;
+
+    bool empty() const { return nodes_.size() <= 1; }
+    bool stopped() const { return stopped_; }
+    size_t held_back() const { return pending_.size(); }
+
+private:
+    struct Node
+    {
+        std::vector<std::pair<unsigned char, int32_t>> next;
+        int32_t fail = 0;
+        uint32_t depth = 0;
+        uint32_t match_len = 0;
+    };
+
+    std::vector<Node> nodes_;
+    int32_t state_ = 0;
+    std::string pending_;
+    bool stopped_ = false;
+
+    int32_t child(int32_t node, unsigned char c) const;
+    int32_t step(int32_t node, unsigned char c) const;
+};
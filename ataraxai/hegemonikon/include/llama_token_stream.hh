@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "llama_interface.hh"
+
+/**
+ * @brief Pull-style adapter over a callback-based streaming generation.
+ *
+ * The generation runs on a background thread and pushes pieces into a queue that the
+ * consumer drains with next(). This is what lets Python iterate over tokens while the
+ * GIL is released between them. Destroying the stream cancels the generation; when a
+ * request handle is attached, cancelling also interrupts a prefill or decode in progress
+ * instead of waiting for the next piece.
+ */
+class LlamaTokenStream
+{
+public:
+    using runner_t = std::function<bool(const llama_token_callback &, std::string &error)>;
+
+    explicit LlamaTokenStream(runner_t runner, std::shared_ptr<LlamaRequestHandle> handle = nullptr);
+    ~LlamaTokenStream();
+
+    LlamaTokenStream(const LlamaTokenStream &) = delete;
+    LlamaTokenStream &operator=(const LlamaTokenStream &) = delete;
+
+    bool next(std::string &piece);
+
+    void cancel();
+
+    bool is_finished() const;
+    bool succeeded() const;
+    std::string error() const;
+
+private:
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::string> pieces_;
+    bool finished_ = false;
+    bool success_ = false;
+    std::string error_;
+    std::atomic<bool> cancelled_{false};
+    std::shared_ptr<LlamaRequestHandle> handle_;
+    std::thread worker_;
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "llama_interface.hh"
+
+/**
+ * @brief Winning load parameters of a model on a machine, as found by the auto-tuner.
+ *
+ * `params` holds the tuned fields only (see LlamaTuningStore::apply); the measurements
+ * are those of the winning configuration.
+ */
+struct HegemonikonTunedLlamaParams
+{
+    std::string model_key;
+    std::string machine_key;
+    std::string objective;
+    double score = 0.0;
+    double ttft_ms = 0.0;
+    double tokens_per_second = 0.0;
+    double memory_mb = 0.0;
+    HegemonikonLlamaModelParams params;
+
+    std::string to_string() const
+    {
+        return "HegemonikonTunedLlamaParams(model_key=" + model_key +
+               ", machine_key=" + machine_key +
+               ", objective=" + objective +
+               ", score=" + std::to_string(score) +
+               ", ttft_ms=" + std::to_string(ttft_ms) +
+               ", tokens_per_second=" + std::to_string(tokens_per_second) +
+               ", memory_mb=" + std::to_string(memory_mb) +
+               ", params=" + params.to_string() + ")";
+    }
+};
+
+/**
+ * @brief JSON file of tuned load parameters, one entry per model and machine.
+ *
+ * A model is identified by its file name and size, so a moved or re-downloaded copy of
+ * the same GGUF keeps its settings; a machine by its CPU model, its number of logical
+ * CPUs and its offload devices with their memory. The file is re-read on every lookup
+ * and rewritten under a temporary name on every store, so several processes can share it.
+ *
+ * All methods are thread-safe.
+ */
+class LlamaTuningStore
+{
+public:
+    static constexpr int FORMAT_VERSION = 1;
+
+    explicit LlamaTuningStore(const std::string &path);
+
+    const std::string &path() const { return path_; }
+
+    bool lookup(const std::string &model_path, HegemonikonTunedLlamaParams &entry) const;
+    bool lookup(const std::string &model_key, const std::string &machine_key, HegemonikonTunedLlamaParams &entry) const;
+    bool store(const HegemonikonTunedLlamaParams &entry);
+    std::vector<HegemonikonTunedLlamaParams> entries() const;
+
+    static std::string model_key(const std::string &model_path);
+    static std::string machine_key();
+    static HegemonikonLlamaModelParams apply(const HegemonikonLlamaModelParams &params,
+                                             const HegemonikonLlamaModelParams &tuned);
+
+private:
+    std::string path_;
+    mutable std::mutex mutex_;
+
+    bool read_locked(std::vector<HegemonikonTunedLlamaParams> &entries) const;
+    bool write_locked(const std::vector<HegemonikonTunedLlamaParams> &entries) const;
+};
@@ -1,12 +1,16 @@
 #pragma once
+#include <algorithm>
 #include <cstring>
 #include <memory>
 #include <stdexcept>
+#include <thread>
 #include <vector>
 #include <iostream>
 
 #include "argon2/argon2.h"
 #include "plateform_memory.hh"
+#include "secure_arena.hh"
+#include "trace_recorder.hh"
 
 /**
  * @brief Securely sets a block of memory to a specified value.
@@ -19,7 +23,7 @@
  * @param value Value to set (interpreted as an unsigned char).
  * @param size  Number of bytes to set.
  */
-void secure_memset(void *ptr, int value, size_t size)
+inline void secure_memset(void *ptr, int value, size_t size)
 {
     volatile char *p = static_cast<volatile char *>(ptr);
     while (size--)
@@ -38,31 +42,20 @@ private:
 
     void allocate_memory(size_t size)
     {
-        size_t page_size = PlatformMemory::get_page_size();
-        capacity = (size + page_size - 1) & ~(page_size - 1);
-
-        data = static_cast<char *>(PlatformMemory::allocate_aligned(capacity, page_size));
+        // Zeroed and locked block of the shared secure arena
+        capacity = size;
+        data = static_cast<char *>(SecureArena::instance().allocate(capacity));
         if (!data)
         {
             throw std::bad_alloc();
         }
-
-        if (!PlatformMemory::lock_memory(data, capacity))
-        {
-            PlatformMemory::deallocate_aligned(data);
-            throw std::runtime_error("Failed to lock memory: " + PlatformMemory::get_last_error());
-        }
-
-        secure_memset(data, 0, capacity);
     }
 
     void deallocate_memory()
     {
         if (data)
         {
-            secure_memset(data, 0, capacity);
-            PlatformMemory::unlock_memory(data, capacity);
-            PlatformMemory::deallocate_aligned(data);
+            SecureArena::instance().deallocate(data, capacity);
             data = nullptr;
             capacity = 0;
             length = 0;
@@ -143,8 +136,9 @@ public:
     /**
      * @brief Constructs a LockedMemory object that allocates and locks a memory region.
      *
-     * Allocates a memory block of the specified size with page alignment using PlatformMemory.
-     * The allocated memory is then locked into RAM to prevent it from being swapped out.
+     * Takes a zeroed block of the specified size from the shared SecureArena, whose regions
+     * are locked into RAM to prevent them from being swapped out. Regions are locked once
+     * and shared, so small objects no longer cost a page and a lock call each.
      * If allocation or locking fails, the constructor throws an exception.
      *
      * @param sz The size (in bytes) of the memory region to allocate and lock.
@@ -153,16 +147,9 @@ public:
      */
     LockedMemory(size_t sz) : ptr(nullptr), size(sz)
     {
-        size_t page_size = PlatformMemory::get_page_size();
-        ptr = PlatformMemory::allocate_aligned(size, page_size);
+        ptr = SecureArena::instance().allocate(size);
         if (!ptr)
             throw std::bad_alloc();
-
-        if (!PlatformMemory::lock_memory(ptr, size))
-        {
-            PlatformMemory::deallocate_aligned(ptr);
-            throw std::runtime_error("Failed to lock memory: " + PlatformMemory::get_last_error());
-        }
     }
 
     /**
@@ -184,8 +171,8 @@ public:
      * @brief Move assignment operator for LockedMemory.
      *
      * Transfers ownership of the locked memory from another LockedMemory instance.
-     * If this instance already owns memory, it securely wipes the contents,
-     * unlocks the memory, and frees it before taking ownership of the other's memory.
+     * If this instance already owns memory, it securely wipes the contents and
+     * returns it to the arena before taking ownership of the other's memory.
      * The source instance is left in a valid but empty state.
      *
      * @param other The LockedMemory instance to move from.
@@ -194,9 +181,7 @@ public:
     LockedMemory& operator=(LockedMemory&& other) noexcept {
         if (this != &other) {
             if (ptr) {
-                secure_memset(ptr, 0, size);
-                PlatformMemory::unlock_memory(ptr, size);
-                PlatformMemory::deallocate_aligned(ptr);
+                SecureArena::instance().deallocate(ptr, size);
             }
 
             ptr = other.ptr;
@@ -211,8 +196,8 @@ public:
     /**
      * @brief Destructor for the LockedMemory class.
      *
-     * This destructor securely erases the memory region pointed to by `ptr` using `secure_memset`,
-     * unlocks the memory, and then frees the allocated memory.
+     * This destructor returns the memory region pointed to by `ptr` to the SecureArena,
+     * which securely erases it before it can be reused.
      * These steps ensure that sensitive data is not left in memory after the object is destroyed.
      *
      * If `ptr` is null, no action is taken.
@@ -221,9 +206,7 @@ public:
     {
         if (ptr)
         {
-            secure_memset(ptr, 0, size);
-            PlatformMemory::unlock_memory(ptr, size);
-            PlatformMemory::deallocate_aligned(ptr);
+            SecureArena::instance().deallocate(ptr, size);
         }
     }
 
@@ -319,10 +302,11 @@ public:
     using value_type = T;
 
     /**
-     * @brief Allocates aligned memory for n objects of type T and locks it into RAM.
+     * @brief Allocates locked memory for n objects of type T.
      *
-     * This function allocates memory aligned to page boundaries for an array of n elements of type T.
-     * The allocated memory is then locked into physical RAM to prevent it from being swapped out.
+     * This function takes a block for an array of n elements of type T from the shared
+     * SecureArena, whose regions are locked into physical RAM to prevent them from being
+     * swapped out. Blocks are aligned to their size, up to a page.
      * If allocation or locking fails, appropriate exceptions are thrown.
      *
      * @param n The number of objects of type T to allocate.
@@ -332,27 +316,18 @@ public:
      */
     T *allocate(size_t n)
     {
-        size_t size = n * sizeof(T);
-        size_t page_size = PlatformMemory::get_page_size();
-        void *ptr = PlatformMemory::allocate_aligned(size, page_size);
+        void *ptr = SecureArena::instance().allocate(n * sizeof(T));
         if (!ptr)
             throw std::bad_alloc();
 
-        if (!PlatformMemory::lock_memory(ptr, size))
-        {
-            PlatformMemory::deallocate_aligned(ptr);
-            throw std::runtime_error("Failed to lock memory: " + PlatformMemory::get_last_error());
-        }
-
         return static_cast<T *>(ptr);
     }
 
     /**
-     * @brief Deallocates memory securely by zeroing out its contents, unlocking it from RAM, and freeing it.
+     * @brief Deallocates memory securely by zeroing out its contents and returning it to the arena.
      *
-     * This function first overwrites the memory pointed to by `ptr` with zeros using `secure_memset`
-     * to prevent sensitive data from lingering in memory. It then unlocks the memory region and
-     * finally frees the memory.
+     * The arena overwrites the memory pointed to by `ptr` with zeros before the block can be
+     * reused, to prevent sensitive data from lingering in memory.
      *
      * @tparam T Type of the elements pointed to by `ptr`.
      * @param ptr Pointer to the memory block to deallocate.
@@ -362,10 +337,7 @@ public:
     {
         if (ptr)
         {
-            size_t size = n * sizeof(T);
-            secure_memset(ptr, 0, size);
-            PlatformMemory::unlock_memory(ptr, size);
-            PlatformMemory::deallocate_aligned(ptr);
+            SecureArena::instance().deallocate(ptr, n * sizeof(T));
         }
     }
 };
@@ -373,42 +345,40 @@ public:
 class SecureKey
 {
 private:
-    std::unique_ptr<uint8_t, decltype(&PlatformMemory::deallocate_aligned)> key_data;
+    uint8_t *key_data;
     size_t key_size;
 
+    void release()
+    {
+        if (key_data)
+        {
+            SecureArena::instance().deallocate(key_data, key_size);
+            key_data = nullptr;
+        }
+    }
+
 public:
     SecureKey(const uint8_t *key, size_t size)
-        : key_data(nullptr, &PlatformMemory::deallocate_aligned), key_size(size)
+        : key_data(nullptr), key_size(size)
     {
-        size_t page_size = PlatformMemory::get_page_size();
-
-        void *ptr = PlatformMemory::allocate_aligned(key_size, page_size);
-        if (!ptr)
+        key_data = static_cast<uint8_t *>(SecureArena::instance().allocate(key_size));
+        if (!key_data)
             throw std::bad_alloc();
-        if (!PlatformMemory::lock_memory(ptr, key_size))
-        {
-            PlatformMemory::deallocate_aligned(ptr);
-            throw std::runtime_error("Failed to lock key memory");
-        }
-        key_data.reset(static_cast<uint8_t *>(ptr));
-        memcpy(key_data.get(), key, key_size);
+        memcpy(key_data, key, key_size);
     }
 
     ~SecureKey()
     {
-        if (key_data)
-        {
-            secure_memset(key_data.get(), 0, key_size);
-            PlatformMemory::unlock_memory(key_data.get(), key_size);
-        }
+        release();
     }
 
     SecureKey(const SecureKey &) = delete;
     SecureKey &operator=(const SecureKey &) = delete;
 
     SecureKey(SecureKey &&other) noexcept
-        : key_data(std::move(other.key_data)), key_size(other.key_size)
+        : key_data(other.key_data), key_size(other.key_size)
     {
+        other.key_data = nullptr;
         other.key_size = 0;
     }
 
@@ -416,32 +386,54 @@ public:
     {
         if (this != &other)
         {
-            key_data = std::move(other.key_data);
+            release();
+            key_data = other.key_data;
             key_size = other.key_size;
+            other.key_data = nullptr;
             other.key_size = 0;
         }
         return *this;
     }
 
-    const uint8_t *data() const { return key_data.get(); }
+    const uint8_t *data() const { return key_data; }
     size_t size() const { return key_size; }
 };
 
 using SecureVector = std::vector<uint8_t, SecureAllocator<uint8_t>>;
 
-SecureVector derive_key_from_password(const SecureString &password, const std::vector<uint8_t> &salt)
+/**
+ * @brief Argon2id cost parameters of a password key derivation.
+ *
+ * The defaults are those the vault was created with. `t_cost`, `m_cost` (KiB) and `lanes`
+ * are part of the derived key, so changing them requires re-keying; `threads` is not, and
+ * only sets how many lanes are filled concurrently. 0 threads uses one per lane, bounded
+ * by the hardware concurrency.
+ */
+struct KeyDerivationParams
+{
+    uint32_t t_cost = 2;
+    uint32_t m_cost = 65536;
+    uint32_t lanes = 1;
+    uint32_t threads = 0;
+};
+
+inline SecureVector derive_key_from_password(const SecureString &password, const std::vector<uint8_t> &salt,
+                                             const KeyDerivationParams &params = KeyDerivationParams())
 {
-    const uint32_t t_cost = 2;
-    const uint32_t m_cost = 65536;
-    const uint32_t parallelism = 1;
     const uint32_t key_length = 32;
+    uint32_t threads = params.threads;
+    if (threads == 0)
+    {
+        threads = std::min(params.lanes, std::max(1u, std::thread::hardware_concurrency()));
+    }
 
     SecureVector derived_key(key_length);
 
+    TraceSpan span("argon2_derive", "crypto");
     Argon2_Context context(derived_key.data(), static_cast<uint32_t>(derived_key.size()),
                            (uint8_t *)password.c_str(), static_cast<uint32_t>(password.size()),
                            (uint8_t *)salt.data(), static_cast<uint32_t>(salt.size()), nullptr, 0, nullptr, 0,
-                           t_cost, m_cost, parallelism, parallelism, nullptr, nullptr, false,
+                           params.t_cost, params.m_cost, params.lanes, threads, nullptr, nullptr, false,
                            false, false, false);
 
     int result = Argon2id(&context);
@@ -453,9 +445,10 @@ SecureVector derive_key_from_password(const SecureString &password, const std::v
     return derived_key;
 }
 
-SecureKey derive_and_protect_key(const SecureString &password, const std::vector<uint8_t> &salt)
+inline SecureKey derive_and_protect_key(const SecureString &password, const std::vector<uint8_t> &salt,
+                                        const KeyDerivationParams &params = KeyDerivationParams())
 {
-    SecureVector key_data = derive_key_from_password(password, salt);
+    SecureVector key_data = derive_key_from_password(password, salt, params);
 
     size_t key_size = key_data.size();
     SecureKey secure_key(key_data.data(), key_size);
@@ -0,0 +1,253 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Timed phases of the inference paths.
+ *
+ * Decode covers the decode steps that extend generations (one token per active sequence,
+ * or the verification batch of speculative drafts); Prefill the steps that carry prompt
+ * chunks. A step that does both is recorded in both. InterToken is the time between two
+ * tokens of the same generation as seen by the caller, stalls included.
+ */
+enum class MetricPhase
+{
+    QueueWait,
+    Tokenize,
+    Prefill,
+    Decode,
+    Sample,
+    Detokenize,
+    TimeToFirstToken,
+    InterToken,
+    Generation,
+    WhisperEncode,
+    WhisperDecode,
+    Transcription,
+    Count
+};
+
+/**
+ * @brief Monotonic counters of the inference paths.
+ */
+enum class MetricCounter
+{
+    Requests,
+    FailedRequests,
+    PromptTokens,
+    GeneratedTokens,
+    Transcriptions,
+    FailedTranscriptions,
+    AudioSamples,
+    LookupDraftedTokens,
+    LookupAcceptedTokens,
+    Count
+};
+
+/**
+ * @brief Point-in-time view of one latency histogram.
+ *
+ * Percentiles are the upper bound of the bucket holding the rank, so they overestimate by
+ * at most 1/16 of the value. `buckets` lists the cumulative count of samples at or below
+ * each bound of MetricsRegistry::bucket_bounds_ms().
+ */
+struct HegemonikonLatencySnapshot
+{
+    std::string name;
+    uint64_t count = 0;
+    double sum_ms = 0.0;
+    double max_ms = 0.0;
+    double p50_ms = 0.0;
+    double p90_ms = 0.0;
+    double p99_ms = 0.0;
+    double p999_ms = 0.0;
+    std::vector<std::pair<double, uint64_t>> buckets;
+
+    double mean_ms() const
+    {
+        return count > 0 ? sum_ms / static_cast<double>(count) : 0.0;
+    }
+
+    std::string to_string() const
+    {
+        return "HegemonikonLatencySnapshot(name=" + name +
+               ", count=" + std::to_string(count) +
+               ", mean_ms=" + std::to_string(mean_ms()) +
+               ", p50_ms=" + std::to_string(p50_ms) +
+               ", p90_ms=" + std::to_string(p90_ms) +
+               ", p99_ms=" + std::to_string(p99_ms) +
+               ", p999_ms=" + std::to_string(p999_ms) +
+               ", max_ms=" + std::to_string(max_ms) + ")";
+    }
+};
+
+/**
+ * @brief Point-in-time view of every histogram and counter of a MetricsRegistry.
+ */
+struct HegemonikonMetricsSnapshot
+{
+    std::vector<HegemonikonLatencySnapshot> latencies;
+
+    uint64_t requests = 0;
+    uint64_t failed_requests = 0;
+    uint64_t prompt_tokens = 0;
+    uint64_t generated_tokens = 0;
+    uint64_t transcriptions = 0;
+    uint64_t failed_transcriptions = 0;
+    double audio_seconds = 0.0;
+    uint64_t lookup_drafted_tokens = 0;
+    uint64_t lookup_accepted_tokens = 0;
+    double uptime_seconds = 0.0;
+
+    /**
+     * @brief Fraction of the prompt-lookup drafts accepted by the model.
+     */
+    double lookup_acceptance_rate() const
+    {
+        return lookup_drafted_tokens > 0 ? static_cast<double>(lookup_accepted_tokens) / lookup_drafted_tokens : 0.0;
+    }
+
+    const HegemonikonLatencySnapshot *find(const std::string &name) const
+    {
+        for (const HegemonikonLatencySnapshot &latency : latencies)
+        {
+            if (latency.name == name)
+            {
+                return &latency;
+            }
+        }
+        return nullptr;
+    }
+
+    std::string to_string() const
+    {
+        std::string out = "HegemonikonMetricsSnapshot(requests=" + std::to_string(requests) +
+                          ", failed_requests=" + std::to_string(failed_requests) +
+                          ", prompt_tokens=" + std::to_string(prompt_tokens) +
+                          ", generated_tokens=" + std::to_string(generated_tokens) +
+                          ", transcriptions=" + std::to_string(transcriptions) +
+                          ", failed_transcriptions=" + std::to_string(failed_transcriptions) +
+                          ", audio_seconds=" + std::to_string(audio_seconds) +
+                          ", lookup_drafted_tokens=" + std::to_string(lookup_drafted_tokens) +
+                          ", lookup_accepted_tokens=" + std::to_string(lookup_accepted_tokens) +
+                          ", uptime_seconds=" + std::to_string(uptime_seconds);
+        for (const HegemonikonLatencySnapshot &latency : latencies)
+        {
+            if (latency.count > 0)
+            {
+                out += ", " + latency.name + "_p50_ms=" + std::to_string(latency.p50_ms) +
+                       ", " + latency.name + "_p99_ms=" + std::to_string(latency.p99_ms);
+            }
+        }
+        return out + ")";
+    }
+};
+
+/**
+ * @brief Lock-free latency histogram with log-linear buckets, HDR style.
+ *
+ * Values are recorded in nanoseconds: below 16 ns every value has its own bucket, above
+ * each power of two is split in 16 equal buckets, up to about 3 days. record() is three
+ * relaxed atomic operations and never allocates, so it can stay on the decode path.
+ */
+class LatencyHistogram
+{
+public:
+    static constexpr uint32_t SUB_BUCKET_BITS = 4;
+    static constexpr uint32_t SUB_BUCKETS = 1u << SUB_BUCKET_BITS;
+    static constexpr uint32_t MAX_EXPONENT = 48;
+    static constexpr size_t N_BUCKETS = SUB_BUCKETS + (MAX_EXPONENT - SUB_BUCKET_BITS) * SUB_BUCKETS;
+
+    LatencyHistogram() = default;
+
+    LatencyHistogram(const LatencyHistogram &) = delete;
+    LatencyHistogram &operator=(const LatencyHistogram &) = delete;
+
+    void record(uint64_t value_ns);
+    void reset();
+
+    HegemonikonLatencySnapshot snapshot(const std::string &name, const std::vector<double> &bounds_ms) const;
+
+    static size_t bucket_index(uint64_t value_ns);
+    static uint64_t bucket_upper_ns(size_t index);
+
+private:
+    std::array<std::atomic<uint64_t>, N_BUCKETS> buckets_{};
+    std::atomic<uint64_t> sum_ns_{0};
+    std::atomic<uint64_t> max_ns_{0};
+};
+
+/**
+ * @brief Always-on timers and counters of the native inference paths.
+ *
+ * One registry is owned by each CoreAIService and shared with its Llama and Whisper
+ * interfaces, the batching scheduler and the context pool. Recording is lock-free;
+ * snapshot() and to_prometheus() read the atomics without stopping the writers, so a
+ * snapshot taken under load may be off by the samples recorded while it was read.
+ */
+class MetricsRegistry
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    /**
+     * @brief Records the time from its construction to its destruction in one phase.
+     *
+     * A null registry makes the timer a no-op.
+     */
+    class ScopedTimer
+    {
+    public:
+        ScopedTimer(MetricsRegistry *registry, MetricPhase phase)
+            : registry_(registry), phase_(phase), start_(registry ? clock::now() : clock::time_point())
+        {
+        }
+
+        ~ScopedTimer()
+        {
+            if (registry_)
+            {
+                registry_->record(phase_, start_, clock::now());
+            }
+        }
+
+        ScopedTimer(const ScopedTimer &) = delete;
+        ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+    private:
+        MetricsRegistry *registry_;
+        MetricPhase phase_;
+        clock::time_point start_;
+    };
+
+    MetricsRegistry();
+
+    MetricsRegistry(const MetricsRegistry &) = delete;
+    MetricsRegistry &operator=(const MetricsRegistry &) = delete;
+
+    void record(MetricPhase phase, clock::time_point start, clock::time_point end);
+    void record_ms(MetricPhase phase, double duration_ms);
+    void add(MetricCounter counter, uint64_t value = 1);
+
+    HegemonikonMetricsSnapshot snapshot() const;
+    std::string to_prometheus() const;
+    void reset();
+
+    static const char *phase_name(MetricPhase phase);
+    static const char *counter_name(MetricCounter counter);
+    static const std::vector<double> &bucket_bounds_ms();
+
+private:
+    std::array<LatencyHistogram, static_cast<size_t>(MetricPhase::Count)> histograms_;
+    std::array<std::atomic<uint64_t>, static_cast<size_t>(MetricCounter::Count)> counters_{};
+    std::atomic<int64_t> started_at_ns_{0};
+
+    uint64_t counter(MetricCounter counter) const;
+};
@@ -13,8 +13,11 @@
 #include <thread>
 #include <future>
 #include <filesystem>
+#include <cmath>
+#include <system_error>
 
 #include "llama_interface.hh"
+#include "llama_tuning_store.hh"
 #include "json.hpp"
 
 using namespace std::chrono;
@@ -70,6 +73,29 @@ T stdev(const std::vector<T> &v)
     return std::sqrt(sq_sum / (v.size() - 1) - mean * mean * v.size() / (v.size() - 1));
 }
 
+/**
+ * @brief Writes a benchmark report as indented JSON, creating the parent directories.
+ *
+ * @return true if the file was written.
+ */
+inline bool write_benchmark_json(const std::string &path, const json &document)
+{
+    std::error_code ec;
+    const fs::path parent = fs::path(path).parent_path();
+    if (!parent.empty())
+    {
+        fs::create_directories(parent, ec);
+    }
+    std::ofstream file(path, std::ios::trunc);
+    file << document.dump(2) << "\n";
+    if (!file)
+    {
+        std::cerr << "Benchmark Error: cannot write " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
 struct HegemonikonQuantizedModelInfo
 {
     std::string model_id;
@@ -132,6 +158,32 @@ struct HegemonikonBenchmarkMetrics
     float p50_latency_ms = 0.0f;
     float p95_latency_ms = 0.0f;
     float p99_latency_ms = 0.0f;
+
+    float draft_acceptance_rate = 0.0f;
+    float avg_accepted_draft_length = 0.0f;
+    std::vector<float> accepted_draft_length_history;
+
+    json to_json() const
+    {
+        return json{{"success", success},
+                    {"error", errorMessage},
+                    {"load_time_ms", load_time_ms},
+                    {"memory_usage_mb", memory_usage_mb},
+                    {"tokens_per_second", tokens_per_second},
+                    {"stdev_tokens_per_second", stdev(tokens_per_second_history)},
+                    {"avg_ttft_ms", avg_ttft_ms},
+                    {"stdev_ttft_ms", stdev(ttft_history_ms)},
+                    {"avg_decode_time_ms", avg_decode_time_ms},
+                    {"avg_end_to_end_latency_ms", avg_end_to_end_time_latency_ms},
+                    {"p50_latency_ms", p50_latency_ms},
+                    {"p95_latency_ms", p95_latency_ms},
+                    {"p99_latency_ms", p99_latency_ms},
+                    {"draft_acceptance_rate", draft_acceptance_rate},
+                    {"avg_accepted_draft_length", avg_accepted_draft_length},
+                    {"ttft_history_ms", ttft_history_ms},
+                    {"tokens_per_second_history", tokens_per_second_history},
+                    {"end_to_end_latency_history_ms", end_to_end_latency_history_ms}};
+    }
 };
 
 struct HegemonikonBenchmarkParams
@@ -168,6 +220,10 @@ struct HegemonikonBenchmarkResult
         {
             metrics.avg_decode_time_ms = avg(metrics.decode_times_history_ms);
         }
+        if (!metrics.tokens_per_second_history.empty())
+        {
+            metrics.tokens_per_second = avg(metrics.tokens_per_second_history);
+        }
         if (!metrics.end_to_end_latency_history_ms.empty())
         {
             metrics.avg_end_to_end_time_latency_ms = avg(metrics.end_to_end_latency_history_ms);
@@ -179,6 +235,97 @@ struct HegemonikonBenchmarkResult
             }
         }
     }
+
+    json to_json() const
+    {
+        return json{{"model_id", model_id},
+                    {"prompt", promptUsed},
+                    {"metrics", metrics.to_json()}};
+    }
+};
+
+/**
+ * @brief What the auto-tuner optimizes.
+ */
+enum class HegemonikonTuningObjective
+{
+    TimeToFirstToken,
+    DecodeTokensPerSecond,
+    Memory
+};
+
+/**
+ * @brief Values swept by the auto-tuner; an empty list keeps the value of the base parameters.
+ *
+ * `cache_types` is applied to both the K and V caches.
+ */
+struct HegemonikonTuningGrid
+{
+    std::vector<int32_t> n_gpu_layers;
+    std::vector<int32_t> n_batch;
+    std::vector<int32_t> n_threads;
+    std::vector<int32_t> n_ctx;
+    std::vector<std::string> cache_types;
+    std::vector<std::string> flash_attn;
+
+    size_t size() const
+    {
+        return std::max<size_t>(1, n_gpu_layers.size()) * std::max<size_t>(1, n_batch.size()) *
+               std::max<size_t>(1, n_threads.size()) * std::max<size_t>(1, n_ctx.size()) *
+               std::max<size_t>(1, cache_types.size()) * std::max<size_t>(1, flash_attn.size());
+    }
+};
+
+/**
+ * @brief Limits a configuration must meet to be picked; 0 disables a limit.
+ */
+struct HegemonikonTuningConstraints
+{
+    float max_ttft_ms = 0.0f;
+    float min_tokens_per_second = 0.0f;
+    float max_memory_mb = 0.0f;
+
+    bool satisfied_by(const HegemonikonBenchmarkMetrics &metrics) const
+    {
+        return metrics.success &&
+               (max_ttft_ms <= 0.0f || metrics.avg_ttft_ms <= max_ttft_ms) &&
+               (min_tokens_per_second <= 0.0f || metrics.tokens_per_second >= min_tokens_per_second) &&
+               (max_memory_mb <= 0.0f || metrics.memory_usage_mb <= max_memory_mb);
+    }
+};
+
+struct HegemonikonTuningParams
+{
+    HegemonikonTuningGrid grid;
+    HegemonikonTuningObjective objective = HegemonikonTuningObjective::DecodeTokensPerSecond;
+    HegemonikonTuningConstraints constraints;
+    // Successive halving: every configuration runs min_repetitions times, the better half
+    // is kept and runs twice as many, until one is left or benchmark_params.repetitions is reached.
+    bool successive_halving = false;
+    int min_repetitions = 1;
+    HegemonikonBenchmarkParams benchmark_params;
+};
+
+struct HegemonikonTuningCandidate
+{
+    HegemonikonLlamaModelParams llama_model_params;
+    HegemonikonBenchmarkMetrics metrics;
+    int repetitions = 0;
+    bool feasible = false;
+    double score = 0.0;
+};
+
+struct HegemonikonTuningResult
+{
+    std::string model_id;
+    bool success = false;
+    std::string errorMessage;
+    HegemonikonLlamaModelParams best_params;
+    // Best first; with successive halving, configurations dropped in a later round come first.
+    std::vector<HegemonikonTuningCandidate> candidates;
+    bool stored = false;
+
+    HegemonikonTuningResult(const std::string &id) : model_id(id) {}
 };
 
 class HegemonikonLlamaBenchmarker
@@ -252,8 +399,10 @@ public:
             result.metrics.load_time_ms = duration_cast<milliseconds>(
                                               high_resolution_clock::now() - load_start)
                                               .count();
+            result.metrics.memory_usage_mb = static_cast<float>(interface.get_memory_footprint().total_bytes()) / (1024.0f * 1024.0f);
 
             HegemonikonGenerationParams gen_params = benchmark_params.generation_params;
+            const bool speculative = interface.has_draft_model();
 
             if (cancellation_requested.load())
             {
@@ -270,6 +419,7 @@ public:
                 int32_t tokens_generated = 0;
                 std::cout << "  Running warmup..." << std::endl;
                 interface.generate_completion("Hello", gen_params, ttft_ms, decode_duration_ms, tokens_generated);
+                interface.reset_speculative_stats();
                 if (cancellation_requested.load())
                 {
                     result.metrics.success = false;
@@ -298,6 +448,7 @@ public:
                 double ttft_ms = 0.0;
                 double decode_duration_ms = 0.0;
                 int32_t tokens_generated = 0;
+                const HegemonikonSpeculativeStats spec_before = interface.get_speculative_stats();
 
                 std::string generated_text = interface.generate_completion(prompt, gen_params, ttft_ms, decode_duration_ms, tokens_generated);
 
@@ -310,13 +461,29 @@ public:
                 result.metrics.ttft_history_ms.push_back(ttft_ms);
 
                 double decode_tps = (decode_duration_ms > 0) ? (tokens_generated * 1000.0) / decode_duration_ms : 0.0;
-                result.metrics.decode_times_history_ms.push_back(decode_tps);
+                result.metrics.decode_times_history_ms.push_back(static_cast<float>(decode_duration_ms));
+                result.metrics.tokens_per_second_history.push_back(static_cast<float>(decode_tps));
+
+                if (speculative)
+                {
+                    HegemonikonSpeculativeStats spec_run = interface.get_speculative_stats();
+                    spec_run.verify_steps -= spec_before.verify_steps;
+                    spec_run.drafted_tokens -= spec_before.drafted_tokens;
+                    spec_run.accepted_tokens -= spec_before.accepted_tokens;
+                    result.metrics.accepted_draft_length_history.push_back(static_cast<float>(spec_run.avg_accepted_length()));
+                }
 
                 if (i == 0)
                 {
                     result.generated_text = generated_text;
                 }
             }
+            if (speculative)
+            {
+                const HegemonikonSpeculativeStats spec = interface.get_speculative_stats();
+                result.metrics.draft_acceptance_rate = static_cast<float>(spec.acceptance_rate());
+                result.metrics.avg_accepted_draft_length = static_cast<float>(spec.avg_accepted_length());
+            }
             result.metrics.success = true;
         }
         catch (const std::exception &e)
@@ -329,6 +496,221 @@ public:
         return result;
     }
 
+    /**
+     * @brief Lists the configurations of a grid, in the order of its nested loops.
+     *
+     * @param grid The values to sweep.
+     * @param base Parameters the swept values are set on.
+     * @return One set of parameters per configuration, at least `base` itself.
+     */
+    static std::vector<HegemonikonLlamaModelParams> expandTuningGrid(const HegemonikonTuningGrid &grid, const HegemonikonLlamaModelParams &base)
+    {
+        auto or_base = [](const auto &values, auto base_value)
+        {
+            return values.empty() ? std::vector<decltype(base_value)>{base_value}
+                                  : std::vector<decltype(base_value)>(values.begin(), values.end());
+        };
+        std::vector<HegemonikonLlamaModelParams> configurations;
+        configurations.reserve(grid.size());
+        for (int32_t n_gpu_layers : or_base(grid.n_gpu_layers, base.n_gpu_layers))
+            for (int32_t n_batch : or_base(grid.n_batch, base.n_batch))
+                for (int32_t n_threads : or_base(grid.n_threads, base.n_threads))
+                    for (int32_t n_ctx : or_base(grid.n_ctx, base.n_ctx))
+                        for (const std::string &cache_type : or_base(grid.cache_types, base.cache_type_k))
+                            for (const std::string &flash_attn : or_base(grid.flash_attn, base.flash_attn))
+                            {
+                                HegemonikonLlamaModelParams params = base;
+                                params.n_gpu_layers = n_gpu_layers;
+                                params.n_batch = n_batch;
+                                params.n_ubatch = std::min(base.n_ubatch, n_batch);
+                                params.n_threads = n_threads;
+                                params.n_threads_batch = grid.n_threads.empty() ? base.n_threads_batch : n_threads;
+                                params.n_ctx = n_ctx;
+                                params.cache_type_k = cache_type;
+                                params.cache_type_v = grid.cache_types.empty() ? base.cache_type_v : cache_type;
+                                params.flash_attn = flash_attn;
+                                configurations.push_back(params);
+                            }
+        return configurations;
+    }
+
+    static std::string tuningObjectiveName(HegemonikonTuningObjective objective)
+    {
+        switch (objective)
+        {
+        case HegemonikonTuningObjective::TimeToFirstToken:
+            return "ttft";
+        case HegemonikonTuningObjective::DecodeTokensPerSecond:
+            return "decode_tokens_per_second";
+        case HegemonikonTuningObjective::Memory:
+            return "memory";
+        }
+        return "";
+    }
+
+    /**
+     * @brief Scores measured metrics for an objective; higher is better.
+     */
+    static double tuningScore(const HegemonikonBenchmarkMetrics &metrics, HegemonikonTuningObjective objective)
+    {
+        switch (objective)
+        {
+        case HegemonikonTuningObjective::TimeToFirstToken:
+            return -metrics.avg_ttft_ms;
+        case HegemonikonTuningObjective::DecodeTokensPerSecond:
+            return metrics.tokens_per_second;
+        case HegemonikonTuningObjective::Memory:
+            return -metrics.memory_usage_mb;
+        }
+        return 0.0;
+    }
+
+    /**
+     * @brief Scores candidates and sorts them: configurations meeting the constraints
+     * first, then those that ran but miss a constraint, then the failed ones; each group
+     * by decreasing score.
+     */
+    static void rankTuningCandidates(std::vector<HegemonikonTuningCandidate> &candidates, const HegemonikonTuningParams &tuning_params)
+    {
+        for (HegemonikonTuningCandidate &candidate : candidates)
+        {
+            candidate.feasible = tuning_params.constraints.satisfied_by(candidate.metrics);
+            candidate.score = candidate.metrics.success ? tuningScore(candidate.metrics, tuning_params.objective) : 0.0;
+        }
+        auto group = [](const HegemonikonTuningCandidate &c)
+        {
+            return c.feasible ? 0 : (c.metrics.success ? 1 : 2);
+        };
+        std::stable_sort(candidates.begin(), candidates.end(),
+                         [&group](const HegemonikonTuningCandidate &a, const HegemonikonTuningCandidate &b)
+                         {
+                             return group(a) != group(b) ? group(a) < group(b) : a.score > b.score;
+                         });
+    }
+
+    /**
+     * @brief Benchmarks a model over a grid of load parameters and picks the best one.
+     *
+     * Each configuration loads the model again, so the sweep takes about
+     * `grid.size()` model loads (fewer runs per load with successive halving).
+     *
+     * @param quantized_model_info The model to tune.
+     * @param tuning_params        Grid, objective, constraints and benchmark settings.
+     * @param base_llama_params    Parameters of the model the swept values are set on.
+     * @return The ranked configurations; `success` is false when none meets the constraints.
+     */
+    HegemonikonTuningResult tuneModel(const HegemonikonQuantizedModelInfo &quantized_model_info, const HegemonikonTuningParams &tuning_params, const HegemonikonLlamaModelParams &base_llama_params)
+    {
+        HegemonikonTuningResult result(quantized_model_info.model_id);
+        cancellation_requested.store(false);
+
+        std::vector<HegemonikonTuningCandidate> survivors;
+        for (const HegemonikonLlamaModelParams &params : expandTuningGrid(tuning_params.grid, base_llama_params))
+        {
+            HegemonikonTuningCandidate candidate;
+            candidate.llama_model_params = params;
+            survivors.push_back(candidate);
+        }
+
+        const int final_repetitions = std::max(1, tuning_params.benchmark_params.repetitions);
+        int repetitions = tuning_params.successive_halving ? std::min(final_repetitions, std::max(1, tuning_params.min_repetitions))
+                                                           : final_repetitions;
+        std::vector<HegemonikonTuningCandidate> dropped;
+        while (true)
+        {
+            std::cout << "Tuning " << quantized_model_info.model_id << ": " << survivors.size()
+                      << " configurations, " << repetitions << " repetitions each" << std::endl;
+            for (HegemonikonTuningCandidate &candidate : survivors)
+            {
+                if (cancellation_requested.load())
+                {
+                    result.errorMessage = "Tuning cancelled by user.";
+                    return result;
+                }
+                HegemonikonBenchmarkParams benchmark_params = tuning_params.benchmark_params;
+                benchmark_params.n_gpu_layers = candidate.llama_model_params.n_gpu_layers;
+                benchmark_params.repetitions = repetitions;
+                candidate.metrics = benchmarkSingleModel(quantized_model_info, benchmark_params, candidate.llama_model_params).metrics;
+                candidate.repetitions = repetitions;
+            }
+            rankTuningCandidates(survivors, tuning_params);
+
+            if (survivors.size() <= 1 || repetitions >= final_repetitions)
+            {
+                break;
+            }
+            const size_t kept = (survivors.size() + 1) / 2;
+            dropped.insert(dropped.begin(), survivors.begin() + kept, survivors.end());
+            survivors.resize(kept);
+            repetitions = std::min(final_repetitions, repetitions * 2);
+        }
+
+        result.candidates = std::move(survivors);
+        result.candidates.insert(result.candidates.end(), dropped.begin(), dropped.end());
+        if (result.candidates.empty() || !result.candidates.front().feasible)
+        {
+            result.errorMessage = "No configuration meets the tuning constraints.";
+            return result;
+        }
+        result.best_params = result.candidates.front().llama_model_params;
+        result.success = true;
+        return result;
+    }
+
+    /**
+     * @brief Tunes a model and stores the winning parameters for this machine.
+     *
+     * CoreAIService::enable_tuned_llama_params(store_path) then loads the model with them.
+     */
+    HegemonikonTuningResult tuneAndStoreModel(const HegemonikonQuantizedModelInfo &quantized_model_info, const HegemonikonTuningParams &tuning_params, const HegemonikonLlamaModelParams &base_llama_params, const std::string &store_path)
+    {
+        HegemonikonTuningResult result = tuneModel(quantized_model_info, tuning_params, base_llama_params);
+        if (!result.success)
+        {
+            return result;
+        }
+        const HegemonikonTuningCandidate &best = result.candidates.front();
+        HegemonikonTunedLlamaParams entry;
+        entry.model_key = LlamaTuningStore::model_key(base_llama_params.model_path);
+        entry.machine_key = LlamaTuningStore::machine_key();
+        entry.objective = tuningObjectiveName(tuning_params.objective);
+        entry.score = best.score;
+        entry.ttft_ms = best.metrics.avg_ttft_ms;
+        entry.tokens_per_second = best.metrics.tokens_per_second;
+        entry.memory_mb = best.metrics.memory_usage_mb;
+        entry.params = best.llama_model_params;
+        LlamaTuningStore store(store_path);
+        result.stored = store.store(entry);
+        if (!result.stored)
+        {
+            result.errorMessage = "Failed to store the tuned parameters in " + store_path;
+        }
+        return result;
+    }
+
+    void printTuningResult(const HegemonikonTuningResult &result)
+    {
+        std::cout << std::fixed << std::setprecision(2);
+        for (const HegemonikonTuningCandidate &candidate : result.candidates)
+        {
+            const HegemonikonLlamaModelParams &p = candidate.llama_model_params;
+            std::cout << "  gpu_layers=" << p.n_gpu_layers << " batch=" << p.n_batch << " threads=" << p.n_threads
+                      << " ctx=" << p.n_ctx << " kv=" << p.cache_type_k << " fa=" << p.flash_attn << ": ";
+            if (!candidate.metrics.success)
+            {
+                std::cout << "FAILED: " << candidate.metrics.errorMessage << std::endl;
+                continue;
+            }
+            std::cout << candidate.metrics.avg_ttft_ms << " ms TTFT, " << candidate.metrics.tokens_per_second
+                      << " tokens/sec, " << candidate.metrics.memory_usage_mb << " MB"
+                      << (candidate.feasible ? "" : " (constraint missed)") << std::endl;
+        }
+        if (!result.success)
+        {
+            std::cout << "  FAILED: " << result.errorMessage << std::endl;
+        }
+    }
+
     void printBenchmarkResult(const HegemonikonBenchmarkResult &result)
     {
         if (!result.metrics.success)
@@ -340,7 +722,8 @@ public:
         std::cout << std::fixed << std::setprecision(2);
         std::cout << "  Load Time:          " << result.metrics.load_time_ms << " ms" << std::endl;
         std::cout << "  Avg TTFT:           " << result.metrics.avg_ttft_ms << " ms" << std::endl;
-        std::cout << "  Avg Decode Speed:   " << result.metrics.avg_decode_time_ms << " tokens/sec" << std::endl;
+        std::cout << "  Avg Decode Time:    " << result.metrics.avg_decode_time_ms << " ms" << std::endl;
+        std::cout << "  Avg Decode Speed:   " << result.metrics.tokens_per_second << " tokens/sec" << std::endl;
         std::cout << "  Avg E2E Latency:    " << result.metrics.avg_end_to_end_time_latency_ms << " ms" << std::endl;
         std::cout << "  Latency (P50/P95/P99): "
                   << result.metrics.p50_latency_ms << " / "
@@ -358,13 +741,13 @@ public:
         auto fastest = std::max_element(results.begin(), results.end(),
                                         [](const HegemonikonBenchmarkResult &a, const HegemonikonBenchmarkResult &b)
                                         {
-                                            return a.metrics.success && b.metrics.success ? a.metrics.avg_decode_time_ms < b.metrics.avg_decode_time_ms : !a.metrics.success;
+                                            return a.metrics.success && b.metrics.success ? a.metrics.tokens_per_second < b.metrics.tokens_per_second : !a.metrics.success;
                                         });
 
         if (fastest != results.end() && fastest->metrics.success)
         {
             std::cout << "Fastest model (by decode TPS): " << fastest->model_id
-                      << " (" << fastest->metrics.avg_decode_time_ms << " tokens/sec)" << std::endl;
+                      << " (" << fastest->metrics.tokens_per_second << " tokens/sec)" << std::endl;
         }
 
         int successful = std::count_if(results.begin(), results.end(),
@@ -374,6 +757,19 @@ public:
                   << " (" << (100.0 * successful / results.size()) << "%)" << std::endl;
     }
 
+    /**
+     * @brief Writes benchmark results to a JSON file, for comparing runs across builds.
+     */
+    static bool saveResultsJson(const std::vector<HegemonikonBenchmarkResult> &results, const std::string &path)
+    {
+        json list = json::array();
+        for (const HegemonikonBenchmarkResult &result : results)
+        {
+            list.push_back(result.to_json());
+        }
+        return write_benchmark_json(path, json{{"benchmark", "llama"}, {"results", list}});
+    }
+
     void setBenchmarkPrompts(const std::vector<std::string> &prompts)
     {
         benchmark_prompts = prompts;
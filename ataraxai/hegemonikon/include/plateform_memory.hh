@@ -68,16 +68,14 @@ public:
     
 private:
     static int protection_to_native(Protection protection);
-    static thread_local std::string last_error;
+    static inline thread_local std::string last_error;
 };
 
-thread_local std::string PlatformMemory::last_error;
-
 // Implement the new methods for all platforms
 
 #ifdef __linux__
 
-void* PlatformMemory::allocate_protected(size_t size) {
+inline void* PlatformMemory::allocate_protected(size_t size) {
     void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
     if (ptr == MAP_FAILED) {
@@ -87,21 +85,21 @@ void* PlatformMemory::allocate_protected(size_t size) {
     return ptr;
 }
 
-void PlatformMemory::deallocate_protected(void* ptr, size_t size) {
+inline void PlatformMemory::deallocate_protected(void* ptr, size_t size) {
     if (ptr && munmap(ptr, size) != 0) {
         last_error = "munmap failed: " + std::to_string(errno);
     }
 }
 
-bool PlatformMemory::protect_readonly(void* ptr, size_t size) {
+inline bool PlatformMemory::protect_readonly(void* ptr, size_t size) {
     return protect_memory(ptr, size, Protection::READ);
 }
 
-bool PlatformMemory::protect_readwrite(void* ptr, size_t size) {
+inline bool PlatformMemory::protect_readwrite(void* ptr, size_t size) {
     return protect_memory(ptr, size, Protection::READ_WRITE);
 }
 
-bool PlatformMemory::lock_memory(void* ptr, size_t size) {
+inline bool PlatformMemory::lock_memory(void* ptr, size_t size) {
     if (!ptr || size == 0) {
         last_error = "Invalid parameters";
         return false;
@@ -127,7 +125,7 @@ bool PlatformMemory::lock_memory(void* ptr, size_t size) {
     return false;
 }
 
-bool PlatformMemory::unlock_memory(void* ptr, size_t size) {
+inline bool PlatformMemory::unlock_memory(void* ptr, size_t size) {
     if (!ptr || size == 0) {
         last_error = "Invalid parameters";
         return false;
@@ -150,7 +148,7 @@ bool PlatformMemory::unlock_memory(void* ptr, size_t size) {
     return false;
 }
 
-bool PlatformMemory::protect_memory(void* ptr, size_t size, Protection protection) {
+inline bool PlatformMemory::protect_memory(void* ptr, size_t size, Protection protection) {
     if (!ptr || size == 0) {
         last_error = "Invalid parameters";
         return false;
@@ -177,7 +175,7 @@ bool PlatformMemory::protect_memory(void* ptr, size_t size, Protection protectio
     return false;
 }
 
-size_t PlatformMemory::get_page_size() {
+inline size_t PlatformMemory::get_page_size() {
     static size_t page_size = 0;
     if (page_size == 0) {
         page_size = static_cast<size_t>(getpagesize());
@@ -185,7 +183,7 @@ size_t PlatformMemory::get_page_size() {
     return page_size;
 }
 
-void* PlatformMemory::allocate_aligned(size_t size, size_t alignment) {
+inline void* PlatformMemory::allocate_aligned(size_t size, size_t alignment) {
     if (size == 0 || alignment == 0 || (alignment & (alignment - 1)) != 0) {
         last_error = "Invalid size or alignment (must be power of 2)";
         return nullptr;
@@ -198,26 +196,26 @@ void* PlatformMemory::allocate_aligned(size_t size, size_t alignment) {
     return ptr;
 }
 
-void PlatformMemory::deallocate_aligned(void* ptr) {
+inline void PlatformMemory::deallocate_aligned(void* ptr) {
     if (ptr) {
         free(ptr);
     }
 }
 
-bool PlatformMemory::is_memory_locked(void* ptr, size_t size) {
+inline bool PlatformMemory::is_memory_locked(void* ptr, size_t size) {
     return true; 
 }
 
-size_t PlatformMemory::get_memory_usage() {
+inline size_t PlatformMemory::get_memory_usage() {
     return 0; 
 }
 
-bool PlatformMemory::flush_instruction_cache(void* ptr, size_t size) {
+inline bool PlatformMemory::flush_instruction_cache(void* ptr, size_t size) {
     __builtin___clear_cache(static_cast<char*>(ptr), static_cast<char*>(ptr) + size);
     return true;
 }
 
-int PlatformMemory::protection_to_native(Protection protection) {
+inline int PlatformMemory::protection_to_native(Protection protection) {
     int prot = 0;
     if (static_cast<int>(protection) & static_cast<int>(Protection::READ)) {
         prot |= PROT_READ;
@@ -238,7 +236,7 @@ int PlatformMemory::protection_to_native(Protection protection) {
 
 #ifdef _WIN32
 
-void* PlatformMemory::allocate_protected(size_t size) {
+inline void* PlatformMemory::allocate_protected(size_t size) {
     void* ptr = VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
     if (!ptr) {
         last_error = "VirtualAlloc failed: " + std::to_string(GetLastError());
@@ -246,22 +244,22 @@ void* PlatformMemory::allocate_protected(size_t size) {
     return ptr;
 }
 
-void PlatformMemory::deallocate_protected(void* ptr, size_t size) {
+inline void PlatformMemory::deallocate_protected(void* ptr, size_t size) {
     (void)size; // Size not needed for VirtualFree
     if (ptr && !VirtualFree(ptr, 0, MEM_RELEASE)) {
         last_error = "VirtualFree failed: " + std::to_string(GetLastError());
     }
 }
 
-bool PlatformMemory::protect_readonly(void* ptr, size_t size) {
+inline bool PlatformMemory::protect_readonly(void* ptr, size_t size) {
     return protect_memory(ptr, size, Protection::READ);
 }
 
-bool PlatformMemory::protect_readwrite(void* ptr, size_t size) {
+inline bool PlatformMemory::protect_readwrite(void* ptr, size_t size) {
     return protect_memory(ptr, size, Protection::READ_WRITE);
 }
 
-bool PlatformMemory::lock_memory(void* ptr, size_t size) {
+inline bool PlatformMemory::lock_memory(void* ptr, size_t size) {
     if (!ptr || size == 0) {
         last_error = "Invalid parameters";
         return false;
@@ -288,7 +286,7 @@ bool PlatformMemory::lock_memory(void* ptr, size_t size) {
     return false;
 }
 
-bool PlatformMemory::unlock_memory(void* ptr, size_t size) {
+inline bool PlatformMemory::unlock_memory(void* ptr, size_t size) {
     if (!ptr || size == 0) {
         last_error = "Invalid parameters";
         return false;
@@ -312,7 +310,7 @@ bool PlatformMemory::unlock_memory(void* ptr, size_t size) {
     return false;
 }
 
-bool PlatformMemory::protect_memory(void* ptr, size_t size, Protection protection) {
+inline bool PlatformMemory::protect_memory(void* ptr, size_t size, Protection protection) {
     if (!ptr || size == 0) {
         last_error = "Invalid parameters";
         return false;
@@ -339,7 +337,7 @@ bool PlatformMemory::protect_memory(void* ptr, size_t size, Protection protectio
     return false;
 }
 
-size_t PlatformMemory::get_page_size() {
+inline size_t PlatformMemory::get_page_size() {
     static size_t page_size = 0;
     if (page_size == 0) {
         SYSTEM_INFO si;
@@ -349,7 +347,7 @@ size_t PlatformMemory::get_page_size() {
     return page_size;
 }
 
-void* PlatformMemory::allocate_aligned(size_t size, size_t alignment) {
+inline void* PlatformMemory::allocate_aligned(size_t size, size_t alignment) {
     if (size == 0 || alignment == 0 || (alignment & (alignment - 1)) != 0) {
         last_error = "Invalid size or alignment (must be power of 2)";
         return nullptr;
@@ -362,13 +360,13 @@ void* PlatformMemory::allocate_aligned(size_t size, size_t alignment) {
     return ptr;
 }
 
-void PlatformMemory::deallocate_aligned(void* ptr) {
+inline void PlatformMemory::deallocate_aligned(void* ptr) {
     if (ptr) {
         _aligned_free(ptr);
     }
 }
 
-bool PlatformMemory::is_memory_locked(void* ptr, size_t size) {
+inline bool PlatformMemory::is_memory_locked(void* ptr, size_t size) {
     MEMORY_BASIC_INFORMATION mbi;
     if (VirtualQuery(ptr, &mbi, sizeof(mbi)) == sizeof(mbi)) {
         return (mbi.State & MEM_COMMIT) && !(mbi.State & MEM_FREE);
@@ -376,7 +374,7 @@ bool PlatformMemory::is_memory_locked(void* ptr, size_t size) {
     return false;
 }
 
-size_t PlatformMemory::get_memory_usage() {
+inline size_t PlatformMemory::get_memory_usage() {
     PROCESS_MEMORY_COUNTERS pmc;
     if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) {
         return pmc.WorkingSetSize;
@@ -384,11 +382,11 @@ size_t PlatformMemory::get_memory_usage() {
     return 0;
 }
 
-bool PlatformMemory::flush_instruction_cache(void* ptr, size_t size) {
+inline bool PlatformMemory::flush_instruction_cache(void* ptr, size_t size) {
     return FlushInstructionCache(GetCurrentProcess(), ptr, size) != FALSE;
 }
 
-int PlatformMemory::protection_to_native(Protection protection) {
+inline int PlatformMemory::protection_to_native(Protection protection) {
     switch (protection) {
         case Protection::NONE:
             return PAGE_NOACCESS;
@@ -413,7 +411,7 @@ int PlatformMemory::protection_to_native(Protection protection) {
 
 #ifdef __APPLE__
 
-void* PlatformMemory::allocate_protected(size_t size) {
+inline void* PlatformMemory::allocate_protected(size_t size) {
     void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
     if (ptr == MAP_FAILED) {
@@ -423,21 +421,21 @@ void* PlatformMemory::allocate_protected(size_t size) {
     return ptr;
 }
 
-void PlatformMemory::deallocate_protected(void* ptr, size_t size) {
+inline void PlatformMemory::deallocate_protected(void* ptr, size_t size) {
     if (ptr && munmap(ptr, size) != 0) {
         last_error = "munmap failed: " + std::to_string(errno);
     }
 }
 
-bool PlatformMemory::protect_readonly(void* ptr, size_t size) {
+inline bool PlatformMemory::protect_readonly(void* ptr, size_t size) {
     return protect_memory(ptr, size, Protection::READ);
 }
 
-bool PlatformMemory::protect_readwrite(void* ptr, size_t size) {
+inline bool PlatformMemory::protect_readwrite(void* ptr, size_t size) {
     return protect_memory(ptr, size, Protection::READ_WRITE);
 }
 
-bool PlatformMemory::lock_memory(void* ptr, size_t size) {
+inline bool PlatformMemory::lock_memory(void* ptr, size_t size) {
     if (!ptr || size == 0) {
         last_error = "Invalid parameters";
         return false;
@@ -463,7 +461,7 @@ bool PlatformMemory::lock_memory(void* ptr, size_t size) {
     return false;
 }
 
-bool PlatformMemory::unlock_memory(void* ptr, size_t size) {
+inline bool PlatformMemory::unlock_memory(void* ptr, size_t size) {
     if (!ptr || size == 0) {
         last_error = "Invalid parameters";
         return false;
@@ -486,7 +484,7 @@ bool PlatformMemory::unlock_memory(void* ptr, size_t size) {
     return false;
 }
 
-bool PlatformMemory::protect_memory(void* ptr, size_t size, Protection protection) {
+inline bool PlatformMemory::protect_memory(void* ptr, size_t size, Protection protection) {
     if (!ptr || size == 0) {
         last_error = "Invalid parameters";
         return false;
@@ -513,7 +511,7 @@ bool PlatformMemory::protect_memory(void* ptr, size_t size, Protection protectio
     return false;
 }
 
-size_t PlatformMemory::get_page_size() {
+inline size_t PlatformMemory::get_page_size() {
     static size_t page_size = 0;
     if (page_size == 0) {
         page_size = static_cast<size_t>(getpagesize());
@@ -521,7 +519,7 @@ size_t PlatformMemory::get_page_size() {
     return page_size;
 }
 
-void* PlatformMemory::allocate_aligned(size_t size, size_t alignment) {
+inline void* PlatformMemory::allocate_aligned(size_t size, size_t alignment) {
     if (size == 0 || alignment == 0 || (alignment & (alignment - 1)) != 0) {
         last_error = "Invalid size or alignment (must be power of 2)";
         return nullptr;
@@ -536,17 +534,17 @@ void* PlatformMemory::allocate_aligned(size_t size, size_t alignment) {
     return nullptr;
 }
 
-void PlatformMemory::deallocate_aligned(void* ptr) {
+inline void PlatformMemory::deallocate_aligned(void* ptr) {
     if (ptr) {
         free(ptr);
     }
 }
 
-bool PlatformMemory::is_memory_locked(void* ptr, size_t size) {
+inline bool PlatformMemory::is_memory_locked(void* ptr, size_t size) {
     return true; 
 }
 
-size_t PlatformMemory::get_memory_usage() {
+inline size_t PlatformMemory::get_memory_usage() {
     mach_task_basic_info_data_t info;
     mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
     
@@ -557,12 +555,12 @@ size_t PlatformMemory::get_memory_usage() {
     return 0;
 }
 
-bool PlatformMemory::flush_instruction_cache(void* ptr, size_t size) {
+inline bool PlatformMemory::flush_instruction_cache(void* ptr, size_t size) {
     __builtin___clear_cache(static_cast<char*>(ptr), static_cast<char*>(ptr) + size);
     return true;
 }
 
-int PlatformMemory::protection_to_native(Protection protection) {
+inline int PlatformMemory::protection_to_native(Protection protection) {
     int prot = 0;
     if (static_cast<int>(protection) & static_cast<int>(Protection::READ)) {
         prot |= PROT_READ;
@@ -583,7 +581,7 @@ int PlatformMemory::protection_to_native(Protection protection) {
 
 #ifdef __FreeBSD__
 
-void* PlatformMemory::allocate_protected(size_t size) {
+inline void* PlatformMemory::allocate_protected(size_t size) {
     void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
     if (ptr == MAP_FAILED) {
@@ -593,21 +591,21 @@ void* PlatformMemory::allocate_protected(size_t size) {
     return ptr;
 }
 
-void PlatformMemory::deallocate_protected(void* ptr, size_t size) {
+inline void PlatformMemory::deallocate_protected(void* ptr, size_t size) {
     if (ptr && munmap(ptr, size) != 0) {
         last_error = "munmap failed: " + std::to_string(errno);
     }
 }
 
-bool PlatformMemory::protect_readonly(void* ptr, size_t size) {
+inline bool PlatformMemory::protect_readonly(void* ptr, size_t size) {
     return protect_memory(ptr, size, Protection::READ);
 }
 
-bool PlatformMemory::protect_readwrite(void* ptr, size_t size) {
+inline bool PlatformMemory::protect_readwrite(void* ptr, size_t size) {
     return protect_memory(ptr, size, Protection::READ_WRITE);
 }
 
-bool PlatformMemory::lock_memory(void* ptr, size_t size) {
+inline bool PlatformMemory::lock_memory(void* ptr, size_t size) {
     if (!ptr || size == 0) {
         last_error = "Invalid parameters";
         return false;
@@ -633,7 +631,7 @@ bool PlatformMemory::lock_memory(void* ptr, size_t size) {
     return false;
 }
 
-bool PlatformMemory::unlock_memory(void* ptr, size_t size) {
+inline bool PlatformMemory::unlock_memory(void* ptr, size_t size) {
     if (!ptr || size == 0) {
         last_error = "Invalid parameters";
         return false;
@@ -656,7 +654,7 @@ bool PlatformMemory::unlock_memory(void* ptr, size_t size) {
     return false;
 }
 
-bool PlatformMemory::protect_memory(void* ptr, size_t size, Protection protection) {
+inline bool PlatformMemory::protect_memory(void* ptr, size_t size, Protection protection) {
     if (!ptr || size == 0) {
         last_error = "Invalid parameters";
         return false;
@@ -683,7 +681,7 @@ bool PlatformMemory::protect_memory(void* ptr, size_t size, Protection protectio
     return false;
 }
 
-size_t PlatformMemory::get_page_size() {
+inline size_t PlatformMemory::get_page_size() {
     static size_t page_size = 0;
     if (page_size == 0) {
         page_size = static_cast<size_t>(getpagesize());
@@ -691,7 +689,7 @@ size_t PlatformMemory::get_page_size() {
     return page_size;
 }
 
-void* PlatformMemory::allocate_aligned(size_t size, size_t alignment) {
+inline void* PlatformMemory::allocate_aligned(size_t size, size_t alignment) {
     if (size == 0 || alignment == 0 || (alignment & (alignment - 1)) != 0) {
         last_error = "Invalid size or alignment (must be power of 2)";
         return nullptr;
@@ -706,26 +704,26 @@ void* PlatformMemory::allocate_aligned(size_t size, size_t alignment) {
     return nullptr;
 }
 
-void PlatformMemory::deallocate_aligned(void* ptr) {
+inline void PlatformMemory::deallocate_aligned(void* ptr) {
     if (ptr) {
         free(ptr);
     }
 }
 
-bool PlatformMemory::is_memory_locked(void* ptr, size_t size) {
+inline bool PlatformMemory::is_memory_locked(void* ptr, size_t size) {
     return true; 
 }
 
-size_t PlatformMemory::get_memory_usage() {
+inline size_t PlatformMemory::get_memory_usage() {
     return 0;
 }
 
-bool PlatformMemory::flush_instruction_cache(void* ptr, size_t size) {
+inline bool PlatformMemory::flush_instruction_cache(void* ptr, size_t size) {
     __builtin___clear_cache(static_cast<char*>(ptr), static_cast<char*>(ptr) + size);
     return true;
 }
 
-int PlatformMemory::protection_to_native(Protection protection) {
+inline int PlatformMemory::protection_to_native(Protection protection) {
     int prot = 0;
     if (static_cast<int>(protection) & static_cast<int>(Protection::READ)) {
         prot |= PROT_READ;
@@ -744,12 +742,12 @@ int PlatformMemory::protection_to_native(Protection protection) {
 
 #endif
 
-std::string PlatformMemory::get_last_error() {
+inline std::string PlatformMemory::get_last_error() {
     return last_error;
 }
 
 namespace PlatformMemoryUtils {
-    bool is_platform_supported() {
+    inline bool is_platform_supported() {
         #if defined(__linux__) || defined(_WIN32) || defined(__APPLE__) || defined(__FreeBSD__)
             return true;
         #else
@@ -757,7 +755,7 @@ namespace PlatformMemoryUtils {
         #endif
     }
     
-    std::string get_platform_name() {
+    inline std::string get_platform_name() {
         #ifdef __linux__
             return "Linux";
         #elif _WIN32
@@ -771,11 +769,11 @@ namespace PlatformMemoryUtils {
         #endif
     }
     
-    size_t align_size(size_t size, size_t alignment) {
+    inline size_t align_size(size_t size, size_t alignment) {
         return (size + alignment - 1) & ~(alignment - 1);
     }
     
-    bool is_power_of_two(size_t value) {
+    inline bool is_power_of_two(size_t value) {
         return value != 0 && (value & (value - 1)) == 0;
     }
 }
\ No newline at end of file
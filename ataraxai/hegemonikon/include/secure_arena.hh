@@ -0,0 +1,105 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Counters of a SecureArena.
+ *
+ * `lock_calls` counts mlock/VirtualLock calls: one per region plus one per large block.
+ * `locked_bytes` is what they locked, which counts against RLIMIT_MEMLOCK.
+ */
+struct SecureArenaStats
+{
+    size_t regions = 0;
+    size_t locked_bytes = 0;
+    size_t lock_calls = 0;
+    size_t blocks_in_use = 0;
+    size_t bytes_in_use = 0;
+    size_t large_blocks = 0;
+
+    std::string to_string() const
+    {
+        return "SecureArenaStats(regions=" + std::to_string(regions) +
+               ", locked_bytes=" + std::to_string(locked_bytes) +
+               ", lock_calls=" + std::to_string(lock_calls) +
+               ", blocks_in_use=" + std::to_string(blocks_in_use) +
+               ", bytes_in_use=" + std::to_string(bytes_in_use) +
+               ", large_blocks=" + std::to_string(large_blocks) + ")";
+    }
+};
+
+/**
+ * @brief Slab allocator of locked memory for secrets.
+ *
+ * Regions of several pages are allocated and locked once. Their pages are then handed
+ * out on demand to power-of-two size classes (16 to 2048 bytes), one class per page, and
+ * split into blocks kept on a free list per class. A block is zeroed when it is freed,
+ * so the free list never holds secret bytes, and it is handed out zeroed. Regions stay
+ * locked for the arena's lifetime; only their blocks are recycled.
+ *
+ * Requests above the largest class get their own page-rounded locked allocation, as
+ * before, which is wiped, unlocked and freed on deallocate().
+ *
+ * deallocate() must be given the size passed to allocate(): it selects the class. All
+ * methods are thread-safe.
+ */
+class SecureArena
+{
+public:
+    static constexpr size_t MIN_BLOCK_SIZE = 16;
+    static constexpr size_t MAX_BLOCK_SIZE = 2048;
+    static constexpr size_t DEFAULT_REGION_SIZE = 32 * 1024;
+
+    /**
+     * @brief Arena shared by SecureString, LockedMemory, SecureKey and SecureAllocator.
+     */
+    static SecureArena &instance();
+
+    explicit SecureArena(size_t region_size = DEFAULT_REGION_SIZE);
+    ~SecureArena();
+
+    SecureArena(const SecureArena &) = delete;
+    SecureArena &operator=(const SecureArena &) = delete;
+
+    void *allocate(size_t size);
+    void deallocate(void *ptr, size_t size);
+
+    /**
+     * @brief Bytes actually reserved for a request of `size` bytes.
+     */
+    static size_t block_size(size_t size);
+
+    SecureArenaStats get_stats() const;
+
+private:
+    static constexpr size_t N_CLASSES = 8;
+
+    struct FreeBlock
+    {
+        FreeBlock *next;
+    };
+
+    struct Region
+    {
+        char *base;
+        size_t size;
+    };
+
+    static size_t class_index(size_t size);
+
+    char *take_page();
+
+    size_t region_size_;
+    size_t page_size_;
+
+    mutable std::mutex mutex_;
+    std::vector<Region> regions_;
+    size_t next_page_offset_ = 0;
+    std::array<FreeBlock *, N_CLASSES> free_lists_{};
+    SecureArenaStats stats_;
+};
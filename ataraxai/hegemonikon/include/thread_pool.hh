@@ -0,0 +1,168 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/**
+ * @brief Fixed-size pool of worker threads for CPU-bound helper work.
+ *
+ * Used for work that is embarrassingly parallel over read-only model state, such as
+ * tokenizing many RAG chunks against the same vocabulary. Tasks are run in FIFO order;
+ * the destructor drains the queue and joins the workers.
+ */
+class ThreadPool
+{
+public:
+    /**
+     * @brief Starts the workers.
+     *
+     * @param n_threads Number of worker threads, 0 for the hardware concurrency.
+     */
+    explicit ThreadPool(size_t n_threads = 0)
+    {
+        if (n_threads == 0)
+        {
+            n_threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        workers_.reserve(n_threads);
+        for (size_t i = 0; i < n_threads; ++i)
+        {
+            workers_.emplace_back([this]()
+                                  { worker_loop(); });
+        }
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        cv_.notify_all();
+        for (auto &worker : workers_)
+        {
+            if (worker.joinable())
+            {
+                worker.join();
+            }
+        }
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    size_t size() const { return workers_.size(); }
+
+    /**
+     * @brief Queues a callable and returns a future for its result.
+     */
+    template <typename F>
+    auto submit(F &&fn) -> std::future<std::invoke_result_t<std::decay_t<F>>>
+    {
+        using result_t = std::invoke_result_t<std::decay_t<F>>;
+        auto task = std::make_shared<std::packaged_task<result_t()>>(std::forward<F>(fn));
+        std::future<result_t> future = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            tasks_.emplace_back([task]()
+                                { (*task)(); });
+        }
+        cv_.notify_one();
+        return future;
+    }
+
+    /**
+     * @brief Runs `fn(begin, end)` over contiguous sub-ranges of [0, n) and waits for all of them.
+     *
+     * The range is split into at most one chunk per worker (and no chunk smaller than
+     * `min_chunk`); the calling thread processes the first chunk itself. Exceptions thrown
+     * by `fn` are rethrown here.
+     *
+     * @param n         Number of items.
+     * @param fn        Callable taking (begin, end) indices.
+     * @param min_chunk Minimum number of items per chunk.
+     */
+    template <typename F>
+    void parallel_for(size_t n, F &&fn, size_t min_chunk = 1)
+    {
+        if (n == 0)
+        {
+            return;
+        }
+        const size_t max_chunks = std::max<size_t>(1, n / std::max<size_t>(1, min_chunk));
+        const size_t n_chunks = std::min(max_chunks, size() + 1);
+        const size_t chunk = (n + n_chunks - 1) / n_chunks;
+
+        std::vector<std::future<void>> pending;
+        pending.reserve(n_chunks);
+        for (size_t begin = chunk; begin < n; begin += chunk)
+        {
+            const size_t end = std::min(n, begin + chunk);
+            pending.push_back(submit([&fn, begin, end]()
+                                     { fn(begin, end); }));
+        }
+
+        std::exception_ptr error;
+        try
+        {
+            fn(size_t{0}, std::min(n, chunk));
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+        for (auto &future : pending)
+        {
+            try
+            {
+                future.get();
+            }
+            catch (...)
+            {
+                if (!error)
+                    error = std::current_exception();
+            }
+        }
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    std::vector<std::thread> workers_;
+    std::deque<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stopping_ = false;
+
+    void worker_loop()
+    {
+        while (true)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [this]()
+                         { return stopping_ || !tasks_.empty(); });
+                if (tasks_.empty())
+                {
+                    return;
+                }
+                task = std::move(tasks_.front());
+                tasks_.pop_front();
+            }
+            task();
+        }
+    }
+};
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Counters of the trace recorder.
+ */
+struct HegemonikonTraceStats
+{
+    bool enabled = false;
+    uint32_t n_threads = 0;
+    uint64_t events_recorded = 0;
+    uint64_t events_overwritten = 0;
+    size_t events_per_thread = 0;
+
+    std::string to_string() const
+    {
+        return "HegemonikonTraceStats(enabled=" + std::string(enabled ? "true" : "false") +
+               ", n_threads=" + std::to_string(n_threads) +
+               ", events_recorded=" + std::to_string(events_recorded) +
+               ", events_overwritten=" + std::to_string(events_overwritten) +
+               ", events_per_thread=" + std::to_string(events_per_thread) + ")";
+    }
+};
+
+/**
+ * @brief Process-wide recorder of timed spans, exported as a Chrome trace.
+ *
+ * Each thread writes its spans to its own ring buffer, allocated the first time it
+ * records while tracing is enabled; a full ring overwrites its oldest spans. Writing a
+ * span is a handful of relaxed atomic stores and takes no lock, so spans can mark single
+ * decode steps. Readers copy the rings under a per-slot sequence number and skip the
+ * slots being overwritten, which lets a trace be written while recording continues.
+ *
+ * Span names, categories and argument names must be string literals (or otherwise
+ * outlive the recorder): only their pointers are stored.
+ *
+ * The JSON written by write_chrome_trace() opens in chrome://tracing and in Perfetto.
+ */
+class TraceRecorder
+{
+public:
+    static constexpr size_t DEFAULT_EVENTS_PER_THREAD = 1u << 14;
+
+    static TraceRecorder &instance();
+
+    /**
+     * @brief Whether spans are being recorded; a relaxed load, cheap enough for any path.
+     */
+    static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+    static uint64_t now_ns();
+
+    void start(size_t events_per_thread = DEFAULT_EVENTS_PER_THREAD);
+    void stop();
+
+    void record(const char *name, const char *category, uint64_t start_ns, uint64_t end_ns,
+                const char *arg_name = nullptr, int64_t arg = 0);
+    void set_thread_name(const std::string &name);
+
+    std::string to_chrome_trace() const;
+    bool write_chrome_trace(const std::string &path) const;
+    HegemonikonTraceStats get_stats() const;
+
+private:
+    struct Event
+    {
+        // index + 1 of the span in the slot once written, 0 while the slot is rewritten.
+        std::atomic<uint64_t> sequence{0};
+        std::atomic<const char *> name{nullptr};
+        std::atomic<const char *> category{nullptr};
+        std::atomic<const char *> arg_name{nullptr};
+        std::atomic<uint64_t> start_ns{0};
+        std::atomic<uint64_t> duration_ns{0};
+        std::atomic<int64_t> arg{0};
+    };
+
+    struct ThreadBuffer
+    {
+        uint32_t tid = 0;
+        std::string name;
+        std::unique_ptr<Event[]> events;
+        size_t mask = 0;
+        std::atomic<uint64_t> write_index{0};
+    };
+
+    TraceRecorder() = default;
+
+    static std::atomic<bool> enabled_;
+
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers_;
+    size_t events_per_thread_ = DEFAULT_EVENTS_PER_THREAD;
+    std::atomic<uint64_t> session_start_ns_{0};
+
+    ThreadBuffer *thread_buffer();
+};
+
+/**
+ * @brief Records the time from its construction to its destruction as one span.
+ *
+ * Does nothing, not even read the clock, when tracing is disabled at construction.
+ */
+class TraceSpan
+{
+public:
+    TraceSpan(const char *name, const char *category)
+        : name_(name), category_(category), active_(TraceRecorder::enabled()),
+          start_ns_(active_ ? TraceRecorder::now_ns() : 0)
+    {
+    }
+
+    ~TraceSpan()
+    {
+        finish();
+    }
+
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+
+    /**
+     * @brief Attaches a number to the span, e.g. the tokens of a batch.
+     */
+    void set_arg(const char *arg_name, int64_t value)
+    {
+        arg_name_ = arg_name;
+        arg_ = value;
+    }
+
+    /**
+     * @brief Ends the span before the end of its scope.
+     */
+    void finish()
+    {
+        if (active_)
+        {
+            active_ = false;
+            TraceRecorder::instance().record(name_, category_, start_ns_, TraceRecorder::now_ns(), arg_name_, arg_);
+        }
+    }
+
+private:
+    const char *name_;
+    const char *category_;
+    const char *arg_name_ = nullptr;
+    int64_t arg_ = 0;
+    bool active_;
+    uint64_t start_ns_;
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "llama_interface.hh"
+#include "whisper_interface.hh"
+
+/**
+ * @brief Outcome of a transcription followed by a generation over its text.
+ *
+ * `prefilled_tokens` counts the prompt tokens already in the KV cache when the
+ * generation started, decoded while whisper was still transcribing.
+ */
+struct HegemonikonAudioPromptResult
+{
+    HegemonikonTranscription transcription;
+    HegemonikonGenerationResult generation;
+    int32_t prefilled_tokens = 0;
+    double transcribe_ms = 0.0;
+    double total_ms = 0.0;
+
+    bool ok() const { return transcription.ok() && generation.success; }
+
+    std::string to_string() const
+    {
+        return "HegemonikonAudioPromptResult(ok=" + std::string(ok() ? "true" : "false") +
+               ", n_segments=" + std::to_string(transcription.segments.size()) +
+               ", error='" + transcription.error +
+               "', prefilled_tokens=" + std::to_string(prefilled_tokens) +
+               ", transcribe_ms=" + std::to_string(transcribe_ms) +
+               ", total_ms=" + std::to_string(total_ms) +
+               ", generation=" + generation.to_string() + ")";
+    }
+};
+
+/**
+ * @brief Prefills a llama session with a transcript while it is being transcribed.
+ *
+ * Text appended from the transcribing thread is handed to a worker thread, which calls
+ * LlamaInterface::prefill_session with the prompt prefix followed by the transcript so
+ * far. Texts appended while a prefill runs are coalesced into the next one, so the
+ * worker never falls behind by more than one prefill. Once the transcription ends, the
+ * generation request with the complete prompt and the same session id only decodes the
+ * tokens held back at the end of the transcript and the instruction that follows it.
+ */
+class TranscriptPrefiller
+{
+public:
+    static constexpr size_t HOLD_BACK_TOKENS = 4;
+
+    TranscriptPrefiller(LlamaInterface *llama, std::string prompt_prefix, HegemonikonGenerationParams params);
+    ~TranscriptPrefiller();
+
+    TranscriptPrefiller(const TranscriptPrefiller &) = delete;
+    TranscriptPrefiller &operator=(const TranscriptPrefiller &) = delete;
+
+    void append(const std::string &text);
+    std::string finish();
+    int32_t prefilled_tokens() const;
+
+private:
+    LlamaInterface *llama_;
+    std::string prompt_prefix_;
+    HegemonikonGenerationParams params_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable changed_;
+    std::string transcript_;
+    // Length of transcript_ taken by the last prefill.
+    size_t n_submitted_ = 0;
+    int32_t prefilled_tokens_ = 0;
+    bool finishing_ = false;
+    std::thread worker_;
+
+    void run();
+};
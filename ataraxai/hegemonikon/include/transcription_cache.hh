@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "whisper_interface.hh"
+
+/**
+ * @brief Counters of the transcription cache.
+ */
+struct HegemonikonTranscriptionCacheStats
+{
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t insertions = 0;
+    uint64_t evictions = 0;
+    uint64_t entries = 0;
+    uint64_t bytes = 0;
+    uint64_t max_bytes = 0;
+
+    std::string to_string() const
+    {
+        return "HegemonikonTranscriptionCacheStats(hits=" + std::to_string(hits) +
+               ", misses=" + std::to_string(misses) +
+               ", insertions=" + std::to_string(insertions) +
+               ", evictions=" + std::to_string(evictions) +
+               ", entries=" + std::to_string(entries) +
+               ", bytes=" + std::to_string(bytes) +
+               ", max_bytes=" + std::to_string(max_bytes) + ")";
+    }
+};
+
+/**
+ * @brief Persistent cache of transcriptions, keyed by audio content and parameters.
+ *
+ * An entry is one file named `<content_digest>-<params_digest>.hwcache` holding the
+ * segments (and tokens) of a transcription. The content digest is a BLAKE2b-128 of the
+ * bytes of the audio file, so a renamed, touched or re-indexed file whose content did
+ * not change is a hit; the params digest covers the model and generation parameters and
+ * the size and modification time of the model file. The files take at most `max_bytes`:
+ * the least recently used entries are removed first, and a hit refreshes the
+ * modification time of its file so that the order survives restarts.
+ *
+ * All methods are thread-safe.
+ */
+class TranscriptionCache
+{
+public:
+    static constexpr const char *FILE_EXTENSION = ".hwcache";
+    static constexpr uint64_t DEFAULT_MAX_BYTES = 256ull << 20;
+
+    TranscriptionCache() = default;
+
+    TranscriptionCache(const TranscriptionCache &) = delete;
+    TranscriptionCache &operator=(const TranscriptionCache &) = delete;
+
+    bool open(const std::string &directory, uint64_t max_bytes, std::string &error);
+    void close();
+    bool is_open() const;
+
+    static bool hash_file(const std::string &path, std::string &digest, std::string &error);
+    static std::string make_key(const std::string &content_digest,
+                                const HegemonikonWhisperModelParams &model_params,
+                                const HegemonikonWhisperGenerationParams &generation_params);
+
+    bool lookup(const std::string &key, HegemonikonTranscription &transcription);
+    bool store(const std::string &key, const HegemonikonTranscription &transcription);
+
+    size_t clear();
+    HegemonikonTranscriptionCacheStats get_stats() const;
+
+    static bool write_file(const std::string &path, const HegemonikonTranscription &transcription);
+    static bool read_file(const std::string &path, HegemonikonTranscription &transcription);
+
+private:
+    struct Entry
+    {
+        uint64_t bytes = 0;
+        std::list<std::string>::iterator position;
+    };
+
+    mutable std::mutex mutex_;
+    std::string directory_;
+    uint64_t max_bytes_ = 0;
+    // Least recently used first.
+    std::list<std::string> lru_;
+    std::unordered_map<std::string, Entry> entries_;
+    HegemonikonTranscriptionCacheStats stats_;
+
+    std::string path_of(const std::string &key) const;
+    void remove_locked(const std::string &key);
+    void evict_locked();
+};
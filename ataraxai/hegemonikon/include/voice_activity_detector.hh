@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief A run of speech, as a half-open range of samples.
+ */
+struct HegemonikonSpeechRegion
+{
+    size_t start = 0;
+    size_t end = 0;
+
+    size_t length() const { return end - start; }
+
+    std::string to_string() const
+    {
+        return "HegemonikonSpeechRegion(start=" + std::to_string(start) +
+               ", end=" + std::to_string(end) + ")";
+    }
+};
+
+/**
+ * @brief Maps positions in speech-only audio back to the audio it was cut from.
+ *
+ * Filled by VoiceActivityDetector::compact(): each kept region is recorded with its
+ * position in the compacted audio and in the original audio.
+ */
+class SpeechTimeline
+{
+public:
+    void clear();
+    bool empty() const { return spans_.empty(); }
+
+    void add(uint64_t original_start, uint64_t length);
+    void skip(uint64_t length);
+
+    uint64_t compact_size() const { return compact_end_; }
+    uint64_t to_original(uint64_t compact_position) const;
+
+private:
+    struct Span
+    {
+        uint64_t compact_start;
+        uint64_t original_start;
+        uint64_t length;
+    };
+
+    std::vector<Span> spans_;
+    uint64_t compact_end_ = 0;
+};
+
+/**
+ * @brief Energy-based voice activity detection on 16 kHz mono audio.
+ *
+ * The audio is high-passed at `freq_thold` Hz, which removes hum and rumble, and cut in
+ * 30 ms frames. A frame is speech when its energy exceeds `vad_thold` times the mean
+ * frame energy of the buffer (and an absolute floor, so that digital silence is never
+ * speech). Speech frames are then padded, pauses shorter than MIN_SILENCE_SAMPLES are
+ * bridged so sentences are not split, and isolated clicks shorter than
+ * MIN_SPEECH_SAMPLES are dropped.
+ */
+class VoiceActivityDetector
+{
+public:
+    static constexpr uint32_t SAMPLE_RATE = 16000;
+    static constexpr size_t FRAME_SAMPLES = SAMPLE_RATE * 30 / 1000;
+    static constexpr size_t PAD_SAMPLES = SAMPLE_RATE * 200 / 1000;
+    static constexpr size_t MIN_SILENCE_SAMPLES = SAMPLE_RATE * 500 / 1000;
+    static constexpr size_t MIN_SPEECH_SAMPLES = SAMPLE_RATE * 100 / 1000;
+    static constexpr size_t GAP_SAMPLES = SAMPLE_RATE * 100 / 1000;
+
+    VoiceActivityDetector(float vad_thold, float freq_thold);
+
+    std::vector<HegemonikonSpeechRegion> detect(const float *samples, size_t n_samples) const;
+
+    size_t compact(const float *samples, size_t n_samples, uint64_t original_offset,
+                   std::vector<float> &out, SpeechTimeline &timeline) const;
+
+private:
+    float vad_thold_;
+    float freq_thold_;
+};
@@ -0,0 +1,459 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "audio_file_decoder.hh"
+#include "benchmarker/system_infos/gpu_info.hh"
+#include "benchmarker/system_infos/memory_usage.hh"
+#include "metrics_registry.hh"
+#include "model_benchmarker.hh"
+#include "whisper_interface.hh"
+
+struct HegemonikonWhisperBenchmarkParams
+{
+    int repetitions = 3;
+    bool warmup = true;
+    HegemonikonWhisperGenerationParams generation_params;
+};
+
+/**
+ * @brief Values swept by the Whisper benchmarker; an empty list keeps the value of the
+ * base parameters.
+ *
+ * `models` are model files, typically the sizes of one family (tiny, base, small...).
+ * `beam_size` and `audio_ctx` are set on the generation parameters, the others on the
+ * model parameters.
+ */
+struct HegemonikonWhisperBenchmarkGrid
+{
+    std::vector<std::string> models;
+    std::vector<int32_t> n_threads;
+    std::vector<int32_t> beam_size;
+    std::vector<bool> flash_attn;
+    std::vector<int32_t> audio_ctx;
+
+    size_t size() const
+    {
+        return std::max<size_t>(1, models.size()) * std::max<size_t>(1, n_threads.size()) *
+               std::max<size_t>(1, beam_size.size()) * std::max<size_t>(1, flash_attn.size()) *
+               std::max<size_t>(1, audio_ctx.size());
+    }
+};
+
+struct HegemonikonWhisperBenchmarkConfiguration
+{
+    HegemonikonWhisperModelParams model_params;
+    HegemonikonWhisperGenerationParams generation_params;
+};
+
+/**
+ * @brief Measurements of one configuration over the whole corpus.
+ *
+ * One repetition transcribes every clip of the corpus. The real-time factor is the
+ * transcription time divided by the duration of the audio, so below 1 is faster than
+ * real time. Encoder and decoder times are summed over the whisper_full calls of a
+ * repetition (the parallel pieces of long clips included). The peak RSS covers the load
+ * and the repetitions; the GPU memory is the growth of the memory used on the NVIDIA
+ * devices from before the load, 0 on CPU or without nvidia-smi.
+ */
+struct HegemonikonWhisperBenchmarkMetrics
+{
+    float load_time_ms = 0.0f;
+    float model_size_mb = 0.0f;
+    float audio_seconds = 0.0f;
+    bool success = false;
+    std::string errorMessage;
+
+    std::vector<float> transcription_time_history_ms;
+    std::vector<float> real_time_factor_history;
+    std::vector<float> encode_time_history_ms;
+    std::vector<float> decode_time_history_ms;
+
+    float avg_transcription_time_ms = 0.0f;
+    float stdev_transcription_time_ms = 0.0f;
+    float p50_transcription_time_ms = 0.0f;
+    float p95_transcription_time_ms = 0.0f;
+    float p99_transcription_time_ms = 0.0f;
+    float real_time_factor = 0.0f;
+    float stdev_real_time_factor = 0.0f;
+    float avg_encode_time_ms = 0.0f;
+    float avg_decode_time_ms = 0.0f;
+
+    float peak_rss_mb = 0.0f;
+    float gpu_memory_mb = 0.0f;
+
+    json to_json() const
+    {
+        return json{{"success", success},
+                    {"error", errorMessage},
+                    {"load_time_ms", load_time_ms},
+                    {"model_size_mb", model_size_mb},
+                    {"audio_seconds", audio_seconds},
+                    {"avg_transcription_time_ms", avg_transcription_time_ms},
+                    {"stdev_transcription_time_ms", stdev_transcription_time_ms},
+                    {"p50_transcription_time_ms", p50_transcription_time_ms},
+                    {"p95_transcription_time_ms", p95_transcription_time_ms},
+                    {"p99_transcription_time_ms", p99_transcription_time_ms},
+                    {"real_time_factor", real_time_factor},
+                    {"stdev_real_time_factor", stdev_real_time_factor},
+                    {"avg_encode_time_ms", avg_encode_time_ms},
+                    {"avg_decode_time_ms", avg_decode_time_ms},
+                    {"peak_rss_mb", peak_rss_mb},
+                    {"gpu_memory_mb", gpu_memory_mb},
+                    {"transcription_time_history_ms", transcription_time_history_ms},
+                    {"real_time_factor_history", real_time_factor_history},
+                    {"encode_time_history_ms", encode_time_history_ms},
+                    {"decode_time_history_ms", decode_time_history_ms}};
+    }
+};
+
+struct HegemonikonWhisperBenchmarkResult
+{
+    std::string model_id;
+    HegemonikonWhisperModelParams model_params;
+    HegemonikonWhisperGenerationParams generation_params;
+    HegemonikonWhisperBenchmarkMetrics metrics;
+    std::string transcript;
+
+    HegemonikonWhisperBenchmarkResult(const std::string &id) : model_id(id) {}
+
+    void calculateStatistics()
+    {
+        const std::vector<float> &times = metrics.transcription_time_history_ms;
+        if (!times.empty())
+        {
+            metrics.avg_transcription_time_ms = avg(times);
+            metrics.stdev_transcription_time_ms = stdev(times);
+            metrics.p50_transcription_time_ms = percentile(times, 0.50);
+            metrics.p95_transcription_time_ms = percentile(times, 0.95);
+            metrics.p99_transcription_time_ms = percentile(times, 0.99);
+        }
+        if (!metrics.real_time_factor_history.empty())
+        {
+            metrics.real_time_factor = avg(metrics.real_time_factor_history);
+            metrics.stdev_real_time_factor = stdev(metrics.real_time_factor_history);
+        }
+        if (!metrics.encode_time_history_ms.empty())
+        {
+            metrics.avg_encode_time_ms = avg(metrics.encode_time_history_ms);
+        }
+        if (!metrics.decode_time_history_ms.empty())
+        {
+            metrics.avg_decode_time_ms = avg(metrics.decode_time_history_ms);
+        }
+    }
+
+    json to_json() const
+    {
+        return json{{"model_id", model_id},
+                    {"model", model_params.model},
+                    {"n_threads", model_params.n_threads},
+                    {"use_gpu", model_params.use_gpu},
+                    {"flash_attn", model_params.flash_attn},
+                    {"n_processors", model_params.n_processors},
+                    {"beam_size", generation_params.beam_size},
+                    {"audio_ctx", generation_params.audio_ctx},
+                    {"metrics", metrics.to_json()}};
+    }
+};
+
+/**
+ * @brief Benchmarks Whisper models on a corpus of audio files.
+ *
+ * The corpus is decoded once to 16 kHz mono PCM and kept in memory, so file decoding is
+ * not measured. Every configuration loads its model again in a WhisperInterface of its own.
+ */
+class HegemonikonWhisperBenchmarker
+{
+private:
+    std::vector<std::vector<float>> corpus;
+    std::vector<std::string> corpus_names;
+    std::atomic<bool> cancellation_requested{false};
+
+public:
+    HegemonikonWhisperBenchmarker() = default;
+
+    void requestCancellation()
+    {
+        cancellation_requested.store(true);
+    }
+
+    void resetCancellation()
+    {
+        cancellation_requested.store(false);
+    }
+
+    /**
+     * @brief Decodes audio files into the corpus, replacing the previous one.
+     *
+     * @return false if a file could not be decoded; the other files are still loaded.
+     */
+    bool loadCorpus(const std::vector<std::string> &paths)
+    {
+        corpus.clear();
+        corpus_names.clear();
+        bool ok = true;
+        std::vector<float> buffer(AudioFileDecoder::SAMPLE_RATE);
+        for (const std::string &path : paths)
+        {
+            AudioFileDecoder decoder;
+            if (!decoder.open(path))
+            {
+                std::cerr << "Whisper Benchmark Error: " << decoder.error() << std::endl;
+                ok = false;
+                continue;
+            }
+            std::vector<float> pcm;
+            size_t n_read = 0;
+            while ((n_read = decoder.read(buffer.data(), buffer.size())) > 0)
+            {
+                pcm.insert(pcm.end(), buffer.begin(), buffer.begin() + static_cast<std::ptrdiff_t>(n_read));
+            }
+            if (decoder.failed() || pcm.empty())
+            {
+                std::cerr << "Whisper Benchmark Error: no audio decoded from " << path << std::endl;
+                ok = false;
+                continue;
+            }
+            corpus.push_back(std::move(pcm));
+            corpus_names.push_back(path);
+        }
+        return ok;
+    }
+
+    /**
+     * @brief Replaces the corpus with clips of 16 kHz mono samples.
+     */
+    void setCorpus(const std::vector<std::vector<float>> &clips)
+    {
+        corpus = clips;
+        corpus_names.assign(clips.size(), "");
+    }
+
+    size_t getCorpusSize() const
+    {
+        return corpus.size();
+    }
+
+    double getCorpusSeconds() const
+    {
+        size_t n_samples = 0;
+        for (const std::vector<float> &clip : corpus)
+        {
+            n_samples += clip.size();
+        }
+        return static_cast<double>(n_samples) / AudioFileDecoder::SAMPLE_RATE;
+    }
+
+    /**
+     * @brief Lists the configurations of a grid, in the order of its nested loops.
+     *
+     * @return One configuration per combination, at least the base parameters themselves.
+     */
+    static std::vector<HegemonikonWhisperBenchmarkConfiguration> expandGrid(const HegemonikonWhisperBenchmarkGrid &grid,
+                                                                            const HegemonikonWhisperModelParams &base_model_params,
+                                                                            const HegemonikonWhisperGenerationParams &base_generation_params)
+    {
+        auto or_base = [](const auto &values, auto base_value)
+        {
+            return values.empty() ? std::vector<decltype(base_value)>{base_value}
+                                  : std::vector<decltype(base_value)>(values.begin(), values.end());
+        };
+        std::vector<HegemonikonWhisperBenchmarkConfiguration> configurations;
+        configurations.reserve(grid.size());
+        for (const std::string &model : or_base(grid.models, base_model_params.model))
+            for (int32_t n_threads : or_base(grid.n_threads, base_model_params.n_threads))
+                for (bool flash_attn : or_base(grid.flash_attn, base_model_params.flash_attn))
+                    for (int32_t beam_size : or_base(grid.beam_size, base_generation_params.beam_size))
+                        for (int32_t audio_ctx : or_base(grid.audio_ctx, base_generation_params.audio_ctx))
+                        {
+                            HegemonikonWhisperBenchmarkConfiguration configuration;
+                            configuration.model_params = base_model_params;
+                            configuration.model_params.model = model;
+                            configuration.model_params.n_threads = n_threads;
+                            configuration.model_params.flash_attn = flash_attn;
+                            configuration.model_params.audio_ctx = audio_ctx;
+                            configuration.generation_params = base_generation_params;
+                            configuration.generation_params.beam_size = beam_size;
+                            configuration.generation_params.audio_ctx = audio_ctx;
+                            configurations.push_back(configuration);
+                        }
+        return configurations;
+    }
+
+    HegemonikonWhisperBenchmarkResult benchmarkSingleModel(const HegemonikonWhisperModelParams &model_params, const HegemonikonWhisperBenchmarkParams &benchmark_params)
+    {
+        cancellation_requested.store(false);
+        return runConfiguration(model_params, benchmark_params);
+    }
+
+    /**
+     * @brief Benchmarks every configuration of a grid, in the order of expandGrid.
+     *
+     * The generation parameters of `benchmark_params` are the base of the swept ones.
+     * Stops at the first configuration run after a cancellation request.
+     */
+    std::vector<HegemonikonWhisperBenchmarkResult> benchmarkGrid(const HegemonikonWhisperBenchmarkGrid &grid, const HegemonikonWhisperModelParams &base_model_params, const HegemonikonWhisperBenchmarkParams &benchmark_params)
+    {
+        cancellation_requested.store(false);
+        std::vector<HegemonikonWhisperBenchmarkResult> results;
+        for (const HegemonikonWhisperBenchmarkConfiguration &configuration :
+             expandGrid(grid, base_model_params, benchmark_params.generation_params))
+        {
+            if (cancellation_requested.load())
+            {
+                break;
+            }
+            HegemonikonWhisperBenchmarkParams params = benchmark_params;
+            params.generation_params = configuration.generation_params;
+            results.push_back(runConfiguration(configuration.model_params, params));
+            printBenchmarkResult(results.back());
+        }
+        return results;
+    }
+
+    /**
+     * @brief Writes benchmark results to a JSON file, for comparing runs across builds.
+     */
+    static bool saveResultsJson(const std::vector<HegemonikonWhisperBenchmarkResult> &results, const std::string &path)
+    {
+        json list = json::array();
+        for (const HegemonikonWhisperBenchmarkResult &result : results)
+        {
+            list.push_back(result.to_json());
+        }
+        return write_benchmark_json(path, json{{"benchmark", "whisper"}, {"results", list}});
+    }
+
+    void printBenchmarkResult(const HegemonikonWhisperBenchmarkResult &result)
+    {
+        const HegemonikonWhisperModelParams &p = result.model_params;
+        std::cout << result.model_id << " threads=" << p.n_threads << " beam=" << result.generation_params.beam_size
+                  << " fa=" << (p.flash_attn ? "on" : "off") << " audio_ctx=" << result.generation_params.audio_ctx << std::endl;
+        if (!result.metrics.success)
+        {
+            std::cout << "  FAILED: " << result.metrics.errorMessage << std::endl;
+            return;
+        }
+
+        std::cout << std::fixed << std::setprecision(2);
+        std::cout << "  Load Time:          " << result.metrics.load_time_ms << " ms" << std::endl;
+        std::cout << "  Real-Time Factor:   " << result.metrics.real_time_factor << " (stdev " << result.metrics.stdev_real_time_factor
+                  << ", " << result.metrics.audio_seconds << " s of audio)" << std::endl;
+        std::cout << "  Avg Encode/Decode:  " << result.metrics.avg_encode_time_ms << " / " << result.metrics.avg_decode_time_ms << " ms" << std::endl;
+        std::cout << "  Latency (P50/P95/P99): "
+                  << result.metrics.p50_transcription_time_ms << " / "
+                  << result.metrics.p95_transcription_time_ms << " / "
+                  << result.metrics.p99_transcription_time_ms << " ms" << std::endl;
+        std::cout << "  Peak RSS / GPU:     " << result.metrics.peak_rss_mb << " / " << result.metrics.gpu_memory_mb << " MB" << std::endl;
+    }
+
+private:
+    HegemonikonWhisperBenchmarkResult runConfiguration(const HegemonikonWhisperModelParams &model_params, const HegemonikonWhisperBenchmarkParams &benchmark_params)
+    {
+        HegemonikonWhisperBenchmarkResult result(fs::path(model_params.model).filename().string());
+        result.model_params = model_params;
+        result.generation_params = benchmark_params.generation_params;
+
+        try
+        {
+            if (getCorpusSeconds() <= 0.0)
+            {
+                throw std::runtime_error("No audio corpus loaded.");
+            }
+            std::error_code ec;
+            const uintmax_t model_size = fs::file_size(model_params.model, ec);
+            if (ec)
+            {
+                throw std::runtime_error("Model file does not exist: " + model_params.model);
+            }
+            result.metrics.model_size_mb = static_cast<float>(model_size) / (1024.0f * 1024.0f);
+            result.metrics.audio_seconds = static_cast<float>(getCorpusSeconds());
+
+            const size_t gpu_baseline_mb = model_params.use_gpu ? get_gpu_memory_used_MB() : 0;
+            size_t gpu_peak_mb = gpu_baseline_mb;
+            PeakMemorySampler memory;
+
+            WhisperInterface interface;
+            auto load_start = high_resolution_clock::now();
+            if (!interface.load_model(model_params))
+            {
+                throw std::runtime_error("WhisperInterface failed to load model: " + model_params.model);
+            }
+            result.metrics.load_time_ms = duration_cast<microseconds>(high_resolution_clock::now() - load_start).count() / 1000.0f;
+            if (model_params.use_gpu)
+            {
+                gpu_peak_mb = std::max(gpu_peak_mb, get_gpu_memory_used_MB());
+            }
+
+            std::cout << "Benchmarking model: " << model_params.model << std::endl;
+
+            auto metrics = std::make_shared<MetricsRegistry>();
+            interface.set_metrics(metrics);
+            const HegemonikonWhisperGenerationParams &gen_params = benchmark_params.generation_params;
+
+            if (benchmark_params.warmup)
+            {
+                std::cout << "  Running warmup..." << std::endl;
+                interface.transcribe_pcm_segments(corpus.front().data(), corpus.front().size(), gen_params);
+            }
+
+            for (int i = 0; i < benchmark_params.repetitions; ++i)
+            {
+                if (cancellation_requested.load())
+                {
+                    throw std::runtime_error("Benchmark cancelled by user.");
+                }
+
+                metrics->reset();
+                auto start = high_resolution_clock::now();
+                for (size_t clip = 0; clip < corpus.size(); ++clip)
+                {
+                    const HegemonikonTranscription transcription =
+                        interface.transcribe_pcm_segments(corpus[clip].data(), corpus[clip].size(), gen_params);
+                    if (!transcription.ok())
+                    {
+                        throw std::runtime_error("Transcription failed" +
+                                                 (corpus_names[clip].empty() ? std::string() : " on " + corpus_names[clip]) +
+                                                 ": " + transcription.error);
+                    }
+                    if (i == 0 && clip == 0)
+                    {
+                        result.transcript = transcription.text();
+                    }
+                }
+                const float elapsed_ms = duration_cast<microseconds>(high_resolution_clock::now() - start).count() / 1000.0f;
+
+                const HegemonikonMetricsSnapshot snapshot = metrics->snapshot();
+                const HegemonikonLatencySnapshot *encode = snapshot.find(MetricsRegistry::phase_name(MetricPhase::WhisperEncode));
+                const HegemonikonLatencySnapshot *decode = snapshot.find(MetricsRegistry::phase_name(MetricPhase::WhisperDecode));
+                result.metrics.transcription_time_history_ms.push_back(elapsed_ms);
+                result.metrics.real_time_factor_history.push_back(elapsed_ms / (1000.0f * result.metrics.audio_seconds));
+                result.metrics.encode_time_history_ms.push_back(encode ? static_cast<float>(encode->sum_ms) : 0.0f);
+                result.metrics.decode_time_history_ms.push_back(decode ? static_cast<float>(decode->sum_ms) : 0.0f);
+
+                if (model_params.use_gpu)
+                {
+                    gpu_peak_mb = std::max(gpu_peak_mb, get_gpu_memory_used_MB());
+                }
+            }
+
+            memory.stop();
+            result.metrics.peak_rss_mb = static_cast<float>(memory.peak_mb());
+            result.metrics.gpu_memory_mb = static_cast<float>(gpu_peak_mb - gpu_baseline_mb);
+            interface.unload_model();
+            result.metrics.success = true;
+        }
+        catch (const std::exception &e)
+        {
+            result.metrics.success = false;
+            result.metrics.errorMessage = e.what();
+        }
+
+        result.calculateStatistics();
+        return result;
+    }
+};
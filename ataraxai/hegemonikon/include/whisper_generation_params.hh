@@ -18,6 +18,7 @@ struct HegemonikonWhisperGenerationParams
     int32_t capture_id = -1;
     float vad_thold = 0.6f;
     float freq_thold = 100.0f;
+    bool vad = false;
 
     bool translate = false;
     bool tinydiarize = false;
@@ -37,6 +38,7 @@ struct HegemonikonWhisperGenerationParams
 
     bool print_special = false;
     bool no_timestamps = false;
+    bool token_timestamps = false;
     bool save_audio = false;
     std::string fname_out;
 
@@ -94,6 +96,7 @@ struct HegemonikonWhisperGenerationParams
                capture_id == other.capture_id &&
                vad_thold == other.vad_thold &&
                freq_thold == other.freq_thold &&
+               vad == other.vad &&
                translate == other.translate &&
                tinydiarize == other.tinydiarize &&
                no_fallback == other.no_fallback &&
@@ -102,6 +105,7 @@ struct HegemonikonWhisperGenerationParams
                beam_size == other.beam_size &&
                print_special == other.print_special &&
                no_timestamps == other.no_timestamps &&
+               token_timestamps == other.token_timestamps &&
                save_audio == other.save_audio &&
                fname_out == other.fname_out;
     }
@@ -138,6 +142,7 @@ struct HegemonikonWhisperGenerationParams
                std::hash<int32_t>()(capture_id) ^
                std::hash<float>()(vad_thold) ^
                std::hash<float>()(freq_thold) ^
+               std::hash<bool>()(vad) ^
                std::hash<bool>()(translate) ^
                std::hash<bool>()(tinydiarize) ^
                std::hash<bool>()(no_fallback) ^
@@ -146,6 +151,7 @@ struct HegemonikonWhisperGenerationParams
                std::hash<int32_t>()(beam_size) ^
                std::hash<bool>()(print_special) ^
                std::hash<bool>()(no_timestamps) ^
+               std::hash<bool>()(token_timestamps) ^
                std::hash<bool>()(save_audio) ^
                std::hash<std::string>()(fname_out);
     }
@@ -166,6 +172,7 @@ struct HegemonikonWhisperGenerationParams
                ", capture_id=" + std::to_string(capture_id) +
                ", vad_thold=" + std::to_string(vad_thold) +
                ", freq_thold=" + std::to_string(freq_thold) +
+               ", vad=" + (vad ? "true" : "false") +
                ", translate=" + (translate ? "true" : "false") +
                ", tinydiarize=" + (tinydiarize ? "true" : "false") +
                ", no_fallback=" + (no_fallback ? "true" : "false") +
@@ -174,6 +181,7 @@ struct HegemonikonWhisperGenerationParams
                ", beam_size=" + std::to_string(beam_size) +
                ", print_special=" + (print_special ? "true" : "false") +
                ", no_timestamps=" + (no_timestamps ? "true" : "false") +
+               ", token_timestamps=" + (token_timestamps ? "true" : "false") +
                ", save_audio=" + (save_audio ? "true" : "false") +
                ", fname_out='" + fname_out + "')";
     }
@@ -261,6 +269,22 @@ struct HegemonikonWhisperGenerationParams
         return *this;
     }
 
+    /**
+     * @brief Enables the voice activity detection pre-pass.
+     *
+     * When enabled, silence is cut out of the audio before it reaches whisper, using
+     * `vad_thold` and `freq_thold` (see VoiceActivityDetector); segment timestamps still
+     * refer to the original audio.
+     *
+     * @param vad_ If true, only the detected speech is transcribed.
+     * @return Reference to the current HegemonikonWhisperGenerationParams object for method chaining.
+     */
+    HegemonikonWhisperGenerationParams &set_vad(bool vad_)
+    {
+        vad = vad_;
+        return *this;
+    }
+
     /**
      * @brief Sets the translation mode for Whisper generation.
      *
@@ -368,6 +392,20 @@ struct HegemonikonWhisperGenerationParams
         return *this;
     }
 
+    /**
+     * @brief Sets whether the segments carry the timestamps and probabilities of their tokens.
+     *
+     * Token times are estimated by whisper with `word_thold` as the timestamp token threshold.
+     *
+     * @param token_timestamps_ If true, HegemonikonWhisperSegment::tokens is filled.
+     * @return Reference to this HegemonikonWhisperGenerationParams object for method chaining.
+     */
+    HegemonikonWhisperGenerationParams &set_token_timestamps(bool token_timestamps_)
+    {
+        token_timestamps = token_timestamps_;
+        return *this;
+    }
+
     /**
      * @brief Sets the flag indicating whether to save audio output.
      *
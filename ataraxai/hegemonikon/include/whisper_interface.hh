@@ -1,19 +1,134 @@
 #pragma once
+#include <cstddef>
 #include <string>
 #include <vector>
+#include <cstdint>
 #include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
 
+#include "compute_pool.hh"
+#include "metrics_registry.hh"
 #include "whisper_model_params.hh"
 #include "whisper_generation_params.hh"
 
 struct whisper_context;
+struct whisper_state;
 struct whisper_context_params;
+class SpeechTimeline;
 
+/**
+ * @brief Source of 16 kHz mono samples for WhisperInterface::transcribe_stream.
+ *
+ * Writes up to `max_samples` samples to `buffer` and returns how many it wrote; 0 ends
+ * the stream.
+ */
+using whisper_pcm_reader_t = std::function<size_t(float *buffer, size_t max_samples)>;
+
+/**
+ * @brief One text token of a segment, with times in milliseconds from the start of the audio.
+ *
+ * The times are only estimated with HegemonikonWhisperGenerationParams::token_timestamps
+ * set; they are -1 otherwise.
+ */
+struct HegemonikonWhisperToken
+{
+    int32_t id = 0;
+    std::string text;
+    int64_t t0_ms = -1;
+    int64_t t1_ms = -1;
+    float p = 0.0f;
+
+    std::string to_string() const
+    {
+        return "HegemonikonWhisperToken(id=" + std::to_string(id) +
+               ", text='" + text +
+               "', t0_ms=" + std::to_string(t0_ms) +
+               ", t1_ms=" + std::to_string(t1_ms) +
+               ", p=" + std::to_string(p) + ")";
+    }
+};
+
+/**
+ * @brief One transcribed segment, with times in milliseconds from the start of the audio.
+ *
+ * Streaming sessions mark a segment `partial` while its window may still be transcribed
+ * again with more audio; a newer partial result replaces the previous one. `tokens` is
+ * only filled with HegemonikonWhisperGenerationParams::token_timestamps set.
+ */
+struct HegemonikonWhisperSegment
+{
+    std::string text;
+    int64_t t0_ms = 0;
+    int64_t t1_ms = 0;
+    bool speaker_turn_next = false;
+    bool partial = false;
+    float no_speech_prob = 0.0f;
+    std::vector<HegemonikonWhisperToken> tokens;
+
+    std::string to_string() const
+    {
+        return "HegemonikonWhisperSegment(text='" + text +
+               "', t0_ms=" + std::to_string(t0_ms) +
+               ", t1_ms=" + std::to_string(t1_ms) +
+               ", speaker_turn_next=" + (speaker_turn_next ? "true" : "false") +
+               ", partial=" + (partial ? "true" : "false") +
+               ", no_speech_prob=" + std::to_string(no_speech_prob) +
+               ", n_tokens=" + std::to_string(tokens.size()) + ")";
+    }
+};
+
+/**
+ * @brief Segments of a whole transcription, or the error that stopped it.
+ */
+struct HegemonikonTranscription
+{
+    std::vector<HegemonikonWhisperSegment> segments;
+    std::string error;
+    int64_t audio_ms = 0;
+
+    bool ok() const { return error.empty(); }
+
+    /**
+     * @brief The text of the segments, joined without timestamps.
+     */
+    std::string text() const
+    {
+        std::string joined;
+        for (const HegemonikonWhisperSegment &segment : segments)
+        {
+            joined += segment.text;
+        }
+        return joined;
+    }
+
+    std::string to_string() const
+    {
+        return "HegemonikonTranscription(n_segments=" + std::to_string(segments.size()) +
+               ", ok=" + (ok() ? "true" : "false") +
+               ", error='" + error +
+               "', audio_ms=" + std::to_string(audio_ms) + ")";
+    }
+};
+
+using whisper_segment_callback_t = std::function<void(const HegemonikonWhisperSegment &)>;
+
+/**
+ * @brief Transcription with a whisper.cpp model.
+ *
+ * One model is loaded at a time. Serial transcriptions run on the default state of the
+ * context, one at a time; long audio is split at pauses and its pieces transcribed
+ * concurrently on `n_processors` additional states that share the model weights (see
+ * HegemonikonWhisperModelParams::n_processors).
+ */
 class WhisperInterface
 {
 public:
+    static constexpr uint32_t SAMPLE_RATE = 16000;
+
     WhisperInterface();
-    ~WhisperInterface();
+    virtual ~WhisperInterface();
 
     virtual bool load_model(const HegemonikonWhisperModelParams &params);
 
@@ -21,15 +136,80 @@ public:
 
     bool is_model_loaded() const;
 
+    HegemonikonWhisperModelParams model_params() const;
+    void set_keep_resident(bool keep_resident);
+
+    bool warm_up(const HegemonikonWhisperGenerationParams &params);
+
     virtual std::string transcribe_pcm(const std::vector<float> &pcm_f32_data,
                                const HegemonikonWhisperGenerationParams &params);
 
+    virtual std::string transcribe_pcm(const float *pcm_f32_data, size_t n_samples,
+                                       const HegemonikonWhisperGenerationParams &params);
+
+    virtual std::string transcribe_stream(const whisper_pcm_reader_t &reader,
+                                          const HegemonikonWhisperGenerationParams &params);
+
+    virtual HegemonikonTranscription transcribe_pcm_segments(const float *pcm_f32_data, size_t n_samples,
+                                                             const HegemonikonWhisperGenerationParams &params);
+
+    virtual HegemonikonTranscription transcribe_stream_segments(const whisper_pcm_reader_t &reader,
+                                                                const HegemonikonWhisperGenerationParams &params,
+                                                                const whisper_segment_callback_t &on_segment = nullptr);
+
+    static std::string format_transcription(const HegemonikonWhisperGenerationParams &params,
+                                            const HegemonikonTranscription &transcription);
+
+    bool transcribe_segments(const float *pcm_f32_data, size_t n_samples,
+                             const HegemonikonWhisperGenerationParams &params,
+                             const std::vector<int32_t> &prompt_tokens, int64_t offset_ms,
+                             std::vector<HegemonikonWhisperSegment> &segments,
+                             std::vector<int32_t> *next_prompt_tokens = nullptr);
+
+    void set_compute_pool(std::shared_ptr<ComputePool> pool);
+    void set_metrics(std::shared_ptr<MetricsRegistry> metrics);
+
     static void init_backend();
     static void free_backend();
 
 private:
+    struct AudioPiece
+    {
+        const float *samples;
+        size_t n_samples;
+        uint64_t offset;
+    };
+
     whisper_context *ctx_ = nullptr;
+    // Exclusive while ctx_ is loaded or unloaded, shared while it is transcribing.
+    mutable std::shared_mutex model_mutex_;
+    // The default state of ctx_, used by serial transcriptions.
+    mutable std::mutex context_mutex_;
     HegemonikonWhisperModelParams current_model_params_;
+    std::shared_ptr<ComputePool> compute_pool_;
+    std::shared_ptr<MetricsRegistry> metrics_;
+
+    // Idle states for parallel transcriptions, created at load time when warming up or on
+    // demand, and freed with the model.
+    std::mutex states_mutex_;
+    std::vector<whisper_state *> states_;
+
+    bool run_full(const float *samples, size_t n_samples, const HegemonikonWhisperGenerationParams &params,
+                  const std::vector<int32_t> &prompt_tokens, whisper_state *state = nullptr,
+                  bool record_metrics = true);
+    bool transcribe_pieces(const std::vector<AudioPiece> &pieces, const HegemonikonWhisperGenerationParams &params,
+                           const SpeechTimeline *timeline, std::vector<HegemonikonWhisperSegment> &segments);
+    static size_t split_pieces(const float *samples, size_t n_samples, bool end_of_audio, uint64_t offset,
+                               std::vector<AudioPiece> &pieces);
+    whisper_state *acquire_state();
+    void release_state(whisper_state *state);
+    size_t n_processors() const;
+
+    void read_segments(whisper_state *state, uint64_t offset_samples, const SpeechTimeline *timeline,
+                       bool with_tokens, std::vector<HegemonikonWhisperSegment> &segments) const;
+    void collect_prompt_tokens(std::vector<int32_t> &prompt_tokens) const;
+    void unload_model_locked();
+    bool warm_up_locked(const HegemonikonWhisperGenerationParams &params);
 
     static void static_new_segment_callback(struct whisper_context *ctx, struct whisper_state *state, int n_new, void *user_data);
     static void static_progress_callback(struct whisper_context *ctx, struct whisper_state *state, int progress, void *user_data);
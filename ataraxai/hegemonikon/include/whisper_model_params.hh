@@ -11,6 +11,9 @@ struct HegemonikonWhisperModelParams
     bool use_gpu = true;
     bool flash_attn = false;
     int32_t audio_ctx = 0; 
+    int32_t n_processors = 1;
+    bool warmup = true;
+    bool keep_resident = false;
 
     std::string model = "models/ggml-base.en.bin";
     std::string language = "en";
@@ -36,6 +39,8 @@ struct HegemonikonWhisperModelParams
      * Compares this instance with another HegemonikonWhisperModelParams object to determine if all
      * configuration parameters are equal. The comparison includes the number of threads,
      * GPU usage flag, flash attention flag, audio context size, model identifier, and language.
+     * The load-behaviour flags warmup and keep_resident are left out: they do not change the
+     * loaded model, so a resident model is reused whatever their values.
      *
      * @param other The HegemonikonWhisperModelParams instance to compare against.
      * @return true if all parameters are equal; false otherwise.
@@ -46,6 +51,7 @@ struct HegemonikonWhisperModelParams
                use_gpu == other.use_gpu &&
                flash_attn == other.flash_attn &&
                audio_ctx == other.audio_ctx &&
+               n_processors == other.n_processors &&
                model == other.model &&
                language == other.language;
     }
@@ -74,6 +80,9 @@ struct HegemonikonWhisperModelParams
      * - flash_attn (bool)
      * - audio_ctx (int32_t)
      * - n_threads (int32_t)
+     * - n_processors (int32_t)
+     *
+     * warmup and keep_resident are left out, as in operator==.
      *
      * The resulting hash can be used for storing objects in hash-based containers.
      *
@@ -86,7 +95,8 @@ struct HegemonikonWhisperModelParams
                std::hash<bool>()(use_gpu) ^
                std::hash<bool>()(flash_attn) ^
                std::hash<int32_t>()(audio_ctx) ^
-               std::hash<int32_t>()(n_threads);
+               std::hash<int32_t>()(n_threads) ^
+               std::hash<int32_t>()(n_processors);
     }
 
     /**
@@ -102,7 +112,10 @@ struct HegemonikonWhisperModelParams
                "', use_gpu=" + (use_gpu ? "true" : "false") +
                ", flash_attn=" + (flash_attn ? "true" : "false") +
                ", audio_ctx=" + std::to_string(audio_ctx) +
-               ", n_threads=" + std::to_string(n_threads) + ")";
+               ", n_threads=" + std::to_string(n_threads) +
+               ", n_processors=" + std::to_string(n_processors) +
+               ", warmup=" + (warmup ? "true" : "false") +
+               ", keep_resident=" + (keep_resident ? "true" : "false") + ")";
     }
 
     /**
@@ -188,4 +201,51 @@ struct HegemonikonWhisperModelParams
         n_threads = threads;
         return *this;
     }
+
+    /**
+     * @brief Sets how many pieces of a long recording are transcribed concurrently.
+     *
+     * Each processor runs its own whisper state over the shared model weights, with up to
+     * n_threads threads; 1 transcribes serially.
+     *
+     * @param processors Number of concurrent whisper states.
+     * @return Reference to the current HegemonikonWhisperModelParams object to allow method chaining.
+     */
+    HegemonikonWhisperModelParams &set_n_processors(int32_t processors)
+    {
+        n_processors = processors;
+        return *this;
+    }
+
+    /**
+     * @brief Sets whether the whisper states are warmed up when the model is loaded.
+     *
+     * The warm-up transcribes a second of silence on the default state and on the
+     * n_processors states of parallel transcriptions, which allocates their compute
+     * buffers and decoders, so the first real request does not pay for it.
+     *
+     * @param enable Whether to warm up at load time.
+     * @return Reference to the current HegemonikonWhisperModelParams object to allow method chaining.
+     */
+    HegemonikonWhisperModelParams &set_warmup(bool enable)
+    {
+        warmup = enable;
+        return *this;
+    }
+
+    /**
+     * @brief Sets whether the model stays loaded when CoreAIService unloads it.
+     *
+     * A resident model is parked instead of freed by unload_whisper_model and by the
+     * destruction of the service, and initializing a model with the same parameters
+     * takes it back without reloading it, in the same or another CoreAIService.
+     *
+     * @param enable Whether to keep the model resident.
+     * @return Reference to the current HegemonikonWhisperModelParams object to allow method chaining.
+     */
+    HegemonikonWhisperModelParams &set_keep_resident(bool enable)
+    {
+        keep_resident = enable;
+        return *this;
+    }
 };
\ No newline at end of file
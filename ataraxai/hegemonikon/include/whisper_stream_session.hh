@@ -0,0 +1,119 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "audio_ring_buffer.hh"
+#include "whisper_interface.hh"
+
+/**
+ * @brief Counters of a streaming transcription session.
+ */
+struct HegemonikonWhisperStreamStats
+{
+    uint64_t samples_received = 0;
+    uint64_t samples_dropped = 0;
+    uint64_t windows_transcribed = 0;
+    uint64_t partial_segments = 0;
+    uint64_t final_segments = 0;
+    double transcribe_ms_total = 0.0;
+    double transcribe_ms_last = 0.0;
+
+    /**
+     * @brief Transcription time over audio duration; below 1 the session keeps up with live audio.
+     */
+    double real_time_factor() const
+    {
+        const double audio_ms = samples_received * 1000.0 / WhisperInterface::SAMPLE_RATE;
+        return audio_ms > 0.0 ? transcribe_ms_total / audio_ms : 0.0;
+    }
+
+    std::string to_string() const
+    {
+        return "HegemonikonWhisperStreamStats(samples_received=" + std::to_string(samples_received) +
+               ", samples_dropped=" + std::to_string(samples_dropped) +
+               ", windows_transcribed=" + std::to_string(windows_transcribed) +
+               ", partial_segments=" + std::to_string(partial_segments) +
+               ", final_segments=" + std::to_string(final_segments) +
+               ", transcribe_ms_total=" + std::to_string(transcribe_ms_total) +
+               ", transcribe_ms_last=" + std::to_string(transcribe_ms_last) + ")";
+    }
+};
+
+/**
+ * @brief Live transcription of pushed or captured audio on overlapping windows.
+ *
+ * Audio is pushed as 16 kHz mono samples, or captured from a microphone, and a worker
+ * thread transcribes it every `step_ms` of new audio. Each pass covers the new audio plus
+ * up to `length_ms + keep_ms` of the audio before it, so results improve as a sentence
+ * goes on; they are reported as partial segments, which the next pass replaces. Every
+ * `length_ms / step_ms - 1` passes the window is committed: its segments are reported as
+ * final, only the last `keep_ms` of audio are kept as context and, unless `no_context`
+ * is set, its text tokens prompt the following windows.
+ *
+ * Captured audio never goes through push(): the device callback converts it to 16 kHz
+ * mono (see AudioFormatConverter) into a lock-free ring that the worker drains, so the
+ * audio thread never waits on the session.
+ *
+ * Segment times are relative to the first pushed sample. When transcription falls behind
+ * by more than 30 s of audio, the oldest pending audio is dropped (see the stats).
+ * Callbacks run on the worker thread. The WhisperInterface is shared with other callers;
+ * each pass holds its context only for the duration of the inference.
+ */
+class WhisperStreamSession
+{
+public:
+    static constexpr size_t MAX_PENDING_SAMPLES = WhisperInterface::SAMPLE_RATE * 30;
+
+    WhisperStreamSession(std::shared_ptr<WhisperInterface> whisper,
+                         const HegemonikonWhisperGenerationParams &params,
+                         whisper_segment_callback_t on_segment);
+    ~WhisperStreamSession();
+
+    WhisperStreamSession(const WhisperStreamSession &) = delete;
+    WhisperStreamSession &operator=(const WhisperStreamSession &) = delete;
+
+    void push(const float *samples, size_t n_samples);
+
+    bool start_capture(int32_t capture_id = -1);
+    void stop_capture();
+
+    void stop();
+
+    bool is_running() const;
+    std::string error() const;
+    HegemonikonWhisperStreamStats get_stats() const;
+
+private:
+    struct Capture;
+
+    std::shared_ptr<WhisperInterface> whisper_;
+    HegemonikonWhisperGenerationParams params_;
+    whisper_segment_callback_t on_segment_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable pending_ready_;
+    std::vector<float> pending_;
+    bool stopping_ = false;
+    bool running_ = true;
+    std::string error_;
+    HegemonikonWhisperStreamStats stats_;
+
+    // Filled by the capture callback, drained by the worker; outlives the devices.
+    AudioRingBuffer capture_ring_{MAX_PENDING_SAMPLES};
+    uint64_t capture_dropped_ = 0;
+    bool capturing_ = false;
+    std::unique_ptr<Capture> capture_;
+    std::mutex capture_mutex_;
+    std::thread worker_;
+
+    void run();
+    void drain_capture_locked();
+    void fail(const std::string &message);
+};
@@ -0,0 +1,65 @@
+/*
+ * Argon2 source code package
+ * 
+ * Written by Daniel Dinu and Dmitry Khovratovich, 2015
+ * 
+ * This work is licensed under a Creative Commons CC0 1.0 License/Waiver.
+ * 
+ * You should have received a copy of the CC0 Public Domain Dedication along with
+ * this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+ */
+
+/*
+ * AVX2 block compression. This unit is built with AVX2 enabled and only called when
+ * CPUID reports AVX2 (see Argon2KernelSupported in argon2-opt-core.cpp).
+ */
+
+#include <stdint.h>
+
+#include <immintrin.h>
+
+#include "argon2/argon2.h"
+#include "argon2/argon2-core.h"
+
+#include "argon2/blamka-round-opt.h"
+
+#if !defined(__AVX2__)
+#error "argon2-avx2-core.cpp must be compiled with AVX2 enabled"
+#endif
+
+
+void FillBlockAVX2(block* state_block, const block* ref_block, block* next_block, const uint64_t* Sbox) {
+    __m256i* state = (__m256i*) state_block->v;
+    __m256i block_XY[ARGON2_HWORDS_IN_BLOCK];
+
+    for (uint32_t i = 0; i < ARGON2_HWORDS_IN_BLOCK; i++) {//Initial XOR
+        block_XY[i] = state[i] = _mm256_xor_si256(
+            state[i], _mm256_loadu_si256((__m256i const *)(&ref_block->v[4 * i])));
+    }
+
+    uint64_t x = 0;
+    if (Sbox != NULL) { //S-boxes in Argon2ds, the state still holds block_XY here
+        x = SboxMix(state_block->v[0] ^ state_block->v[ARGON2_WORDS_IN_BLOCK - 1], Sbox);
+    }
+
+    // Rows: words 16i..16i+15 are split over state[8i..8i+7] as (low, high) 128-bit pairs
+    for (uint32_t i = 0; i < 4; ++i) {
+        BLAKE2_ROUND_1_AVX2(state[8 * i + 0], state[8 * i + 4], state[8 * i + 1], state[8 * i + 5],
+                            state[8 * i + 2], state[8 * i + 6], state[8 * i + 3], state[8 * i + 7]);
+    }
+
+    for (uint32_t i = 0; i < 4; ++i) {
+        BLAKE2_ROUND_2_AVX2(state[ 0 + i], state[ 4 + i], state[ 8 + i], state[12 + i],
+                            state[16 + i], state[20 + i], state[24 + i], state[28 + i]);
+    }
+
+    for (uint32_t i = 0; i < ARGON2_HWORDS_IN_BLOCK; i++) {
+        // Feedback
+        state[i] = _mm256_xor_si256(state[i], block_XY[i]);
+    }
+    state[0] = _mm256_add_epi64(state[0], _mm256_set_epi64x(0, 0, 0, x));
+    state[ARGON2_HWORDS_IN_BLOCK - 1] = _mm256_add_epi64(state[ARGON2_HWORDS_IN_BLOCK - 1], _mm256_set_epi64x(x, 0, 0, 0));
+    for (uint32_t i = 0; i < ARGON2_HWORDS_IN_BLOCK; i++) {
+        _mm256_storeu_si256((__m256i *)(&next_block->v[4 * i]), state[i]);
+    }
+}
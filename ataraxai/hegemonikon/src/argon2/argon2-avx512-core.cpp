@@ -0,0 +1,65 @@
+/*
+ * Argon2 source code package
+ * 
+ * Written by Daniel Dinu and Dmitry Khovratovich, 2015
+ * 
+ * This work is licensed under a Creative Commons CC0 1.0 License/Waiver.
+ * 
+ * You should have received a copy of the CC0 Public Domain Dedication along with
+ * this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+ */
+
+/*
+ * AVX-512F block compression. This unit is built with AVX-512F enabled and only called
+ * when CPUID reports AVX-512F (see Argon2KernelSupported in argon2-opt-core.cpp).
+ */
+
+#include <stdint.h>
+
+#include <immintrin.h>
+
+#include "argon2/argon2.h"
+#include "argon2/argon2-core.h"
+
+#include "argon2/blamka-round-opt.h"
+
+#if !defined(__AVX512F__)
+#error "argon2-avx512-core.cpp must be compiled with AVX-512F enabled"
+#endif
+
+
+void FillBlockAVX512(block* state_block, const block* ref_block, block* next_block, const uint64_t* Sbox) {
+    __m512i* state = (__m512i*) state_block->v;
+    __m512i block_XY[ARGON2_512BIT_WORDS_IN_BLOCK];
+
+    for (uint32_t i = 0; i < ARGON2_512BIT_WORDS_IN_BLOCK; i++) {//Initial XOR
+        block_XY[i] = state[i] = _mm512_xor_si512(
+            state[i], _mm512_loadu_si512((void const *)(&ref_block->v[8 * i])));
+    }
+
+    uint64_t x = 0;
+    if (Sbox != NULL) { //S-boxes in Argon2ds, the state still holds block_XY here
+        x = SboxMix(state_block->v[0] ^ state_block->v[ARGON2_WORDS_IN_BLOCK - 1], Sbox);
+    }
+
+    for (uint32_t i = 0; i < 2; ++i) {
+        BLAKE2_ROUND_1_AVX512(state[8 * i + 0], state[8 * i + 1], state[8 * i + 2], state[8 * i + 3],
+                              state[8 * i + 4], state[8 * i + 5], state[8 * i + 6], state[8 * i + 7]);
+    }
+
+    for (uint32_t i = 0; i < 2; ++i) {
+        BLAKE2_ROUND_2_AVX512(state[2 * 0 + i], state[2 * 1 + i], state[2 * 2 + i], state[2 * 3 + i],
+                              state[2 * 4 + i], state[2 * 5 + i], state[2 * 6 + i], state[2 * 7 + i]);
+    }
+
+    for (uint32_t i = 0; i < ARGON2_512BIT_WORDS_IN_BLOCK; i++) {
+        // Feedback
+        state[i] = _mm512_xor_si512(state[i], block_XY[i]);
+    }
+    state[0] = _mm512_add_epi64(state[0], _mm512_set_epi64(0, 0, 0, 0, 0, 0, 0, x));
+    state[ARGON2_512BIT_WORDS_IN_BLOCK - 1] = _mm512_add_epi64(state[ARGON2_512BIT_WORDS_IN_BLOCK - 1],
+                                                               _mm512_set_epi64(x, 0, 0, 0, 0, 0, 0, 0));
+    for (uint32_t i = 0; i < ARGON2_512BIT_WORDS_IN_BLOCK; i++) {
+        _mm512_storeu_si512((void *)(&next_block->v[8 * i]), state[i]);
+    }
+}
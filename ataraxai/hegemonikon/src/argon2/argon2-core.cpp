@@ -12,13 +12,14 @@
 
 
 #include <inttypes.h>
+#include <algorithm>
 #include <vector>
-#include <thread>
 #include <cstring>
 
 #include "argon2.h"
 #include "argon2-core.h"
 #include "kat.h"
+#include "thread_pool.hh"
 
 
 #include "argon2/blake2.h"
@@ -149,30 +150,38 @@ uint32_t IndexAlpha(const Argon2_instance_t* instance, const Argon2_position_t*
     return absolute_position;
 }
 
+/*
+ * Workers shared by every derivation of the process, so that a derivation does not create
+ * a thread per lane and slice. Created on the first multi-threaded derivation.
+ */
+static ThreadPool& Argon2WorkerPool() {
+    static ThreadPool pool;
+    return pool;
+}
+
 void FillMemoryBlocks(Argon2_instance_t* instance) {
-    std::vector<std::thread> Threads;
     if (instance == NULL) {
         return;
     }
+    // Worker t fills lanes t, t + threads, ...; never more than @lanes workers
+    const uint32_t threads = std::max<uint32_t>(1, std::min(instance->threads, instance->lanes));
     for (uint32_t r = 0; r < instance->passes; ++r) {
         if (Argon2_ds == instance->type) {
             GenerateSbox(instance);
         }
         for (uint8_t s = 0; s < ARGON2_SYNC_POINTS; ++s) {
-            for (uint32_t l = 0; l < instance->lanes; ++l) {
-                Threads.push_back(std::thread(FillSegment, instance, Argon2_position_t(r, l, s, 0)));
-                if(instance->threads <= Threads.size()){ //have to join extra threads
-                    for (auto& t : Threads) {
-                        t.join();
+            auto fill_lanes = [instance, threads, r, s](size_t begin, size_t end) {
+                for (size_t t = begin; t < end; ++t) {
+                    for (uint32_t l = static_cast<uint32_t>(t); l < instance->lanes; l += threads) {
+                        FillSegment(instance, Argon2_position_t(r, l, s, 0));
                     }
-                    Threads.clear();
                 }
-            }
-            if(!Threads.empty()){
-                for (auto& t : Threads) {
-                    t.join();
-                }
-                Threads.clear();
+            };
+            if (threads == 1) {
+                fill_lanes(0, 1);
+            } else {
+                // parallel_for returns once every lane of the slice is filled: this is the sync point
+                Argon2WorkerPool().parallel_for(threads, fill_lanes);
             }
         }
         if(instance->internal_print){
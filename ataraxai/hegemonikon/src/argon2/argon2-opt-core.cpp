@@ -12,6 +12,7 @@
 
 
 #include <stdint.h>
+#include <atomic>
 
 
 #if !defined(_MSC_VER)
@@ -31,6 +32,7 @@
 
 #include "argon2/blake2.h"
 #include "argon2/blamka-round-opt.h"
+#include "benchmarker/system_infos/cpu_info.hh"
 
 
 
@@ -38,11 +40,6 @@
 const char* ARGON2_KAT_FILENAME = "kat-argon2-opt.log";
 
 
-//const __m128i r16 = _mm_setr_epi8(2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9);
-//const __m128i r24 = _mm_setr_epi8(3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10);
-
-__m128i t0, t1;
-
 /*
  * Function fills a new memory block
  * @param state Pointer to the just produced block. Content will be updated(!)
@@ -51,26 +48,18 @@ __m128i t0, t1;
  * @param Sbox Pointer to the Sbox (used in Argon2_ds only)
  * @pre all block pointers must be valid
  */
-void FillBlock(__m128i* state, const uint8_t *ref_block, uint8_t *next_block, const uint64_t* Sbox) {
+void FillBlockSSE2(block* state_block, const block* ref_block, block* next_block, const uint64_t* Sbox) {
+    __m128i* state = (__m128i*) state_block->v;
     __m128i block_XY[ARGON2_QWORDS_IN_BLOCK];
     
      for (uint32_t i = 0; i < ARGON2_QWORDS_IN_BLOCK; i++) {//Initial XOR
         block_XY[i] = state[i] = _mm_xor_si128(
-            state[i], _mm_loadu_si128((__m128i const *)(&ref_block[16 * i])));
+            state[i], _mm_loadu_si128((__m128i const *)(&ref_block->v[2 * i])));
     }
 
     uint64_t x = 0;
-    if (Sbox != NULL) { //S-boxes in Argon2ds
-	x = *(uint64_t*)block_XY ^ ((uint64_t*)block_XY)[2 * ARGON2_QWORDS_IN_BLOCK - 1];
-        for (int i = 0; i < 6 * 16; ++i) {
-            uint32_t x1 = x >> 32;
-            uint32_t x2 = x & 0xFFFFFFFF;
-            uint64_t y = Sbox[x1 & ARGON2_SBOX_MASK];
-            uint64_t z = Sbox[(x2 & ARGON2_SBOX_MASK) + ARGON2_SBOX_SIZE / 2];
-            x = (uint64_t) x1 * (uint64_t) x2;
-            x += y;
-            x ^= z;
-        }
+    if (Sbox != NULL) { //S-boxes in Argon2ds, the state still holds block_XY here
+        x = SboxMix(state_block->v[0] ^ state_block->v[ARGON2_WORDS_IN_BLOCK - 1], Sbox);
     }
 
       for (uint32_t i = 0; i < 8; ++i) {
@@ -93,11 +82,90 @@ void FillBlock(__m128i* state, const uint8_t *ref_block, uint8_t *next_block, co
     state[0] = _mm_add_epi64(state[0], _mm_set_epi64x(0, x));
     state[ARGON2_QWORDS_IN_BLOCK - 1] = _mm_add_epi64(state[ARGON2_QWORDS_IN_BLOCK - 1], _mm_set_epi64x(x, 0));
     for (uint32_t i = 0; i < ARGON2_QWORDS_IN_BLOCK; i++) {
-                _mm_storeu_si128((__m128i *)(&next_block[16 * i]), state[i]);
+                _mm_storeu_si128((__m128i *)(&next_block->v[2 * i]), state[i]);
+    }
+}
+
+bool Argon2KernelSupported(Argon2_kernel kernel) {
+    const CPUFeatures& cpu = CPUFeatures::detect();
+    switch (kernel) {
+        case Argon2_kernel_sse2:
+            return true;
+        case Argon2_kernel_avx2:
+#if defined(ARGON2_AVX2_KERNEL)
+            return cpu.avx2;
+#else
+            return false;
+#endif
+        case Argon2_kernel_avx512:
+#if defined(ARGON2_AVX512_KERNEL)
+            return cpu.avx512f;
+#else
+            return false;
+#endif
+        default:
+            return false;
+    }
+}
+
+static Argon2_kernel DetectKernel() {
+    if (Argon2KernelSupported(Argon2_kernel_avx512)) {
+        return Argon2_kernel_avx512;
+    }
+    if (Argon2KernelSupported(Argon2_kernel_avx2)) {
+        return Argon2_kernel_avx2;
+    }
+    return Argon2_kernel_sse2;
+}
+
+/* Active kernel, detected from CPUID on first use */
+static std::atomic<Argon2_kernel>& ActiveKernel() {
+    static std::atomic<Argon2_kernel> kernel(DetectKernel());
+    return kernel;
+}
+
+Argon2_kernel Argon2ActiveKernel() {
+    return ActiveKernel().load(std::memory_order_relaxed);
+}
+
+bool Argon2SelectKernel(Argon2_kernel kernel) {
+    if (!Argon2KernelSupported(kernel)) {
+        return false;
+    }
+    ActiveKernel().store(kernel, std::memory_order_relaxed);
+    return true;
+}
+
+const char* Argon2KernelName(Argon2_kernel kernel) {
+    switch (kernel) {
+        case Argon2_kernel_sse2:
+            return "sse2";
+        case Argon2_kernel_avx2:
+            return "avx2";
+        case Argon2_kernel_avx512:
+            return "avx512";
+        default:
+            return "unknown";
+    }
+}
+
+static FillBlockKernel ActiveFillBlock() {
+    switch (Argon2ActiveKernel()) {
+#if defined(ARGON2_AVX512_KERNEL)
+        case Argon2_kernel_avx512:
+            return FillBlockAVX512;
+#endif
+#if defined(ARGON2_AVX2_KERNEL)
+        case Argon2_kernel_avx2:
+            return FillBlockAVX2;
+#endif
+        default:
+            return FillBlockSSE2;
     }
 }
 
 void GenerateAddresses(const Argon2_instance_t* instance, const Argon2_position_t* position, uint64_t* pseudo_rands) {
+    const FillBlockKernel fill_block = ActiveFillBlock();
     block input_block(0), address_block(0);
     if (instance != NULL && position != NULL) {
         input_block.v[0] = position->pass;
@@ -111,8 +179,8 @@ void GenerateAddresses(const Argon2_instance_t* instance, const Argon2_position_
             if (i % ARGON2_ADDRESSES_IN_BLOCK == 0) {
                 input_block.v[6]++;
                 block zero_block(0), zero2_block(0);
-                FillBlock((__m128i *) & zero_block.v, (uint8_t *) & input_block.v, (uint8_t *) & address_block.v, NULL);
-                FillBlock((__m128i *) & zero2_block.v, (uint8_t *) & address_block.v, (uint8_t *) & address_block.v, NULL);
+                fill_block(&zero_block, &input_block, &address_block, NULL);
+                fill_block(&zero2_block, &address_block, &address_block, NULL);
             }
             pseudo_rands[i] = address_block[i % ARGON2_ADDRESSES_IN_BLOCK];
         }
@@ -120,7 +188,7 @@ void GenerateAddresses(const Argon2_instance_t* instance, const Argon2_position_
 }
 
 /*
- * Function that fills the segment using previous segments also from other threads. Identical to the reference code except that it calls optimized FillBlock()
+ * Function that fills the segment using previous segments also from other threads. Identical to the reference code except that it calls the active SIMD kernel
  * @param instance Pointer to the current instance
  * @param position Current position
  * @pre all block pointers must be valid
@@ -131,7 +199,8 @@ void FillSegment(const Argon2_instance_t* instance, Argon2_position_t position)
  	}    
 	uint64_t pseudo_rand, ref_index, ref_lane;
 	uint32_t prev_offset, curr_offset;
-	__m128i state[64];
+	block state;
+	const FillBlockKernel fill_block = ActiveFillBlock();
 	bool data_independent_addressing = (instance->type == Argon2_i) || (instance->type == Argon2_id && (position.pass == 0) && (position.slice < ARGON2_SYNC_POINTS / 2));
 
     
@@ -158,7 +227,7 @@ void FillSegment(const Argon2_instance_t* instance, Argon2_position_t position)
        // Previous block
        prev_offset = curr_offset - 1;
    }
-   memcpy(state, (uint8_t *) ((instance->memory + prev_offset)->v), ARGON2_BLOCK_SIZE);
+   state = instance->memory[prev_offset];
    for (uint32_t i = starting_index; i < instance->segment_length; ++i, ++curr_offset, ++prev_offset) {
        /*1.1 Rotating prev_offset if needed */
        if (curr_offset % instance->lane_length == 1) {
@@ -187,7 +256,7 @@ void FillSegment(const Argon2_instance_t* instance, Argon2_position_t position)
        /* 2 Creating a new block */
        block* ref_block = instance->memory + instance->lane_length * ref_lane + ref_index;
        block* curr_block = instance->memory + curr_offset;
-       FillBlock(state, (uint8_t *) ref_block->v, (uint8_t *) curr_block->v, instance->Sbox);
+       fill_block(&state, ref_block, curr_block, instance->Sbox);
    }
 
    delete[] pseudo_rands;
@@ -198,6 +267,7 @@ void GenerateSbox(Argon2_instance_t* instance) {
     if (instance == NULL) {
         return;
     }
+    const FillBlockKernel fill_block = ActiveFillBlock();
     block start_block(instance->memory[0]), out_block(0), zero_block(0);
     
     if (instance->Sbox == NULL) {
@@ -206,8 +276,8 @@ void GenerateSbox(Argon2_instance_t* instance) {
 
     for (uint32_t i = 0; i < ARGON2_SBOX_SIZE / ARGON2_WORDS_IN_BLOCK; ++i) {
         block zero_block(0), zero2_block(0);
-        FillBlock((__m128i*) zero_block.v, (uint8_t*) start_block.v, (uint8_t*) out_block.v, NULL);
-        FillBlock((__m128i*) zero2_block.v, (uint8_t*) out_block.v, (uint8_t*) start_block.v, NULL);
+        fill_block(&zero_block, &start_block, &out_block, NULL);
+        fill_block(&zero2_block, &out_block, &start_block, NULL);
         memcpy(instance->Sbox + i * ARGON2_WORDS_IN_BLOCK, start_block.v, ARGON2_BLOCK_SIZE);
     }
 }
@@ -0,0 +1,302 @@
+#include "audio_batch_transcriber.hh"
+#include "hegemonikon_log.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <thread>
+
+#include "audio_file_decoder.hh"
+
+namespace
+{
+    constexpr size_t DECODE_BLOCK_SAMPLES = WhisperInterface::SAMPLE_RATE;
+}
+
+/**
+ * @brief Bounded queue of the decoded samples of one file.
+ */
+struct AudioBatchTranscriber::Channel
+{
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<float> samples;
+    uint64_t n_decoded = 0;
+    bool closed = false;
+    bool cancelled = false;
+    std::string error;
+
+    /**
+     * @brief Appends samples, waiting while the queue is full.
+     *
+     * @return false if the batch was cancelled.
+     */
+    bool push(const float *data, size_t n)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&]()
+                     { return cancelled || samples.size() + n <= MAX_QUEUED_SAMPLES; });
+        if (cancelled)
+        {
+            return false;
+        }
+        samples.insert(samples.end(), data, data + n);
+        n_decoded += n;
+        changed.notify_all();
+        return true;
+    }
+
+    /**
+     * @brief Takes up to `max_samples` samples, waiting for the decoder; 0 at the end of the file.
+     */
+    size_t pop(float *buffer, size_t max_samples)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&]()
+                     { return closed || cancelled || !samples.empty(); });
+        const size_t n = std::min(max_samples, samples.size());
+        std::copy(samples.begin(), samples.begin() + static_cast<std::ptrdiff_t>(n), buffer);
+        samples.erase(samples.begin(), samples.begin() + static_cast<std::ptrdiff_t>(n));
+        changed.notify_all();
+        return n;
+    }
+
+    /**
+     * @brief Waits until the file has samples or has ended.
+     *
+     * @return true if there is audio to transcribe.
+     */
+    bool wait_for_audio()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&]()
+                     { return closed || cancelled || !samples.empty(); });
+        return !samples.empty() && error.empty();
+    }
+
+    void close(const std::string &message = "")
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        error = message;
+        changed.notify_all();
+    }
+
+    void cancel()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        cancelled = true;
+        changed.notify_all();
+    }
+};
+
+/**
+ * @brief Creates a batch transcriber.
+ *
+ * @param whisper The interface to transcribe with; its model must be loaded.
+ * @param n_decoders Number of decoder threads, which is also how many files are decoded
+ *                   ahead of the transcription.
+ * @param n_workers Number of files transcribed at once.
+ */
+AudioBatchTranscriber::AudioBatchTranscriber(std::shared_ptr<WhisperInterface> whisper, size_t n_decoders, size_t n_workers)
+    : whisper_(std::move(whisper)), n_decoders_(std::max<size_t>(1, n_decoders)), n_workers_(std::max<size_t>(1, n_workers))
+{
+}
+
+AudioBatchTranscriber::~AudioBatchTranscriber() = default;
+
+/**
+ * @brief Transcribes the files, reporting each one as soon as it is done.
+ *
+ * A file that cannot be decoded or transcribed gets an error in its result and does not
+ * stop the batch. If the callback throws, the batch stops and the exception is rethrown
+ * once the threads have ended.
+ *
+ * @param audio_file_paths The files, in the order they are decoded and transcribed.
+ * @param params Transcription parameters, the same for every file.
+ * @param on_result Optional, called with each result in completion order, one at a time.
+ * @return The results, in the order of `audio_file_paths`.
+ */
+std::vector<HegemonikonTranscriptionResult> AudioBatchTranscriber::run(const std::vector<std::string> &audio_file_paths,
+                                                                       const HegemonikonWhisperGenerationParams &params,
+                                                                       const transcription_result_callback_t &on_result)
+{
+    std::vector<HegemonikonTranscriptionResult> results(audio_file_paths.size());
+    if (audio_file_paths.empty())
+    {
+        return results;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        channels_.clear();
+        for (size_t i = 0; i < audio_file_paths.size(); ++i)
+        {
+            channels_.push_back(std::make_unique<Channel>());
+        }
+        next_decode_ = 0;
+        next_transcribe_ = 0;
+    }
+
+    std::mutex result_mutex;
+    std::exception_ptr failure;
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < std::min(n_decoders_, audio_file_paths.size()); ++i)
+    {
+        threads.emplace_back([&]()
+                             { decode_files(audio_file_paths); });
+    }
+    for (size_t i = 0; i < std::min(n_workers_, audio_file_paths.size()); ++i)
+    {
+        threads.emplace_back([&]()
+                             {
+            try
+            {
+                transcribe_files(audio_file_paths, params, results, on_result, result_mutex);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!failure)
+                {
+                    failure = std::current_exception();
+                }
+                // Unblock the decoders and the other workers, then let everyone stop.
+                next_transcribe_ = audio_file_paths.size();
+                next_decode_ = audio_file_paths.size();
+                for (const std::unique_ptr<Channel> &channel : channels_)
+                {
+                    channel->cancel();
+                }
+                progress_.notify_all();
+            } });
+    }
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+
+    channels_.clear();
+    if (failure)
+    {
+        std::rethrow_exception(failure);
+    }
+    return results;
+}
+
+/**
+ * @brief Decoder thread: decodes the next file into its channel, staying ahead of the workers.
+ */
+void AudioBatchTranscriber::decode_files(const std::vector<std::string> &paths)
+{
+    std::vector<float> block(DECODE_BLOCK_SAMPLES);
+    while (true)
+    {
+        Channel *channel = nullptr;
+        size_t index = 0;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            progress_.wait(lock, [&]()
+                           { return next_decode_ >= paths.size() || next_decode_ < next_transcribe_ + n_decoders_; });
+            if (next_decode_ >= paths.size())
+            {
+                return;
+            }
+            index = next_decode_++;
+            channel = channels_[index].get();
+        }
+
+        AudioFileDecoder decoder;
+        if (!decoder.open(paths[index]))
+        {
+            channel->close("[Error: Failed to load audio file: " + decoder.error() + "]");
+            continue;
+        }
+        bool cancelled = false;
+        size_t n_read = 0;
+        while (!cancelled && (n_read = decoder.read(block.data(), block.size())) > 0)
+        {
+            cancelled = !channel->push(block.data(), n_read);
+        }
+        if (decoder.failed())
+        {
+            channel->close("[Error: Failed to load audio file: " + decoder.error() + "]");
+        }
+        else
+        {
+            channel->close(decoder.samples_read() == 0 ? "[Error: Empty audio data]" : "");
+        }
+    }
+}
+
+/**
+ * @brief Worker thread: transcribes the next file from its channel and publishes the result.
+ */
+void AudioBatchTranscriber::transcribe_files(const std::vector<std::string> &paths, const HegemonikonWhisperGenerationParams &params,
+                                             std::vector<HegemonikonTranscriptionResult> &results,
+                                             const transcription_result_callback_t &on_result, std::mutex &result_mutex)
+{
+    while (true)
+    {
+        Channel *channel = nullptr;
+        size_t index = 0;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (next_transcribe_ >= paths.size())
+            {
+                return;
+            }
+            index = next_transcribe_++;
+            channel = channels_[index].get();
+        }
+        progress_.notify_all();
+
+        HegemonikonTranscriptionResult result;
+        result.index = index;
+        result.path = paths[index];
+        const auto start = std::chrono::steady_clock::now();
+        HegemonikonTranscription transcription;
+        if (channel->wait_for_audio())
+        {
+            transcription = whisper_->transcribe_stream_segments([channel](float *buffer, size_t max_samples)
+                                                                 { return channel->pop(buffer, max_samples); },
+                                                                 params);
+        }
+        result.transcribe_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        {
+            std::lock_guard<std::mutex> lock(channel->mutex);
+            if (channel->cancelled)
+            {
+                return;
+            }
+            result.audio_seconds = static_cast<double>(channel->n_decoded) / WhisperInterface::SAMPLE_RATE;
+            result.error = channel->error;
+            channel->samples.clear();
+        }
+        if (result.error.empty())
+        {
+            result.error = transcription.error;
+        }
+        if (result.error.empty())
+        {
+            result.text = transcription.text();
+            result.segments = std::move(transcription.segments);
+        }
+        else
+        {
+            if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+            {
+                std::cerr << "AudioBatchTranscriber Error: " << result.path << ": " << result.error << std::endl;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(result_mutex);
+        results[index] = std::move(result);
+        if (on_result)
+        {
+            on_result(results[index]);
+        }
+    }
+}
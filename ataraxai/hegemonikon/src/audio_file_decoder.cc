@@ -0,0 +1,88 @@
+#include "audio_file_decoder.hh"
+#include "hegemonikon_log.hh"
+#include "trace_recorder.hh"
+
+#include <iostream>
+
+#define MINIAUDIO_IMPLEMENTATION
+#include "miniaudio.h"
+
+AudioFileDecoder::AudioFileDecoder() = default;
+
+AudioFileDecoder::~AudioFileDecoder()
+{
+    close();
+}
+
+/**
+ * @brief Opens an audio file for decoding, closing the previous one.
+ *
+ * @param path The path of the audio file; supported formats depend on the miniaudio build.
+ * @return true if the decoder is ready; false otherwise (see error()).
+ */
+bool AudioFileDecoder::open(const std::string &path)
+{
+    close();
+    path_ = path;
+    samples_read_ = 0;
+    failed_ = false;
+    error_.clear();
+
+    TraceSpan span("audio_open", "audio");
+    auto decoder = std::make_unique<ma_decoder>();
+    ma_decoder_config config = ma_decoder_config_init(ma_format_f32, 1, SAMPLE_RATE); // Target: f32, 1 channel, 16kHz
+    const ma_result result = ma_decoder_init_file(path.c_str(), &config, decoder.get());
+    if (result != MA_SUCCESS)
+    {
+        failed_ = true;
+        error_ = ma_result_description(result);
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+        {
+            std::cerr << "Failed to initialize audio decoder for: " << path << " Error: " << error_ << std::endl;
+        }
+        return false;
+    }
+    decoder_ = std::move(decoder);
+    return true;
+}
+
+void AudioFileDecoder::close()
+{
+    if (decoder_)
+    {
+        ma_decoder_uninit(decoder_.get());
+        decoder_.reset();
+    }
+}
+
+/**
+ * @brief Decodes the next samples of the file.
+ *
+ * @param buffer Receives up to max_samples 16 kHz mono samples.
+ * @param max_samples Capacity of the buffer in samples.
+ * @return The number of samples written; 0 at the end of the file or on error.
+ */
+size_t AudioFileDecoder::read(float *buffer, size_t max_samples)
+{
+    if (!decoder_ || max_samples == 0)
+    {
+        return 0;
+    }
+    TraceSpan span("audio_decode", "audio");
+    ma_uint64 frames_read = 0;
+    const ma_result result = ma_decoder_read_pcm_frames(decoder_.get(), buffer, max_samples, &frames_read);
+    span.set_arg("n_samples", static_cast<int64_t>(frames_read));
+    if (result != MA_SUCCESS && result != MA_AT_END)
+    {
+        failed_ = true;
+        error_ = ma_result_description(result);
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+        {
+            std::cerr << "Failed to read PCM frames for: " << path_ << " after " << samples_read_
+                      << " samples. Error: " << error_ << std::endl;
+        }
+        close();
+    }
+    samples_read_ += frames_read;
+    return static_cast<size_t>(frames_read);
+}
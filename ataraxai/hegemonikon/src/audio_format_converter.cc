@@ -0,0 +1,235 @@
+#include "audio_format_converter.hh"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+    constexpr float S16_SCALE = 1.0f / 32768.0f;
+    constexpr double LOW_PASS_HZ = 7000.0;
+    constexpr double PI = 3.14159265358979323846;
+
+    /**
+     * @brief Blackman-windowed sinc low-pass; 32 taps per unit of decimation ratio keep the
+     *        transition band under 3 kHz whatever the device rate.
+     */
+    std::vector<float> make_low_pass(double step, uint32_t sample_rate)
+    {
+        const size_t n_taps = 32 * static_cast<size_t>(std::ceil(step)) + 1;
+        const double cutoff = LOW_PASS_HZ / sample_rate;
+        const double middle = static_cast<double>(n_taps - 1) / 2.0;
+        std::vector<double> taps(n_taps);
+        double sum = 0.0;
+        for (size_t i = 0; i < n_taps; ++i)
+        {
+            const double x = static_cast<double>(i) - middle;
+            const double sinc = x == 0.0 ? 2.0 * cutoff : std::sin(2.0 * PI * cutoff * x) / (PI * x);
+            const double window = 0.42 - 0.5 * std::cos(2.0 * PI * i / (n_taps - 1)) + 0.08 * std::cos(4.0 * PI * i / (n_taps - 1));
+            taps[i] = sinc * window;
+            sum += taps[i];
+        }
+        std::vector<float> normalized(n_taps);
+        for (size_t i = 0; i < n_taps; ++i)
+        {
+            normalized[i] = static_cast<float>(taps[i] / sum);
+        }
+        return normalized;
+    }
+}
+
+/**
+ * @brief Creates a converter for one device format.
+ *
+ * @param format Format of the device samples.
+ * @param n_channels Number of interleaved channels, at least 1.
+ * @param sample_rate Rate of the device in Hz.
+ */
+AudioFormatConverter::AudioFormatConverter(AudioSampleFormat format, uint32_t n_channels, uint32_t sample_rate)
+    : format_(format), n_channels_(std::max<uint32_t>(1, n_channels)),
+      sample_rate_(sample_rate > 0 ? sample_rate : TARGET_SAMPLE_RATE),
+      step_(static_cast<double>(sample_rate_) / TARGET_SAMPLE_RATE)
+{
+    taps_ = step_ > 1.0 ? make_low_pass(step_, sample_rate_) : std::vector<float>{1.0f};
+    interleaved_.resize(MAX_BLOCK_FRAMES * n_channels_);
+    mono_.resize(taps_.size() - 1 + MAX_BLOCK_FRAMES);
+    filtered_.resize(MAX_BLOCK_FRAMES);
+}
+
+/**
+ * @brief Upper bound on the samples convert() writes for `n_frames` input frames.
+ */
+size_t AudioFormatConverter::max_output(size_t n_frames) const
+{
+    return static_cast<size_t>(std::ceil(n_frames / step_)) + 2;
+}
+
+/**
+ * @brief Forgets the previous blocks, for a new stream.
+ */
+void AudioFormatConverter::reset()
+{
+    position_ = 0.0;
+    last_ = 0.0f;
+    std::fill(mono_.begin(), mono_.end(), 0.0f);
+}
+
+/**
+ * @brief Converts interleaved frames to 16 kHz mono samples.
+ *
+ * @param input `n_frames` frames of `n_channels` samples in the device format.
+ * @param n_frames Number of frames.
+ * @param output Receives the samples; must hold max_output(n_frames).
+ * @return The number of samples written.
+ */
+size_t AudioFormatConverter::convert(const void *input, size_t n_frames, float *output)
+{
+    const size_t sample_size = format_ == AudioSampleFormat::S16 ? sizeof(int16_t) : sizeof(float);
+    const auto *bytes = static_cast<const uint8_t *>(input);
+    size_t n_written = 0;
+    for (size_t frame = 0; frame < n_frames; frame += MAX_BLOCK_FRAMES)
+    {
+        const size_t n_block = std::min(MAX_BLOCK_FRAMES, n_frames - frame);
+        n_written += convert_block(bytes + frame * n_channels_ * sample_size, n_block, output + n_written);
+    }
+    return n_written;
+}
+
+size_t AudioFormatConverter::convert_block(const void *input, size_t n_frames, float *output)
+{
+    const size_t history = taps_.size() - 1;
+    float *mono = mono_.data() + history;
+    const float *samples = static_cast<const float *>(input);
+    if (format_ == AudioSampleFormat::S16)
+    {
+        float *converted = n_channels_ == 1 ? mono : interleaved_.data();
+        s16_to_f32(static_cast<const int16_t *>(input), converted, n_frames * n_channels_);
+        samples = converted;
+    }
+    if (n_channels_ > 1)
+    {
+        downmix(samples, n_frames, n_channels_, mono);
+    }
+    else if (samples != mono)
+    {
+        std::copy(samples, samples + n_frames, mono);
+    }
+
+    if (sample_rate_ == TARGET_SAMPLE_RATE)
+    {
+        std::copy(mono, mono + n_frames, output);
+        return n_frames;
+    }
+
+    // Low-pass over the block and the tail of the previous one, one tap at a time so that
+    // the inner loop vectorizes.
+    const float *filtered = mono;
+    if (history > 0)
+    {
+        std::fill(filtered_.begin(), filtered_.begin() + static_cast<std::ptrdiff_t>(n_frames), 0.0f);
+        float *out = filtered_.data();
+        for (size_t k = 0; k < taps_.size(); ++k)
+        {
+            const float tap = taps_[k];
+            const float *in = mono_.data() + k;
+            for (size_t i = 0; i < n_frames; ++i)
+            {
+                out[i] += tap * in[i];
+            }
+        }
+        std::copy(mono_.begin() + static_cast<std::ptrdiff_t>(n_frames),
+                  mono_.begin() + static_cast<std::ptrdiff_t>(n_frames + history), mono_.begin());
+        filtered = filtered_.data();
+    }
+
+    size_t n_written = 0;
+    const double end = static_cast<double>(n_frames) - 1.0;
+    while (position_ < end)
+    {
+        const double base = std::floor(position_);
+        const auto index = static_cast<std::ptrdiff_t>(base);
+        const float frac = static_cast<float>(position_ - base);
+        const float a = index < 0 ? last_ : filtered[index];
+        const float b = filtered[index + 1];
+        output[n_written++] = a + frac * (b - a);
+        position_ += step_;
+    }
+    position_ -= static_cast<double>(n_frames);
+    last_ = filtered[n_frames - 1];
+    return n_written;
+}
+
+/**
+ * @brief Converts int16 samples to floats in [-1, 1).
+ */
+void AudioFormatConverter::s16_to_f32(const int16_t *input, float *output, size_t n_samples)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128 scale = _mm_set1_ps(S16_SCALE);
+    for (; i + 8 <= n_samples; i += 8)
+    {
+        const __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i *>(input + i));
+        // Sign-extend by placing each sample in the high half of a 32-bit lane, then shifting down.
+        const __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(packed, packed), 16);
+        const __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(packed, packed), 16);
+        _mm_storeu_ps(output + i, _mm_mul_ps(_mm_cvtepi32_ps(low), scale));
+        _mm_storeu_ps(output + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(high), scale));
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 8 <= n_samples; i += 8)
+    {
+        const int16x8_t packed = vld1q_s16(input + i);
+        vst1q_f32(output + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(packed))), S16_SCALE));
+        vst1q_f32(output + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(packed))), S16_SCALE));
+    }
+#endif
+    for (; i < n_samples; ++i)
+    {
+        output[i] = static_cast<float>(input[i]) * S16_SCALE;
+    }
+}
+
+/**
+ * @brief Averages the channels of interleaved frames into one.
+ */
+void AudioFormatConverter::downmix(const float *input, size_t n_frames, uint32_t n_channels, float *output)
+{
+    size_t frame = 0;
+    if (n_channels == 2)
+    {
+#if defined(__SSE2__)
+        const __m128 half = _mm_set1_ps(0.5f);
+        for (; frame + 4 <= n_frames; frame += 4)
+        {
+            const __m128 a = _mm_loadu_ps(input + 2 * frame);
+            const __m128 b = _mm_loadu_ps(input + 2 * frame + 4);
+            const __m128 left = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+            const __m128 right = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+            _mm_storeu_ps(output + frame, _mm_mul_ps(_mm_add_ps(left, right), half));
+        }
+#elif defined(__ARM_NEON)
+        for (; frame + 4 <= n_frames; frame += 4)
+        {
+            const float32x4x2_t channels = vld2q_f32(input + 2 * frame);
+            vst1q_f32(output + frame, vmulq_n_f32(vaddq_f32(channels.val[0], channels.val[1]), 0.5f));
+        }
+#endif
+    }
+
+    const float scale = 1.0f / static_cast<float>(n_channels);
+    for (; frame < n_frames; ++frame)
+    {
+        float sum = 0.0f;
+        for (uint32_t channel = 0; channel < n_channels; ++channel)
+        {
+            sum += input[frame * n_channels + channel];
+        }
+        output[frame] = sum * scale;
+    }
+}
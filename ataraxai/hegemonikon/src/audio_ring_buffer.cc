@@ -0,0 +1,67 @@
+#include "audio_ring_buffer.hh"
+
+#include <algorithm>
+
+/**
+ * @brief Creates a ring holding at least `min_capacity` samples, rounded up to a power of two.
+ */
+AudioRingBuffer::AudioRingBuffer(size_t min_capacity)
+{
+    size_t capacity = 1;
+    while (capacity < min_capacity)
+    {
+        capacity <<= 1;
+    }
+    buffer_.assign(capacity, 0.0f);
+    mask_ = capacity - 1;
+}
+
+/**
+ * @brief Producer side: appends samples, dropping those that do not fit.
+ *
+ * @return The number of samples written.
+ */
+size_t AudioRingBuffer::write(const float *samples, size_t n_samples)
+{
+    const size_t write_pos = write_pos_.load(std::memory_order_relaxed);
+    const size_t read_pos = read_pos_.load(std::memory_order_acquire);
+    const size_t n = std::min(n_samples, buffer_.size() - (write_pos - read_pos));
+    if (n < n_samples)
+    {
+        dropped_.fetch_add(n_samples - n, std::memory_order_relaxed);
+    }
+
+    const size_t start = write_pos & mask_;
+    const size_t first = std::min(n, buffer_.size() - start);
+    std::copy(samples, samples + first, buffer_.begin() + static_cast<std::ptrdiff_t>(start));
+    std::copy(samples + first, samples + n, buffer_.begin());
+    write_pos_.store(write_pos + n, std::memory_order_release);
+    return n;
+}
+
+/**
+ * @brief Consumer side: takes up to `max_samples` samples, without waiting.
+ *
+ * @return The number of samples read, 0 if the ring is empty.
+ */
+size_t AudioRingBuffer::read(float *buffer, size_t max_samples)
+{
+    const size_t read_pos = read_pos_.load(std::memory_order_relaxed);
+    const size_t write_pos = write_pos_.load(std::memory_order_acquire);
+    const size_t n = std::min(max_samples, write_pos - read_pos);
+
+    const size_t start = read_pos & mask_;
+    const size_t first = std::min(n, buffer_.size() - start);
+    std::copy(buffer_.begin() + static_cast<std::ptrdiff_t>(start), buffer_.begin() + static_cast<std::ptrdiff_t>(start + first), buffer);
+    std::copy(buffer_.begin(), buffer_.begin() + static_cast<std::ptrdiff_t>(n - first), buffer + first);
+    read_pos_.store(read_pos + n, std::memory_order_release);
+    return n;
+}
+
+/**
+ * @brief Number of samples the consumer can read; exact on the consumer thread.
+ */
+size_t AudioRingBuffer::read_available() const
+{
+    return write_pos_.load(std::memory_order_acquire) - read_pos_.load(std::memory_order_relaxed);
+}
@@ -1,14 +1,112 @@
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
+#include <pybind11/functional.h>
+#include <pybind11/numpy.h>
 #include <thread>
 #include <algorithm>
 
 #include "core_ai_service.hh"
+#include "llama_load_benchmarker.hh"
+#include "llama_offload_planner.hh"
 #include "model_benchmarker.hh"
+#include "whisper_benchmarker.hh"
 #include "memory_locker.hh"
 
 namespace py = pybind11;
 
+/**
+ * @brief Borrows the UTF-8 bytes of every str/bytes item of a Python sequence.
+ *
+ * The views point into the Python objects, which the caller's argument keeps alive,
+ * so the texts are never copied and can be read with the GIL released.
+ */
+static std::vector<std::string_view> borrow_texts(const py::sequence &texts)
+{
+     std::vector<std::string_view> views;
+     views.reserve(texts.size());
+     for (const py::handle item : texts)
+     {
+          if (PyUnicode_Check(item.ptr()))
+          {
+               Py_ssize_t size = 0;
+               const char *data = PyUnicode_AsUTF8AndSize(item.ptr(), &size);
+               if (!data)
+                    throw py::error_already_set();
+               views.emplace_back(data, static_cast<size_t>(size));
+          }
+          else if (PyBytes_Check(item.ptr()))
+          {
+               views.emplace_back(PyBytes_AS_STRING(item.ptr()), static_cast<size_t>(PyBytes_GET_SIZE(item.ptr())));
+          }
+          else
+          {
+               throw py::type_error("expected a sequence of str or bytes");
+          }
+     }
+     return views;
+}
+
+/**
+ * @brief Hands a vector over to NumPy without copying it.
+ */
+template <typename T>
+static py::array_t<T> vector_to_array(std::vector<T> &&values)
+{
+     auto *owned = new std::vector<T>(std::move(values));
+     py::capsule release(owned, [](void *p)
+                         { delete static_cast<std::vector<T> *>(p); });
+     return py::array_t<T>(static_cast<py::ssize_t>(owned->size()), owned->data(), release);
+}
+
+using float_array = py::array_t<float, py::array::c_style | py::array::forcecast>;
+using int32_array = py::array_t<int32_t, py::array::c_style | py::array::forcecast>;
+
+/**
+ * @brief Reads the samples of a one-dimensional array in place.
+ *
+ * pybind only converts the argument when it is not already a contiguous array of the
+ * right dtype, so float32 NumPy arrays and buffers reach C++ without a copy. The pointer
+ * stays valid while the caller holds the array, including with the GIL released.
+ */
+template <typename T>
+static void borrow_array(const py::array_t<T, py::array::c_style | py::array::forcecast> &array,
+                         const T *&data, size_t &size)
+{
+     if (array.ndim() > 1)
+     {
+          throw py::value_error("expected a one-dimensional array");
+     }
+     data = array.data();
+     size = static_cast<size_t>(array.size());
+}
+
+/**
+ * @brief Deletes native objects whose destructor joins a thread that may call into Python.
+ */
+template <typename T>
+struct gil_releasing_delete
+{
+     void operator()(T *object) const
+     {
+          py::gil_scoped_release release;
+          delete object;
+     }
+};
+
+/**
+ * @brief Hands a row-major matrix over to NumPy without copying it.
+ */
+template <typename T>
+static py::array_t<T> matrix_to_array(std::vector<T> &&values, size_t rows, size_t cols)
+{
+     auto *owned = new std::vector<T>(std::move(values));
+     py::capsule release(owned, [](void *p)
+                         { delete static_cast<std::vector<T> *>(p); });
+     return py::array_t<T>({static_cast<py::ssize_t>(rows), static_cast<py::ssize_t>(cols)},
+                           {static_cast<py::ssize_t>(cols * sizeof(T)), static_cast<py::ssize_t>(sizeof(T))},
+                           owned->data(), release);
+}
+
 PYBIND11_MODULE(hegemonikon_py, m)
 {
      m.doc() = "Python bindings for the AtaraxAI Core AI C++ engine. Provides access to LLM, STT, and other AI functionalities.";
@@ -20,10 +118,10 @@ PYBIND11_MODULE(hegemonikon_py, m)
               py::arg("n_ctx") = 2048,
               py::arg("n_gpu_layers") = 0,
               py::arg("main_gpu") = 0,
-              py::arg("n_batch") = 1,
+              py::arg("n_batch") = 512,
               py::arg("tensor_split") = false,
               py::arg("vocab_only") = false,
-              py::arg("use_map") = false,
+              py::arg("use_map") = true,
               py::arg("use_mlock") = false)
          .def_static("from_dict", [](const py::dict &d)
                      {
@@ -32,22 +130,50 @@ PYBIND11_MODULE(hegemonikon_py, m)
      params.n_ctx = d.attr("get")("n_ctx", 2048).cast<int32_t>();
      params.n_gpu_layers = d.attr("get")("n_gpu_layers", 0).cast<int32_t>();
      params.main_gpu = d.attr("get")("main_gpu", 0).cast<int32_t>();
-     params.n_batch = d.attr("get")("n_batch", 1).cast<int32_t>();
+     params.n_batch = d.attr("get")("n_batch", 512).cast<int32_t>();
+     params.n_ubatch = d.attr("get")("n_ubatch", 512).cast<int32_t>();
      params.tensor_split = d.attr("get")("tensor_split", false).cast<bool>();
      params.vocab_only = d.attr("get")("vocab_only", false).cast<bool>();
-     params.use_map = d.attr("get")("use_map", false).cast<bool>();
+     params.use_map = d.attr("get")("use_map", true).cast<bool>();
      params.use_mlock = d.attr("get")("use_mlock", false).cast<bool>();
+     params.warmup = d.attr("get")("warmup", true).cast<bool>();
+     params.n_seq_max = d.attr("get")("n_seq_max", 4).cast<int32_t>();
+     params.prefix_cache_slots = d.attr("get")("prefix_cache_slots", 2).cast<int32_t>();
+     params.prefix_cache_max_tokens = d.attr("get")("prefix_cache_max_tokens", 2048).cast<int32_t>();
+     params.draft_model_path = d.attr("get")("draft_model_path", "").cast<std::string>();
+     params.draft_n_gpu_layers = d.attr("get")("draft_n_gpu_layers", 0).cast<int32_t>();
+     params.cache_type_k = d.attr("get")("cache_type_k", "f16").cast<std::string>();
+     params.cache_type_v = d.attr("get")("cache_type_v", "f16").cast<std::string>();
+     params.embeddings = d.attr("get")("embeddings", false).cast<bool>();
+     params.pooling_type = d.attr("get")("pooling_type", "").cast<std::string>();
+     params.flash_attn = d.attr("get")("flash_attn", "auto").cast<std::string>();
+     params.n_threads = d.attr("get")("n_threads", 0).cast<int32_t>();
+     params.n_threads_batch = d.attr("get")("n_threads_batch", 0).cast<int32_t>();
      return params; })
          .def("set_model_path", &HegemonikonLlamaModelParams::set_model_path, "Set the model file path.")
          .def_readwrite("model_path", &HegemonikonLlamaModelParams::model_path, "Path to the GGUF model file.")
          .def_readwrite("n_gpu_layers", &HegemonikonLlamaModelParams::n_gpu_layers, "Number of layers to offload to GPU.")
          .def_readwrite("n_ctx", &HegemonikonLlamaModelParams::n_ctx, "Context size for the model.")
          .def_readwrite("main_gpu", &HegemonikonLlamaModelParams::main_gpu, "Main GPU index for model loading.")
-         .def_readwrite("n_batch", &HegemonikonLlamaModelParams::n_batch, "Batch size for model inference.")
+         .def_readwrite("n_batch", &HegemonikonLlamaModelParams::n_batch, "Logical batch size: maximum number of tokens per decode call.")
+         .def_readwrite("n_ubatch", &HegemonikonLlamaModelParams::n_ubatch, "Physical batch size, also the prefill budget of steps that carry in-flight decodes.")
          .def_readwrite("tensor_split", &HegemonikonLlamaModelParams::tensor_split, "Whether to use tensor splitting for large models.")
          .def_readwrite("vocab_only", &HegemonikonLlamaModelParams::vocab_only, "Load only the vocabulary without the model.")
          .def_readwrite("use_map", &HegemonikonLlamaModelParams::use_map, "Use memory mapping for the model file.")
          .def_readwrite("use_mlock", &HegemonikonLlamaModelParams::use_mlock, "Lock model memory to prevent swapping.")
+         .def_readwrite("warmup", &HegemonikonLlamaModelParams::warmup, "Run a one-token decode after loading so the first request is not slowed by backend setup.")
+         .def_readwrite("n_seq_max", &HegemonikonLlamaModelParams::n_seq_max, "Maximum number of chat sessions kept in the KV cache.")
+         .def_readwrite("prefix_cache_slots", &HegemonikonLlamaModelParams::prefix_cache_slots, "Number of shared prompt prefixes that can be cached (0 disables the cache).")
+         .def_readwrite("prefix_cache_max_tokens", &HegemonikonLlamaModelParams::prefix_cache_max_tokens, "Total number of tokens the prefix cache may keep.")
+         .def_readwrite("draft_model_path", &HegemonikonLlamaModelParams::draft_model_path, "Path to a small draft GGUF sharing the vocabulary, enables speculative decoding.")
+         .def_readwrite("draft_n_gpu_layers", &HegemonikonLlamaModelParams::draft_n_gpu_layers, "Number of draft model layers to offload to GPU.")
+         .def_readwrite("cache_type_k", &HegemonikonLlamaModelParams::cache_type_k, "Type of the K cache: 'f16' (default), 'f32', 'bf16', 'q8_0', 'q5_1', 'q5_0', 'q4_1', 'q4_0' or 'iq4_nl'.")
+         .def_readwrite("cache_type_v", &HegemonikonLlamaModelParams::cache_type_v, "Type of the V cache; quantized types enable flash attention.")
+         .def_readwrite("embeddings", &HegemonikonLlamaModelParams::embeddings, "Load the model as an embedding model (pooled vectors instead of text generation).")
+         .def_readwrite("pooling_type", &HegemonikonLlamaModelParams::pooling_type, "Pooling of an embedding model: 'mean', 'cls', 'last', or '' for the model default.")
+         .def_readwrite("flash_attn", &HegemonikonLlamaModelParams::flash_attn, "Flash attention: 'auto' (default), 'on' or 'off'.")
+         .def_readwrite("n_threads", &HegemonikonLlamaModelParams::n_threads, "Threads of single-token decodes, 0 for half the logical CPUs.")
+         .def_readwrite("n_threads_batch", &HegemonikonLlamaModelParams::n_threads_batch, "Threads of prompt decodes, 0 for all the logical CPUs.")
          .def("__eq__", [](const HegemonikonLlamaModelParams &a, const HegemonikonLlamaModelParams &b)
               { return a == b; })
          .def("__ne__", [](const HegemonikonLlamaModelParams &a, const HegemonikonLlamaModelParams &b)
@@ -57,6 +183,11 @@ PYBIND11_MODULE(hegemonikon_py, m)
          .def("__str__", [](const HegemonikonLlamaModelParams &p)
               { return p.to_string(); });
 
+     py::enum_<LlamaRequestPriority>(m, "LlamaRequestPriority", "Scheduling class of a request on the batching scheduler.")
+         .value("INTERACTIVE", LlamaRequestPriority::Interactive)
+         .value("BATCH", LlamaRequestPriority::Batch)
+         .value("BACKGROUND", LlamaRequestPriority::Background);
+
      py::class_<HegemonikonGenerationParams>(m, "HegemonikonGenerationParams", "Parameters for Llama text generation.")
          .def(py::init<>())
          .def(py::init<int32_t, float, int32_t, float, float, int32_t, float, float,
@@ -86,6 +217,16 @@ PYBIND11_MODULE(hegemonikon_py, m)
                          params.stop_sequences = d.attr("get")("stop_sequences", std::vector<std::string>{}).cast<std::vector<std::string>>();
                          params.n_batch = d.attr("get")("n_batch", 512).cast<int32_t>();
                          params.n_threads = d.attr("get")("n_threads", 0).cast<int32_t>();
+                         params.session_id = d.attr("get")("session_id", "").cast<std::string>();
+                         params.n_draft = d.attr("get")("n_draft", 4).cast<int32_t>();
+                         params.timeout_ms = d.attr("get")("timeout_ms", 0).cast<int32_t>();
+                         params.context_shift = d.attr("get")("context_shift", false).cast<bool>();
+                         params.n_keep = d.attr("get")("n_keep", 0).cast<int32_t>();
+                         params.priority = d.attr("get")("priority", LlamaRequestPriority::Interactive).cast<LlamaRequestPriority>();
+                         params.prompt_lookup = d.attr("get")("prompt_lookup", false).cast<bool>();
+                         params.n_lookup_draft = d.attr("get")("n_lookup_draft", 8).cast<int32_t>();
+                         params.lookup_ngram_min = d.attr("get")("lookup_ngram_min", 2).cast<int32_t>();
+                         params.lookup_ngram_max = d.attr("get")("lookup_ngram_max", 4).cast<int32_t>();
                          return params; })
          .def_readwrite("n_predict", &HegemonikonGenerationParams::n_predict)
          .def_readwrite("temperature", &HegemonikonGenerationParams::temperature)
@@ -98,6 +239,16 @@ PYBIND11_MODULE(hegemonikon_py, m)
          .def_readwrite("stop_sequences", &HegemonikonGenerationParams::stop_sequences)
          .def_readwrite("n_batch", &HegemonikonGenerationParams::n_batch)
          .def_readwrite("n_threads", &HegemonikonGenerationParams::n_threads)
+         .def_readwrite("session_id", &HegemonikonGenerationParams::session_id, "Session whose KV cache is reused across calls; empty for stateless generation.")
+         .def_readwrite("n_draft", &HegemonikonGenerationParams::n_draft, "Maximum tokens proposed per speculative step when a draft model is loaded (0 disables).")
+         .def_readwrite("timeout_ms", &HegemonikonGenerationParams::timeout_ms, "Wall-clock budget of the request in milliseconds (0 for no limit).")
+         .def_readwrite("context_shift", &HegemonikonGenerationParams::context_shift, "Discard the oldest tokens after the first n_keep instead of failing or stopping when the context is full.")
+         .def_readwrite("n_keep", &HegemonikonGenerationParams::n_keep, "Number of leading tokens (system prompt) never discarded by a context shift.")
+         .def_readwrite("priority", &HegemonikonGenerationParams::priority, "Scheduling class on the batching scheduler; background requests are held and preempted for interactive ones.")
+         .def_readwrite("prompt_lookup", &HegemonikonGenerationParams::prompt_lookup, "Propose the tokens that followed earlier occurrences of the last tokens in the context as drafts, without a draft model.")
+         .def_readwrite("n_lookup_draft", &HegemonikonGenerationParams::n_lookup_draft, "Maximum tokens proposed per prompt-lookup step.")
+         .def_readwrite("lookup_ngram_min", &HegemonikonGenerationParams::lookup_ngram_min, "Shortest run of tokens matched by prompt lookup.")
+         .def_readwrite("lookup_ngram_max", &HegemonikonGenerationParams::lookup_ngram_max, "Longest run of tokens matched by prompt lookup, tried first.")
          .def("__eq__", [](const HegemonikonGenerationParams &a, const HegemonikonGenerationParams &b)
               { return a == b; })
          .def("__ne__", [](const HegemonikonGenerationParams &a, const HegemonikonGenerationParams &b)
@@ -125,6 +276,9 @@ PYBIND11_MODULE(hegemonikon_py, m)
                               params.flash_attn = d.attr("get")("flash_attn", false).cast<bool>();
                               params.audio_ctx = d.attr("get")("audio_ctx", 0).cast<int32_t>();
                               params.n_threads = d.attr("get")("n_threads", (std::min)(4, (int32_t)std::thread::hardware_concurrency())).cast<int32_t>();
+                              params.n_processors = d.attr("get")("n_processors", 1).cast<int32_t>();
+                              params.warmup = d.attr("get")("warmup", true).cast<bool>();
+                              params.keep_resident = d.attr("get")("keep_resident", false).cast<bool>();
                               return params; })
          .def_readwrite("model", &HegemonikonWhisperModelParams::model, "Path to the Whisper GGUF model file.")
          .def_readwrite("language", &HegemonikonWhisperModelParams::language, "Language for the Whisper model (e.g., 'en', 'auto').")
@@ -132,6 +286,9 @@ PYBIND11_MODULE(hegemonikon_py, m)
          .def_readwrite("flash_attn", &HegemonikonWhisperModelParams::flash_attn, "Whether to use flash attention for faster processing.")
          .def_readwrite("audio_ctx", &HegemonikonWhisperModelParams::audio_ctx, "Audio context size for the model.")
          .def_readwrite("n_threads", &HegemonikonWhisperModelParams::n_threads, "Number of threads to use for processing.")
+         .def_readwrite("n_processors", &HegemonikonWhisperModelParams::n_processors, "Number of pieces of long audio transcribed concurrently, each on its own whisper state.")
+         .def_readwrite("warmup", &HegemonikonWhisperModelParams::warmup, "Whether to warm up the whisper states when the model is loaded.")
+         .def_readwrite("keep_resident", &HegemonikonWhisperModelParams::keep_resident, "Whether the model stays loaded across unload_whisper_model and service lifetimes.")
          .def("__eq__", [](const HegemonikonWhisperModelParams &a, const HegemonikonWhisperModelParams &b)
               { return a == b; })
          .def("__ne__", [](const HegemonikonWhisperModelParams &a, const HegemonikonWhisperModelParams &b)
@@ -169,6 +326,7 @@ PYBIND11_MODULE(hegemonikon_py, m)
      params.capture_id = d.attr("get")("capture_id", 0).cast<int32_t>();
      params.vad_thold = d.attr("get")("vad_thold", 200).cast<int32_t>();
      params.freq_thold = d.attr("get")("freq_thold", 0).cast<int32_t>();
+     params.vad = d.attr("get")("vad", false).cast<bool>();
      params.translate = d.attr("get")("translate", false).cast<bool>();
      params.tinydiarize = d.attr("get")("tinydiarize", false).cast<bool>();
      params.no_fallback = d.attr("get")("no_fallback", false).cast<bool>();
@@ -177,6 +335,7 @@ PYBIND11_MODULE(hegemonikon_py, m)
      params.beam_size = d.attr("get")("beam_size", 1).cast<int32_t>();
      params.print_special = d.attr("get")("print_special", false).cast<bool>();
      params.no_timestamps = d.attr("get")("no_timestamps", false).cast<bool>();
+     params.token_timestamps = d.attr("get")("token_timestamps", false).cast<bool>();
      params.save_audio = d.attr("get")("save_audio", false).cast<bool>();
      params.fname_out = d.attr("get")("fname_out", "").cast<std::string>();
      return params; })
@@ -186,6 +345,7 @@ PYBIND11_MODULE(hegemonikon_py, m)
          .def_readwrite("capture_id", &HegemonikonWhisperGenerationParams::capture_id, "Capture device ID for audio input.")
          .def_readwrite("vad_thold", &HegemonikonWhisperGenerationParams::vad_thold, "Voice Activity Detection threshold.")
          .def_readwrite("freq_thold", &HegemonikonWhisperGenerationParams::freq_thold, "Frequency threshold for audio processing.")
+         .def_readwrite("vad", &HegemonikonWhisperGenerationParams::vad, "Whether to cut silence out of the audio before transcription.")
          .def_readwrite("translate", &HegemonikonWhisperGenerationParams::translate, "Whether to translate the audio to English.")
          .def_readwrite("tinydiarize", &HegemonikonWhisperGenerationParams::tinydiarize, "Whether to use tiny diarization for speaker separation.")
          .def_readwrite("no_fallback", &HegemonikonWhisperGenerationParams::no_fallback, "Whether to disable fallback to non-diarized transcription.")
@@ -194,6 +354,7 @@ PYBIND11_MODULE(hegemonikon_py, m)
          .def_readwrite("beam_size", &HegemonikonWhisperGenerationParams::beam_size, "Beam size for beam search decoding.")
          .def_readwrite("print_special", &HegemonikonWhisperGenerationParams::print_special, "Whether to print special tokens in the output.")
          .def_readwrite("no_timestamps", &HegemonikonWhisperGenerationParams::no_timestamps, "Whether to disable timestamps in the output.")
+         .def_readwrite("token_timestamps", &HegemonikonWhisperGenerationParams::token_timestamps, "Whether segments carry the timestamps and probabilities of their tokens.")
          .def_readwrite("save_audio", &HegemonikonWhisperGenerationParams::save_audio, "Whether to save the processed audio.")
          .def_readwrite("fname_out", &HegemonikonWhisperGenerationParams::fname_out, "Output filename for the processed audio.")
          .def("__eq__", [](const HegemonikonWhisperGenerationParams &a, const HegemonikonWhisperGenerationParams &b)
@@ -205,28 +366,617 @@ PYBIND11_MODULE(hegemonikon_py, m)
          .def("__str__", [](const HegemonikonWhisperGenerationParams &p)
               { return p.to_string(); });
 
+     py::class_<HegemonikonPrefixCacheStats>(m, "HegemonikonPrefixCacheStats", "Counters describing the prompt prefix cache.")
+         .def(py::init<>())
+         .def_readonly("hits", &HegemonikonPrefixCacheStats::hits, "Number of prompts that reused a cached prefix.")
+         .def_readonly("misses", &HegemonikonPrefixCacheStats::misses, "Number of prompts that found no cached prefix.")
+         .def_readonly("reused_tokens", &HegemonikonPrefixCacheStats::reused_tokens, "Total number of prompt tokens served from the cache.")
+         .def_readonly("cached_tokens", &HegemonikonPrefixCacheStats::cached_tokens, "Number of tokens currently held by the cache.")
+         .def_readonly("entries", &HegemonikonPrefixCacheStats::entries, "Number of prefixes currently cached.")
+         .def_readonly("evictions", &HegemonikonPrefixCacheStats::evictions, "Number of prefixes evicted from the cache.")
+         .def("__str__", [](const HegemonikonPrefixCacheStats &s)
+              { return s.to_string(); });
+
+     py::class_<HegemonikonSpeculativeStats>(m, "HegemonikonSpeculativeStats", "Counters describing speculative decoding with a draft model.")
+         .def(py::init<>())
+         .def_readonly("verify_steps", &HegemonikonSpeculativeStats::verify_steps, "Number of speculative verification steps.")
+         .def_readonly("drafted_tokens", &HegemonikonSpeculativeStats::drafted_tokens, "Number of tokens proposed by the draft model.")
+         .def_readonly("accepted_tokens", &HegemonikonSpeculativeStats::accepted_tokens, "Number of drafted tokens accepted by the main model.")
+         .def_property_readonly("acceptance_rate", &HegemonikonSpeculativeStats::acceptance_rate, "Fraction of drafted tokens accepted.")
+         .def_property_readonly("avg_accepted_length", &HegemonikonSpeculativeStats::avg_accepted_length, "Average number of accepted drafts per step.")
+         .def("__str__", [](const HegemonikonSpeculativeStats &s)
+              { return s.to_string(); });
+
+     py::class_<HegemonikonModelRegistryStats>(m, "HegemonikonModelRegistryStats", "Residency and memory accounting of the Llama model registry.")
+         .def(py::init<>())
+         .def_readonly("resident_models", &HegemonikonModelRegistryStats::resident_models, "Number of models currently loaded.")
+         .def_readonly("pinned_models", &HegemonikonModelRegistryStats::pinned_models, "Number of resident models that are pinned.")
+         .def_readonly("models_in_use", &HegemonikonModelRegistryStats::models_in_use, "Number of resident models held by the service or in-flight requests.")
+         .def_readonly("ram_bytes", &HegemonikonModelRegistryStats::ram_bytes, "Host memory held by resident models.")
+         .def_readonly("vram_bytes", &HegemonikonModelRegistryStats::vram_bytes, "Device memory held by resident models.")
+         .def_readonly("ram_budget_bytes", &HegemonikonModelRegistryStats::ram_budget_bytes, "Host memory budget (0 for unlimited).")
+         .def_readonly("vram_budget_bytes", &HegemonikonModelRegistryStats::vram_budget_bytes, "Device memory budget (0 for unlimited).")
+         .def_readonly("hits", &HegemonikonModelRegistryStats::hits, "Number of requests served by a resident model.")
+         .def_readonly("misses", &HegemonikonModelRegistryStats::misses, "Number of requests that required a load.")
+         .def_readonly("evictions", &HegemonikonModelRegistryStats::evictions, "Number of models unloaded by the registry.")
+         .def_readonly("load_failures", &HegemonikonModelRegistryStats::load_failures, "Number of loads that failed or did not fit in the budget.")
+         .def("__str__", [](const HegemonikonModelRegistryStats &s)
+              { return s.to_string(); });
+
+     py::enum_<ComputeEngine>(m, "ComputeEngine", "Inference engines sharing the CPU through the compute pool.")
+         .value("LLAMA", ComputeEngine::Llama)
+         .value("WHISPER", ComputeEngine::Whisper);
+
+     py::class_<HegemonikonCpuCore>(m, "HegemonikonCpuCore", "A physical CPU core.")
+         .def_readonly("cpu", &HegemonikonCpuCore::cpu, "Index of the first logical CPU of the core.")
+         .def_readonly("core_id", &HegemonikonCpuCore::core_id, "Core id within its package.")
+         .def_readonly("package", &HegemonikonCpuCore::package, "Physical package (socket).")
+         .def_readonly("numa_node", &HegemonikonCpuCore::numa_node, "NUMA node of the core.")
+         .def_readonly("efficiency", &HegemonikonCpuCore::efficiency, "Whether this is an efficiency (E) core.");
+
+     py::class_<HegemonikonCpuTopology>(m, "HegemonikonCpuTopology", "Physical cores available to the process.")
+         .def_readonly("cores", &HegemonikonCpuTopology::cores, "One entry per physical core.")
+         .def_readonly("n_logical_cpus", &HegemonikonCpuTopology::n_logical_cpus, "Number of logical CPUs.")
+         .def_readonly("n_numa_nodes", &HegemonikonCpuTopology::n_numa_nodes, "Number of NUMA nodes.")
+         .def("n_performance_cores", &HegemonikonCpuTopology::n_performance_cores, "Number of performance cores.")
+         .def("n_efficiency_cores", &HegemonikonCpuTopology::n_efficiency_cores, "Number of efficiency cores.")
+         .def("__str__", [](const HegemonikonCpuTopology &t)
+              { return t.to_string(); });
+
+     py::class_<HegemonikonComputePoolStats>(m, "HegemonikonComputePoolStats", "Quotas and counters of the process-wide compute pool.")
+         .def_readonly("n_threads", &HegemonikonComputePoolStats::n_threads, "Number of cores the pool schedules on.")
+         .def_readonly("llama_quota", &HegemonikonComputePoolStats::llama_quota, "Threads guaranteed to llama while whisper runs.")
+         .def_readonly("whisper_quota", &HegemonikonComputePoolStats::whisper_quota, "Threads guaranteed to whisper while llama runs.")
+         .def_readonly("llama_threads", &HegemonikonComputePoolStats::llama_threads, "Threads of the current llama decode, 0 if idle.")
+         .def_readonly("whisper_threads", &HegemonikonComputePoolStats::whisper_threads, "Threads of the running transcriptions, 0 if idle.")
+         .def_readonly("llama_leases", &HegemonikonComputePoolStats::llama_leases, "Number of llama decode steps scheduled.")
+         .def_readonly("whisper_leases", &HegemonikonComputePoolStats::whisper_leases, "Number of transcriptions scheduled.")
+         .def_readonly("borrowed_leases", &HegemonikonComputePoolStats::borrowed_leases, "Number of leases that used cores lent by the idle engine.")
+         .def_readonly("pinned", &HegemonikonComputePoolStats::pinned, "Whether threads are pinned to cores.")
+         .def_readonly("numa_node", &HegemonikonComputePoolStats::numa_node, "NUMA node the pool runs on, -1 for all.")
+         .def("__str__", [](const HegemonikonComputePoolStats &s)
+              { return s.to_string(); });
+
+     py::class_<HegemonikonLatencySnapshot>(m, "HegemonikonLatencySnapshot", "Latency histogram of one inference phase.")
+         .def_readonly("name", &HegemonikonLatencySnapshot::name, "Phase name, e.g. 'inter_token'.")
+         .def_readonly("count", &HegemonikonLatencySnapshot::count, "Number of samples.")
+         .def_readonly("sum_ms", &HegemonikonLatencySnapshot::sum_ms, "Sum of the samples in milliseconds.")
+         .def_readonly("max_ms", &HegemonikonLatencySnapshot::max_ms, "Largest sample in milliseconds.")
+         .def_readonly("p50_ms", &HegemonikonLatencySnapshot::p50_ms, "Median in milliseconds.")
+         .def_readonly("p90_ms", &HegemonikonLatencySnapshot::p90_ms, "90th percentile in milliseconds.")
+         .def_readonly("p99_ms", &HegemonikonLatencySnapshot::p99_ms, "99th percentile in milliseconds.")
+         .def_readonly("p999_ms", &HegemonikonLatencySnapshot::p999_ms, "99.9th percentile in milliseconds.")
+         .def_readonly("buckets", &HegemonikonLatencySnapshot::buckets, "Cumulative (upper bound in ms, count) pairs.")
+         .def("mean_ms", &HegemonikonLatencySnapshot::mean_ms, "Mean of the samples in milliseconds.")
+         .def("__str__", [](const HegemonikonLatencySnapshot &s)
+              { return s.to_string(); });
+
+     py::class_<HegemonikonMetricsSnapshot>(m, "HegemonikonMetricsSnapshot", "Latency histograms and counters of a service.")
+         .def_readonly("latencies", &HegemonikonMetricsSnapshot::latencies, "One histogram per inference phase.")
+         .def_readonly("requests", &HegemonikonMetricsSnapshot::requests, "Generation requests completed.")
+         .def_readonly("failed_requests", &HegemonikonMetricsSnapshot::failed_requests, "Generation requests that ended with an error.")
+         .def_readonly("prompt_tokens", &HegemonikonMetricsSnapshot::prompt_tokens, "Prompt tokens of the generation requests.")
+         .def_readonly("generated_tokens", &HegemonikonMetricsSnapshot::generated_tokens, "Tokens generated.")
+         .def_readonly("transcriptions", &HegemonikonMetricsSnapshot::transcriptions, "Whisper runs completed.")
+         .def_readonly("failed_transcriptions", &HegemonikonMetricsSnapshot::failed_transcriptions, "Whisper runs that failed.")
+         .def_readonly("audio_seconds", &HegemonikonMetricsSnapshot::audio_seconds, "Seconds of audio transcribed.")
+         .def_readonly("lookup_drafted_tokens", &HegemonikonMetricsSnapshot::lookup_drafted_tokens, "Tokens proposed by prompt-lookup decoding.")
+         .def_readonly("lookup_accepted_tokens", &HegemonikonMetricsSnapshot::lookup_accepted_tokens, "Prompt-lookup tokens accepted by the model.")
+         .def_property_readonly("lookup_acceptance_rate", &HegemonikonMetricsSnapshot::lookup_acceptance_rate, "Fraction of the prompt-lookup drafts accepted.")
+         .def_readonly("uptime_seconds", &HegemonikonMetricsSnapshot::uptime_seconds, "Seconds since the metrics were created or reset.")
+         .def("find", &HegemonikonMetricsSnapshot::find, "Histogram of a phase by name, None if unknown.",
+              py::arg("name"), py::return_value_policy::reference_internal)
+         .def("__str__", [](const HegemonikonMetricsSnapshot &s)
+              { return s.to_string(); });
+
+     py::class_<HegemonikonTraceStats>(m, "HegemonikonTraceStats", "Counters of the trace recorder.")
+         .def_readonly("enabled", &HegemonikonTraceStats::enabled, "Whether spans are being recorded.")
+         .def_readonly("n_threads", &HegemonikonTraceStats::n_threads, "Threads that recorded spans.")
+         .def_readonly("events_recorded", &HegemonikonTraceStats::events_recorded, "Spans recorded by all threads.")
+         .def_readonly("events_overwritten", &HegemonikonTraceStats::events_overwritten, "Spans lost to full rings.")
+         .def_readonly("events_per_thread", &HegemonikonTraceStats::events_per_thread, "Capacity of the ring of each thread.")
+         .def("__str__", [](const HegemonikonTraceStats &s)
+              { return s.to_string(); });
+
+     py::enum_<HegemonikonLogLevel>(m, "HegemonikonLogLevel", "Verbosity of the native console messages.")
+         .value("OFF", HegemonikonLogLevel::Off)
+         .value("ERROR", HegemonikonLogLevel::Error)
+         .value("WARNING", HegemonikonLogLevel::Warning)
+         .value("INFO", HegemonikonLogLevel::Info)
+         .value("DEBUG", HegemonikonLogLevel::Debug);
+
+     py::class_<HegemonikonGpuDevice>(m, "HegemonikonGpuDevice", "A device llama.cpp can offload layers to.")
+         .def(py::init<>())
+         .def_readwrite("name", &HegemonikonGpuDevice::name, "Backend device name, e.g. 'CUDA0'.")
+         .def_readwrite("description", &HegemonikonGpuDevice::description, "Human-readable device description.")
+         .def_readwrite("free_bytes", &HegemonikonGpuDevice::free_bytes, "Free device memory in bytes when queried.")
+         .def_readwrite("total_bytes", &HegemonikonGpuDevice::total_bytes, "Total device memory in bytes.")
+         .def("__str__", [](const HegemonikonGpuDevice &d)
+              { return d.to_string(); });
+
+     py::class_<HegemonikonGgufModelInfo>(m, "HegemonikonGgufModelInfo", "Shape and tensor sizes of a GGUF model, read from its metadata.")
+         .def(py::init<>())
+         .def_readwrite("architecture", &HegemonikonGgufModelInfo::architecture, "Model architecture name.")
+         .def_readwrite("n_layer", &HegemonikonGgufModelInfo::n_layer, "Number of repeating layers.")
+         .def_readwrite("n_embd", &HegemonikonGgufModelInfo::n_embd, "Embedding size.")
+         .def_readwrite("n_head", &HegemonikonGgufModelInfo::n_head, "Number of attention heads.")
+         .def_readwrite("n_head_kv", &HegemonikonGgufModelInfo::n_head_kv, "Number of key/value heads.")
+         .def_readwrite("n_embd_head_k", &HegemonikonGgufModelInfo::n_embd_head_k, "Key size per head.")
+         .def_readwrite("n_embd_head_v", &HegemonikonGgufModelInfo::n_embd_head_v, "Value size per head.")
+         .def_readwrite("n_vocab", &HegemonikonGgufModelInfo::n_vocab, "Vocabulary size.")
+         .def_readwrite("layer_bytes", &HegemonikonGgufModelInfo::layer_bytes, "Size of the tensors of each layer in bytes.")
+         .def_readwrite("input_bytes", &HegemonikonGgufModelInfo::input_bytes, "Size of the token embeddings in bytes.")
+         .def_readwrite("output_bytes", &HegemonikonGgufModelInfo::output_bytes, "Size of the output tensors in bytes.")
+         .def("weights_bytes", &HegemonikonGgufModelInfo::weights_bytes, "Total size of the weights in bytes.")
+         .def("__str__", [](const HegemonikonGgufModelInfo &i)
+              { return i.to_string(); });
+
+     py::class_<HegemonikonOffloadPlan>(m, "HegemonikonOffloadPlan", "GPU offload chosen by the planner, with its reasoning.")
+         .def(py::init<>())
+         .def_readonly("n_gpu_layers", &HegemonikonOffloadPlan::n_gpu_layers, "Number of layers to offload (n_layer + 1 offloads the output too).")
+         .def_readonly("n_layer", &HegemonikonOffloadPlan::n_layer, "Number of repeating layers of the model.")
+         .def_readonly("main_gpu", &HegemonikonOffloadPlan::main_gpu, "Index of the main device.")
+         .def_readonly("tensor_split", &HegemonikonOffloadPlan::tensor_split, "Whether layers are split across devices.")
+         .def_readonly("full_offload", &HegemonikonOffloadPlan::full_offload, "Whether the whole model runs on the devices.")
+         .def_readonly("weights_bytes", &HegemonikonOffloadPlan::weights_bytes, "Total size of the weights in bytes.")
+         .def_readonly("kv_bytes", &HegemonikonOffloadPlan::kv_bytes, "Size of the KV cache for the requested context in bytes.")
+         .def_readonly("compute_bytes", &HegemonikonOffloadPlan::compute_bytes, "Estimated compute buffer size in bytes.")
+         .def_readonly("host_bytes", &HegemonikonOffloadPlan::host_bytes, "Memory expected in host RAM in bytes.")
+         .def_readonly("device_bytes", &HegemonikonOffloadPlan::device_bytes, "Memory expected on each device in bytes.")
+         .def_readonly("reasons", &HegemonikonOffloadPlan::reasons, "Why this plan was chosen, one line per step.")
+         .def("apply", &HegemonikonOffloadPlan::apply, "Return a copy of the model parameters with the plan applied.",
+              py::arg("llama_model_params"))
+         .def("__str__", [](const HegemonikonOffloadPlan &p)
+              { return p.to_string(); });
+
+     py::class_<LlamaOffloadPlanner>(m, "LlamaOffloadPlanner", "Chooses n_gpu_layers and the layer split from model metadata and free device memory.")
+         .def_static("read_model_info", [](const std::string &model_path)
+                     {
+                          HegemonikonGgufModelInfo info;
+                          if (!LlamaOffloadPlanner::read_model_info(model_path, info))
+                          {
+                               throw std::runtime_error("Unable to read GGUF metadata from " + model_path);
+                          }
+                          return info; }, "Read the shape and tensor sizes of a GGUF model.", py::arg("model_path"))
+         .def_static("query_devices", &LlamaOffloadPlanner::query_devices, "List the offload devices with their free memory.")
+         .def_static("plan", py::overload_cast<const HegemonikonLlamaModelParams &, uint64_t>(&LlamaOffloadPlanner::plan),
+                     "Plan the offload of a model on the devices of this machine.",
+                     py::arg("llama_model_params"), py::arg("headroom_bytes") = LlamaOffloadPlanner::DEFAULT_HEADROOM_BYTES,
+                     py::call_guard<py::gil_scoped_release>())
+         .def_static("plan_for", py::overload_cast<const HegemonikonGgufModelInfo &, const HegemonikonLlamaModelParams &, const std::vector<HegemonikonGpuDevice> &, uint64_t>(&LlamaOffloadPlanner::plan),
+                     "Plan the offload of a model described by its metadata on the given devices.",
+                     py::arg("model_info"), py::arg("llama_model_params"), py::arg("devices"),
+                     py::arg("headroom_bytes") = LlamaOffloadPlanner::DEFAULT_HEADROOM_BYTES);
+
+     py::class_<HegemonikonGenerationResult>(m, "HegemonikonGenerationResult", "Outcome of a single generation request.")
+         .def(py::init<>())
+         .def_readonly("text", &HegemonikonGenerationResult::text, "Generated text, or an error message if success is False.")
+         .def_readonly("success", &HegemonikonGenerationResult::success, "Whether the generation completed without error.")
+         .def_readonly("tokens_generated", &HegemonikonGenerationResult::tokens_generated, "Number of generated tokens.")
+         .def_readonly("prompt_tokens", &HegemonikonGenerationResult::prompt_tokens, "Number of prompt tokens.")
+         .def_readonly("reused_tokens", &HegemonikonGenerationResult::reused_tokens, "Number of prompt tokens served from the KV cache.")
+         .def_readonly("ttft_ms", &HegemonikonGenerationResult::ttft_ms, "Time to first token in milliseconds.")
+         .def_readonly("decode_duration_ms", &HegemonikonGenerationResult::decode_duration_ms, "Generation time in milliseconds, tokenization excluded.")
+         .def_readonly("draft_tokens", &HegemonikonGenerationResult::draft_tokens, "Number of tokens proposed by the draft model.")
+         .def_readonly("accepted_draft_tokens", &HegemonikonGenerationResult::accepted_draft_tokens, "Number of drafted tokens accepted by the main model.")
+         .def_readonly("lookup_draft_tokens", &HegemonikonGenerationResult::lookup_draft_tokens, "Number of tokens proposed by prompt lookup.")
+         .def_readonly("accepted_lookup_tokens", &HegemonikonGenerationResult::accepted_lookup_tokens, "Number of prompt-lookup tokens accepted by the model.")
+         .def_readonly("discarded_tokens", &HegemonikonGenerationResult::discarded_tokens, "Number of prompt or context tokens discarded by context shifting.")
+         .def_readonly("finish_reason", &HegemonikonGenerationResult::finish_reason, "Why the generation ended: 'stop', 'length', 'cancelled', 'deadline' or 'error'.")
+         .def("__str__", [](const HegemonikonGenerationResult &r)
+              { return r.to_string(); });
+
+     py::class_<HegemonikonPriorityClassStats>(m, "HegemonikonPriorityClassStats", "Queue counters of one scheduling class.")
+         .def(py::init<>())
+         .def_readonly("queued_requests", &HegemonikonPriorityClassStats::queued_requests, "Number of requests of the class waiting in the queue.")
+         .def_readonly("requests_admitted", &HegemonikonPriorityClassStats::requests_admitted, "Number of requests of the class admitted.")
+         .def_readonly("preemptions", &HegemonikonPriorityClassStats::preemptions, "Number of times a sequence of the class was parked.")
+         .def_readonly("queue_wait_ms_avg", &HegemonikonPriorityClassStats::queue_wait_ms_avg, "Average queue wait over the recent admissions in milliseconds.")
+         .def_readonly("queue_wait_ms_p95", &HegemonikonPriorityClassStats::queue_wait_ms_p95, "95th percentile queue wait over the recent admissions in milliseconds.")
+         .def_readonly("queue_wait_ms_max", &HegemonikonPriorityClassStats::queue_wait_ms_max, "Longest queue wait in milliseconds.")
+         .def("__str__", [](const HegemonikonPriorityClassStats &s)
+              { return s.to_string(); });
+
+     py::class_<HegemonikonSchedulerStats>(m, "HegemonikonSchedulerStats", "Throughput counters of the batching scheduler.")
+         .def(py::init<>())
+         .def_readonly("requests_submitted", &HegemonikonSchedulerStats::requests_submitted, "Number of requests submitted.")
+         .def_readonly("requests_completed", &HegemonikonSchedulerStats::requests_completed, "Number of requests completed.")
+         .def_readonly("decode_steps", &HegemonikonSchedulerStats::decode_steps, "Number of batched llama_decode calls.")
+         .def_readonly("tokens_decoded", &HegemonikonSchedulerStats::tokens_decoded, "Number of tokens decoded, prompt tokens included.")
+         .def_readonly("tokens_generated", &HegemonikonSchedulerStats::tokens_generated, "Number of tokens generated by completed requests.")
+         .def_readonly("active_sequences", &HegemonikonSchedulerStats::active_sequences, "Number of sequences currently decoding.")
+         .def_readonly("queued_requests", &HegemonikonSchedulerStats::queued_requests, "Number of requests waiting for a sequence.")
+         .def_readonly("busy_time_ms", &HegemonikonSchedulerStats::busy_time_ms, "Total time spent decoding in milliseconds.")
+         .def_readonly("parked_sequences", &HegemonikonSchedulerStats::parked_sequences, "Number of preempted sequences waiting to resume.")
+         .def_readonly("preemptions", &HegemonikonSchedulerStats::preemptions, "Number of sequences parked for higher-priority requests.")
+         .def_readonly("resumptions", &HegemonikonSchedulerStats::resumptions, "Number of parked sequences resumed.")
+         .def_readonly("interactive", &HegemonikonSchedulerStats::interactive, "Queue counters of interactive requests.")
+         .def_readonly("batch", &HegemonikonSchedulerStats::batch, "Queue counters of batch requests.")
+         .def_readonly("background", &HegemonikonSchedulerStats::background, "Queue counters of background requests.")
+         .def("tokens_per_second", &HegemonikonSchedulerStats::tokens_per_second, "Aggregate generation throughput.")
+         .def("__str__", [](const HegemonikonSchedulerStats &s)
+              { return s.to_string(); });
+
+     py::class_<HegemonikonContextPoolStats>(m, "HegemonikonContextPoolStats", "Occupancy counters of the llama context pool.")
+         .def(py::init<>())
+         .def_readonly("n_contexts", &HegemonikonContextPoolStats::n_contexts, "Number of contexts sharing the model, the model's own included.")
+         .def_readonly("n_ctx", &HegemonikonContextPoolStats::n_ctx, "Context size of the additional contexts.")
+         .def_readonly("contexts_leased", &HegemonikonContextPoolStats::contexts_leased, "Number of contexts currently running a request.")
+         .def_readonly("leases", &HegemonikonContextPoolStats::leases, "Number of requests served by the pool.")
+         .def_readonly("session_hits", &HegemonikonContextPoolStats::session_hits, "Number of requests routed to the context holding their session.")
+         .def_readonly("waits", &HegemonikonContextPoolStats::waits, "Number of requests that waited for a context.")
+         .def_readonly("wait_time_ms", &HegemonikonContextPoolStats::wait_time_ms, "Total time spent waiting for a context in milliseconds.")
+         .def("__str__", [](const HegemonikonContextPoolStats &s)
+              { return s.to_string(); });
+
+     py::class_<LlamaRequestHandle, std::shared_ptr<LlamaRequestHandle>>(m, "LlamaRequestHandle", "Control block to cancel or bound a generation request from another thread.")
+         .def(py::init<>())
+         .def("cancel", &LlamaRequestHandle::cancel, "Stop the request within one decode step.")
+         .def("is_cancelled", &LlamaRequestHandle::is_cancelled, "Whether cancel() has been called.")
+         .def("set_timeout_ms", &LlamaRequestHandle::set_timeout_ms, "Set a deadline relative to now (0 removes it).",
+              py::arg("timeout_ms"))
+         .def("set_token_limit", &LlamaRequestHandle::set_token_limit, "Cap the number of generated tokens (0 removes the cap).",
+              py::arg("max_tokens"))
+         .def("has_deadline", &LlamaRequestHandle::has_deadline, "Whether a deadline is set.");
+
+     py::class_<LlamaLoadStatus, std::shared_ptr<LlamaLoadStatus>>(m, "LlamaLoadStatus", "Progress and outcome of a background model load.")
+         .def("cancel", &LlamaLoadStatus::cancel, "Abort the load at the next progress report.")
+         .def("is_cancelled", &LlamaLoadStatus::is_cancelled, "Whether cancel() has been called.")
+         .def("progress", &LlamaLoadStatus::progress, "Fraction of the model file loaded, from 0 to 1.")
+         .def("state", [](const LlamaLoadStatus &status)
+              { return std::string(LlamaLoadStatus::state_name(status.state())); }, "One of 'pending', 'loading', 'warming_up', 'ready', 'failed', 'cancelled'.")
+         .def("is_done", &LlamaLoadStatus::is_done, "Whether the load has ended.")
+         .def("succeeded", &LlamaLoadStatus::succeeded, "Whether the model is loaded and active.")
+         .def("error", &LlamaLoadStatus::error, "Error message of a failed load.")
+         .def("wait", &LlamaLoadStatus::wait, "Block until the load ends, releasing the GIL. Returns False on timeout.",
+              py::arg("timeout_ms") = -1.0, py::call_guard<py::gil_scoped_release>());
+
+     py::class_<LlamaTokenStream>(m, "LlamaTokenStream", "Iterator over the pieces of a streaming generation.")
+         .def("__iter__", [](LlamaTokenStream &stream) -> LlamaTokenStream &
+              { return stream; })
+         .def("__next__", [](LlamaTokenStream &stream)
+              {
+                   std::string piece;
+                   bool has_piece;
+                   {
+                        py::gil_scoped_release release;
+                        has_piece = stream.next(piece);
+                   }
+                   if (!has_piece)
+                   {
+                        throw py::stop_iteration();
+                   }
+                   return py::bytes(piece); }, "Return the next piece as UTF-8 bytes, releasing the GIL while waiting.")
+         .def("cancel", &LlamaTokenStream::cancel, "Stop the generation after the current token.")
+         .def("is_finished", &LlamaTokenStream::is_finished, "Whether the generation has ended.")
+         .def("succeeded", &LlamaTokenStream::succeeded, "Whether the generation ended without error.")
+         .def("error", &LlamaTokenStream::error, "Error message of a failed generation, empty otherwise.");
+
+     py::class_<HegemonikonWhisperToken>(m, "HegemonikonWhisperToken", "A text token of a segment, with times in milliseconds.")
+         .def(py::init<>())
+         .def_readonly("id", &HegemonikonWhisperToken::id, "Token id.")
+         .def_readonly("text", &HegemonikonWhisperToken::text, "Text of the token.")
+         .def_readonly("t0_ms", &HegemonikonWhisperToken::t0_ms, "Start of the token, -1 without token timestamps.")
+         .def_readonly("t1_ms", &HegemonikonWhisperToken::t1_ms, "End of the token, -1 without token timestamps.")
+         .def_readonly("p", &HegemonikonWhisperToken::p, "Probability of the token.")
+         .def("__str__", [](const HegemonikonWhisperToken &t)
+              { return t.to_string(); });
+
+     py::class_<HegemonikonWhisperSegment>(m, "HegemonikonWhisperSegment", "A transcribed segment, with times in milliseconds.")
+         .def(py::init<>())
+         .def_readonly("text", &HegemonikonWhisperSegment::text, "Text of the segment.")
+         .def_readonly("t0_ms", &HegemonikonWhisperSegment::t0_ms, "Start of the segment.")
+         .def_readonly("t1_ms", &HegemonikonWhisperSegment::t1_ms, "End of the segment.")
+         .def_readonly("speaker_turn_next", &HegemonikonWhisperSegment::speaker_turn_next, "Whether the next segment is another speaker (tinydiarize).")
+         .def_readonly("partial", &HegemonikonWhisperSegment::partial, "Whether a later result of the stream replaces this one.")
+         .def_readonly("no_speech_prob", &HegemonikonWhisperSegment::no_speech_prob, "Probability that the segment holds no speech.")
+         .def_readonly("tokens", &HegemonikonWhisperSegment::tokens, "Text tokens of the segment, filled with token_timestamps.")
+         .def("__str__", [](const HegemonikonWhisperSegment &s)
+              { return s.to_string(); });
+
+     py::class_<HegemonikonTranscription>(m, "HegemonikonTranscription", "Segments of a whole transcription, or its error.")
+         .def(py::init<>())
+         .def_readonly("segments", &HegemonikonTranscription::segments, "The segments, in order.")
+         .def_readonly("error", &HegemonikonTranscription::error, "The error message, empty on success.")
+         .def_readonly("audio_ms", &HegemonikonTranscription::audio_ms, "Duration of the transcribed audio in milliseconds.")
+         .def("ok", &HegemonikonTranscription::ok, "Whether the audio was transcribed.")
+         .def("text", &HegemonikonTranscription::text, "The text of the segments, without timestamps.")
+         .def("segment_times", [](const HegemonikonTranscription &t)
+              {
+                   std::vector<int64_t> times;
+                   times.reserve(2 * t.segments.size());
+                   for (const HegemonikonWhisperSegment &segment : t.segments)
+                   {
+                        times.push_back(segment.t0_ms);
+                        times.push_back(segment.t1_ms);
+                   }
+                   return matrix_to_array(std::move(times), t.segments.size(), 2); },
+              "Start and end of every segment in milliseconds, as an (n_segments, 2) int64 array.")
+         .def("__str__", [](const HegemonikonTranscription &t)
+              { return t.to_string(); });
+
+     py::class_<HegemonikonWhisperStreamStats>(m, "HegemonikonWhisperStreamStats", "Counters of a streaming transcription session.")
+         .def(py::init<>())
+         .def_readonly("samples_received", &HegemonikonWhisperStreamStats::samples_received, "Number of samples pushed or captured.")
+         .def_readonly("samples_dropped", &HegemonikonWhisperStreamStats::samples_dropped, "Number of samples dropped because transcription fell behind.")
+         .def_readonly("windows_transcribed", &HegemonikonWhisperStreamStats::windows_transcribed, "Number of windows run through whisper.")
+         .def_readonly("partial_segments", &HegemonikonWhisperStreamStats::partial_segments, "Number of partial segments reported.")
+         .def_readonly("final_segments", &HegemonikonWhisperStreamStats::final_segments, "Number of final segments reported.")
+         .def_readonly("transcribe_ms_total", &HegemonikonWhisperStreamStats::transcribe_ms_total, "Total inference time in milliseconds.")
+         .def_readonly("transcribe_ms_last", &HegemonikonWhisperStreamStats::transcribe_ms_last, "Inference time of the last window in milliseconds.")
+         .def("real_time_factor", &HegemonikonWhisperStreamStats::real_time_factor, "Inference time over audio duration.")
+         .def("__str__", [](const HegemonikonWhisperStreamStats &s)
+              { return s.to_string(); });
+
+     py::class_<HegemonikonTranscriptionResult>(m, "HegemonikonTranscriptionResult", "Outcome of one file of a batch transcription.")
+         .def(py::init<>())
+         .def_readonly("index", &HegemonikonTranscriptionResult::index, "Position of the file in the batch.")
+         .def_readonly("path", &HegemonikonTranscriptionResult::path, "Path of the audio file.")
+         .def_readonly("text", &HegemonikonTranscriptionResult::text, "The text of the segments, empty on error.")
+         .def_readonly("segments", &HegemonikonTranscriptionResult::segments, "The transcribed segments.")
+         .def_readonly("error", &HegemonikonTranscriptionResult::error, "The error message, empty on success.")
+         .def_readonly("audio_seconds", &HegemonikonTranscriptionResult::audio_seconds, "Duration of the decoded audio in seconds.")
+         .def_readonly("transcribe_ms", &HegemonikonTranscriptionResult::transcribe_ms, "Time spent transcribing the file in milliseconds.")
+         .def("ok", &HegemonikonTranscriptionResult::ok, "Whether the file was transcribed.")
+         .def("__str__", [](const HegemonikonTranscriptionResult &r)
+              { return r.to_string(); });
+
+     py::class_<HegemonikonAudioPromptResult>(m, "HegemonikonAudioPromptResult", "Outcome of a transcription followed by a generation over its text.")
+         .def_readonly("transcription", &HegemonikonAudioPromptResult::transcription, "The transcription of the audio file.")
+         .def_readonly("generation", &HegemonikonAudioPromptResult::generation, "The generation over the transcript.")
+         .def_readonly("prefilled_tokens", &HegemonikonAudioPromptResult::prefilled_tokens, "Prompt tokens decoded while the audio was transcribed.")
+         .def_readonly("transcribe_ms", &HegemonikonAudioPromptResult::transcribe_ms, "Time until the transcription ended in milliseconds.")
+         .def_readonly("total_ms", &HegemonikonAudioPromptResult::total_ms, "Time of the whole call in milliseconds.")
+         .def("ok", &HegemonikonAudioPromptResult::ok, "Whether both the transcription and the generation succeeded.")
+         .def("__str__", [](const HegemonikonAudioPromptResult &r)
+              { return r.to_string(); });
+
+     py::class_<HegemonikonTranscriptionCacheStats>(m, "HegemonikonTranscriptionCacheStats", "Counters describing the transcription cache.")
+         .def(py::init<>())
+         .def_readonly("hits", &HegemonikonTranscriptionCacheStats::hits, "Number of files served from the cache.")
+         .def_readonly("misses", &HegemonikonTranscriptionCacheStats::misses, "Number of files not found in the cache.")
+         .def_readonly("insertions", &HegemonikonTranscriptionCacheStats::insertions, "Number of transcriptions stored in the cache.")
+         .def_readonly("evictions", &HegemonikonTranscriptionCacheStats::evictions, "Number of entries evicted to stay under max_bytes.")
+         .def_readonly("entries", &HegemonikonTranscriptionCacheStats::entries, "Number of transcriptions currently cached.")
+         .def_readonly("bytes", &HegemonikonTranscriptionCacheStats::bytes, "Size of the cached entries on disk.")
+         .def_readonly("max_bytes", &HegemonikonTranscriptionCacheStats::max_bytes, "Maximum size of the cached entries on disk.")
+         .def("__str__", [](const HegemonikonTranscriptionCacheStats &s)
+              { return s.to_string(); });
+
+     py::class_<WhisperStreamSession, std::unique_ptr<WhisperStreamSession, gil_releasing_delete<WhisperStreamSession>>>(
+         m, "WhisperStreamSession", "Live transcription of pushed or captured audio on overlapping windows.")
+         .def("push", [](WhisperStreamSession &session, const float_array &samples)
+              {
+                   const float *data = nullptr;
+                   size_t n_samples = 0;
+                   borrow_array(samples, data, n_samples);
+                   session.push(data, n_samples); },
+              "Append 16 kHz mono float32 samples to the stream.", py::arg("samples"))
+         .def("start_capture", &WhisperStreamSession::start_capture, "Capture from an input device (-1 for the capture_id of the parameters)",
+              py::arg("capture_id") = -1)
+         .def("stop_capture", &WhisperStreamSession::stop_capture, "Stop capturing; captured audio is still transcribed",
+              py::call_guard<py::gil_scoped_release>())
+         .def("stop", &WhisperStreamSession::stop, "Transcribe the remaining audio as final segments and end the session",
+              py::call_guard<py::gil_scoped_release>())
+         .def("is_running", &WhisperStreamSession::is_running, "Whether the session still transcribes")
+         .def("error", &WhisperStreamSession::error, "Error that ended the session, empty if none")
+         .def("get_stats", &WhisperStreamSession::get_stats, "Get the session counters");
+
      py::class_<CoreAIService>(m, "CoreAIService", "Manages AI model interactions, including LLM, STT, etc.")
          .def(py::init<>(), "Default constructor")
          .def("initialize_llama_model", &CoreAIService::initialize_llama_model, "Initialize and load the Llama model",
+              py::arg("llama_model_params"),
+              py::call_guard<py::gil_scoped_release>())
+         .def("initialize_llama_model_async", &CoreAIService::initialize_llama_model_async,
+              "Load and activate the Llama model on a background thread; returns a LlamaLoadStatus",
               py::arg("llama_model_params"))
-         .def("unload_llama_model", &CoreAIService::unload_llama_model, "Unload the currently loaded Llama model")
+         .def("unload_llama_model", &CoreAIService::unload_llama_model, "Unload the currently loaded Llama model",
+              py::call_guard<py::gil_scoped_release>())
          .def("is_llama_model_loaded", &CoreAIService::is_llama_model_loaded)
-         .def("process_prompt", &CoreAIService::process_prompt, "Process a text prompt using the Llama model",
-              py::arg("prompt_text"), py::arg("llama_generation_params"))
-         .def("stream_prompt", &CoreAIService::stream_prompt, "Stream generation of text from a prompt",
-              py::arg("prompt_text"), py::arg("llama_generation_params"), py::arg("callback"))
+         .def("process_prompt", py::overload_cast<const std::string &, const HegemonikonGenerationParams &>(&CoreAIService::process_prompt),
+              "Process a text prompt using the Llama model",
+              py::arg("prompt_text"), py::arg("llama_generation_params"),
+              py::call_guard<py::gil_scoped_release>())
+         .def("process_prompt", py::overload_cast<const std::string &, const HegemonikonGenerationParams &, std::shared_ptr<LlamaRequestHandle>>(&CoreAIService::process_prompt),
+              "Process a text prompt that can be cancelled or time-limited through a request handle",
+              py::arg("prompt_text"), py::arg("llama_generation_params"), py::arg("handle"),
+              py::call_guard<py::gil_scoped_release>())
+         .def("stream_prompt", py::overload_cast<const std::string &, const HegemonikonGenerationParams &, llama_token_callback>(&CoreAIService::stream_prompt),
+              "Stream generation of text from a prompt",
+              py::arg("prompt_text"), py::arg("llama_generation_params"), py::arg("callback"),
+              py::call_guard<py::gil_scoped_release>())
+         .def("stream_prompt", py::overload_cast<const std::string &, const HegemonikonGenerationParams &, llama_token_callback, std::shared_ptr<LlamaRequestHandle>>(&CoreAIService::stream_prompt),
+              "Stream generation of text from a prompt that can be interrupted through a request handle",
+              py::arg("prompt_text"), py::arg("llama_generation_params"), py::arg("callback"), py::arg("handle"),
+              py::call_guard<py::gil_scoped_release>())
+         .def("open_prompt_stream", &CoreAIService::open_prompt_stream, "Start a streaming generation and return an iterator over its pieces",
+              py::arg("prompt_text"), py::arg("llama_generation_params"),
+              py::keep_alive<0, 1>())
+         .def("process_prompt_batched", &CoreAIService::process_prompt_batched, "Process a prompt on the continuous-batching scheduler; safe to call from several threads",
+              py::arg("prompt_text"), py::arg("llama_generation_params"), py::arg("handle") = nullptr,
+              py::call_guard<py::gil_scoped_release>())
+         .def("get_llama_scheduler_stats", &CoreAIService::get_llama_scheduler_stats, "Get the batching scheduler counters")
+         .def("configure_llama_context_pool", &CoreAIService::configure_llama_context_pool, "Run direct requests on several contexts sharing the model weights; 1 disables the pool",
+              py::arg("n_contexts"), py::arg("n_ctx") = 0,
+              py::call_guard<py::gil_scoped_release>())
+         .def("get_llama_context_pool_stats", &CoreAIService::get_llama_context_pool_stats, "Get the context pool counters")
+         .def("reset_llama_session", &CoreAIService::reset_llama_session, "Drop the KV cache kept for a chat session",
+              py::arg("session_id"))
+         .def("clear_llama_sessions", &CoreAIService::clear_llama_sessions, "Drop the KV cache of every chat session")
+         .def("save_llama_session", &CoreAIService::save_llama_session, "Save the KV cache of an idle chat session to a snapshot file, encrypted when a key is given",
+              py::arg("session_id"), py::arg("directory"), py::arg("key") = nullptr,
+              py::call_guard<py::gil_scoped_release>())
+         .def("restore_llama_session", &CoreAIService::restore_llama_session, "Load the longest saved KV cache the prompt starts with; returns the number of restored tokens",
+              py::arg("prompt_text"), py::arg("llama_generation_params"), py::arg("directory"), py::arg("key") = nullptr,
+              py::call_guard<py::gil_scoped_release>())
+         .def("get_llama_prefix_cache_stats", &CoreAIService::get_llama_prefix_cache_stats, "Get the prompt prefix cache counters")
+         .def("clear_llama_prefix_cache", &CoreAIService::clear_llama_prefix_cache, "Drop every cached prompt prefix")
+         .def("get_llama_speculative_stats", &CoreAIService::get_llama_speculative_stats, "Get the speculative decoding counters")
+         .def("preload_llama_model", &CoreAIService::preload_llama_model, "Load a Llama model into the registry without making it active",
+              py::arg("llama_model_params"),
+              py::call_guard<py::gil_scoped_release>())
+         .def("is_llama_model_resident", &CoreAIService::is_llama_model_resident, "Whether a Llama model is resident in the registry",
+              py::arg("llama_model_params"))
+         .def("pin_llama_model", &CoreAIService::pin_llama_model, "Pin or unpin a resident Llama model",
+              py::arg("llama_model_params"), py::arg("pinned") = true)
+         .def("evict_llama_model", &CoreAIService::evict_llama_model, "Unload a resident Llama model that is neither active nor in use",
+              py::arg("llama_model_params"))
+         .def("set_llama_memory_budget", &CoreAIService::set_llama_memory_budget, "Set the RAM/VRAM budget of resident Llama models in bytes (0 for unlimited)",
+              py::arg("ram_budget_bytes"), py::arg("vram_budget_bytes"))
+         .def("get_llama_registry_stats", &CoreAIService::get_llama_registry_stats, "Get the Llama model registry counters")
+         .def("set_compute_quota", &CoreAIService::set_compute_quota, "Set the threads an engine is guaranteed while both engines run (0 restores the default)",
+              py::arg("engine"), py::arg("n_threads"))
+         .def("configure_compute_pool", &CoreAIService::configure_compute_pool, "Enable core pinning and restrict inference to a NUMA node (-1 for all)",
+              py::arg("pin_threads"), py::arg("numa_node") = -1)
+         .def("get_compute_pool_stats", &CoreAIService::get_compute_pool_stats, "Get the compute pool quotas and counters")
+         .def("get_cpu_topology", &CoreAIService::get_cpu_topology, "Get the cores the compute pool schedules on")
+         .def("get_metrics", &CoreAIService::get_metrics, "Get the latency histograms and counters of the service")
+         .def("export_metrics_prometheus", &CoreAIService::export_metrics_prometheus, "Render the metrics in the Prometheus text format")
+         .def("reset_metrics", &CoreAIService::reset_metrics, "Zero the metrics of the service")
+         .def("enable_tuned_llama_params", &CoreAIService::enable_tuned_llama_params,
+              "Load chat models with the parameters tuned for them on this machine", py::arg("store_path"))
+         .def("disable_tuned_llama_params", &CoreAIService::disable_tuned_llama_params, "Load chat models with the given parameters")
+         .def("resolve_llama_model_params", &CoreAIService::resolve_llama_model_params,
+              "Parameters a chat model is loaded with, tuned ones applied", py::arg("llama_model_params"))
+         .def_static("start_trace", &CoreAIService::start_trace,
+                     "Start recording trace spans of the inference paths of every service",
+                     py::arg("events_per_thread") = TraceRecorder::DEFAULT_EVENTS_PER_THREAD)
+         .def_static("stop_trace", &CoreAIService::stop_trace, "Stop recording trace spans")
+         .def_static("write_trace", &CoreAIService::write_trace,
+                     "Write the recorded spans as Chrome trace JSON, viewable in chrome://tracing or Perfetto",
+                     py::arg("path"), py::call_guard<py::gil_scoped_release>())
+         .def_static("get_trace_stats", &CoreAIService::get_trace_stats, "Get the counters of the trace recorder")
+         .def_static("set_log_level", &CoreAIService::set_log_level,
+                     "Set the verbosity of the native console messages", py::arg("level"))
+         .def_static("get_log_level", &CoreAIService::get_log_level, "Get the verbosity of the native console messages")
          .def("initialize_whisper_model", &CoreAIService::initialize_whisper_model, "Initialize and load the Whisper model",
-              py::arg("whisper_model_params"))
-         .def("unload_whisper_model", &CoreAIService::unload_whisper_model, "Unload the currently loaded Whisper model")
+              py::arg("whisper_model_params"),
+              py::call_guard<py::gil_scoped_release>())
+         .def("unload_whisper_model", &CoreAIService::unload_whisper_model, "Unload the currently loaded Whisper model",
+              py::call_guard<py::gil_scoped_release>())
          .def("is_whisper_model_loaded", &CoreAIService::is_whisper_model_loaded)
-         .def("transcribe_audio_pcm", &CoreAIService::transcribe_audio_pcm, "Transcribe PCM audio data using Whisper",
+         .def("transcribe_audio_pcm", [](CoreAIService &self, const float_array &pcm_f32_data, const HegemonikonWhisperGenerationParams &params)
+              {
+                   const float *samples = nullptr;
+                   size_t n_samples = 0;
+                   borrow_array(pcm_f32_data, samples, n_samples);
+                   py::gil_scoped_release release;
+                   return self.transcribe_audio_pcm(samples, n_samples, params); },
+              "Transcribe 16 kHz mono PCM audio using Whisper. A contiguous float32 NumPy array (or any buffer) is read in place; "
+              "other sequences are converted first.",
               py::arg("pcm_f32_data"), py::arg("whisper_model_params"))
          .def("transcribe_audio_file", &CoreAIService::transcribe_audio_file, "Transcribe an audio file using Whisper",
-              py::arg("audio_file_path"), py::arg("whisper_model_params"))
-         .def("tokenization", &CoreAIService::tokenization, "Tokenize text using Llama model parameters",
+              py::arg("audio_file_path"), py::arg("whisper_model_params"),
+              py::call_guard<py::gil_scoped_release>())
+         .def("transcribe_audio_pcm_segments", [](CoreAIService &self, const float_array &pcm_f32_data, const HegemonikonWhisperGenerationParams &params)
+              {
+                   const float *samples = nullptr;
+                   size_t n_samples = 0;
+                   borrow_array(pcm_f32_data, samples, n_samples);
+                   py::gil_scoped_release release;
+                   return self.transcribe_audio_pcm_segments(samples, n_samples, params); },
+              "Transcribe 16 kHz mono PCM audio into segments with their times, and their tokens with token_timestamps",
+              py::arg("pcm_f32_data"), py::arg("whisper_model_params"))
+         .def("transcribe_audio_file_segments", &CoreAIService::transcribe_audio_file_segments,
+              "Transcribe an audio file into segments with their times, and their tokens with token_timestamps",
+              py::arg("audio_file_path"), py::arg("whisper_model_params"),
+              py::call_guard<py::gil_scoped_release>())
+         .def("transcribe_batch", &CoreAIService::transcribe_batch,
+              "Transcribe audio files with decoding overlapped with inference; on_result(result) is called as each file completes",
+              py::arg("audio_file_paths"), py::arg("whisper_transcription_params"), py::arg("on_result") = nullptr,
+              py::arg("n_decoders") = 2, py::arg("n_workers") = 1,
+              py::call_guard<py::gil_scoped_release>())
+         .def("warm_up_whisper_model", &CoreAIService::warm_up_whisper_model,
+              "Allocate the whisper decoders and buffers for transcriptions with these parameters, e.g. their beam_size",
+              py::arg("whisper_transcription_params"),
+              py::call_guard<py::gil_scoped_release>())
+         .def_static("release_resident_whisper_model", &CoreAIService::release_resident_whisper_model,
+                     "Free the Whisper model kept resident by a service unloaded with keep_resident",
+                     py::call_guard<py::gil_scoped_release>())
+         .def("transcribe_and_generate", &CoreAIService::transcribe_and_generate,
+              "Transcribe an audio file and generate from prompt_prefix + transcript + prompt_suffix, prefilling the transcript while it is transcribed",
+              py::arg("audio_file_path"), py::arg("whisper_transcription_params"), py::arg("prompt_prefix"), py::arg("prompt_suffix"),
+              py::arg("llama_generation_params"), py::arg("on_piece") = nullptr,
+              py::call_guard<py::gil_scoped_release>())
+         .def("enable_transcription_cache", &CoreAIService::enable_transcription_cache,
+              "Cache file transcriptions in a directory, keyed by audio content and parameters",
+              py::arg("directory"), py::arg("max_bytes") = TranscriptionCache::DEFAULT_MAX_BYTES,
+              py::call_guard<py::gil_scoped_release>())
+         .def("disable_transcription_cache", &CoreAIService::disable_transcription_cache, "Stop using the transcription cache, keeping its files")
+         .def("clear_transcription_cache", &CoreAIService::clear_transcription_cache, "Remove every cached transcription; returns the number removed",
+              py::call_guard<py::gil_scoped_release>())
+         .def("get_transcription_cache_stats", &CoreAIService::get_transcription_cache_stats, "Get the transcription cache counters")
+         .def("open_transcription_stream", [](CoreAIService &self, const HegemonikonWhisperGenerationParams &params, whisper_segment_callback_t on_segment)
+              {
+                   std::unique_ptr<WhisperStreamSession> session = self.open_transcription_stream(params, std::move(on_segment));
+                   if (!session)
+                   {
+                        throw std::runtime_error("Whisper model not loaded");
+                   }
+                   return std::unique_ptr<WhisperStreamSession, gil_releasing_delete<WhisperStreamSession>>(session.release()); },
+              "Open a live transcription session; on_segment(segment) is called from the session thread",
+              py::arg("whisper_transcription_params"), py::arg("on_segment"))
+         .def("tokenization", [](CoreAIService &self, const std::string &text)
+              {
+                   std::vector<int32_t> tokens;
+                   {
+                        py::gil_scoped_release release;
+                        tokens = self.tokenization(text);
+                   }
+                   return vector_to_array(std::move(tokens)); },
+              "Tokenize text using Llama model parameters. Returns an int32 NumPy array.",
               py::arg("text"))
-         .def("detokenization", &CoreAIService::detokenization, "Detokenize a list of tokens into text",
-              py::arg("tokens"));
+         .def("detokenization", [](const CoreAIService &self, const int32_array &tokens)
+              {
+                   const int32_t *data = nullptr;
+                   size_t n_tokens = 0;
+                   borrow_array(tokens, data, n_tokens);
+                   std::vector<int32_t> token_vector(data, data + n_tokens);
+                   py::gil_scoped_release release;
+                   return self.detokenization(token_vector); },
+              "Detokenize an int32 NumPy array or a list of tokens into text",
+              py::arg("tokens"))
+         .def("tokenize_batch", [](CoreAIService &self, const py::sequence &texts)
+              {
+                   std::vector<std::string_view> views = borrow_texts(texts);
+                   HegemonikonTokenBatch batch;
+                   {
+                        py::gil_scoped_release release;
+                        batch = self.tokenize_batch(views);
+                   }
+                   return py::make_tuple(vector_to_array(std::move(batch.tokens)),
+                                         vector_to_array(std::move(batch.offsets))); },
+              "Tokenize many texts in parallel. Returns (tokens, offsets) NumPy arrays; the tokens of text i are tokens[offsets[i]:offsets[i + 1]].",
+              py::arg("texts"))
+         .def("count_tokens", [](CoreAIService &self, const py::sequence &texts)
+              {
+                   std::vector<std::string_view> views = borrow_texts(texts);
+                   std::vector<int32_t> counts;
+                   {
+                        py::gil_scoped_release release;
+                        counts = self.count_tokens(views);
+                   }
+                   return vector_to_array(std::move(counts)); },
+              "Count the tokens of many texts in parallel without returning them (-1 on failure).",
+              py::arg("texts"))
+         .def("initialize_embedding_model", &CoreAIService::initialize_embedding_model,
+              "Load the embedding GGUF used by embed(), next to the chat model",
+              py::arg("embedding_model_params"), py::call_guard<py::gil_scoped_release>())
+         .def("unload_embedding_model", &CoreAIService::unload_embedding_model, "Unload the embedding model")
+         .def("is_embedding_model_loaded", &CoreAIService::is_embedding_model_loaded, "Check if the embedding model is loaded")
+         .def("embed", [](CoreAIService &self, const py::sequence &texts, bool normalize)
+              {
+                   std::vector<std::string_view> views = borrow_texts(texts);
+                   HegemonikonEmbeddingBatch batch;
+                   {
+                        py::gil_scoped_release release;
+                        batch = self.embed(views, normalize);
+                   }
+                   const size_t rows = batch.size();
+                   return matrix_to_array(std::move(batch.data), rows, static_cast<size_t>(batch.n_embd)); },
+              "Embed many texts in batched decodes. Returns a float32 NumPy array of shape (len(texts), n_embd), "
+              "L2-normalized unless normalize is False; empty if no embedding model is loaded.",
+              py::arg("texts"), py::arg("normalize") = true);
 
      py::class_<HegemonikonQuantizedModelInfo>(m, "HegemonikonQuantizedModelInfo", "Information about a quantized model.")
          .def(py::init<>())
@@ -274,6 +1024,8 @@ PYBIND11_MODULE(hegemonikon_py, m)
      metrics.avg_ttft_ms = d.attr("get")("avg_ttft_ms", 0.0).cast<float>();
      metrics.avg_decode_time_ms = d.attr("get")("avg_decode_time_ms", 0.0).cast<float>();
      metrics.avg_end_to_end_time_latency_ms = d.attr("get")("avg_end_to_end_time_latency_ms", 0.0).cast<float>();
+     metrics.draft_acceptance_rate = d.attr("get")("draft_acceptance_rate", 0.0).cast<float>();
+     metrics.avg_accepted_draft_length = d.attr("get")("avg_accepted_draft_length", 0.0).cast<float>();
      return metrics; })
          .def_readwrite("load_time_ms", &HegemonikonBenchmarkMetrics::load_time_ms, "Time taken to load the model in milliseconds.")
          .def_readwrite("generation_time_ms", &HegemonikonBenchmarkMetrics::generation_time_ms, "Time taken for text generation in seconds.")
@@ -293,7 +1045,10 @@ PYBIND11_MODULE(hegemonikon_py, m)
          .def_readwrite("decode_times_history_ms", &HegemonikonBenchmarkMetrics::decode_times_history_ms, "List of decode times for each run in milliseconds.")
          .def_readwrite("p50_latency_ms", &HegemonikonBenchmarkMetrics::p50_latency_ms, "50th percentile latency in milliseconds.")
          .def_readwrite("p95_latency_ms", &HegemonikonBenchmarkMetrics::p95_latency_ms, "95th percentile latency in milliseconds.")
-         .def_readwrite("p99_latency_ms", &HegemonikonBenchmarkMetrics::p99_latency_ms, "99th percentile latency in milliseconds.");
+         .def_readwrite("p99_latency_ms", &HegemonikonBenchmarkMetrics::p99_latency_ms, "99th percentile latency in milliseconds.")
+         .def_readwrite("draft_acceptance_rate", &HegemonikonBenchmarkMetrics::draft_acceptance_rate, "Fraction of drafted tokens accepted (speculative decoding only).")
+         .def_readwrite("avg_accepted_draft_length", &HegemonikonBenchmarkMetrics::avg_accepted_draft_length, "Average accepted drafts per speculative step.")
+         .def_readwrite("accepted_draft_length_history", &HegemonikonBenchmarkMetrics::accepted_draft_length_history, "Average accepted drafts per step for each run.");
 
      py::class_<HegemonikonBenchmarkResult>(m, "HegemonikonBenchmarkResult", "Result of a model benchmark.")
          .def(py::init<const std::string &>(), "Constructor with model ID")
@@ -339,14 +1094,223 @@ PYBIND11_MODULE(hegemonikon_py, m)
          .def_readwrite("warmup", &HegemonikonBenchmarkParams::warmup, "Whether to perform a warmup run before benchmarking.")
          .def_readwrite("generation_params", &HegemonikonBenchmarkParams::generation_params, "Generation parameters to use during benchmarking.");
 
+     py::enum_<HegemonikonTuningObjective>(m, "HegemonikonTuningObjective", "What the auto-tuner optimizes.")
+         .value("TIME_TO_FIRST_TOKEN", HegemonikonTuningObjective::TimeToFirstToken)
+         .value("DECODE_TOKENS_PER_SECOND", HegemonikonTuningObjective::DecodeTokensPerSecond)
+         .value("MEMORY", HegemonikonTuningObjective::Memory);
+
+     py::class_<HegemonikonTuningGrid>(m, "HegemonikonTuningGrid", "Values swept by the auto-tuner; an empty list keeps the base value.")
+         .def(py::init<>())
+         .def_readwrite("n_gpu_layers", &HegemonikonTuningGrid::n_gpu_layers, "Offloaded layer counts; -1 plans from the free VRAM.")
+         .def_readwrite("n_batch", &HegemonikonTuningGrid::n_batch, "Logical batch sizes.")
+         .def_readwrite("n_threads", &HegemonikonTuningGrid::n_threads, "Thread counts, used for single-token and prompt decodes.")
+         .def_readwrite("n_ctx", &HegemonikonTuningGrid::n_ctx, "Context sizes.")
+         .def_readwrite("cache_types", &HegemonikonTuningGrid::cache_types, "KV cache types, applied to K and V.")
+         .def_readwrite("flash_attn", &HegemonikonTuningGrid::flash_attn, "Flash attention modes: 'auto', 'on', 'off'.")
+         .def("size", &HegemonikonTuningGrid::size, "Number of configurations of the grid.");
+
+     py::class_<HegemonikonTuningConstraints>(m, "HegemonikonTuningConstraints", "Limits a configuration must meet; 0 disables a limit.")
+         .def(py::init<>())
+         .def_readwrite("max_ttft_ms", &HegemonikonTuningConstraints::max_ttft_ms, "Largest average time to first token in milliseconds.")
+         .def_readwrite("min_tokens_per_second", &HegemonikonTuningConstraints::min_tokens_per_second, "Smallest average decode speed.")
+         .def_readwrite("max_memory_mb", &HegemonikonTuningConstraints::max_memory_mb, "Largest model footprint (RAM + VRAM) in MB.");
+
+     py::class_<HegemonikonTuningParams>(m, "HegemonikonTuningParams", "Parameters of an auto-tuning sweep.")
+         .def(py::init<>())
+         .def_readwrite("grid", &HegemonikonTuningParams::grid, "Values to sweep.")
+         .def_readwrite("objective", &HegemonikonTuningParams::objective, "What to optimize.")
+         .def_readwrite("constraints", &HegemonikonTuningParams::constraints, "Limits the winner must meet.")
+         .def_readwrite("successive_halving", &HegemonikonTuningParams::successive_halving, "Drop the worse half after each round, doubling the repetitions of the rest.")
+         .def_readwrite("min_repetitions", &HegemonikonTuningParams::min_repetitions, "Repetitions of the first successive halving round.")
+         .def_readwrite("benchmark_params", &HegemonikonTuningParams::benchmark_params, "Benchmark settings; repetitions is the count of the last round.");
+
+     py::class_<HegemonikonTuningCandidate>(m, "HegemonikonTuningCandidate", "One configuration measured by the auto-tuner.")
+         .def_readonly("llama_model_params", &HegemonikonTuningCandidate::llama_model_params, "Parameters of the configuration.")
+         .def_readonly("metrics", &HegemonikonTuningCandidate::metrics, "Metrics of its last round.")
+         .def_readonly("repetitions", &HegemonikonTuningCandidate::repetitions, "Repetitions of its last round.")
+         .def_readonly("feasible", &HegemonikonTuningCandidate::feasible, "Whether it meets the constraints.")
+         .def_readonly("score", &HegemonikonTuningCandidate::score, "Objective score, higher is better.");
+
+     py::class_<HegemonikonTuningResult>(m, "HegemonikonTuningResult", "Outcome of an auto-tuning sweep.")
+         .def_readonly("model_id", &HegemonikonTuningResult::model_id, "Tuned model.")
+         .def_readonly("success", &HegemonikonTuningResult::success, "Whether a configuration meets the constraints.")
+         .def_readonly("errorMessage", &HegemonikonTuningResult::errorMessage, "Why the sweep failed or was not stored.")
+         .def_readonly("best_params", &HegemonikonTuningResult::best_params, "Parameters of the winning configuration.")
+         .def_readonly("candidates", &HegemonikonTuningResult::candidates, "Configurations, best first.")
+         .def_readonly("stored", &HegemonikonTuningResult::stored, "Whether the winner was written to the tuning store.");
+
+     py::class_<HegemonikonTunedLlamaParams>(m, "HegemonikonTunedLlamaParams", "Tuned load parameters of a model on a machine.")
+         .def_readonly("model_key", &HegemonikonTunedLlamaParams::model_key, "File name and size of the model.")
+         .def_readonly("machine_key", &HegemonikonTunedLlamaParams::machine_key, "CPU and offload devices of the machine.")
+         .def_readonly("objective", &HegemonikonTunedLlamaParams::objective, "Objective of the tuning.")
+         .def_readonly("score", &HegemonikonTunedLlamaParams::score, "Score of the winner.")
+         .def_readonly("ttft_ms", &HegemonikonTunedLlamaParams::ttft_ms, "Average time to first token of the winner.")
+         .def_readonly("tokens_per_second", &HegemonikonTunedLlamaParams::tokens_per_second, "Average decode speed of the winner.")
+         .def_readonly("memory_mb", &HegemonikonTunedLlamaParams::memory_mb, "Footprint of the winner in MB.")
+         .def_readonly("params", &HegemonikonTunedLlamaParams::params, "Tuned parameters.")
+         .def("__str__", [](const HegemonikonTunedLlamaParams &p)
+              { return p.to_string(); });
+
+     py::class_<LlamaTuningStore, std::shared_ptr<LlamaTuningStore>>(m, "LlamaTuningStore", "JSON file of tuned load parameters per model and machine.")
+         .def(py::init<const std::string &>(), py::arg("path"))
+         .def("lookup", [](const LlamaTuningStore &store, const std::string &model_path) -> py::object
+              {
+                  HegemonikonTunedLlamaParams entry;
+                  if (!store.lookup(model_path, entry))
+                  {
+                      return py::none();
+                  }
+                  return py::cast(entry); }, "Tuned parameters of a model file on this machine, None if not tuned.", py::arg("model_path"))
+         .def("entries", &LlamaTuningStore::entries, "All the entries of the store.")
+         .def_static("model_key", &LlamaTuningStore::model_key, "Key of a model file.", py::arg("model_path"))
+         .def_static("machine_key", &LlamaTuningStore::machine_key, "Key of this machine.");
+
      py::class_<HegemonikonLlamaBenchmarker>(m, "HegemonikonLlamaBenchmarker", "Benchmarks LLM models for performance and metrics.")
          .def(py::init<>(), "Default constructor")
          .def("benchmark_single_model", &HegemonikonLlamaBenchmarker::benchmarkSingleModel, "Benchmark a single LLM model",
               py::arg("quantized_model_info"), py::arg("benchmark_params"), py::arg("llama_model_params"),
               "Runs a benchmark for a single model.",
               py::call_guard<py::gil_scoped_release>())
+         .def("tune_model", &HegemonikonLlamaBenchmarker::tuneModel, "Benchmark a model over a grid of load parameters and rank them",
+              py::arg("quantized_model_info"), py::arg("tuning_params"), py::arg("llama_model_params"),
+              py::call_guard<py::gil_scoped_release>())
+         .def("tune_and_store_model", &HegemonikonLlamaBenchmarker::tuneAndStoreModel, "Tune a model and store the winning parameters for this machine",
+              py::arg("quantized_model_info"), py::arg("tuning_params"), py::arg("llama_model_params"), py::arg("store_path"),
+              py::call_guard<py::gil_scoped_release>())
+         .def_static("expand_tuning_grid", &HegemonikonLlamaBenchmarker::expandTuningGrid, "List the configurations of a grid",
+                     py::arg("grid"), py::arg("llama_model_params"))
+         .def_static("save_results_json", &HegemonikonLlamaBenchmarker::saveResultsJson, "Write results to a JSON file",
+                     py::arg("results"), py::arg("path"))
          .def("request_cancellation", &HegemonikonLlamaBenchmarker::requestCancellation, "Request cancellation of an ongoing benchmark.");
 
+     py::class_<HegemonikonLoadProfile>(m, "HegemonikonLoadProfile", "Simulated clients of a concurrent-load benchmark.")
+         .def(py::init<>())
+         .def_readwrite("concurrency_levels", &HegemonikonLoadProfile::concurrency_levels, "Numbers of concurrent clients, one level each.")
+         .def_readwrite("requests_per_client", &HegemonikonLoadProfile::requests_per_client, "Requests sent by each client per level.")
+         .def_readwrite("arrival_rate", &HegemonikonLoadProfile::arrival_rate, "Poisson arrivals per second per client; 0 sends the next request when the previous one completed.")
+         .def_readwrite("min_prompt_tokens", &HegemonikonLoadProfile::min_prompt_tokens, "Shortest prompt in tokens.")
+         .def_readwrite("max_prompt_tokens", &HegemonikonLoadProfile::max_prompt_tokens, "Longest prompt in tokens.")
+         .def_readwrite("min_output_tokens", &HegemonikonLoadProfile::min_output_tokens, "Shortest n_predict.")
+         .def_readwrite("max_output_tokens", &HegemonikonLoadProfile::max_output_tokens, "Longest n_predict.")
+         .def_readwrite("use_scheduler", &HegemonikonLoadProfile::use_scheduler, "Send the requests to the batching scheduler instead of stream_prompt.")
+         .def_readwrite("seed", &HegemonikonLoadProfile::seed, "Seed of the lengths and arrivals.")
+         .def_readwrite("generation_params", &HegemonikonLoadProfile::generation_params, "Generation parameters; n_predict is drawn per request.")
+         .def_readwrite("prompts", &HegemonikonLoadProfile::prompts, "Texts the prompts are built from, a default corpus when empty.")
+         .def("__str__", [](const HegemonikonLoadProfile &p)
+              { return p.to_string(); });
+
+     py::class_<HegemonikonLatencyPercentiles>(m, "HegemonikonLatencyPercentiles", "Latency percentiles in milliseconds.")
+         .def_readonly("count", &HegemonikonLatencyPercentiles::count, "Number of samples.")
+         .def_readonly("mean_ms", &HegemonikonLatencyPercentiles::mean_ms, "Mean latency.")
+         .def_readonly("p50_ms", &HegemonikonLatencyPercentiles::p50_ms, "Median latency.")
+         .def_readonly("p95_ms", &HegemonikonLatencyPercentiles::p95_ms, "95th percentile latency.")
+         .def_readonly("p99_ms", &HegemonikonLatencyPercentiles::p99_ms, "99th percentile latency.")
+         .def_readonly("max_ms", &HegemonikonLatencyPercentiles::max_ms, "Largest latency.")
+         .def("__str__", [](const HegemonikonLatencyPercentiles &p)
+              { return p.to_string(); });
+
+     py::class_<HegemonikonLoadLevelResult>(m, "HegemonikonLoadLevelResult", "Throughput and latencies at one concurrency level.")
+         .def_readonly("concurrency", &HegemonikonLoadLevelResult::concurrency, "Number of concurrent clients.")
+         .def_readonly("requests", &HegemonikonLoadLevelResult::requests, "Requests sent.")
+         .def_readonly("failed_requests", &HegemonikonLoadLevelResult::failed_requests, "Requests that failed.")
+         .def_readonly("prompt_tokens", &HegemonikonLoadLevelResult::prompt_tokens, "Prompt tokens of the successful requests.")
+         .def_readonly("generated_tokens", &HegemonikonLoadLevelResult::generated_tokens, "Tokens generated by the successful requests.")
+         .def_readonly("duration_s", &HegemonikonLoadLevelResult::duration_s, "Wall time of the level.")
+         .def_readonly("tokens_per_second", &HegemonikonLoadLevelResult::tokens_per_second, "Generated tokens per second over all clients.")
+         .def_readonly("requests_per_second", &HegemonikonLoadLevelResult::requests_per_second, "Successful requests per second.")
+         .def_readonly("ttft", &HegemonikonLoadLevelResult::ttft, "Time to first token, queueing included.")
+         .def_readonly("inter_token", &HegemonikonLoadLevelResult::inter_token, "Gaps between streamed pieces.")
+         .def_readonly("end_to_end", &HegemonikonLoadLevelResult::end_to_end, "Request latencies.")
+         .def_readonly("start_memory_mb", &HegemonikonLoadLevelResult::start_memory_mb, "Resident memory when the level started.")
+         .def_readonly("peak_memory_mb", &HegemonikonLoadLevelResult::peak_memory_mb, "Peak resident memory during the level.")
+         .def("__str__", [](const HegemonikonLoadLevelResult &r)
+              { return r.to_string(); });
+
+     py::class_<HegemonikonLoadBenchmarkResult>(m, "HegemonikonLoadBenchmarkResult", "Outcome of a concurrent-load benchmark.")
+         .def_readonly("success", &HegemonikonLoadBenchmarkResult::success, "Whether every level ran.")
+         .def_readonly("errorMessage", &HegemonikonLoadBenchmarkResult::errorMessage, "Why the benchmark failed.")
+         .def_readonly("levels", &HegemonikonLoadBenchmarkResult::levels, "Results per concurrency level.")
+         .def("to_csv", &HegemonikonLoadBenchmarkResult::to_csv, "The levels as CSV, one row per concurrency level.");
+
+     py::class_<LlamaLoadBenchmarker>(m, "LlamaLoadBenchmarker", "Drives simulated concurrent clients against a CoreAIService.")
+         .def(py::init<CoreAIService &>(), py::arg("service"), py::keep_alive<1, 2>())
+         .def("run", &LlamaLoadBenchmarker::run, "Run every concurrency level of a load profile",
+              py::arg("profile"),
+              py::call_guard<py::gil_scoped_release>())
+         .def("request_cancellation", &LlamaLoadBenchmarker::request_cancellation, "Cancel the running benchmark.");
+
+     py::class_<HegemonikonWhisperBenchmarkParams>(m, "HegemonikonWhisperBenchmarkParams", "Parameters for a Whisper benchmark.")
+         .def(py::init<>())
+         .def_readwrite("repetitions", &HegemonikonWhisperBenchmarkParams::repetitions, "Passes over the whole corpus.")
+         .def_readwrite("warmup", &HegemonikonWhisperBenchmarkParams::warmup, "Transcribe the first clip once before measuring.")
+         .def_readwrite("generation_params", &HegemonikonWhisperBenchmarkParams::generation_params, "Transcription parameters.");
+
+     py::class_<HegemonikonWhisperBenchmarkGrid>(m, "HegemonikonWhisperBenchmarkGrid", "Values swept by the Whisper benchmarker; an empty list keeps the base value.")
+         .def(py::init<>())
+         .def_readwrite("models", &HegemonikonWhisperBenchmarkGrid::models, "Model files, e.g. the sizes of one family.")
+         .def_readwrite("n_threads", &HegemonikonWhisperBenchmarkGrid::n_threads, "Thread counts.")
+         .def_readwrite("beam_size", &HegemonikonWhisperBenchmarkGrid::beam_size, "Beam sizes; 1 or less decodes greedily.")
+         .def_readwrite("flash_attn", &HegemonikonWhisperBenchmarkGrid::flash_attn, "Flash attention settings.")
+         .def_readwrite("audio_ctx", &HegemonikonWhisperBenchmarkGrid::audio_ctx, "Audio context sizes; 0 is the full window.")
+         .def("size", &HegemonikonWhisperBenchmarkGrid::size, "Number of configurations.");
+
+     py::class_<HegemonikonWhisperBenchmarkConfiguration>(m, "HegemonikonWhisperBenchmarkConfiguration", "One configuration of a Whisper benchmark grid.")
+         .def_readonly("model_params", &HegemonikonWhisperBenchmarkConfiguration::model_params, "Model parameters.")
+         .def_readonly("generation_params", &HegemonikonWhisperBenchmarkConfiguration::generation_params, "Transcription parameters.");
+
+     py::class_<HegemonikonWhisperBenchmarkMetrics>(m, "HegemonikonWhisperBenchmarkMetrics", "Measurements of one Whisper configuration over the corpus.")
+         .def_readonly("load_time_ms", &HegemonikonWhisperBenchmarkMetrics::load_time_ms, "Model load time.")
+         .def_readonly("model_size_mb", &HegemonikonWhisperBenchmarkMetrics::model_size_mb, "Size of the model file.")
+         .def_readonly("audio_seconds", &HegemonikonWhisperBenchmarkMetrics::audio_seconds, "Duration of the corpus.")
+         .def_readonly("success", &HegemonikonWhisperBenchmarkMetrics::success, "Whether every repetition ran.")
+         .def_readonly("errorMessage", &HegemonikonWhisperBenchmarkMetrics::errorMessage, "Why the benchmark failed.")
+         .def_readonly("transcription_time_history_ms", &HegemonikonWhisperBenchmarkMetrics::transcription_time_history_ms, "Time to transcribe the corpus, per repetition.")
+         .def_readonly("real_time_factor_history", &HegemonikonWhisperBenchmarkMetrics::real_time_factor_history, "Real-time factor per repetition.")
+         .def_readonly("encode_time_history_ms", &HegemonikonWhisperBenchmarkMetrics::encode_time_history_ms, "Encoder time per repetition.")
+         .def_readonly("decode_time_history_ms", &HegemonikonWhisperBenchmarkMetrics::decode_time_history_ms, "Decoder time per repetition.")
+         .def_readonly("avg_transcription_time_ms", &HegemonikonWhisperBenchmarkMetrics::avg_transcription_time_ms, "Average time to transcribe the corpus.")
+         .def_readonly("stdev_transcription_time_ms", &HegemonikonWhisperBenchmarkMetrics::stdev_transcription_time_ms, "Standard deviation of the corpus time.")
+         .def_readonly("p50_transcription_time_ms", &HegemonikonWhisperBenchmarkMetrics::p50_transcription_time_ms, "Median corpus time.")
+         .def_readonly("p95_transcription_time_ms", &HegemonikonWhisperBenchmarkMetrics::p95_transcription_time_ms, "95th percentile corpus time.")
+         .def_readonly("p99_transcription_time_ms", &HegemonikonWhisperBenchmarkMetrics::p99_transcription_time_ms, "99th percentile corpus time.")
+         .def_readonly("real_time_factor", &HegemonikonWhisperBenchmarkMetrics::real_time_factor, "Average transcription time over audio duration; below 1 is faster than real time.")
+         .def_readonly("stdev_real_time_factor", &HegemonikonWhisperBenchmarkMetrics::stdev_real_time_factor, "Standard deviation of the real-time factor.")
+         .def_readonly("avg_encode_time_ms", &HegemonikonWhisperBenchmarkMetrics::avg_encode_time_ms, "Average encoder time per repetition.")
+         .def_readonly("avg_decode_time_ms", &HegemonikonWhisperBenchmarkMetrics::avg_decode_time_ms, "Average decoder time per repetition.")
+         .def_readonly("peak_rss_mb", &HegemonikonWhisperBenchmarkMetrics::peak_rss_mb, "Peak resident memory of the process.")
+         .def_readonly("gpu_memory_mb", &HegemonikonWhisperBenchmarkMetrics::gpu_memory_mb, "Growth of the GPU memory in use since before the load.");
+
+     py::class_<HegemonikonWhisperBenchmarkResult>(m, "HegemonikonWhisperBenchmarkResult", "Result of benchmarking one Whisper configuration.")
+         .def_readonly("model_id", &HegemonikonWhisperBenchmarkResult::model_id, "File name of the model.")
+         .def_readonly("model_params", &HegemonikonWhisperBenchmarkResult::model_params, "Model parameters of the configuration.")
+         .def_readonly("generation_params", &HegemonikonWhisperBenchmarkResult::generation_params, "Transcription parameters of the configuration.")
+         .def_readonly("metrics", &HegemonikonWhisperBenchmarkResult::metrics, "Measurements.")
+         .def_readonly("transcript", &HegemonikonWhisperBenchmarkResult::transcript, "Transcript of the first clip.")
+         .def("to_json", [](const HegemonikonWhisperBenchmarkResult &r)
+              { return r.to_json().dump(); }, "The result as a JSON string.");
+
+     py::class_<HegemonikonWhisperBenchmarker>(m, "HegemonikonWhisperBenchmarker", "Benchmarks Whisper models on a corpus of audio files.")
+         .def(py::init<>(), "Default constructor")
+         .def("load_corpus", &HegemonikonWhisperBenchmarker::loadCorpus, "Decode audio files into the corpus; False if one could not be decoded",
+              py::arg("paths"),
+              py::call_guard<py::gil_scoped_release>())
+         .def("set_corpus", &HegemonikonWhisperBenchmarker::setCorpus, "Replace the corpus with clips of 16 kHz mono samples",
+              py::arg("clips"))
+         .def("get_corpus_size", &HegemonikonWhisperBenchmarker::getCorpusSize, "Number of clips in the corpus")
+         .def("get_corpus_seconds", &HegemonikonWhisperBenchmarker::getCorpusSeconds, "Duration of the corpus")
+         .def_static("expand_grid", &HegemonikonWhisperBenchmarker::expandGrid, "List the configurations of a grid",
+                     py::arg("grid"), py::arg("model_params"), py::arg("generation_params"))
+         .def("benchmark_single_model", &HegemonikonWhisperBenchmarker::benchmarkSingleModel, "Benchmark one Whisper configuration on the corpus",
+              py::arg("model_params"), py::arg("benchmark_params"),
+              py::call_guard<py::gil_scoped_release>())
+         .def("benchmark_grid", &HegemonikonWhisperBenchmarker::benchmarkGrid, "Benchmark every configuration of a grid on the corpus",
+              py::arg("grid"), py::arg("model_params"), py::arg("benchmark_params"),
+              py::call_guard<py::gil_scoped_release>())
+         .def_static("save_results_json", &HegemonikonWhisperBenchmarker::saveResultsJson, "Write results to a JSON file",
+                     py::arg("results"), py::arg("path"))
+         .def("print_benchmark_result", &HegemonikonWhisperBenchmarker::printBenchmarkResult, "Print a result", py::arg("result"))
+         .def("request_cancellation", &HegemonikonWhisperBenchmarker::requestCancellation, "Request cancellation of an ongoing benchmark.");
+
      py::class_<SecureKey>(m, "SecureKey", "A C++ class to hold sensitive data (like encryption keys) in locked memory.")
          .def("data", [](const SecureKey &self)
               { return py::bytes(reinterpret_cast<const char *>(self.data()), self.size()); }, "Returns the key data as a Python bytes object.")
@@ -357,7 +1321,14 @@ PYBIND11_MODULE(hegemonikon_py, m)
                        { return new SecureString(std::string(b)); }),
               "Constructor from a bytes object");
 
-     m.def("derive_and_protect_key", [](const SecureString &secure_password, const py::bytes &salt_bytes)
+     py::class_<KeyDerivationParams>(m, "KeyDerivationParams", "Argon2id cost parameters of a password key derivation.")
+         .def(py::init<>(), "Default constructor")
+         .def_readwrite("t_cost", &KeyDerivationParams::t_cost, "Number of passes over memory.")
+         .def_readwrite("m_cost", &KeyDerivationParams::m_cost, "Memory in KiB.")
+         .def_readwrite("lanes", &KeyDerivationParams::lanes, "Number of lanes; part of the derived key.")
+         .def_readwrite("threads", &KeyDerivationParams::threads, "Lanes filled concurrently, 0 for one per lane; not part of the derived key.");
+
+     m.def("derive_and_protect_key", [](const SecureString &secure_password, const py::bytes &salt_bytes, const KeyDerivationParams &params)
            {
 
                 char *salt_buffer;
@@ -368,5 +1339,6 @@ PYBIND11_MODULE(hegemonikon_py, m)
                 }
                 std::vector<uint8_t> salt(salt_buffer, salt_buffer + salt_length);
 
-                return derive_and_protect_key(secure_password, salt); }, py::arg("password"), py::arg("salt"), "Derives a key from a password using Argon2id and returns it in a protected object.");
+                py::gil_scoped_release release;
+                return derive_and_protect_key(secure_password, salt, params); }, py::arg("password"), py::arg("salt"), py::arg("params") = KeyDerivationParams(), "Derives a key from a password using Argon2id and returns it in a protected object.");
 };
\ No newline at end of file
@@ -0,0 +1,542 @@
+#include "compute_pool.hh"
+#include "hegemonikon_log.hh"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <thread>
+
+#include <ggml.h>
+#include <ggml-cpu.h>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#ifdef __APPLE__
+#include <sys/sysctl.h>
+#include <sys/types.h>
+#endif
+
+namespace
+{
+#ifdef __linux__
+    bool read_int_file(const std::string &path, int64_t &value)
+    {
+        std::ifstream in(path);
+        return static_cast<bool>(in >> value);
+    }
+
+    /**
+     * @brief Parses a sysfs CPU list such as "0-3,8,10-11".
+     */
+    std::set<int32_t> read_cpu_list(const std::string &path)
+    {
+        std::set<int32_t> cpus;
+        std::ifstream in(path);
+        std::string list;
+        if (!std::getline(in, list))
+        {
+            return cpus;
+        }
+        std::stringstream ss(list);
+        std::string range;
+        while (std::getline(ss, range, ','))
+        {
+            const size_t dash = range.find('-');
+            try
+            {
+                const int32_t first = std::stoi(range.substr(0, dash));
+                const int32_t last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+                for (int32_t cpu = first; cpu <= last; ++cpu)
+                {
+                    cpus.insert(cpu);
+                }
+            }
+            catch (const std::exception &)
+            {
+            }
+        }
+        return cpus;
+    }
+#endif
+
+    struct ggml_threadpool_deleter
+    {
+        void operator()(ggml_threadpool *threadpool) const
+        {
+            if (threadpool)
+            {
+                ggml_threadpool_free(threadpool);
+            }
+        }
+    };
+}
+
+/**
+ * @brief Detects the physical cores of the machine.
+ */
+HegemonikonCpuTopology HegemonikonCpuTopology::detect()
+{
+    HegemonikonCpuTopology topology;
+    topology.n_logical_cpus = static_cast<int32_t>(std::max(1u, std::thread::hardware_concurrency()));
+
+#ifdef __linux__
+    cpu_set_t affinity;
+    CPU_ZERO(&affinity);
+    const bool has_affinity = sched_getaffinity(0, sizeof(affinity), &affinity) == 0;
+
+    const std::set<int32_t> atom_cpus = read_cpu_list("/sys/devices/cpu_atom/cpus");
+    std::map<int32_t, int32_t> node_of_cpu;
+    for (int32_t node = 0; node < 1024; ++node)
+    {
+        const std::set<int32_t> node_cpus = read_cpu_list("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        if (node_cpus.empty())
+        {
+            if (node > 0)
+                break;
+            continue;
+        }
+        topology.n_numa_nodes = node + 1;
+        for (int32_t cpu : node_cpus)
+        {
+            node_of_cpu[cpu] = node;
+        }
+    }
+
+    std::set<std::pair<int32_t, int32_t>> seen_cores;
+    std::vector<std::pair<HegemonikonCpuCore, int64_t>> cores;
+    int64_t max_capacity = 0;
+    for (int32_t cpu = 0; cpu < topology.n_logical_cpus; ++cpu)
+    {
+        if (has_affinity && !CPU_ISSET(cpu, &affinity))
+            continue;
+
+        const std::string base = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/";
+        int64_t core_id = cpu;
+        int64_t package = 0;
+        int64_t capacity = 0;
+        read_int_file(base + "topology/core_id", core_id);
+        read_int_file(base + "topology/physical_package_id", package);
+        read_int_file(base + "cpu_capacity", capacity);
+        if (!seen_cores.insert({static_cast<int32_t>(package), static_cast<int32_t>(core_id)}).second)
+            continue;
+
+        HegemonikonCpuCore core;
+        core.cpu = cpu;
+        core.core_id = static_cast<int32_t>(core_id);
+        core.package = static_cast<int32_t>(package);
+        core.numa_node = node_of_cpu.count(cpu) ? node_of_cpu[cpu] : 0;
+        core.efficiency = atom_cpus.count(cpu) > 0;
+        max_capacity = std::max(max_capacity, capacity);
+        cores.push_back({core, capacity});
+    }
+    for (auto &[core, capacity] : cores)
+    {
+        // ARM big.LITTLE: little cores report a capacity below the biggest one.
+        if (atom_cpus.empty() && capacity > 0 && capacity < max_capacity)
+        {
+            core.efficiency = true;
+        }
+        topology.cores.push_back(core);
+    }
+#elif defined(__APPLE__)
+    int32_t n_performance = 0;
+    int32_t n_efficiency = 0;
+    size_t size = sizeof(int32_t);
+    if (sysctlbyname("hw.perflevel0.physicalcpu", &n_performance, &size, nullptr, 0) != 0)
+    {
+        size = sizeof(int32_t);
+        sysctlbyname("hw.physicalcpu", &n_performance, &size, nullptr, 0);
+    }
+    size = sizeof(int32_t);
+    if (sysctlbyname("hw.perflevel1.physicalcpu", &n_efficiency, &size, nullptr, 0) != 0)
+    {
+        n_efficiency = 0;
+    }
+    for (int32_t i = 0; i < n_performance + n_efficiency; ++i)
+    {
+        HegemonikonCpuCore core;
+        core.cpu = i;
+        core.core_id = i;
+        core.efficiency = i >= n_performance;
+        topology.cores.push_back(core);
+    }
+#endif
+
+    if (topology.cores.empty())
+    {
+        for (int32_t cpu = 0; cpu < topology.n_logical_cpus; ++cpu)
+        {
+            HegemonikonCpuCore core;
+            core.cpu = cpu;
+            core.core_id = cpu;
+            topology.cores.push_back(core);
+        }
+    }
+    return topology;
+}
+
+size_t HegemonikonCpuTopology::n_performance_cores() const
+{
+    return static_cast<size_t>(std::count_if(cores.begin(), cores.end(), [](const HegemonikonCpuCore &core)
+                                             { return !core.efficiency; }));
+}
+
+size_t HegemonikonCpuTopology::n_efficiency_cores() const
+{
+    return cores.size() - n_performance_cores();
+}
+
+ComputeLease::~ComputeLease()
+{
+    release();
+}
+
+ComputeLease::ComputeLease(ComputeLease &&other) noexcept
+{
+    *this = std::move(other);
+}
+
+ComputeLease &ComputeLease::operator=(ComputeLease &&other) noexcept
+{
+    if (this != &other)
+    {
+        release();
+        pool_ = other.pool_;
+        engine_ = other.engine_;
+        n_threads_ = other.n_threads_;
+        borrowed_ = other.borrowed_;
+        cpus_ = std::move(other.cpus_);
+        threadpool_ = std::move(other.threadpool_);
+        saved_affinity_ = std::move(other.saved_affinity_);
+        other.pool_ = nullptr;
+        other.n_threads_ = 0;
+    }
+    return *this;
+}
+
+/**
+ * @brief Restricts the calling thread to the lease CPUs until the lease is released.
+ *
+ * Threads created meanwhile inherit the restriction, which is how the workers whisper
+ * spawns for a transcription end up on the lease cores.
+ *
+ * @return true if the affinity was changed; always false outside Linux.
+ */
+bool ComputeLease::bind_current_thread()
+{
+#ifdef __linux__
+    if (cpus_.empty() || !saved_affinity_.empty())
+    {
+        return false;
+    }
+    cpu_set_t previous;
+    CPU_ZERO(&previous);
+    if (sched_getaffinity(0, sizeof(previous), &previous) != 0)
+    {
+        return false;
+    }
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    for (int32_t cpu : cpus_)
+    {
+        CPU_SET(cpu, &mask);
+    }
+    if (sched_setaffinity(0, sizeof(mask), &mask) != 0)
+    {
+        return false;
+    }
+    const auto *bytes = reinterpret_cast<const uint8_t *>(&previous);
+    saved_affinity_.assign(bytes, bytes + sizeof(previous));
+    return true;
+#else
+    return false;
+#endif
+}
+
+void ComputeLease::release()
+{
+#ifdef __linux__
+    if (saved_affinity_.size() == sizeof(cpu_set_t))
+    {
+        sched_setaffinity(0, sizeof(cpu_set_t), reinterpret_cast<const cpu_set_t *>(saved_affinity_.data()));
+    }
+#endif
+    saved_affinity_.clear();
+    if (pool_)
+    {
+        pool_->release(engine_, n_threads_);
+        pool_ = nullptr;
+    }
+    threadpool_.reset();
+}
+
+/**
+ * @brief The pool shared by every CoreAIService of the process.
+ */
+std::shared_ptr<ComputePool> ComputePool::shared()
+{
+    static std::shared_ptr<ComputePool> pool = std::make_shared<ComputePool>();
+    return pool;
+}
+
+/**
+ * @brief Builds a pool over the given cores, unpinned and spanning every NUMA node.
+ *
+ * @param topology The cores to schedule on.
+ */
+ComputePool::ComputePool(HegemonikonCpuTopology topology)
+    : topology_(std::move(topology))
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    layout_locked();
+}
+
+ComputePool::~ComputePool() = default;
+
+/**
+ * @brief Enables thread pinning and restricts the pool to one NUMA node.
+ *
+ * Llama contexts switch to the new threadpool at their next decode step.
+ *
+ * @param pin_threads Whether to pin llama threads to cores and bind whisper leases.
+ * @param numa_node   NUMA node to run on, -1 for all of them. A node without cores is ignored.
+ */
+void ComputePool::configure(bool pin_threads, int32_t numa_node)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    pin_threads_ = pin_threads;
+    numa_node_ = numa_node;
+    layout_locked();
+}
+
+/**
+ * @brief Sets the number of threads an engine is guaranteed while the other one runs.
+ *
+ * @param engine    The engine.
+ * @param n_threads The quota, 0 or less to restore the default.
+ */
+void ComputePool::set_quota(ComputeEngine engine, int32_t n_threads)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    (engine == ComputeEngine::Llama ? llama_quota_set_ : whisper_quota_set_) = n_threads > 0;
+    (engine == ComputeEngine::Llama ? llama_quota_ : whisper_quota_) = n_threads;
+    layout_locked();
+}
+
+int32_t ComputePool::get_quota(ComputeEngine engine) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return engine == ComputeEngine::Llama ? llama_quota_ : whisper_quota_;
+}
+
+/**
+ * @brief Sets how long after its last decode step llama still counts as busy.
+ */
+void ComputePool::set_idle_grace_ms(int64_t grace_ms)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    idle_grace_ms_ = std::max<int64_t>(0, grace_ms);
+}
+
+/**
+ * @brief Grants an engine its share of the cores.
+ *
+ * @param engine      The engine.
+ * @param max_threads Upper bound requested by the caller, 0 for none.
+ * @return The lease; it always grants at least one thread.
+ */
+ComputeLease ComputePool::acquire(ComputeEngine engine, int32_t max_threads)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    const int32_t total = static_cast<int32_t>(cpus_.size());
+
+    ComputeLease lease;
+    lease.pool_ = this;
+    lease.engine_ = engine;
+
+    int32_t n = 0;
+    if (engine == ComputeEngine::Llama)
+    {
+        const int32_t n_llama = static_cast<int32_t>(n_llama_cpus_);
+        const int32_t available = std::min(n_llama, total - whisper_threads_);
+        n = whisper_threads_ > 0 ? std::min(available, llama_quota_) : n_llama;
+        lease.borrowed_ = whisper_threads_ == 0 && n > llama_quota_;
+        // Models decoding at the same time split llama's share.
+        n /= llama_active_ + 1;
+        llama_active_++;
+        stats_.llama_leases++;
+        lease.threadpool_ = threadpool_locked();
+    }
+    else
+    {
+        const bool llama_busy = llama_active_ > 0 ||
+                                clock::now() - last_llama_release_ < std::chrono::milliseconds(idle_grace_ms_);
+        n = llama_busy ? whisper_quota_ : total - whisper_threads_;
+        lease.borrowed_ = !llama_busy && n > whisper_quota_;
+        stats_.whisper_leases++;
+    }
+
+    if (max_threads > 0)
+    {
+        n = std::min(n, max_threads);
+        lease.borrowed_ = lease.borrowed_ && n > (engine == ComputeEngine::Llama ? llama_quota_ : whisper_quota_);
+    }
+    n = std::max(1, n);
+    lease.n_threads_ = n;
+    stats_.borrowed_leases += lease.borrowed_ ? 1 : 0;
+
+    if (engine == ComputeEngine::Llama)
+    {
+        last_llama_threads_ = n;
+        lease.cpus_.assign(cpus_.begin(), cpus_.begin() + std::min<size_t>(static_cast<size_t>(n), cpus_.size()));
+    }
+    else
+    {
+        whisper_threads_ += n;
+        if (pin_threads_)
+        {
+            lease.cpus_.assign(cpus_.end() - std::min<size_t>(static_cast<size_t>(n), cpus_.size()), cpus_.end());
+        }
+    }
+    return lease;
+}
+
+/**
+ * @brief Number of cores the pool schedules on.
+ */
+int32_t ComputePool::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return static_cast<int32_t>(cpus_.size());
+}
+
+HegemonikonCpuTopology ComputePool::get_topology() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return topology_;
+}
+
+HegemonikonComputePoolStats ComputePool::get_stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    HegemonikonComputePoolStats stats = stats_;
+    stats.n_threads = static_cast<int32_t>(cpus_.size());
+    stats.llama_quota = llama_quota_;
+    stats.whisper_quota = whisper_quota_;
+    stats.llama_threads = llama_active_ > 0 ? last_llama_threads_ : 0;
+    stats.whisper_threads = whisper_threads_;
+    stats.pinned = pin_threads_;
+    stats.numa_node = numa_node_;
+    return stats;
+}
+
+/**
+ * @brief Orders the cores, derives the default quotas and drops the current threadpool.
+ *
+ * Performance cores of the selected node come first and form llama's set; efficiency
+ * cores follow. Without efficiency cores whisper's quota is taken from the tail of the
+ * performance cores (at most 4 threads, as whisper scales poorly beyond that).
+ */
+void ComputePool::layout_locked()
+{
+    std::vector<HegemonikonCpuCore> cores;
+    for (const HegemonikonCpuCore &core : topology_.cores)
+    {
+        if (numa_node_ < 0 || core.numa_node == numa_node_)
+            cores.push_back(core);
+    }
+    if (cores.empty())
+    {
+        cores = topology_.cores;
+    }
+
+    cpus_.clear();
+    for (const HegemonikonCpuCore &core : cores)
+    {
+        if (!core.efficiency)
+            cpus_.push_back(core.cpu);
+    }
+    n_llama_cpus_ = cpus_.size();
+    for (const HegemonikonCpuCore &core : cores)
+    {
+        if (core.efficiency)
+            cpus_.push_back(core.cpu);
+    }
+    if (n_llama_cpus_ == 0)
+    {
+        n_llama_cpus_ = cpus_.size();
+    }
+
+    const int32_t total = static_cast<int32_t>(cpus_.size());
+    const int32_t n_efficiency = total - static_cast<int32_t>(n_llama_cpus_);
+    if (!whisper_quota_set_)
+    {
+        whisper_quota_ = n_efficiency > 0 ? n_efficiency : std::max(1, std::min(4, total / 4));
+    }
+    whisper_quota_ = std::clamp(whisper_quota_, 1, std::max(1, total));
+    if (!llama_quota_set_)
+    {
+        llama_quota_ = std::max(1, std::min(static_cast<int32_t>(n_llama_cpus_), total - whisper_quota_));
+    }
+    llama_quota_ = std::clamp(llama_quota_, 1, std::max(1, static_cast<int32_t>(n_llama_cpus_)));
+
+    // Rebuilt on the next llama lease; contexts holding the old one keep it alive.
+    threadpool_.reset();
+    threadpool_failed_ = false;
+}
+
+/**
+ * @brief Returns llama's ggml threadpool, creating it on first use.
+ *
+ * It has one thread per llama core; a lease only uses its first n_threads() of them.
+ */
+std::shared_ptr<ggml_threadpool> ComputePool::threadpool_locked()
+{
+    if (threadpool_ || threadpool_failed_ || n_llama_cpus_ == 0)
+    {
+        return threadpool_;
+    }
+
+    ggml_threadpool_params params = ggml_threadpool_params_default(static_cast<int>(n_llama_cpus_));
+    if (pin_threads_)
+    {
+        std::fill(std::begin(params.cpumask), std::end(params.cpumask), false);
+        for (size_t i = 0; i < n_llama_cpus_; ++i)
+        {
+            if (cpus_[i] >= 0 && cpus_[i] < GGML_MAX_N_THREADS)
+                params.cpumask[cpus_[i]] = true;
+        }
+        params.strict_cpu = true;
+    }
+    ggml_threadpool *threadpool = ggml_threadpool_new(&params);
+    if (!threadpool)
+    {
+        threadpool_failed_ = true;
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Warning))
+        {
+            std::cerr << "ComputePool Warning: failed to create the ggml threadpool, llama will use its own threads" << std::endl;
+        }
+        return nullptr;
+    }
+    threadpool_ = std::shared_ptr<ggml_threadpool>(threadpool, ggml_threadpool_deleter());
+    return threadpool_;
+}
+
+void ComputePool::release(ComputeEngine engine, int32_t n_threads)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (engine == ComputeEngine::Llama)
+    {
+        llama_active_ = std::max(0, llama_active_ - 1);
+        last_llama_release_ = clock::now();
+    }
+    else
+    {
+        whisper_threads_ = std::max(0, whisper_threads_ - n_threads);
+    }
+}
@@ -1,24 +1,35 @@
 #include "core_ai_service.hh"
 
+#include <chrono>
 #include <iostream>
 #include <memory>
 #include <string>
 #include <vector>
 
-#define MINIAUDIO_IMPLEMENTATION
-#include "miniaudio.h"
+#include "audio_file_decoder.hh"
+
+namespace
+{
+    /**
+     * @brief The Whisper interface parked by a service unloading a model kept resident.
+     *
+     * Process-wide, so that a CoreAIService created later takes the loaded model back.
+     */
+    std::mutex resident_whisper_mutex;
+    std::shared_ptr<WhisperInterface> resident_whisper;
+}
 
 /**
  * @brief Constructs a CoreAIService object and initializes member variables.
  *
- * Initializes the llama_interface_ and whisper_interface_ pointers to nullptr,
- * and sets the model loaded flags (llama_model_loaded_ and whisper_model_loaded_)
- * to false, indicating that no models are loaded at construction.
+ * Initializes the Llama and Whisper interfaces to nullptr; Llama models are created by
+ * the model registry on demand. No model is loaded at construction.
  */
 CoreAIService::CoreAIService()
     : llama_interface_(nullptr),
+      llama_registry_([this]()
+                      { return take_spare_llama_interface(); }),
       whisper_interface_(nullptr),
-      llama_model_loaded_(false),
       whisper_model_loaded_(false)
 {
 }
@@ -27,7 +38,8 @@ CoreAIService::CoreAIService()
  * @brief Constructs a CoreAIService object with the given Llama and Whisper interfaces.
  *
  * Initializes the CoreAIService by taking ownership of the provided LlamaInterface and
- * WhisperInterface instances. Also initializes the model loaded flags to false.
+ * WhisperInterface instances. The Llama interface is used for the first model loaded
+ * through initialize_llama_model. No model is loaded at construction.
  *
  * @param llama_interface Unique pointer to a LlamaInterface implementation.
  * @param whisper_interface Unique pointer to a WhisperInterface implementation.
@@ -35,9 +47,11 @@ CoreAIService::CoreAIService()
 CoreAIService::CoreAIService(
     std::unique_ptr<LlamaInterface> llama_interface,
     std::unique_ptr<WhisperInterface> whisper_interface)
-    : llama_interface_(std::move(llama_interface)),
+    : llama_interface_(nullptr),
+      spare_llama_interface_(std::move(llama_interface)),
+      llama_registry_([this]()
+                      { return take_spare_llama_interface(); }),
       whisper_interface_(std::move(whisper_interface)),
-      llama_model_loaded_(false),
       whisper_model_loaded_(false)
 {
 }
@@ -51,28 +65,156 @@ CoreAIService::CoreAIService(
  */
 CoreAIService::~CoreAIService()
 {
+    join_llama_load_thread();
     unload_llama_model();
+    llama_registry_.clear();
+    unload_embedding_model();
     unload_whisper_model();
 }
 
 /**
- * @brief Initializes the Llama model with the specified parameters.
+ * @brief Makes the Llama model with the specified parameters the active one.
  *
- * This function ensures that the Llama interface is instantiated and attempts to load
- * the Llama model using the provided parameters. The result of the model loading operation
- * is stored internally and returned to indicate success or failure.
+ * The model is looked up in the model registry first, so switching back to a model that
+ * is still resident is immediate. Otherwise it is loaded, possibly evicting idle models
+ * that no longer fit in the memory budget. The previously active model stays resident.
+ * Requests already queued on the batching scheduler complete on the previous model
+ * before the switch.
  *
  * @param params The parameters required to load the Llama model.
- * @return true if the model was loaded successfully; false otherwise.
+ * @return true if the model is loaded and active; false otherwise (no model is active then).
  */
 bool CoreAIService::initialize_llama_model(const HegemonikonLlamaModelParams &params)
 {
-    if (!llama_interface_)
+    return activate_llama_model(params, nullptr);
+}
+
+/**
+ * @brief Loads and activates a Llama model on a background thread.
+ *
+ * Returns immediately with a status the caller can poll, wait on or cancel; the model
+ * becomes active once the status reports ready, and requests keep being served by the
+ * previously active model until then. A model that is already resident is activated
+ * without a reload. Loads started in a row run one after the other, in order.
+ *
+ * @param params The parameters required to load the Llama model.
+ * @return The status of the load.
+ */
+std::shared_ptr<LlamaLoadStatus> CoreAIService::initialize_llama_model_async(const HegemonikonLlamaModelParams &params)
+{
+    auto status = std::make_shared<LlamaLoadStatus>();
+    std::lock_guard<std::mutex> lock(llama_load_thread_mutex_);
+    std::thread previous = std::move(llama_load_thread_);
+    llama_load_thread_ = std::thread([this, params, status, previous = std::move(previous)]() mutable
+                                     {
+        if (previous.joinable())
+        {
+            previous.join();
+        }
+        if (status->is_cancelled())
+        {
+            status->finish(false, "Load cancelled");
+            return;
+        }
+        const bool ok = activate_llama_model(params, status);
+        status->finish(ok, ok ? "" : "Failed to load model: " + params.model_path); });
+    return status;
+}
+
+/**
+ * @brief Waits for the background model loads to complete.
+ */
+void CoreAIService::join_llama_load_thread()
+{
+    std::thread load_thread;
+    {
+        std::lock_guard<std::mutex> lock(llama_load_thread_mutex_);
+        load_thread = std::move(llama_load_thread_);
+    }
+    if (load_thread.joinable())
+    {
+        load_thread.join();
+    }
+}
+
+/**
+ * @brief Looks up or loads a model in the registry and makes it the active one.
+ *
+ * @param params The parameters required to load the Llama model.
+ * @param status Optional status the load reports progress to. When set, a failed load
+ *               keeps the previously active model; otherwise no model is active then.
+ * @return true if the model is loaded and active; false otherwise.
+ */
+bool CoreAIService::activate_llama_model(const HegemonikonLlamaModelParams &params,
+                                         std::shared_ptr<LlamaLoadStatus> status)
+{
+    const bool keep_on_failure = status != nullptr;
+    const HegemonikonLlamaModelParams resolved = resolve_llama_model_params(params);
+    std::shared_ptr<LlamaInterface> model = llama_registry_.acquire(resolved, std::move(status));
+    claim_spare_llama_interface(model);
+    if (model && model == get_active_llama_interface())
     {
-        llama_interface_ = std::make_unique<LlamaInterface>();
+        return true;
+    }
+    if (!model && keep_on_failure)
+    {
+        // A failed or cancelled background load leaves the active model serving requests.
+        return false;
+    }
+
+    drain_llama_scheduler();
+    stop_llama_context_pool();
+    std::shared_ptr<LlamaInterface> previous;
+    {
+        std::lock_guard<std::mutex> lock(llama_interface_mutex_);
+        previous = std::move(llama_interface_);
+        llama_interface_ = model;
+        if (model)
+        {
+            llama_model_params = resolved;
+        }
+    }
+    return model != nullptr;
+}
+
+/**
+ * @brief Returns the active Llama model, or nullptr if none is loaded.
+ *
+ * Callers keep the returned pointer for the duration of a request, which is what
+ * prevents the registry from evicting a model that is still in use.
+ */
+std::shared_ptr<LlamaInterface> CoreAIService::get_active_llama_interface() const
+{
+    std::lock_guard<std::mutex> lock(llama_interface_mutex_);
+    return llama_interface_;
+}
+
+/**
+ * @brief Hands the registry the interface to load the next model into.
+ *
+ * An interface set with set_llama_interface (or kept from unload_llama_model) is reused;
+ * a new LlamaInterface is created otherwise. The spare is only lent: it stays available
+ * for the next load until claim_spare_llama_interface sees it loaded.
+ */
+std::shared_ptr<LlamaInterface> CoreAIService::take_spare_llama_interface()
+{
+    std::lock_guard<std::mutex> lock(llama_interface_mutex_);
+    std::shared_ptr<LlamaInterface> model = spare_llama_interface_ ? spare_llama_interface_ : std::make_shared<LlamaInterface>();
+    model->set_compute_pool(compute_pool_);
+    model->set_metrics(metrics_);
+    return model;
+}
+
+/**
+ * @brief Stops offering the spare interface once a model has been loaded into it.
+ */
+void CoreAIService::claim_spare_llama_interface(const std::shared_ptr<LlamaInterface> &model)
+{
+    std::lock_guard<std::mutex> lock(llama_interface_mutex_);
+    if (model && spare_llama_interface_ == model)
+    {
+        spare_llama_interface_.reset();
     }
-    llama_model_loaded_ = llama_interface_->load_model(params);
-    return llama_model_loaded_;
 }
 
 /**
@@ -80,55 +222,106 @@ bool CoreAIService::initialize_llama_model(const HegemonikonLlamaModelParams &pa
  *
  * This function ensures that the Whisper interface is instantiated and attempts to load
  * the Whisper model using the provided parameters. The result of the model loading
- * operation is stored and returned.
+ * operation is stored and returned. Nothing is reloaded when the model is already loaded
+ * with the same parameters, or when it was kept resident (see
+ * HegemonikonWhisperModelParams::keep_resident) by this or another service.
  *
  * @param params The parameters required to load the Whisper model.
  * @return true if the Whisper model was successfully loaded; false otherwise.
  */
 bool CoreAIService::initialize_whisper_model(const HegemonikonWhisperModelParams &params)
 {
+    std::lock_guard<std::mutex> lock(whisper_interface_mutex_);
+    if (whisper_interface_ && whisper_model_loaded_ && whisper_interface_->is_model_loaded() &&
+        whisper_interface_->model_params() == params)
+    {
+        whisper_interface_->set_keep_resident(params.keep_resident);
+        return true;
+    }
     if (!whisper_interface_)
     {
-        whisper_interface_ = std::make_unique<WhisperInterface>();
+        {
+            std::lock_guard<std::mutex> resident_lock(resident_whisper_mutex);
+            if (resident_whisper && resident_whisper->model_params() == params)
+            {
+                whisper_interface_ = std::move(resident_whisper);
+            }
+        }
+        if (whisper_interface_)
+        {
+            if (HegemonikonLog::enabled(HegemonikonLogLevel::Info))
+            {
+                std::cerr << "CoreAIService: reusing resident Whisper model " << params.model << std::endl;
+            }
+            whisper_interface_->set_compute_pool(compute_pool_);
+            whisper_interface_->set_metrics(metrics_);
+            whisper_interface_->set_keep_resident(params.keep_resident);
+            whisper_model_loaded_ = true;
+            return true;
+        }
+        whisper_interface_ = std::make_shared<WhisperInterface>();
     }
+    whisper_interface_->set_compute_pool(compute_pool_);
+    whisper_interface_->set_metrics(metrics_);
     whisper_model_loaded_ = whisper_interface_->load_model(params);
     return whisper_model_loaded_;
 }
 
 /**
- * @brief Unloads the currently loaded Llama model from the service.
+ * @brief Unloads the currently active Llama model from the service.
  *
- * This function checks if the Llama interface is initialized. If so, it calls
- * the interface's unload_model() method to release the model resources and
- * updates the internal state to indicate that no model is loaded.
+ * The model is removed from the registry and unloaded unless requests still hold it, in
+ * which case it stays resident until the registry evicts it. Other resident models are
+ * left untouched.
  */
 void CoreAIService::unload_llama_model()
 {
-    if (llama_interface_)
+    stop_llama_scheduler();
+    stop_llama_context_pool();
+    std::shared_ptr<LlamaInterface> previous;
+    HegemonikonLlamaModelParams previous_params;
+    {
+        std::lock_guard<std::mutex> lock(llama_interface_mutex_);
+        previous = std::move(llama_interface_);
+        previous_params = llama_model_params;
+    }
+    if (!previous)
+    {
+        return;
+    }
+    previous.reset();
+
+    std::shared_ptr<LlamaInterface> detached = llama_registry_.detach(previous_params);
+    if (detached)
     {
-        llama_interface_->unload_model();
-        llama_model_loaded_ = false;
+        detached->unload_model();
+        std::lock_guard<std::mutex> lock(llama_interface_mutex_);
+        if (!spare_llama_interface_)
+        {
+            spare_llama_interface_ = std::move(detached);
+        }
     }
 }
 
 /**
  * @brief Checks if the Llama model is currently loaded.
  *
- * This function returns true if both the Llama interface is initialized
- * and the Llama model has been successfully loaded into memory.
+ * This function returns true if a Llama model has been successfully loaded and is the
+ * active model of the service.
  *
  * @return true if the Llama model is loaded and ready for use, false otherwise.
  */
 bool CoreAIService::is_llama_model_loaded() const
 {
-    return llama_interface_ && llama_model_loaded_;
+    return get_active_llama_interface() != nullptr;
 }
 
 /**
  * @brief Processes the given prompt text using the loaded Llama model and returns the generated completion.
  *
  * This function checks if a Llama model is loaded. If so, it generates a completion for the provided prompt text
- * using the specified generation parameters. If the model is not loaded, it returns an error message.
+ * using the specified generation parameters, on a context leased from the context pool when one is configured.
+ * If the model is not loaded, it returns an error message.
  *
  * @param prompt_text The input prompt text to be processed by the Llama model.
  * @param llama_generation_params_ The parameters to control the generation behavior of the Llama model.
@@ -136,24 +329,42 @@ bool CoreAIService::is_llama_model_loaded() const
  */
 std::string CoreAIService::process_prompt(const std::string &prompt_text, const HegemonikonGenerationParams &llama_generation_params_)
 {
-    if (is_llama_model_loaded())
+    return process_prompt(prompt_text, llama_generation_params_, nullptr);
+}
+
+/**
+ * @brief Processes a prompt that can be cancelled or time-limited through a request handle.
+ *
+ * Cancelling the handle from another thread stops the generation within one decode step,
+ * including in the middle of a long prefill. Text generated before the interruption is
+ * returned; a request interrupted before its first token returns an error string.
+ *
+ * @param prompt_text The input prompt text to be processed by the Llama model.
+ * @param llama_generation_params_ The parameters to control the generation behavior of the Llama model.
+ * @param handle The control block of the request, may be null.
+ * @return std::string The generated completion, or an error message.
+ */
+std::string CoreAIService::process_prompt(const std::string &prompt_text, const HegemonikonGenerationParams &llama_generation_params_,
+                                          std::shared_ptr<LlamaRequestHandle> handle)
+{
+    std::shared_ptr<LlamaInterface> llama = get_active_llama_interface();
+    if (!llama)
     {
-        double ttft_ms = 0.0;
-        double decode_duration_ms = 0.0;
-        int32_t tokens_generated = 0;
-        return llama_interface_->generate_completion(prompt_text, llama_generation_params_, ttft_ms, decode_duration_ms, tokens_generated);
+        return "[Error: Llama model not loaded]";
     }
-    else
+    if (std::shared_ptr<LlamaContextPool> pool = get_llama_context_pool(llama))
     {
-        return "[Error: Llama model not loaded]";
+        LlamaContextLease lease = pool->acquire(llama_generation_params_.session_id);
+        return lease->run_generation(prompt_text, llama_generation_params_, nullptr, std::move(handle)).text;
     }
+    return llama->run_generation(prompt_text, llama_generation_params_, nullptr, std::move(handle)).text;
 }
 
 std::vector<int32_t> CoreAIService::tokenization(const std::string &text)
 {
-    if (is_llama_model_loaded())
+    if (std::shared_ptr<LlamaInterface> llama = get_active_llama_interface())
     {
-        return llama_interface_->tokenization(text);
+        return llama->tokenization(text);
     }
     else
     {
@@ -163,9 +374,9 @@ std::vector<int32_t> CoreAIService::tokenization(const std::string &text)
 
 std::string CoreAIService::detokenization(const std::vector<int32_t> &tokens) const
 {
-    if (is_llama_model_loaded())
+    if (std::shared_ptr<LlamaInterface> llama = get_active_llama_interface())
     {
-        return llama_interface_->detokenization(tokens);
+        return llama->detokenization(tokens);
     }
     else
     {
@@ -174,170 +385,1345 @@ std::string CoreAIService::detokenization(const std::vector<int32_t> &tokens) co
 }
 
 /**
- * @brief Streams a prompt to the Llama model and returns generated completions via a callback.
+ * @brief Returns the worker pool used for batched tokenization, creating it on first use.
+ */
+ThreadPool *CoreAIService::get_tokenizer_pool()
+{
+    std::lock_guard<std::mutex> lock(tokenizer_pool_mutex_);
+    if (!tokenizer_pool_)
+    {
+        tokenizer_pool_ = std::make_unique<ThreadPool>();
+    }
+    return tokenizer_pool_.get();
+}
+
+/**
+ * @brief Tokenizes many texts in one call, in parallel.
  *
- * This function checks if the Llama model is loaded. If so, it streams the prompt text to the model
- * using the specified generation parameters, invoking the provided callback with each generated token.
- * If the model is not loaded, the callback is invoked with an error message and the function returns false.
+ * Intended for RAG indexing, where thousands of chunks would otherwise be tokenized one
+ * call at a time. Tokens are returned packed in a single array with per-text offsets.
  *
- * @param prompt_text The input prompt to be sent to the Llama model.
- * @param llama_generation_params Parameters controlling the generation behavior of the model.
- * @param callback A function to be called with each generated token or error message.
- * @return true if the streaming started successfully, false otherwise.
+ * @param texts The texts to tokenize (a BOS token is prepended to each, as in tokenization()).
+ * @return HegemonikonTokenBatch The packed tokens; empty if the Llama model is not loaded.
  */
-bool CoreAIService::stream_prompt(const std::string &prompt_text,
-                                  const HegemonikonGenerationParams &llama_generation_params,
-                                  llama_token_callback callback)
+HegemonikonTokenBatch CoreAIService::tokenize_batch(const std::vector<std::string_view> &texts)
 {
-    if (is_llama_model_loaded())
+    std::shared_ptr<LlamaInterface> llama = get_active_llama_interface();
+    if (!llama)
     {
-        return llama_interface_->generate_completion_streaming(prompt_text, llama_generation_params, callback);
+        return {};
     }
-    else
+    return llama->tokenize_batch(texts, get_tokenizer_pool());
+}
+
+/**
+ * @brief Loads the embedding model used by embed(), next to the chat model.
+ *
+ * The embedding model has its own context and is not part of the model registry, so
+ * switching chat models never evicts it. `embeddings` is forced on; a larger `n_batch`
+ * and `n_seq_max` let more chunks share each decode.
+ *
+ * @param params The parameters of the embedding GGUF.
+ * @return true if the model is loaded; false otherwise (the previous one is kept then).
+ */
+bool CoreAIService::initialize_embedding_model(const HegemonikonLlamaModelParams &params)
+{
+    HegemonikonLlamaModelParams embedding_params = params;
+    embedding_params.embeddings = true;
+
+    auto model = std::make_shared<LlamaInterface>();
+    model->set_compute_pool(compute_pool_);
+    model->set_metrics(metrics_);
+    if (!model->load_model(embedding_params))
     {
-        if (callback)
-        {
-            callback("[Error: Llama model not loaded]");
-        }
         return false;
     }
+
+    std::shared_ptr<LlamaInterface> previous;
+    {
+        std::lock_guard<std::mutex> lock(embedding_interface_mutex_);
+        previous = std::move(embedding_interface_);
+        embedding_interface_ = std::move(model);
+    }
+    return true;
 }
 
 /**
- * @brief Checks if the Whisper model is currently loaded.
+ * @brief Unloads the embedding model once no embed() call uses it anymore.
+ */
+void CoreAIService::unload_embedding_model()
+{
+    std::lock_guard<std::mutex> lock(embedding_interface_mutex_);
+    embedding_interface_.reset();
+}
+
+bool CoreAIService::is_embedding_model_loaded() const
+{
+    std::lock_guard<std::mutex> lock(embedding_interface_mutex_);
+    return embedding_interface_ && embedding_interface_->is_model_loaded();
+}
+
+/**
+ * @brief Embeds many texts in batched decodes of the embedding model.
  *
- * This method returns true if the Whisper interface exists and the model has been successfully loaded.
- * Otherwise, it returns false.
+ * Meant for RAG indexing and queries: the chunks are tokenized in parallel and packed
+ * several per llama_decode, and the result is one contiguous matrix.
  *
- * @return true if the Whisper model is loaded; false otherwise.
+ * @param texts     The texts to embed.
+ * @param normalize Whether to L2-normalize every row.
+ * @return HegemonikonEmbeddingBatch One row per text; empty if no embedding model is loaded.
  */
-bool CoreAIService::is_whisper_model_loaded() const
+HegemonikonEmbeddingBatch CoreAIService::embed(const std::vector<std::string_view> &texts, bool normalize)
 {
-    if (whisper_interface_)
+    std::shared_ptr<LlamaInterface> model;
     {
-        return whisper_model_loaded_;
+        std::lock_guard<std::mutex> lock(embedding_interface_mutex_);
+        model = embedding_interface_;
     }
-    return false;
+    if (!model)
+    {
+        return {};
+    }
+    return model->embed_batch(texts, normalize, get_tokenizer_pool());
 }
 
 /**
- * @brief Unloads the currently loaded Whisper model, if any.
+ * @brief Counts the tokens of many texts without returning the tokens themselves.
  *
- * This function checks if a Whisper model interface exists. If so, it calls
- * the unload_model() method to release any resources associated with the model,
- * and then resets the interface pointer to ensure proper cleanup.
+ * @param texts The texts to measure.
+ * @return The token count of each text, -1 for failures or when no model is loaded.
  */
-void CoreAIService::unload_whisper_model()
+std::vector<int32_t> CoreAIService::count_tokens(const std::vector<std::string_view> &texts)
 {
-    if (whisper_interface_)
+    std::shared_ptr<LlamaInterface> llama = get_active_llama_interface();
+    if (!llama)
     {
-        whisper_interface_->unload_model();
-        whisper_interface_.reset();
+        return std::vector<int32_t>(texts.size(), -1);
     }
+    return llama->count_tokens_batch(texts, get_tokenizer_pool());
 }
 
 /**
- * @brief Transcribes audio data in PCM float32 format using the loaded Whisper model.
+ * @brief Streams a prompt to the Llama model and returns generated completions via a callback.
  *
- * This function takes a vector of 32-bit floating point PCM audio samples and transcribes
- * them into text using the Whisper model, if it is loaded. If the model is not loaded,
- * an error message is returned.
+ * This function checks if the Llama model is loaded. If so, it streams the prompt text to the model
+ * using the specified generation parameters, on a context leased from the context pool when one is
+ * configured, invoking the provided callback with each generated token. The callback only ever
+ * receives generated text: a failure, including a model that is not loaded, is reported by the
+ * return value.
  *
- * @param pcm_f32_data A vector containing the PCM audio data as float values.
- * @param whisper_model_params_ Parameters to configure the Whisper model's transcription behavior.
- * @return std::string The transcribed text if successful, or an error message if the model is not loaded.
+ * @param prompt_text The input prompt to be sent to the Llama model.
+ * @param llama_generation_params Parameters controlling the generation behavior of the model.
+ * @param callback A function to be called with each generated token.
+ * @return true if the generation completed, false on error.
  */
-std::string CoreAIService::transcribe_audio_pcm(const std::vector<float> &pcm_f32_data, const HegemonikonWhisperGenerationParams &whisper_model_params_)
+bool CoreAIService::stream_prompt(const std::string &prompt_text,
+                                  const HegemonikonGenerationParams &llama_generation_params,
+                                  llama_token_callback callback)
+{
+    return stream_prompt(prompt_text, llama_generation_params, std::move(callback), nullptr);
+}
+
+/**
+ * @brief Streams a prompt whose generation can be interrupted through a request handle.
+ *
+ * @param prompt_text The input prompt to be sent to the Llama model.
+ * @param llama_generation_params Parameters controlling the generation behavior of the model.
+ * @param callback A function to be called with each generated token.
+ * @param handle The control block of the request, may be null.
+ * @return true if the generation completed or was interrupted after producing text, false otherwise.
+ */
+bool CoreAIService::stream_prompt(const std::string &prompt_text,
+                                  const HegemonikonGenerationParams &llama_generation_params,
+                                  llama_token_callback callback,
+                                  std::shared_ptr<LlamaRequestHandle> handle)
+{
+    std::string error;
+    return stream_prompt(prompt_text, llama_generation_params, std::move(callback), std::move(handle), error);
+}
+
+/**
+ * @brief Streams a prompt and reports why it failed, if it did.
+ *
+ * Errors never go through `callback`, which may already have received part of the
+ * answer: they are returned in `error`, the same "[Error: ...]" text process_prompt returns.
+ *
+ * @param prompt_text The input prompt to be sent to the Llama model.
+ * @param llama_generation_params Parameters controlling the generation behavior of the model.
+ * @param callback A function to be called with each generated token.
+ * @param handle The control block of the request, may be null.
+ * @param error Set to the error message when the function returns false, cleared otherwise.
+ * @return true if the generation completed or was interrupted after producing text, false otherwise.
+ */
+bool CoreAIService::stream_prompt(const std::string &prompt_text,
+                                  const HegemonikonGenerationParams &llama_generation_params,
+                                  llama_token_callback callback,
+                                  std::shared_ptr<LlamaRequestHandle> handle,
+                                  std::string &error)
 {
-    if (is_whisper_model_loaded())
+    error.clear();
+    if (!callback)
+    {
+        error = "[Error: No callback given]";
+        return false;
+    }
+    std::shared_ptr<LlamaInterface> llama = get_active_llama_interface();
+    if (!llama)
+    {
+        error = "[Error: Llama model not loaded]";
+        return false;
+    }
+
+    HegemonikonGenerationResult result;
+    if (std::shared_ptr<LlamaContextPool> pool = get_llama_context_pool(llama))
     {
-        return whisper_interface_->transcribe_pcm(pcm_f32_data, whisper_model_params_);
+        LlamaContextLease lease = pool->acquire(llama_generation_params.session_id);
+        result = lease->run_generation(prompt_text, llama_generation_params, callback, std::move(handle));
     }
     else
     {
-        return "[Error: Whisper model not loaded]";
+        result = llama->run_generation(prompt_text, llama_generation_params, callback, std::move(handle));
+    }
+    if (!result.success)
+    {
+        error = result.text;
+        return false;
     }
+    return true;
 }
 
 /**
- * @brief Converts an audio file to 16kHz mono 32-bit floating point PCM data.
+ * @brief Queues a prompt on the continuous-batching scheduler.
+ *
+ * The scheduler is started on first use. Concurrent submissions are decoded together in
+ * multi-sequence batches, which raises aggregate throughput compared to process_prompt,
+ * where requests run one after the other.
  *
- * This function uses the miniaudio library to decode the specified audio file,
- * resampling and converting it to a single channel (mono) with a sample rate of 16,000 Hz
- * and 32-bit floating point samples. The resulting PCM data is returned as a std::vector<float>.
+ * @param prompt_text The input prompt text to be processed by the Llama model.
+ * @param llama_generation_params The parameters to control the generation behavior of the Llama model.
+ * @param on_piece Optional callback receiving each generated piece on the scheduler thread.
+ * @param handle Optional control block to cancel or time-limit the request.
+ * @return A future resolved with the generation result.
+ */
+std::future<HegemonikonGenerationResult> CoreAIService::submit_prompt(const std::string &prompt_text,
+                                                                      const HegemonikonGenerationParams &llama_generation_params,
+                                                                      llama_token_callback on_piece,
+                                                                      std::shared_ptr<LlamaRequestHandle> handle)
+{
+    std::shared_ptr<LlamaInterface> llama = get_active_llama_interface();
+    if (!llama)
+    {
+        std::promise<HegemonikonGenerationResult> promise;
+        HegemonikonGenerationResult result;
+        result.text = "[Error: Llama model not loaded]";
+        promise.set_value(result);
+        return promise.get_future();
+    }
+
+    std::lock_guard<std::mutex> lock(llama_scheduler_mutex_);
+    if (!llama_scheduler_ || llama_scheduler_model_ != llama)
+    {
+        if (llama_scheduler_)
+        {
+            llama_scheduler_->drain();
+        }
+        llama_scheduler_ = std::make_unique<LlamaBatchScheduler>(*llama);
+        llama_scheduler_model_ = llama;
+    }
+    return llama_scheduler_->submit(prompt_text, llama_generation_params, std::move(on_piece), std::move(handle));
+}
+
+/**
+ * @brief Runs a prompt through the batching scheduler and waits for its result.
  *
- * @param audio_file_path The path to the audio file to be converted.
- * @return std::vector<float> The decoded PCM data in 16kHz mono F32 format.
- *         Returns an empty vector if decoding fails or the file has zero length.
+ * Intended to be called from several threads at once; see submit_prompt. The `priority`
+ * of the parameters decides how the request is queued against the other callers.
  *
- * @note Supported audio formats depend on the miniaudio build configuration.
- * @note Error messages are printed to std::cerr on failure.
+ * @param prompt_text The input prompt text to be processed by the Llama model.
+ * @param llama_generation_params The parameters to control the generation behavior of the Llama model.
+ * @param handle Optional control block to cancel or time-limit the request.
+ * @return HegemonikonGenerationResult The completion along with its timings.
  */
-std::vector<float> CoreAIService::convert_audio_file_to_pcm_f32(const std::string &audio_file_path)
+HegemonikonGenerationResult CoreAIService::process_prompt_batched(const std::string &prompt_text,
+                                                                  const HegemonikonGenerationParams &llama_generation_params,
+                                                                  std::shared_ptr<LlamaRequestHandle> handle)
 {
-    ma_result result;
-    ma_decoder_config config = ma_decoder_config_init(ma_format_f32, 1, 16000); // Target: f32, 1 channel, 16kHz
-    ma_decoder decoder;
+    return submit_prompt(prompt_text, llama_generation_params, nullptr, std::move(handle)).get();
+}
 
-    result = ma_decoder_init_file(audio_file_path.c_str(), &config, &decoder);
-    if (result != MA_SUCCESS)
+/**
+ * @brief Returns the counters of the batching scheduler.
+ *
+ * @return HegemonikonSchedulerStats The statistics, all zero if the scheduler never ran.
+ */
+HegemonikonSchedulerStats CoreAIService::get_llama_scheduler_stats() const
+{
+    std::lock_guard<std::mutex> lock(llama_scheduler_mutex_);
+    if (llama_scheduler_)
     {
-        std::cerr << "Failed to initialize audio decoder for: " << audio_file_path << " Error: " << ma_result_description(result) << std::endl;
-        return {};
+        return llama_scheduler_->get_stats();
     }
+    return {};
+}
+
+/**
+ * @brief Stops the batching scheduler, failing the requests it still holds.
+ */
+void CoreAIService::stop_llama_scheduler()
+{
+    std::lock_guard<std::mutex> lock(llama_scheduler_mutex_);
+    llama_scheduler_.reset();
+    llama_scheduler_model_.reset();
+}
 
-    ma_uint64 total_frames;
-    result = ma_decoder_get_length_in_pcm_frames(&decoder, &total_frames);
-    if (result != MA_SUCCESS)
+/**
+ * @brief Lets the batching scheduler finish its requests, then stops it.
+ */
+void CoreAIService::drain_llama_scheduler()
+{
+    std::lock_guard<std::mutex> lock(llama_scheduler_mutex_);
+    if (llama_scheduler_)
     {
-        std::cerr << "Failed to get audio length for: " << audio_file_path << " Error: " << ma_result_description(result) << std::endl;
-        ma_decoder_uninit(&decoder);
-        return {};
+        llama_scheduler_->drain();
     }
+    llama_scheduler_.reset();
+    llama_scheduler_model_.reset();
+}
 
-    if (total_frames == 0)
+/**
+ * @brief Sets how many contexts process_prompt and stream_prompt spread requests over.
+ *
+ * With more than one context, the active model gets additional llama contexts that share
+ * its weights, each with its own KV cache, and concurrent direct requests run in parallel
+ * instead of waiting for each other. Requests of a session go to the context holding its
+ * cached history. The contexts are created on the next request and rebuilt whenever the
+ * active model changes. The batching scheduler keeps using the model's own context.
+ *
+ * @param n_contexts Total number of contexts per model; 1 disables the pool.
+ * @param n_ctx Context size of the additional contexts, 0 to use the model's n_ctx.
+ */
+void CoreAIService::configure_llama_context_pool(size_t n_contexts, int32_t n_ctx)
+{
+    std::shared_ptr<LlamaContextPool> previous;
     {
-        std::cerr << "Audio file has zero length: " << audio_file_path << std::endl;
-        ma_decoder_uninit(&decoder);
-        return {};
+        std::lock_guard<std::mutex> lock(llama_context_pool_mutex_);
+        llama_context_pool_size_ = n_contexts > 0 ? n_contexts : 1;
+        llama_context_pool_n_ctx_ = n_ctx;
+        previous = std::move(llama_context_pool_);
     }
+}
 
-    std::vector<float> pcm_data(total_frames);
-    ma_uint64 frames_read;
+/**
+ * @brief Returns the occupancy counters of the context pool.
+ *
+ * @return HegemonikonContextPoolStats The statistics, all zero if no pool is in use.
+ */
+HegemonikonContextPoolStats CoreAIService::get_llama_context_pool_stats() const
+{
+    std::lock_guard<std::mutex> lock(llama_context_pool_mutex_);
+    if (llama_context_pool_)
+    {
+        return llama_context_pool_->get_stats();
+    }
+    return {};
+}
 
-    result = ma_decoder_read_pcm_frames(&decoder, pcm_data.data(), total_frames, &frames_read);
-    if (result != MA_SUCCESS || frames_read != total_frames)
+/**
+ * @brief Drops the context pool; its contexts are freed once their last lease ends.
+ */
+void CoreAIService::stop_llama_context_pool()
+{
+    std::shared_ptr<LlamaContextPool> previous;
     {
-        std::cerr << "Failed to read PCM frames for: " << audio_file_path << " Read " << frames_read << "/" << total_frames << ". Error: " << ma_result_description(result) << std::endl;
-        ma_decoder_uninit(&decoder);
-        return {};
+        std::lock_guard<std::mutex> lock(llama_context_pool_mutex_);
+        previous = std::move(llama_context_pool_);
     }
+}
 
-    ma_decoder_uninit(&decoder);
-    std::cout << "Successfully decoded and converted " << audio_file_path << " to 16kHz mono F32 PCM." << std::endl;
-    return pcm_data;
+/**
+ * @brief Returns the context pool of a model, creating it on first use.
+ *
+ * @param llama The active model.
+ * @return The pool, or null if the pool is disabled or no additional context fits.
+ */
+std::shared_ptr<LlamaContextPool> CoreAIService::get_llama_context_pool(const std::shared_ptr<LlamaInterface> &llama)
+{
+    std::shared_ptr<LlamaContextPool> previous;
+    std::lock_guard<std::mutex> lock(llama_context_pool_mutex_);
+    if (llama_context_pool_size_ <= 1)
+    {
+        return nullptr;
+    }
+    if (!llama_context_pool_ || llama_context_pool_->primary() != llama)
+    {
+        previous = std::move(llama_context_pool_);
+        llama_context_pool_ = std::make_shared<LlamaContextPool>(llama, llama_context_pool_size_, llama_context_pool_n_ctx_);
+    }
+    return llama_context_pool_->size() > 1 ? llama_context_pool_ : nullptr;
 }
 
 /**
- * @brief Transcribes an audio file to text using the specified Whisper model parameters.
+ * @brief Loads a Llama model into the registry without making it active.
  *
- * This function loads an audio file from the given file path, converts it to
- * 32-bit floating point PCM data, and then transcribes the audio using the
- * provided Whisper model parameters.
+ * Used to warm a model the user is likely to switch to, so that the later
+ * initialize_llama_model call is immediate.
  *
- * @param audio_file_path The path to the audio file to be transcribed.
- * @param whisper_model_params_ The parameters to configure the Whisper model for transcription.
- * @return The transcribed text as a std::string. Returns an error message if the audio file could not be loaded.
+ * @param params The parameters of the model to load.
+ * @return true if the model is resident.
  */
-std::string CoreAIService::transcribe_audio_file(const std::string &audio_file_path, const HegemonikonWhisperGenerationParams &whisper_model_params_)
+bool CoreAIService::preload_llama_model(const HegemonikonLlamaModelParams &params)
+{
+    std::shared_ptr<LlamaInterface> model = llama_registry_.acquire(resolve_llama_model_params(params));
+    claim_spare_llama_interface(model);
+    return model != nullptr;
+}
+
+/**
+ * @brief Checks whether a Llama model is resident, active or not.
+ */
+bool CoreAIService::is_llama_model_resident(const HegemonikonLlamaModelParams &params) const
+{
+    return llama_registry_.contains(resolve_llama_model_params(params));
+}
+
+/**
+ * @brief Pins a resident Llama model so that it is never evicted to make room for another.
+ *
+ * @param params The parameters of the model.
+ * @param pinned Whether the model should be pinned.
+ * @return false if the model is not resident.
+ */
+bool CoreAIService::pin_llama_model(const HegemonikonLlamaModelParams &params, bool pinned)
+{
+    return llama_registry_.set_pinned(resolve_llama_model_params(params), pinned);
+}
+
+/**
+ * @brief Unloads a resident Llama model that is neither active nor in use.
+ *
+ * @param params The parameters of the model.
+ * @return true if the model was unloaded.
+ */
+bool CoreAIService::evict_llama_model(const HegemonikonLlamaModelParams &params)
+{
+    return llama_registry_.evict(resolve_llama_model_params(params));
+}
+
+/**
+ * @brief Loads chat models with the parameters tuned for them on this machine.
+ *
+ * initialize_llama_model and the other model methods then look the model up in the
+ * store written by HegemonikonLlamaBenchmarker::tuneModel and, when it was tuned on
+ * this machine, replace the tuned fields of the given parameters (see
+ * LlamaTuningStore::apply). Models without an entry load as requested.
+ *
+ * @param store_path Path of the JSON file of tuned parameters.
+ * @return true if the store is enabled; a missing file is accepted and read once a
+ *         tuning run writes it.
+ */
+bool CoreAIService::enable_tuned_llama_params(const std::string &store_path)
+{
+    if (store_path.empty())
+    {
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+        {
+            std::cerr << "CoreAIService Error: empty tuning store path" << std::endl;
+        }
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(llama_tuning_store_mutex_);
+    llama_tuning_store_ = std::make_shared<LlamaTuningStore>(store_path);
+    return true;
+}
+
+/**
+ * @brief Loads chat models with the parameters they are given again.
+ */
+void CoreAIService::disable_tuned_llama_params()
+{
+    std::lock_guard<std::mutex> lock(llama_tuning_store_mutex_);
+    llama_tuning_store_.reset();
+}
+
+/**
+ * @brief Returns the parameters a chat model is loaded with.
+ *
+ * These are the given parameters with the tuned fields applied when
+ * enable_tuned_llama_params() is on and the model was tuned on this machine; embedding
+ * and vocabulary-only models are never tuned.
+ */
+HegemonikonLlamaModelParams CoreAIService::resolve_llama_model_params(const HegemonikonLlamaModelParams &params) const
+{
+    std::shared_ptr<LlamaTuningStore> store;
+    {
+        std::lock_guard<std::mutex> lock(llama_tuning_store_mutex_);
+        store = llama_tuning_store_;
+    }
+    HegemonikonTunedLlamaParams tuned;
+    if (!store || params.embeddings || params.vocab_only || !store->lookup(params.model_path, tuned))
+    {
+        return params;
+    }
+    if (HegemonikonLog::enabled(HegemonikonLogLevel::Info))
+    {
+        std::cerr << "CoreAIService: using the " << tuned.objective << " tuning of " << params.model_path << std::endl;
+    }
+    return LlamaTuningStore::apply(params, tuned.params);
+}
+
+/**
+ * @brief Sets the memory budget shared by the resident Llama models.
+ *
+ * @param ram_budget_bytes  Host memory budget in bytes, 0 for unlimited.
+ * @param vram_budget_bytes Device memory budget in bytes, 0 for unlimited.
+ */
+void CoreAIService::set_llama_memory_budget(uint64_t ram_budget_bytes, uint64_t vram_budget_bytes)
+{
+    llama_registry_.set_budget(ram_budget_bytes, vram_budget_bytes);
+}
+
+/**
+ * @brief Returns the counters and memory accounting of the Llama model registry.
+ */
+HegemonikonModelRegistryStats CoreAIService::get_llama_registry_stats() const
+{
+    return llama_registry_.get_stats();
+}
+
+/**
+ * @brief Sets the threads an engine is guaranteed while llama and whisper run together.
+ *
+ * The compute pool is shared by the whole process, so the quota applies to every service.
+ *
+ * @param engine    The engine.
+ * @param n_threads The quota, 0 to restore the default.
+ */
+void CoreAIService::set_compute_quota(ComputeEngine engine, int32_t n_threads)
+{
+    compute_pool_->set_quota(engine, n_threads);
+}
+
+/**
+ * @brief Enables core pinning and restricts inference to one NUMA node.
+ *
+ * @param pin_threads Whether to pin inference threads to cores.
+ * @param numa_node   NUMA node to run on, -1 for all of them.
+ */
+void CoreAIService::configure_compute_pool(bool pin_threads, int32_t numa_node)
+{
+    compute_pool_->configure(pin_threads, numa_node);
+}
+
+/**
+ * @brief Returns the quotas and lease counters of the compute pool.
+ */
+HegemonikonComputePoolStats CoreAIService::get_compute_pool_stats() const
+{
+    return compute_pool_->get_stats();
+}
+
+/**
+ * @brief Returns the cores the compute pool schedules on.
+ */
+HegemonikonCpuTopology CoreAIService::get_cpu_topology() const
+{
+    return compute_pool_->get_topology();
+}
+
+/**
+ * @brief Returns the latency histograms and counters of the models of this service.
+ *
+ * Covers every generation and transcription since the service was created or
+ * reset_metrics() was called, whichever path ran it (direct calls, streams, the batching
+ * scheduler or the context pool).
+ */
+HegemonikonMetricsSnapshot CoreAIService::get_metrics() const
+{
+    return metrics_->snapshot();
+}
+
+/**
+ * @brief Renders the metrics of this service in the Prometheus text exposition format.
+ */
+std::string CoreAIService::export_metrics_prometheus() const
+{
+    return metrics_->to_prometheus();
+}
+
+/**
+ * @brief Zeroes the metrics of this service.
+ */
+void CoreAIService::reset_metrics()
+{
+    metrics_->reset();
+}
+
+/**
+ * @brief Starts recording trace spans of every service in the process.
+ *
+ * Spans cover the decode steps, batch composition and sampling of the LLM, the encode
+ * and decode phases of whisper, audio decoding and key derivation. Tracing is off by
+ * default and costs a relaxed atomic load per span while off.
+ *
+ * @param events_per_thread Spans kept per thread before the oldest are overwritten.
+ */
+void CoreAIService::start_trace(size_t events_per_thread)
+{
+    TraceRecorder::instance().start(events_per_thread);
+}
+
+/**
+ * @brief Stops recording trace spans; the recorded spans can still be written.
+ */
+void CoreAIService::stop_trace()
+{
+    TraceRecorder::instance().stop();
+}
+
+/**
+ * @brief Writes the spans recorded since the last start_trace() as Chrome trace JSON.
+ *
+ * The file opens in chrome://tracing and in the Perfetto UI.
+ *
+ * @return true if the file was written.
+ */
+bool CoreAIService::write_trace(const std::string &path)
+{
+    return TraceRecorder::instance().write_chrome_trace(path);
+}
+
+HegemonikonTraceStats CoreAIService::get_trace_stats()
+{
+    return TraceRecorder::instance().get_stats();
+}
+
+/**
+ * @brief Sets the verbosity of the console messages of the native core and its backends.
+ */
+void CoreAIService::set_log_level(HegemonikonLogLevel level)
+{
+    HegemonikonLog::set_level(level);
+}
+
+HegemonikonLogLevel CoreAIService::get_log_level()
+{
+    return HegemonikonLog::level();
+}
+
+/**
+ * @brief Drops the KV cache kept for a chat session.
+ *
+ * The next prompt sent with this session id is prefilled from scratch. Should be
+ * called when a conversation is deleted or its history is rewritten.
+ *
+ * @param session_id The session identifier used in HegemonikonGenerationParams.
+ * @return true if the session was resident and has been released, false otherwise.
+ */
+bool CoreAIService::reset_llama_session(const std::string &session_id)
+{
+    std::shared_ptr<LlamaInterface> llama = get_active_llama_interface();
+    if (!llama)
+    {
+        return false;
+    }
+    if (std::shared_ptr<LlamaContextPool> pool = get_llama_context_pool(llama))
+    {
+        bool reset = false;
+        for (const auto &context : pool->contexts())
+        {
+            reset = context->reset_session(session_id) || reset;
+        }
+        return reset;
+    }
+    return llama->reset_session(session_id);
+}
+
+/**
+ * @brief Drops the KV cache of every chat session.
+ */
+void CoreAIService::clear_llama_sessions()
+{
+    std::shared_ptr<LlamaInterface> llama = get_active_llama_interface();
+    if (!llama)
+    {
+        return;
+    }
+    if (std::shared_ptr<LlamaContextPool> pool = get_llama_context_pool(llama))
+    {
+        for (const auto &context : pool->contexts())
+        {
+            context->clear_sessions();
+        }
+        return;
+    }
+    llama->clear_sessions();
+}
+
+/**
+ * @brief Saves the KV cache of a chat session to disk.
+ *
+ * Meant to be called when a conversation goes idle or before the app exits, so the
+ * conversation can be resumed after a restart without prefilling its history again.
+ * With a context pool, the snapshot is taken from the context holding the session.
+ *
+ * @param session_id The session identifier used in HegemonikonGenerationParams.
+ * @param directory  Directory of the snapshots, next to the chat database.
+ * @param key        Optional vault key; the snapshot is then encrypted and authenticated.
+ * @return true if the snapshot was written.
+ */
+bool CoreAIService::save_llama_session(const std::string &session_id, const std::string &directory,
+                                       const SecureKey *key)
+{
+    std::shared_ptr<LlamaInterface> llama = get_active_llama_interface();
+    if (!llama)
+    {
+        return false;
+    }
+    if (std::shared_ptr<LlamaContextPool> pool = get_llama_context_pool(llama))
+    {
+        for (const auto &context : pool->contexts())
+        {
+            if (context->has_session(session_id))
+            {
+                return context->save_session_snapshot(session_id, directory, key);
+            }
+        }
+        return false;
+    }
+    return llama->save_session_snapshot(session_id, directory, key);
+}
+
+/**
+ * @brief Loads the best saved KV cache for a conversation about to be resumed.
+ *
+ * With a context pool, the snapshot is loaded into the context the pool leases for the
+ * session, so the next request of the conversation lands where its history is.
+ *
+ * @param prompt_text             The prompt of the next request of the conversation.
+ * @param llama_generation_params The generation parameters of that request; `session_id` must be set.
+ * @param directory               Directory of the snapshots.
+ * @param key                     The key the snapshots were saved with, or nullptr.
+ * @return int32_t Number of prompt tokens restored, 0 if no snapshot applied.
+ */
+int32_t CoreAIService::restore_llama_session(const std::string &prompt_text,
+                                             const HegemonikonGenerationParams &llama_generation_params,
+                                             const std::string &directory, const SecureKey *key)
+{
+    std::shared_ptr<LlamaInterface> llama = get_active_llama_interface();
+    if (!llama)
+    {
+        return 0;
+    }
+    if (std::shared_ptr<LlamaContextPool> pool = get_llama_context_pool(llama))
+    {
+        LlamaContextLease lease = pool->acquire(llama_generation_params.session_id);
+        return lease->restore_session_snapshot(prompt_text, llama_generation_params, directory, key);
+    }
+    return llama->restore_session_snapshot(prompt_text, llama_generation_params, directory, key);
+}
+
+/**
+ * @brief Returns the prefix cache counters of the loaded Llama model.
+ *
+ * @return HegemonikonPrefixCacheStats The statistics, all zero if no model is loaded.
+ */
+HegemonikonPrefixCacheStats CoreAIService::get_llama_prefix_cache_stats() const
+{
+    if (std::shared_ptr<LlamaInterface> llama = get_active_llama_interface())
+    {
+        return llama->get_prefix_cache_stats();
+    }
+    return {};
+}
+
+/**
+ * @brief Drops every cached prompt prefix of the loaded Llama model.
+ */
+void CoreAIService::clear_llama_prefix_cache()
+{
+    if (std::shared_ptr<LlamaInterface> llama = get_active_llama_interface())
+    {
+        llama->clear_prefix_cache();
+    }
+}
+
+/**
+ * @brief Returns the speculative decoding counters of the loaded Llama model.
+ *
+ * @return HegemonikonSpeculativeStats The counters, all zero without a draft model.
+ */
+HegemonikonSpeculativeStats CoreAIService::get_llama_speculative_stats() const
+{
+    if (std::shared_ptr<LlamaInterface> llama = get_active_llama_interface())
+    {
+        return llama->get_speculative_stats();
+    }
+    return {};
+}
+
+/**
+ * @brief Starts a streaming generation that is consumed by pulling pieces.
+ *
+ * The generation runs stream_prompt on a background thread; the returned stream yields
+ * the pieces in order and cancels the generation when destroyed. A failure is reported
+ * by its succeeded() and error(), never as a piece. The stream owns the
+ * request handle, so cancelling it also interrupts a prefill or decode in progress.
+ *
+ * @param prompt_text The input prompt to be sent to the Llama model.
+ * @param llama_generation_params Parameters controlling the generation behavior of the model.
+ * @return std::unique_ptr<LlamaTokenStream> The stream of generated pieces.
+ */
+std::unique_ptr<LlamaTokenStream> CoreAIService::open_prompt_stream(const std::string &prompt_text,
+                                                                    const HegemonikonGenerationParams &llama_generation_params)
+{
+    auto handle = std::make_shared<LlamaRequestHandle>();
+    return std::make_unique<LlamaTokenStream>(
+        [this, prompt_text, llama_generation_params, handle](const llama_token_callback &callback, std::string &error)
+        {
+            return stream_prompt(prompt_text, llama_generation_params, callback, handle, error);
+        },
+        handle);
+}
+
+/**
+ * @brief Checks if the Whisper model is currently loaded.
+ *
+ * This method returns true if the Whisper interface exists and the model has been successfully loaded.
+ * Otherwise, it returns false.
+ *
+ * @return true if the Whisper model is loaded; false otherwise.
+ */
+bool CoreAIService::is_whisper_model_loaded() const
+{
+    std::lock_guard<std::mutex> lock(whisper_interface_mutex_);
+    if (whisper_interface_)
+    {
+        return whisper_model_loaded_;
+    }
+    return false;
+}
+
+/**
+ * @brief Unloads the currently loaded Whisper model, if any.
+ *
+ * This function checks if a Whisper model interface exists. If so, it calls
+ * the unload_model() method to release any resources associated with the model,
+ * and then resets the interface pointer to ensure proper cleanup. A model loaded with
+ * HegemonikonWhisperModelParams::keep_resident is parked instead, loaded and warm, for
+ * the next initialize_whisper_model with the same parameters; it replaces the model
+ * parked before, if any. The destructor goes through here too.
+ */
+void CoreAIService::unload_whisper_model()
+{
+    std::shared_ptr<WhisperInterface> replaced;
+    std::lock_guard<std::mutex> lock(whisper_interface_mutex_);
+    if (whisper_interface_)
+    {
+        if (whisper_model_loaded_ && whisper_interface_->is_model_loaded() &&
+            whisper_interface_->model_params().keep_resident)
+        {
+            std::lock_guard<std::mutex> resident_lock(resident_whisper_mutex);
+            replaced = std::move(resident_whisper);
+            resident_whisper = std::move(whisper_interface_);
+        }
+        else
+        {
+            whisper_interface_->unload_model();
+        }
+        whisper_interface_.reset();
+        whisper_model_loaded_ = false;
+    }
+}
+
+/**
+ * @brief Frees the Whisper model parked by a service with keep_resident, if any.
+ */
+void CoreAIService::release_resident_whisper_model()
+{
+    std::shared_ptr<WhisperInterface> released;
+    {
+        std::lock_guard<std::mutex> lock(resident_whisper_mutex);
+        released = std::move(resident_whisper);
+    }
+    if (released)
+    {
+        released->unload_model();
+    }
+}
+
+/**
+ * @brief Warms the Whisper states up for transcriptions with the given parameters.
+ *
+ * See WhisperInterface::warm_up; typically called once after initialize_whisper_model
+ * with the parameters of voice commands, so that their decoders are allocated upfront.
+ *
+ * @param whisper_transcription_params The parameters of the transcriptions to come.
+ * @return true if the model is loaded and every state ran.
+ */
+bool CoreAIService::warm_up_whisper_model(const HegemonikonWhisperGenerationParams &whisper_transcription_params)
+{
+    if (std::shared_ptr<WhisperInterface> whisper = get_loaded_whisper_interface())
+    {
+        return whisper->warm_up(whisper_transcription_params);
+    }
+    return false;
+}
+
+/**
+ * @brief Transcribes audio data in PCM float32 format using the loaded Whisper model.
+ *
+ * This function takes a vector of 32-bit floating point PCM audio samples and transcribes
+ * them into text using the Whisper model, if it is loaded. If the model is not loaded,
+ * an error message is returned.
+ *
+ * @param pcm_f32_data A vector containing the PCM audio data as float values.
+ * @param whisper_model_params_ Parameters to configure the Whisper model's transcription behavior.
+ * @return std::string The transcribed text if successful, or an error message if the model is not loaded.
+ */
+std::string CoreAIService::transcribe_audio_pcm(const std::vector<float> &pcm_f32_data, const HegemonikonWhisperGenerationParams &whisper_model_params_)
+{
+    if (std::shared_ptr<WhisperInterface> whisper = get_loaded_whisper_interface())
+    {
+        return whisper->transcribe_pcm(pcm_f32_data, whisper_model_params_);
+    }
+    else
+    {
+        return "[Error: Whisper model not loaded]";
+    }
+}
+
+/**
+ * @brief Transcribes PCM audio read in place from a caller-owned buffer.
+ *
+ * Lets the bindings hand over the memory of a NumPy array without copying it. Calls from
+ * several threads are serialized by the Whisper interface, whose context transcribes one
+ * buffer at a time.
+ *
+ * @param pcm_f32_data 16 kHz mono samples; must stay valid for the duration of the call.
+ * @param n_samples Number of samples.
+ * @param whisper_model_params_ Parameters to configure the Whisper model's transcription behavior.
+ * @return std::string The transcribed text if successful, or an error message if the model is not loaded.
+ */
+std::string CoreAIService::transcribe_audio_pcm(const float *pcm_f32_data, size_t n_samples,
+                                                const HegemonikonWhisperGenerationParams &whisper_model_params_)
+{
+    if (std::shared_ptr<WhisperInterface> whisper = get_loaded_whisper_interface())
+    {
+        return whisper->transcribe_pcm(pcm_f32_data, n_samples, whisper_model_params_);
+    }
+    return "[Error: Whisper model not loaded]";
+}
+
+/**
+ * @brief Transcribes an audio file to text using the specified Whisper model parameters.
+ *
+ * The file is decoded to 16 kHz mono PCM while it is transcribed, one 30 s window at a
+ * time (see WhisperInterface::transcribe_stream), so memory use stays flat however long
+ * the recording is, and files whose length is not known upfront are supported.
+ *
+ * @param audio_file_path The path to the audio file to be transcribed.
+ * @param whisper_model_params_ The parameters to configure the Whisper model for transcription.
+ * @return The transcribed text as a std::string. Returns an error message if the audio file could not be decoded.
+ */
+std::string CoreAIService::transcribe_audio_file(const std::string &audio_file_path, const HegemonikonWhisperGenerationParams &whisper_model_params_)
+{
+    return WhisperInterface::format_transcription(whisper_model_params_, transcribe_audio_file_segments(audio_file_path, whisper_model_params_));
+}
+
+/**
+ * @brief Transcribes PCM audio into segments, read in place from a caller-owned buffer.
+ *
+ * @param pcm_f32_data 16 kHz mono samples; must stay valid for the duration of the call.
+ * @param n_samples Number of samples.
+ * @param whisper_model_params_ Parameters to configure the Whisper model's transcription behavior.
+ * @return The segments, or an error if the model is not loaded or the transcription failed.
+ */
+HegemonikonTranscription CoreAIService::transcribe_audio_pcm_segments(const float *pcm_f32_data, size_t n_samples,
+                                                                      const HegemonikonWhisperGenerationParams &whisper_model_params_)
+{
+    if (std::shared_ptr<WhisperInterface> whisper = get_loaded_whisper_interface())
+    {
+        return whisper->transcribe_pcm_segments(pcm_f32_data, n_samples, whisper_model_params_);
+    }
+    HegemonikonTranscription transcription;
+    transcription.error = "[Error: Whisper model not loaded]";
+    return transcription;
+}
+
+/**
+ * @brief Transcribes an audio file into segments, decoding it while it is transcribed.
+ *
+ * @param audio_file_path The path to the audio file to be transcribed.
+ * @param whisper_model_params_ The parameters to configure the Whisper model for transcription.
+ * @return The segments, with times from the start of the file, or an error if the file
+ *         could not be decoded, the model is not loaded or the transcription failed.
+ */
+HegemonikonTranscription CoreAIService::transcribe_audio_file_segments(const std::string &audio_file_path,
+                                                                       const HegemonikonWhisperGenerationParams &whisper_model_params_)
+{
+    HegemonikonTranscription transcription;
+    AudioFileDecoder decoder;
+    if (!decoder.open(audio_file_path))
+    {
+        transcription.error = "[Error: Failed to load audio file]";
+        return transcription;
+    }
+
+    std::shared_ptr<WhisperInterface> whisper = get_loaded_whisper_interface();
+    if (!whisper)
+    {
+        transcription.error = "[Error: Whisper model not loaded]";
+        return transcription;
+    }
+    std::string cache_key;
+    if (lookup_cached_transcription(audio_file_path, whisper->model_params(), whisper_model_params_, cache_key, transcription))
+    {
+        return transcription;
+    }
+    transcription = whisper->transcribe_stream_segments([&decoder](float *buffer, size_t max_samples)
+                                                        { return decoder.read(buffer, max_samples); },
+                                                        whisper_model_params_);
+    if (decoder.failed() || decoder.samples_read() == 0)
+    {
+        transcription.segments.clear();
+        transcription.error = "[Error: Failed to load audio file]";
+    }
+    if (!cache_key.empty())
+    {
+        transcription_cache_.store(cache_key, transcription);
+    }
+    return transcription;
+}
+
+/**
+ * @brief Transcribes many audio files, decoding the next files while whisper runs.
+ *
+ * See AudioBatchTranscriber: decoder threads prefetch and resample upcoming files into
+ * bounded queues that the whisper workers consume, so decoding and inference overlap.
+ * Per-file failures are reported in the results; they do not stop the batch. With the
+ * transcription cache enabled, cached files are reported first, without being decoded.
+ *
+ * @param audio_file_paths The files to transcribe.
+ * @param whisper_transcription_params The parameters used for every file.
+ * @param on_result Optional, called with each result as soon as its file is done.
+ * @param n_decoders Number of decoder threads, i.e. files decoded ahead.
+ * @param n_workers Number of files transcribed at once.
+ * @return The results in the order of `audio_file_paths`; every result carries an error
+ *         if no Whisper model is loaded.
+ */
+std::vector<HegemonikonTranscriptionResult> CoreAIService::transcribe_batch(const std::vector<std::string> &audio_file_paths,
+                                                                            const HegemonikonWhisperGenerationParams &whisper_transcription_params,
+                                                                            const transcription_result_callback_t &on_result,
+                                                                            size_t n_decoders, size_t n_workers)
+{
+    std::shared_ptr<WhisperInterface> whisper = get_loaded_whisper_interface();
+    if (!whisper)
+    {
+        std::vector<HegemonikonTranscriptionResult> results(audio_file_paths.size());
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            results[i].index = i;
+            results[i].path = audio_file_paths[i];
+            results[i].error = "[Error: Whisper model not loaded]";
+            if (on_result)
+            {
+                on_result(results[i]);
+            }
+        }
+        return results;
+    }
+
+    // Serve the cached files first, then transcribe the others as a smaller batch whose
+    // indices map back to `audio_file_paths`.
+    std::vector<HegemonikonTranscriptionResult> results(audio_file_paths.size());
+    std::vector<std::string> pending_paths;
+    std::vector<size_t> pending_indices;
+    std::vector<std::string> pending_keys;
+    const HegemonikonWhisperModelParams model_params = whisper->model_params();
+    for (size_t i = 0; i < audio_file_paths.size(); ++i)
+    {
+        std::string cache_key;
+        HegemonikonTranscription transcription;
+        if (!lookup_cached_transcription(audio_file_paths[i], model_params, whisper_transcription_params, cache_key, transcription))
+        {
+            pending_paths.push_back(audio_file_paths[i]);
+            pending_indices.push_back(i);
+            pending_keys.push_back(std::move(cache_key));
+            continue;
+        }
+        HegemonikonTranscriptionResult &result = results[i];
+        result.index = i;
+        result.path = audio_file_paths[i];
+        result.text = transcription.text();
+        result.segments = std::move(transcription.segments);
+        result.audio_seconds = static_cast<double>(transcription.audio_ms) / 1000.0;
+        if (on_result)
+        {
+            on_result(result);
+        }
+    }
+    if (pending_paths.empty())
+    {
+        return results;
+    }
+
+    AudioBatchTranscriber transcriber(std::move(whisper), n_decoders, n_workers);
+    std::vector<HegemonikonTranscriptionResult> transcribed = transcriber.run(
+        pending_paths, whisper_transcription_params,
+        [&](const HegemonikonTranscriptionResult &pending)
+        {
+            HegemonikonTranscriptionResult result = pending;
+            result.index = pending_indices[pending.index];
+            if (result.ok() && !pending_keys[pending.index].empty())
+            {
+                HegemonikonTranscription transcription;
+                transcription.segments = result.segments;
+                transcription.audio_ms = static_cast<int64_t>(result.audio_seconds * 1000.0);
+                transcription_cache_.store(pending_keys[pending.index], transcription);
+            }
+            if (on_result)
+            {
+                on_result(result);
+            }
+        });
+    for (HegemonikonTranscriptionResult &result : transcribed)
+    {
+        const size_t index = pending_indices[result.index];
+        result.index = index;
+        results[index] = std::move(result);
+    }
+    return results;
+}
+
+/**
+ * @brief Transcribes an audio file and runs a generation over its text, overlapping both.
+ *
+ * The prompt is `prompt_prefix`, the transcript, then `prompt_suffix`, e.g. a system
+ * prompt, the recording and the summarization instruction. While whisper transcribes,
+ * each window of segments is appended to the KV cache of the request's session by a
+ * TranscriptPrefiller, so that once the transcription ends only the suffix (and a few
+ * tokens held back at the end of the transcript) remain to be prefilled. Without a
+ * session id the request uses a scratch session, dropped once it is done. With a context
+ * pool, one context is leased for the whole call.
+ *
+ * @param audio_file_path The audio file to transcribe.
+ * @param whisper_transcription_params Parameters of the transcription.
+ * @param prompt_prefix Text of the prompt before the transcript.
+ * @param prompt_suffix Text of the prompt after the transcript.
+ * @param llama_generation_params Parameters of the generation.
+ * @param on_piece Optional, receives the generated pieces as they are decoded.
+ * @return The transcription and the generation; the generation carries the error of the
+ *         transcription when it failed.
+ */
+HegemonikonAudioPromptResult CoreAIService::transcribe_and_generate(const std::string &audio_file_path,
+                                                                    const HegemonikonWhisperGenerationParams &whisper_transcription_params,
+                                                                    const std::string &prompt_prefix,
+                                                                    const std::string &prompt_suffix,
+                                                                    const HegemonikonGenerationParams &llama_generation_params,
+                                                                    llama_token_callback on_piece)
+{
+    const auto start = std::chrono::steady_clock::now();
+    auto elapsed_ms = [&start]()
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    HegemonikonAudioPromptResult result;
+    result.generation.finish_reason = "error";
+    std::shared_ptr<LlamaInterface> llama = get_active_llama_interface();
+    if (!llama)
+    {
+        result.generation.text = "[Error: Llama model not loaded]";
+        return result;
+    }
+    std::shared_ptr<WhisperInterface> whisper = get_loaded_whisper_interface();
+    if (!whisper)
+    {
+        result.transcription.error = "[Error: Whisper model not loaded]";
+        result.generation.text = result.transcription.error;
+        return result;
+    }
+
+    HegemonikonGenerationParams params = llama_generation_params;
+    const bool scratch_session = params.session_id.empty();
+    if (scratch_session)
+    {
+        params.session_id = std::string(1, '\x01') + "audio_prompt_" + std::to_string(++audio_prompt_counter_);
+    }
+    LlamaContextLease lease;
+    if (std::shared_ptr<LlamaContextPool> pool = get_llama_context_pool(llama))
+    {
+        lease = pool->acquire(params.session_id);
+    }
+    LlamaInterface *target = lease ? lease.get() : llama.get();
+
+    std::string cache_key;
+    if (!lookup_cached_transcription(audio_file_path, whisper->model_params(), whisper_transcription_params,
+                                     cache_key, result.transcription))
+    {
+        AudioFileDecoder decoder;
+        if (!decoder.open(audio_file_path))
+        {
+            result.transcription.error = "[Error: Failed to load audio file]";
+        }
+        else
+        {
+            TranscriptPrefiller prefiller(target, prompt_prefix, params);
+            result.transcription = whisper->transcribe_stream_segments([&decoder](float *buffer, size_t max_samples)
+                                                                       { return decoder.read(buffer, max_samples); },
+                                                                       whisper_transcription_params,
+                                                                       [&prefiller](const HegemonikonWhisperSegment &segment)
+                                                                       { prefiller.append(segment.text); });
+            prefiller.finish();
+            result.prefilled_tokens = prefiller.prefilled_tokens();
+            if (decoder.failed() || decoder.samples_read() == 0)
+            {
+                result.transcription.segments.clear();
+                result.transcription.error = "[Error: Failed to load audio file]";
+            }
+            if (!cache_key.empty())
+            {
+                transcription_cache_.store(cache_key, result.transcription);
+            }
+        }
+    }
+    result.transcribe_ms = elapsed_ms();
+
+    if (result.transcription.ok())
+    {
+        result.generation = target->run_generation(prompt_prefix + result.transcription.text() + prompt_suffix,
+                                                   params, std::move(on_piece));
+    }
+    else
+    {
+        result.generation.text = result.transcription.error;
+    }
+    if (scratch_session)
+    {
+        target->reset_session(params.session_id);
+    }
+    result.total_ms = elapsed_ms();
+    return result;
+}
+
+/**
+ * @brief Looks up the transcription of a file in the transcription cache.
+ *
+ * @param audio_file_path The audio file, hashed by content.
+ * @param model_params Parameters of the loaded Whisper model.
+ * @param whisper_transcription_params Parameters of the transcription.
+ * @param key Set to the cache key of the file, or left empty if the cache is disabled or
+ *        the file cannot be read; store the transcription under it on a miss.
+ * @param transcription Set to the cached transcription on a hit.
+ * @return true on a hit.
+ */
+bool CoreAIService::lookup_cached_transcription(const std::string &audio_file_path,
+                                                const HegemonikonWhisperModelParams &model_params,
+                                                const HegemonikonWhisperGenerationParams &whisper_transcription_params,
+                                                std::string &key, HegemonikonTranscription &transcription)
+{
+    key.clear();
+    if (!transcription_cache_.is_open())
+    {
+        return false;
+    }
+    std::string digest;
+    std::string error;
+    if (!TranscriptionCache::hash_file(audio_file_path, digest, error))
+    {
+        return false;
+    }
+    key = TranscriptionCache::make_key(digest, model_params, whisper_transcription_params);
+    return transcription_cache_.lookup(key, transcription);
+}
+
+/**
+ * @brief Caches file transcriptions on disk, keyed by audio content and parameters.
+ *
+ * transcribe_audio_file, transcribe_audio_file_segments and transcribe_batch then hash
+ * each file and return its cached segments when the same content was already transcribed
+ * with the same model and parameters, so re-indexing unchanged files skips whisper. The
+ * entries persist across runs in `directory`; the least recently used are removed beyond
+ * `max_bytes`.
+ *
+ * @param directory Directory of the cache, created if missing.
+ * @param max_bytes Maximum size of the cache on disk.
+ * @return true if the cache is enabled.
+ */
+bool CoreAIService::enable_transcription_cache(const std::string &directory, uint64_t max_bytes)
+{
+    std::string error;
+    if (!transcription_cache_.open(directory, max_bytes, error))
+    {
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+        {
+            std::cerr << "CoreAIService Error: " << error << std::endl;
+        }
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Stops using the transcription cache; its files are kept.
+ */
+void CoreAIService::disable_transcription_cache()
+{
+    transcription_cache_.close();
+}
+
+/**
+ * @brief Removes every entry of the transcription cache.
+ *
+ * @return The number of entries removed.
+ */
+size_t CoreAIService::clear_transcription_cache()
+{
+    return transcription_cache_.clear();
+}
+
+HegemonikonTranscriptionCacheStats CoreAIService::get_transcription_cache_stats() const
+{
+    return transcription_cache_.get_stats();
+}
+
+/**
+ * @brief Returns the Whisper interface if its model is loaded, null otherwise.
+ *
+ * Callers keep the interface alive for the duration of their call, so unloading the model
+ * never frees it under a transcription in progress.
+ */
+std::shared_ptr<WhisperInterface> CoreAIService::get_loaded_whisper_interface() const
+{
+    std::lock_guard<std::mutex> lock(whisper_interface_mutex_);
+    if (whisper_interface_ && whisper_model_loaded_)
+    {
+        return whisper_interface_;
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Opens a live transcription session on the loaded Whisper model.
+ *
+ * Audio pushed to the session, or captured with start_capture, is transcribed every
+ * `step_ms` on overlapping windows, and segments are reported as they are recognized;
+ * see WhisperStreamSession. The session keeps working on the model it was opened on and
+ * ends with an error if that model is unloaded.
+ *
+ * @param whisper_transcription_params The window sizes and transcription parameters.
+ * @param on_segment Receives the partial and final segments, on the session's thread.
+ * @return The session, or null if no Whisper model is loaded.
+ */
+std::unique_ptr<WhisperStreamSession> CoreAIService::open_transcription_stream(const HegemonikonWhisperGenerationParams &whisper_transcription_params,
+                                                                               whisper_segment_callback_t on_segment)
 {
-    std::vector<float> pcm_f32_data;
-    pcm_f32_data = convert_audio_file_to_pcm_f32(audio_file_path);
-    if (pcm_f32_data.empty())
+    std::shared_ptr<WhisperInterface> whisper = get_loaded_whisper_interface();
+    if (!whisper)
     {
-        return "[Error: Failed to load audio file]";
+        return nullptr;
     }
-    return transcribe_audio_pcm(pcm_f32_data, whisper_model_params_);
+    return std::make_unique<WhisperStreamSession>(std::move(whisper), whisper_transcription_params, std::move(on_segment));
 }
 
 /**
@@ -345,13 +1731,14 @@ std::string CoreAIService::transcribe_audio_file(const std::string &audio_file_p
  *
  * This function is responsible for setting up and initializing any global
  * backend dependencies needed for the AI service to function correctly.
- * Currently, it initializes the Llama backend interface.
+ * It initializes the Llama backend and routes the whisper.cpp logs through the log level.
  *
  * Should be called during the startup phase before using any backend-dependent features.
  */
 void CoreAIService::initialize_global_backends()
 {
     LlamaInterface::init_backend();
+    WhisperInterface::init_backend();
 }
 
 /**
@@ -359,9 +1746,11 @@ void CoreAIService::initialize_global_backends()
  *
  * This function calls the static method LlamaInterface::free_backend()
  * to release any resources or memory held by the global backend.
- * It should be invoked during shutdown or cleanup to prevent resource leaks.
+ * It should be invoked during shutdown or cleanup to prevent resource leaks. The resident
+ * Whisper model, if any, is freed first.
  */
 void CoreAIService::free_global_backends()
 {
+    release_resident_whisper_model();
     LlamaInterface::free_backend();
 }
\ No newline at end of file
@@ -0,0 +1,498 @@
+#include "llama_batch_scheduler.hh"
+#include "hegemonikon_log.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+/**
+ * @brief Constructs the scheduler and starts its worker thread.
+ *
+ * @param llama_interface The interface whose context is shared by all requests.
+ * @param max_active      Maximum number of concurrently decoding sequences, 0 to use the
+ *                        size of the interface's sequence pool.
+ */
+LlamaBatchScheduler::LlamaBatchScheduler(LlamaInterface &llama_interface, uint32_t max_active)
+    : llama_interface_(llama_interface),
+      max_active_(max_active > 0 ? max_active : std::max(1u, llama_interface.get_max_sequences()))
+{
+    worker_ = std::thread(&LlamaBatchScheduler::run, this);
+}
+
+/**
+ * @brief Stops the worker thread, failing any request that has not completed.
+ */
+LlamaBatchScheduler::~LlamaBatchScheduler()
+{
+    stop();
+}
+
+/**
+ * @brief Queues a generation request.
+ *
+ * @param prompt_text The input prompt.
+ * @param params      The generation parameters; requests sharing a session_id are run one at a time,
+ *                    and `priority` selects the queue the request waits in.
+ * @param on_piece    Optional callback invoked from the worker thread with each generated piece.
+ * @param handle      Optional control block; a request cancelled while queued is resolved
+ *                    without ever being admitted.
+ * @return A future resolved with the result once the sequence finishes.
+ */
+std::future<HegemonikonGenerationResult> LlamaBatchScheduler::submit(const std::string &prompt_text,
+                                                                     const HegemonikonGenerationParams &params,
+                                                                     llama_token_callback on_piece,
+                                                                     std::shared_ptr<LlamaRequestHandle> handle)
+{
+    PendingRequest request;
+    request.prompt_text = prompt_text;
+    request.params = params;
+    request.on_piece = std::move(on_piece);
+    request.handle = std::move(handle);
+    request.submitted_at = clock::now();
+    std::future<HegemonikonGenerationResult> future = request.promise.get_future();
+
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        if (!running_.load() || draining_.load())
+        {
+            HegemonikonGenerationResult result;
+            result.text = "[Error: Scheduler stopped]";
+            request.promise.set_value(result);
+            return future;
+        }
+        queues_[static_cast<size_t>(params.priority)].push_back(std::move(request));
+    }
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        stats_.requests_submitted++;
+    }
+    queue_cv_.notify_one();
+    return future;
+}
+
+/**
+ * @brief Stops the worker thread.
+ *
+ * In-flight and queued requests are resolved with an error result.
+ */
+void LlamaBatchScheduler::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        if (!running_.exchange(false) && !worker_.joinable())
+        {
+            return;
+        }
+    }
+    queue_cv_.notify_all();
+    if (worker_.joinable())
+    {
+        worker_.join();
+    }
+}
+
+/**
+ * @brief Stops accepting requests and returns once every queued and in-flight request has completed.
+ *
+ * Used when the model behind the scheduler is about to be replaced, so that switching
+ * models never fails requests that were already submitted.
+ */
+void LlamaBatchScheduler::drain()
+{
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        draining_.store(true);
+    }
+    queue_cv_.notify_all();
+    if (worker_.joinable())
+    {
+        worker_.join();
+    }
+    running_.store(false);
+}
+
+/**
+ * @brief Returns a snapshot of the scheduler counters.
+ *
+ * @return HegemonikonSchedulerStats The current statistics.
+ */
+HegemonikonSchedulerStats LlamaBatchScheduler::get_stats() const
+{
+    HegemonikonSchedulerStats stats;
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        stats = stats_;
+        for (size_t p = 0; p < LLAMA_REQUEST_PRIORITY_COUNT; ++p)
+        {
+            const WaitSamples &waits = wait_samples_[p];
+            HegemonikonPriorityClassStats &class_stats = stats.for_priority(static_cast<LlamaRequestPriority>(p));
+            class_stats.queue_wait_ms_max = waits.max_ms;
+            if (waits.samples.empty())
+            {
+                continue;
+            }
+            std::vector<double> sorted = waits.samples;
+            std::sort(sorted.begin(), sorted.end());
+            double total = 0.0;
+            for (double wait_ms : sorted)
+            {
+                total += wait_ms;
+            }
+            class_stats.queue_wait_ms_avg = total / sorted.size();
+            class_stats.queue_wait_ms_p95 = sorted[std::min(sorted.size() - 1, sorted.size() * 95 / 100)];
+        }
+    }
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    stats.queued_requests = 0;
+    for (size_t p = 0; p < LLAMA_REQUEST_PRIORITY_COUNT; ++p)
+    {
+        stats.for_priority(static_cast<LlamaRequestPriority>(p)).queued_requests = static_cast<uint32_t>(queues_[p].size());
+        stats.queued_requests += static_cast<uint32_t>(queues_[p].size());
+    }
+    return stats;
+}
+
+/**
+ * @brief Whether no request is waiting in any class; the queue mutex must be held.
+ */
+bool LlamaBatchScheduler::queues_empty_locked() const
+{
+    for (const auto &queue : queues_)
+    {
+        if (!queue.empty())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Records how long an admitted request waited in its queue, in the scheduler
+ *        stats and in the metrics of the interface.
+ */
+void LlamaBatchScheduler::record_wait(LlamaRequestPriority priority, double wait_ms)
+{
+    if (const std::shared_ptr<MetricsRegistry> metrics = llama_interface_.get_metrics())
+    {
+        metrics->record_ms(MetricPhase::QueueWait, wait_ms);
+    }
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    stats_.for_priority(priority).requests_admitted++;
+    WaitSamples &waits = wait_samples_[static_cast<size_t>(priority)];
+    if (waits.samples.size() < HegemonikonPriorityClassStats::WAIT_SAMPLES)
+    {
+        waits.samples.push_back(wait_ms);
+    }
+    else
+    {
+        waits.samples[waits.next] = wait_ms;
+        waits.next = (waits.next + 1) % HegemonikonPriorityClassStats::WAIT_SAMPLES;
+    }
+    waits.max_ms = std::max(waits.max_ms, wait_ms);
+}
+
+/**
+ * @brief Moves queued requests into the active set while sequences are available.
+ *
+ * Classes are served in priority order; within a class, parked sequences resume before
+ * queued requests are admitted. A request that finds every sequence taken preempts a
+ * running background sequence of lower priority, if there is one. A request whose
+ * session already has an active sequence stays queued, which keeps turns of one
+ * conversation ordered. Requests cancelled or timed out while waiting are dropped from
+ * the queue with an error result instead of being admitted.
+ */
+void LlamaBatchScheduler::admit_pending()
+{
+    struct Admission
+    {
+        PendingRequest request;
+        ActiveRequest *victim;
+    };
+    std::vector<Admission> admitted;
+    std::vector<PendingRequest> abandoned;
+    std::vector<ActiveRequest *> resumed;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        size_t n_running = 0;
+        std::vector<ActiveRequest *> preemptible;
+        for (auto &active : active_)
+        {
+            if (active.sequence->parked)
+                continue;
+            ++n_running;
+            if (!active.sequence->finished && active.sequence->params.priority == LlamaRequestPriority::Background)
+                preemptible.push_back(&active);
+        }
+        // The most recently admitted sequence has the least work to lose.
+        std::sort(preemptible.begin(), preemptible.end(), [](const ActiveRequest *a, const ActiveRequest *b)
+                  { return a->admission > b->admission; });
+
+        auto session_busy = [&](const std::string &session_id)
+        {
+            if (session_id.empty())
+                return false;
+            for (const auto &active : active_)
+                if (active.sequence->params.session_id == session_id)
+                    return true;
+            for (const auto &admission : admitted)
+                if (admission.request.params.session_id == session_id)
+                    return true;
+            return false;
+        };
+
+        for (size_t p = 0; p < LLAMA_REQUEST_PRIORITY_COUNT; ++p)
+        {
+            for (auto &active : active_)
+            {
+                if (active.sequence->parked && static_cast<size_t>(active.sequence->params.priority) == p &&
+                    n_running < max_active_)
+                {
+                    resumed.push_back(&active);
+                    ++n_running;
+                }
+            }
+
+            auto &queue = queues_[p];
+            for (auto it = queue.begin(); it != queue.end();)
+            {
+                const LlamaInterruptReason reason = it->handle ? it->handle->check(0) : LlamaInterruptReason::None;
+                if (reason != LlamaInterruptReason::None)
+                {
+                    abandoned.push_back(std::move(*it));
+                    it = queue.erase(it);
+                    continue;
+                }
+                if (session_busy(it->params.session_id))
+                {
+                    ++it;
+                    continue;
+                }
+
+                ActiveRequest *victim = nullptr;
+                if (n_running >= max_active_)
+                {
+                    auto candidate = std::find_if(preemptible.begin(), preemptible.end(), [p](const ActiveRequest *active)
+                                                  { return static_cast<size_t>(active->sequence->params.priority) > p; });
+                    if (candidate == preemptible.end())
+                    {
+                        ++it;
+                        continue;
+                    }
+                    victim = *candidate;
+                    preemptible.erase(candidate);
+                    --n_running;
+                }
+                admitted.push_back({std::move(*it), victim});
+                it = queue.erase(it);
+                ++n_running;
+            }
+        }
+    }
+
+    for (auto &request : abandoned)
+    {
+        HegemonikonGenerationResult result;
+        const bool cancelled = request.handle->is_cancelled();
+        result.text = cancelled ? "[Error: Generation cancelled]" : "[Error: Deadline exceeded]";
+        result.finish_reason = cancelled ? "cancelled" : "deadline";
+        {
+            std::lock_guard<std::mutex> lock(stats_mutex_);
+            stats_.requests_completed++;
+        }
+        request.promise.set_value(result);
+    }
+
+    for (ActiveRequest *active : resumed)
+    {
+        if (llama_interface_.resume_sequence(*active->sequence))
+        {
+            std::lock_guard<std::mutex> lock(stats_mutex_);
+            stats_.resumptions++;
+        }
+    }
+
+    // Victims are parked before any request is started, as that may grow active_.
+    std::vector<PendingRequest> starting;
+    for (auto &admission : admitted)
+    {
+        if (admission.victim)
+        {
+            if (!llama_interface_.park_sequence(*admission.victim->sequence))
+            {
+                std::lock_guard<std::mutex> lock(queue_mutex_);
+                queues_[static_cast<size_t>(admission.request.params.priority)].push_front(std::move(admission.request));
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(stats_mutex_);
+            stats_.preemptions++;
+            stats_.for_priority(admission.victim->sequence->params.priority).preemptions++;
+        }
+        starting.push_back(std::move(admission.request));
+    }
+
+    const clock::time_point now = clock::now();
+    for (auto &request : starting)
+    {
+        record_wait(request.params.priority, std::chrono::duration<double, std::milli>(now - request.submitted_at).count());
+        ActiveRequest active;
+        active.sequence = llama_interface_.start_sequence(request.prompt_text, request.params, std::move(request.on_piece),
+                                                          std::move(request.handle));
+        active.promise = std::move(request.promise);
+        active.admission = ++admission_counter_;
+        active_.push_back(std::move(active));
+    }
+}
+
+/**
+ * @brief Finishes the parked and held-back sequences whose handle asks for it.
+ */
+void LlamaBatchScheduler::poll_held(const std::vector<LlamaGenerationSequence *> &held)
+{
+    for (LlamaGenerationSequence *seq : held)
+    {
+        if (seq->handle)
+        {
+            llama_interface_.poll_interrupt(*seq);
+        }
+    }
+}
+
+/**
+ * @brief Resolves and removes every finished sequence from the active set.
+ */
+void LlamaBatchScheduler::retire_finished()
+{
+    auto it = std::partition(active_.begin(), active_.end(), [](const ActiveRequest &active)
+                             { return !active.sequence->finished; });
+
+    for (auto done = it; done != active_.end(); ++done)
+    {
+        {
+            std::lock_guard<std::mutex> lock(stats_mutex_);
+            stats_.requests_completed++;
+            stats_.tokens_generated += done->sequence->result.tokens_generated;
+        }
+        done->promise.set_value(done->sequence->result);
+    }
+    active_.erase(it, active_.end());
+}
+
+/**
+ * @brief Worker loop: admit, decode one batched step, retire.
+ */
+void LlamaBatchScheduler::run()
+{
+    std::vector<LlamaGenerationSequence *> sequences;
+    std::vector<LlamaGenerationSequence *> held;
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            queue_cv_.wait(lock, [this]()
+                           { return !running_.load() || draining_.load() || !queues_empty_locked() || !active_.empty(); });
+            if (!running_.load() || (draining_.load() && queues_empty_locked() && active_.empty()))
+            {
+                break;
+            }
+        }
+
+        admit_pending();
+        retire_finished();
+
+        if (active_.empty())
+        {
+            continue;
+        }
+
+        bool interactive_running = false;
+        for (const auto &active : active_)
+        {
+            interactive_running = interactive_running ||
+                                  (!active.sequence->parked && !active.sequence->finished &&
+                                   active.sequence->params.priority == LlamaRequestPriority::Interactive);
+        }
+
+        sequences.clear();
+        held.clear();
+        for (auto &active : active_)
+        {
+            LlamaGenerationSequence *seq = active.sequence.get();
+            if (seq->parked || (interactive_running && seq->params.priority == LlamaRequestPriority::Background))
+                held.push_back(seq);
+            else
+                sequences.push_back(seq);
+        }
+        poll_held(held);
+        {
+            std::lock_guard<std::mutex> lock(stats_mutex_);
+            stats_.parked_sequences = static_cast<uint32_t>(std::count_if(held.begin(), held.end(), [](const LlamaGenerationSequence *seq)
+                                                                          { return seq->parked && !seq->finished; }));
+        }
+
+        if (sequences.empty())
+        {
+            // Only parked sequences that cannot resume yet are left; wait for a change.
+            retire_finished();
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            queue_cv_.wait_for(lock, std::chrono::milliseconds(10));
+            continue;
+        }
+
+        auto step_start = std::chrono::high_resolution_clock::now();
+        int32_t n_decoded = 0;
+        try
+        {
+            n_decoded = llama_interface_.decode_step(sequences);
+        }
+        catch (const std::exception &e)
+        {
+            if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+            {
+                std::cerr << "LlamaBatchScheduler Error: decode step failed: " << e.what() << std::endl;
+            }
+            for (auto *seq : sequences)
+            {
+                seq->result.text = "[Error: " + std::string(e.what()) + "]";
+                llama_interface_.finish_sequence(*seq);
+            }
+        }
+        auto step_end = std::chrono::high_resolution_clock::now();
+
+        {
+            std::lock_guard<std::mutex> lock(stats_mutex_);
+            stats_.decode_steps++;
+            stats_.tokens_decoded += static_cast<uint64_t>(std::max(0, n_decoded));
+            stats_.busy_time_ms += std::chrono::duration<double, std::milli>(step_end - step_start).count();
+        }
+
+        retire_finished();
+
+        {
+            std::lock_guard<std::mutex> lock(stats_mutex_);
+            stats_.active_sequences = static_cast<uint32_t>(active_.size());
+        }
+    }
+
+    for (auto &active : active_)
+    {
+        active.sequence->result.text = "[Error: Scheduler stopped]";
+        llama_interface_.finish_sequence(*active.sequence);
+        active.sequence->result.success = false;
+        active.promise.set_value(active.sequence->result);
+    }
+    active_.clear();
+
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    for (auto &queue : queues_)
+    {
+        for (auto &request : queue)
+        {
+            HegemonikonGenerationResult result;
+            result.text = "[Error: Scheduler stopped]";
+            request.promise.set_value(result);
+        }
+        queue.clear();
+    }
+}
@@ -0,0 +1,243 @@
+#include "llama_context_pool.hh"
+#include "hegemonikon_log.hh"
+
+#include <iostream>
+#include <limits>
+
+namespace
+{
+    constexpr size_t NO_CONTEXT = std::numeric_limits<size_t>::max();
+}
+
+LlamaContextLease::LlamaContextLease(LlamaContextLease &&other) noexcept
+    : pool_(other.pool_), interface_(std::move(other.interface_)), index_(other.index_)
+{
+    other.pool_ = nullptr;
+}
+
+LlamaContextLease &LlamaContextLease::operator=(LlamaContextLease &&other) noexcept
+{
+    if (this != &other)
+    {
+        release();
+        pool_ = other.pool_;
+        interface_ = std::move(other.interface_);
+        index_ = other.index_;
+        other.pool_ = nullptr;
+    }
+    return *this;
+}
+
+LlamaContextLease::~LlamaContextLease()
+{
+    release();
+}
+
+/**
+ * @brief Returns the context to the pool before the lease goes out of scope.
+ */
+void LlamaContextLease::release()
+{
+    if (pool_)
+    {
+        pool_->give_back(index_);
+    }
+    pool_ = nullptr;
+    interface_.reset();
+}
+
+/**
+ * @brief Builds the pool over the model of a loaded interface.
+ *
+ * Contexts that cannot be created (typically because the KV cache does not fit in memory)
+ * are skipped with a warning, so the pool may end up smaller than requested.
+ *
+ * @param primary    The loaded interface whose model the contexts share; it is context 0.
+ * @param n_contexts Total number of contexts, the primary included.
+ * @param n_ctx      Context size of the additional contexts, 0 to use the primary's.
+ */
+LlamaContextPool::LlamaContextPool(std::shared_ptr<LlamaInterface> primary, size_t n_contexts, int32_t n_ctx)
+    : primary_(std::move(primary)), n_ctx_(n_ctx)
+{
+    if (!primary_ || !primary_->is_model_loaded())
+    {
+        return;
+    }
+    metrics_ = primary_->get_metrics();
+    entries_.push_back({primary_, false});
+    for (size_t i = 1; i < n_contexts; ++i)
+    {
+        auto context = std::make_shared<LlamaInterface>();
+        context->set_compute_pool(primary_->get_compute_pool());
+        context->set_metrics(primary_->get_metrics());
+        if (!context->share_model(*primary_, n_ctx_))
+        {
+            if (HegemonikonLog::enabled(HegemonikonLogLevel::Warning))
+            {
+                std::cerr << "LlamaContextPool Warning: created " << entries_.size() << " of "
+                          << n_contexts << " contexts" << std::endl;
+            }
+            break;
+        }
+        entries_.push_back({std::move(context), false});
+    }
+    stats_.n_contexts = static_cast<uint32_t>(entries_.size());
+    stats_.n_ctx = static_cast<uint32_t>(n_ctx_ > 0 ? n_ctx_ : primary_->get_context_size());
+}
+
+/**
+ * @brief Waits for the outstanding leases, then releases the additional contexts.
+ */
+LlamaContextPool::~LlamaContextPool()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    released_.wait(lock, [this]()
+                   { return stats_.contexts_leased == 0; });
+}
+
+/**
+ * @brief Leases a context, waiting until one is free.
+ *
+ * @param session_id Session of the request; the context holding its KV cache is preferred,
+ *                   and waited for if it is busy.
+ * @return The lease; empty only if the pool has no context.
+ */
+LlamaContextLease LlamaContextPool::acquire(const std::string &session_id)
+{
+    if (entries_.empty())
+    {
+        return {};
+    }
+    const size_t owner = find_session(session_id);
+    std::unique_lock<std::mutex> lock(mutex_);
+    size_t index = 0;
+    double wait_ms = 0.0;
+    if (!pick_locked(owner, index))
+    {
+        const auto wait_start = std::chrono::steady_clock::now();
+        released_.wait(lock, [&]()
+                       { return pick_locked(owner, index); });
+        wait_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - wait_start).count();
+        ++stats_.waits;
+        stats_.wait_time_ms += wait_ms;
+    }
+    if (metrics_)
+    {
+        metrics_->record_ms(MetricPhase::QueueWait, wait_ms);
+    }
+    return lease_locked(index, owner);
+}
+
+/**
+ * @brief Leases a context if one is free right away.
+ *
+ * @param session_id Session of the request, see acquire().
+ * @return The lease, or an empty lease if the preferred context or every context is busy.
+ */
+LlamaContextLease LlamaContextPool::try_acquire(const std::string &session_id)
+{
+    if (entries_.empty())
+    {
+        return {};
+    }
+    const size_t owner = find_session(session_id);
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t index = 0;
+    if (!pick_locked(owner, index))
+    {
+        return {};
+    }
+    return lease_locked(index, owner);
+}
+
+size_t LlamaContextPool::size() const
+{
+    return entries_.size();
+}
+
+/**
+ * @brief Returns every context of the pool, leased or not, the primary first.
+ */
+std::vector<std::shared_ptr<LlamaInterface>> LlamaContextPool::contexts() const
+{
+    std::vector<std::shared_ptr<LlamaInterface>> result;
+    result.reserve(entries_.size());
+    for (const Entry &entry : entries_)
+    {
+        result.push_back(entry.interface);
+    }
+    return result;
+}
+
+HegemonikonContextPoolStats LlamaContextPool::get_stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+/**
+ * @brief Finds the context holding the KV cache of a session.
+ *
+ * Runs without the pool mutex: the set of contexts never changes after construction, and
+ * probing a busy context waits for its current decode step.
+ *
+ * @return The index of the context, NO_CONTEXT if none holds the session.
+ */
+size_t LlamaContextPool::find_session(const std::string &session_id) const
+{
+    if (session_id.empty())
+    {
+        return NO_CONTEXT;
+    }
+    for (size_t i = 0; i < entries_.size(); ++i)
+    {
+        if (entries_[i].interface->has_session(session_id))
+        {
+            return i;
+        }
+    }
+    return NO_CONTEXT;
+}
+
+/**
+ * @brief Picks the context to lease: the session's own if any, else the first free one.
+ */
+bool LlamaContextPool::pick_locked(size_t owner, size_t &index) const
+{
+    if (owner != NO_CONTEXT)
+    {
+        index = owner;
+        return !entries_[owner].leased;
+    }
+    for (size_t i = 0; i < entries_.size(); ++i)
+    {
+        if (!entries_[i].leased)
+        {
+            index = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+LlamaContextLease LlamaContextPool::lease_locked(size_t index, size_t owner)
+{
+    entries_[index].leased = true;
+    ++stats_.contexts_leased;
+    ++stats_.leases;
+    if (owner != NO_CONTEXT)
+    {
+        ++stats_.session_hits;
+    }
+    return LlamaContextLease(this, entries_[index].interface, index);
+}
+
+void LlamaContextPool::give_back(size_t index)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_[index].leased = false;
+        --stats_.contexts_leased;
+    }
+    released_.notify_all();
+}
@@ -1,13 +1,27 @@
 #include <atomic>
 #include "llama_interface.hh"
+#include "hegemonikon_log.hh"
+#include "llama_offload_planner.hh"
+#include "memory_locker.hh"
+#include "trace_recorder.hh"
+#include <chrono>
+#include <cmath>
+#include <filesystem>
 #include <stdexcept>
 #include <iostream>
 #include <algorithm>
+#include <limits>
 #include <memory>
 #include <mutex>
 #include <thread>
 #include <llama.h>
 
+#if defined(__linux__) || defined(__FreeBSD__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 static std::once_flag backend_init_flag;
 static std::atomic<bool> backend_initialized{false};
 
@@ -28,12 +42,14 @@ void LlamaInterface::init_backend()
         ggml_backend_load_all();
         llama_backend_init();
         llama_log_set([](enum ggml_log_level level, const char * text, void * /* user_data */) {
-            if (level >= GGML_LOG_LEVEL_ERROR) {
+            if (HegemonikonLog::enabled(level >= GGML_LOG_LEVEL_ERROR ? HegemonikonLogLevel::Error : HegemonikonLogLevel::Debug)) {
                 fprintf(stderr, "%s", text);
             }
         }, nullptr);
         backend_initialized.store(true);
-        std::cerr << "LlamaInterface: Backend initialized." << std::endl; });
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Info)) {
+            std::cerr << "LlamaInterface: Backend initialized." << std::endl;
+        } });
 }
 
 /**
@@ -49,7 +65,10 @@ void LlamaInterface::free_backend()
     {
         llama_backend_free();
         backend_initialized.store(false);
-        std::cerr << "LlamaInterface: Backend freed." << std::endl;
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Info))
+        {
+            std::cerr << "LlamaInterface: Backend freed." << std::endl;
+        }
     }
 }
 
@@ -87,12 +106,36 @@ LlamaInterface::~LlamaInterface()
  * @param other The LlamaInterface instance to move from.
  */
 LlamaInterface::LlamaInterface(LlamaInterface &&other) noexcept
-    : model_(other.model_), ctx_(other.ctx_), vocab_(other.vocab_),
-      current_model_params_(std::move(other.current_model_params_))
+    : model_(other.model_), shared_model_(std::move(other.shared_model_)), ctx_(other.ctx_), vocab_(other.vocab_),
+      draft_model_(other.draft_model_), draft_ctx_(other.draft_ctx_), draft_sampler_(other.draft_sampler_),
+      speculative_stats_(other.speculative_stats_),
+      abort_watch_(std::move(other.abort_watch_)),
+      current_model_params_(std::move(other.current_model_params_)),
+      load_status_(std::move(other.load_status_)),
+      compute_pool_(std::move(other.compute_pool_)),
+      attached_threadpool_(std::move(other.attached_threadpool_)),
+      metrics_(std::move(other.metrics_)),
+      default_n_threads_(other.default_n_threads_),
+      default_n_threads_batch_(other.default_n_threads_batch_),
+      sessions_(std::move(other.sessions_)),
+      free_seq_ids_(std::move(other.free_seq_ids_)),
+      session_clock_(other.session_clock_),
+      stateless_counter_(other.stateless_counter_),
+      prefix_cache_(std::move(other.prefix_cache_)),
+      piece_table_(std::move(other.piece_table_))
 {
     other.model_ = nullptr;
     other.ctx_ = nullptr;
     other.vocab_ = nullptr;
+    other.draft_model_ = nullptr;
+    other.draft_ctx_ = nullptr;
+    other.draft_sampler_ = nullptr;
+    other.sessions_.clear();
+    other.free_seq_ids_.clear();
+    if (ctx_)
+    {
+        llama_set_abort_callback(ctx_, &LlamaInterface::abort_callback, this);
+    }
 }
 
 /**
@@ -111,12 +154,39 @@ LlamaInterface &LlamaInterface::operator=(LlamaInterface &&other) noexcept
     {
         unload_model();
         model_ = other.model_;
+        shared_model_ = std::move(other.shared_model_);
         ctx_ = other.ctx_;
         vocab_ = other.vocab_;
+        draft_model_ = other.draft_model_;
+        draft_ctx_ = other.draft_ctx_;
+        draft_sampler_ = other.draft_sampler_;
+        speculative_stats_ = other.speculative_stats_;
+        abort_watch_ = std::move(other.abort_watch_);
         current_model_params_ = std::move(other.current_model_params_);
+        load_status_ = std::move(other.load_status_);
+        compute_pool_ = std::move(other.compute_pool_);
+        attached_threadpool_ = std::move(other.attached_threadpool_);
+        metrics_ = std::move(other.metrics_);
+        default_n_threads_ = other.default_n_threads_;
+        default_n_threads_batch_ = other.default_n_threads_batch_;
+        sessions_ = std::move(other.sessions_);
+        free_seq_ids_ = std::move(other.free_seq_ids_);
+        session_clock_ = other.session_clock_;
+        stateless_counter_ = other.stateless_counter_;
+        prefix_cache_ = std::move(other.prefix_cache_);
+        piece_table_ = std::move(other.piece_table_);
         other.model_ = nullptr;
         other.ctx_ = nullptr;
         other.vocab_ = nullptr;
+        other.draft_model_ = nullptr;
+        other.draft_ctx_ = nullptr;
+        other.draft_sampler_ = nullptr;
+        other.sessions_.clear();
+        other.free_seq_ids_.clear();
+        if (ctx_)
+        {
+            llama_set_abort_callback(ctx_, &LlamaInterface::abort_callback, this);
+        }
     }
     return *this;
 }
@@ -127,7 +197,8 @@ LlamaInterface &LlamaInterface::operator=(LlamaInterface &&other) noexcept
  * This function attempts to load a Llama model from the file path specified in the given
  * LlamaModelParams. It first unloads any currently loaded model. It validates the input
  * parameters, sets up model and context parameters, and initializes the model and context.
- * If any step fails, it logs an error message and returns false.
+ * A negative n_gpu_layers lets LlamaOffloadPlanner choose the offload from the free device
+ * memory. If any step fails, it logs an error message and returns false.
  *
  * @param params The parameters for loading the model, including model path, context size,
  *               and GPU layer configuration.
@@ -135,475 +206,3263 @@ LlamaInterface &LlamaInterface::operator=(LlamaInterface &&other) noexcept
  */
 bool LlamaInterface::load_model(const HegemonikonLlamaModelParams &params)
 {
+    std::lock_guard<std::mutex> lock(context_mutex_);
     if (model_)
     {
-        unload_model();
+        unload_model_locked();
     }
 
     if (params.model_path.empty())
     {
-        std::cerr << "LlamaInterface Error: model path is empty" << std::endl;
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+        {
+            std::cerr << "LlamaInterface Error: model path is empty" << std::endl;
+        }
+        return false;
+    }
+
+    if (params.n_ctx <= 0)
+    {
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+        {
+            std::cerr << "LlamaInterface Error: invalid context size: " << params.n_ctx << std::endl;
+        }
+        return false;
+    }
+
+    ggml_type type_k = GGML_TYPE_F16;
+    ggml_type type_v = GGML_TYPE_F16;
+    if (!parse_cache_type(params.cache_type_k, type_k) || !parse_cache_type(params.cache_type_v, type_v))
+    {
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+        {
+            std::cerr << "LlamaInterface Error: unsupported KV cache type: " << params.cache_type_k
+                      << "/" << params.cache_type_v << std::endl;
+        }
+        return false;
+    }
+
+    enum llama_pooling_type pooling = LLAMA_POOLING_TYPE_UNSPECIFIED;
+    if (params.embeddings && !parse_pooling_type(params.pooling_type, pooling))
+    {
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+        {
+            std::cerr << "LlamaInterface Error: unsupported pooling type: " << params.pooling_type << std::endl;
+        }
+        return false;
+    }
+
+    enum llama_flash_attn_type flash_attn = LLAMA_FLASH_ATTN_TYPE_AUTO;
+    if (!parse_flash_attn_type(params.flash_attn, flash_attn) ||
+        (flash_attn == LLAMA_FLASH_ATTN_TYPE_DISABLED && ggml_is_quantized(type_v)))
+    {
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+        {
+            std::cerr << "LlamaInterface Error: unsupported flash attention mode: " << params.flash_attn
+                      << " with V cache " << params.cache_type_v << std::endl;
+        }
+        return false;
+    }
+
+    if (params.n_threads < 0 || params.n_threads_batch < 0)
+    {
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+        {
+            std::cerr << "LlamaInterface Error: invalid number of threads: " << params.n_threads
+                      << "/" << params.n_threads_batch << std::endl;
+        }
+        return false;
+    }
+
+    if (params.n_seq_max <= 0 || params.prefix_cache_slots < 0 ||
+        static_cast<size_t>(params.n_seq_max + params.prefix_cache_slots) > llama_max_parallel_sequences())
+    {
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+        {
+            std::cerr << "LlamaInterface Error: invalid number of sequences: " << params.n_seq_max
+                      << " (+" << params.prefix_cache_slots << " prefix cache)" << std::endl;
+        }
         return false;
     }
 
-    if (params.n_ctx <= 0 || params.n_ctx > 32768)
+    if (params.n_batch <= 0 || params.n_ubatch <= 0)
     {
-        std::cerr << "LlamaInterface Error: invalid context size: " << params.n_ctx << std::endl;
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+        {
+            std::cerr << "LlamaInterface Error: invalid batch size: " << params.n_batch
+                      << " (ubatch " << params.n_ubatch << ")" << std::endl;
+        }
         return false;
     }
 
     current_model_params_ = params;
+    if (current_model_params_.n_gpu_layers < 0)
+    {
+        const HegemonikonOffloadPlan plan = LlamaOffloadPlanner::plan(current_model_params_);
+        for (const std::string &reason : plan.reasons)
+        {
+            if (HegemonikonLog::enabled(HegemonikonLogLevel::Info))
+            {
+                std::cerr << "LlamaInterface: offload plan: " << reason << std::endl;
+            }
+        }
+        current_model_params_ = plan.apply(current_model_params_);
+    }
 
     llama_model_params model_p = llama_model_default_params();
     model_p.n_gpu_layers = current_model_params_.n_gpu_layers;
-
-    if (model_p.n_gpu_layers < 0)
+    model_p.main_gpu = current_model_params_.main_gpu;
+    model_p.split_mode = current_model_params_.tensor_split ? LLAMA_SPLIT_MODE_LAYER : LLAMA_SPLIT_MODE_NONE;
+    model_p.use_mmap = current_model_params_.use_map;
+    model_p.use_mlock = current_model_params_.use_mlock;
+    model_p.progress_callback = &LlamaInterface::load_progress_callback;
+    model_p.progress_callback_user_data = this;
+
+    if (load_status_)
     {
-        std::cerr << "LlamaInterface Warning: negative GPU layers, setting to 0" << std::endl;
-        model_p.n_gpu_layers = 0;
+        load_status_->set_state(LlamaLoadState::Loading);
+    }
+    if (model_p.use_mmap)
+    {
+        prefetch_model_file(current_model_params_.model_path);
     }
 
     model_ = llama_model_load_from_file(current_model_params_.model_path.c_str(), model_p);
     if (!model_)
     {
-        std::cerr << "LlamaInterface Error: unable to load model from " << current_model_params_.model_path << std::endl;
+        if (load_status_ && load_status_->is_cancelled())
+        {
+            if (HegemonikonLog::enabled(HegemonikonLogLevel::Info))
+            {
+                std::cerr << "LlamaInterface: loading of " << current_model_params_.model_path << " was cancelled" << std::endl;
+            }
+            return false;
+        }
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+        {
+            std::cerr << "LlamaInterface Error: unable to load model from " << current_model_params_.model_path << std::endl;
+        }
         return false;
     }
 
+    shared_model_.reset(model_, llama_model_free);
+
     vocab_ = llama_model_get_vocab(model_);
     if (!vocab_)
     {
-        std::cerr << "LlamaInterface Error: failed to get vocabulary" << std::endl;
-        llama_model_free(model_);
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+        {
+            std::cerr << "LlamaInterface Error: failed to get vocabulary" << std::endl;
+        }
+        shared_model_.reset();
         model_ = nullptr;
         return false;
     }
 
-    llama_context_params ctx_p = llama_context_default_params();
-    ctx_p.n_ctx = current_model_params_.n_ctx;
-    ctx_p.n_batch = std::min(512, current_model_params_.n_ctx / 4);
-    ctx_p.offload_kqv = true;
-    ctx_p.n_threads = std::max(1u, std::thread::hardware_concurrency() / 2);
-    ctx_p.n_threads_batch = std::max(1u, std::thread::hardware_concurrency());
+    piece_table_ = std::make_unique<LlamaPieceTable>(vocab_);
 
-    ctx_ = llama_init_from_model(model_, ctx_p);
-    if (!ctx_)
+    if (current_model_params_.n_ctx > llama_model_n_ctx_train(model_))
+    {
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Warning))
+        {
+            std::cerr << "LlamaInterface Warning: n_ctx " << current_model_params_.n_ctx
+                      << " exceeds the training context of the model (" << llama_model_n_ctx_train(model_) << ")" << std::endl;
+        }
+    }
+
+    llama_context_params ctx_p;
+    if (!create_context(ctx_p))
     {
-        std::cerr << "LlamaInterface Error: failed to create llama_context" << std::endl;
-        llama_model_free(model_);
+        shared_model_.reset();
         model_ = nullptr;
         vocab_ = nullptr;
+        piece_table_.reset();
         return false;
     }
 
-    std::cerr << "LlamaInterface: Model loaded successfully: " << current_model_params_.model_path
-              << " (ctx: " << ctx_p.n_ctx << ", gpu_layers: " << model_p.n_gpu_layers << ")" << std::endl;
+    if (!current_model_params_.embeddings && !current_model_params_.draft_model_path.empty() && !load_draft_model(ctx_p))
+    {
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Warning))
+        {
+            std::cerr << "LlamaInterface Warning: continuing without speculative decoding" << std::endl;
+        }
+    }
+
+    if (current_model_params_.warmup)
+    {
+        if (load_status_)
+        {
+            load_status_->set_state(LlamaLoadState::WarmingUp);
+        }
+        warm_up();
+    }
+    reset_sequence_pool();
+
+    if (HegemonikonLog::enabled(HegemonikonLogLevel::Info))
+    {
+        std::cerr << "LlamaInterface: Model loaded successfully: " << current_model_params_.model_path
+                  << " (ctx: " << ctx_p.n_ctx << ", batch: " << ctx_p.n_batch << "/" << ctx_p.n_ubatch
+                  << ", gpu_layers: " << model_p.n_gpu_layers << ", kv: " << current_model_params_.cache_type_k
+                  << "/" << current_model_params_.cache_type_v << ")" << std::endl;
+    }
     return true;
 }
 
 /**
- * @brief Unloads the currently loaded Llama model and releases associated resources.
+ * @brief Creates the llama context of the loaded model from the current parameters.
  *
- * This function frees the context and model objects if they are loaded,
- * sets their pointers to nullptr, and resets the vocabulary pointer.
- * It also logs a message indicating that the model has been unloaded.
+ * The thread defaults, KV cache types and embedding settings are derived from
+ * `current_model_params_`, which load_model() and share_model() have validated.
+ *
+ * @param ctx_p Set to the parameters the context was created with.
+ * @return true if the context was created.
  */
-void LlamaInterface::unload_model()
+bool LlamaInterface::create_context(llama_context_params &ctx_p)
 {
-    if (ctx_)
+    ggml_type type_k = GGML_TYPE_F16;
+    ggml_type type_v = GGML_TYPE_F16;
+    enum llama_pooling_type pooling = LLAMA_POOLING_TYPE_UNSPECIFIED;
+    enum llama_flash_attn_type flash_attn = LLAMA_FLASH_ATTN_TYPE_AUTO;
+    parse_cache_type(current_model_params_.cache_type_k, type_k);
+    parse_cache_type(current_model_params_.cache_type_v, type_v);
+    parse_pooling_type(current_model_params_.pooling_type, pooling);
+    parse_flash_attn_type(current_model_params_.flash_attn, flash_attn);
+
+    ctx_p = llama_context_default_params();
+    ctx_p.n_ctx = current_model_params_.n_ctx;
+    ctx_p.n_batch = static_cast<uint32_t>(std::min(current_model_params_.n_batch, current_model_params_.n_ctx));
+    ctx_p.n_ubatch = std::min(ctx_p.n_batch, static_cast<uint32_t>(current_model_params_.n_ubatch));
+    ctx_p.offload_kqv = true;
+    ctx_p.n_threads = current_model_params_.n_threads > 0 ? static_cast<uint32_t>(current_model_params_.n_threads)
+                                                          : std::max(1u, std::thread::hardware_concurrency() / 2);
+    ctx_p.n_threads_batch = current_model_params_.n_threads_batch > 0 ? static_cast<uint32_t>(current_model_params_.n_threads_batch)
+                                                                      : std::max(1u, std::thread::hardware_concurrency());
+    default_n_threads_ = static_cast<int32_t>(ctx_p.n_threads);
+    default_n_threads_batch_ = static_cast<int32_t>(ctx_p.n_threads_batch);
+    ctx_p.n_seq_max = static_cast<uint32_t>(current_model_params_.n_seq_max + current_model_params_.prefix_cache_slots);
+    ctx_p.kv_unified = true;
+    ctx_p.type_k = type_k;
+    ctx_p.type_v = type_v;
+    ctx_p.flash_attn_type = ggml_is_quantized(type_v) ? LLAMA_FLASH_ATTN_TYPE_ENABLED : flash_attn;
+    if (current_model_params_.embeddings)
     {
+        // Encoder models attend over the whole batch at once, so it must fit in one micro-batch.
+        ctx_p.embeddings = true;
+        ctx_p.pooling_type = pooling;
+        ctx_p.n_ubatch = ctx_p.n_batch;
+        ctx_p.n_seq_max = static_cast<uint32_t>(current_model_params_.n_seq_max);
+    }
+
+    ctx_ = llama_init_from_model(model_, ctx_p);
+    if (ctx_ && current_model_params_.embeddings &&
+        (llama_pooling_type(ctx_) == LLAMA_POOLING_TYPE_NONE || llama_pooling_type(ctx_) == LLAMA_POOLING_TYPE_RANK))
+    {
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+        {
+            std::cerr << "LlamaInterface Error: " << current_model_params_.model_path
+                      << " has no sequence pooling; set a pooling type to use it for embeddings" << std::endl;
+        }
         llama_free(ctx_);
         ctx_ = nullptr;
     }
-    if (model_)
+    if (!ctx_)
     {
-        llama_model_free(model_);
-        model_ = nullptr;
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+        {
+            std::cerr << "LlamaInterface Error: failed to create llama_context" << std::endl;
+        }
+        return false;
     }
-    vocab_ = nullptr;
-    std::cerr << "LlamaInterface: Model unloaded." << std::endl;
-}
 
-/**
- * @brief Checks if the Llama model and its required components are loaded.
- *
- * This function verifies that the model, context, and vocabulary pointers are all non-null,
- * indicating that the model and its dependencies have been successfully loaded and initialized.
- *
- * @return true if the model, context, and vocabulary are loaded; false otherwise.
- */
-bool LlamaInterface::is_model_loaded() const
-{
-    return model_ != nullptr && ctx_ != nullptr && vocab_ != nullptr;
+    llama_set_abort_callback(ctx_, &LlamaInterface::abort_callback, this);
+    return true;
 }
 
 /**
- * @brief Tokenizes the given text using the loaded Llama model vocabulary.
+ * @brief Creates a context of its own over the model already loaded by another interface.
  *
- * This function converts the input string into a sequence of llama_token values,
- * optionally adding a beginning-of-sequence (BOS) token and handling special tokens.
- * It first checks if the model is loaded, then estimates the required buffer size
- * for tokenization. If the initial buffer is insufficient, it resizes and retries.
+ * The weights are shared and stay alive until the last interface using them is unloaded;
+ * only the KV cache and compute buffers are allocated, so this is much cheaper than
+ * loading the model again. The new context has its own sessions and prefix cache. The
+ * draft model of the source is not shared, so speculative decoding is disabled.
  *
- * @param text The input string to tokenize.
- * @param add_bos If true, prepends a BOS token to the output.
- * @param special If true, enables special token handling during tokenization.
- * @return std::vector<llama_token> The sequence of tokens representing the input text.
- *         Returns an empty vector if the model is not loaded or tokenization fails.
+ * @param source The interface whose model to use.
+ * @param n_ctx  Context size of the new context, 0 to use the source's.
+ * @return true if the context was created; false otherwise (this interface is left unloaded).
  */
-std::vector<llama_token> LlamaInterface::tokenize(const std::string &text, bool add_bos, bool special) const
+bool LlamaInterface::share_model(const LlamaInterface &source, int32_t n_ctx)
 {
-    if (!is_model_loaded())
-    {
-        std::cerr << "LlamaInterface Error: model not loaded for tokenization" << std::endl;
-        return {};
-    }
-
-    if (text.empty())
+    std::lock_guard<std::mutex> lock(context_mutex_);
+    if (model_)
     {
-        return add_bos ? std::vector<int32_t>{llama_vocab_bos(vocab_)} : std::vector<int32_t>{};
+        unload_model_locked();
     }
-
-    int n_tokens_estimated = static_cast<int>(text.length() * 1.5) + (add_bos ? 1 : 0) + 64;
-    std::vector<llama_token> result(n_tokens_estimated);
-
-    int n_tokens = llama_tokenize(vocab_, text.c_str(), text.length(), result.data(), result.size(), add_bos, special);
-
-    if (n_tokens < 0)
+    if (!source.is_model_loaded() || !source.shared_model_)
     {
-        int required_size = -n_tokens;
-        result.resize(required_size);
-        n_tokens = llama_tokenize(vocab_, text.c_str(), text.length(), result.data(), result.size(), add_bos, special);
-        if (n_tokens < 0)
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
         {
-            std::cerr << "LlamaInterface Error: tokenization failed even after resize" << std::endl;
-            return {};
+            std::cerr << "LlamaInterface Error: cannot share the model of an unloaded interface" << std::endl;
         }
+        return false;
     }
 
-    result.resize(n_tokens);
-    return result;
-}
-
-std::vector<int32_t> LlamaInterface::tokenization(const std::string &text) const
-{
-    if (!is_model_loaded())
+    shared_model_ = source.shared_model_;
+    model_ = source.model_;
+    vocab_ = source.vocab_;
+    current_model_params_ = source.current_model_params_;
+    current_model_params_.draft_model_path.clear();
+    if (n_ctx > 0)
     {
-        std::cerr << "LlamaInterface Error: model not loaded for tokenization" << std::endl;
-        return {};
+        current_model_params_.n_ctx = n_ctx;
     }
+    piece_table_ = std::make_unique<LlamaPieceTable>(vocab_);
 
-    std::vector<int32_t> tokens = tokenize(text, true, false);
-    if (tokens.empty())
+    llama_context_params ctx_p;
+    if (!create_context(ctx_p))
     {
-        std::cerr << "LlamaInterface Error: tokenization failed for text: " << text << std::endl;
-        return {};
+        shared_model_.reset();
+        model_ = nullptr;
+        vocab_ = nullptr;
+        piece_table_.reset();
+        return false;
     }
-
-    return tokens;
+    if (current_model_params_.warmup)
+    {
+        warm_up();
+    }
+    reset_sequence_pool();
+    return true;
 }
 
-std::string LlamaInterface::detokenization(const std::vector<int32_t> &tokens) const
+namespace
 {
-    if (!is_model_loaded())
+    struct LlamaCacheType
     {
-        std::cerr << "LlamaInterface Error: model not loaded for detokenization" << std::endl;
-        return "";
-    }
+        const char *name;
+        ggml_type type;
+        double bytes_per_element;
+    };
+
+    constexpr LlamaCacheType CACHE_TYPES[] = {
+        {"f32", GGML_TYPE_F32, 4.0},
+        {"f16", GGML_TYPE_F16, 2.0},
+        {"bf16", GGML_TYPE_BF16, 2.0},
+        {"q8_0", GGML_TYPE_Q8_0, 34.0 / 32.0},
+        {"q5_1", GGML_TYPE_Q5_1, 24.0 / 32.0},
+        {"q5_0", GGML_TYPE_Q5_0, 22.0 / 32.0},
+        {"q4_1", GGML_TYPE_Q4_1, 20.0 / 32.0},
+        {"q4_0", GGML_TYPE_Q4_0, 18.0 / 32.0},
+        {"iq4_nl", GGML_TYPE_IQ4_NL, 18.0 / 32.0},
+    };
+}
 
-    if (tokens.empty())
+/**
+ * @brief Maps a KV cache type name to its ggml type.
+ *
+ * @param name The type name, e.g. "f16" or "q8_0".
+ * @param type Set to the ggml type when the name is known.
+ * @return true if the name is a supported KV cache type.
+ */
+bool LlamaInterface::parse_cache_type(const std::string &name, ggml_type &type)
+{
+    for (const LlamaCacheType &entry : CACHE_TYPES)
     {
-        return "";
+        if (name == entry.name)
+        {
+            type = entry.type;
+            return true;
+        }
     }
+    return false;
+}
 
-    std::string result;
-    result.reserve(tokens.size() * 4);
+/**
+ * @brief Maps a pooling type name to its llama pooling type.
+ *
+ * Only the pooling types that produce one vector per sequence are accepted.
+ *
+ * @param name "mean", "cls", "last", or an empty string for the pooling of the model.
+ * @param type Set to the llama pooling type when the name is known.
+ * @return true if the name is a supported pooling type.
+ */
+bool LlamaInterface::parse_pooling_type(const std::string &name, enum llama_pooling_type &type)
+{
+    if (name.empty())
+        type = LLAMA_POOLING_TYPE_UNSPECIFIED;
+    else if (name == "mean")
+        type = LLAMA_POOLING_TYPE_MEAN;
+    else if (name == "cls")
+        type = LLAMA_POOLING_TYPE_CLS;
+    else if (name == "last")
+        type = LLAMA_POOLING_TYPE_LAST;
+    else
+        return false;
+    return true;
+}
+
+/**
+ * @brief Maps a flash attention mode name to its llama flash attention type.
+ *
+ * @param name "auto", "on" or "off".
+ * @param type Set to the llama flash attention type when the name is known.
+ * @return true if the name is a supported mode.
+ */
+bool LlamaInterface::parse_flash_attn_type(const std::string &name, enum llama_flash_attn_type &type)
+{
+    if (name == "auto")
+        type = LLAMA_FLASH_ATTN_TYPE_AUTO;
+    else if (name == "on")
+        type = LLAMA_FLASH_ATTN_TYPE_ENABLED;
+    else if (name == "off")
+        type = LLAMA_FLASH_ATTN_TYPE_DISABLED;
+    else
+        return false;
+    return true;
+}
 
-    for (int32_t token : tokens)
+/**
+ * @brief Average storage cost of one KV cache element of a type, block scales included.
+ *
+ * @param name The type name; unknown names count as f16.
+ * @return double Bytes per element.
+ */
+double LlamaInterface::cache_type_bytes(const std::string &name)
+{
+    for (const LlamaCacheType &entry : CACHE_TYPES)
     {
-        std::string piece = detokenize_token(token);
-        if (piece == "[Error]")
+        if (name == entry.name)
         {
-            std::cerr << "LlamaInterface Error: failed to detokenize token " << token << std::endl;
-            return "[Error]";
+            return entry.bytes_per_element;
         }
-        result += piece;
     }
-    return result;
+    return 2.0;
 }
 
 /**
- * @brief Converts a token ID to its corresponding string representation.
+ * @brief Attaches the status an asynchronous load reports progress to.
  *
- * This function takes an integer token ID and returns the detokenized string
- * using the loaded vocabulary. If the model is not loaded, it returns an empty string.
- * If the conversion fails, it logs an error and returns "[Error]".
+ * The status is only used by the next load_model() calls; pass nullptr to detach it.
  *
- * @param token The token ID to be detokenized.
- * @return The string representation of the token, or "[Error]" if conversion fails,
- *         or an empty string if the model is not loaded.
+ * @param status The load status shared with the caller.
  */
-std::string LlamaInterface::detokenize_token(int32_t token) const
+void LlamaInterface::set_load_status(std::shared_ptr<LlamaLoadStatus> status)
 {
-    if (!is_model_loaded())
-    {
-        return "";
-    }
-
-    constexpr size_t buf_size = 256;
-    char buf[buf_size];
-    int n = llama_token_to_piece(vocab_, token, buf, buf_size, 0, true);
+    load_status_ = std::move(status);
+}
 
-    if (n < 0)
+/**
+ * @brief Makes the contexts of this interface run on a shared compute pool.
+ *
+ * Each decode step then takes a lease from the pool and runs on its ggml threadpool with
+ * the number of threads the pool grants, instead of the fixed thread counts of the
+ * context. Pass nullptr to go back to the context's own threads.
+ *
+ * @param pool The compute pool, usually ComputePool::shared().
+ */
+void LlamaInterface::set_compute_pool(std::shared_ptr<ComputePool> pool)
+{
+    std::lock_guard<std::mutex> lock(context_mutex_);
+    compute_pool_ = std::move(pool);
+    if (!compute_pool_ && attached_threadpool_)
     {
-        std::cerr << "LlamaInterface Error: failed to convert token " << token << " to piece" << std::endl;
-        return "[Error]";
+        llama_detach_threadpool(ctx_);
+        if (draft_ctx_)
+        {
+            llama_detach_threadpool(draft_ctx_);
+        }
+        attached_threadpool_.reset();
     }
+}
 
-    return std::string(buf, n);
+std::shared_ptr<ComputePool> LlamaInterface::get_compute_pool() const
+{
+    std::lock_guard<std::mutex> lock(context_mutex_);
+    return compute_pool_;
 }
 
 /**
- * @brief Converts a sequence of token IDs into a string by detokenizing each token.
+ * @brief Sets the registry receiving the timings and counters of the generations.
  *
- * This function takes a vector of integer token IDs and reconstructs the original
- * string by detokenizing each token using the detokenize_token method. If the input
- * vector is empty, an empty string is returned.
+ * Tokenization, prefill and decode steps, sampling, detokenization, time to first token,
+ * inter-token latency and whole generations are recorded. Pass nullptr to stop recording.
  *
- * @param tokens A vector of integer token IDs to be detokenized.
- * @return The detokenized string corresponding to the input token sequence.
+ * @param metrics The registry, usually the one of the owning CoreAIService.
  */
-std::string LlamaInterface::detokenize_sequence(const std::vector<int32_t> &tokens) const
+void LlamaInterface::set_metrics(std::shared_ptr<MetricsRegistry> metrics)
 {
-    if (tokens.empty())
-        return "";
-
-    std::string result;
-    result.reserve(tokens.size() * 4);
+    std::lock_guard<std::mutex> lock(context_mutex_);
+    metrics_ = std::move(metrics);
+}
 
-    for (int32_t token : tokens)
-    {
-        result += detokenize_token(token);
-    }
-    return result;
+std::shared_ptr<MetricsRegistry> LlamaInterface::get_metrics() const
+{
+    std::lock_guard<std::mutex> lock(context_mutex_);
+    return metrics_;
 }
 
 /**
- * @brief Creates and configures a llama_sampler instance based on the provided generation parameters.
+ * @brief Sets the threads of the next decode from the compute pool and the requests.
  *
- * This function initializes a new llama_sampler chain and sequentially adds various sampling strategies
- * to it, such as penalties for repetition, minimum probability threshold, top-k and top-p sampling,
- * temperature scaling, and distribution initialization. The configuration is determined by the values
- * in the provided HegemonikonGenerationParams structure.
+ * The largest positive HegemonikonGenerationParams::n_threads among the active sequences
+ * caps the thread count; without a compute pool it replaces the context defaults.
  *
- * @param params The generation parameters specifying sampler configuration, including penalties,
- *               top-k, top-p, temperature, and other relevant settings.
- * @return A pointer to the configured llama_sampler instance.
+ * @param sequences The sequences taking part in the decode.
+ * @return The lease to hold for the duration of the decode, empty without a compute pool.
  */
-llama_sampler *LlamaInterface::create_sampler(const HegemonikonGenerationParams &params)
+ComputeLease LlamaInterface::acquire_compute_locked(const std::vector<LlamaGenerationSequence *> &sequences)
 {
-    llama_sampler *smpl = llama_sampler_chain_init(llama_sampler_chain_default_params());
+    int32_t requested = 0;
+    for (const LlamaGenerationSequence *seq : sequences)
+    {
+        if (!seq->finished && seq->params.n_threads > 0)
+        {
+            requested = std::max(requested, seq->params.n_threads);
+        }
+    }
+
+    if (!compute_pool_)
+    {
+        const int32_t n_threads = requested > 0 ? requested : default_n_threads_;
+        const int32_t n_threads_batch = requested > 0 ? requested : default_n_threads_batch_;
+        llama_set_n_threads(ctx_, n_threads, n_threads_batch);
+        if (draft_ctx_)
+        {
+            llama_set_n_threads(draft_ctx_, n_threads, n_threads_batch);
+        }
+        return ComputeLease();
+    }
+
+    ComputeLease lease = compute_pool_->acquire(ComputeEngine::Llama, requested);
+    if (lease.threadpool() != attached_threadpool_)
+    {
+        attached_threadpool_ = lease.threadpool();
+        if (attached_threadpool_)
+        {
+            llama_attach_threadpool(ctx_, attached_threadpool_.get(), attached_threadpool_.get());
+            if (draft_ctx_)
+            {
+                llama_attach_threadpool(draft_ctx_, attached_threadpool_.get(), attached_threadpool_.get());
+            }
+        }
+        else
+        {
+            llama_detach_threadpool(ctx_);
+            if (draft_ctx_)
+            {
+                llama_detach_threadpool(draft_ctx_);
+            }
+        }
+    }
+    llama_set_n_threads(ctx_, lease.n_threads(), lease.n_threads());
+    if (draft_ctx_)
+    {
+        llama_set_n_threads(draft_ctx_, lease.n_threads(), lease.n_threads());
+    }
+    return lease;
+}
+
+/**
+ * @brief llama progress callback of model loading.
+ *
+ * @param progress Fraction of the model file loaded, from 0 to 1.
+ * @param data     The LlamaInterface loading the model.
+ * @return false to abort the load, when the attached load status was cancelled.
+ */
+bool LlamaInterface::load_progress_callback(float progress, void *data)
+{
+    const auto *self = static_cast<const LlamaInterface *>(data);
+    if (!self->load_status_)
+    {
+        return true;
+    }
+    self->load_status_->set_progress(progress);
+    return !self->load_status_->is_cancelled();
+}
+
+/**
+ * @brief Asks the kernel to start reading a model file ahead of the mmap page faults.
+ *
+ * With mmap the weights are paged in lazily on first touch, one fault at a time. The
+ * read-ahead hint turns that into large sequential reads that overlap with the tensor
+ * setup, and leaves the pages in the page cache for the next load of the same file. It is
+ * a hint only: failures are ignored and platforms without it load as before.
+ *
+ * @param path Path of the GGUF file.
+ */
+void LlamaInterface::prefetch_model_file(const std::string &path)
+{
+#if defined(__linux__) || defined(__FreeBSD__)
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return;
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+    close(fd);
+#elif defined(__APPLE__)
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        struct radvisory advice;
+        advice.ra_offset = 0;
+        advice.ra_count = static_cast<int>(std::min<off_t>(st.st_size, std::numeric_limits<int>::max()));
+        fcntl(fd, F_RDADVISE, &advice);
+    }
+    close(fd);
+#else
+    (void)path;
+#endif
+}
+
+/**
+ * @brief Runs a one-token decode so the first real request does not pay for backend setup.
+ *
+ * The first llama_decode allocates the compute buffers, compiles or uploads the GPU
+ * kernels and faults in the weights it touches. Doing it here moves that latency to load
+ * time. The warm-up token is removed from the KV cache afterwards.
+ */
+void LlamaInterface::warm_up()
+{
+    llama_token token = llama_vocab_bos(vocab_);
+    if (token == LLAMA_TOKEN_NULL)
+    {
+        token = 0;
+    }
+
+    llama_batch batch = llama_batch_get_one(&token, 1);
+    const auto start = std::chrono::steady_clock::now();
+    if (llama_decode(ctx_, batch) != 0)
+    {
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Warning))
+        {
+            std::cerr << "LlamaInterface Warning: warm-up decode failed" << std::endl;
+        }
+    }
+    llama_synchronize(ctx_);
+    if (llama_memory_t mem = llama_get_memory(ctx_))
+    {
+        llama_memory_seq_rm(mem, -1, -1, -1);
+    }
+    const double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if (HegemonikonLog::enabled(HegemonikonLogLevel::Info))
+    {
+        std::cerr << "LlamaInterface: warm-up took " << elapsed_ms << " ms" << std::endl;
+    }
+}
+
+/**
+ * @brief Unloads the currently loaded Llama model and releases associated resources.
+ *
+ * This function frees the context and model objects if they are loaded,
+ * sets their pointers to nullptr, and resets the vocabulary pointer.
+ * It also logs a message indicating that the model has been unloaded. Waits for the
+ * decode step in flight, if any, as pooled contexts and the scheduler may be using it.
+ */
+void LlamaInterface::unload_model()
+{
+    std::lock_guard<std::mutex> lock(context_mutex_);
+    unload_model_locked();
+}
+
+void LlamaInterface::unload_model_locked()
+{
+    unload_draft_model();
+    sessions_.clear();
+    free_seq_ids_.clear();
+    if (ctx_)
+    {
+        llama_free(ctx_);
+        ctx_ = nullptr;
+    }
+    attached_threadpool_.reset();
+    shared_model_.reset();
+    model_ = nullptr;
+    vocab_ = nullptr;
+    piece_table_.reset();
+    if (HegemonikonLog::enabled(HegemonikonLogLevel::Info))
+    {
+        std::cerr << "LlamaInterface: Model unloaded." << std::endl;
+    }
+}
+
+/**
+ * @brief Checks if the Llama model and its required components are loaded.
+ *
+ * This function verifies that the model, context, and vocabulary pointers are all non-null,
+ * indicating that the model and its dependencies have been successfully loaded and initialized.
+ *
+ * @return true if the model, context, and vocabulary are loaded; false otherwise.
+ */
+bool LlamaInterface::is_model_loaded() const
+{
+    return model_ != nullptr && ctx_ != nullptr && vocab_ != nullptr;
+}
+
+/**
+ * @brief Tokenizes the given text using the loaded Llama model vocabulary.
+ *
+ * This function converts the input string into a sequence of llama_token values,
+ * optionally adding a beginning-of-sequence (BOS) token and handling special tokens.
+ * It first checks if the model is loaded, then estimates the required buffer size
+ * for tokenization. If the initial buffer is insufficient, it resizes and retries.
+ *
+ * @param text The input string to tokenize.
+ * @param add_bos If true, prepends a BOS token to the output.
+ * @param special If true, enables special token handling during tokenization.
+ * @return std::vector<llama_token> The sequence of tokens representing the input text.
+ *         Returns an empty vector if the model is not loaded or tokenization fails.
+ */
+std::vector<llama_token> LlamaInterface::tokenize(const std::string &text, bool add_bos, bool special) const
+{
+    if (!is_model_loaded())
+    {
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+        {
+            std::cerr << "LlamaInterface Error: model not loaded for tokenization" << std::endl;
+        }
+        return {};
+    }
+
+    if (text.empty())
+    {
+        return add_bos ? std::vector<int32_t>{llama_vocab_bos(vocab_)} : std::vector<int32_t>{};
+    }
+
+    int n_tokens_estimated = static_cast<int>(text.length() * 1.5) + (add_bos ? 1 : 0) + 64;
+    std::vector<llama_token> result(n_tokens_estimated);
+
+    int n_tokens = llama_tokenize(vocab_, text.c_str(), text.length(), result.data(), result.size(), add_bos, special);
+
+    if (n_tokens < 0)
+    {
+        int required_size = -n_tokens;
+        result.resize(required_size);
+        n_tokens = llama_tokenize(vocab_, text.c_str(), text.length(), result.data(), result.size(), add_bos, special);
+        if (n_tokens < 0)
+        {
+            if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+            {
+                std::cerr << "LlamaInterface Error: tokenization failed even after resize" << std::endl;
+            }
+            return {};
+        }
+    }
+
+    result.resize(n_tokens);
+    return result;
+}
+
+std::vector<int32_t> LlamaInterface::tokenization(const std::string &text) const
+{
+    if (!is_model_loaded())
+    {
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+        {
+            std::cerr << "LlamaInterface Error: model not loaded for tokenization" << std::endl;
+        }
+        return {};
+    }
+
+    std::vector<int32_t> tokens = tokenize(text, true, false);
+    if (tokens.empty())
+    {
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+        {
+            std::cerr << "LlamaInterface Error: tokenization failed for text: " << text << std::endl;
+        }
+        return {};
+    }
+
+    return tokens;
+}
+
+/**
+ * @brief Tokenizes a text and appends its tokens to a caller-owned buffer.
+ *
+ * The buffer is grown by an upper bound of the token count (one token per byte plus
+ * special tokens) so a single llama_tokenize call is enough in practice; the exact
+ * size reported by llama.cpp is used if that bound is ever exceeded.
+ *
+ * @param text    The text to tokenize.
+ * @param add_bos Whether to prepend the BOS token.
+ * @param special Whether to parse special tokens.
+ * @param out     The buffer to append to; restored to its original size on failure.
+ * @return The number of tokens appended, or -1 on failure.
+ */
+int32_t LlamaInterface::tokenize_into(std::string_view text, bool add_bos, bool special, std::vector<llama_token> &out) const
+{
+    const size_t base = out.size();
+    out.resize(base + text.size() + 8);
+    int32_t n = llama_tokenize(vocab_, text.data(), static_cast<int32_t>(text.size()), out.data() + base,
+                               static_cast<int32_t>(out.size() - base), add_bos, special);
+    if (n < 0 && n != std::numeric_limits<int32_t>::min())
+    {
+        out.resize(base + static_cast<size_t>(-n));
+        n = llama_tokenize(vocab_, text.data(), static_cast<int32_t>(text.size()), out.data() + base,
+                           static_cast<int32_t>(out.size() - base), add_bos, special);
+    }
+    if (n < 0)
+    {
+        out.resize(base);
+        return -1;
+    }
+    out.resize(base + static_cast<size_t>(n));
+    return n;
+}
+
+/**
+ * @brief Tokenizes many texts at once into a single flat token array.
+ *
+ * The texts are split into contiguous ranges that are tokenized in parallel on the
+ * pool (the vocabulary is read-only), each range into one local buffer; the buffers
+ * are then concatenated once into the result.
+ *
+ * @param texts   The texts to tokenize; they must stay alive for the duration of the call.
+ * @param pool    Worker pool to fan out on, or nullptr to run on the calling thread.
+ * @param add_bos Whether to prepend the BOS token to each text.
+ * @param special Whether to parse special tokens.
+ * @return The packed tokens and per-text offsets; empty when no model is loaded.
+ */
+HegemonikonTokenBatch LlamaInterface::tokenize_batch(const std::vector<std::string_view> &texts, ThreadPool *pool,
+                                                     bool add_bos, bool special) const
+{
+    HegemonikonTokenBatch batch;
+    if (!is_model_loaded())
+    {
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+        {
+            std::cerr << "LlamaInterface Error: model not loaded for tokenization" << std::endl;
+        }
+        return batch;
+    }
+
+    struct Part
+    {
+        size_t begin;
+        std::vector<llama_token> tokens;
+    };
+    std::vector<int32_t> counts(texts.size(), 0);
+    std::vector<Part> parts;
+    std::mutex parts_mutex;
+
+    auto run = [&](size_t begin, size_t end)
+    {
+        Part part{begin, {}};
+        for (size_t i = begin; i < end; ++i)
+        {
+            counts[i] = std::max(0, tokenize_into(texts[i], add_bos, special, part.tokens));
+        }
+        std::lock_guard<std::mutex> lock(parts_mutex);
+        parts.push_back(std::move(part));
+    };
+
+    if (pool)
+        pool->parallel_for(texts.size(), run, 16);
+    else
+        run(0, texts.size());
+
+    batch.offsets.resize(texts.size() + 1, 0);
+    for (size_t i = 0; i < texts.size(); ++i)
+    {
+        batch.offsets[i + 1] = batch.offsets[i] + counts[i];
+    }
+    batch.tokens.resize(static_cast<size_t>(batch.offsets.back()));
+    for (const Part &part : parts)
+    {
+        std::copy(part.tokens.begin(), part.tokens.end(), batch.tokens.begin() + batch.offsets[part.begin]);
+    }
+    return batch;
+}
+
+/**
+ * @brief Counts the tokens of many texts without materializing them.
+ *
+ * Meant for chunk sizing: llama_tokenize is called with an empty output buffer and
+ * reports the required size, so no token storage is allocated at all.
+ *
+ * @param texts   The texts to measure.
+ * @param pool    Worker pool to fan out on, or nullptr to run on the calling thread.
+ * @param add_bos Whether to count the BOS token.
+ * @param special Whether to parse special tokens.
+ * @return The token count of each text, -1 for texts that failed to tokenize.
+ */
+std::vector<int32_t> LlamaInterface::count_tokens_batch(const std::vector<std::string_view> &texts, ThreadPool *pool,
+                                                        bool add_bos, bool special) const
+{
+    std::vector<int32_t> counts(texts.size(), -1);
+    if (!is_model_loaded())
+    {
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+        {
+            std::cerr << "LlamaInterface Error: model not loaded for tokenization" << std::endl;
+        }
+        return counts;
+    }
+
+    auto run = [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            const int32_t n = llama_tokenize(vocab_, texts[i].data(), static_cast<int32_t>(texts[i].size()),
+                                             nullptr, 0, add_bos, special);
+            counts[i] = n == std::numeric_limits<int32_t>::min() ? -1 : (n < 0 ? -n : n);
+        }
+    };
+
+    if (pool)
+        pool->parallel_for(texts.size(), run, 16);
+    else
+        run(0, texts.size());
+    return counts;
+}
+
+/**
+ * @brief Embeds many texts with as few llama_decode calls as possible.
+ *
+ * The texts are tokenized in parallel on the pool, then packed greedily into batches of
+ * up to `llama_n_batch` tokens and `llama_n_seq_max` texts, each text in its own sequence;
+ * one decode yields the pooled vector of every text of the batch. Texts longer than a
+ * batch are truncated to fit. Requires a model loaded with
+ * HegemonikonLlamaModelParams::set_embeddings.
+ *
+ * @param texts     The texts to embed; they must stay alive for the duration of the call.
+ * @param normalize Whether to scale every row to unit L2 norm (cosine similarity becomes a dot product).
+ * @param pool      Worker pool for tokenization, or nullptr to tokenize on the calling thread.
+ * @return HegemonikonEmbeddingBatch One row per text; empty if no embedding model is loaded.
+ */
+HegemonikonEmbeddingBatch LlamaInterface::embed_batch(const std::vector<std::string_view> &texts, bool normalize,
+                                                      ThreadPool *pool)
+{
+    HegemonikonEmbeddingBatch out;
+    if (!is_model_loaded() || !current_model_params_.embeddings)
+    {
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+        {
+            std::cerr << "LlamaInterface Error: no embedding model loaded" << std::endl;
+        }
+        return out;
+    }
+
+    const HegemonikonTokenBatch tokens = tokenize_batch(texts, pool, true, false);
+
+    std::lock_guard<std::mutex> lock(context_mutex_);
+    out.n_embd = llama_model_n_embd(model_);
+    out.data.assign(texts.size() * static_cast<size_t>(out.n_embd), 0.0f);
+    if (texts.empty())
+    {
+        return out;
+    }
+
+    const int32_t n_batch = static_cast<int32_t>(llama_n_batch(ctx_));
+    const size_t n_seq_max = std::max<size_t>(1, llama_n_seq_max(ctx_));
+    llama_batch batch = llama_batch_init(n_batch, 0, 1);
+
+    std::vector<std::pair<size_t, int32_t>> rows;
+    int32_t n_pending = 0;
+    for (size_t i = 0; i < texts.size(); ++i)
+    {
+        int32_t n_tokens = static_cast<int32_t>(tokens.offsets[i + 1] - tokens.offsets[i]);
+        if (n_tokens == 0)
+        {
+            ++out.n_failed;
+            continue;
+        }
+        if (n_tokens > n_batch)
+        {
+            n_tokens = n_batch;
+            ++out.n_truncated;
+        }
+        if (n_pending + n_tokens > n_batch || rows.size() == n_seq_max)
+        {
+            decode_embeddings_locked(batch, tokens, rows, normalize, out);
+            rows.clear();
+            n_pending = 0;
+        }
+        rows.emplace_back(i, n_tokens);
+        n_pending += n_tokens;
+    }
+    if (!rows.empty())
+    {
+        decode_embeddings_locked(batch, tokens, rows, normalize, out);
+    }
+
+    llama_batch_free(batch);
+    return out;
+}
+
+/**
+ * @brief Decodes one packed batch of texts and copies their pooled vectors out.
+ *
+ * @param batch     Scratch batch of at least `llama_n_batch` tokens.
+ * @param tokens    The tokens of all texts.
+ * @param rows      The texts of this batch: row index and number of tokens to use.
+ * @param normalize Whether to L2-normalize the rows.
+ * @param out       The matrix the rows are written to.
+ */
+void LlamaInterface::decode_embeddings_locked(llama_batch &batch, const HegemonikonTokenBatch &tokens,
+                                              const std::vector<std::pair<size_t, int32_t>> &rows, bool normalize,
+                                              HegemonikonEmbeddingBatch &out)
+{
+    if (llama_memory_t mem = llama_get_memory(ctx_))
+    {
+        llama_memory_clear(mem, true);
+    }
+
+    batch.n_tokens = 0;
+    for (size_t s = 0; s < rows.size(); ++s)
+    {
+        const llama_token *text_tokens = tokens.tokens.data() + tokens.offsets[rows[s].first];
+        for (int32_t pos = 0; pos < rows[s].second; ++pos)
+        {
+            const int32_t k = batch.n_tokens++;
+            batch.token[k] = text_tokens[pos];
+            batch.pos[k] = pos;
+            batch.n_seq_id[k] = 1;
+            batch.seq_id[k][0] = static_cast<llama_seq_id>(s);
+            batch.logits[k] = 1;
+        }
+    }
+
+    const ComputeLease lease = acquire_compute_locked({});
+    if (llama_decode(ctx_, batch) != 0)
+    {
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+        {
+            std::cerr << "LlamaInterface Error: embedding decode of " << rows.size() << " texts failed" << std::endl;
+        }
+        out.n_failed += static_cast<int32_t>(rows.size());
+        return;
+    }
+
+    const size_t n_embd = static_cast<size_t>(out.n_embd);
+    for (size_t s = 0; s < rows.size(); ++s)
+    {
+        const float *embd = llama_get_embeddings_seq(ctx_, static_cast<llama_seq_id>(s));
+        if (!embd)
+        {
+            ++out.n_failed;
+            continue;
+        }
+        float *row = out.data.data() + rows[s].first * n_embd;
+        double norm = 0.0;
+        for (size_t j = 0; j < n_embd; ++j)
+        {
+            row[j] = embd[j];
+            norm += static_cast<double>(embd[j]) * embd[j];
+        }
+        if (normalize && norm > 0.0)
+        {
+            const float scale = static_cast<float>(1.0 / std::sqrt(norm));
+            for (size_t j = 0; j < n_embd; ++j)
+            {
+                row[j] *= scale;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Embeds a single text, without normalization.
+ *
+ * @param text The text to embed.
+ * @return The pooled embedding, empty on failure or if no embedding model is loaded.
+ */
+std::vector<float> LlamaInterface::get_embeddings(const std::string &text)
+{
+    HegemonikonEmbeddingBatch batch = embed_batch({std::string_view(text)}, false);
+    if (batch.size() != 1 || batch.n_failed > 0)
+    {
+        return {};
+    }
+    return std::move(batch.data);
+}
+
+/**
+ * @brief Returns the dimension of the embeddings produced by embed_batch().
+ *
+ * @return The embedding size, 0 if no embedding model is loaded.
+ */
+int32_t LlamaInterface::get_embedding_size() const
+{
+    return is_model_loaded() && current_model_params_.embeddings ? llama_model_n_embd(model_) : 0;
+}
+
+std::string LlamaInterface::detokenization(const std::vector<int32_t> &tokens) const
+{
+    if (!is_model_loaded())
+    {
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+        {
+            std::cerr << "LlamaInterface Error: model not loaded for detokenization" << std::endl;
+        }
+        return "";
+    }
+
+    if (tokens.empty())
+    {
+        return "";
+    }
+
+    std::string result;
+    if (!piece_table_->detokenize(tokens.data(), tokens.size(), result))
+    {
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+        {
+            std::cerr << "LlamaInterface Error: failed to detokenize tokens: id out of vocabulary" << std::endl;
+        }
+        return "[Error]";
+    }
+    return result;
+}
+
+/**
+ * @brief Converts a token ID to its corresponding string representation.
+ *
+ * This function takes an integer token ID and returns its piece from the vocabulary
+ * piece table. If the model is not loaded, it returns an empty string.
+ * If the token is outside the vocabulary, it logs an error and returns "[Error]".
+ *
+ * @param token The token ID to be detokenized.
+ * @return The string representation of the token, or "[Error]" if conversion fails,
+ *         or an empty string if the model is not loaded.
+ */
+std::string LlamaInterface::detokenize_token(int32_t token) const
+{
+    if (!is_model_loaded())
+    {
+        return "";
+    }
+
+    std::string piece;
+    if (!piece_table_->append(token, piece))
+    {
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+        {
+            std::cerr << "LlamaInterface Error: failed to convert token " << token << " to piece" << std::endl;
+        }
+        return "[Error]";
+    }
+    return piece;
+}
+
+/**
+ * @brief Converts a sequence of token IDs into a string by detokenizing each token.
+ *
+ * This function takes a vector of integer token IDs and reconstructs the original
+ * string by copying each piece from the vocabulary piece table. If the input
+ * vector is empty, an empty string is returned; tokens outside the vocabulary are skipped.
+ *
+ * @param tokens A vector of integer token IDs to be detokenized.
+ * @return The detokenized string corresponding to the input token sequence.
+ */
+std::string LlamaInterface::detokenize_sequence(const std::vector<int32_t> &tokens) const
+{
+    if (tokens.empty())
+        return "";
+
+    if (!is_model_loaded())
+        return "";
+
+    std::string result;
+    if (!piece_table_->detokenize(tokens.data(), tokens.size(), result))
+    {
+        for (int32_t token : tokens)
+        {
+            piece_table_->append(token, result);
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief Creates and configures a llama_sampler instance based on the provided generation parameters.
+ *
+ * This function initializes a new llama_sampler chain and sequentially adds various sampling strategies
+ * to it, such as penalties for repetition, minimum probability threshold, top-k and top-p sampling,
+ * temperature scaling, and distribution initialization. The configuration is determined by the values
+ * in the provided HegemonikonGenerationParams structure.
+ *
+ * @param params The generation parameters specifying sampler configuration, including penalties,
+ *               top-k, top-p, temperature, and other relevant settings.
+ * @return A pointer to the configured llama_sampler instance.
+ */
+llama_sampler *LlamaInterface::create_sampler(const HegemonikonGenerationParams &params)
+{
+    llama_sampler *smpl = llama_sampler_chain_init(llama_sampler_chain_default_params());
+
+    llama_sampler_chain_add(smpl, llama_sampler_init_penalties(
+                                      params.penalty_last_n,
+                                      params.repeat_penalty,
+                                      params.penalty_freq,
+                                      params.penalty_present));
+
+    llama_sampler_chain_add(smpl, llama_sampler_init_min_p(0.05f, 1));
+
+    llama_sampler_chain_add(smpl, llama_sampler_init_top_k(params.top_k));
+
+    llama_sampler_chain_add(smpl, llama_sampler_init_top_p(params.top_p, 1));
+    llama_sampler_chain_add(smpl, llama_sampler_init_temp(params.temperature));
+
+    llama_sampler_chain_add(smpl, llama_sampler_init_dist(LLAMA_DEFAULT_SEED));
+
+    return smpl;
+}
+
+/**
+ * @brief Rebuilds the pool of free KV-cache sequence ids for the current context.
+ *
+ * Called after a context has been created; every sequence starts out free and
+ * no session is resident. Sequence ids past n_seq_max are handed to the prefix cache.
+ */
+void LlamaInterface::reset_sequence_pool()
+{
+    sessions_.clear();
+    free_seq_ids_.clear();
+    for (int32_t id = current_model_params_.n_seq_max - 1; id >= 0; --id)
+    {
+        free_seq_ids_.push_back(static_cast<llama_seq_id>(id));
+    }
+
+    std::vector<llama_seq_id> prefix_seq_ids;
+    const int32_t n_prefix_slots = current_model_params_.embeddings ? 0 : current_model_params_.prefix_cache_slots;
+    for (int32_t i = 0; i < n_prefix_slots; ++i)
+    {
+        prefix_seq_ids.push_back(static_cast<llama_seq_id>(current_model_params_.n_seq_max + i));
+    }
+    prefix_cache_.configure(prefix_seq_ids, static_cast<size_t>(std::max(0, current_model_params_.prefix_cache_max_tokens)));
+}
+
+/**
+ * @brief Returns the sequence slot bound to a key, allocating one if needed.
+ *
+ * Known session keys get their existing slot back (with its cached tokens). New keys
+ * take a free sequence id, evicting the least recently used idle session when the pool
+ * is exhausted. Stateless keys are unique per request and always start empty.
+ *
+ * @param key       The session identifier, or a per-request key for stateless requests.
+ * @param stateless Whether the slot is released once the request finishes.
+ * @return Pointer to the slot, or nullptr if the slot is busy or no sequence could be allocated.
+ */
+LlamaInterface::LlamaSequenceSlot *LlamaInterface::acquire_sequence(const std::string &key, bool stateless)
+{
+    auto it = sessions_.find(key);
+    if (it != sessions_.end())
+    {
+        if (it->second.busy)
+        {
+            return nullptr;
+        }
+    }
+    else
+    {
+        if (free_seq_ids_.empty() && !evict_lru_session())
+        {
+            return nullptr;
+        }
+
+        LlamaSequenceSlot slot;
+        slot.seq_id = free_seq_ids_.back();
+        free_seq_ids_.pop_back();
+        llama_memory_seq_rm(llama_get_memory(ctx_), slot.seq_id, -1, -1);
+        if (draft_ctx_)
+        {
+            llama_memory_seq_rm(llama_get_memory(draft_ctx_), slot.seq_id, -1, -1);
+        }
+        it = sessions_.emplace(key, std::move(slot)).first;
+    }
+
+    it->second.busy = true;
+    it->second.last_used = stateless ? 0 : ++session_clock_;
+    return &it->second;
+}
+
+/**
+ * @brief Releases the sequence bound to a key and returns its id to the pool.
+ *
+ * @param key The session or stateless request key.
+ */
+void LlamaInterface::release_sequence(const std::string &key)
+{
+    auto it = sessions_.find(key);
+    if (it == sessions_.end())
+    {
+        return;
+    }
+
+    llama_memory_seq_rm(llama_get_memory(ctx_), it->second.seq_id, -1, -1);
+    if (draft_ctx_)
+    {
+        llama_memory_seq_rm(llama_get_memory(draft_ctx_), it->second.seq_id, -1, -1);
+    }
+    free_seq_ids_.push_back(it->second.seq_id);
+    sessions_.erase(it);
+}
+
+/**
+ * @brief Evicts the least recently used idle session from the KV cache.
+ *
+ * Sessions that are currently generating are never evicted. Cached prefixes are
+ * only evicted once no idle session is left.
+ *
+ * @return true if a session or prefix was evicted, false if there was nothing to evict.
+ */
+bool LlamaInterface::evict_lru_session()
+{
+    auto victim = sessions_.end();
+    for (auto it = sessions_.begin(); it != sessions_.end(); ++it)
+    {
+        if (it->second.busy)
+            continue;
+        if (victim == sessions_.end() || it->second.last_used < victim->second.last_used)
+            victim = it;
+    }
+
+    if (victim == sessions_.end())
+    {
+        llama_seq_id prefix_seq = prefix_cache_.evict_lru();
+        if (prefix_seq < 0)
+        {
+            return false;
+        }
+        llama_memory_seq_rm(llama_get_memory(ctx_), prefix_seq, -1, -1);
+        return true;
+    }
+
+    if (HegemonikonLog::enabled(HegemonikonLogLevel::Debug))
+    {
+        std::cerr << "LlamaInterface: evicting session '" << victim->first << "' from KV cache" << std::endl;
+    }
+    release_sequence(victim->first);
+    return true;
+}
+
+/**
+ * @brief Prepares a generation request and binds it to a KV-cache sequence.
+ *
+ * Tokenizes the prompt, acquires the sequence of its session (or a scratch sequence for
+ * stateless requests), keeps the longest prefix already present in the KV cache and
+ * pulls a shared prefix from the prefix cache when possible. No decoding happens here;
+ * the prompt remainder is prefilled by decode_step.
+ *
+ * @param prompt_text The input prompt.
+ * @param params      The generation parameters.
+ * @param on_piece    Optional callback receiving each generated piece; returning false stops generation.
+ * @param handle      Optional control block to cancel or bound the request. When `params.timeout_ms`
+ *                    is set and the handle has no deadline yet, the deadline is started here.
+ * @return The new sequence. On failure it is already finished and `result.text` holds the error.
+ */
+std::unique_ptr<LlamaGenerationSequence> LlamaInterface::start_sequence(const std::string &prompt_text,
+                                                                        const HegemonikonGenerationParams &params,
+                                                                        llama_token_callback on_piece,
+                                                                        std::shared_ptr<LlamaRequestHandle> handle)
+{
+    auto seq = std::make_unique<LlamaGenerationSequence>();
+    seq->params = params;
+    seq->on_piece = std::move(on_piece);
+    seq->start_time = std::chrono::high_resolution_clock::now();
+    seq->finished = true;
+    seq->released = true;
+    seq->result.finish_reason = "error";
+
+    if (params.timeout_ms > 0)
+    {
+        if (!handle)
+        {
+            handle = std::make_shared<LlamaRequestHandle>();
+        }
+        if (!handle->has_deadline())
+        {
+            handle->set_timeout_ms(params.timeout_ms);
+        }
+    }
+    seq->handle = std::move(handle);
+
+    if (!is_model_loaded())
+    {
+        seq->result.text = "[Error: Model not loaded]";
+        return seq;
+    }
+
+    if (current_model_params_.embeddings)
+    {
+        seq->result.text = "[Error: Model loaded for embeddings]";
+        return seq;
+    }
+
+    if (prompt_text.empty())
+    {
+        seq->result.text = "[Error: Empty prompt]";
+        return seq;
+    }
+
+    seq->prompt_tokens = tokenize(prompt_text, params.add_bos, params.parse_special);
+    seq->tokenize_duration_ms = std::chrono::duration<double, std::milli>(
+                                    std::chrono::high_resolution_clock::now() - seq->start_time)
+                                    .count();
+    if (seq->prompt_tokens.empty())
+    {
+        seq->result.text = "[Error: Prompt tokenization failed]";
+        return seq;
+    }
+
+    std::lock_guard<std::mutex> lock(context_mutex_);
+    if (metrics_)
+    {
+        metrics_->record_ms(MetricPhase::Tokenize, seq->tokenize_duration_ms);
+        metrics_->add(MetricCounter::PromptTokens, seq->prompt_tokens.size());
+    }
+
+    const size_t n_ctx = llama_n_ctx(ctx_);
+    if (seq->prompt_tokens.size() >= n_ctx && params.context_shift)
+    {
+        // Keep the first n_keep tokens and drop whole blocks of half the remaining window
+        // after them, which leaves the prompt filling half to all of the window.
+        const size_t n_keep = keep_length(params.n_keep);
+        const size_t n_block = std::max<size_t>(1, (n_ctx - n_keep) / 2);
+        const size_t n_erased = (seq->prompt_tokens.size() - n_keep - n_block) / n_block * n_block;
+        seq->prompt_tokens.erase(seq->prompt_tokens.begin() + n_keep, seq->prompt_tokens.begin() + n_keep + n_erased);
+        seq->result.discarded_tokens = static_cast<int32_t>(n_erased);
+    }
+
+    const std::vector<llama_token> &prompt_tokens = seq->prompt_tokens;
+    if (prompt_tokens.size() >= n_ctx)
+    {
+        seq->result.text = "[Error: Context size exceeded]";
+        return seq;
+    }
+
+    seq->stateless = params.session_id.empty();
+    seq->slot_key = seq->stateless ? std::string(1, '\0') + std::to_string(++stateless_counter_) : params.session_id;
+
+    LlamaSequenceSlot *slot = acquire_sequence(seq->slot_key, seq->stateless);
+    if (!slot)
+    {
+        seq->result.text = seq->stateless || sessions_.find(seq->slot_key) == sessions_.end()
+                               ? "[Error: No free KV cache sequence]"
+                               : "[Error: Session is busy]";
+        return seq;
+    }
+
+    // Keep the longest common prefix, but always re-decode the last prompt token
+    // so that fresh logits are available for sampling.
+    size_t n_reuse = 0;
+    const size_t n_common = std::min(slot->tokens.size(), prompt_tokens.size() - 1);
+    while (n_reuse < n_common && slot->tokens[n_reuse] == prompt_tokens[n_reuse])
+    {
+        ++n_reuse;
+    }
+
+    llama_memory_t mem = llama_get_memory(ctx_);
+    if (n_reuse < slot->tokens.size())
+    {
+        llama_memory_seq_rm(mem, slot->seq_id, static_cast<llama_pos>(n_reuse), -1);
+        slot->tokens.resize(n_reuse);
+        slot->n_shared = std::min(slot->n_shared, n_reuse);
+    }
+
+    seq->fresh = (n_reuse == 0);
+    if (prefix_cache_.aligned_length(prompt_tokens.size() - 1) > n_reuse)
+    {
+        LlamaPrefixMatch prefix = prefix_cache_.lookup(prompt_tokens, prompt_tokens.size() - 1);
+        if (prefix.n_tokens > n_reuse)
+        {
+            llama_memory_seq_cp(mem, prefix.seq_id, slot->seq_id,
+                                static_cast<llama_pos>(n_reuse), static_cast<llama_pos>(prefix.n_tokens));
+            slot->tokens.assign(prompt_tokens.begin(), prompt_tokens.begin() + prefix.n_tokens);
+            slot->n_shared = std::max(slot->n_shared, prefix.n_tokens);
+            n_reuse = prefix.n_tokens;
+        }
+    }
+
+    seq->seq_id = slot->seq_id;
+    seq->n_past = n_reuse;
+    seq->sampler = create_sampler(params);
+    seq->stop_matcher.configure(params.stop_sequences);
+    if (params.prompt_lookup)
+    {
+        seq->lookup.configure(static_cast<size_t>(std::max(1, params.lookup_ngram_min)),
+                              static_cast<size_t>(std::max(1, params.lookup_ngram_max)));
+    }
+    seq->result.prompt_tokens = static_cast<int32_t>(prompt_tokens.size());
+    seq->result.reused_tokens = static_cast<int32_t>(n_reuse);
+    seq->result.finish_reason.clear();
+    seq->finished = false;
+    seq->released = false;
+    return seq;
+}
+
+/**
+ * @brief Samples the next token of a sequence from the logits of the last decode.
+ *
+ * accept_token handles end-of-generation, n_predict, stop sequences and the context limit. Stop
+ * sequences are matched incrementally by the sequence's LlamaStopMatcher, which also
+ * decides which part of the piece can be appended and streamed right away.
+ *
+ * @param sequence The sequence whose logits are at `logits_index`.
+ * @return true if the sequence should continue with `pending_token`, false if it is finished.
+ */
+bool LlamaInterface::sample_sequence(LlamaGenerationSequence &sequence)
+{
+    llama_token token = LLAMA_TOKEN_NULL;
+    {
+        TraceSpan span("llama_sample", "llama");
+        MetricsRegistry::ScopedTimer timer(metrics_.get(), MetricPhase::Sample);
+        token = llama_sampler_sample(sequence.sampler, ctx_, sequence.logits_index);
+    }
+    sequence.logits_index = -1;
+    return accept_token(sequence, token);
+}
+
+/**
+ * @brief Appends a sampled token to the output of a sequence.
+ *
+ * @param sequence The sequence the token was sampled for.
+ * @param token    The sampled token.
+ * @return true if the sequence should continue with `pending_token` set to the token,
+ *         false if it is finished.
+ */
+bool LlamaInterface::accept_token(LlamaGenerationSequence &sequence, llama_token token)
+{
+    sequence.pending_token = LLAMA_TOKEN_NULL;
+
+    if (sequence.result.tokens_generated == 0)
+    {
+        sequence.result.ttft_ms = std::chrono::duration<double, std::milli>(
+                                      std::chrono::high_resolution_clock::now() - sequence.start_time)
+                                      .count();
+    }
+    MetricsRegistry *metrics = metrics_.get();
+    if (metrics)
+    {
+        const MetricsRegistry::clock::time_point now = MetricsRegistry::clock::now();
+        if (sequence.result.tokens_generated == 0)
+        {
+            metrics->record_ms(MetricPhase::TimeToFirstToken, sequence.result.ttft_ms);
+        }
+        else
+        {
+            metrics->record(MetricPhase::InterToken, sequence.last_token_time, now);
+        }
+        sequence.last_token_time = now;
+    }
+
+    std::string &text = sequence.result.text;
+
+    // Text withheld as a possible stop-sequence prefix belongs to the output when the
+    // generation ends for any other reason.
+    auto finish = [&](bool notify, const char *reason)
+    {
+        sequence.result.finish_reason = reason;
+        std::string tail = sequence.stop_matcher.flush() + sequence.utf8.flush();
+        if (!tail.empty())
+        {
+            text += tail;
+            if (notify && sequence.on_piece)
+            {
+                sequence.on_piece(tail);
+            }
+        }
+        return false;
+    };
+
+    if (llama_vocab_is_eog(vocab_, token))
+    {
+        return finish(true, "stop");
+    }
+
+    const MetricsRegistry::clock::time_point detokenize_start = metrics ? MetricsRegistry::clock::now() : MetricsRegistry::clock::time_point();
+    const std::string_view raw_piece = piece_table_->piece(token);
+    if (raw_piece.empty() && (token < 0 || static_cast<size_t>(token) >= piece_table_->size()))
+    {
+        return finish(true, "stop");
+    }
+    sequence.result.tokens_generated++;
+
+    // Only whole UTF-8 characters are handed to the stop matcher and the stream.
+    std::string piece;
+    sequence.utf8.push(raw_piece, piece);
+
+    std::string emitted;
+    const bool stop_matched = sequence.stop_matcher.feed(piece, emitted);
+    text += emitted;
+    if (metrics)
+    {
+        metrics->record(MetricPhase::Detokenize, detokenize_start, MetricsRegistry::clock::now());
+    }
+
+    if (!emitted.empty() && sequence.on_piece && !sequence.on_piece(emitted))
+    {
+        return finish(false, "cancelled");
+    }
+
+    if (stop_matched)
+    {
+        sequence.result.finish_reason = "stop";
+        return false;
+    }
+
+    if (sequence.result.tokens_generated >= sequence.params.n_predict)
+    {
+        return finish(true, "length");
+    }
+
+    auto it = sessions_.find(sequence.slot_key);
+    if (it != sessions_.end() && it->second.tokens.size() + 1 >= llama_n_ctx(ctx_) && sequence.params.context_shift)
+    {
+        sequence.result.discarded_tokens += static_cast<int32_t>(shift_context(it->second, sequence.params.n_keep));
+    }
+    if (it == sessions_.end() || it->second.tokens.size() + 1 >= llama_n_ctx(ctx_))
+    {
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Warning))
+        {
+            std::cerr << "LlamaInterface Warning: context size reached, stopping generation" << std::endl;
+        }
+        return finish(true, "length");
+    }
+
+    sequence.pending_token = token;
+    return true;
+}
+
+/**
+ * @brief Stops a sequence whose request handle asks for it.
+ *
+ * A request interrupted before producing anything fails with an error; otherwise the
+ * text generated so far, including any withheld tail, is kept and the result stays
+ * successful with `finish_reason` telling why it ended early.
+ *
+ * @param sequence The in-flight sequence.
+ * @return true if the sequence has been finished.
+ */
+bool LlamaInterface::interrupt_if_requested(LlamaGenerationSequence &sequence)
+{
+    if (!sequence.handle)
+    {
+        return false;
+    }
+    const LlamaInterruptReason reason = sequence.handle->check(sequence.result.tokens_generated);
+    if (reason == LlamaInterruptReason::None)
+    {
+        return false;
+    }
+
+    std::string tail = sequence.stop_matcher.flush() + sequence.utf8.flush();
+    if (reason == LlamaInterruptReason::TokenLimit)
+    {
+        sequence.result.text += tail;
+        if (!tail.empty() && sequence.on_piece)
+        {
+            sequence.on_piece(tail);
+        }
+        sequence.result.finish_reason = "length";
+    }
+    else if (sequence.result.tokens_generated == 0)
+    {
+        sequence.result.text = reason == LlamaInterruptReason::Cancelled ? "[Error: Generation cancelled]"
+                                                                         : "[Error: Deadline exceeded]";
+        sequence.result.finish_reason = reason == LlamaInterruptReason::Cancelled ? "cancelled" : "deadline";
+    }
+    else
+    {
+        sequence.result.text += tail;
+        sequence.result.finish_reason = reason == LlamaInterruptReason::Cancelled ? "cancelled" : "deadline";
+    }
+    finish_sequence_locked(sequence);
+    return true;
+}
+
+/**
+ * @brief llama abort callback, polled by the backend between graph nodes.
+ *
+ * Aborts the running decode only when every sequence in it has been interrupted, so that
+ * one abandoned request never discards work done for the others in the same batch.
+ *
+ * @param data The LlamaInterface owning the context.
+ * @return true to abort the current llama_decode.
+ */
+bool LlamaInterface::abort_callback(void *data)
+{
+    const auto *self = static_cast<const LlamaInterface *>(data);
+    if (self->abort_watch_.empty())
+    {
+        return false;
+    }
+    for (const LlamaGenerationSequence *seq : self->abort_watch_)
+    {
+        if (!seq->handle || seq->handle->check(seq->result.tokens_generated) == LlamaInterruptReason::None)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Advances a set of sequences with a single multi-sequence llama_decode.
+ *
+ * Every decoding sequence contributes its pending token; the remaining batch capacity
+ * (`llama_n_batch`) is filled with prompt chunks of prefilling sequences, each capped by
+ * the request's `n_batch`. When at least one sequence is decoding, the prefill part of the
+ * step is further limited to `llama_n_ubatch` tokens so that a long prompt cannot stretch
+ * the step and stall the inter-token latency of in-flight generations; the rest of the
+ * prompt is picked up by the following steps. Logits are only requested for the tokens
+ * that will be sampled. Sequences that finish during the step are released and marked
+ * finished.
+ *
+ * When a draft model is loaded and a single sequence is decoding, the step is a
+ * speculative one instead (see speculative_step); with several active sequences the
+ * batch already amortizes the weights, so plain batched decoding is used.
+ *
+ * Request handles are checked before the step and, through the abort callback, during
+ * the decode itself; an aborted decode is rolled back to the last completed step.
+ *
+ * @param sequences The in-flight sequences; finished ones are ignored.
+ * @return Number of tokens decoded, or -1 if the decode failed (the sequences involved are finished with an error).
+ */
+int32_t LlamaInterface::decode_step(const std::vector<LlamaGenerationSequence *> &sequences)
+{
+    std::lock_guard<std::mutex> lock(context_mutex_);
+    if (!is_model_loaded())
+    {
+        for (LlamaGenerationSequence *seq : sequences)
+        {
+            if (!seq->finished)
+            {
+                seq->result.text = "[Error: Model not loaded]";
+                finish_sequence_locked(*seq);
+            }
+        }
+        return -1;
+    }
+
+    for (LlamaGenerationSequence *seq : sequences)
+    {
+        if (!seq->finished)
+        {
+            interrupt_if_requested(*seq);
+        }
+    }
+    const ComputeLease lease = acquire_compute_locked(sequences);
+
+    LlamaGenerationSequence *single = nullptr;
+    size_t n_active = 0;
+    for (LlamaGenerationSequence *seq : sequences)
+    {
+        if (!seq->finished)
+        {
+            single = seq;
+            ++n_active;
+        }
+    }
+    if (n_active == 1 && !single->is_prefilling() && single->pending_token != LLAMA_TOKEN_NULL)
+    {
+        if (single->params.prompt_lookup && single->params.n_lookup_draft > 0)
+        {
+            const int32_t n_looked_up = lookup_step(*single);
+            if (n_looked_up > 0)
+            {
+                return n_looked_up;
+            }
+        }
+        if (draft_ctx_ && single->params.n_draft > 0)
+        {
+            const int32_t n_speculated = speculative_step(*single);
+            if (n_speculated > 0)
+            {
+                return n_speculated;
+            }
+        }
+    }
+
+    TraceSpan compose_span("llama_compose_batch", "llama");
+    const size_t n_batch = std::max<size_t>(1, llama_n_batch(ctx_));
+    llama_batch batch = llama_batch_init(static_cast<int32_t>(n_batch), 0, 1);
+    batch.n_tokens = 0;
+
+    struct Span
+    {
+        LlamaGenerationSequence *seq;
+        size_t n_tokens;
+    };
+    std::vector<Span> spans;
+
+    auto add_token = [&](LlamaGenerationSequence *seq, llama_token token, llama_pos pos, bool logits)
+    {
+        const int32_t i = batch.n_tokens++;
+        batch.token[i] = token;
+        batch.pos[i] = pos;
+        batch.n_seq_id[i] = 1;
+        batch.seq_id[i][0] = seq->seq_id;
+        batch.logits[i] = logits;
+        if (logits)
+        {
+            seq->logits_index = i;
+        }
+    };
+
+    for (LlamaGenerationSequence *seq : sequences)
+    {
+        if (seq->finished || seq->is_prefilling() || seq->pending_token == LLAMA_TOKEN_NULL ||
+            static_cast<size_t>(batch.n_tokens) >= n_batch)
+            continue;
+        const size_t pos = sessions_[seq->slot_key].tokens.size();
+        add_token(seq, seq->pending_token, static_cast<llama_pos>(pos), true);
+        spans.push_back({seq, 1});
+    }
+
+    const size_t n_decoding = static_cast<size_t>(batch.n_tokens);
+    const size_t prefill_budget = n_decoding > 0
+                                      ? std::min(n_batch - n_decoding, std::max<size_t>(1, llama_n_ubatch(ctx_)))
+                                      : n_batch;
+    size_t n_prefill = 0;
+
+    for (LlamaGenerationSequence *seq : sequences)
+    {
+        const size_t room = prefill_budget - n_prefill;
+        if (seq->finished || !seq->is_prefilling() || room == 0)
+            continue;
+        size_t n_chunk = std::min(room, seq->prompt_tokens.size() - seq->n_past);
+        if (seq->params.n_batch > 0)
+        {
+            n_chunk = std::min(n_chunk, static_cast<size_t>(seq->params.n_batch));
+        }
+        n_prefill += n_chunk;
+        for (size_t i = 0; i < n_chunk; ++i)
+        {
+            const size_t pos = seq->n_past + i;
+            add_token(seq, seq->prompt_tokens[pos], static_cast<llama_pos>(pos), pos == seq->prompt_tokens.size() - 1);
+        }
+        spans.push_back({seq, n_chunk});
+    }
+
+    const int32_t n_decoded = batch.n_tokens;
+    compose_span.set_arg("n_tokens", n_decoded);
+    compose_span.finish();
+    if (n_decoded == 0)
+    {
+        llama_batch_free(batch);
+        return 0;
+    }
+
+    abort_watch_.clear();
+    for (const Span &span : spans)
+    {
+        if (std::find(abort_watch_.begin(), abort_watch_.end(), span.seq) == abort_watch_.end())
+        {
+            abort_watch_.push_back(span.seq);
+        }
+    }
+
+    const MetricsRegistry::clock::time_point decode_start = MetricsRegistry::clock::now();
+    int ret = 0;
+    {
+        TraceSpan span(n_prefill > 0 ? "llama_decode_prefill" : "llama_decode", "llama");
+        span.set_arg("n_tokens", n_decoded);
+        do
+        {
+            ret = llama_decode(ctx_, batch);
+        } while (ret == 1 && evict_lru_session());
+    }
+    abort_watch_.clear();
+    if (ret == 0 && metrics_)
+    {
+        // A mixed step counts in both phases: its decoding sequences waited for all of it.
+        const MetricsRegistry::clock::time_point decode_end = MetricsRegistry::clock::now();
+        if (n_prefill > 0)
+        {
+            metrics_->record(MetricPhase::Prefill, decode_start, decode_end);
+        }
+        if (n_decoding > 0)
+        {
+            metrics_->record(MetricPhase::Decode, decode_start, decode_end);
+        }
+    }
+
+    if (ret == 2)
+    {
+        // Ubatches processed before the abort stay in the KV cache; drop them so the cache
+        // matches the token mirrors again.
+        llama_batch_free(batch);
+        llama_memory_t mem = llama_get_memory(ctx_);
+        for (const Span &span : spans)
+        {
+            if (span.seq->finished)
+                continue;
+            const LlamaSequenceSlot &slot = sessions_[span.seq->slot_key];
+            llama_memory_seq_rm(mem, slot.seq_id, static_cast<llama_pos>(slot.tokens.size()), -1);
+            span.seq->logits_index = -1;
+            if (!interrupt_if_requested(*span.seq))
+            {
+                span.seq->result.text = "[Error: Failed to decode]";
+                finish_sequence_locked(*span.seq);
+            }
+        }
+        return 0;
+    }
+
+    if (ret != 0)
+    {
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+        {
+            std::cerr << "LlamaInterface Error: llama_decode failed with status " << ret << std::endl;
+        }
+        llama_batch_free(batch);
+        for (const Span &span : spans)
+        {
+            span.seq->result.text = "[Error: Failed to decode]";
+            finish_sequence_locked(*span.seq);
+        }
+        return -1;
+    }
+
+    for (const Span &span : spans)
+    {
+        LlamaGenerationSequence *seq = span.seq;
+        LlamaSequenceSlot &slot = sessions_[seq->slot_key];
+        if (seq->is_prefilling())
+        {
+            slot.tokens.insert(slot.tokens.end(), seq->prompt_tokens.begin() + seq->n_past,
+                               seq->prompt_tokens.begin() + seq->n_past + span.n_tokens);
+            seq->n_past += span.n_tokens;
+            if (!seq->is_prefilling() && seq->fresh)
+            {
+                cache_prompt_prefix(slot);
+            }
+            if (seq->on_prefill && !seq->on_prefill(seq->n_past, seq->prompt_tokens.size()))
+            {
+                seq->result.text = "[Error: Prefill cancelled]";
+                seq->result.finish_reason = "cancelled";
+                finish_sequence_locked(*seq);
+                continue;
+            }
+        }
+        else
+        {
+            slot.tokens.push_back(seq->pending_token);
+        }
+
+        if (seq->logits_index >= 0 && !sample_sequence(*seq))
+        {
+            finish_sequence_locked(*seq);
+        }
+    }
+
+    llama_batch_free(batch);
+    return n_decoded;
+}
+
+/**
+ * @brief Finishes a sequence, freeing its sampler and releasing stateless KV state.
+ *
+ * Safe to call more than once. Session sequences keep their KV cache for the next turn.
+ *
+ * @param sequence The sequence to finish.
+ */
+void LlamaInterface::finish_sequence(LlamaGenerationSequence &sequence)
+{
+    std::lock_guard<std::mutex> lock(context_mutex_);
+    finish_sequence_locked(sequence);
+}
+
+void LlamaInterface::finish_sequence_locked(LlamaGenerationSequence &sequence)
+{
+    sequence.finished = true;
+    if (sequence.released)
+    {
+        return;
+    }
+    sequence.released = true;
+
+    if (sequence.sampler)
+    {
+        llama_sampler_free(sequence.sampler);
+        sequence.sampler = nullptr;
+    }
+
+    const bool failed = sequence.result.text.rfind("[Error", 0) == 0;
+    sequence.result.success = !failed;
+    if (failed && sequence.result.finish_reason.empty())
+    {
+        sequence.result.finish_reason = "error";
+    }
+    else if (sequence.result.finish_reason.empty())
+    {
+        sequence.result.finish_reason = "stop";
+    }
+    if (sequence.parked)
+    {
+        // The sequence id was given back when the sequence was parked; drop the saved state.
+        sequence.parked = false;
+        std::vector<uint8_t>().swap(sequence.parked_state);
+        std::vector<llama_token>().swap(sequence.parked_tokens);
+    }
+    else if (sequence.stateless || failed)
+    {
+        release_sequence(sequence.slot_key);
+    }
+    else
+    {
+        auto it = sessions_.find(sequence.slot_key);
+        if (it != sessions_.end())
+        {
+            it->second.busy = false;
+        }
+    }
+
+    sequence.result.decode_duration_ms = std::chrono::duration<double, std::milli>(
+                                             std::chrono::high_resolution_clock::now() - sequence.start_time)
+                                             .count() -
+                                         sequence.tokenize_duration_ms;
+
+    if (metrics_)
+    {
+        metrics_->record_ms(MetricPhase::Generation, sequence.result.decode_duration_ms + sequence.tokenize_duration_ms);
+        metrics_->add(MetricCounter::Requests);
+        metrics_->add(MetricCounter::GeneratedTokens, static_cast<uint64_t>(std::max(0, sequence.result.tokens_generated)));
+        metrics_->add(MetricCounter::LookupDraftedTokens, static_cast<uint64_t>(sequence.result.lookup_draft_tokens));
+        metrics_->add(MetricCounter::LookupAcceptedTokens, static_cast<uint64_t>(sequence.result.accepted_lookup_tokens));
+        if (failed)
+        {
+            metrics_->add(MetricCounter::FailedRequests);
+        }
+    }
+}
+
+/**
+ * @brief Moves the KV state of an unfinished sequence to host memory and frees its sequence id.
+ *
+ * Used by the batching scheduler to preempt background work when a higher-priority
+ * request needs a KV-cache sequence. The sequence keeps its sampler, prompt progress and
+ * generated text; resume_sequence() puts the state back, so the generation continues
+ * exactly where it stopped without prefilling anything again. The cells the sequence
+ * shared with the prefix cache are saved as its own.
+ *
+ * @param sequence The sequence to park.
+ * @return true if the sequence is parked, false if it could not be (it is left untouched then).
+ */
+bool LlamaInterface::park_sequence(LlamaGenerationSequence &sequence)
+{
+    std::lock_guard<std::mutex> lock(context_mutex_);
+    if (sequence.finished || sequence.released || sequence.parked)
+    {
+        return false;
+    }
+    auto it = sessions_.find(sequence.slot_key);
+    if (it == sessions_.end())
+    {
+        return false;
+    }
+
+    const llama_seq_id seq_id = it->second.seq_id;
+    std::vector<uint8_t> state(llama_state_seq_get_size(ctx_, seq_id));
+    if (!state.empty() && llama_state_seq_get_data(ctx_, state.data(), state.size(), seq_id) != state.size())
+    {
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+        {
+            std::cerr << "LlamaInterface Error: failed to save the KV state of sequence " << seq_id << std::endl;
+        }
+        return false;
+    }
+
+    sequence.parked_state = std::move(state);
+    sequence.parked_tokens = std::move(it->second.tokens);
+    sequence.parked = true;
+    release_sequence(sequence.slot_key);
+    sequence.seq_id = -1;
+    return true;
+}
+
+/**
+ * @brief Puts the KV state of a parked sequence back into a free KV-cache sequence.
+ *
+ * @param sequence The parked sequence.
+ * @return true if the sequence can be decoded again (or finished with an error because its
+ *         state no longer fits), false if no sequence is free yet.
+ */
+bool LlamaInterface::resume_sequence(LlamaGenerationSequence &sequence)
+{
+    std::lock_guard<std::mutex> lock(context_mutex_);
+    if (!sequence.parked)
+    {
+        return true;
+    }
+    LlamaSequenceSlot *slot = acquire_sequence(sequence.slot_key, sequence.stateless);
+    if (!slot)
+    {
+        return false;
+    }
+
+    llama_memory_seq_rm(llama_get_memory(ctx_), slot->seq_id, -1, -1);
+    if (draft_ctx_)
+    {
+        llama_memory_seq_rm(llama_get_memory(draft_ctx_), slot->seq_id, -1, -1);
+    }
+    slot->draft_tokens.clear();
+    slot->n_shared = 0;
+    sequence.seq_id = slot->seq_id;
+    sequence.parked = false;
+
+    if (!sequence.parked_state.empty() &&
+        llama_state_seq_set_data(ctx_, sequence.parked_state.data(), sequence.parked_state.size(), slot->seq_id) == 0)
+    {
+        slot->tokens.clear();
+        sequence.result.text = "[Error: Failed to resume preempted sequence]";
+        finish_sequence_locked(sequence);
+    }
+    else
+    {
+        slot->tokens = std::move(sequence.parked_tokens);
+    }
+    std::vector<uint8_t>().swap(sequence.parked_state);
+    std::vector<llama_token>().swap(sequence.parked_tokens);
+    return true;
+}
+
+/**
+ * @brief Finishes a sequence that is not being decoded if its handle asks for it.
+ *
+ * Decode steps check the handles of the sequences they run; this covers sequences that
+ * are parked or held back by the scheduler.
+ *
+ * @param sequence The sequence to check.
+ * @return true if the sequence has been finished.
+ */
+bool LlamaInterface::poll_interrupt(LlamaGenerationSequence &sequence)
+{
+    std::lock_guard<std::mutex> lock(context_mutex_);
+    return !sequence.finished && interrupt_if_requested(sequence);
+}
+
+/**
+ * @brief Loads the draft model used for speculative decoding.
+ *
+ * The draft gets its own context with the same size as the main one and one sequence per
+ * session, so each session's draft KV cache can be kept in sync with the main one. The
+ * draft vocabulary must match the main vocabulary token for token.
+ *
+ * @param ctx_p The context parameters of the main context.
+ * @return true if the draft model is ready, false otherwise (nothing is left loaded).
+ */
+bool LlamaInterface::load_draft_model(const llama_context_params &ctx_p)
+{
+    llama_model_params model_p = llama_model_default_params();
+    model_p.n_gpu_layers = std::max(0, current_model_params_.draft_n_gpu_layers);
+    model_p.main_gpu = current_model_params_.main_gpu;
+    model_p.use_mmap = current_model_params_.use_map;
+    model_p.use_mlock = current_model_params_.use_mlock;
+
+    if (model_p.use_mmap)
+    {
+        prefetch_model_file(current_model_params_.draft_model_path);
+    }
+
+    draft_model_ = llama_model_load_from_file(current_model_params_.draft_model_path.c_str(), model_p);
+    if (!draft_model_)
+    {
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+        {
+            std::cerr << "LlamaInterface Error: unable to load draft model from " << current_model_params_.draft_model_path << std::endl;
+        }
+        return false;
+    }
+
+    const llama_vocab *draft_vocab = llama_model_get_vocab(draft_model_);
+    if (!draft_vocab || llama_vocab_type(draft_vocab) != llama_vocab_type(vocab_) ||
+        llama_vocab_n_tokens(draft_vocab) != llama_vocab_n_tokens(vocab_) ||
+        llama_vocab_bos(draft_vocab) != llama_vocab_bos(vocab_) ||
+        llama_vocab_eos(draft_vocab) != llama_vocab_eos(vocab_))
+    {
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+        {
+            std::cerr << "LlamaInterface Error: draft model vocabulary does not match the main model" << std::endl;
+        }
+        unload_draft_model();
+        return false;
+    }
+
+    llama_context_params draft_p = ctx_p;
+    draft_p.n_seq_max = static_cast<uint32_t>(current_model_params_.n_seq_max);
+    draft_ctx_ = llama_init_from_model(draft_model_, draft_p);
+    if (!draft_ctx_)
+    {
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+        {
+            std::cerr << "LlamaInterface Error: failed to create draft llama_context" << std::endl;
+        }
+        unload_draft_model();
+        return false;
+    }
+
+    draft_sampler_ = llama_sampler_init_greedy();
+    speculative_stats_ = HegemonikonSpeculativeStats();
+    if (HegemonikonLog::enabled(HegemonikonLogLevel::Info))
+    {
+        std::cerr << "LlamaInterface: Draft model loaded: " << current_model_params_.draft_model_path << std::endl;
+    }
+    return true;
+}
+
+/**
+ * @brief Frees the draft model, its context and sampler.
+ */
+void LlamaInterface::unload_draft_model()
+{
+    if (draft_sampler_)
+    {
+        llama_sampler_free(draft_sampler_);
+        draft_sampler_ = nullptr;
+    }
+    if (draft_ctx_)
+    {
+        llama_free(draft_ctx_);
+        draft_ctx_ = nullptr;
+    }
+    if (draft_model_)
+    {
+        llama_model_free(draft_model_);
+        draft_model_ = nullptr;
+    }
+    for (auto &entry : sessions_)
+    {
+        entry.second.draft_tokens.clear();
+    }
+}
+
+/**
+ * @brief Brings the draft KV cache of a slot up to date with the main one plus one token.
+ *
+ * The draft keeps the longest prefix it shares with the main sequence; whatever the main
+ * model rejected or skipped (session diffing, prefix cache hits) is removed and the missing
+ * tokens are decoded into the draft, followed by `next_token`. Afterwards the draft logits
+ * are those following `next_token`.
+ *
+ * @param slot       The sequence slot to synchronize.
+ * @param next_token The token about to be verified by the main model.
+ * @return true on success, false if the draft could not decode (its sequence is then cleared).
+ */
+bool LlamaInterface::sync_draft(LlamaSequenceSlot &slot, llama_token next_token)
+{
+    llama_memory_t draft_mem = llama_get_memory(draft_ctx_);
+
+    size_t n_common = 0;
+    const size_t n_max = std::min(slot.draft_tokens.size(), slot.tokens.size());
+    while (n_common < n_max && slot.draft_tokens[n_common] == slot.tokens[n_common])
+    {
+        ++n_common;
+    }
+    llama_memory_seq_rm(draft_mem, slot.seq_id, static_cast<llama_pos>(n_common), -1);
+    slot.draft_tokens.resize(n_common);
+
+    std::vector<llama_token> missing(slot.tokens.begin() + n_common, slot.tokens.end());
+    missing.push_back(next_token);
+
+    const size_t n_batch = std::max<size_t>(1, llama_n_batch(draft_ctx_));
+    llama_batch batch = llama_batch_init(static_cast<int32_t>(n_batch), 0, 1);
+    for (size_t begin = 0; begin < missing.size(); begin += n_batch)
+    {
+        const size_t end = std::min(missing.size(), begin + n_batch);
+        batch.n_tokens = 0;
+        for (size_t i = begin; i < end; ++i)
+        {
+            const int32_t j = batch.n_tokens++;
+            batch.token[j] = missing[i];
+            batch.pos[j] = static_cast<llama_pos>(n_common + i);
+            batch.n_seq_id[j] = 1;
+            batch.seq_id[j][0] = slot.seq_id;
+            batch.logits[j] = (i == missing.size() - 1);
+        }
+        if (llama_decode(draft_ctx_, batch) != 0)
+        {
+            llama_batch_free(batch);
+            llama_memory_seq_rm(draft_mem, slot.seq_id, -1, -1);
+            slot.draft_tokens.clear();
+            return false;
+        }
+        slot.draft_tokens.insert(slot.draft_tokens.end(), missing.begin() + begin, missing.begin() + end);
+    }
+    llama_batch_free(batch);
+    return true;
+}
+
+/**
+ * @brief Number of leading tokens a context shift keeps for a request.
+ *
+ * At least the BOS token is kept when the vocabulary adds one, and never more than half
+ * of the context, so a shift always frees a meaningful part of the window.
+ *
+ * @param n_keep The n_keep of the generation parameters.
+ * @return size_t The number of tokens to keep.
+ */
+size_t LlamaInterface::keep_length(int32_t n_keep) const
+{
+    size_t n = static_cast<size_t>(std::max(0, n_keep));
+    if (n == 0 && llama_vocab_get_add_bos(vocab_))
+    {
+        n = 1;
+    }
+    return std::min(n, static_cast<size_t>(llama_n_ctx(ctx_)) / 2);
+}
+
+/**
+ * @brief Discards the oldest tokens after the kept prefix of a full sequence.
+ *
+ * Half of the tokens following the first `n_keep` are removed from the KV cache and the
+ * positions of the remaining ones are moved down with `llama_memory_seq_add`; llama.cpp
+ * re-rotates the shifted keys before the next decode, so generation continues without
+ * any prefill. A shift moves a KV cell for every sequence holding it, so the discarded
+ * range always covers the positions shared with other sequences through the prefix
+ * cache. The draft sequence is shifted the same way, or trimmed when it cannot be.
+ *
+ * @param slot   The sequence slot whose context is full.
+ * @param n_keep The n_keep of the generation parameters.
+ * @return size_t Number of tokens discarded, 0 if the context could not be shifted.
+ */
+size_t LlamaInterface::shift_context(LlamaSequenceSlot &slot, int32_t n_keep)
+{
+    llama_memory_t mem = llama_get_memory(ctx_);
+    if (!llama_memory_can_shift(mem))
+    {
+        return 0;
+    }
+
+    const size_t n_past = slot.tokens.size();
+    const size_t n_kept = std::min(keep_length(n_keep), n_past);
+    const size_t n_discard = std::max((n_past - n_kept) / 2, slot.n_shared > n_kept ? slot.n_shared - n_kept : 0);
+    if (n_discard == 0 || n_kept + n_discard >= n_past)
+    {
+        return 0;
+    }
+
+    const llama_pos p0 = static_cast<llama_pos>(n_kept);
+    const llama_pos p1 = static_cast<llama_pos>(n_kept + n_discard);
+    llama_memory_seq_rm(mem, slot.seq_id, p0, p1);
+    llama_memory_seq_add(mem, slot.seq_id, p1, -1, -static_cast<llama_pos>(n_discard));
+    slot.tokens.erase(slot.tokens.begin() + n_kept, slot.tokens.begin() + n_kept + n_discard);
+    slot.n_shared = std::min(slot.n_shared, n_kept);
+
+    if (draft_ctx_)
+    {
+        llama_memory_t draft_mem = llama_get_memory(draft_ctx_);
+        if (slot.draft_tokens.size() > n_kept + n_discard && llama_memory_can_shift(draft_mem))
+        {
+            llama_memory_seq_rm(draft_mem, slot.seq_id, p0, p1);
+            llama_memory_seq_add(draft_mem, slot.seq_id, p1, -1, -static_cast<llama_pos>(n_discard));
+            slot.draft_tokens.erase(slot.draft_tokens.begin() + n_kept, slot.draft_tokens.begin() + n_kept + n_discard);
+        }
+        else
+        {
+            llama_memory_seq_rm(draft_mem, slot.seq_id, p0, -1);
+            slot.draft_tokens.resize(std::min(slot.draft_tokens.size(), n_kept));
+        }
+    }
+    return n_discard;
+}
+
+/**
+ * @brief Number of tokens a sequence may have drafted in its next step.
+ *
+ * Leaves room in the request's n_predict, the context and the batch for the pending
+ * token and the one sampled after the drafts.
+ *
+ * @param n_max The draft length asked for by the generation parameters.
+ */
+int32_t LlamaInterface::draft_limit(const LlamaGenerationSequence &sequence, const LlamaSequenceSlot &slot,
+                                    int32_t n_max) const
+{
+    const int64_t n_ctx = static_cast<int64_t>(llama_n_ctx(ctx_));
+    int64_t n_draft = n_max;
+    n_draft = std::min<int64_t>(n_draft, sequence.params.n_predict - sequence.result.tokens_generated - 1);
+    n_draft = std::min<int64_t>(n_draft, n_ctx - static_cast<int64_t>(slot.tokens.size()) - 2);
+    n_draft = std::min<int64_t>(n_draft, static_cast<int64_t>(llama_n_batch(ctx_)) - 1);
+    return static_cast<int32_t>(std::max<int64_t>(n_draft, 0));
+}
+
+/**
+ * @brief Verifies drafted tokens with the main model and keeps the longest agreeing prefix.
+ *
+ * The pending token and all drafts are decoded in one batch, with logits for every
+ * position, and the sequence's own sampler is run position by position: a drafted token
+ * is accepted while the main model samples exactly that token, and the first disagreement
+ * becomes the next pending token. Every emitted token is therefore sampled by the main
+ * model, so the output distribution does not depend on where the drafts came from.
+ * Rejected drafts are removed from the KV cache.
+ *
+ * @param sequence   The sequence, which must have a pending token.
+ * @param slot       Its sequence slot.
+ * @param drafted    The tokens proposed after the pending token.
+ * @param n_accepted Set to the number of drafts accepted.
+ * @param active     Set to false if the sequence ended; the caller finishes it.
+ * @return Number of tokens decoded, or 0 if the batch could not be decoded (the sequence
+ *         is then unchanged).
+ */
+int32_t LlamaInterface::verify_drafts(LlamaGenerationSequence &sequence, LlamaSequenceSlot &slot,
+                                      const std::vector<llama_token> &drafted, int32_t &n_accepted, bool &active)
+{
+    const size_t pos0 = slot.tokens.size();
+    const int32_t n_verify = static_cast<int32_t>(drafted.size()) + 1;
+    llama_batch batch = llama_batch_init(n_verify, 0, 1);
+    batch.n_tokens = n_verify;
+    for (int32_t i = 0; i < n_verify; ++i)
+    {
+        batch.token[i] = i == 0 ? sequence.pending_token : drafted[i - 1];
+        batch.pos[i] = static_cast<llama_pos>(pos0 + i);
+        batch.n_seq_id[i] = 1;
+        batch.seq_id[i][0] = slot.seq_id;
+        batch.logits[i] = true;
+    }
+
+    const MetricsRegistry::clock::time_point decode_start = MetricsRegistry::clock::now();
+    int ret = 0;
+    {
+        TraceSpan span("llama_decode_verify", "llama");
+        span.set_arg("n_tokens", n_verify);
+        do
+        {
+            ret = llama_decode(ctx_, batch);
+        } while (ret == 1 && evict_lru_session());
+    }
+    llama_batch_free(batch);
+    if (ret == 0 && metrics_)
+    {
+        metrics_->record(MetricPhase::Decode, decode_start, MetricsRegistry::clock::now());
+    }
+
+    llama_memory_t mem = llama_get_memory(ctx_);
+    if (ret != 0)
+    {
+        llama_memory_seq_rm(mem, slot.seq_id, static_cast<llama_pos>(pos0), -1);
+        return 0;
+    }
+
+    slot.tokens.push_back(sequence.pending_token);
+    n_accepted = 0;
+    active = true;
+    for (int32_t i = 0; i < n_verify; ++i)
+    {
+        const llama_token token = llama_sampler_sample(sequence.sampler, ctx_, i);
+        active = accept_token(sequence, token);
+        if (!active)
+        {
+            break;
+        }
+        if (i + 1 < n_verify && token == drafted[i])
+        {
+            // Already decoded as part of the verification batch.
+            slot.tokens.push_back(token);
+            sequence.pending_token = LLAMA_TOKEN_NULL;
+            ++n_accepted;
+            continue;
+        }
+        break;
+    }
+    llama_memory_seq_rm(mem, slot.seq_id, static_cast<llama_pos>(slot.tokens.size()), -1);
+    return n_verify;
+}
+
+/**
+ * @brief Runs one speculative decoding step for a single decoding sequence.
+ *
+ * The draft model greedily proposes up to `n_draft` tokens after the pending token, then
+ * verify_drafts() checks them with the main model.
+ *
+ * @param sequence The sequence, which must have a pending token.
+ * @return Number of tokens decoded by the main model, or 0 if speculation was not
+ *         possible and a regular step should be run instead.
+ */
+int32_t LlamaInterface::speculative_step(LlamaGenerationSequence &sequence)
+{
+    auto slot_it = sessions_.find(sequence.slot_key);
+    if (slot_it == sessions_.end())
+    {
+        return 0;
+    }
+    LlamaSequenceSlot &slot = slot_it->second;
+
+    const size_t pos0 = slot.tokens.size();
+    const int32_t n_draft = draft_limit(sequence, slot, sequence.params.n_draft);
+    if (n_draft <= 0 || !sync_draft(slot, sequence.pending_token))
+    {
+        return 0;
+    }
+
+    TraceSpan draft_span("llama_draft", "llama");
+    std::vector<llama_token> drafted;
+    drafted.reserve(static_cast<size_t>(n_draft));
+    llama_batch single = llama_batch_init(1, 0, 1);
+    for (int32_t i = 0; i < n_draft; ++i)
+    {
+        const llama_token token = llama_sampler_sample(draft_sampler_, draft_ctx_, -1);
+        drafted.push_back(token);
+        if (i + 1 == n_draft || llama_vocab_is_eog(vocab_, token))
+        {
+            break;
+        }
+
+        single.n_tokens = 1;
+        single.token[0] = token;
+        single.pos[0] = static_cast<llama_pos>(pos0 + 1 + i);
+        single.n_seq_id[0] = 1;
+        single.seq_id[0][0] = slot.seq_id;
+        single.logits[0] = true;
+        if (llama_decode(draft_ctx_, single) != 0)
+        {
+            break;
+        }
+        slot.draft_tokens.push_back(token);
+    }
+    llama_batch_free(single);
+    draft_span.set_arg("n_tokens", static_cast<int64_t>(drafted.size()));
+    draft_span.finish();
+
+    int32_t n_accepted = 0;
+    bool active = true;
+    const int32_t n_verify = verify_drafts(sequence, slot, drafted, n_accepted, active);
+    if (n_verify == 0)
+    {
+        return 0;
+    }
+
+    speculative_stats_.verify_steps++;
+    speculative_stats_.drafted_tokens += drafted.size();
+    speculative_stats_.accepted_tokens += static_cast<uint64_t>(n_accepted);
+    sequence.result.draft_tokens += static_cast<int32_t>(drafted.size());
+    sequence.result.accepted_draft_tokens += n_accepted;
+
+    if (!active)
+    {
+        finish_sequence_locked(sequence);
+    }
+    return n_verify;
+}
+
+/**
+ * @brief Runs one prompt-lookup decoding step for a single decoding sequence.
+ *
+ * The n-gram index of the sequence is brought up to date with its KV tokens and the
+ * pending token; if the last tokens appeared earlier in the context, the tokens that
+ * followed them are verified by verify_drafts(). Costs no model evaluation when nothing
+ * matches.
+ *
+ * @param sequence The sequence, which must have a pending token.
+ * @return Number of tokens decoded, or 0 if there was nothing to propose and another
+ *         kind of step should be run instead.
+ */
+int32_t LlamaInterface::lookup_step(LlamaGenerationSequence &sequence)
+{
+    auto slot_it = sessions_.find(sequence.slot_key);
+    if (slot_it == sessions_.end())
+    {
+        return 0;
+    }
+    LlamaSequenceSlot &slot = slot_it->second;
+
+    const int32_t n_draft = draft_limit(sequence, slot, sequence.params.n_lookup_draft);
+    if (n_draft <= 0)
+    {
+        return 0;
+    }
+
+    TraceSpan lookup_span("llama_prompt_lookup", "llama");
+    std::vector<llama_token> drafted;
+    sequence.lookup.sync(slot.tokens);
+    sequence.lookup.push(sequence.pending_token);
+    sequence.lookup.draft(static_cast<size_t>(n_draft), drafted);
+    lookup_span.set_arg("n_tokens", static_cast<int64_t>(drafted.size()));
+    lookup_span.finish();
+    if (drafted.empty())
+    {
+        return 0;
+    }
+
+    int32_t n_accepted = 0;
+    bool active = true;
+    const int32_t n_verify = verify_drafts(sequence, slot, drafted, n_accepted, active);
+    if (n_verify == 0)
+    {
+        return 0;
+    }
+
+    sequence.result.lookup_draft_tokens += static_cast<int32_t>(drafted.size());
+    sequence.result.accepted_lookup_tokens += n_accepted;
+
+    if (!active)
+    {
+        finish_sequence_locked(sequence);
+    }
+    return n_verify;
+}
+
+/**
+ * @brief Checks whether a draft model is loaded for speculative decoding.
+ */
+bool LlamaInterface::has_draft_model() const
+{
+    std::lock_guard<std::mutex> lock(context_mutex_);
+    return draft_ctx_ != nullptr;
+}
+
+/**
+ * @brief Returns the cumulative speculative decoding counters.
+ *
+ * @return HegemonikonSpeculativeStats A snapshot of the counters.
+ */
+HegemonikonSpeculativeStats LlamaInterface::get_speculative_stats() const
+{
+    std::lock_guard<std::mutex> lock(context_mutex_);
+    return speculative_stats_;
+}
 
-    llama_sampler_chain_add(smpl, llama_sampler_init_penalties(
-                                      params.penalty_last_n,
-                                      params.repeat_penalty,
-                                      params.penalty_freq,
-                                      params.penalty_present));
+/**
+ * @brief Resets the speculative decoding counters.
+ */
+void LlamaInterface::reset_speculative_stats()
+{
+    std::lock_guard<std::mutex> lock(context_mutex_);
+    speculative_stats_ = HegemonikonSpeculativeStats();
+}
 
-    llama_sampler_chain_add(smpl, llama_sampler_init_min_p(0.05f, 1));
+/**
+ * @brief Estimates the memory held by the loaded model(s).
+ *
+ * Weights are taken from llama_model_size and the KV cache is sized for the full context
+ * with the configured cache types. Both are split between host and device memory in proportion to the offloaded
+ * layers. The draft model, when loaded, is included.
+ *
+ * @return HegemonikonModelFootprint The footprint, all zero if no model is loaded.
+ */
+HegemonikonModelFootprint LlamaInterface::get_memory_footprint() const
+{
+    HegemonikonModelFootprint footprint;
+    if (!is_model_loaded())
+    {
+        return footprint;
+    }
 
-    llama_sampler_chain_add(smpl, llama_sampler_init_top_k(params.top_k));
+    const double kv_element_bytes = cache_type_bytes(current_model_params_.cache_type_k) +
+                                    cache_type_bytes(current_model_params_.cache_type_v);
+    auto add_model = [&footprint, kv_element_bytes](const llama_model *model, const llama_context *ctx, int32_t n_gpu_layers)
+    {
+        const int32_t n_layer = std::max(1, llama_model_n_layer(model));
+        const int32_t n_head = std::max(1, llama_model_n_head(model));
+        const uint64_t n_embd_kv = static_cast<uint64_t>(llama_model_n_embd(model)) * llama_model_n_head_kv(model) / n_head;
+        const uint64_t kv_bytes = ctx ? static_cast<uint64_t>(kv_element_bytes * llama_n_ctx(ctx) * n_layer * n_embd_kv) : 0;
+        const uint64_t total = llama_model_size(model) + kv_bytes;
+
+        const double offloaded = llama_supports_gpu_offload()
+                                     ? std::clamp(static_cast<double>(n_gpu_layers) / n_layer, 0.0, 1.0)
+                                     : 0.0;
+        const uint64_t vram = static_cast<uint64_t>(static_cast<double>(total) * offloaded);
+        footprint.vram_bytes += vram;
+        footprint.ram_bytes += total - vram;
+    };
+
+    add_model(model_, ctx_, current_model_params_.n_gpu_layers);
+    if (draft_model_)
+    {
+        add_model(draft_model_, draft_ctx_, current_model_params_.draft_n_gpu_layers);
+    }
+    return footprint;
+}
 
-    llama_sampler_chain_add(smpl, llama_sampler_init_top_p(params.top_p, 1));
-    llama_sampler_chain_add(smpl, llama_sampler_init_temp(params.temperature));
+/**
+ * @brief Estimates the memory a model will need before it is loaded.
+ *
+ * Only the GGUF file sizes are known at that point; they are charged to device memory
+ * when any layer is offloaded and to host memory otherwise. The KV cache is not
+ * included, which is why callers should use get_memory_footprint once loaded.
+ *
+ * @param params The parameters the model would be loaded with.
+ * @return HegemonikonModelFootprint The estimate, zero for files that cannot be read.
+ */
+HegemonikonModelFootprint LlamaInterface::estimate_memory_footprint(const HegemonikonLlamaModelParams &params)
+{
+    HegemonikonModelFootprint footprint;
+    auto add_file = [&footprint](const std::string &path, int32_t n_gpu_layers)
+    {
+        if (path.empty())
+        {
+            return;
+        }
+        std::error_code ec;
+        const uintmax_t size = std::filesystem::file_size(path, ec);
+        if (ec)
+        {
+            return;
+        }
+        if (n_gpu_layers > 0 && llama_supports_gpu_offload())
+        {
+            footprint.vram_bytes += size;
+        }
+        else
+        {
+            footprint.ram_bytes += size;
+        }
+    };
 
-    llama_sampler_chain_add(smpl, llama_sampler_init_dist(LLAMA_DEFAULT_SEED));
+    add_file(params.model_path, params.n_gpu_layers);
+    add_file(params.draft_model_path, params.draft_n_gpu_layers);
+    return footprint;
+}
 
-    return smpl;
+/**
+ * @brief Returns how many sequences can generate concurrently.
+ *
+ * @return uint32_t The size of the session sequence pool, or 0 if no model is loaded.
+ */
+uint32_t LlamaInterface::get_max_sequences() const
+{
+    if (!is_model_loaded())
+        return 0;
+    return static_cast<uint32_t>(current_model_params_.n_seq_max);
 }
 
 /**
- * @brief Generates a text completion based on the provided prompt and generation parameters.
+ * @brief Offers a freshly prefilled prompt to the prefix cache.
  *
- * This function uses the currently loaded Llama model to generate a completion for the given prompt text.
- * It handles model loading checks, prompt tokenization, context management, and sampling according to the specified
- * generation parameters. The function supports stopping generation based on a maximum number of tokens or custom stop sequences.
+ * Only called for prompts that did not continue a session, so that conversation
+ * history never competes with shared preambles for cache space.
  *
- * @param prompt_text The input prompt for which to generate a completion.
- * @param gen_params  The parameters controlling text generation (e.g., number of tokens, stop sequences).
- * @return The generated completion as a string. Returns an error message string if the model is not loaded,
- *         the prompt is empty, the context size is exceeded, or an exception occurs during generation.
+ * With a unified KV cache `llama_memory_seq_cp` only tags the existing cells with
+ * the reserved sequence, so caching a prefix costs no extra compute.
+ *
+ * @param slot The sequence that has just been prefilled with the prompt.
  */
-std::string LlamaInterface::generate_completion(const std::string &prompt_text, const HegemonikonGenerationParams &gen_params, double &ttft_ms, double &decode_duration_ms, int32_t &tokens_generated)
+void LlamaInterface::cache_prompt_prefix(LlamaSequenceSlot &slot)
 {
+    llama_seq_id prefix_seq = -1;
+    std::vector<llama_seq_id> evicted;
+    const size_t n_cache = prefix_cache_.insert(slot.tokens, slot.tokens.size(), prefix_seq, evicted);
+    if (n_cache == 0)
+    {
+        return;
+    }
 
-    auto start = std::chrono::high_resolution_clock::now();
-    if (!is_model_loaded())
+    llama_memory_t mem = llama_get_memory(ctx_);
+    for (llama_seq_id seq : evicted)
     {
-        return "[Error: Model not loaded]";
+        llama_memory_seq_rm(mem, seq, -1, -1);
     }
+    llama_memory_seq_cp(mem, slot.seq_id, prefix_seq, 0, static_cast<llama_pos>(n_cache));
+    slot.n_shared = std::max(slot.n_shared, n_cache);
+}
 
-    if (prompt_text.empty())
+/**
+ * @brief Drops the KV cache held for a session.
+ *
+ * @param session_id The session identifier.
+ * @return true if the session was resident and has been released, false otherwise.
+ */
+bool LlamaInterface::reset_session(const std::string &session_id)
+{
+    std::lock_guard<std::mutex> lock(context_mutex_);
+    auto it = sessions_.find(session_id);
+    if (!is_model_loaded() || it == sessions_.end() || it->second.busy)
     {
-        return "[Error: Empty prompt]";
+        return false;
     }
+    release_sequence(session_id);
+    return true;
+}
 
-    const llama_vocab *vocab = llama_model_get_vocab(model_);
+/**
+ * @brief Drops the KV cache of every session that is not currently generating.
+ */
+void LlamaInterface::clear_sessions()
+{
+    std::lock_guard<std::mutex> lock(context_mutex_);
+    if (!is_model_loaded())
+    {
+        return;
+    }
+    std::vector<std::string> idle;
+    for (const auto &entry : sessions_)
+    {
+        if (!entry.second.busy)
+            idle.push_back(entry.first);
+    }
+    for (const auto &key : idle)
+    {
+        release_sequence(key);
+    }
+}
 
-    llama_context_params ctx_params = llama_context_default_params();
-    ctx_params.n_ctx = current_model_params_.n_ctx;
-    ctx_params.n_batch = current_model_params_.n_batch;
+/**
+ * @brief Returns the number of sessions currently resident in the KV cache.
+ *
+ * @return size_t The number of resident sessions.
+ */
+size_t LlamaInterface::get_session_count() const
+{
+    std::lock_guard<std::mutex> lock(context_mutex_);
+    return sessions_.size();
+}
 
-    bool first_token = true;
+/**
+ * @brief Checks whether a session has its KV cache in this context.
+ */
+bool LlamaInterface::has_session(const std::string &session_id) const
+{
+    std::lock_guard<std::mutex> lock(context_mutex_);
+    return sessions_.find(session_id) != sessions_.end();
+}
 
-    try
+/**
+ * @brief Returns a fingerprint of the loaded model, the key of its KV session snapshots.
+ *
+ * Hashes the size and modification time of the model file together with the model size
+ * and parameter count reported by llama, so a re-downloaded or re-quantized file never
+ * picks up the snapshots of its predecessor. Hashing the file contents would cost a full
+ * read of several GB. The KV cache types are included since they change the state layout.
+ *
+ * @return uint64_t The fingerprint, 0 if no model is loaded.
+ */
+uint64_t LlamaInterface::get_model_fingerprint() const
+{
+    if (!model_)
     {
-        LlamaContextWrapper ctx(model_, ctx_params);
-        llama_sampler *sampler = create_sampler(gen_params);
-        auto tokenizer_start = std::chrono::high_resolution_clock::now();
-        std::vector<llama_token> prompt_tokens = tokenize(prompt_text, true, false);
-        auto tokenizer_end = std::chrono::high_resolution_clock::now();
-        double tokenizer_duration = std::chrono::duration<double, std::milli>(tokenizer_end - tokenizer_start).count();
-
-        llama_batch batch = llama_batch_get_one(prompt_tokens.data(), prompt_tokens.size());
-        llama_token new_token_id;
+        return 0;
+    }
 
-        std::string completion_text;
+    std::error_code ec;
+    const std::filesystem::path path(current_model_params_.model_path);
+    const uint64_t file_bytes = std::filesystem::file_size(path, ec);
+    const auto mtime = std::filesystem::last_write_time(path, ec).time_since_epoch().count();
+    const uint64_t fields[4] = {ec ? 0 : file_bytes, static_cast<uint64_t>(mtime),
+                                llama_model_size(model_), llama_model_n_params(model_)};
+
+    constexpr uint64_t FNV_OFFSET = 1469598103934665603ULL;
+    constexpr uint64_t FNV_PRIME = 1099511628211ULL;
+    uint64_t h = FNV_OFFSET;
+    for (uint64_t field : fields)
+    {
+        for (int byte = 0; byte < 8; ++byte)
+        {
+            h ^= (field >> (8 * byte)) & 0xff;
+            h *= FNV_PRIME;
+        }
+    }
+    for (char c : current_model_params_.cache_type_k + "/" + current_model_params_.cache_type_v)
+    {
+        h ^= static_cast<unsigned char>(c);
+        h *= FNV_PRIME;
+    }
+    return h;
+}
 
-        int current_nb_predict = 0;
+/**
+ * @brief Writes the KV state of an idle session to a snapshot file.
+ *
+ * The state is copied out of the context with `llama_state_seq_get_data` under the
+ * context lock; the file itself is written without holding it, so other sessions keep
+ * generating. Only the main context is saved: after a restore the draft model, if any,
+ * catches up on its own at the first speculative step.
+ *
+ * @param session_id The session to save.
+ * @param directory  Directory of the snapshots, typically next to the chat database.
+ * @param key        Optional vault key to encrypt the snapshot with.
+ * @return true if the snapshot was written.
+ */
+bool LlamaInterface::save_session_snapshot(const std::string &session_id, const std::string &directory,
+                                           const SecureKey *key)
+{
+    std::vector<llama_token> tokens;
+    std::vector<uint8_t> state;
+    {
+        std::lock_guard<std::mutex> lock(context_mutex_);
+        auto it = sessions_.find(session_id);
+        if (!is_model_loaded() || it == sessions_.end() || it->second.busy || it->second.tokens.empty())
+        {
+            return false;
+        }
 
-        while (true)
+        tokens = it->second.tokens;
+        state.resize(llama_state_seq_get_size(ctx_, it->second.seq_id));
+        if (state.empty() ||
+            llama_state_seq_get_data(ctx_, state.data(), state.size(), it->second.seq_id) != state.size())
         {
-            int n_ctx = llama_n_ctx(ctx);
-            int n_ctx_used = llama_memory_seq_pos_max(llama_get_memory(ctx), 0);
-            const bool is_first = (n_ctx_used == -1);
-            if (n_ctx_used + batch.n_tokens > n_ctx)
+            if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
             {
-                printf("\033[0m\n");
-                fprintf(stderr, "context size exceeded\n");
-                return "[Error: Context size exceeded]";
+                std::cerr << "LlamaInterface Error: failed to copy the KV state of session '" << session_id << "'" << std::endl;
             }
+            return false;
+        }
+    }
 
-            if (llama_decode(ctx, batch))
-            {
-                GGML_ABORT("failed to decode\n");
-            }
+    std::string path;
+    std::string error;
+    const bool ok = LlamaSessionSnapshot::write(directory, get_model_fingerprint(), tokens, state, key, path, error);
+    if (key)
+    {
+        secure_memset(state.data(), 0, state.size());
+        secure_memset(tokens.data(), 0, tokens.size() * sizeof(llama_token));
+    }
+    if (!ok)
+    {
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+        {
+            std::cerr << "LlamaInterface Error: " << error << std::endl;
+        }
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Restores the KV state of a session from the best snapshot for its prompt.
+ *
+ * Looks for the longest snapshot of the loaded model whose tokens start the prompt and
+ * loads it into the session's sequence with `llama_state_seq_set_data`, so the next
+ * request with this session id only prefills what follows. Nothing is done when the
+ * session already holds at least as much of the prompt.
+ *
+ * @param prompt_text The full prompt the conversation is about to be resumed with.
+ * @param params      The generation parameters of that request (session id, BOS and special-token handling).
+ * @param directory   Directory of the snapshots.
+ * @param key         The key the session's snapshots are encrypted with, or nullptr.
+ * @return int32_t Number of prompt tokens now in the KV cache thanks to the snapshot, 0 if none was restored.
+ */
+int32_t LlamaInterface::restore_session_snapshot(const std::string &prompt_text, const HegemonikonGenerationParams &params,
+                                                 const std::string &directory, const SecureKey *key)
+{
+    if (!is_model_loaded() || params.session_id.empty() || prompt_text.empty())
+    {
+        return 0;
+    }
+
+    const std::vector<llama_token> prompt = tokenize(prompt_text, params.add_bos, params.parse_special);
+    const uint64_t model_hash = get_model_fingerprint();
+    HegemonikonSessionSnapshotInfo info;
+    if (!LlamaSessionSnapshot::find_best(directory, model_hash, prompt, key, info) ||
+        info.n_tokens >= llama_n_ctx(ctx_))
+    {
+        return 0;
+    }
+
+    auto resident_tokens = [&]() -> size_t
+    {
+        auto it = sessions_.find(params.session_id);
+        if (it == sessions_.end())
+        {
+            return 0;
+        }
+        size_t n = 0;
+        const size_t n_max = std::min(it->second.tokens.size(), prompt.size());
+        while (n < n_max && it->second.tokens[n] == prompt[n])
+        {
+            ++n;
+        }
+        return n;
+    };
+    {
+        std::lock_guard<std::mutex> lock(context_mutex_);
+        if (resident_tokens() >= info.n_tokens)
+        {
+            return 0;
+        }
+    }
 
-            new_token_id = llama_sampler_sample(sampler, ctx, -1);
+    std::vector<llama_token> tokens;
+    std::vector<uint8_t> state;
+    std::string error;
+    if (!LlamaSessionSnapshot::read(info.path, model_hash, key, tokens, state, error))
+    {
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+        {
+            std::cerr << "LlamaInterface Error: " << error << std::endl;
+        }
+        return 0;
+    }
 
-            if (first_token)
+    int32_t restored = 0;
+    {
+        std::lock_guard<std::mutex> lock(context_mutex_);
+        LlamaSequenceSlot *slot = resident_tokens() < tokens.size() ? acquire_sequence(params.session_id, false) : nullptr;
+        if (slot)
+        {
+            llama_memory_seq_rm(llama_get_memory(ctx_), slot->seq_id, -1, -1);
+            if (draft_ctx_)
             {
-                auto ttft_end = std::chrono::high_resolution_clock::now();
-                ttft_ms = std::chrono::duration<double, std::milli>(ttft_end - start).count();
-                first_token = false;
+                llama_memory_seq_rm(llama_get_memory(draft_ctx_), slot->seq_id, -1, -1);
             }
-
-            if (llama_vocab_is_eog(vocab, new_token_id))
+            slot->draft_tokens.clear();
+            if (llama_state_seq_set_data(ctx_, state.data(), state.size(), slot->seq_id) == 0)
             {
-                break;
+                if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+                {
+                    std::cerr << "LlamaInterface Error: snapshot " << info.path << " does not fit the current context" << std::endl;
+                }
+                slot->tokens.clear();
+                llama_memory_seq_rm(llama_get_memory(ctx_), slot->seq_id, -1, -1);
             }
-
-            char buf[256];
-            int n = llama_token_to_piece(vocab, new_token_id, buf, sizeof(buf), 0, true);
-            if (n < 0)
+            else
             {
-                GGML_ABORT("failed to convert token to piece\n");
+                slot->tokens = tokens;
+                slot->n_shared = 0;
+                restored = static_cast<int32_t>(tokens.size());
             }
-            std::string piece(buf, n);
-            completion_text += piece;
+            slot->busy = false;
+        }
+    }
+
+    if (key)
+    {
+        secure_memset(state.data(), 0, state.size());
+        secure_memset(tokens.data(), 0, tokens.size() * sizeof(llama_token));
+    }
+    return restored;
+}
+
+/**
+ * @brief Decodes a prompt into the KV cache of a session ahead of its generation request.
+ *
+ * The prompt is diffed against the tokens the session already holds, as start_sequence
+ * does, and only the new tokens are decoded, without logits. Calling it as a prompt grows
+ * therefore prefills it incrementally, and the generation request that follows with the
+ * complete prompt and the same session id only decodes what was not prefilled yet. The
+ * last `n_hold_back` tokens are left out, because the tokenization of the end of a text
+ * may change when more text is appended to it.
+ *
+ * @param prompt_text The prompt, or the part of it known so far.
+ * @param params      The generation parameters of the request to come; `session_id` is required.
+ * @param n_hold_back Number of trailing prompt tokens not to decode.
+ * @return int32_t Number of leading prompt tokens in the KV cache of the session, -1 if the
+ *         model is not loaded, the session is busy or no sequence is available.
+ */
+int32_t LlamaInterface::prefill_session(const std::string &prompt_text, const HegemonikonGenerationParams &params,
+                                        size_t n_hold_back)
+{
+    if (!is_model_loaded() || current_model_params_.embeddings || params.session_id.empty())
+    {
+        return -1;
+    }
+    const std::vector<llama_token> prompt = tokenize(prompt_text, params.add_bos, params.parse_special);
+
+    std::lock_guard<std::mutex> lock(context_mutex_);
+    LlamaSequenceSlot *slot = acquire_sequence(params.session_id, false);
+    if (!slot)
+    {
+        return -1;
+    }
+
+    size_t n_reuse = 0;
+    const size_t n_common = std::min(slot->tokens.size(), prompt.size());
+    while (n_reuse < n_common && slot->tokens[n_reuse] == prompt[n_reuse])
+    {
+        ++n_reuse;
+    }
+    llama_memory_t mem = llama_get_memory(ctx_);
+    if (n_reuse < slot->tokens.size())
+    {
+        llama_memory_seq_rm(mem, slot->seq_id, static_cast<llama_pos>(n_reuse), -1);
+        slot->tokens.resize(n_reuse);
+        slot->n_shared = std::min(slot->n_shared, n_reuse);
+    }
 
-            current_nb_predict++;
-            if (current_nb_predict >= gen_params.n_predict)
+    // Leave room for the last prompt token, which the generation request decodes itself.
+    const size_t n_ctx = llama_n_ctx(ctx_);
+    const size_t n_target = std::min(prompt.size() - std::min(prompt.size(), n_hold_back), n_ctx > 0 ? n_ctx - 1 : 0);
+    if (n_reuse < n_target)
+    {
+        const ComputeLease lease = acquire_compute_locked({});
+        size_t n_batch = std::max<size_t>(1, llama_n_batch(ctx_));
+        if (params.n_batch > 0)
+        {
+            n_batch = std::min(n_batch, static_cast<size_t>(params.n_batch));
+        }
+        llama_batch batch = llama_batch_init(static_cast<int32_t>(n_batch), 0, 1);
+        for (size_t begin = n_reuse; begin < n_target; begin += n_batch)
+        {
+            const size_t end = std::min(n_target, begin + n_batch);
+            batch.n_tokens = 0;
+            for (size_t i = begin; i < end; ++i)
             {
-                printf("\033[0m\n");
-                break;
+                const int32_t j = batch.n_tokens++;
+                batch.token[j] = prompt[i];
+                batch.pos[j] = static_cast<llama_pos>(i);
+                batch.n_seq_id[j] = 1;
+                batch.seq_id[j][0] = slot->seq_id;
+                batch.logits[j] = false;
             }
-
-            bool stopped_by_sequence = false;
-            if (gen_params.stop_sequences.size() > 0)
+            MetricsRegistry::ScopedTimer timer(metrics_.get(), MetricPhase::Prefill);
+            TraceSpan span("llama_decode_prefill", "llama");
+            span.set_arg("n_tokens", static_cast<int64_t>(end - begin));
+            int ret = 0;
+            do
+            {
+                ret = llama_decode(ctx_, batch);
+            } while (ret == 1 && evict_lru_session());
+            if (ret != 0)
             {
-                for (size_t i = 0; i < gen_params.stop_sequences.size(); ++i)
+                if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
                 {
-                    const std::string &stop_seq = gen_params.stop_sequences[i];
-                    if (!stop_seq.empty() && completion_text.length() >= stop_seq.length())
-                    {
-                        if (completion_text.rfind(stop_seq) == (completion_text.length() - stop_seq.length()))
-                        {
-                            completion_text.erase(completion_text.length() - stop_seq.length());
-                            stopped_by_sequence = true;
-                            break;
-                        }
-                    }
+                    std::cerr << "LlamaInterface Error: prefill of session '" << params.session_id
+                              << "' failed with status " << ret << std::endl;
                 }
-            }
-            if (stopped_by_sequence)
-            {
+                llama_memory_seq_rm(mem, slot->seq_id, static_cast<llama_pos>(slot->tokens.size()), -1);
                 break;
             }
-
-            batch = llama_batch_get_one(&new_token_id, 1);
+            slot->tokens.insert(slot->tokens.end(), prompt.begin() + begin, prompt.begin() + end);
         }
+        llama_batch_free(batch);
+    }
+
+    slot->busy = false;
+    return static_cast<int32_t>(slot->tokens.size());
+}
+
+/**
+ * @brief Returns the hit/miss counters of the prefix cache.
+ *
+ * @return HegemonikonPrefixCacheStats A snapshot of the prefix cache statistics.
+ */
+HegemonikonPrefixCacheStats LlamaInterface::get_prefix_cache_stats() const
+{
+    std::lock_guard<std::mutex> lock(context_mutex_);
+    return prefix_cache_.get_stats();
+}
+
+/**
+ * @brief Drops every cached prompt prefix from the KV cache.
+ */
+void LlamaInterface::clear_prefix_cache()
+{
+    std::lock_guard<std::mutex> lock(context_mutex_);
+    if (!is_model_loaded())
+    {
+        return;
+    }
+    llama_memory_t mem = llama_get_memory(ctx_);
+    for (llama_seq_id seq : prefix_cache_.clear())
+    {
+        llama_memory_seq_rm(mem, seq, -1, -1);
+    }
+}
 
-        llama_sampler_free(sampler);
-        // llama_free(ctx);
-        tokens_generated = current_nb_predict;
-        auto end = std::chrono::high_resolution_clock::now();
-        decode_duration_ms = std::chrono::duration<double, std::milli>(end - start).count() - tokenizer_duration;
-        return completion_text;
+/**
+ * @brief Runs a single request to completion on the long-lived context.
+ *
+ * When `session_id` is set, the sequence owned by that session is kept between calls: the
+ * new prompt tokens are compared with the tokens already in the KV cache, only the
+ * divergent suffix is removed and only the new tokens are prefilled. Without a session id
+ * the request uses a scratch sequence that is released afterwards. Prompt prefixes shared
+ * across requests (system preambles, templates) are served from the prefix cache with
+ * `llama_memory_seq_cp`. The loop stops within one decode step of `handle` being cancelled
+ * or its deadline passing.
+ *
+ * @param prompt_text The input prompt.
+ * @param params      The generation parameters.
+ * @param on_piece    Optional callback receiving each generated piece; returning false stops generation.
+ * @param handle      Optional control block to cancel or bound the request from another thread.
+ * @return The result; on failure `success` is false and `text` holds the error.
+ */
+HegemonikonGenerationResult LlamaInterface::run_generation(const std::string &prompt_text,
+                                                           const HegemonikonGenerationParams &params,
+                                                           llama_token_callback on_piece,
+                                                           std::shared_ptr<LlamaRequestHandle> handle)
+{
+    std::unique_ptr<LlamaGenerationSequence> seq;
+    try
+    {
+        seq = start_sequence(prompt_text, params, std::move(on_piece), std::move(handle));
+        while (!seq->finished)
+        {
+            decode_step({seq.get()});
+            if (seq->is_prefilling())
+            {
+                std::this_thread::yield();
+            }
+        }
     }
     catch (const std::exception &e)
     {
-        return "[Error: " + std::string(e.what()) + "]";
+        HegemonikonGenerationResult result;
+        if (seq)
+        {
+            seq->result.text = "[Error: " + std::string(e.what()) + "]";
+            finish_sequence(*seq);
+            result = seq->result;
+        }
+        result.text = "[Error: " + std::string(e.what()) + "]";
+        result.success = false;
+        result.finish_reason = "error";
+        return result;
     }
+    return seq->result;
+}
+
+/**
+ * @brief Generates a text completion based on the provided prompt and generation parameters.
+ *
+ * Thin wrapper over run_generation that unpacks the timings.
+ *
+ * @param prompt_text The input prompt for which to generate a completion.
+ * @param gen_params  The parameters controlling text generation (e.g., number of tokens, stop sequences).
+ * @param ttft_ms     Receives the time to first token in milliseconds.
+ * @param decode_duration_ms Receives the generation time in milliseconds, tokenization excluded.
+ * @param tokens_generated   Receives the number of generated tokens.
+ * @return The generated completion as a string. Returns an error message string if the model is not loaded,
+ *         the prompt is empty, the context size is exceeded, or an exception occurs during generation.
+ */
+std::string LlamaInterface::generate_completion(const std::string &prompt_text, const HegemonikonGenerationParams &gen_params, double &ttft_ms, double &decode_duration_ms, int32_t &tokens_generated)
+{
+    HegemonikonGenerationResult result = run_generation(prompt_text, gen_params);
+    ttft_ms = result.ttft_ms;
+    decode_duration_ms = result.decode_duration_ms;
+    tokens_generated = result.tokens_generated;
+    return result.text;
 }
 
 /**
  * @brief Generates a completion for the given prompt in a streaming fashion.
  *
- * This function takes a prompt string and generation parameters, tokenizes the prompt,
- * and streams the generated completion tokens to the provided callback function.
- * It performs several checks, including whether the model is loaded, whether the callback
- * is valid, and whether tokenization of the prompt succeeds. If any of these checks fail,
- * an error message is sent to the callback or logged, and the function returns false.
+ * Runs the same generation loop as generate_completion, but hands every piece to the
+ * callback as soon as it is sampled. Generation stops early when the callback returns
+ * false. Errors are reported through the callback as "[Error: ...]" strings.
  *
  * @param prompt_text The input prompt to generate a completion for.
  * @param gen_params  The parameters controlling the generation process.
  * @param callback    A function to be called with each generated token or error message.
- * @return true if the streaming generation process was successfully started, false otherwise.
+ * @return true if the generation completed (or was stopped by the callback), false on error.
  */
 bool LlamaInterface::generate_completion_streaming(
     const std::string &prompt_text,
     const HegemonikonGenerationParams &gen_params,
     llama_token_callback callback)
 {
-    if (!is_model_loaded())
+    if (!callback)
     {
-        callback("[Error: Model not loaded]");
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+        {
+            std::cerr << "LlamaInterface Error: callback is null" << std::endl;
+        }
         return false;
     }
 
-    if (!callback)
+    if (!is_model_loaded())
     {
-        std::cerr << "LlamaInterface Error: callback is null" << std::endl;
+        callback("[Error: Model not loaded]");
         return false;
     }
 
-    std::vector<llama_token> prompt_tokens = tokenize(prompt_text, true, false);
-    if (prompt_tokens.empty() && !prompt_text.empty())
+    HegemonikonGenerationResult result = run_generation(prompt_text, gen_params, callback);
+    if (!result.success)
     {
-        callback("[Error: Prompt tokenization failed]");
+        callback(result.text);
         return false;
     }
-
     return true;
 }
 
 /**
  * @brief Checks if the given text ends with any of the specified stop sequences.
  *
- * Iterates through the provided list of stop sequences and determines if the input
- * text ends with any non-empty stop sequence. Returns true if a match is found,
- * otherwise returns false.
+ * Uses the same automaton as the generation loop (LlamaStopMatcher) rather than a
+ * separate per-string comparison.
  *
  * @param text The text to check for stop sequences.
  * @param stop_sequences A vector of stop sequences to check against the end of the text.
@@ -611,20 +3470,7 @@ bool LlamaInterface::generate_completion_streaming(
  */
 bool LlamaInterface::check_stop_sequences(const std::string &text, const std::vector<std::string> &stop_sequences)
 {
-    for (const auto &stop_seq : stop_sequences)
-    {
-        if (stop_seq.empty())
-            continue;
-
-        if (text.length() >= stop_seq.length())
-        {
-            if (text.compare(text.length() - stop_seq.length(), stop_seq.length(), stop_seq) == 0)
-            {
-                return true;
-            }
-        }
-    }
-    return false;
+    return LlamaStopMatcher(stop_sequences).matches_suffix(text);
 }
 
 /**
@@ -0,0 +1,335 @@
+#include "llama_load_benchmarker.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <thread>
+
+#include "core_ai_service.hh"
+#include "benchmarker/system_infos/memory_usage.hh"
+
+namespace
+{
+    using load_clock = std::chrono::steady_clock;
+
+    const std::vector<std::string> DEFAULT_CORPUS = {
+        "The Niger river rises in the Guinea Highlands and flows north-east through Mali before turning south towards the Gulf of Guinea.",
+        "A compiler translates source code into machine code in several passes: parsing, semantic analysis, optimization and code generation.",
+        "Summarize the following meeting notes and list the decisions that were taken, the owners of each action item and the deadlines.",
+        "In distributed systems, consensus protocols such as Raft let a cluster of servers agree on a replicated log despite failures.",
+        "Photosynthesis converts light energy into chemical energy, storing it in glucose while releasing oxygen as a by-product.",
+        "Write a short story about a lighthouse keeper who receives a letter that was posted forty years ago.",
+    };
+
+    double elapsed_ms(load_clock::time_point from, load_clock::time_point to)
+    {
+        return std::chrono::duration<double, std::milli>(to - from).count();
+    }
+}
+
+/**
+ * @brief Computes the percentiles of a set of samples (nearest rank).
+ */
+HegemonikonLatencyPercentiles HegemonikonLatencyPercentiles::from_samples(std::vector<double> samples_ms)
+{
+    HegemonikonLatencyPercentiles percentiles;
+    if (samples_ms.empty())
+    {
+        return percentiles;
+    }
+    std::sort(samples_ms.begin(), samples_ms.end());
+    auto rank = [&samples_ms](double p)
+    {
+        const size_t index = static_cast<size_t>(p * static_cast<double>(samples_ms.size() - 1) + 0.5);
+        return samples_ms[std::min(index, samples_ms.size() - 1)];
+    };
+    double sum = 0.0;
+    for (double sample : samples_ms)
+    {
+        sum += sample;
+    }
+    percentiles.count = samples_ms.size();
+    percentiles.mean_ms = sum / static_cast<double>(samples_ms.size());
+    percentiles.p50_ms = rank(0.50);
+    percentiles.p95_ms = rank(0.95);
+    percentiles.p99_ms = rank(0.99);
+    percentiles.max_ms = samples_ms.back();
+    return percentiles;
+}
+
+/**
+ * @brief Renders the levels as CSV, one row per concurrency level, for plotting the
+ * throughput and latency curves.
+ */
+std::string HegemonikonLoadBenchmarkResult::to_csv() const
+{
+    std::ostringstream out;
+    out << "concurrency,requests,failed_requests,duration_s,tokens_per_second,requests_per_second,"
+           "ttft_p50_ms,ttft_p95_ms,ttft_p99_ms,inter_token_p50_ms,inter_token_p95_ms,inter_token_p99_ms,"
+           "end_to_end_p50_ms,end_to_end_p95_ms,end_to_end_p99_ms,start_memory_mb,peak_memory_mb\n";
+    for (const HegemonikonLoadLevelResult &level : levels)
+    {
+        out << level.concurrency << ',' << level.requests << ',' << level.failed_requests << ','
+            << level.duration_s << ',' << level.tokens_per_second << ',' << level.requests_per_second << ','
+            << level.ttft.p50_ms << ',' << level.ttft.p95_ms << ',' << level.ttft.p99_ms << ','
+            << level.inter_token.p50_ms << ',' << level.inter_token.p95_ms << ',' << level.inter_token.p99_ms << ','
+            << level.end_to_end.p50_ms << ',' << level.end_to_end.p95_ms << ',' << level.end_to_end.p99_ms << ','
+            << level.start_memory_mb << ',' << level.peak_memory_mb << '\n';
+    }
+    return out.str();
+}
+
+LlamaLoadBenchmarker::LlamaLoadBenchmarker(CoreAIService &service) : service_(service)
+{
+}
+
+/**
+ * @brief Stops the benchmark: running generations are cancelled and no request is sent.
+ */
+void LlamaLoadBenchmarker::request_cancellation()
+{
+    cancellation_requested_.store(true);
+}
+
+/**
+ * @brief Runs every concurrency level of a profile.
+ *
+ * @return The results per level; `success` is false if the profile is invalid, no
+ *         model is loaded, or the benchmark was cancelled (the completed levels are kept).
+ */
+HegemonikonLoadBenchmarkResult LlamaLoadBenchmarker::run(const HegemonikonLoadProfile &profile)
+{
+    HegemonikonLoadBenchmarkResult result;
+    cancellation_requested_.store(false);
+
+    if (!service_.is_llama_model_loaded())
+    {
+        result.errorMessage = "No Llama model loaded";
+        return result;
+    }
+    if (profile.requests_per_client <= 0 || profile.arrival_rate < 0.0 ||
+        profile.min_prompt_tokens <= 0 || profile.max_prompt_tokens < profile.min_prompt_tokens ||
+        profile.min_output_tokens <= 0 || profile.max_output_tokens < profile.min_output_tokens)
+    {
+        result.errorMessage = "Invalid load profile: " + profile.to_string();
+        return result;
+    }
+
+    const std::vector<std::string> &corpus = profile.prompts.empty() ? DEFAULT_CORPUS : profile.prompts;
+    std::mt19937 rng(profile.seed);
+    for (int32_t concurrency : profile.concurrency_levels)
+    {
+        if (concurrency <= 0)
+        {
+            continue;
+        }
+        std::uniform_int_distribution<int32_t> prompt_tokens(profile.min_prompt_tokens, profile.max_prompt_tokens);
+        std::uniform_int_distribution<int32_t> output_tokens(profile.min_output_tokens, profile.max_output_tokens);
+        std::uniform_int_distribution<size_t> offset(0, corpus.size() - 1);
+        std::exponential_distribution<double> inter_arrival(profile.arrival_rate > 0.0 ? profile.arrival_rate : 1.0);
+
+        std::vector<std::vector<Request>> clients(static_cast<size_t>(concurrency));
+        for (std::vector<Request> &client : clients)
+        {
+            double arrival_s = 0.0;
+            for (int32_t i = 0; i < profile.requests_per_client; ++i)
+            {
+                Request request;
+                request.params = profile.generation_params;
+                request.params.n_predict = output_tokens(rng);
+                request.params.session_id.clear();
+                request.prompt = make_prompt(corpus, offset(rng), prompt_tokens(rng));
+                request.prompt_tokens = static_cast<int32_t>(service_.tokenization(request.prompt).size());
+                if (profile.arrival_rate > 0.0)
+                {
+                    arrival_s += inter_arrival(rng);
+                    request.arrival_s = arrival_s;
+                }
+                client.push_back(std::move(request));
+            }
+        }
+
+        if (cancellation_requested_.load())
+        {
+            result.errorMessage = "Load benchmark cancelled";
+            return result;
+        }
+        result.levels.push_back(run_level(profile, concurrency, clients));
+        std::cout << "  " << result.levels.back().to_string() << std::endl;
+    }
+    if (cancellation_requested_.load())
+    {
+        result.errorMessage = "Load benchmark cancelled";
+        return result;
+    }
+    result.success = true;
+    return result;
+}
+
+/**
+ * @brief Builds a prompt of about `n_tokens` tokens from the corpus, starting at a
+ * different text for each offset so that prompts do not all share a prefix.
+ */
+std::string LlamaLoadBenchmarker::make_prompt(const std::vector<std::string> &corpus, size_t offset, int32_t n_tokens)
+{
+    std::string text;
+    std::vector<int32_t> tokens;
+    for (size_t i = 0; static_cast<int32_t>(tokens.size()) < n_tokens && i < corpus.size() * 64; ++i)
+    {
+        text += corpus[(offset + i) % corpus.size()];
+        text += ' ';
+        tokens = service_.tokenization(text);
+        if (tokens.empty())
+        {
+            // The model cannot tokenize, the text is used as is.
+            break;
+        }
+    }
+    if (static_cast<int32_t>(tokens.size()) <= n_tokens)
+    {
+        return text;
+    }
+    // The first token may be BOS, which add_bos adds back.
+    const size_t begin = tokens.size() > 1 ? 1 : 0;
+    tokens = std::vector<int32_t>(tokens.begin() + static_cast<std::ptrdiff_t>(begin),
+                                  tokens.begin() + static_cast<std::ptrdiff_t>(begin + static_cast<size_t>(n_tokens)));
+    return service_.detokenization(tokens);
+}
+
+/**
+ * @brief Runs the requests of one level and aggregates their samples.
+ *
+ * One thread per client; open-loop requests run on their own thread from their arrival
+ * time so that a slow request does not delay the next arrival.
+ */
+HegemonikonLoadLevelResult LlamaLoadBenchmarker::run_level(const HegemonikonLoadProfile &profile, int32_t concurrency,
+                                                           const std::vector<std::vector<Request>> &clients)
+{
+    HegemonikonLoadLevelResult level;
+    level.concurrency = concurrency;
+    PeakMemorySampler memory;
+    level.start_memory_mb = memory.start_mb();
+
+    std::mutex samples_mutex;
+    std::vector<Sample> samples;
+    const load_clock::time_point start = load_clock::now();
+    const bool open_loop = profile.arrival_rate > 0.0;
+
+    std::vector<std::thread> threads;
+    threads.reserve(clients.size());
+    for (const std::vector<Request> &client : clients)
+    {
+        threads.emplace_back([&, open_loop]()
+                             {
+            std::vector<std::future<Sample>> pending;
+            std::vector<Sample> client_samples;
+            for (const Request &request : client)
+            {
+                if (cancellation_requested_.load())
+                {
+                    break;
+                }
+                if (!open_loop)
+                {
+                    client_samples.push_back(run_request(request, profile.use_scheduler));
+                    continue;
+                }
+                std::this_thread::sleep_until(start + std::chrono::duration_cast<load_clock::duration>(
+                                                          std::chrono::duration<double>(request.arrival_s)));
+                pending.push_back(std::async(std::launch::async, [this, &request, &profile]()
+                                             { return run_request(request, profile.use_scheduler); }));
+            }
+            for (std::future<Sample> &future : pending)
+            {
+                client_samples.push_back(future.get());
+            }
+            std::lock_guard<std::mutex> lock(samples_mutex);
+            samples.insert(samples.end(), client_samples.begin(), client_samples.end()); });
+    }
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+    const load_clock::time_point end = load_clock::now();
+    memory.stop();
+
+    std::vector<double> ttft;
+    std::vector<double> inter_token;
+    std::vector<double> end_to_end;
+    for (const Sample &sample : samples)
+    {
+        ++level.requests;
+        if (!sample.success)
+        {
+            ++level.failed_requests;
+            continue;
+        }
+        level.prompt_tokens += static_cast<uint64_t>(sample.prompt_tokens);
+        level.generated_tokens += static_cast<uint64_t>(sample.generated_tokens);
+        if (sample.n_pieces > 0)
+        {
+            ttft.push_back(sample.ttft_ms);
+        }
+        end_to_end.push_back(sample.end_to_end_ms);
+        inter_token.insert(inter_token.end(), sample.inter_token_ms.begin(), sample.inter_token_ms.end());
+    }
+    level.duration_s = elapsed_ms(start, end) / 1000.0;
+    if (level.duration_s > 0.0)
+    {
+        level.tokens_per_second = static_cast<double>(level.generated_tokens) / level.duration_s;
+        level.requests_per_second = static_cast<double>(level.requests - level.failed_requests) / level.duration_s;
+    }
+    level.ttft = HegemonikonLatencyPercentiles::from_samples(std::move(ttft));
+    level.inter_token = HegemonikonLatencyPercentiles::from_samples(std::move(inter_token));
+    level.end_to_end = HegemonikonLatencyPercentiles::from_samples(std::move(end_to_end));
+    level.peak_memory_mb = memory.peak_mb();
+    return level;
+}
+
+/**
+ * @brief Sends one request and times the pieces it streams back.
+ *
+ * TTFT is measured from the submission, queueing included. stream_prompt does not
+ * report token counts, so on that path the generated tokens are the streamed pieces.
+ */
+LlamaLoadBenchmarker::Sample LlamaLoadBenchmarker::run_request(const Request &request, bool use_scheduler)
+{
+    Sample sample;
+    const load_clock::time_point start = load_clock::now();
+    load_clock::time_point last = start;
+    auto on_piece = [&](const std::string & /*piece*/)
+    {
+        const load_clock::time_point now = load_clock::now();
+        if (sample.n_pieces == 0)
+        {
+            sample.ttft_ms = elapsed_ms(start, now);
+        }
+        else
+        {
+            sample.inter_token_ms.push_back(elapsed_ms(last, now));
+        }
+        last = now;
+        ++sample.n_pieces;
+        return !cancellation_requested_.load();
+    };
+
+    if (use_scheduler)
+    {
+        const HegemonikonGenerationResult result = service_.submit_prompt(request.prompt, request.params, on_piece).get();
+        sample.success = result.success;
+        sample.prompt_tokens = result.prompt_tokens;
+        sample.generated_tokens = result.tokens_generated;
+    }
+    else
+    {
+        sample.success = service_.stream_prompt(request.prompt, request.params, on_piece);
+        sample.prompt_tokens = request.prompt_tokens;
+        sample.generated_tokens = sample.n_pieces;
+    }
+    sample.end_to_end_ms = elapsed_ms(start, load_clock::now());
+    return sample;
+}
@@ -0,0 +1,354 @@
+#include "llama_microbench.hh"
+#include "hegemonikon_log.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <thread>
+
+#include "json.hpp"
+#include "llama.h"
+#include "llama_offload_planner.hh"
+#include "model_benchmarker.hh"
+
+#ifndef HEGEMONIKON_LLAMA_CPP_TAG
+#define HEGEMONIKON_LLAMA_CPP_TAG "unknown"
+#endif
+
+namespace
+{
+    using bench_clock = std::chrono::steady_clock;
+
+    double elapsed_ms(bench_clock::time_point from, bench_clock::time_point to)
+    {
+        return std::chrono::duration<double, std::milli>(to - from).count();
+    }
+
+    /**
+     * @brief Decodes tokens into sequence 0 in chunks of at most n_batch tokens.
+     */
+    bool decode_tokens(llama_context *ctx, std::vector<llama_token> &tokens, size_t begin, size_t end, int32_t n_batch)
+    {
+        for (size_t i = begin; i < end; i += static_cast<size_t>(n_batch))
+        {
+            const int32_t n = static_cast<int32_t>(std::min(static_cast<size_t>(n_batch), end - i));
+            if (llama_decode(ctx, llama_batch_get_one(tokens.data() + i, n)) != 0)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::vector<llama_token> random_tokens(std::mt19937 &rng, const llama_vocab *vocab, size_t n)
+    {
+        std::uniform_int_distribution<llama_token> token(0, llama_vocab_n_tokens(vocab) - 1);
+        std::vector<llama_token> tokens(n);
+        for (llama_token &t : tokens)
+        {
+            t = token(rng);
+        }
+        if (!tokens.empty() && llama_vocab_bos(vocab) != LLAMA_TOKEN_NULL)
+        {
+            tokens[0] = llama_vocab_bos(vocab);
+        }
+        return tokens;
+    }
+
+    HegemonikonMicrobenchSample make_sample(const std::string &test, const std::string &kind, int32_t n_tokens, int32_t depth)
+    {
+        HegemonikonMicrobenchSample sample;
+        sample.test = test;
+        sample.kind = kind;
+        sample.n_tokens = n_tokens;
+        sample.depth = depth;
+        return sample;
+    }
+}
+
+void HegemonikonMicrobenchSample::calculate_statistics()
+{
+    std::vector<double> throughput;
+    for (double ms : samples_ms)
+    {
+        throughput.push_back(ms > 0.0 ? 1000.0 * n_tokens / ms : 0.0);
+    }
+    avg_ms = avg(samples_ms);
+    stdev_ms = stdev(samples_ms);
+    tokens_per_second = avg(throughput);
+    stdev_tokens_per_second = stdev(throughput);
+}
+
+std::string HegemonikonMicrobenchReport::to_json() const
+{
+    json list = json::array();
+    for (const HegemonikonMicrobenchSample &sample : samples)
+    {
+        list.push_back(json{{"test", sample.test},
+                            {"kind", sample.kind},
+                            {"n_tokens", sample.n_tokens},
+                            {"depth", sample.depth},
+                            {"avg_ms", sample.avg_ms},
+                            {"stdev_ms", sample.stdev_ms},
+                            {"tokens_per_second", sample.tokens_per_second},
+                            {"stdev_tokens_per_second", sample.stdev_tokens_per_second},
+                            {"samples_ms", sample.samples_ms}});
+    }
+    const json document{{"benchmark", "llama_microbench"},
+                        {"success", success},
+                        {"error", errorMessage},
+                        {"llama_cpp_version", llama_cpp_version},
+                        {"system_info", system_info},
+                        {"model", json{{"path", model_path},
+                                       {"description", model_description},
+                                       {"size_bytes", model_size_bytes},
+                                       {"n_params", model_n_params}}},
+                        {"config", json{{"n_threads", n_threads},
+                                        {"n_threads_batch", n_threads_batch},
+                                        {"n_gpu_layers", n_gpu_layers},
+                                        {"n_batch", n_batch},
+                                        {"n_ubatch", n_ubatch},
+                                        {"cache_type_k", cache_type_k},
+                                        {"cache_type_v", cache_type_v},
+                                        {"flash_attn", flash_attn}}},
+                        {"results", list}};
+    return document.dump(2);
+}
+
+/**
+ * @brief Runs the prefill, decode and sampler tests of a model.
+ *
+ * The context is sized for the longest test; decode depths beyond the training context
+ * of the model are skipped with a warning. Every test runs once before it is timed.
+ *
+ * @return The report; `success` is false if the model could not be loaded or a decode failed.
+ */
+HegemonikonMicrobenchReport LlamaMicrobench::run(const HegemonikonMicrobenchParams &params)
+{
+    HegemonikonMicrobenchReport report;
+    report.model_path = params.model_params.model_path;
+    report.llama_cpp_version = HEGEMONIKON_LLAMA_CPP_TAG;
+
+    if (params.repetitions <= 0 || params.n_generate <= 0 || params.sampler_iterations < 0)
+    {
+        report.errorMessage = "Invalid microbenchmark parameters: " + params.to_string();
+        return report;
+    }
+
+    HegemonikonLlamaModelParams model_params = params.model_params;
+    ggml_type type_k = GGML_TYPE_F16;
+    ggml_type type_v = GGML_TYPE_F16;
+    enum llama_flash_attn_type flash_attn = LLAMA_FLASH_ATTN_TYPE_AUTO;
+    if (!LlamaInterface::parse_cache_type(model_params.cache_type_k, type_k) ||
+        !LlamaInterface::parse_cache_type(model_params.cache_type_v, type_v) ||
+        !LlamaInterface::parse_flash_attn_type(model_params.flash_attn, flash_attn) ||
+        model_params.n_batch <= 0 || model_params.n_ubatch <= 0)
+    {
+        report.errorMessage = "Invalid model parameters: " + model_params.to_string();
+        return report;
+    }
+
+    LlamaInterface::init_backend();
+    report.system_info = llama_print_system_info();
+
+    int32_t n_ctx = params.n_generate;
+    for (int32_t n : params.prompt_lengths)
+    {
+        n_ctx = std::max(n_ctx, n);
+    }
+    for (int32_t depth : params.depths)
+    {
+        n_ctx = std::max(n_ctx, depth + params.n_generate);
+    }
+    model_params.n_ctx = n_ctx;
+    if (model_params.n_gpu_layers < 0)
+    {
+        model_params = LlamaOffloadPlanner::plan(model_params).apply(model_params);
+    }
+
+    llama_model_params model_p = llama_model_default_params();
+    model_p.n_gpu_layers = model_params.n_gpu_layers;
+    model_p.main_gpu = model_params.main_gpu;
+    model_p.use_mmap = model_params.use_map;
+    model_p.use_mlock = model_params.use_mlock;
+    std::unique_ptr<llama_model, decltype(&llama_model_free)> model(
+        llama_model_load_from_file(model_params.model_path.c_str(), model_p), llama_model_free);
+    if (!model)
+    {
+        report.errorMessage = "Unable to load model from " + model_params.model_path;
+        return report;
+    }
+    const llama_vocab *vocab = llama_model_get_vocab(model.get());
+    char description[256] = {0};
+    llama_model_desc(model.get(), description, sizeof(description));
+    report.model_description = description;
+    report.model_size_bytes = llama_model_size(model.get());
+    report.model_n_params = llama_model_n_params(model.get());
+
+    const int32_t n_ctx_train = llama_model_n_ctx_train(model.get());
+    llama_context_params ctx_p = llama_context_default_params();
+    ctx_p.n_ctx = static_cast<uint32_t>(std::min(n_ctx, std::max(n_ctx_train, params.n_generate)));
+    ctx_p.n_batch = static_cast<uint32_t>(std::min<int32_t>(model_params.n_batch, static_cast<int32_t>(ctx_p.n_ctx)));
+    ctx_p.n_ubatch = std::min(ctx_p.n_batch, static_cast<uint32_t>(model_params.n_ubatch));
+    ctx_p.n_seq_max = 1;
+    ctx_p.n_threads = model_params.n_threads > 0 ? static_cast<uint32_t>(model_params.n_threads)
+                                                 : std::max(1u, std::thread::hardware_concurrency() / 2);
+    ctx_p.n_threads_batch = model_params.n_threads_batch > 0 ? static_cast<uint32_t>(model_params.n_threads_batch)
+                                                             : std::max(1u, std::thread::hardware_concurrency());
+    ctx_p.type_k = type_k;
+    ctx_p.type_v = type_v;
+    ctx_p.flash_attn_type = ggml_is_quantized(type_v) ? LLAMA_FLASH_ATTN_TYPE_ENABLED : flash_attn;
+    std::unique_ptr<llama_context, decltype(&llama_free)> ctx(llama_init_from_model(model.get(), ctx_p), llama_free);
+    if (!ctx)
+    {
+        report.errorMessage = "Failed to create a context of " + std::to_string(ctx_p.n_ctx) + " tokens";
+        return report;
+    }
+    report.n_threads = static_cast<int32_t>(ctx_p.n_threads);
+    report.n_threads_batch = static_cast<int32_t>(ctx_p.n_threads_batch);
+    report.n_gpu_layers = model_params.n_gpu_layers;
+    report.n_batch = static_cast<int32_t>(ctx_p.n_batch);
+    report.n_ubatch = static_cast<int32_t>(ctx_p.n_ubatch);
+    report.cache_type_k = model_params.cache_type_k;
+    report.cache_type_v = model_params.cache_type_v;
+    report.flash_attn = model_params.flash_attn;
+
+    llama_memory_t memory = llama_get_memory(ctx.get());
+    const int32_t n_batch = static_cast<int32_t>(ctx_p.n_batch);
+    std::mt19937 rng(params.seed);
+
+    for (int32_t n_prompt : params.prompt_lengths)
+    {
+        if (n_prompt <= 0 || n_prompt > static_cast<int32_t>(ctx_p.n_ctx))
+        {
+            if (HegemonikonLog::enabled(HegemonikonLogLevel::Warning))
+            {
+                std::cerr << "LlamaMicrobench Warning: skipping pp" << n_prompt << ", the context holds " << ctx_p.n_ctx << " tokens" << std::endl;
+            }
+            continue;
+        }
+        HegemonikonMicrobenchSample sample = make_sample("pp" + std::to_string(n_prompt), "prefill", n_prompt, 0);
+        std::vector<llama_token> tokens = random_tokens(rng, vocab, static_cast<size_t>(n_prompt));
+        for (int32_t i = 0; i <= params.repetitions; ++i)
+        {
+            llama_memory_clear(memory, true);
+            const bench_clock::time_point start = bench_clock::now();
+            if (!decode_tokens(ctx.get(), tokens, 0, tokens.size(), n_batch))
+            {
+                report.errorMessage = "llama_decode failed in " + sample.test;
+                return report;
+            }
+            llama_synchronize(ctx.get());
+            if (i > 0)
+            {
+                sample.samples_ms.push_back(elapsed_ms(start, bench_clock::now()));
+            }
+        }
+        sample.calculate_statistics();
+        report.samples.push_back(sample);
+    }
+
+    for (int32_t depth : params.depths)
+    {
+        if (depth < 0 || depth + params.n_generate > static_cast<int32_t>(ctx_p.n_ctx))
+        {
+            if (HegemonikonLog::enabled(HegemonikonLogLevel::Warning))
+            {
+                std::cerr << "LlamaMicrobench Warning: skipping tg" << params.n_generate << "@d" << depth
+                          << ", the context holds " << ctx_p.n_ctx << " tokens" << std::endl;
+            }
+            continue;
+        }
+        HegemonikonMicrobenchSample sample = make_sample("tg" + std::to_string(params.n_generate) + "@d" + std::to_string(depth),
+                                                         "decode", params.n_generate, depth);
+        std::vector<llama_token> tokens = random_tokens(rng, vocab, static_cast<size_t>(depth + params.n_generate));
+        llama_memory_clear(memory, true);
+        if (!decode_tokens(ctx.get(), tokens, 0, static_cast<size_t>(depth), n_batch))
+        {
+            report.errorMessage = "llama_decode failed filling the KV cache of " + sample.test;
+            return report;
+        }
+        for (int32_t i = 0; i <= params.repetitions; ++i)
+        {
+            // Drop the tokens generated by the previous repetition, keep the fill.
+            llama_memory_seq_rm(memory, 0, depth, -1);
+            const bench_clock::time_point start = bench_clock::now();
+            if (!decode_tokens(ctx.get(), tokens, static_cast<size_t>(depth), tokens.size(), 1))
+            {
+                report.errorMessage = "llama_decode failed in " + sample.test;
+                return report;
+            }
+            llama_synchronize(ctx.get());
+            if (i > 0)
+            {
+                sample.samples_ms.push_back(elapsed_ms(start, bench_clock::now()));
+            }
+        }
+        sample.calculate_statistics();
+        report.samples.push_back(sample);
+    }
+
+    if (params.sampler_iterations > 0)
+    {
+        // The tests need the logits of a decode; decode one token if none ran.
+        if (report.samples.empty())
+        {
+            std::vector<llama_token> tokens = random_tokens(rng, vocab, 1);
+            llama_memory_clear(memory, true);
+            if (!decode_tokens(ctx.get(), tokens, 0, tokens.size(), 1))
+            {
+                report.errorMessage = "llama_decode failed before the sampler tests";
+                return report;
+            }
+        }
+        const std::pair<const char *, llama_sampler *> samplers[] = {
+            {"sampler_greedy", llama_sampler_init_greedy()},
+            {"sampler_chain", LlamaInterface::create_sampler(params.sampler_params)},
+        };
+        for (const auto &[name, sampler] : samplers)
+        {
+            HegemonikonMicrobenchSample sample = make_sample(name, "sampler", params.sampler_iterations, 0);
+            for (int32_t i = 0; i <= params.repetitions; ++i)
+            {
+                const bench_clock::time_point start = bench_clock::now();
+                for (int32_t call = 0; call < params.sampler_iterations; ++call)
+                {
+                    llama_sampler_sample(sampler, ctx.get(), -1);
+                }
+                if (i > 0)
+                {
+                    sample.samples_ms.push_back(elapsed_ms(start, bench_clock::now()));
+                }
+            }
+            llama_sampler_free(sampler);
+            sample.calculate_statistics();
+            report.samples.push_back(sample);
+        }
+    }
+
+    report.success = true;
+    return report;
+}
+
+/**
+ * @brief Writes a report as JSON.
+ *
+ * @return true if the file was written.
+ */
+bool LlamaMicrobench::write_report(const HegemonikonMicrobenchReport &report, const std::string &path)
+{
+    std::ofstream file(path, std::ios::trunc);
+    file << report.to_json() << "\n";
+    if (!file)
+    {
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+        {
+            std::cerr << "LlamaMicrobench Error: cannot write " << path << std::endl;
+        }
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,372 @@
+#include "llama_model_registry.hh"
+#include "hegemonikon_log.hh"
+
+#include <iostream>
+#include <iterator>
+
+/**
+ * @brief Constructs an empty registry.
+ *
+ * @param factory Creates the interface a model is loaded into; a plain LlamaInterface when null.
+ */
+LlamaModelRegistry::LlamaModelRegistry(factory_t factory)
+    : factory_(std::move(factory))
+{
+}
+
+/**
+ * @brief Unloads every idle model. Models still held elsewhere are released by their last owner.
+ */
+LlamaModelRegistry::~LlamaModelRegistry()
+{
+    clear();
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+}
+
+/**
+ * @brief Replaces the factory used for the next loads.
+ */
+void LlamaModelRegistry::set_factory(factory_t factory)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    factory_ = std::move(factory);
+}
+
+/**
+ * @brief Sets the memory budget of resident models.
+ *
+ * Lowering the budget evicts idle models right away until the resident set fits again.
+ *
+ * @param ram_budget_bytes  Host memory budget in bytes, 0 for unlimited.
+ * @param vram_budget_bytes Device memory budget in bytes, 0 for unlimited.
+ */
+void LlamaModelRegistry::set_budget(uint64_t ram_budget_bytes, uint64_t vram_budget_bytes)
+{
+    std::vector<std::shared_ptr<LlamaInterface>> evicted;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ram_budget_bytes_ = ram_budget_bytes;
+        vram_budget_bytes_ = vram_budget_bytes;
+        make_room({}, static_cast<size_t>(-1), evicted);
+    }
+    unload_all(evicted);
+}
+
+/**
+ * @brief Returns the model loaded with the given parameters, loading it if needed.
+ *
+ * A resident model is returned immediately. Otherwise idle least-recently-used models are
+ * unloaded until the estimated footprint of the new one fits in the budget, the model is
+ * loaded, and the budget is enforced again with its measured footprint. Loads are
+ * serialized, but lookups of resident models never wait for a load in progress.
+ *
+ * @param params The model parameters; their hash is the registry key.
+ * @param status Optional load status the load reports progress to and can be cancelled
+ *               through. It is not finished here; that is left to the caller.
+ * @return The loaded model, or nullptr if it failed to load or cannot fit in the budget.
+ *         The model is never evicted while the returned pointer is held.
+ */
+std::shared_ptr<LlamaInterface> LlamaModelRegistry::acquire(const HegemonikonLlamaModelParams &params,
+                                                            std::shared_ptr<LlamaLoadStatus> status)
+{
+    const size_t key = params.hash();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(key);
+        if (it != entries_.end() && it->second.params == params)
+        {
+            it->second.last_used = ++clock_;
+            stats_.hits++;
+            return it->second.model;
+        }
+    }
+
+    std::lock_guard<std::mutex> load_lock(load_mutex_);
+    const HegemonikonModelFootprint estimate = LlamaInterface::estimate_memory_footprint(params);
+    std::vector<std::shared_ptr<LlamaInterface>> evicted;
+    factory_t factory;
+    bool fits_budget = true;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(key);
+        if (it != entries_.end())
+        {
+            if (it->second.params == params)
+            {
+                it->second.last_used = ++clock_;
+                stats_.hits++;
+                return it->second.model;
+            }
+            // Another model hashes to the same key; it has to go before this one can be registered.
+            if (it->second.model.use_count() > 1)
+            {
+                if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+                {
+                    std::cerr << "LlamaModelRegistry Error: key collision with a model in use: " << params.model_path << std::endl;
+                }
+                stats_.load_failures++;
+                return nullptr;
+            }
+            remove_locked(it, evicted);
+            stats_.evictions++;
+        }
+
+        stats_.misses++;
+        if (!make_room(estimate, key, evicted))
+        {
+            if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+            {
+                std::cerr << "LlamaModelRegistry Error: " << params.model_path << " does not fit in the memory budget ("
+                          << estimate.to_string() << ")" << std::endl;
+            }
+            stats_.load_failures++;
+            fits_budget = false;
+        }
+        factory = factory_;
+    }
+    unload_all(evicted);
+    if (!fits_budget)
+    {
+        return nullptr;
+    }
+
+    std::shared_ptr<LlamaInterface> model = factory ? factory() : std::make_shared<LlamaInterface>();
+    bool loaded = false;
+    if (model)
+    {
+        model->set_load_status(status);
+        loaded = model->load_model(params);
+        model->set_load_status(nullptr);
+    }
+    if (!loaded)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.load_failures++;
+        return nullptr;
+    }
+
+    HegemonikonModelFootprint footprint = model->get_memory_footprint();
+    if (footprint.total_bytes() == 0)
+    {
+        footprint = estimate;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Entry &entry = entries_[key];
+        entry.params = params;
+        entry.model = model;
+        entry.footprint = footprint;
+        entry.last_used = ++clock_;
+        entry.pinned = false;
+
+        if (!make_room({}, key, evicted))
+        {
+            if (HegemonikonLog::enabled(HegemonikonLogLevel::Warning))
+            {
+                std::cerr << "LlamaModelRegistry Warning: resident models exceed the memory budget after loading "
+                          << params.model_path << " (" << footprint.to_string() << ")" << std::endl;
+            }
+        }
+    }
+    unload_all(evicted);
+    return model;
+}
+
+/**
+ * @brief Checks whether a model is resident.
+ */
+bool LlamaModelRegistry::contains(const HegemonikonLlamaModelParams &params) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(params.hash());
+    return it != entries_.end() && it->second.params == params;
+}
+
+/**
+ * @brief Pins or unpins a resident model; pinned models are never evicted to make room.
+ *
+ * @param params The model parameters.
+ * @param pinned Whether the model should be pinned.
+ * @return false if the model is not resident.
+ */
+bool LlamaModelRegistry::set_pinned(const HegemonikonLlamaModelParams &params, bool pinned)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(params.hash());
+    if (it == entries_.end() || !(it->second.params == params))
+    {
+        return false;
+    }
+    it->second.pinned = pinned;
+    return true;
+}
+
+/**
+ * @brief Unloads a resident model, pinned or not, if nothing is using it.
+ *
+ * @param params The model parameters.
+ * @return true if the model was unloaded, false if it is not resident or still in use.
+ */
+bool LlamaModelRegistry::evict(const HegemonikonLlamaModelParams &params)
+{
+    std::vector<std::shared_ptr<LlamaInterface>> evicted;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(params.hash());
+        if (it == entries_.end() || !(it->second.params == params) || it->second.model.use_count() > 1)
+        {
+            return false;
+        }
+        remove_locked(it, evicted);
+        stats_.evictions++;
+    }
+    unload_all(evicted);
+    return true;
+}
+
+/**
+ * @brief Removes an idle model from the registry without unloading it.
+ *
+ * Lets the caller unload and reuse the interface object itself.
+ *
+ * @param params The model parameters.
+ * @return The model, or nullptr if it is not resident or still in use.
+ */
+std::shared_ptr<LlamaInterface> LlamaModelRegistry::detach(const HegemonikonLlamaModelParams &params)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(params.hash());
+    if (it == entries_.end() || !(it->second.params == params) || it->second.model.use_count() > 1)
+    {
+        return nullptr;
+    }
+    std::shared_ptr<LlamaInterface> model = std::move(it->second.model);
+    entries_.erase(it);
+    return model;
+}
+
+/**
+ * @brief Unloads every model that is not in use, pinned ones included.
+ *
+ * @return Number of models unloaded.
+ */
+size_t LlamaModelRegistry::clear()
+{
+    std::vector<std::shared_ptr<LlamaInterface>> evicted;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto it = entries_.begin(); it != entries_.end();)
+        {
+            auto next = std::next(it);
+            if (it->second.model.use_count() == 1)
+            {
+                remove_locked(it, evicted);
+                stats_.evictions++;
+            }
+            it = next;
+        }
+    }
+    const size_t n_evicted = evicted.size();
+    unload_all(evicted);
+    return n_evicted;
+}
+
+/**
+ * @brief Number of resident models.
+ */
+size_t LlamaModelRegistry::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
+
+/**
+ * @brief Returns a snapshot of the registry counters and memory accounting.
+ */
+HegemonikonModelRegistryStats LlamaModelRegistry::get_stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    HegemonikonModelRegistryStats stats = stats_;
+    stats.resident_models = static_cast<uint32_t>(entries_.size());
+    stats.ram_budget_bytes = ram_budget_bytes_;
+    stats.vram_budget_bytes = vram_budget_bytes_;
+    for (const auto &[key, entry] : entries_)
+    {
+        stats.pinned_models += entry.pinned ? 1 : 0;
+        stats.models_in_use += entry.model.use_count() > 1 ? 1 : 0;
+        stats.ram_bytes += entry.footprint.ram_bytes;
+        stats.vram_bytes += entry.footprint.vram_bytes;
+    }
+    return stats;
+}
+
+/**
+ * @brief Checks whether the resident models plus `extra` fit in the budget.
+ */
+bool LlamaModelRegistry::fits(const HegemonikonModelFootprint &extra) const
+{
+    uint64_t ram = extra.ram_bytes;
+    uint64_t vram = extra.vram_bytes;
+    for (const auto &[key, entry] : entries_)
+    {
+        ram += entry.footprint.ram_bytes;
+        vram += entry.footprint.vram_bytes;
+    }
+    return (ram_budget_bytes_ == 0 || ram <= ram_budget_bytes_) &&
+           (vram_budget_bytes_ == 0 || vram <= vram_budget_bytes_);
+}
+
+/**
+ * @brief Evicts idle, unpinned models in LRU order until `extra` fits in the budget.
+ *
+ * A model counts as idle when the registry holds the only reference to it.
+ *
+ * @param extra    Memory that must fit on top of the resident models.
+ * @param keep_key Key of an entry that must not be evicted.
+ * @param evicted  Receives the evicted models, to be unloaded once the lock is released.
+ * @return true if the budget is met.
+ */
+bool LlamaModelRegistry::make_room(const HegemonikonModelFootprint &extra, size_t keep_key,
+                                   std::vector<std::shared_ptr<LlamaInterface>> &evicted)
+{
+    while (!fits(extra))
+    {
+        auto victim = entries_.end();
+        for (auto it = entries_.begin(); it != entries_.end(); ++it)
+        {
+            const Entry &entry = it->second;
+            if (it->first == keep_key || entry.pinned || entry.model.use_count() > 1)
+                continue;
+            if (victim == entries_.end() || entry.last_used < victim->second.last_used)
+                victim = it;
+        }
+        if (victim == entries_.end())
+        {
+            return false;
+        }
+        remove_locked(victim, evicted);
+        stats_.evictions++;
+    }
+    return true;
+}
+
+void LlamaModelRegistry::remove_locked(std::unordered_map<size_t, Entry>::iterator it,
+                                       std::vector<std::shared_ptr<LlamaInterface>> &evicted)
+{
+    evicted.push_back(std::move(it->second.model));
+    entries_.erase(it);
+}
+
+/**
+ * @brief Unloads evicted models outside the registry lock.
+ */
+void LlamaModelRegistry::unload_all(std::vector<std::shared_ptr<LlamaInterface>> &evicted)
+{
+    for (auto &model : evicted)
+    {
+        model->unload_model();
+    }
+    evicted.clear();
+}
@@ -0,0 +1,124 @@
+#include "llama_ngram_lookup.hh"
+
+#include <algorithm>
+
+/**
+ * @param ngram_min Shortest n-gram matched, at least 1.
+ * @param ngram_max Longest n-gram matched, at most MAX_NGRAM.
+ */
+LlamaNgramLookup::LlamaNgramLookup(size_t ngram_min, size_t ngram_max)
+{
+    configure(ngram_min, ngram_max);
+}
+
+/**
+ * @brief Sets the n-gram lengths and empties the index.
+ *
+ * The lengths are clamped to [1, MAX_NGRAM], and `ngram_max` to at least `ngram_min`.
+ */
+void LlamaNgramLookup::configure(size_t ngram_min, size_t ngram_max)
+{
+    ngram_min_ = std::clamp<size_t>(ngram_min, 1, MAX_NGRAM);
+    ngram_max_ = std::clamp<size_t>(ngram_max, ngram_min_, MAX_NGRAM);
+    index_.assign(ngram_max_ - ngram_min_ + 1, {});
+    tokens_.clear();
+}
+
+void LlamaNgramLookup::reset()
+{
+    for (auto &index : index_)
+    {
+        index.clear();
+    }
+    tokens_.clear();
+}
+
+uint64_t LlamaNgramLookup::hash(const llama_token *tokens, size_t n)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < n; ++i)
+    {
+        h ^= static_cast<uint32_t>(tokens[i]);
+        h *= 0x100000001b3ULL;
+        h ^= h >> 29;
+    }
+    return h;
+}
+
+/**
+ * @brief Appends a token and indexes the n-grams it follows.
+ */
+void LlamaNgramLookup::push(llama_token token)
+{
+    tokens_.push_back(token);
+    const size_t pos = tokens_.size() - 1;
+    for (size_t n = ngram_min_; n <= ngram_max_ && n <= pos; ++n)
+    {
+        index_[n - ngram_min_][hash(tokens_.data() + pos - n, n)] = static_cast<uint32_t>(pos);
+    }
+}
+
+/**
+ * @brief Makes the indexed tokens equal to `tokens`.
+ *
+ * Tokens appended since the last call are indexed incrementally. If the sequence was
+ * rewritten instead (a context shift, a rejected token), the index is rebuilt.
+ */
+void LlamaNgramLookup::sync(const std::vector<llama_token> &tokens)
+{
+    size_t n_common = 0;
+    if (tokens.size() >= tokens_.size())
+    {
+        n_common = static_cast<size_t>(
+            std::mismatch(tokens_.begin(), tokens_.end(), tokens.begin()).first - tokens_.begin());
+    }
+    if (n_common < tokens_.size())
+    {
+        reset();
+        n_common = 0;
+    }
+    for (size_t i = n_common; i < tokens.size(); ++i)
+    {
+        push(tokens[i]);
+    }
+}
+
+/**
+ * @brief Proposes the tokens that followed the latest earlier occurrence of the last tokens.
+ *
+ * @param n_max Maximum number of tokens proposed.
+ * @param out   Replaced by the proposal.
+ * @return Number of tokens proposed, 0 if the last `ngram_min` tokens never appeared before.
+ */
+size_t LlamaNgramLookup::draft(size_t n_max, std::vector<llama_token> &out) const
+{
+    out.clear();
+    if (n_max == 0)
+    {
+        return 0;
+    }
+
+    const size_t n_tokens = tokens_.size();
+    for (size_t n = std::min(ngram_max_, n_tokens); n >= ngram_min_; --n)
+    {
+        const llama_token *tail = tokens_.data() + n_tokens - n;
+        const auto &index = index_[n - ngram_min_];
+        const auto it = index.find(hash(tail, n));
+        if (it == index.end())
+        {
+            continue;
+        }
+
+        const size_t next = it->second;
+        // Different n-grams may share a hash
+        if (!std::equal(tail, tail + n, tokens_.data() + next - n))
+        {
+            continue;
+        }
+
+        const size_t end = std::min(n_tokens, next + n_max);
+        out.assign(tokens_.begin() + next, tokens_.begin() + end);
+        return out.size();
+    }
+    return 0;
+}
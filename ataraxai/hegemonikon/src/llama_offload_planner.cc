@@ -0,0 +1,378 @@
+#include "llama_offload_planner.hh"
+#include "hegemonikon_log.hh"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <numeric>
+
+#include <ggml-backend.h>
+#include <gguf.h>
+#include <llama.h>
+
+namespace
+{
+    std::string format_mib(uint64_t bytes)
+    {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%.1f MiB", static_cast<double>(bytes) / (1024.0 * 1024.0));
+        return buffer;
+    }
+
+    /**
+     * @brief Reads an integer metadata value; per-layer arrays yield their largest element.
+     */
+    int32_t get_int(const gguf_context *ctx, const std::string &key, int32_t fallback)
+    {
+        const int64_t id = gguf_find_key(ctx, key.c_str());
+        if (id < 0)
+        {
+            return fallback;
+        }
+        switch (gguf_get_kv_type(ctx, id))
+        {
+        case GGUF_TYPE_UINT32:
+            return static_cast<int32_t>(gguf_get_val_u32(ctx, id));
+        case GGUF_TYPE_INT32:
+            return gguf_get_val_i32(ctx, id);
+        case GGUF_TYPE_ARRAY:
+        {
+            const gguf_type type = gguf_get_arr_type(ctx, id);
+            const size_t n = gguf_get_arr_n(ctx, id);
+            if (n == 0 || (type != GGUF_TYPE_UINT32 && type != GGUF_TYPE_INT32))
+            {
+                return fallback;
+            }
+            const auto *values = static_cast<const int32_t *>(gguf_get_arr_data(ctx, id));
+            return *std::max_element(values, values + n);
+        }
+        default:
+            return fallback;
+        }
+    }
+}
+
+/**
+ * @brief Reads the model shape and per-layer tensor sizes from a GGUF file.
+ *
+ * Only the header is parsed; no tensor data is read.
+ *
+ * @param model_path Path of the GGUF file.
+ * @param info       Receives the model information.
+ * @return true on success, false if the file cannot be parsed or has no layers.
+ */
+bool LlamaOffloadPlanner::read_model_info(const std::string &model_path, HegemonikonGgufModelInfo &info)
+{
+    gguf_init_params init_params;
+    init_params.no_alloc = true;
+    init_params.ctx = nullptr;
+    gguf_context *ctx = gguf_init_from_file(model_path.c_str(), init_params);
+    if (!ctx)
+    {
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+        {
+            std::cerr << "LlamaOffloadPlanner Error: unable to read GGUF metadata from " << model_path << std::endl;
+        }
+        return false;
+    }
+
+    info = HegemonikonGgufModelInfo();
+    const int64_t arch_id = gguf_find_key(ctx, "general.architecture");
+    if (arch_id >= 0 && gguf_get_kv_type(ctx, arch_id) == GGUF_TYPE_STRING)
+    {
+        info.architecture = gguf_get_val_str(ctx, arch_id);
+    }
+    const std::string prefix = info.architecture + ".";
+    info.n_layer = get_int(ctx, prefix + "block_count", 0);
+    info.n_embd = get_int(ctx, prefix + "embedding_length", 0);
+    info.n_head = get_int(ctx, prefix + "attention.head_count", 0);
+    info.n_head_kv = get_int(ctx, prefix + "attention.head_count_kv", info.n_head);
+    const int32_t n_embd_head = info.n_head > 0 ? info.n_embd / info.n_head : 0;
+    info.n_embd_head_k = get_int(ctx, prefix + "attention.key_length", n_embd_head);
+    info.n_embd_head_v = get_int(ctx, prefix + "attention.value_length", n_embd_head);
+
+    const int64_t tokens_id = gguf_find_key(ctx, "tokenizer.ggml.tokens");
+    info.n_vocab = tokens_id >= 0 ? static_cast<int32_t>(gguf_get_arr_n(ctx, tokens_id))
+                                  : get_int(ctx, prefix + "vocab_size", 0);
+
+    info.layer_bytes.assign(static_cast<size_t>(std::max(0, info.n_layer)), 0);
+    const int64_t n_tensors = gguf_get_n_tensors(ctx);
+    for (int64_t i = 0; i < n_tensors; ++i)
+    {
+        const char *name = gguf_get_tensor_name(ctx, i);
+        const uint64_t size = gguf_get_tensor_size(ctx, i);
+        int layer = -1;
+        if (std::sscanf(name, "blk.%d.", &layer) == 1 && layer >= 0 && layer < info.n_layer)
+        {
+            info.layer_bytes[static_cast<size_t>(layer)] += size;
+        }
+        else if (std::strncmp(name, "token_embd", 10) == 0)
+        {
+            info.input_bytes += size;
+        }
+        else
+        {
+            info.output_bytes += size;
+        }
+    }
+    gguf_free(ctx);
+
+    if (info.n_layer <= 0)
+    {
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+        {
+            std::cerr << "LlamaOffloadPlanner Error: no layer count in " << model_path << std::endl;
+        }
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Lists the GPUs llama.cpp can offload to, with their current free memory.
+ *
+ * Integrated GPUs are only listed when there is no discrete one, as llama.cpp does. The
+ * order is the one main_gpu indexes.
+ */
+std::vector<HegemonikonGpuDevice> LlamaOffloadPlanner::query_devices()
+{
+    LlamaInterface::init_backend();
+
+    std::vector<HegemonikonGpuDevice> gpus;
+    std::vector<HegemonikonGpuDevice> igpus;
+    for (size_t i = 0; i < ggml_backend_dev_count(); ++i)
+    {
+        ggml_backend_dev_t dev = ggml_backend_dev_get(i);
+        const enum ggml_backend_dev_type type = ggml_backend_dev_type(dev);
+        if (type != GGML_BACKEND_DEVICE_TYPE_GPU && type != GGML_BACKEND_DEVICE_TYPE_IGPU)
+        {
+            continue;
+        }
+        HegemonikonGpuDevice device;
+        device.name = ggml_backend_dev_name(dev);
+        device.description = ggml_backend_dev_description(dev);
+        size_t free_bytes = 0;
+        size_t total_bytes = 0;
+        ggml_backend_dev_memory(dev, &free_bytes, &total_bytes);
+        device.free_bytes = free_bytes;
+        device.total_bytes = total_bytes;
+        (type == GGML_BACKEND_DEVICE_TYPE_GPU ? gpus : igpus).push_back(device);
+    }
+    return gpus.empty() ? igpus : gpus;
+}
+
+/**
+ * @brief Size of the KV cache of one layer for a context of `n_ctx` tokens.
+ *
+ * @param type_k Type of the K cache, as in HegemonikonLlamaModelParams::cache_type_k.
+ * @param type_v Type of the V cache.
+ */
+uint64_t LlamaOffloadPlanner::kv_bytes_per_layer(const HegemonikonGgufModelInfo &info, int32_t n_ctx,
+                                                 const std::string &type_k, const std::string &type_v)
+{
+    const double n_ctx_tokens = static_cast<double>(std::max(0, n_ctx));
+    const double n_head_kv = static_cast<double>(std::max(0, info.n_head_kv));
+    const double k_bytes = LlamaInterface::cache_type_bytes(type_k) * std::max(0, info.n_embd_head_k);
+    const double v_bytes = LlamaInterface::cache_type_bytes(type_v) * std::max(0, info.n_embd_head_v);
+    return static_cast<uint64_t>(n_ctx_tokens * n_head_kv * (k_bytes + v_bytes));
+}
+
+/**
+ * @brief Rough size of the compute buffer of the main device.
+ *
+ * Dominated by the logits of a micro-batch, the attention scores of a micro-batch over
+ * the whole context, and a few activations of width n_embd per token.
+ */
+uint64_t LlamaOffloadPlanner::compute_buffer_bytes(const HegemonikonGgufModelInfo &info,
+                                                   const HegemonikonLlamaModelParams &params)
+{
+    const uint64_t n_ubatch = static_cast<uint64_t>(std::max(1, std::min({params.n_ubatch, params.n_batch, params.n_ctx})));
+    const uint64_t n_ctx = static_cast<uint64_t>(std::max(0, params.n_ctx));
+    const uint64_t logits = n_ubatch * static_cast<uint64_t>(std::max(0, info.n_vocab));
+    const uint64_t scores = n_ubatch * n_ctx * static_cast<uint64_t>(std::max(0, info.n_head));
+    const uint64_t activations = 8 * n_ubatch * static_cast<uint64_t>(std::max(0, info.n_embd));
+    return sizeof(float) * (logits + scores + activations);
+}
+
+/**
+ * @brief Checks whether offloaded layers fit when spread over devices with the given shares.
+ *
+ * @param budgets          Usable memory of each device.
+ * @param shares           Fraction of the offloaded layers each device receives.
+ * @param layers_bytes     Total size of the offloaded layers, KV cache included.
+ * @param main_extra_bytes Memory needed on the main device only.
+ * @param main_device      Index of the main device.
+ * @param device_bytes     Receives the memory expected on each device.
+ * @return true if every device stays within its budget.
+ */
+bool LlamaOffloadPlanner::fits_on(const std::vector<uint64_t> &budgets, const std::vector<double> &shares,
+                                  uint64_t layers_bytes, uint64_t main_extra_bytes, size_t main_device,
+                                  std::vector<uint64_t> &device_bytes)
+{
+    device_bytes.assign(budgets.size(), 0);
+    bool fits = true;
+    for (size_t d = 0; d < budgets.size(); ++d)
+    {
+        device_bytes[d] = static_cast<uint64_t>(static_cast<double>(layers_bytes) * shares[d]) +
+                          (d == main_device ? main_extra_bytes : 0);
+        fits = fits && device_bytes[d] <= budgets[d];
+    }
+    return fits;
+}
+
+/**
+ * @brief Plans the offload of a model described by `info` on the given devices.
+ *
+ * @param info           Model shape and tensor sizes.
+ * @param params         Load parameters; n_ctx, n_batch and n_ubatch size the buffers.
+ * @param devices        Candidate devices and their free memory.
+ * @param headroom_bytes Memory left free on every device for other processes and drivers.
+ * @return The plan, n_gpu_layers = 0 when nothing can be offloaded.
+ */
+HegemonikonOffloadPlan LlamaOffloadPlanner::plan(const HegemonikonGgufModelInfo &info,
+                                                 const HegemonikonLlamaModelParams &params,
+                                                 const std::vector<HegemonikonGpuDevice> &devices,
+                                                 uint64_t headroom_bytes)
+{
+    HegemonikonOffloadPlan plan;
+    plan.n_layer = info.n_layer;
+    plan.weights_bytes = info.weights_bytes();
+    const uint64_t kv_layer = kv_bytes_per_layer(info, params.n_ctx, params.cache_type_k, params.cache_type_v);
+    plan.kv_bytes = kv_layer * static_cast<uint64_t>(std::max(0, info.n_layer));
+    plan.compute_bytes = compute_buffer_bytes(info, params);
+    plan.device_bytes.assign(devices.size(), 0);
+
+    plan.reasons.push_back("model: " + std::to_string(info.n_layer) + " layers, " + format_mib(plan.weights_bytes) +
+                           " of weights, KV cache " + format_mib(kv_layer) + " per layer at n_ctx=" +
+                           std::to_string(params.n_ctx) + ", compute buffer ~" + format_mib(plan.compute_bytes));
+
+    if (devices.empty() || info.n_layer <= 0)
+    {
+        plan.reasons.push_back(devices.empty() ? "no GPU device available, running on CPU"
+                                               : "unknown model shape, running on CPU");
+        plan.host_bytes = plan.weights_bytes + plan.kv_bytes + plan.compute_bytes;
+        return plan;
+    }
+
+    std::vector<uint64_t> budgets(devices.size(), 0);
+    size_t best_device = 0;
+    uint64_t total_free = 0;
+    for (size_t d = 0; d < devices.size(); ++d)
+    {
+        budgets[d] = devices[d].free_bytes > headroom_bytes ? devices[d].free_bytes - headroom_bytes : 0;
+        total_free += devices[d].free_bytes;
+        if (devices[d].free_bytes > devices[best_device].free_bytes)
+        {
+            best_device = d;
+        }
+        plan.reasons.push_back("device " + std::to_string(d) + " (" + devices[d].name + "): " +
+                               format_mib(devices[d].free_bytes) + " free, " + format_mib(budgets[d]) +
+                               " usable after " + format_mib(headroom_bytes) + " headroom");
+    }
+
+    // Offloading n layers moves the last n repeating layers; n = n_layer + 1 also moves the output.
+    auto offloaded_bytes = [&info, kv_layer](int32_t n)
+    {
+        uint64_t bytes = 0;
+        const int32_t n_repeating = std::min(n, info.n_layer);
+        for (int32_t i = info.n_layer - n_repeating; i < info.n_layer; ++i)
+        {
+            bytes += info.layer_bytes[static_cast<size_t>(i)] + kv_layer;
+        }
+        if (n > info.n_layer)
+        {
+            bytes += info.output_bytes;
+        }
+        return bytes;
+    };
+
+    auto max_layers = [&](const std::vector<double> &shares, std::vector<uint64_t> &device_bytes)
+    {
+        for (int32_t n = info.n_layer + 1; n > 0; --n)
+        {
+            if (fits_on(budgets, shares, offloaded_bytes(n), plan.compute_bytes, best_device, device_bytes))
+            {
+                return n;
+            }
+        }
+        device_bytes.assign(budgets.size(), 0);
+        return 0;
+    };
+
+    std::vector<double> single(devices.size(), 0.0);
+    single[best_device] = 1.0;
+    std::vector<uint64_t> single_bytes;
+    const int32_t n_single = max_layers(single, single_bytes);
+
+    int32_t n_split = 0;
+    std::vector<uint64_t> split_bytes;
+    if (devices.size() > 1 && total_free > 0)
+    {
+        std::vector<double> shares(devices.size(), 0.0);
+        for (size_t d = 0; d < devices.size(); ++d)
+        {
+            shares[d] = static_cast<double>(devices[d].free_bytes) / static_cast<double>(total_free);
+        }
+        n_split = max_layers(shares, split_bytes);
+    }
+
+    plan.main_gpu = static_cast<int32_t>(best_device);
+    if (n_split > n_single)
+    {
+        plan.n_gpu_layers = n_split;
+        plan.tensor_split = true;
+        plan.device_bytes = split_bytes;
+        plan.reasons.push_back("splitting layers across " + std::to_string(devices.size()) +
+                               " devices in proportion to their free memory offloads " + std::to_string(n_split) +
+                               " layers instead of " + std::to_string(n_single) + " on a single device");
+    }
+    else
+    {
+        plan.n_gpu_layers = n_single;
+        plan.device_bytes = single_bytes;
+    }
+
+    plan.full_offload = plan.n_gpu_layers > info.n_layer;
+    if (plan.n_gpu_layers == 0)
+    {
+        plan.reasons.push_back("not even one layer fits in the usable device memory, running on CPU");
+    }
+    else if (plan.full_offload)
+    {
+        plan.reasons.push_back("full offload fits" + std::string(plan.tensor_split ? "" : " on " + devices[best_device].name));
+    }
+    else
+    {
+        plan.reasons.push_back("partial offload: " + std::to_string(plan.n_gpu_layers) + " of " +
+                               std::to_string(info.n_layer) + " layers fit, the rest runs on CPU");
+    }
+
+    plan.host_bytes = info.input_bytes + offloaded_bytes(info.n_layer + 1) - offloaded_bytes(plan.n_gpu_layers) +
+                      (plan.n_gpu_layers == 0 ? plan.compute_bytes : 0);
+    return plan;
+}
+
+/**
+ * @brief Plans the offload of the model at `params.model_path` on the devices of this machine.
+ *
+ * @param params         Load parameters of the model.
+ * @param headroom_bytes Memory left free on every device.
+ * @return The plan; it keeps the model on CPU if the metadata cannot be read or the build
+ *         has no GPU backend.
+ */
+HegemonikonOffloadPlan LlamaOffloadPlanner::plan(const HegemonikonLlamaModelParams &params, uint64_t headroom_bytes)
+{
+    HegemonikonGgufModelInfo info;
+    if (!read_model_info(params.model_path, info))
+    {
+        HegemonikonOffloadPlan plan;
+        plan.reasons.push_back("could not read the GGUF metadata of " + params.model_path + ", running on CPU");
+        return plan;
+    }
+    if (!llama_supports_gpu_offload())
+    {
+        return LlamaOffloadPlanner::plan(info, params, {}, headroom_bytes);
+    }
+    return LlamaOffloadPlanner::plan(info, params, query_devices(), headroom_bytes);
+}
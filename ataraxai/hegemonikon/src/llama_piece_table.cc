@@ -0,0 +1,151 @@
+#include "llama_piece_table.hh"
+#include "hegemonikon_log.hh"
+
+#include <cstring>
+#include <iostream>
+
+/**
+ * @brief Binds the table to a vocabulary; the pieces are extracted on first use.
+ *
+ * @param vocab The vocabulary of the loaded model (must outlive the table).
+ */
+LlamaPieceTable::LlamaPieceTable(const llama_vocab *vocab)
+    : vocab_(vocab)
+{
+}
+
+/**
+ * @brief Extracts the piece of every token into the arena, once.
+ *
+ * Pieces are rendered with special tokens enabled and no leading-space stripping, which
+ * is what the generation loop and detokenization have always used.
+ */
+void LlamaPieceTable::ensure_built() const
+{
+    std::call_once(built_, [this]()
+                   {
+        const int32_t n_vocab = vocab_ ? llama_vocab_n_tokens(vocab_) : 0;
+        offsets_.assign(1, 0);
+        if (n_vocab <= 0)
+        {
+            return;
+        }
+
+        offsets_.reserve(static_cast<size_t>(n_vocab) + 1);
+        arena_.reserve(static_cast<size_t>(n_vocab) * 6);
+
+        std::vector<char> buf(256);
+        for (int32_t token = 0; token < n_vocab; ++token)
+        {
+            int32_t n = llama_token_to_piece(vocab_, token, buf.data(), static_cast<int32_t>(buf.size()), 0, true);
+            if (n < 0)
+            {
+                buf.resize(static_cast<size_t>(-n));
+                n = llama_token_to_piece(vocab_, token, buf.data(), static_cast<int32_t>(buf.size()), 0, true);
+            }
+            if (n > 0)
+            {
+                arena_.append(buf.data(), static_cast<size_t>(n));
+            }
+            else if (n < 0)
+            {
+                if (HegemonikonLog::enabled(HegemonikonLogLevel::Warning))
+                {
+                    std::cerr << "LlamaPieceTable Warning: failed to convert token " << token << " to piece" << std::endl;
+                }
+            }
+            offsets_.push_back(static_cast<uint32_t>(arena_.size()));
+        }
+        arena_.shrink_to_fit(); });
+}
+
+/**
+ * @brief Returns the text piece of a token.
+ *
+ * @param token The token id.
+ * @return A view into the arena, empty for ids outside the vocabulary.
+ */
+std::string_view LlamaPieceTable::piece(llama_token token) const
+{
+    ensure_built();
+    if (token < 0 || static_cast<size_t>(token) + 1 >= offsets_.size())
+    {
+        return {};
+    }
+    return std::string_view(arena_.data() + offsets_[token], offsets_[token + 1] - offsets_[token]);
+}
+
+/**
+ * @brief Appends the piece of a token.
+ *
+ * @param token The token id.
+ * @param out   The string to append to.
+ * @return false if the token is outside the vocabulary.
+ */
+bool LlamaPieceTable::append(llama_token token, std::string &out) const
+{
+    ensure_built();
+    if (token < 0 || static_cast<size_t>(token) + 1 >= offsets_.size())
+    {
+        return false;
+    }
+    out.append(arena_.data() + offsets_[token], offsets_[token + 1] - offsets_[token]);
+    return true;
+}
+
+/**
+ * @brief Appends the concatenated pieces of a token array.
+ *
+ * The output length is computed first so the string is grown exactly once, then each
+ * piece is copied straight from the arena.
+ *
+ * @param tokens   The token ids.
+ * @param n_tokens Number of tokens.
+ * @param out      The string to append to; left untouched on failure.
+ * @return false if any token is outside the vocabulary.
+ */
+bool LlamaPieceTable::detokenize(const llama_token *tokens, size_t n_tokens, std::string &out) const
+{
+    ensure_built();
+    const size_t n_vocab = offsets_.size() - 1;
+
+    size_t total = 0;
+    for (size_t i = 0; i < n_tokens; ++i)
+    {
+        const llama_token token = tokens[i];
+        if (token < 0 || static_cast<size_t>(token) >= n_vocab)
+        {
+            return false;
+        }
+        total += offsets_[token + 1] - offsets_[token];
+    }
+
+    size_t pos = out.size();
+    out.resize(pos + total);
+    for (size_t i = 0; i < n_tokens; ++i)
+    {
+        const uint32_t begin = offsets_[tokens[i]];
+        const uint32_t len = offsets_[tokens[i] + 1] - begin;
+        std::memcpy(&out[pos], arena_.data() + begin, len);
+        pos += len;
+    }
+    return true;
+}
+
+/**
+ * @brief Number of tokens covered by the table.
+ */
+size_t LlamaPieceTable::size() const
+{
+    ensure_built();
+    return offsets_.size() - 1;
+}
+
+/**
+ * @brief Size of the piece arena in bytes.
+ */
+size_t LlamaPieceTable::arena_bytes() const
+{
+    ensure_built();
+    return arena_.size();
+}
@@ -0,0 +1,288 @@
+#include "llama_prefix_cache.hh"
+
+#include <algorithm>
+
+/**
+ * @brief Resets the cache and assigns the reserved sequences it may use.
+ *
+ * @param seq_ids    Sequence ids reserved for cached prefixes, one entry per id.
+ * @param max_tokens Upper bound on the total number of tokens kept in the cache.
+ * @param block_size Granularity, in tokens, at which prefixes are hashed and matched.
+ */
+void LlamaPrefixCache::configure(const std::vector<llama_seq_id> &seq_ids, size_t max_tokens, size_t block_size)
+{
+    entries_.clear();
+    entries_.resize(seq_ids.size());
+    for (size_t i = 0; i < seq_ids.size(); ++i)
+    {
+        entries_[i].seq_id = seq_ids[i];
+    }
+    max_tokens_ = max_tokens;
+    block_size_ = std::max<size_t>(1, block_size);
+    cached_tokens_ = 0;
+    clock_ = 0;
+    last_prompt_hashes_.clear();
+    hits_ = misses_ = reused_tokens_ = evictions_ = 0;
+}
+
+/**
+ * @brief Rounds a token count down to a whole number of blocks.
+ *
+ * @param n_tokens The token count.
+ * @return size_t The largest multiple of the block size not greater than n_tokens.
+ */
+size_t LlamaPrefixCache::aligned_length(size_t n_tokens) const
+{
+    return (n_tokens / block_size_) * block_size_;
+}
+
+/**
+ * @brief Computes the chained FNV-1a hash of every complete block of a token prefix.
+ *
+ * Element k hashes tokens [0, (k + 1) * block_size), so two prefixes share their
+ * first k hashes exactly when they share their first k blocks (modulo collisions).
+ *
+ * @param tokens   The tokens to hash.
+ * @param n_tokens Number of leading tokens to consider.
+ * @return std::vector<uint64_t> One hash per complete block.
+ */
+std::vector<uint64_t> LlamaPrefixCache::block_hashes(const std::vector<llama_token> &tokens, size_t n_tokens) const
+{
+    constexpr uint64_t FNV_OFFSET = 1469598103934665603ULL;
+    constexpr uint64_t FNV_PRIME = 1099511628211ULL;
+
+    const size_t n_blocks = std::min(n_tokens, tokens.size()) / block_size_;
+    std::vector<uint64_t> hashes;
+    hashes.reserve(n_blocks);
+
+    uint64_t h = FNV_OFFSET;
+    for (size_t b = 0; b < n_blocks; ++b)
+    {
+        for (size_t i = b * block_size_; i < (b + 1) * block_size_; ++i)
+        {
+            uint32_t t = static_cast<uint32_t>(tokens[i]);
+            for (int byte = 0; byte < 4; ++byte)
+            {
+                h ^= (t >> (byte * 8)) & 0xFF;
+                h *= FNV_PRIME;
+            }
+        }
+        hashes.push_back(h);
+    }
+    return hashes;
+}
+
+/**
+ * @brief Finds the cached prefix sharing the most leading blocks with a prompt.
+ *
+ * Updates the hit/miss counters and the recency of the matched entry.
+ *
+ * @param tokens The prompt tokens.
+ * @param n_max  Maximum number of tokens the caller can take from the cache.
+ * @return LlamaPrefixMatch The matching sequence and matched length, or seq_id -1 on a miss.
+ */
+LlamaPrefixMatch LlamaPrefixCache::lookup(const std::vector<llama_token> &tokens, size_t n_max)
+{
+    LlamaPrefixMatch match;
+    if (!enabled() || aligned_length(std::min(n_max, tokens.size())) == 0)
+    {
+        return match;
+    }
+
+    const std::vector<uint64_t> hashes = block_hashes(tokens, n_max);
+
+    Entry *best = nullptr;
+    size_t best_blocks = 0;
+    for (auto &entry : entries_)
+    {
+        size_t n = 0;
+        const size_t limit = std::min(hashes.size(), entry.block_hashes.size());
+        while (n < limit && entry.block_hashes[n] == hashes[n])
+        {
+            ++n;
+        }
+        if (n > best_blocks)
+        {
+            best = &entry;
+            best_blocks = n;
+        }
+    }
+
+    const size_t n_match = best_blocks * block_size_;
+    if (!best || !std::equal(tokens.begin(), tokens.begin() + n_match, best->tokens.begin()))
+    {
+        ++misses_;
+        return match;
+    }
+
+    best->last_used = ++clock_;
+    ++hits_;
+    reused_tokens_ += n_match;
+    match.seq_id = best->seq_id;
+    match.n_tokens = n_match;
+    return match;
+}
+
+/**
+ * @brief Reserves a sequence for the prefix a prompt shares with the previous one.
+ *
+ * Only the blocks a prompt has in common with the prompt offered before it are cached,
+ * so recurring preambles get an entry while request-specific content does not. The
+ * prefix is further truncated to the token budget. Nothing is inserted when an existing
+ * entry already covers it. Entries are evicted least recently used first until the new
+ * prefix fits; their ids are returned so the caller can clear them.
+ *
+ * @param tokens   The prompt tokens whose prefix should be cached.
+ * @param n_tokens Number of leading tokens available in the source sequence.
+ * @param seq_id   Receives the reserved sequence that must receive the KV copy.
+ * @param evicted  Receives the sequences whose KV content must be removed first.
+ * @return size_t Number of leading tokens the caller must copy into seq_id, 0 if nothing was inserted.
+ */
+size_t LlamaPrefixCache::insert(const std::vector<llama_token> &tokens, size_t n_tokens,
+                                llama_seq_id &seq_id, std::vector<llama_seq_id> &evicted)
+{
+    evicted.clear();
+    if (!enabled())
+    {
+        return 0;
+    }
+
+    std::vector<uint64_t> hashes = block_hashes(tokens, std::min(n_tokens, max_tokens_));
+
+    size_t n_shared = 0;
+    const size_t limit = std::min(hashes.size(), last_prompt_hashes_.size());
+    while (n_shared < limit && hashes[n_shared] == last_prompt_hashes_[n_shared])
+    {
+        ++n_shared;
+    }
+    last_prompt_hashes_ = hashes;
+
+    const size_t n_insert = n_shared * block_size_;
+    if (n_insert == 0)
+    {
+        return 0;
+    }
+    hashes.resize(n_shared);
+
+    for (const auto &entry : entries_)
+    {
+        if (entry.block_hashes.size() >= hashes.size() &&
+            std::equal(hashes.begin(), hashes.end(), entry.block_hashes.begin()))
+        {
+            return 0;
+        }
+    }
+
+    Entry *target = nullptr;
+    for (auto &entry : entries_)
+    {
+        if (entry.tokens.empty())
+        {
+            target = &entry;
+            break;
+        }
+    }
+    if (!target)
+    {
+        target = lru_entry();
+        evicted.push_back(target->seq_id);
+        release(*target);
+        ++evictions_;
+    }
+
+    while (cached_tokens_ + n_insert > max_tokens_)
+    {
+        Entry *victim = lru_entry();
+        if (!victim)
+            break;
+        evicted.push_back(victim->seq_id);
+        release(*victim);
+        ++evictions_;
+    }
+
+    target->tokens.assign(tokens.begin(), tokens.begin() + n_insert);
+    target->block_hashes = hashes;
+    target->last_used = ++clock_;
+    cached_tokens_ += n_insert;
+    seq_id = target->seq_id;
+    return n_insert;
+}
+
+/**
+ * @brief Evicts the least recently used entry.
+ *
+ * @return llama_seq_id The sequence whose KV content must be removed, or -1 if the cache is empty.
+ */
+llama_seq_id LlamaPrefixCache::evict_lru()
+{
+    Entry *victim = lru_entry();
+    if (!victim)
+    {
+        return -1;
+    }
+    llama_seq_id seq_id = victim->seq_id;
+    release(*victim);
+    ++evictions_;
+    return seq_id;
+}
+
+/**
+ * @brief Drops every cached prefix.
+ *
+ * @return std::vector<llama_seq_id> The sequences whose KV content must be removed.
+ */
+std::vector<llama_seq_id> LlamaPrefixCache::clear()
+{
+    std::vector<llama_seq_id> released;
+    for (auto &entry : entries_)
+    {
+        if (!entry.tokens.empty())
+        {
+            released.push_back(entry.seq_id);
+            release(entry);
+        }
+    }
+    return released;
+}
+
+/**
+ * @brief Returns a snapshot of the cache counters.
+ *
+ * @return HegemonikonPrefixCacheStats The current statistics.
+ */
+HegemonikonPrefixCacheStats LlamaPrefixCache::get_stats() const
+{
+    HegemonikonPrefixCacheStats stats;
+    stats.hits = hits_;
+    stats.misses = misses_;
+    stats.reused_tokens = reused_tokens_;
+    stats.cached_tokens = cached_tokens_;
+    stats.evictions = evictions_;
+    for (const auto &entry : entries_)
+    {
+        if (!entry.tokens.empty())
+            ++stats.entries;
+    }
+    return stats;
+}
+
+LlamaPrefixCache::Entry *LlamaPrefixCache::lru_entry()
+{
+    Entry *victim = nullptr;
+    for (auto &entry : entries_)
+    {
+        if (entry.tokens.empty())
+            continue;
+        if (!victim || entry.last_used < victim->last_used)
+            victim = &entry;
+    }
+    return victim;
+}
+
+void LlamaPrefixCache::release(Entry &entry)
+{
+    cached_tokens_ -= entry.tokens.size();
+    entry.tokens.clear();
+    entry.block_hashes.clear();
+    entry.last_used = 0;
+}
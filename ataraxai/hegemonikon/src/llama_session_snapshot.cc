@@ -0,0 +1,523 @@
+#include "llama_session_snapshot.hh"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <random>
+
+#include "argon2/blake2.h"
+#include "memory_locker.hh"
+
+namespace
+{
+    constexpr char MAGIC[4] = {'H', 'K', 'V', 'S'};
+    constexpr uint32_t FORMAT_VERSION = 1;
+    constexpr uint32_t FLAG_ENCRYPTED = 1u << 0;
+    constexpr size_t NONCE_BYTES = 16;
+    constexpr size_t SUBKEY_BYTES = 32;
+    constexpr size_t TAG_BYTES = 32;
+    constexpr size_t KEYSTREAM_BLOCK = BLAKE2B_OUTBYTES;
+    constexpr size_t IO_CHUNK_BYTES = 1u << 20;
+
+    /**
+     * @brief Fixed-size file header; stored in native byte order since snapshots are a
+     * local cache, never exchanged between machines.
+     */
+    struct SnapshotHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint32_t flags;
+        uint32_t n_tokens;
+        uint64_t model_hash;
+        uint64_t prefix_hash;
+        uint64_t state_bytes;
+        uint8_t nonce[NONCE_BYTES];
+    };
+
+    struct FileCloser
+    {
+        void operator()(std::FILE *file) const { std::fclose(file); }
+    };
+    using FilePtr = std::unique_ptr<std::FILE, FileCloser>;
+
+    /**
+     * @brief Subkeys derived from the caller's key, wiped on destruction.
+     */
+    struct SnapshotKeys
+    {
+        uint8_t enc[SUBKEY_BYTES];
+        uint8_t mac[SUBKEY_BYTES];
+        uint8_t prefix[SUBKEY_BYTES];
+
+        ~SnapshotKeys() { secure_memset(this, 0, sizeof(*this)); }
+    };
+
+    bool valid_key(const SecureKey &key)
+    {
+        return key.data() && key.size() > 0 && key.size() <= BLAKE2B_KEYBYTES;
+    }
+
+    bool derive_keys(const SecureKey &key, SnapshotKeys &keys)
+    {
+        if (!valid_key(key))
+        {
+            return false;
+        }
+        static const char ENC_LABEL[] = "hegemonikon.kvsnap.enc";
+        static const char MAC_LABEL[] = "hegemonikon.kvsnap.mac";
+        static const char PREFIX_LABEL[] = "hegemonikon.kvsnap.prefix";
+        return blake2b(keys.enc, SUBKEY_BYTES, ENC_LABEL, sizeof(ENC_LABEL) - 1, key.data(), key.size()) == 0 &&
+               blake2b(keys.mac, SUBKEY_BYTES, MAC_LABEL, sizeof(MAC_LABEL) - 1, key.data(), key.size()) == 0 &&
+               blake2b(keys.prefix, SUBKEY_BYTES, PREFIX_LABEL, sizeof(PREFIX_LABEL) - 1, key.data(), key.size()) == 0;
+    }
+
+    /**
+     * @brief XORs `data` with the keystream starting at byte `offset` of the payload.
+     *
+     * Keystream block i is BLAKE2b(enc_key, nonce || i), so any offset can be reached
+     * without generating the blocks before it.
+     */
+    void apply_keystream(const SnapshotKeys &keys, const uint8_t *nonce, uint64_t offset, uint8_t *data, size_t size)
+    {
+        uint8_t input[NONCE_BYTES + sizeof(uint64_t)];
+        uint8_t block[KEYSTREAM_BLOCK];
+        std::memcpy(input, nonce, NONCE_BYTES);
+
+        uint64_t counter = offset / KEYSTREAM_BLOCK;
+        size_t skip = static_cast<size_t>(offset % KEYSTREAM_BLOCK);
+        size_t done = 0;
+        while (done < size)
+        {
+            std::memcpy(input + NONCE_BYTES, &counter, sizeof(counter));
+            blake2b(block, KEYSTREAM_BLOCK, input, sizeof(input), keys.enc, SUBKEY_BYTES);
+            const size_t n = std::min(KEYSTREAM_BLOCK - skip, size - done);
+            for (size_t i = 0; i < n; ++i)
+            {
+                data[done + i] ^= block[skip + i];
+            }
+            done += n;
+            skip = 0;
+            ++counter;
+        }
+        secure_memset(block, 0, sizeof(block));
+    }
+
+    bool constant_time_equal(const uint8_t *a, const uint8_t *b, size_t size)
+    {
+        uint8_t diff = 0;
+        for (size_t i = 0; i < size; ++i)
+        {
+            diff |= static_cast<uint8_t>(a[i] ^ b[i]);
+        }
+        return diff == 0;
+    }
+
+    bool read_header(std::FILE *file, SnapshotHeader &header)
+    {
+        return std::fread(&header, sizeof(header), 1, file) == 1 &&
+               std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 &&
+               header.version == FORMAT_VERSION;
+    }
+
+    /**
+     * @brief Whether a directory entry is a snapshot of the given model, judging by its name.
+     */
+    bool is_model_snapshot(const std::filesystem::directory_entry &entry, const std::string &model_prefix)
+    {
+        if (!entry.is_regular_file())
+        {
+            return false;
+        }
+        const std::string name = entry.path().filename().string();
+        return name.size() > model_prefix.size() &&
+               name.compare(0, model_prefix.size(), model_prefix) == 0 &&
+               entry.path().extension() == LlamaSessionSnapshot::FILE_EXTENSION;
+    }
+
+    std::string model_prefix(uint64_t model_hash)
+    {
+        return LlamaSessionSnapshot::file_name(model_hash, 0).substr(0, 17);
+    }
+}
+
+/**
+ * @brief Hashes a token prefix as used in snapshot file names.
+ *
+ * @param tokens   The tokens to hash.
+ * @param n_tokens Number of tokens.
+ * @param key      Optional key; when set the hash is keyed, as for encrypted snapshots.
+ * @return uint64_t The 64-bit BLAKE2b digest of the tokens.
+ */
+uint64_t LlamaSessionSnapshot::hash_tokens(const llama_token *tokens, size_t n_tokens, const SecureKey *key)
+{
+    blake2b_state state;
+    SnapshotKeys keys;
+    if (key && derive_keys(*key, keys))
+    {
+        blake2b_init_key(&state, sizeof(uint64_t), keys.prefix, SUBKEY_BYTES);
+    }
+    else
+    {
+        blake2b_init(&state, sizeof(uint64_t));
+    }
+    blake2b_update(&state, tokens, n_tokens * sizeof(llama_token));
+
+    uint64_t hash = 0;
+    blake2b_final(&state, &hash, sizeof(hash));
+    return hash;
+}
+
+/**
+ * @brief Returns the file name of the snapshot of a token prefix for a model.
+ */
+std::string LlamaSessionSnapshot::file_name(uint64_t model_hash, uint64_t prefix_hash)
+{
+    char buffer[64];
+    std::snprintf(buffer, sizeof(buffer), "%016llx-%016llx%s",
+                  static_cast<unsigned long long>(model_hash), static_cast<unsigned long long>(prefix_hash), FILE_EXTENSION);
+    return buffer;
+}
+
+/**
+ * @brief Writes the KV state of a sequence to a snapshot file.
+ *
+ * The file is written under a temporary name and renamed into place, so a crash never
+ * leaves a truncated snapshot behind. Older snapshots of the same model whose tokens are
+ * a prefix of `tokens` are removed: the new snapshot resumes everything they did.
+ *
+ * @param directory   Directory of the snapshots, created if missing.
+ * @param model_hash  Fingerprint of the model the state belongs to.
+ * @param tokens      Tokens held by the sequence.
+ * @param state       Output of `llama_state_seq_get_data` for the sequence.
+ * @param key         Optional key to encrypt the snapshot with.
+ * @param path        Set to the path of the snapshot on success.
+ * @param error       Set to a description of the failure otherwise.
+ * @return true if the snapshot was written.
+ */
+bool LlamaSessionSnapshot::write(const std::string &directory, uint64_t model_hash,
+                                 const std::vector<llama_token> &tokens, const std::vector<uint8_t> &state,
+                                 const SecureKey *key, std::string &path, std::string &error)
+{
+    if (tokens.empty() || state.empty())
+    {
+        error = "Nothing to snapshot";
+        return false;
+    }
+
+    SnapshotKeys keys;
+    if (key && !derive_keys(*key, keys))
+    {
+        error = "Snapshot key must be 1 to " + std::to_string(BLAKE2B_KEYBYTES) + " bytes";
+        return false;
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+    if (ec)
+    {
+        error = "Cannot create snapshot directory: " + ec.message();
+        return false;
+    }
+
+    SnapshotHeader header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = FORMAT_VERSION;
+    header.flags = key ? FLAG_ENCRYPTED : 0;
+    header.n_tokens = static_cast<uint32_t>(tokens.size());
+    header.model_hash = model_hash;
+    header.prefix_hash = hash_tokens(tokens.data(), tokens.size(), key);
+    header.state_bytes = state.size();
+    if (key)
+    {
+        std::random_device rd;
+        for (size_t i = 0; i < NONCE_BYTES; i += sizeof(uint32_t))
+        {
+            const uint32_t r = rd();
+            std::memcpy(header.nonce + i, &r, sizeof(r));
+        }
+    }
+
+    const std::filesystem::path target = std::filesystem::path(directory) / file_name(model_hash, header.prefix_hash);
+    const std::filesystem::path temp = target.string() + ".tmp";
+
+    blake2b_state mac;
+    if (key)
+    {
+        blake2b_init_key(&mac, TAG_BYTES, keys.mac, SUBKEY_BYTES);
+        blake2b_update(&mac, &header, sizeof(header));
+    }
+
+    bool ok = true;
+    {
+        FilePtr file(std::fopen(temp.string().c_str(), "wb"));
+        if (!file)
+        {
+            error = "Cannot open " + temp.string() + " for writing";
+            return false;
+        }
+        ok = std::fwrite(&header, sizeof(header), 1, file.get()) == 1;
+
+        // Payload: tokens then state, as one stream for the cipher.
+        const uint8_t *regions[2] = {reinterpret_cast<const uint8_t *>(tokens.data()), state.data()};
+        const size_t sizes[2] = {tokens.size() * sizeof(llama_token), state.size()};
+        std::vector<uint8_t> chunk(key ? IO_CHUNK_BYTES : 0);
+        uint64_t offset = 0;
+        for (int r = 0; r < 2 && ok; ++r)
+        {
+            for (size_t done = 0; done < sizes[r] && ok; done += IO_CHUNK_BYTES)
+            {
+                const size_t n = std::min(IO_CHUNK_BYTES, sizes[r] - done);
+                const uint8_t *src = regions[r] + done;
+                if (key)
+                {
+                    std::memcpy(chunk.data(), src, n);
+                    apply_keystream(keys, header.nonce, offset, chunk.data(), n);
+                    blake2b_update(&mac, chunk.data(), n);
+                    src = chunk.data();
+                }
+                ok = std::fwrite(src, 1, n, file.get()) == n;
+                offset += n;
+            }
+        }
+        secure_memset(chunk.data(), 0, chunk.size());
+
+        if (ok && key)
+        {
+            uint8_t tag[TAG_BYTES];
+            blake2b_final(&mac, tag, TAG_BYTES);
+            ok = std::fwrite(tag, 1, TAG_BYTES, file.get()) == TAG_BYTES;
+        }
+        ok = std::fflush(file.get()) == 0 && ok;
+    }
+
+    if (ok)
+    {
+        std::filesystem::rename(temp, target, ec);
+        ok = !ec;
+    }
+    if (!ok)
+    {
+        std::filesystem::remove(temp, ec);
+        error = "Failed to write snapshot " + target.string();
+        return false;
+    }
+
+    for (const HegemonikonSessionSnapshotInfo &info : list(directory, model_hash))
+    {
+        if (info.n_tokens < tokens.size() && info.encrypted == (key != nullptr) &&
+            info.prefix_hash == hash_tokens(tokens.data(), info.n_tokens, key))
+        {
+            std::filesystem::remove(info.path, ec);
+        }
+    }
+
+    path = target.string();
+    return true;
+}
+
+/**
+ * @brief Reads the header of a snapshot file.
+ *
+ * @param path The snapshot file.
+ * @param info Filled with the header fields.
+ * @return true if the file is a snapshot in a supported format.
+ */
+bool LlamaSessionSnapshot::read_info(const std::string &path, HegemonikonSessionSnapshotInfo &info)
+{
+    FilePtr file(std::fopen(path.c_str(), "rb"));
+    SnapshotHeader header;
+    if (!file || !read_header(file.get(), header))
+    {
+        return false;
+    }
+    info.path = path;
+    info.model_hash = header.model_hash;
+    info.prefix_hash = header.prefix_hash;
+    info.n_tokens = header.n_tokens;
+    info.state_bytes = header.state_bytes;
+    info.encrypted = (header.flags & FLAG_ENCRYPTED) != 0;
+    return true;
+}
+
+/**
+ * @brief Reads the tokens and KV state stored in a snapshot.
+ *
+ * Encrypted snapshots are authenticated before anything is decrypted; a wrong key or a
+ * tampered file is reported as an error and leaves `tokens` and `state` empty.
+ *
+ * @param path       The snapshot file.
+ * @param model_hash Fingerprint of the loaded model; snapshots of other models are rejected.
+ * @param key        The key the snapshot was encrypted with, nullptr for plain snapshots.
+ * @param tokens     Set to the tokens of the sequence.
+ * @param state      Set to the data for `llama_state_seq_set_data`.
+ * @param error      Set to a description of the failure.
+ * @return true on success.
+ */
+bool LlamaSessionSnapshot::read(const std::string &path, uint64_t model_hash, const SecureKey *key,
+                                std::vector<llama_token> &tokens, std::vector<uint8_t> &state, std::string &error)
+{
+    tokens.clear();
+    state.clear();
+
+    FilePtr file(std::fopen(path.c_str(), "rb"));
+    SnapshotHeader header;
+    if (!file || !read_header(file.get(), header))
+    {
+        error = "Not a session snapshot: " + path;
+        return false;
+    }
+    if (header.model_hash != model_hash)
+    {
+        error = "Snapshot was taken with another model";
+        return false;
+    }
+
+    const bool encrypted = (header.flags & FLAG_ENCRYPTED) != 0;
+    if (encrypted != (key != nullptr))
+    {
+        error = encrypted ? "Snapshot is encrypted and no key was given" : "Snapshot is not encrypted";
+        return false;
+    }
+    SnapshotKeys keys;
+    if (key && !derive_keys(*key, keys))
+    {
+        error = "Snapshot key must be 1 to " + std::to_string(BLAKE2B_KEYBYTES) + " bytes";
+        return false;
+    }
+
+    std::error_code ec;
+    const uint64_t file_bytes = std::filesystem::file_size(path, ec);
+    const uint64_t expected = sizeof(header) + uint64_t(header.n_tokens) * sizeof(llama_token) +
+                              header.state_bytes + (encrypted ? TAG_BYTES : 0);
+    if (ec || file_bytes != expected || header.n_tokens == 0)
+    {
+        error = "Snapshot is truncated or corrupted";
+        return false;
+    }
+
+    tokens.resize(header.n_tokens);
+    state.resize(static_cast<size_t>(header.state_bytes));
+    const size_t token_bytes = tokens.size() * sizeof(llama_token);
+    uint8_t tag[TAG_BYTES];
+    bool ok = std::fread(tokens.data(), 1, token_bytes, file.get()) == token_bytes &&
+              std::fread(state.data(), 1, state.size(), file.get()) == state.size() &&
+              (!encrypted || std::fread(tag, 1, TAG_BYTES, file.get()) == TAG_BYTES);
+
+    if (ok && encrypted)
+    {
+        uint8_t expected_tag[TAG_BYTES];
+        blake2b_state mac;
+        blake2b_init_key(&mac, TAG_BYTES, keys.mac, SUBKEY_BYTES);
+        blake2b_update(&mac, &header, sizeof(header));
+        blake2b_update(&mac, tokens.data(), token_bytes);
+        blake2b_update(&mac, state.data(), state.size());
+        blake2b_final(&mac, expected_tag, TAG_BYTES);
+        ok = constant_time_equal(tag, expected_tag, TAG_BYTES);
+        if (ok)
+        {
+            apply_keystream(keys, header.nonce, 0, reinterpret_cast<uint8_t *>(tokens.data()), token_bytes);
+            apply_keystream(keys, header.nonce, token_bytes, state.data(), state.size());
+        }
+        else
+        {
+            error = "Snapshot authentication failed (wrong key or tampered file)";
+        }
+    }
+    else if (!ok)
+    {
+        error = "Failed to read snapshot " + path;
+    }
+
+    if (ok && hash_tokens(tokens.data(), tokens.size(), key) != header.prefix_hash)
+    {
+        ok = false;
+        error = "Snapshot tokens do not match its prefix hash";
+    }
+    if (!ok)
+    {
+        tokens.clear();
+        state.clear();
+    }
+    return ok;
+}
+
+/**
+ * @brief Finds the longest snapshot of a model that a prompt starts with.
+ *
+ * Only the headers are read: for each snapshot of the model, the first `n_tokens` of the
+ * prompt are hashed and compared with the snapshot's prefix hash. Snapshots encrypted with
+ * another key, or plain ones when a key is given, never match.
+ *
+ * @param directory  Directory of the snapshots.
+ * @param model_hash Fingerprint of the loaded model.
+ * @param prompt     Tokens of the prompt about to be sent.
+ * @param key        Key used for the session's snapshots, or nullptr.
+ * @param best       Set to the header of the best snapshot.
+ * @return true if a snapshot matched.
+ */
+bool LlamaSessionSnapshot::find_best(const std::string &directory, uint64_t model_hash,
+                                     const std::vector<llama_token> &prompt, const SecureKey *key,
+                                     HegemonikonSessionSnapshotInfo &best)
+{
+    bool found = false;
+    for (const HegemonikonSessionSnapshotInfo &info : list(directory, model_hash))
+    {
+        if (info.encrypted != (key != nullptr) || info.n_tokens > prompt.size() ||
+            (found && info.n_tokens <= best.n_tokens))
+        {
+            continue;
+        }
+        if (hash_tokens(prompt.data(), info.n_tokens, key) == info.prefix_hash)
+        {
+            best = info;
+            found = true;
+        }
+    }
+    return found;
+}
+
+/**
+ * @brief Lists the snapshots of a model in a directory.
+ *
+ * @param directory  Directory of the snapshots.
+ * @param model_hash Fingerprint of the model.
+ * @return The headers of the snapshots, in no particular order.
+ */
+std::vector<HegemonikonSessionSnapshotInfo> LlamaSessionSnapshot::list(const std::string &directory, uint64_t model_hash)
+{
+    std::vector<HegemonikonSessionSnapshotInfo> infos;
+    std::error_code ec;
+    const std::string prefix = model_prefix(model_hash);
+    for (std::filesystem::directory_iterator it(directory, ec), end; !ec && it != end; it.increment(ec))
+    {
+        HegemonikonSessionSnapshotInfo info;
+        if (is_model_snapshot(*it, prefix) && read_info(it->path().string(), info) && info.model_hash == model_hash)
+        {
+            infos.push_back(std::move(info));
+        }
+    }
+    return infos;
+}
+
+/**
+ * @brief Deletes every snapshot of a model in a directory.
+ *
+ * @return size_t Number of files removed.
+ */
+size_t LlamaSessionSnapshot::remove_for_model(const std::string &directory, uint64_t model_hash)
+{
+    size_t removed = 0;
+    std::error_code ec;
+    for (const HegemonikonSessionSnapshotInfo &info : list(directory, model_hash))
+    {
+        if (std::filesystem::remove(info.path, ec))
+        {
+            ++removed;
+        }
+    }
+    return removed;
+}
@@ -0,0 +1,199 @@
+#include "llama_stop_matcher.hh"
+
+#include <deque>
+
+/**
+ * @brief Builds the automaton for the given stop sequences.
+ *
+ * @param stop_sequences The stop strings; empty ones are ignored.
+ */
+LlamaStopMatcher::LlamaStopMatcher(const std::vector<std::string> &stop_sequences)
+{
+    configure(stop_sequences);
+}
+
+/**
+ * @brief Rebuilds the automaton for a new set of stop sequences and resets the stream state.
+ *
+ * The trie of all patterns is built first, then failure links are computed breadth-first.
+ * Each node also records the length of the longest pattern ending there (following the
+ * failure chain), so a match is detected with a single lookup per input byte.
+ *
+ * @param stop_sequences The stop strings; empty ones are ignored.
+ */
+void LlamaStopMatcher::configure(const std::vector<std::string> &stop_sequences)
+{
+    nodes_.assign(1, Node{});
+
+    for (const auto &stop_seq : stop_sequences)
+    {
+        int32_t node = 0;
+        for (char ch : stop_seq)
+        {
+            const unsigned char c = static_cast<unsigned char>(ch);
+            int32_t next = child(node, c);
+            if (next < 0)
+            {
+                next = static_cast<int32_t>(nodes_.size());
+                Node created;
+                created.depth = nodes_[node].depth + 1;
+                nodes_.push_back(std::move(created));
+                nodes_[node].next.emplace_back(c, next);
+            }
+            node = next;
+        }
+        if (node != 0)
+        {
+            nodes_[node].match_len = nodes_[node].depth;
+        }
+    }
+
+    std::deque<int32_t> queue;
+    for (const auto &edge : nodes_[0].next)
+    {
+        nodes_[edge.second].fail = 0;
+        queue.push_back(edge.second);
+    }
+    while (!queue.empty())
+    {
+        const int32_t node = queue.front();
+        queue.pop_front();
+        for (const auto &edge : nodes_[node].next)
+        {
+            const int32_t target = edge.second;
+            nodes_[target].fail = step(nodes_[node].fail, edge.first);
+            if (nodes_[target].match_len == 0)
+            {
+                nodes_[target].match_len = nodes_[nodes_[target].fail].match_len;
+            }
+            queue.push_back(target);
+        }
+    }
+
+    reset();
+}
+
+/**
+ * @brief Consumes the next generated piece.
+ *
+ * @param piece   The newly generated text.
+ * @param emitted Receives the text that is now safe to stream: everything before the
+ *                match when a stop sequence completed, otherwise everything that can no
+ *                longer be the beginning of a stop sequence.
+ * @return true if a stop sequence was matched; the matcher ignores further input until reset.
+ */
+bool LlamaStopMatcher::feed(const std::string &piece, std::string &emitted)
+{
+    emitted.clear();
+    if (stopped_)
+    {
+        return true;
+    }
+    if (empty())
+    {
+        emitted = piece;
+        return false;
+    }
+
+    for (char ch : piece)
+    {
+        pending_.push_back(ch);
+        state_ = step(state_, static_cast<unsigned char>(ch));
+        const uint32_t match_len = nodes_[state_].match_len;
+        if (match_len > 0)
+        {
+            emitted.assign(pending_, 0, pending_.size() - match_len);
+            pending_.clear();
+            stopped_ = true;
+            return true;
+        }
+    }
+
+    const size_t n_hold = nodes_[state_].depth;
+    if (pending_.size() > n_hold)
+    {
+        emitted.assign(pending_, 0, pending_.size() - n_hold);
+        pending_.erase(0, pending_.size() - n_hold);
+    }
+    return false;
+}
+
+/**
+ * @brief Releases the held-back text at the end of a generation that did not hit a stop sequence.
+ *
+ * @return The text that was withheld as a potential stop-sequence prefix.
+ */
+std::string LlamaStopMatcher::flush()
+{
+    std::string tail;
+    tail.swap(pending_);
+    state_ = 0;
+    return tail;
+}
+
+/**
+ * @brief Resets the stream state, keeping the automaton.
+ */
+void LlamaStopMatcher::reset()
+{
+    state_ = 0;
+    pending_.clear();
+    stopped_ = false;
+}
+
+/**
+ * @brief Checks whether a complete text ends with one of the stop sequences.
+ *
+ * Runs the automaton over the text without touching the stream state.
+ *
+ * @param text The text to check.
+ * @return true if the text ends with a non-empty stop sequence.
+ */
+bool LlamaStopMatcher::matches_suffix(const std::string &text) const
+{
+    if (empty())
+    {
+        return false;
+    }
+    int32_t node = 0;
+    for (char ch : text)
+    {
+        node = step(node, static_cast<unsigned char>(ch));
+    }
+    return nodes_[node].match_len > 0;
+}
+
+/**
+ * @brief Returns the trie child of a node for a byte, or -1.
+ */
+int32_t LlamaStopMatcher::child(int32_t node, unsigned char c) const
+{
+    for (const auto &edge : nodes_[node].next)
+    {
+        if (edge.first == c)
+        {
+            return edge.second;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Automaton transition: follows failure links until a node has an edge for the byte.
+ */
+int32_t LlamaStopMatcher::step(int32_t node, unsigned char c) const
+{
+    while (true)
+    {
+        const int32_t next = child(node, c);
+        if (next >= 0)
+        {
+            return next;
+        }
+        if (node == 0)
+        {
+            return 0;
+        }
+        node = nodes_[node].fail;
+    }
+}
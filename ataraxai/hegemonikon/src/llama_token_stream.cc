@@ -0,0 +1,119 @@
+#include "llama_token_stream.hh"
+
+#include <exception>
+
+/**
+ * @brief Starts the generation on a background thread.
+ *
+ * @param runner Function running a streaming generation with the provided callback,
+ *               typically a bound CoreAIService::stream_prompt. Its return value is
+ *               reported by succeeded() and the error it sets by error().
+ * @param handle Optional handle of the request run by `runner`, cancelled with the stream.
+ */
+LlamaTokenStream::LlamaTokenStream(runner_t runner, std::shared_ptr<LlamaRequestHandle> handle)
+    : handle_(std::move(handle))
+{
+    worker_ = std::thread([this, runner = std::move(runner)]()
+                          {
+        bool ok = false;
+        std::string error;
+        try
+        {
+            ok = runner([this](const std::string &piece)
+                        {
+                if (cancelled_.load())
+                {
+                    return false;
+                }
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    pieces_.push_back(piece);
+                }
+                cv_.notify_one();
+                return !cancelled_.load(); }, error);
+        }
+        catch (const std::exception &e)
+        {
+            ok = false;
+            error = "[Error: " + std::string(e.what()) + "]";
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            finished_ = true;
+            success_ = ok;
+            error_ = ok ? std::string() : std::move(error);
+        }
+        cv_.notify_all(); });
+}
+
+/**
+ * @brief Cancels the generation and waits for the background thread to exit.
+ */
+LlamaTokenStream::~LlamaTokenStream()
+{
+    cancel();
+    if (worker_.joinable())
+    {
+        worker_.join();
+    }
+}
+
+/**
+ * @brief Blocks until the next piece is available.
+ *
+ * @param piece Receives the next generated piece.
+ * @return true if a piece was returned, false once the generation is over and drained.
+ */
+bool LlamaTokenStream::next(std::string &piece)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this]()
+             { return !pieces_.empty() || finished_; });
+    if (pieces_.empty())
+    {
+        return false;
+    }
+    piece = std::move(pieces_.front());
+    pieces_.pop_front();
+    return true;
+}
+
+/**
+ * @brief Asks the generation to stop after the current token.
+ */
+void LlamaTokenStream::cancel()
+{
+    cancelled_.store(true);
+    if (handle_)
+    {
+        handle_->cancel();
+    }
+}
+
+/**
+ * @brief Checks whether the generation has ended (pieces may still be queued).
+ */
+bool LlamaTokenStream::is_finished() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return finished_;
+}
+
+/**
+ * @brief Checks whether the generation ended without error.
+ */
+bool LlamaTokenStream::succeeded() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return finished_ && success_;
+}
+
+/**
+ * @brief Returns why the generation failed, empty while it runs or if it succeeded.
+ */
+std::string LlamaTokenStream::error() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return error_;
+}
@@ -0,0 +1,303 @@
+#include "llama_tuning_store.hh"
+#include "hegemonikon_log.hh"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <system_error>
+
+#include "compute_pool.hh"
+#include "json.hpp"
+#include "llama_offload_planner.hh"
+
+using json = nlohmann::json;
+
+namespace
+{
+    json params_to_json(const HegemonikonLlamaModelParams &params)
+    {
+        return json{{"n_ctx", params.n_ctx},
+                    {"n_gpu_layers", params.n_gpu_layers},
+                    {"n_batch", params.n_batch},
+                    {"n_ubatch", params.n_ubatch},
+                    {"n_threads", params.n_threads},
+                    {"n_threads_batch", params.n_threads_batch},
+                    {"cache_type_k", params.cache_type_k},
+                    {"cache_type_v", params.cache_type_v},
+                    {"flash_attn", params.flash_attn}};
+    }
+
+    HegemonikonLlamaModelParams params_from_json(const json &object)
+    {
+        HegemonikonLlamaModelParams params;
+        params.n_ctx = object.value("n_ctx", params.n_ctx);
+        params.n_gpu_layers = object.value("n_gpu_layers", params.n_gpu_layers);
+        params.n_batch = object.value("n_batch", params.n_batch);
+        params.n_ubatch = object.value("n_ubatch", params.n_ubatch);
+        params.n_threads = object.value("n_threads", params.n_threads);
+        params.n_threads_batch = object.value("n_threads_batch", params.n_threads_batch);
+        params.cache_type_k = object.value("cache_type_k", params.cache_type_k);
+        params.cache_type_v = object.value("cache_type_v", params.cache_type_v);
+        params.flash_attn = object.value("flash_attn", params.flash_attn);
+        return params;
+    }
+
+    /**
+     * @brief Name of the CPU as reported by the OS, empty where it is not available.
+     */
+    std::string cpu_model_name()
+    {
+#ifdef __linux__
+        std::ifstream cpuinfo("/proc/cpuinfo");
+        std::string line;
+        while (std::getline(cpuinfo, line))
+        {
+            if (line.rfind("model name", 0) == 0)
+            {
+                const size_t colon = line.find(':');
+                if (colon != std::string::npos)
+                {
+                    const size_t start = line.find_first_not_of(" \t", colon + 1);
+                    return start == std::string::npos ? "" : line.substr(start);
+                }
+            }
+        }
+#endif
+        return "";
+    }
+}
+
+LlamaTuningStore::LlamaTuningStore(const std::string &path) : path_(path)
+{
+}
+
+/**
+ * @brief Identifies a model file by its name and size.
+ *
+ * @return The key, or an empty string if the file cannot be read.
+ */
+std::string LlamaTuningStore::model_key(const std::string &model_path)
+{
+    std::error_code ec;
+    const uintmax_t size = std::filesystem::file_size(model_path, ec);
+    if (ec)
+    {
+        return "";
+    }
+    return std::filesystem::path(model_path).filename().string() + ":" + std::to_string(size);
+}
+
+/**
+ * @brief Identifies this machine by its CPU and offload devices.
+ *
+ * Computed once per process: the devices are queried from the llama backends.
+ */
+std::string LlamaTuningStore::machine_key()
+{
+    static const std::string key = []()
+    {
+        std::ostringstream out;
+        out << "cpu=" << cpu_model_name() << ";logical_cpus=" << HegemonikonCpuTopology::detect().n_logical_cpus << ";gpus=";
+        const std::vector<HegemonikonGpuDevice> devices = LlamaOffloadPlanner::query_devices();
+        for (size_t i = 0; i < devices.size(); ++i)
+        {
+            out << (i > 0 ? "," : "") << devices[i].description << ":" << (devices[i].total_bytes >> 20) << "MB";
+        }
+        return out.str();
+    }();
+    return key;
+}
+
+/**
+ * @brief Returns `params` with the tuned fields of `tuned` copied over it.
+ *
+ * The tuned fields are the context size, offloaded layers, batch sizes, thread counts,
+ * KV cache types and flash attention mode; the model, sessions, caches and draft model
+ * of `params` are kept.
+ */
+HegemonikonLlamaModelParams LlamaTuningStore::apply(const HegemonikonLlamaModelParams &params,
+                                                    const HegemonikonLlamaModelParams &tuned)
+{
+    HegemonikonLlamaModelParams out = params;
+    out.n_ctx = tuned.n_ctx;
+    out.n_gpu_layers = tuned.n_gpu_layers;
+    out.n_batch = tuned.n_batch;
+    out.n_ubatch = tuned.n_ubatch;
+    out.n_threads = tuned.n_threads;
+    out.n_threads_batch = tuned.n_threads_batch;
+    out.cache_type_k = tuned.cache_type_k;
+    out.cache_type_v = tuned.cache_type_v;
+    out.flash_attn = tuned.flash_attn;
+    return out;
+}
+
+/**
+ * @brief Looks up the tuned parameters of a model file on this machine.
+ *
+ * @return true if an entry was found and copied to `entry`.
+ */
+bool LlamaTuningStore::lookup(const std::string &model_path, HegemonikonTunedLlamaParams &entry) const
+{
+    const std::string model = model_key(model_path);
+    if (model.empty())
+    {
+        return false;
+    }
+    return lookup(model, machine_key(), entry);
+}
+
+bool LlamaTuningStore::lookup(const std::string &model_key, const std::string &machine_key,
+                              HegemonikonTunedLlamaParams &entry) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<HegemonikonTunedLlamaParams> stored;
+    if (!read_locked(stored))
+    {
+        return false;
+    }
+    for (const HegemonikonTunedLlamaParams &candidate : stored)
+    {
+        if (candidate.model_key == model_key && candidate.machine_key == machine_key)
+        {
+            entry = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Adds an entry, replacing the one of the same model and machine.
+ *
+ * @return true if the file was written.
+ */
+bool LlamaTuningStore::store(const HegemonikonTunedLlamaParams &entry)
+{
+    if (entry.model_key.empty() || entry.machine_key.empty())
+    {
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+        {
+            std::cerr << "LlamaTuningStore Error: entry without model or machine key" << std::endl;
+        }
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<HegemonikonTunedLlamaParams> stored;
+    read_locked(stored);
+    bool replaced = false;
+    for (HegemonikonTunedLlamaParams &existing : stored)
+    {
+        if (existing.model_key == entry.model_key && existing.machine_key == entry.machine_key)
+        {
+            existing = entry;
+            replaced = true;
+        }
+    }
+    if (!replaced)
+    {
+        stored.push_back(entry);
+    }
+    return write_locked(stored);
+}
+
+std::vector<HegemonikonTunedLlamaParams> LlamaTuningStore::entries() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<HegemonikonTunedLlamaParams> stored;
+    read_locked(stored);
+    return stored;
+}
+
+/**
+ * @brief Reads the entries of the file; a missing file has none.
+ *
+ * @return false if the file exists but is not a store of this version.
+ */
+bool LlamaTuningStore::read_locked(std::vector<HegemonikonTunedLlamaParams> &entries) const
+{
+    entries.clear();
+    std::ifstream file(path_);
+    if (!file)
+    {
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    const json document = json::parse(buffer.str(), nullptr, false);
+    if (document.is_discarded() || !document.is_object() || document.value("version", 0) != FORMAT_VERSION ||
+        !document.contains("entries") || !document["entries"].is_array())
+    {
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Warning))
+        {
+            std::cerr << "LlamaTuningStore Warning: ignoring unreadable file " << path_ << std::endl;
+        }
+        return false;
+    }
+    for (const json &object : document["entries"])
+    {
+        if (!object.is_object() || !object.contains("params") || !object["params"].is_object())
+        {
+            continue;
+        }
+        HegemonikonTunedLlamaParams entry;
+        entry.model_key = object.value("model", "");
+        entry.machine_key = object.value("machine", "");
+        entry.objective = object.value("objective", "");
+        entry.score = object.value("score", 0.0);
+        entry.ttft_ms = object.value("ttft_ms", 0.0);
+        entry.tokens_per_second = object.value("tokens_per_second", 0.0);
+        entry.memory_mb = object.value("memory_mb", 0.0);
+        entry.params = params_from_json(object["params"]);
+        entries.push_back(entry);
+    }
+    return true;
+}
+
+/**
+ * @brief Writes the entries under a temporary name renamed into place.
+ */
+bool LlamaTuningStore::write_locked(const std::vector<HegemonikonTunedLlamaParams> &entries) const
+{
+    json list = json::array();
+    for (const HegemonikonTunedLlamaParams &entry : entries)
+    {
+        list.push_back(json{{"model", entry.model_key},
+                            {"machine", entry.machine_key},
+                            {"objective", entry.objective},
+                            {"score", entry.score},
+                            {"ttft_ms", entry.ttft_ms},
+                            {"tokens_per_second", entry.tokens_per_second},
+                            {"memory_mb", entry.memory_mb},
+                            {"params", params_to_json(entry.params)}});
+    }
+    const json document{{"version", FORMAT_VERSION}, {"entries", list}};
+
+    std::error_code ec;
+    const std::filesystem::path parent = std::filesystem::path(path_).parent_path();
+    if (!parent.empty())
+    {
+        std::filesystem::create_directories(parent, ec);
+    }
+    const std::string temp = path_ + ".tmp";
+    bool ok = false;
+    {
+        std::ofstream file(temp, std::ios::trunc);
+        file << document.dump(2) << "\n";
+        ok = static_cast<bool>(file);
+    }
+    if (ok)
+    {
+        std::filesystem::rename(temp, path_, ec);
+        ok = !ec;
+    }
+    if (!ok)
+    {
+        std::filesystem::remove(temp, ec);
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+        {
+            std::cerr << "LlamaTuningStore Error: cannot write " << path_ << std::endl;
+        }
+    }
+    return ok;
+}
@@ -5,6 +5,7 @@
 #include <cstring>
 #include <filesystem>
 #include <system_error>
+#include <thread>
 #include "llama.h"
 
 #include <iostream>
@@ -17,6 +18,43 @@
 using json = nlohmann::json;
 namespace fs = std::filesystem;
 
+/**
+ * @brief Reads the models listed in text.json, either a list of model objects or an
+ * object with a "models" list; each model needs a "local_path".
+ */
+static std::vector<HegemonikonQuantizedModelInfo> read_models(const std::string &path)
+{
+    std::vector<HegemonikonQuantizedModelInfo> models;
+    std::ifstream file(path);
+    const json document = json::parse(file, nullptr, false);
+    if (document.is_discarded())
+    {
+        return models;
+    }
+    const json &list = document.is_object() && document.contains("models") ? document["models"] : document;
+    if (!list.is_array())
+    {
+        return models;
+    }
+    for (const json &entry : list)
+    {
+        if (!entry.is_object())
+        {
+            continue;
+        }
+        HegemonikonQuantizedModelInfo info;
+        info.local_path = entry.value("local_path", "");
+        info.model_id = entry.value("model_id", info.local_path);
+        info.quantization = entry.value("quantization", "");
+        info.last_modified = entry.value("last_modified", "");
+        if (info.isValid())
+        {
+            models.push_back(info);
+        }
+    }
+    return models;
+}
+
 int main(int argc, char **argv)
 {
     const char *env_path = std::getenv("ATARAXIA_PATH") ? std::getenv("ATARAXIA_PATH") : "..";
@@ -40,19 +78,37 @@ int main(int argc, char **argv)
 
     std::cout << "Full path: " << model_jsons_path << std::endl;
 
-    HegemonikonLlamaBenchmarker benchmarker(model_jsons_path);
-
-    BenchmarkParams params;
-    params.n_gpu_layers = 32;
-    params.repetitions = 10;
-    params.warmup = true;
-    params.parallel = false;
-
-    benchmarker.setBenchmarkParams(params);
+    const std::vector<HegemonikonQuantizedModelInfo> models = read_models(model_jsons_path);
+    if (models.empty())
+    {
+        std::cerr << "No model listed in: " << model_jsons_path << std::endl;
+        return 1;
+    }
 
-    auto results = benchmarker.benchmarkAllModels(params);
+    // Sweep the offload (CPU only or planned from the free VRAM), batch and thread
+    // counts instead of a fixed configuration, and keep the fastest decode per model.
+    const int32_t n_cpus = static_cast<int32_t>(std::max(1u, std::thread::hardware_concurrency()));
+    HegemonikonTuningParams tuning_params;
+    tuning_params.grid.n_gpu_layers = {0, -1};
+    tuning_params.grid.n_batch = {256, 512};
+    tuning_params.grid.n_threads = {std::max(1, n_cpus / 2), n_cpus};
+    tuning_params.objective = HegemonikonTuningObjective::DecodeTokensPerSecond;
+    tuning_params.successive_halving = true;
+    tuning_params.min_repetitions = 2;
+    tuning_params.benchmark_params.repetitions = 10;
+    tuning_params.benchmark_params.warmup = true;
 
-    benchmarker.exportResults(results, "benchmark_results.json");
+    const std::string store_path = output_path + "/llama_tuning.json";
+    HegemonikonLlamaBenchmarker benchmarker;
+    for (const HegemonikonQuantizedModelInfo &model : models)
+    {
+        HegemonikonLlamaModelParams base_params;
+        base_params.model_path = model.local_path;
+        HegemonikonTuningResult result = benchmarker.tuneAndStoreModel(model, tuning_params, base_params, store_path);
+        std::cout << model.model_id << std::endl;
+        benchmarker.printTuningResult(result);
+    }
 
+    std::cout << "Tuned parameters written to: " << store_path << std::endl;
     return 0;
-}
\ No newline at end of file
+}
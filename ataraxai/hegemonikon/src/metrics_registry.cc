@@ -0,0 +1,350 @@
+#include "metrics_registry.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iterator>
+
+namespace
+{
+    constexpr double NS_PER_MS = 1e6;
+    constexpr double AUDIO_SAMPLE_RATE = 16000.0;
+
+    int64_t now_ns()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   MetricsRegistry::clock::now().time_since_epoch())
+            .count();
+    }
+
+    /**
+     * @brief Formats a sample value the way Prometheus parsers expect it.
+     */
+    std::string format_value(double value)
+    {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%.9g", value);
+        return buffer;
+    }
+
+    const char *counter_help(MetricCounter counter)
+    {
+        switch (counter)
+        {
+        case MetricCounter::Requests:
+            return "Generation requests completed.";
+        case MetricCounter::FailedRequests:
+            return "Generation requests that ended with an error.";
+        case MetricCounter::PromptTokens:
+            return "Prompt tokens of the generation requests.";
+        case MetricCounter::GeneratedTokens:
+            return "Tokens generated.";
+        case MetricCounter::Transcriptions:
+            return "Whisper runs completed.";
+        case MetricCounter::FailedTranscriptions:
+            return "Whisper runs that failed.";
+        case MetricCounter::AudioSamples:
+            return "Seconds of audio transcribed.";
+        case MetricCounter::LookupDraftedTokens:
+            return "Tokens proposed by prompt-lookup decoding.";
+        case MetricCounter::LookupAcceptedTokens:
+            return "Prompt-lookup tokens accepted by the model.";
+        default:
+            return "";
+        }
+    }
+}
+
+/**
+ * @brief Adds one sample.
+ *
+ * @param value_ns The duration in nanoseconds; longer than the last bucket counts in it.
+ */
+void LatencyHistogram::record(uint64_t value_ns)
+{
+    buckets_[bucket_index(value_ns)].fetch_add(1, std::memory_order_relaxed);
+    sum_ns_.fetch_add(value_ns, std::memory_order_relaxed);
+    uint64_t max = max_ns_.load(std::memory_order_relaxed);
+    while (value_ns > max && !max_ns_.compare_exchange_weak(max, value_ns, std::memory_order_relaxed))
+    {
+    }
+}
+
+void LatencyHistogram::reset()
+{
+    for (std::atomic<uint64_t> &bucket : buckets_)
+    {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    sum_ns_.store(0, std::memory_order_relaxed);
+    max_ns_.store(0, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Index of the bucket a value falls in.
+ */
+size_t LatencyHistogram::bucket_index(uint64_t value_ns)
+{
+    if (value_ns < SUB_BUCKETS)
+    {
+        return static_cast<size_t>(value_ns);
+    }
+    value_ns = std::min<uint64_t>(value_ns, (uint64_t{1} << MAX_EXPONENT) - 1);
+    uint32_t msb = 0;
+    for (uint64_t v = value_ns; v > 1; v >>= 1)
+    {
+        ++msb;
+    }
+    const uint32_t shift = msb - SUB_BUCKET_BITS;
+    return SUB_BUCKETS + static_cast<size_t>(shift) * SUB_BUCKETS +
+           static_cast<size_t>((value_ns >> shift) - SUB_BUCKETS);
+}
+
+/**
+ * @brief Largest value that falls in a bucket.
+ */
+uint64_t LatencyHistogram::bucket_upper_ns(size_t index)
+{
+    if (index < SUB_BUCKETS)
+    {
+        return index;
+    }
+    const size_t shift = (index - SUB_BUCKETS) / SUB_BUCKETS;
+    const uint64_t sub = (index - SUB_BUCKETS) % SUB_BUCKETS;
+    return ((SUB_BUCKETS + sub + 1) << shift) - 1;
+}
+
+/**
+ * @brief Reads the histogram.
+ *
+ * @param name      Name given to the snapshot.
+ * @param bounds_ms Ascending bounds of the cumulative `buckets` of the snapshot.
+ */
+HegemonikonLatencySnapshot LatencyHistogram::snapshot(const std::string &name, const std::vector<double> &bounds_ms) const
+{
+    HegemonikonLatencySnapshot snapshot;
+    snapshot.name = name;
+
+    std::vector<uint64_t> counts(N_BUCKETS);
+    for (size_t i = 0; i < N_BUCKETS; ++i)
+    {
+        counts[i] = buckets_[i].load(std::memory_order_relaxed);
+        snapshot.count += counts[i];
+    }
+    const uint64_t max_ns = max_ns_.load(std::memory_order_relaxed);
+    snapshot.sum_ms = static_cast<double>(sum_ns_.load(std::memory_order_relaxed)) / NS_PER_MS;
+    snapshot.max_ms = static_cast<double>(max_ns) / NS_PER_MS;
+
+    const std::pair<double, double *> quantiles[] = {
+        {0.50, &snapshot.p50_ms}, {0.90, &snapshot.p90_ms}, {0.99, &snapshot.p99_ms}, {0.999, &snapshot.p999_ms}};
+    size_t next_quantile = 0;
+    size_t next_bound = 0;
+    snapshot.buckets.reserve(bounds_ms.size());
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i < N_BUCKETS; ++i)
+    {
+        const uint64_t upper_ns = bucket_upper_ns(i);
+        while (next_bound < bounds_ms.size() && static_cast<double>(upper_ns) > bounds_ms[next_bound] * NS_PER_MS)
+        {
+            snapshot.buckets.emplace_back(bounds_ms[next_bound++], cumulative);
+        }
+        cumulative += counts[i];
+        while (snapshot.count > 0 && next_quantile < std::size(quantiles) &&
+               static_cast<double>(cumulative) >= std::ceil(quantiles[next_quantile].first * static_cast<double>(snapshot.count)))
+        {
+            *quantiles[next_quantile++].second = static_cast<double>(std::min(upper_ns, max_ns)) / NS_PER_MS;
+        }
+    }
+    while (next_bound < bounds_ms.size())
+    {
+        snapshot.buckets.emplace_back(bounds_ms[next_bound++], cumulative);
+    }
+    return snapshot;
+}
+
+MetricsRegistry::MetricsRegistry()
+    : started_at_ns_(now_ns())
+{
+}
+
+/**
+ * @brief Records the duration between two time points in one phase.
+ */
+void MetricsRegistry::record(MetricPhase phase, clock::time_point start, clock::time_point end)
+{
+    const int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    histograms_[static_cast<size_t>(phase)].record(static_cast<uint64_t>(std::max<int64_t>(0, ns)));
+}
+
+/**
+ * @brief Records a duration measured elsewhere, in milliseconds.
+ */
+void MetricsRegistry::record_ms(MetricPhase phase, double duration_ms)
+{
+    const double ns = std::max(0.0, duration_ms * NS_PER_MS);
+    histograms_[static_cast<size_t>(phase)].record(static_cast<uint64_t>(std::llround(ns)));
+}
+
+void MetricsRegistry::add(MetricCounter counter, uint64_t value)
+{
+    counters_[static_cast<size_t>(counter)].fetch_add(value, std::memory_order_relaxed);
+}
+
+uint64_t MetricsRegistry::counter(MetricCounter counter) const
+{
+    return counters_[static_cast<size_t>(counter)].load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Reads every histogram and counter.
+ */
+HegemonikonMetricsSnapshot MetricsRegistry::snapshot() const
+{
+    HegemonikonMetricsSnapshot snapshot;
+    snapshot.latencies.reserve(histograms_.size());
+    for (size_t i = 0; i < histograms_.size(); ++i)
+    {
+        snapshot.latencies.push_back(histograms_[i].snapshot(phase_name(static_cast<MetricPhase>(i)), bucket_bounds_ms()));
+    }
+    snapshot.requests = counter(MetricCounter::Requests);
+    snapshot.failed_requests = counter(MetricCounter::FailedRequests);
+    snapshot.prompt_tokens = counter(MetricCounter::PromptTokens);
+    snapshot.generated_tokens = counter(MetricCounter::GeneratedTokens);
+    snapshot.transcriptions = counter(MetricCounter::Transcriptions);
+    snapshot.failed_transcriptions = counter(MetricCounter::FailedTranscriptions);
+    snapshot.audio_seconds = static_cast<double>(counter(MetricCounter::AudioSamples)) / AUDIO_SAMPLE_RATE;
+    snapshot.lookup_drafted_tokens = counter(MetricCounter::LookupDraftedTokens);
+    snapshot.lookup_accepted_tokens = counter(MetricCounter::LookupAcceptedTokens);
+    snapshot.uptime_seconds = static_cast<double>(now_ns() - started_at_ns_.load(std::memory_order_relaxed)) / 1e9;
+    return snapshot;
+}
+
+/**
+ * @brief Renders the registry in the Prometheus text exposition format.
+ *
+ * The phases form one `hegemonikon_phase_duration_seconds` histogram family labelled by
+ * `phase`; each counter is a `hegemonikon_<name>_total` counter.
+ */
+std::string MetricsRegistry::to_prometheus() const
+{
+    const HegemonikonMetricsSnapshot metrics = snapshot();
+    std::string out;
+    out.reserve(16384);
+
+    out += "# HELP hegemonikon_phase_duration_seconds Duration of the inference phases.\n";
+    out += "# TYPE hegemonikon_phase_duration_seconds histogram\n";
+    for (const HegemonikonLatencySnapshot &latency : metrics.latencies)
+    {
+        const std::string label = "phase=\"" + latency.name + "\"";
+        for (const auto &[bound_ms, count] : latency.buckets)
+        {
+            out += "hegemonikon_phase_duration_seconds_bucket{" + label + ",le=\"" + format_value(bound_ms / 1e3) +
+                   "\"} " + std::to_string(count) + "\n";
+        }
+        out += "hegemonikon_phase_duration_seconds_bucket{" + label + ",le=\"+Inf\"} " + std::to_string(latency.count) + "\n";
+        out += "hegemonikon_phase_duration_seconds_sum{" + label + "} " + format_value(latency.sum_ms / 1e3) + "\n";
+        out += "hegemonikon_phase_duration_seconds_count{" + label + "} " + std::to_string(latency.count) + "\n";
+    }
+
+    for (size_t i = 0; i < counters_.size(); ++i)
+    {
+        const auto id = static_cast<MetricCounter>(i);
+        const std::string name = std::string("hegemonikon_") + counter_name(id) + "_total";
+        const std::string value = id == MetricCounter::AudioSamples ? format_value(metrics.audio_seconds)
+                                                                    : std::to_string(counter(id));
+        out += "# HELP " + name + " " + counter_help(id) + "\n";
+        out += "# TYPE " + name + " counter\n";
+        out += name + " " + value + "\n";
+    }
+
+    out += "# HELP hegemonikon_uptime_seconds Seconds since the metrics were created or reset.\n";
+    out += "# TYPE hegemonikon_uptime_seconds gauge\n";
+    out += "hegemonikon_uptime_seconds " + format_value(metrics.uptime_seconds) + "\n";
+    return out;
+}
+
+/**
+ * @brief Zeroes every histogram and counter.
+ */
+void MetricsRegistry::reset()
+{
+    for (LatencyHistogram &histogram : histograms_)
+    {
+        histogram.reset();
+    }
+    for (std::atomic<uint64_t> &counter : counters_)
+    {
+        counter.store(0, std::memory_order_relaxed);
+    }
+    started_at_ns_.store(now_ns(), std::memory_order_relaxed);
+}
+
+const char *MetricsRegistry::phase_name(MetricPhase phase)
+{
+    switch (phase)
+    {
+    case MetricPhase::QueueWait:
+        return "queue_wait";
+    case MetricPhase::Tokenize:
+        return "tokenize";
+    case MetricPhase::Prefill:
+        return "prefill";
+    case MetricPhase::Decode:
+        return "decode";
+    case MetricPhase::Sample:
+        return "sample";
+    case MetricPhase::Detokenize:
+        return "detokenize";
+    case MetricPhase::TimeToFirstToken:
+        return "time_to_first_token";
+    case MetricPhase::InterToken:
+        return "inter_token";
+    case MetricPhase::Generation:
+        return "generation";
+    case MetricPhase::WhisperEncode:
+        return "whisper_encode";
+    case MetricPhase::WhisperDecode:
+        return "whisper_decode";
+    case MetricPhase::Transcription:
+        return "transcription";
+    default:
+        return "unknown";
+    }
+}
+
+const char *MetricsRegistry::counter_name(MetricCounter counter)
+{
+    switch (counter)
+    {
+    case MetricCounter::Requests:
+        return "requests";
+    case MetricCounter::FailedRequests:
+        return "failed_requests";
+    case MetricCounter::PromptTokens:
+        return "prompt_tokens";
+    case MetricCounter::GeneratedTokens:
+        return "generated_tokens";
+    case MetricCounter::Transcriptions:
+        return "transcriptions";
+    case MetricCounter::FailedTranscriptions:
+        return "failed_transcriptions";
+    case MetricCounter::AudioSamples:
+        return "audio_seconds";
+    case MetricCounter::LookupDraftedTokens:
+        return "lookup_drafted_tokens";
+    case MetricCounter::LookupAcceptedTokens:
+        return "lookup_accepted_tokens";
+    default:
+        return "unknown";
+    }
+}
+
+/**
+ * @brief Bounds, in milliseconds, of the cumulative buckets of the snapshots and the export.
+ */
+const std::vector<double> &MetricsRegistry::bucket_bounds_ms()
+{
+    static const std::vector<double> bounds = {0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 25, 50,
+                                               100, 250, 500, 1000, 2500, 5000, 10000, 30000, 60000};
+    return bounds;
+}
@@ -0,0 +1,108 @@
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "llama_microbench.hh"
+
+static std::vector<int32_t> parse_list(const std::string &text)
+{
+    std::vector<int32_t> values;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+        if (!item.empty())
+        {
+            values.push_back(static_cast<int32_t>(std::strtol(item.c_str(), nullptr, 10)));
+        }
+    }
+    return values;
+}
+
+static void print_usage(const char *program)
+{
+    std::cerr << "Usage: " << program << " -m MODEL [-o OUTPUT.json] [-p 512,2048] [-n 128] [-d 0,4096,16384]\n"
+              << "         [-r REPETITIONS] [-s SAMPLER_ITERATIONS] [-ngl GPU_LAYERS] [-t THREADS] [-tb THREADS_BATCH]\n"
+              << "         [-b N_BATCH] [-ub N_UBATCH] [-ctk TYPE] [-ctv TYPE] [-fa auto|on|off]" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    HegemonikonMicrobenchParams params;
+    std::string output_path;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (i + 1 >= argc)
+        {
+            print_usage(argv[0]);
+            return 1;
+        }
+        const std::string value = argv[++i];
+        if (arg == "-m")
+            params.model_params.model_path = value;
+        else if (arg == "-o")
+            output_path = value;
+        else if (arg == "-p")
+            params.prompt_lengths = parse_list(value);
+        else if (arg == "-n")
+            params.n_generate = std::atoi(value.c_str());
+        else if (arg == "-d")
+            params.depths = parse_list(value);
+        else if (arg == "-r")
+            params.repetitions = std::atoi(value.c_str());
+        else if (arg == "-s")
+            params.sampler_iterations = std::atoi(value.c_str());
+        else if (arg == "-ngl")
+            params.model_params.n_gpu_layers = std::atoi(value.c_str());
+        else if (arg == "-t")
+            params.model_params.n_threads = std::atoi(value.c_str());
+        else if (arg == "-tb")
+            params.model_params.n_threads_batch = std::atoi(value.c_str());
+        else if (arg == "-b")
+            params.model_params.n_batch = std::atoi(value.c_str());
+        else if (arg == "-ub")
+            params.model_params.n_ubatch = std::atoi(value.c_str());
+        else if (arg == "-ctk")
+            params.model_params.cache_type_k = value;
+        else if (arg == "-ctv")
+            params.model_params.cache_type_v = value;
+        else if (arg == "-fa")
+            params.model_params.flash_attn = value;
+        else
+        {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (params.model_params.model_path.empty())
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    const HegemonikonMicrobenchReport report = LlamaMicrobench::run(params);
+    if (!report.success)
+    {
+        std::cerr << "Microbenchmark failed: " << report.errorMessage << std::endl;
+    }
+
+    std::cout << report.model_description << " (llama.cpp " << report.llama_cpp_version << ", " << report.n_threads
+              << " threads, " << report.n_gpu_layers << " GPU layers)" << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    for (const HegemonikonMicrobenchSample &sample : report.samples)
+    {
+        std::cout << "  " << std::left << std::setw(16) << sample.test << std::right << std::setw(12) << sample.tokens_per_second
+                  << " +/- " << std::setw(8) << sample.stdev_tokens_per_second
+                  << (sample.kind == "sampler" ? " samples/sec" : " tokens/sec") << std::endl;
+    }
+
+    if (!output_path.empty() && !LlamaMicrobench::write_report(report, output_path))
+    {
+        return 1;
+    }
+    return report.success ? 0 : 1;
+}
@@ -0,0 +1,190 @@
+#include "secure_arena.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+#include "memory_locker.hh"
+#include "plateform_memory.hh"
+
+SecureArena &SecureArena::instance()
+{
+    // Never destroyed: secrets held by static objects may be freed after the arena's own
+    // static destruction would have run.
+    static SecureArena *arena = new SecureArena();
+    return *arena;
+}
+
+/**
+ * @param region_size Bytes locked at a time for the size classes, rounded up to whole pages.
+ */
+SecureArena::SecureArena(size_t region_size)
+    : page_size_(PlatformMemory::get_page_size())
+{
+    region_size_ = PlatformMemoryUtils::align_size(std::max(region_size, page_size_), page_size_);
+}
+
+SecureArena::~SecureArena()
+{
+    for (const Region &region : regions_)
+    {
+        secure_memset(region.base, 0, region.size);
+        PlatformMemory::unlock_memory(region.base, region.size);
+        PlatformMemory::deallocate_aligned(region.base);
+    }
+}
+
+size_t SecureArena::class_index(size_t size)
+{
+    size_t index = 0;
+    size_t block = MIN_BLOCK_SIZE;
+    while (block < size)
+    {
+        block <<= 1;
+        ++index;
+    }
+    return index;
+}
+
+size_t SecureArena::block_size(size_t size)
+{
+    if (size > MAX_BLOCK_SIZE)
+    {
+        return PlatformMemoryUtils::align_size(size, PlatformMemory::get_page_size());
+    }
+    return MIN_BLOCK_SIZE << class_index(size);
+}
+
+/**
+ * @brief Next unused page of the current region, locking a new region when it is full.
+ *
+ * Called with the mutex held.
+ */
+char *SecureArena::take_page()
+{
+    if (regions_.empty() || next_page_offset_ + page_size_ > regions_.back().size)
+    {
+        void *base = PlatformMemory::allocate_aligned(region_size_, page_size_);
+        if (!base)
+        {
+            throw std::bad_alloc();
+        }
+        if (!PlatformMemory::lock_memory(base, region_size_))
+        {
+            PlatformMemory::deallocate_aligned(base);
+            throw std::runtime_error("Failed to lock memory: " + PlatformMemory::get_last_error());
+        }
+        std::memset(base, 0, region_size_);
+
+        regions_.push_back({static_cast<char *>(base), region_size_});
+        next_page_offset_ = 0;
+        stats_.regions++;
+        stats_.lock_calls++;
+        stats_.locked_bytes += region_size_;
+    }
+
+    char *page = regions_.back().base + next_page_offset_;
+    next_page_offset_ += page_size_;
+    return page;
+}
+
+/**
+ * @brief Returns a zeroed, locked block of at least `size` bytes.
+ *
+ * Blocks are aligned to their size (up to a page), large blocks to a page. A size of 0
+ * gets a block of the smallest class, so empty secure buffers still have a valid pointer.
+ *
+ * @throws std::bad_alloc if the memory cannot be allocated.
+ * @throws std::runtime_error if it cannot be locked (e.g. RLIMIT_MEMLOCK is reached).
+ */
+void *SecureArena::allocate(size_t size)
+{
+    if (size > MAX_BLOCK_SIZE)
+    {
+        const size_t rounded = block_size(size);
+        void *ptr = PlatformMemory::allocate_aligned(rounded, page_size_);
+        if (!ptr)
+        {
+            throw std::bad_alloc();
+        }
+        if (!PlatformMemory::lock_memory(ptr, rounded))
+        {
+            PlatformMemory::deallocate_aligned(ptr);
+            throw std::runtime_error("Failed to lock memory: " + PlatformMemory::get_last_error());
+        }
+        std::memset(ptr, 0, rounded);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.large_blocks++;
+        stats_.lock_calls++;
+        stats_.locked_bytes += rounded;
+        return ptr;
+    }
+
+    const size_t index = class_index(size);
+    const size_t block = MIN_BLOCK_SIZE << index;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!free_lists_[index])
+    {
+        char *page = take_page();
+        for (size_t offset = page_size_; offset >= block; offset -= block)
+        {
+            FreeBlock *free_block = reinterpret_cast<FreeBlock *>(page + offset - block);
+            free_block->next = free_lists_[index];
+            free_lists_[index] = free_block;
+        }
+    }
+
+    FreeBlock *free_block = free_lists_[index];
+    free_lists_[index] = free_block->next;
+    // The rest of the block was zeroed when it was freed (or is fresh from the region)
+    std::memset(free_block, 0, sizeof(FreeBlock));
+
+    stats_.blocks_in_use++;
+    stats_.bytes_in_use += block;
+    return free_block;
+}
+
+/**
+ * @brief Zeroes a block and returns it to its class, or releases a large block.
+ *
+ * @param size The size given to allocate() for `ptr`.
+ */
+void SecureArena::deallocate(void *ptr, size_t size)
+{
+    if (!ptr)
+    {
+        return;
+    }
+
+    const size_t block = block_size(size);
+    secure_memset(ptr, 0, block);
+
+    if (size > MAX_BLOCK_SIZE)
+    {
+        PlatformMemory::unlock_memory(ptr, block);
+        PlatformMemory::deallocate_aligned(ptr);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.large_blocks--;
+        stats_.locked_bytes -= block;
+        return;
+    }
+
+    const size_t index = class_index(size);
+    FreeBlock *free_block = static_cast<FreeBlock *>(ptr);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_block->next = free_lists_[index];
+    free_lists_[index] = free_block;
+    stats_.blocks_in_use--;
+    stats_.bytes_in_use -= block;
+}
+
+SecureArenaStats SecureArena::get_stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
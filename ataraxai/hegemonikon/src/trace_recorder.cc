@@ -0,0 +1,268 @@
+#include "trace_recorder.hh"
+#include "hegemonikon_log.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+std::atomic<bool> TraceRecorder::enabled_{false};
+
+namespace
+{
+    struct SpanCopy
+    {
+        const char *name;
+        const char *category;
+        const char *arg_name;
+        uint64_t start_ns;
+        uint64_t duration_ns;
+        int64_t arg;
+    };
+
+    std::string escape_json(const std::string &text)
+    {
+        std::string out;
+        out.reserve(text.size());
+        for (const char c : text)
+        {
+            if (c == '"' || c == '\\')
+            {
+                out += '\\';
+                out += c;
+            }
+            else if (static_cast<unsigned char>(c) < 0x20)
+            {
+                char buffer[8];
+                std::snprintf(buffer, sizeof(buffer), "\\u%04x", static_cast<unsigned>(c));
+                out += buffer;
+            }
+            else
+            {
+                out += c;
+            }
+        }
+        return out;
+    }
+
+    std::string format_us(uint64_t ns)
+    {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%.3f", static_cast<double>(ns) / 1e3);
+        return buffer;
+    }
+}
+
+TraceRecorder &TraceRecorder::instance()
+{
+    static TraceRecorder recorder;
+    return recorder;
+}
+
+/**
+ * @brief Monotonic clock of the spans, in nanoseconds.
+ */
+uint64_t TraceRecorder::now_ns()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                     std::chrono::steady_clock::now().time_since_epoch())
+                                     .count());
+}
+
+/**
+ * @brief Starts recording; the trace then only holds spans that begin after this call.
+ *
+ * @param events_per_thread Capacity of the rings allocated from now on, rounded up to a
+ *                          power of two; rings of threads that already traced keep theirs.
+ */
+void TraceRecorder::start(size_t events_per_thread)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t capacity = 1;
+        while (capacity < std::max<size_t>(1, events_per_thread))
+        {
+            capacity <<= 1;
+        }
+        events_per_thread_ = capacity;
+        session_start_ns_.store(now_ns(), std::memory_order_relaxed);
+    }
+    enabled_.store(true, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Stops recording; the spans recorded so far stay available to write_chrome_trace().
+ */
+void TraceRecorder::stop()
+{
+    enabled_.store(false, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Returns the ring of the calling thread, allocating it on first use.
+ */
+TraceRecorder::ThreadBuffer *TraceRecorder::thread_buffer()
+{
+    static thread_local ThreadBuffer *buffer = nullptr;
+    if (!buffer)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto created = std::make_unique<ThreadBuffer>();
+        created->tid = static_cast<uint32_t>(buffers_.size() + 1);
+        created->events = std::make_unique<Event[]>(events_per_thread_);
+        created->mask = events_per_thread_ - 1;
+        buffer = created.get();
+        buffers_.push_back(std::move(created));
+    }
+    return buffer;
+}
+
+/**
+ * @brief Records one span measured by the caller.
+ *
+ * @param name      Name of the span.
+ * @param category  Category of the span, e.g. "llama" or "whisper".
+ * @param start_ns  Start of the span on the now_ns() clock.
+ * @param end_ns    End of the span on the now_ns() clock.
+ * @param arg_name  Optional name of a number attached to the span.
+ * @param arg       The number.
+ */
+void TraceRecorder::record(const char *name, const char *category, uint64_t start_ns, uint64_t end_ns,
+                           const char *arg_name, int64_t arg)
+{
+    if (!enabled())
+    {
+        return;
+    }
+    ThreadBuffer *buffer = thread_buffer();
+    const uint64_t index = buffer->write_index.load(std::memory_order_relaxed);
+    Event &event = buffer->events[index & buffer->mask];
+
+    event.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    event.name.store(name, std::memory_order_relaxed);
+    event.category.store(category, std::memory_order_relaxed);
+    event.arg_name.store(arg_name, std::memory_order_relaxed);
+    event.start_ns.store(start_ns, std::memory_order_relaxed);
+    event.duration_ns.store(end_ns > start_ns ? end_ns - start_ns : 0, std::memory_order_relaxed);
+    event.arg.store(arg, std::memory_order_relaxed);
+    event.sequence.store(index + 1, std::memory_order_release);
+    buffer->write_index.store(index + 1, std::memory_order_release);
+}
+
+/**
+ * @brief Names the calling thread in the trace.
+ */
+void TraceRecorder::set_thread_name(const std::string &name)
+{
+    ThreadBuffer *buffer = thread_buffer();
+    std::lock_guard<std::mutex> lock(mutex_);
+    buffer->name = name;
+}
+
+/**
+ * @brief Renders the spans of the current or last recording as Chrome trace JSON.
+ *
+ * Timestamps are in microseconds since start().
+ */
+std::string TraceRecorder::to_chrome_trace() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    const uint64_t session_start = session_start_ns_.load(std::memory_order_relaxed);
+
+    std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    auto separator = [&]()
+    {
+        if (!first)
+        {
+            out += ",\n";
+        }
+        first = false;
+    };
+
+    std::vector<SpanCopy> spans;
+    for (const std::unique_ptr<ThreadBuffer> &buffer : buffers_)
+    {
+        const std::string tid = std::to_string(buffer->tid);
+        separator();
+        const std::string thread_name = buffer->name.empty() ? "thread " + tid : buffer->name;
+        out += "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" + tid +
+               ",\"args\":{\"name\":\"" + escape_json(thread_name) + "\"}}";
+
+        const uint64_t end = buffer->write_index.load(std::memory_order_acquire);
+        const uint64_t capacity = buffer->mask + 1;
+        const uint64_t begin = end > capacity ? end - capacity : 0;
+        spans.clear();
+        for (uint64_t index = begin; index < end; ++index)
+        {
+            const Event &event = buffer->events[index & buffer->mask];
+            const uint64_t sequence = event.sequence.load(std::memory_order_acquire);
+            if (sequence != index + 1)
+            {
+                continue;
+            }
+            SpanCopy span{event.name.load(std::memory_order_relaxed), event.category.load(std::memory_order_relaxed),
+                          event.arg_name.load(std::memory_order_relaxed), event.start_ns.load(std::memory_order_relaxed),
+                          event.duration_ns.load(std::memory_order_relaxed), event.arg.load(std::memory_order_relaxed)};
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (event.sequence.load(std::memory_order_relaxed) != sequence || span.start_ns < session_start || !span.name)
+            {
+                continue;
+            }
+            spans.push_back(span);
+        }
+
+        for (const SpanCopy &span : spans)
+        {
+            separator();
+            out += "{\"ph\":\"X\",\"name\":\"" + escape_json(span.name) + "\",\"cat\":\"" +
+                   escape_json(span.category ? span.category : "") + "\",\"pid\":1,\"tid\":" + tid +
+                   ",\"ts\":" + format_us(span.start_ns - session_start) + ",\"dur\":" + format_us(span.duration_ns);
+            if (span.arg_name)
+            {
+                out += ",\"args\":{\"" + escape_json(span.arg_name) + "\":" + std::to_string(span.arg) + "}";
+            }
+            out += "}";
+        }
+    }
+    out += "]}\n";
+    return out;
+}
+
+/**
+ * @brief Writes the trace to a file, see to_chrome_trace().
+ *
+ * @return true if the file was written.
+ */
+bool TraceRecorder::write_chrome_trace(const std::string &path) const
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file)
+    {
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+        {
+            std::cerr << "TraceRecorder Error: cannot open " << path << std::endl;
+        }
+        return false;
+    }
+    file << to_chrome_trace();
+    return static_cast<bool>(file);
+}
+
+HegemonikonTraceStats TraceRecorder::get_stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    HegemonikonTraceStats stats;
+    stats.enabled = enabled();
+    stats.n_threads = static_cast<uint32_t>(buffers_.size());
+    stats.events_per_thread = events_per_thread_;
+    for (const std::unique_ptr<ThreadBuffer> &buffer : buffers_)
+    {
+        const uint64_t written = buffer->write_index.load(std::memory_order_relaxed);
+        stats.events_recorded += written;
+        stats.events_overwritten += written > buffer->mask + 1 ? written - (buffer->mask + 1) : 0;
+    }
+    return stats;
+}
@@ -0,0 +1,99 @@
+#include "transcript_prefiller.hh"
+#include "hegemonikon_log.hh"
+
+#include <iostream>
+#include <utility>
+
+/**
+ * @brief Starts the prefill worker.
+ *
+ * @param llama The interface holding the session; must outlive the prefiller.
+ * @param prompt_prefix Text of the prompt before the transcript, e.g. a system prompt.
+ * @param params Parameters of the generation to come; `session_id` must be set.
+ */
+TranscriptPrefiller::TranscriptPrefiller(LlamaInterface *llama, std::string prompt_prefix, HegemonikonGenerationParams params)
+    : llama_(llama), prompt_prefix_(std::move(prompt_prefix)), params_(std::move(params))
+{
+    worker_ = std::thread(&TranscriptPrefiller::run, this);
+}
+
+TranscriptPrefiller::~TranscriptPrefiller()
+{
+    finish();
+}
+
+/**
+ * @brief Appends text to the transcript and wakes the worker.
+ */
+void TranscriptPrefiller::append(const std::string &text)
+{
+    if (text.empty())
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        transcript_ += text;
+    }
+    changed_.notify_one();
+}
+
+/**
+ * @brief Waits for the running prefill and stops the worker.
+ *
+ * Text appended since the last prefill is left to the generation request, which would
+ * decode it just as fast. Safe to call more than once.
+ *
+ * @return The transcript, i.e. every appended text.
+ */
+std::string TranscriptPrefiller::finish()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        finishing_ = true;
+    }
+    changed_.notify_one();
+    if (worker_.joinable())
+    {
+        worker_.join();
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    return transcript_;
+}
+
+/**
+ * @brief Number of leading prompt tokens in the session after the last prefill.
+ */
+int32_t TranscriptPrefiller::prefilled_tokens() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return prefilled_tokens_;
+}
+
+void TranscriptPrefiller::run()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+        changed_.wait(lock, [this]()
+                      { return finishing_ || transcript_.size() > n_submitted_; });
+        if (finishing_)
+        {
+            return;
+        }
+        n_submitted_ = transcript_.size();
+        const std::string prompt = prompt_prefix_ + transcript_;
+        lock.unlock();
+        const int32_t n_tokens = llama_->prefill_session(prompt, params_, HOLD_BACK_TOKENS);
+        lock.lock();
+        if (n_tokens < 0)
+        {
+            if (HegemonikonLog::enabled(HegemonikonLogLevel::Warning))
+            {
+                std::cerr << "TranscriptPrefiller: cannot prefill session '" << params_.session_id << "'" << std::endl;
+            }
+            return;
+        }
+        prefilled_tokens_ = n_tokens;
+    }
+}
@@ -0,0 +1,519 @@
+#include "transcription_cache.hh"
+#include "hegemonikon_log.hh"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "argon2/blake2.h"
+
+namespace
+{
+    constexpr char MAGIC[4] = {'H', 'W', 'T', 'C'};
+    constexpr uint32_t FORMAT_VERSION = 1;
+    constexpr size_t CONTENT_DIGEST_BYTES = 16;
+    constexpr size_t IO_CHUNK_BYTES = 1u << 20;
+    constexpr uint32_t FLAG_SPEAKER_TURN = 1u << 0;
+
+    /**
+     * @brief Fixed-size file header; native byte order, as the cache is local.
+     */
+    struct CacheHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint64_t payload_bytes;
+        uint64_t checksum;
+    };
+
+    struct FileCloser
+    {
+        void operator()(std::FILE *file) const { std::fclose(file); }
+    };
+    using FilePtr = std::unique_ptr<std::FILE, FileCloser>;
+
+    std::string to_hex(const uint8_t *bytes, size_t size)
+    {
+        static const char DIGITS[] = "0123456789abcdef";
+        std::string hex(2 * size, '0');
+        for (size_t i = 0; i < size; ++i)
+        {
+            hex[2 * i] = DIGITS[bytes[i] >> 4];
+            hex[2 * i + 1] = DIGITS[bytes[i] & 0x0f];
+        }
+        return hex;
+    }
+
+    uint64_t checksum(const std::string &payload)
+    {
+        uint64_t digest = 0;
+        blake2b(&digest, sizeof(digest), payload.data(), payload.size(), nullptr, 0);
+        return digest;
+    }
+
+    template <typename T>
+    void put(std::string &out, const T &value)
+    {
+        out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+
+    void put_string(std::string &out, const std::string &value)
+    {
+        put(out, static_cast<uint32_t>(value.size()));
+        out.append(value);
+    }
+
+    /**
+     * @brief Bounds-checked reader over a payload; stays failed after the first overrun.
+     */
+    struct PayloadReader
+    {
+        const std::string &payload;
+        size_t position = 0;
+        bool ok = true;
+
+        template <typename T>
+        T get()
+        {
+            T value{};
+            if (ok && payload.size() - position >= sizeof(T))
+            {
+                std::memcpy(&value, payload.data() + position, sizeof(T));
+                position += sizeof(T);
+            }
+            else
+            {
+                ok = false;
+            }
+            return value;
+        }
+
+        std::string get_string()
+        {
+            const uint32_t size = get<uint32_t>();
+            if (!ok || payload.size() - position < size)
+            {
+                ok = false;
+                return {};
+            }
+            std::string value = payload.substr(position, size);
+            position += size;
+            return value;
+        }
+    };
+
+    std::string serialize(const HegemonikonTranscription &transcription)
+    {
+        std::string out;
+        put(out, transcription.audio_ms);
+        put(out, static_cast<uint32_t>(transcription.segments.size()));
+        for (const HegemonikonWhisperSegment &segment : transcription.segments)
+        {
+            put(out, segment.t0_ms);
+            put(out, segment.t1_ms);
+            put(out, segment.speaker_turn_next ? FLAG_SPEAKER_TURN : 0u);
+            put(out, segment.no_speech_prob);
+            put_string(out, segment.text);
+            put(out, static_cast<uint32_t>(segment.tokens.size()));
+            for (const HegemonikonWhisperToken &token : segment.tokens)
+            {
+                put(out, token.id);
+                put(out, token.t0_ms);
+                put(out, token.t1_ms);
+                put(out, token.p);
+                put_string(out, token.text);
+            }
+        }
+        return out;
+    }
+
+    bool deserialize(const std::string &payload, HegemonikonTranscription &transcription)
+    {
+        PayloadReader reader{payload};
+        transcription = HegemonikonTranscription();
+        transcription.audio_ms = reader.get<int64_t>();
+        const uint32_t n_segments = reader.get<uint32_t>();
+        for (uint32_t i = 0; i < n_segments && reader.ok; ++i)
+        {
+            HegemonikonWhisperSegment segment;
+            segment.t0_ms = reader.get<int64_t>();
+            segment.t1_ms = reader.get<int64_t>();
+            segment.speaker_turn_next = (reader.get<uint32_t>() & FLAG_SPEAKER_TURN) != 0;
+            segment.no_speech_prob = reader.get<float>();
+            segment.text = reader.get_string();
+            const uint32_t n_tokens = reader.get<uint32_t>();
+            for (uint32_t j = 0; j < n_tokens && reader.ok; ++j)
+            {
+                HegemonikonWhisperToken token;
+                token.id = reader.get<int32_t>();
+                token.t0_ms = reader.get<int64_t>();
+                token.t1_ms = reader.get<int64_t>();
+                token.p = reader.get<float>();
+                token.text = reader.get_string();
+                segment.tokens.push_back(std::move(token));
+            }
+            transcription.segments.push_back(std::move(segment));
+        }
+        if (!reader.ok || reader.position != payload.size())
+        {
+            transcription = HegemonikonTranscription();
+            return false;
+        }
+        return true;
+    }
+}
+
+/**
+ * @brief Opens the cache in a directory, indexing the entries already there.
+ *
+ * Existing entries are ordered by modification time, and the oldest are evicted if they
+ * exceed `max_bytes`. Reopening a cache drops the index of the previous directory.
+ *
+ * @param directory Directory of the entries, created if missing.
+ * @param max_bytes Maximum total size of the entries.
+ * @param error Set to a description of the failure.
+ * @return true if the cache is open.
+ */
+bool TranscriptionCache::open(const std::string &directory, uint64_t max_bytes, std::string &error)
+{
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+    if (ec)
+    {
+        error = "Cannot create transcription cache directory: " + ec.message();
+        return false;
+    }
+
+    std::vector<std::pair<std::filesystem::file_time_type, std::filesystem::directory_entry>> files;
+    for (const auto &entry : std::filesystem::directory_iterator(directory, ec))
+    {
+        if (entry.is_regular_file() && entry.path().extension() == FILE_EXTENSION)
+        {
+            files.emplace_back(entry.last_write_time(), entry);
+        }
+    }
+    if (ec)
+    {
+        error = "Cannot list transcription cache directory: " + ec.message();
+        return false;
+    }
+    std::sort(files.begin(), files.end(), [](const auto &a, const auto &b)
+              { return a.first < b.first; });
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    directory_ = directory;
+    max_bytes_ = max_bytes;
+    lru_.clear();
+    entries_.clear();
+    stats_ = HegemonikonTranscriptionCacheStats();
+    stats_.max_bytes = max_bytes;
+    for (const auto &file : files)
+    {
+        const std::string key = file.second.path().stem().string();
+        Entry entry;
+        entry.bytes = file.second.file_size(ec);
+        entry.position = lru_.insert(lru_.end(), key);
+        entries_[key] = entry;
+        stats_.bytes += entry.bytes;
+    }
+    stats_.entries = entries_.size();
+    evict_locked();
+    return true;
+}
+
+/**
+ * @brief Stops using the directory; its entries stay on disk.
+ */
+void TranscriptionCache::close()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    directory_.clear();
+    lru_.clear();
+    entries_.clear();
+    stats_.entries = 0;
+    stats_.bytes = 0;
+}
+
+bool TranscriptionCache::is_open() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return !directory_.empty();
+}
+
+/**
+ * @brief Computes the content digest of a file, reading it in 1 MiB chunks.
+ *
+ * @param path The file.
+ * @param digest Set to the BLAKE2b-128 of the file bytes, in hex.
+ * @param error Set to a description of the failure.
+ * @return true if the file could be read.
+ */
+bool TranscriptionCache::hash_file(const std::string &path, std::string &digest, std::string &error)
+{
+    FilePtr file(std::fopen(path.c_str(), "rb"));
+    if (!file)
+    {
+        error = "Cannot open " + path;
+        return false;
+    }
+    blake2b_state state;
+    blake2b_init(&state, CONTENT_DIGEST_BYTES);
+    std::vector<uint8_t> chunk(IO_CHUNK_BYTES);
+    size_t n = 0;
+    while ((n = std::fread(chunk.data(), 1, chunk.size(), file.get())) > 0)
+    {
+        blake2b_update(&state, chunk.data(), n);
+    }
+    if (std::ferror(file.get()))
+    {
+        error = "Cannot read " + path;
+        return false;
+    }
+    uint8_t bytes[CONTENT_DIGEST_BYTES];
+    blake2b_final(&state, bytes, sizeof(bytes));
+    digest = to_hex(bytes, sizeof(bytes));
+    return true;
+}
+
+/**
+ * @brief Builds the key of a transcription from its content digest and parameters.
+ *
+ * Only the parameters that change the transcript are part of the key: threads, warm-up,
+ * residency, the streaming window and the output file leave cached entries usable.
+ * The model file is identified by its path and by its size and modification time, so
+ * replacing it in place invalidates its entries.
+ */
+std::string TranscriptionCache::make_key(const std::string &content_digest,
+                                         const HegemonikonWhisperModelParams &model_params,
+                                         const HegemonikonWhisperGenerationParams &generation_params)
+{
+    std::error_code ec;
+    const uint64_t model_bytes = std::filesystem::file_size(model_params.model, ec);
+    const auto model_time = std::filesystem::last_write_time(model_params.model, ec).time_since_epoch().count();
+
+    std::string input;
+    put(input, FORMAT_VERSION);
+    put_string(input, model_params.model);
+    put_string(input, model_params.language);
+    put(input, model_params.use_gpu);
+    put(input, model_params.flash_attn);
+    put(input, generation_params.translate);
+    put(input, generation_params.tinydiarize);
+    put(input, generation_params.no_fallback);
+    put(input, generation_params.no_context);
+    put(input, generation_params.max_tokens);
+    put(input, generation_params.beam_size);
+    put(input, generation_params.audio_ctx);
+    put(input, generation_params.word_thold);
+    put(input, generation_params.token_timestamps);
+    put(input, generation_params.no_timestamps);
+    put(input, generation_params.print_special);
+    put(input, generation_params.vad);
+    put(input, generation_params.vad_thold);
+    put(input, generation_params.freq_thold);
+    put(input, ec ? 0 : model_bytes);
+    put(input, static_cast<int64_t>(ec ? 0 : model_time));
+
+    uint8_t bytes[sizeof(uint64_t)];
+    blake2b(bytes, sizeof(bytes), input.data(), input.size(), nullptr, 0);
+    return content_digest + "-" + to_hex(bytes, sizeof(bytes));
+}
+
+/**
+ * @brief Looks a transcription up, marking it as recently used.
+ *
+ * An entry that cannot be read back is removed and counted as a miss.
+ *
+ * @return true on a hit, with `transcription` set.
+ */
+bool TranscriptionCache::lookup(const std::string &key, HegemonikonTranscription &transcription)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (directory_.empty())
+    {
+        return false;
+    }
+    auto it = entries_.find(key);
+    if (it == entries_.end())
+    {
+        ++stats_.misses;
+        return false;
+    }
+    const std::string path = path_of(key);
+    if (!read_file(path, transcription))
+    {
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Warning))
+        {
+            std::cerr << "TranscriptionCache: dropping unreadable entry " << path << std::endl;
+        }
+        remove_locked(key);
+        ++stats_.misses;
+        return false;
+    }
+
+    lru_.splice(lru_.end(), lru_, it->second.position);
+    std::error_code ec;
+    std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), ec);
+    ++stats_.hits;
+    return true;
+}
+
+/**
+ * @brief Stores a successful transcription, evicting the least recently used entries.
+ *
+ * Failed transcriptions and entries larger than the cache itself are not stored.
+ *
+ * @return true if the entry was written.
+ */
+bool TranscriptionCache::store(const std::string &key, const HegemonikonTranscription &transcription)
+{
+    if (!transcription.ok())
+    {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (directory_.empty())
+    {
+        return false;
+    }
+    remove_locked(key);
+    const std::string path = path_of(key);
+    if (!write_file(path, transcription))
+    {
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+        {
+            std::cerr << "TranscriptionCache: failed to write " << path << std::endl;
+        }
+        return false;
+    }
+
+    std::error_code ec;
+    const uint64_t bytes = std::filesystem::file_size(path, ec);
+    Entry entry;
+    entry.bytes = bytes;
+    entry.position = lru_.insert(lru_.end(), key);
+    entries_[key] = entry;
+    stats_.bytes += bytes;
+    stats_.entries = entries_.size();
+    ++stats_.insertions;
+    evict_locked();
+    return entries_.count(key) != 0;
+}
+
+/**
+ * @brief Removes every entry from memory and disk.
+ *
+ * @return The number of entries removed.
+ */
+size_t TranscriptionCache::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    const size_t n_entries = entries_.size();
+    while (!lru_.empty())
+    {
+        remove_locked(lru_.front());
+    }
+    return n_entries;
+}
+
+HegemonikonTranscriptionCacheStats TranscriptionCache::get_stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+/**
+ * @brief Writes a transcription to a cache file, under a temporary name renamed into place.
+ */
+bool TranscriptionCache::write_file(const std::string &path, const HegemonikonTranscription &transcription)
+{
+    const std::string payload = serialize(transcription);
+    CacheHeader header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = FORMAT_VERSION;
+    header.payload_bytes = payload.size();
+    header.checksum = checksum(payload);
+
+    const std::string temp = path + ".tmp";
+    bool ok = false;
+    {
+        FilePtr file(std::fopen(temp.c_str(), "wb"));
+        if (!file)
+        {
+            return false;
+        }
+        ok = std::fwrite(&header, sizeof(header), 1, file.get()) == 1 &&
+             std::fwrite(payload.data(), 1, payload.size(), file.get()) == payload.size() &&
+             std::fflush(file.get()) == 0;
+    }
+    std::error_code ec;
+    if (ok)
+    {
+        std::filesystem::rename(temp, path, ec);
+        ok = !ec;
+    }
+    if (!ok)
+    {
+        std::filesystem::remove(temp, ec);
+    }
+    return ok;
+}
+
+/**
+ * @brief Reads a transcription from a cache file, checking its format and checksum.
+ */
+bool TranscriptionCache::read_file(const std::string &path, HegemonikonTranscription &transcription)
+{
+    FilePtr file(std::fopen(path.c_str(), "rb"));
+    CacheHeader header;
+    if (!file || std::fread(&header, sizeof(header), 1, file.get()) != 1 ||
+        std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != FORMAT_VERSION)
+    {
+        return false;
+    }
+    std::error_code ec;
+    const uint64_t file_bytes = std::filesystem::file_size(path, ec);
+    if (ec || file_bytes != sizeof(header) + header.payload_bytes)
+    {
+        return false;
+    }
+    std::string payload(static_cast<size_t>(header.payload_bytes), '\0');
+    if (std::fread(&payload[0], 1, payload.size(), file.get()) != payload.size() || checksum(payload) != header.checksum)
+    {
+        return false;
+    }
+    return deserialize(payload, transcription);
+}
+
+std::string TranscriptionCache::path_of(const std::string &key) const
+{
+    return (std::filesystem::path(directory_) / (key + FILE_EXTENSION)).string();
+}
+
+void TranscriptionCache::remove_locked(const std::string &key)
+{
+    auto it = entries_.find(key);
+    if (it == entries_.end())
+    {
+        return;
+    }
+    std::error_code ec;
+    std::filesystem::remove(path_of(key), ec);
+    stats_.bytes -= std::min(stats_.bytes, it->second.bytes);
+    lru_.erase(it->second.position);
+    entries_.erase(it);
+    stats_.entries = entries_.size();
+}
+
+void TranscriptionCache::evict_locked()
+{
+    while (stats_.bytes > max_bytes_ && !lru_.empty())
+    {
+        remove_locked(lru_.front());
+        ++stats_.evictions;
+    }
+}
@@ -0,0 +1,188 @@
+#include "voice_activity_detector.hh"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // Mean square of a frame below which it is silence whatever the threshold (about -70 dBFS).
+    constexpr double ENERGY_FLOOR = 1e-7;
+    constexpr double PI = 3.14159265358979323846;
+}
+
+void SpeechTimeline::clear()
+{
+    spans_.clear();
+    compact_end_ = 0;
+}
+
+/**
+ * @brief Records that the next `length` compacted samples come from `original_start`.
+ */
+void SpeechTimeline::add(uint64_t original_start, uint64_t length)
+{
+    spans_.push_back({compact_end_, original_start, length});
+    compact_end_ += length;
+}
+
+/**
+ * @brief Records `length` compacted samples that are not in the original audio (gaps).
+ *
+ * They map to the end of the preceding span.
+ */
+void SpeechTimeline::skip(uint64_t length)
+{
+    compact_end_ += length;
+}
+
+/**
+ * @brief Converts a position in the compacted audio to the original audio.
+ *
+ * @param compact_position Sample position in the compacted audio.
+ * @return The sample position in the original audio; unchanged if the timeline is empty.
+ */
+uint64_t SpeechTimeline::to_original(uint64_t compact_position) const
+{
+    if (spans_.empty())
+    {
+        return compact_position;
+    }
+    auto it = std::upper_bound(spans_.begin(), spans_.end(), compact_position,
+                               [](uint64_t position, const Span &span)
+                               { return position < span.compact_start; });
+    if (it == spans_.begin())
+    {
+        return spans_.front().original_start;
+    }
+    --it;
+    return it->original_start + std::min(compact_position - it->compact_start, it->length);
+}
+
+/**
+ * @brief Creates a detector.
+ *
+ * @param vad_thold  Energy threshold relative to the mean frame energy; 0 keeps every frame
+ *                   above the silence floor.
+ * @param freq_thold Cut-off of the high-pass filter in Hz; 0 disables the filter.
+ */
+VoiceActivityDetector::VoiceActivityDetector(float vad_thold, float freq_thold)
+    : vad_thold_(std::max(0.0f, vad_thold)), freq_thold_(std::max(0.0f, freq_thold))
+{
+}
+
+/**
+ * @brief Finds the speech regions of a buffer.
+ *
+ * @param samples 16 kHz mono samples.
+ * @param n_samples Number of samples.
+ * @return The regions, sorted and non-overlapping; empty if the buffer holds no speech.
+ */
+std::vector<HegemonikonSpeechRegion> VoiceActivityDetector::detect(const float *samples, size_t n_samples) const
+{
+    std::vector<HegemonikonSpeechRegion> regions;
+    if (!samples || n_samples == 0)
+    {
+        return regions;
+    }
+
+    // First-order high-pass filter, folded into the per-frame energy.
+    const double rc = freq_thold_ > 0.0f ? 1.0 / (2.0 * PI * freq_thold_) : 0.0;
+    const double dt = 1.0 / SAMPLE_RATE;
+    const double alpha = freq_thold_ > 0.0f ? rc / (rc + dt) : 0.0;
+
+    const size_t n_frames = (n_samples + FRAME_SAMPLES - 1) / FRAME_SAMPLES;
+    std::vector<double> energy(n_frames, 0.0);
+    double previous_in = samples[0];
+    double previous_out = 0.0;
+    double total = 0.0;
+    for (size_t frame = 0; frame < n_frames; ++frame)
+    {
+        const size_t begin = frame * FRAME_SAMPLES;
+        const size_t end = std::min(n_samples, begin + FRAME_SAMPLES);
+        double sum = 0.0;
+        for (size_t i = begin; i < end; ++i)
+        {
+            double out = samples[i];
+            if (freq_thold_ > 0.0f)
+            {
+                out = alpha * (previous_out + samples[i] - previous_in);
+                previous_in = samples[i];
+                previous_out = out;
+            }
+            sum += out * out;
+        }
+        energy[frame] = sum / static_cast<double>(end - begin);
+        total += energy[frame];
+    }
+    const double threshold = std::max(ENERGY_FLOOR, vad_thold_ * total / static_cast<double>(n_frames));
+
+    for (size_t frame = 0; frame < n_frames; ++frame)
+    {
+        if (energy[frame] <= threshold)
+        {
+            continue;
+        }
+        const size_t begin = frame * FRAME_SAMPLES;
+        const size_t end = std::min(n_samples, begin + FRAME_SAMPLES);
+        if (!regions.empty() && begin <= regions.back().end + MIN_SILENCE_SAMPLES)
+        {
+            regions.back().end = end;
+        }
+        else
+        {
+            regions.push_back({begin, end});
+        }
+    }
+
+    std::vector<HegemonikonSpeechRegion> padded;
+    padded.reserve(regions.size());
+    for (const HegemonikonSpeechRegion &region : regions)
+    {
+        if (region.length() < MIN_SPEECH_SAMPLES)
+        {
+            continue;
+        }
+        const size_t start = region.start > PAD_SAMPLES ? region.start - PAD_SAMPLES : 0;
+        const size_t end = std::min(n_samples, region.end + PAD_SAMPLES);
+        if (!padded.empty() && start <= padded.back().end)
+        {
+            padded.back().end = end;
+        }
+        else
+        {
+            padded.push_back({start, end});
+        }
+    }
+    return padded;
+}
+
+/**
+ * @brief Appends the speech of a buffer to `out` and records where it came from.
+ *
+ * Regions are separated by GAP_SAMPLES of silence so that whisper still sees a pause
+ * between them.
+ *
+ * @param samples 16 kHz mono samples.
+ * @param n_samples Number of samples.
+ * @param original_offset Position of the buffer in the original audio.
+ * @param out Receives the speech samples.
+ * @param timeline Receives the mapping of the appended samples.
+ * @return The number of speech samples found in the buffer (gaps not included).
+ */
+size_t VoiceActivityDetector::compact(const float *samples, size_t n_samples, uint64_t original_offset,
+                                      std::vector<float> &out, SpeechTimeline &timeline) const
+{
+    size_t n_speech = 0;
+    for (const HegemonikonSpeechRegion &region : detect(samples, n_samples))
+    {
+        if (timeline.compact_size() > 0)
+        {
+            out.insert(out.end(), GAP_SAMPLES, 0.0f);
+            timeline.skip(GAP_SAMPLES);
+        }
+        out.insert(out.end(), samples + region.start, samples + region.end);
+        timeline.add(original_offset + region.start, region.length());
+        n_speech += region.length();
+    }
+    return n_speech;
+}
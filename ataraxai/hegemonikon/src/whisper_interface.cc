@@ -1,4 +1,7 @@
 #include "whisper_interface.hh"
+#include "voice_activity_detector.hh"
+#include "hegemonikon_log.hh"
+#include "trace_recorder.hh"
 #include "whisper.h"
 #include <stdexcept>
 #include <iostream>
@@ -8,21 +11,84 @@
 #include <atomic>
 #include <thread>
 #include <fstream>
+#include <shared_mutex>
+#include <chrono>
 
 static std::once_flag backend_whisper_init_flag;
 static std::atomic<bool> backend_whisper_initialized{false};
 
+namespace
+{
+    /**
+     * @brief Splits one whisper_full run into encoder and decoder time.
+     *
+     * whisper calls the encoder-begin callback before each encoder pass and the logits
+     * filter after each decoder pass; the first decoder pass after an encoder pass ends
+     * it. The mel spectrogram before the first pass is left out of both. Each phase is
+     * also a trace span when tracing is enabled.
+     */
+    struct WhisperRunTimer
+    {
+        using clock = MetricsRegistry::clock;
+
+        clock::time_point phase_start;
+        bool started = false;
+        bool decoding = false;
+        clock::duration encode{};
+        clock::duration decode{};
+
+        void finish(clock::time_point now)
+        {
+            if (started)
+            {
+                (decoding ? decode : encode) += now - phase_start;
+                TraceRecorder::instance().record(decoding ? "whisper_decode" : "whisper_encode", "whisper",
+                                                 to_ns(phase_start), to_ns(now));
+            }
+            phase_start = now;
+        }
+
+        static uint64_t to_ns(clock::time_point time)
+        {
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count());
+        }
+
+        static bool on_encoder_begin(struct whisper_context * /*ctx*/, struct whisper_state * /*state*/, void *user_data)
+        {
+            auto *timer = static_cast<WhisperRunTimer *>(user_data);
+            timer->finish(clock::now());
+            timer->started = true;
+            timer->decoding = false;
+            return true;
+        }
+
+        static void on_logits(struct whisper_context * /*ctx*/, struct whisper_state * /*state*/,
+                              const whisper_token_data * /*tokens*/, int /*n_tokens*/, float * /*logits*/, void *user_data)
+        {
+            auto *timer = static_cast<WhisperRunTimer *>(user_data);
+            if (timer->started && !timer->decoding)
+            {
+                timer->finish(clock::now());
+                timer->decoding = true;
+            }
+        }
+    };
+}
+
 /**
  * @brief Constructs a new WhisperInterface object.
  *
  * Initializes the WhisperInterface instance and sets the internal context pointer to nullptr.
- * Outputs a message to std::cerr indicating that the WhisperInterface has been created and
+ * At debug level, outputs a message to std::cerr indicating that the WhisperInterface has been created and
  * reminding the user to ensure that the whisper backend is initialized if required.
  */
 WhisperInterface::WhisperInterface() : ctx_(nullptr)
 {
-
-    std::cerr << "WhisperInterface created. Ensure whisper backend (if any specific) is initialized if needed." << std::endl;
+    init_backend();
+    if (HegemonikonLog::enabled(HegemonikonLogLevel::Debug))
+    {
+        std::cerr << "WhisperInterface created. Ensure whisper backend (if any specific) is initialized if needed." << std::endl;
+    }
 }
 
 /**
@@ -36,12 +102,22 @@ WhisperInterface::~WhisperInterface()
     unload_model();
 }
 
+/**
+ * @brief Routes the logs of whisper.cpp through the log level.
+ *
+ * Errors are printed when HegemonikonLogLevel::Error is enabled, everything else only at
+ * debug level. Called once, from the constructor or CoreAIService::initialize_global_backends.
+ */
 void WhisperInterface::init_backend()
 {
-    // std::call_once(backend_whisper_init_flag, []() {
-    //     whisper_backend_init();
-    //     std::cerr << "Whisper backend initialized." << std::endl;
-    // });
+    std::call_once(backend_whisper_init_flag, []()
+                   {
+        whisper_log_set([](enum ggml_log_level level, const char * text, void * /* user_data */) {
+            if (HegemonikonLog::enabled(level >= GGML_LOG_LEVEL_ERROR ? HegemonikonLogLevel::Error : HegemonikonLogLevel::Debug)) {
+                fprintf(stderr, "%s", text);
+            }
+        }, nullptr);
+        backend_whisper_initialized.store(true); });
 }
 
 void WhisperInterface::free_backend()
@@ -64,9 +140,10 @@ void WhisperInterface::free_backend()
  */
 bool WhisperInterface::load_model(const HegemonikonWhisperModelParams &params)
 {
+    std::unique_lock<std::shared_mutex> lock(model_mutex_);
     if (ctx_)
     {
-        unload_model();
+        unload_model_locked();
     }
     current_model_params_ = params;
 
@@ -78,29 +155,132 @@ bool WhisperInterface::load_model(const HegemonikonWhisperModelParams &params)
 
     if (!ctx_)
     {
-        std::cerr << "WhisperInterface Error: Failed to load model from " << current_model_params_.model << std::endl;
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+        {
+            std::cerr << "WhisperInterface Error: Failed to load model from " << current_model_params_.model << std::endl;
+        }
         return false;
     }
 
-    std::cerr << "WhisperInterface: Model loaded successfully: " << current_model_params_.model << std::endl;
+    if (HegemonikonLog::enabled(HegemonikonLogLevel::Info))
+    {
+        std::cerr << "WhisperInterface: Model loaded successfully: " << current_model_params_.model << std::endl;
+    }
+    if (current_model_params_.warmup)
+    {
+        warm_up_locked(HegemonikonWhisperGenerationParams());
+    }
     return true;
 }
 
+/**
+ * @brief Warms the whisper states up for transcriptions with the given parameters.
+ *
+ * The first whisper_full of a state allocates the compute buffers of its graphs and the
+ * decoders of the sampling strategy (beam_size beams, or best_of candidates), uploads or
+ * compiles backend kernels and faults in the weights. Load time already warms up with
+ * the default parameters when HegemonikonWhisperModelParams::warmup is set; call this
+ * again with the parameters of the application, e.g. a larger beam_size, so that short
+ * clips transcribed later only pay for their own audio.
+ *
+ * @param params The parameters of the transcriptions to come.
+ * @return true if every state ran.
+ */
+bool WhisperInterface::warm_up(const HegemonikonWhisperGenerationParams &params)
+{
+    std::shared_lock<std::shared_mutex> lock(model_mutex_);
+    if (!ctx_)
+    {
+        return false;
+    }
+    return warm_up_locked(params);
+}
+
+/**
+ * @brief Runs a second of silence on the default state and on n_processors() pooled states.
+ *
+ * The pooled states are allocated here when parallel transcription is enabled, instead of
+ * on the first long recording. The caller holds model_mutex_.
+ */
+bool WhisperInterface::warm_up_locked(const HegemonikonWhisperGenerationParams &params)
+{
+    HegemonikonWhisperGenerationParams warm_params = params;
+    warm_params.no_context = true;
+    const std::vector<float> silence(SAMPLE_RATE, 0.0f);
+    const auto start = std::chrono::steady_clock::now();
+
+    bool ok = false;
+    {
+        std::lock_guard<std::mutex> lock(context_mutex_);
+        ok = run_full(silence.data(), silence.size(), warm_params, {}, nullptr, false);
+    }
+
+    std::vector<whisper_state *> states;
+    const size_t n_states = n_processors() > 1 ? n_processors() : 0;
+    for (size_t i = 0; i < n_states; ++i)
+    {
+        whisper_state *state = acquire_state();
+        if (!state)
+        {
+            ok = false;
+            break;
+        }
+        ok = run_full(silence.data(), silence.size(), warm_params, {}, state, false) && ok;
+        states.push_back(state);
+    }
+    for (whisper_state *state : states)
+    {
+        release_state(state);
+    }
+
+    const double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if (!ok)
+    {
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Warning))
+        {
+            std::cerr << "WhisperInterface Warning: warm-up failed" << std::endl;
+        }
+    }
+    if (HegemonikonLog::enabled(HegemonikonLogLevel::Info))
+    {
+        std::cerr << "WhisperInterface: warm-up of " << 1 + states.size() << " states took " << elapsed_ms << " ms" << std::endl;
+    }
+    return ok;
+}
+
 /**
  * @brief Unloads the currently loaded Whisper model and releases associated resources.
  *
  * This function checks if a model context (`ctx_`) is loaded. If so, it frees the context
  * using `whisper_free` and sets the context pointer to `nullptr` to prevent dangling references.
  * It also logs a message to standard error indicating that the model has been unloaded.
+ * Waits for the transcriptions in progress.
  */
 void WhisperInterface::unload_model()
 {
+    std::unique_lock<std::shared_mutex> lock(model_mutex_);
+    unload_model_locked();
+}
+
+void WhisperInterface::unload_model_locked()
+{
+    {
+        std::lock_guard<std::mutex> states_lock(states_mutex_);
+        for (whisper_state *state : states_)
+        {
+            whisper_free_state(state);
+        }
+        states_.clear();
+    }
     if (ctx_)
     {
         whisper_free(ctx_);
         ctx_ = nullptr;
     }
-    std::cerr << "WhisperInterface: Model unloaded." << std::endl;
+    if (HegemonikonLog::enabled(HegemonikonLogLevel::Info))
+    {
+        std::cerr << "WhisperInterface: Model unloaded." << std::endl;
+    }
 }
 
 /**
@@ -113,17 +293,80 @@ void WhisperInterface::unload_model()
  */
 bool WhisperInterface::is_model_loaded() const
 {
+    std::shared_lock<std::shared_mutex> lock(model_mutex_);
     return ctx_ != nullptr;
 }
 
-void WhisperInterface::static_new_segment_callback(struct whisper_context * /*w_ctx*/, struct whisper_state * /*state*/, int /*n_new*/, void *user_data)
+/**
+ * @brief Returns the parameters the current model was loaded with.
+ */
+HegemonikonWhisperModelParams WhisperInterface::model_params() const
+{
+    std::shared_lock<std::shared_mutex> lock(model_mutex_);
+    return current_model_params_;
+}
+
+/**
+ * @brief Updates whether the loaded model is parked instead of freed when its service unloads it.
+ *
+ * keep_resident is not part of the model identity, so a model reused for parameters that
+ * differ only there takes the flag of the latest request.
+ */
+void WhisperInterface::set_keep_resident(bool keep_resident)
+{
+    std::unique_lock<std::shared_mutex> lock(model_mutex_);
+    current_model_params_.keep_resident = keep_resident;
+}
+
+/**
+ * @brief Makes transcriptions take their threads from a shared compute pool.
+ *
+ * The thread count of a transcription is then granted by the pool, capped by
+ * HegemonikonWhisperModelParams::n_threads; pass nullptr to use n_threads as is.
+ *
+ * @param pool The compute pool, usually ComputePool::shared().
+ */
+void WhisperInterface::set_compute_pool(std::shared_ptr<ComputePool> pool)
+{
+    compute_pool_ = std::move(pool);
+}
+
+/**
+ * @brief Sets the registry receiving the encoder, decoder and run times of transcriptions.
+ *
+ * Like set_compute_pool, call it before transcribing; pass nullptr to stop recording.
+ *
+ * @param metrics The registry, usually the one of the owning CoreAIService.
+ */
+void WhisperInterface::set_metrics(std::shared_ptr<MetricsRegistry> metrics)
+{
+    metrics_ = std::move(metrics);
+}
+
+/**
+ * @brief Static callback forwarding the segments whisper_full just decoded.
+ *
+ * Reports the last `n_new` segments of the state with their times in milliseconds.
+ *
+ * @param w_ctx Pointer to the whisper_context (unused).
+ * @param state The state holding the segments.
+ * @param n_new Number of segments added since the previous call.
+ * @param user_data Pointer to user data, expected to be a WhisperInterface instance.
+ */
+void WhisperInterface::static_new_segment_callback(struct whisper_context * /*w_ctx*/, struct whisper_state *state, int n_new, void *user_data)
 {
     if (user_data)
     {
         auto *instance = static_cast<WhisperInterface *>(user_data);
         if (instance->current_segment_callback_)
         {
-            // TODO: Implement logic to retrieve the new segment text and timestamps
+            const int n_segments = whisper_full_n_segments_from_state(state);
+            for (int i = std::max(0, n_segments - n_new); i < n_segments; ++i)
+            {
+                instance->current_segment_callback_(whisper_full_get_segment_text_from_state(state, i),
+                                                    whisper_full_get_segment_t0_from_state(state, i) * 10,
+                                                    whisper_full_get_segment_t1_from_state(state, i) * 10);
+            }
         }
     }
 }
@@ -171,132 +414,788 @@ void WhisperInterface::static_progress_callback(struct whisper_context * /*w_ctx
  */
 std::string WhisperInterface::transcribe_pcm(const std::vector<float> &pcm_f32_data, const HegemonikonWhisperGenerationParams &transcription_params)
 {
-    if (!is_model_loaded())
+    return transcribe_pcm(pcm_f32_data.data(), pcm_f32_data.size(), transcription_params);
+}
+
+/**
+ * @brief Transcribes PCM audio read in place from a caller-owned buffer.
+ *
+ * Same as the vector overload, without requiring the samples to be copied into a vector
+ * first; the Python bindings pass NumPy arrays through this overload.
+ *
+ * @param pcm_f32_data 16 kHz mono samples; must stay valid for the duration of the call.
+ * @param n_samples Number of samples.
+ * @param transcription_params Parameters controlling the transcription process.
+ * @return The transcribed text, or an error message string.
+ */
+std::string WhisperInterface::transcribe_pcm(const float *pcm_f32_data, size_t n_samples, const HegemonikonWhisperGenerationParams &transcription_params)
+{
+    return format_transcription(transcription_params, transcribe_pcm_segments(pcm_f32_data, n_samples, transcription_params));
+}
+
+/**
+ * @brief Transcribes PCM audio into segments, with their times and optionally their tokens.
+ *
+ * With `vad` set, only the speech is transcribed and audio without speech succeeds with no
+ * segment. With `n_processors` above 1, audio longer than a window is split at pauses and
+ * its pieces transcribed concurrently.
+ *
+ * @param pcm_f32_data 16 kHz mono samples; must stay valid for the duration of the call.
+ * @param n_samples Number of samples.
+ * @param transcription_params Parameters controlling the transcription process.
+ * @return The segments, or an error if the model is not loaded, the audio is empty or
+ *         whisper failed.
+ */
+HegemonikonTranscription WhisperInterface::transcribe_pcm_segments(const float *pcm_f32_data, size_t n_samples,
+                                                                   const HegemonikonWhisperGenerationParams &transcription_params)
+{
+    HegemonikonTranscription transcription;
+    std::shared_lock<std::shared_mutex> model_lock(model_mutex_);
+    if (!ctx_)
     {
-        std::cerr << "WhisperInterface Error: Model not loaded for transcription." << std::endl;
-        return "[Error: Model not loaded]";
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+        {
+            std::cerr << "WhisperInterface Error: Model not loaded for transcription." << std::endl;
+        }
+        transcription.error = "[Error: Model not loaded]";
+        return transcription;
     }
-    if (pcm_f32_data.empty())
+    if (!pcm_f32_data || n_samples == 0)
     {
-        std::cerr << "WhisperInterface Error: Empty audio data provided." << std::endl;
-        return "[Error: Empty audio data]";
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+        {
+            std::cerr << "WhisperInterface Error: Empty audio data provided." << std::endl;
+        }
+        transcription.error = "[Error: Empty audio data]";
+        return transcription;
     }
+    transcription.audio_ms = static_cast<int64_t>(n_samples * 1000 / SAMPLE_RATE);
 
-    std::cout << "WhisperInterface: Starting transcription..." << std::endl;
+    // With VAD, transcribe the speech only, as one buffer so that whisper still works on full windows.
+    std::vector<float> speech;
+    SpeechTimeline timeline;
+    const SpeechTimeline *mapping = nullptr;
+    if (transcription_params.vad)
+    {
+        const VoiceActivityDetector vad(transcription_params.vad_thold, transcription_params.freq_thold);
+        const size_t n_speech = vad.compact(pcm_f32_data, n_samples, 0, speech, timeline);
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Debug))
+        {
+            std::cerr << "WhisperInterface: VAD kept " << n_speech << " of " << n_samples << " samples." << std::endl;
+        }
+        if (speech.empty())
+        {
+            return transcription;
+        }
+        pcm_f32_data = speech.data();
+        n_samples = speech.size();
+        mapping = &timeline;
+    }
+
+    std::vector<AudioPiece> pieces;
+    if (n_processors() > 1 && split_pieces(pcm_f32_data, n_samples, true, 0, pieces) > 0 && pieces.size() > 1)
+    {
+        if (!transcribe_pieces(pieces, transcription_params, mapping, transcription.segments))
+        {
+            transcription.error = "[Error: Whisper full processing failed]";
+        }
+    }
+    else
+    {
+        std::lock_guard<std::mutex> lock(context_mutex_);
+        if (!run_full(pcm_f32_data, n_samples, transcription_params, {}))
+        {
+            transcription.error = "[Error: Whisper full processing failed]";
+        }
+        else
+        {
+            read_segments(nullptr, 0, mapping, transcription_params.token_timestamps, transcription.segments);
+        }
+    }
+    if (!transcription.ok())
+    {
+        transcription.segments.clear();
+    }
+    return transcription;
+}
 
-    std::vector<whisper_token> prompt_tokens;
+namespace
+{
+    constexpr size_t STREAM_WINDOW_SAMPLES = WhisperInterface::SAMPLE_RATE * 30;
+    constexpr size_t CUT_SEARCH_SAMPLES = WhisperInterface::SAMPLE_RATE * 2;
+    constexpr size_t CUT_FRAME_SAMPLES = WhisperInterface::SAMPLE_RATE / 50;
+    constexpr size_t MAX_PROMPT_TOKENS = 224;
 
-    // run the inference
+    /**
+     * @brief Finds where to end a full window: the quietest 20 ms frame of its last two seconds.
+     *
+     * Cutting in a pause rather than at a fixed sample keeps words from being split between
+     * two windows.
+     */
+    size_t find_window_cut(const float *samples, size_t n_samples)
     {
-        whisper_full_params wparams = whisper_full_default_params(transcription_params.beam_size > 1 ? WHISPER_SAMPLING_BEAM_SEARCH : WHISPER_SAMPLING_GREEDY);
+        const size_t search_begin = n_samples > CUT_SEARCH_SAMPLES ? n_samples - CUT_SEARCH_SAMPLES : 0;
+        size_t best = n_samples;
+        double best_energy = -1.0;
+        for (size_t frame = search_begin; frame + CUT_FRAME_SAMPLES <= n_samples; frame += CUT_FRAME_SAMPLES)
+        {
+            double energy = 0.0;
+            for (size_t i = frame; i < frame + CUT_FRAME_SAMPLES; ++i)
+            {
+                energy += static_cast<double>(samples[i]) * samples[i];
+            }
+            if (best_energy < 0.0 || energy < best_energy)
+            {
+                best_energy = energy;
+                best = frame + CUT_FRAME_SAMPLES / 2;
+            }
+        }
+        return best > 0 ? best : n_samples;
+    }
 
-        std::cout << "Start 1" << std::endl;
-        wparams.print_progress = false;
-        wparams.print_special = transcription_params.print_special;
-        wparams.print_realtime = false;
-        wparams.print_timestamps = !transcription_params.no_timestamps;
-        wparams.translate = transcription_params.translate;
-        wparams.single_segment = true;
-        wparams.max_tokens = transcription_params.max_tokens;
-        wparams.language = current_model_params_.language.c_str();
-        wparams.n_threads = current_model_params_.n_threads;
-        wparams.beam_search.beam_size = transcription_params.beam_size;
+    /**
+     * @brief Converts a whisper timestamp of a buffer to milliseconds in the original audio.
+     *
+     * @param t_cs Timestamp in centiseconds from the start of the buffer.
+     * @param offset_samples Position of the buffer in the (possibly compacted) stream.
+     * @param timeline Maps the compacted stream to the original audio, null if not compacted.
+     */
+    int64_t to_stream_ms(int64_t t_cs, uint64_t offset_samples, const SpeechTimeline *timeline)
+    {
+        uint64_t position = offset_samples + static_cast<uint64_t>(std::max<int64_t>(0, t_cs)) * (WhisperInterface::SAMPLE_RATE / 100);
+        if (timeline)
+        {
+            position = timeline->to_original(position);
+        }
+        return static_cast<int64_t>(position * 1000 / WhisperInterface::SAMPLE_RATE);
+    }
+}
 
-        wparams.audio_ctx = transcription_params.audio_ctx;
+/**
+ * @brief Transcribes audio pulled from a reader, holding at most one window of samples.
+ *
+ * The reader fills a fixed 30 s window, which is transcribed and then refilled; the tail
+ * after the cut point (the quietest frame near the end of the window) is carried over to
+ * the next window. Peak memory is therefore independent of the length of the audio, and
+ * sources whose length is not known in advance are transcribed until the reader returns
+ * 0. Timestamps are relative to the start of the stream. Unless `no_context` is set, the
+ * text tokens of each window prompt the next one.
+ *
+ * With `vad` set, the audio is read in 30 s blocks whose silence is cut out before they
+ * fill the windows, so each window holds up to 30 s of speech and mostly silent audio
+ * costs proportionally fewer whisper passes; timestamps still refer to the original audio.
+ *
+ * With `n_processors` above 1, that many windows are read at a time and transcribed
+ * concurrently on separate whisper states, so concurrent calls do not queue on the
+ * default state either; windows are then not prompted with the text of the previous one.
+ *
+ * @param reader Called with a buffer and its capacity in samples; returns the number of
+ *               16 kHz mono samples written, 0 at the end of the stream.
+ * @param transcription_params Parameters controlling the transcription process.
+ * @return The transcribed text, or an error message string.
+ */
+std::string WhisperInterface::transcribe_stream(const whisper_pcm_reader_t &reader, const HegemonikonWhisperGenerationParams &transcription_params)
+{
+    return format_transcription(transcription_params, transcribe_stream_segments(reader, transcription_params));
+}
 
-        wparams.tdrz_enable = transcription_params.tinydiarize; // [TDRZ]
+/**
+ * @brief Transcribes audio pulled from a reader into segments, one window at a time.
+ *
+ * See transcribe_stream for how the stream is windowed.
+ *
+ * @param reader Called with a buffer and its capacity in samples; returns the number of
+ *               16 kHz mono samples written, 0 at the end of the stream.
+ * @param transcription_params Parameters controlling the transcription process.
+ * @param on_segment Optional, called with each segment as soon as its window is
+ *                   transcribed, on the calling thread and without any lock held.
+ * @return The segments, or an error if the model is not loaded, the stream is empty or
+ *         whisper failed.
+ */
+HegemonikonTranscription WhisperInterface::transcribe_stream_segments(const whisper_pcm_reader_t &reader,
+                                                                      const HegemonikonWhisperGenerationParams &transcription_params,
+                                                                      const whisper_segment_callback_t &on_segment)
+{
+    HegemonikonTranscription transcription;
+    size_t n_parallel = 1;
+    {
+        std::shared_lock<std::shared_mutex> model_lock(model_mutex_);
+        if (!ctx_)
+        {
+            if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+            {
+                std::cerr << "WhisperInterface Error: Model not loaded for transcription." << std::endl;
+            }
+            transcription.error = "[Error: Model not loaded]";
+            return transcription;
+        }
+        n_parallel = n_processors();
+    }
 
-        // disable temperature fallback
-        wparams.temperature_inc = transcription_params.no_fallback ? 0.0f : wparams.temperature_inc;
-        wparams.duration_ms = 1000.0f * pcm_f32_data.size() / 16000.0f;
+    std::vector<float> window(STREAM_WINDOW_SAMPLES * n_parallel);
+    std::vector<int32_t> prompt_tokens;
+    std::vector<AudioPiece> pieces;
+    std::vector<HegemonikonWhisperSegment> &segments = transcription.segments;
+    auto fail = [&transcription]()
+    {
+        transcription.segments.clear();
+        transcription.error = "[Error: Whisper full processing failed]";
+        return transcription;
+    };
 
-        wparams.prompt_tokens = transcription_params.no_context ? nullptr : prompt_tokens.data();
-        wparams.prompt_n_tokens = transcription_params.no_context ? 0 : prompt_tokens.size();
+    uint64_t total_samples = 0;
+    whisper_pcm_reader_t read = [&](float *buffer, size_t max_samples)
+    {
+        const size_t n_read = reader(buffer, max_samples);
+        total_samples += n_read;
+        return n_read;
+    };
 
-        std::cout << "pcm_f32_data.size()  " << pcm_f32_data.size() << std::endl;
+    // VAD: `read` serves the speech of raw blocks instead of the raw audio.
+    const VoiceActivityDetector vad(transcription_params.vad_thold, transcription_params.freq_thold);
+    SpeechTimeline timeline;
+    std::vector<float> block;
+    std::vector<float> speech;
+    size_t speech_pos = 0;
+    uint64_t speech_samples = 0;
+    if (transcription_params.vad)
+    {
+        block.resize(STREAM_WINDOW_SAMPLES);
+        read = [&](float *buffer, size_t max_samples)
+        {
+            bool block_end = false;
+            while (!block_end && speech.size() - speech_pos < max_samples)
+            {
+                size_t n_block = 0;
+                while (n_block < block.size())
+                {
+                    const size_t n_read = reader(block.data() + n_block, block.size() - n_block);
+                    if (n_read == 0)
+                    {
+                        block_end = true;
+                        break;
+                    }
+                    n_block += n_read;
+                }
+                speech.erase(speech.begin(), speech.begin() + static_cast<std::ptrdiff_t>(speech_pos));
+                speech_pos = 0;
+                speech_samples += vad.compact(block.data(), n_block, total_samples, speech, timeline);
+                total_samples += n_block;
+            }
+            const size_t n_copy = std::min(max_samples, speech.size() - speech_pos);
+            std::copy(speech.begin() + static_cast<std::ptrdiff_t>(speech_pos),
+                      speech.begin() + static_cast<std::ptrdiff_t>(speech_pos + n_copy), buffer);
+            speech_pos += n_copy;
+            return n_copy;
+        };
+    }
 
-        if (whisper_full(ctx_, wparams, pcm_f32_data.data(), pcm_f32_data.size()) != 0)
+    size_t filled = 0;
+    size_t n_reported = 0;
+    uint64_t window_start = 0;
+    bool end_of_stream = false;
+    while (true)
+    {
+        while (!end_of_stream && filled < window.size())
         {
-            return "[Error: Whisper full processing failed]";
+            const size_t n_read = read(window.data() + filled, window.size() - filled);
+            end_of_stream = n_read == 0;
+            filled += n_read;
+        }
+        if (filled == 0)
+        {
+            break;
         }
 
-        std::cout << "whisper_full if passed  " << pcm_f32_data.size() << std::endl;
-
-        std::string result;
-        result.append("<whisper>");
-        std::ofstream fout;
+        const SpeechTimeline *mapping = transcription_params.vad ? &timeline : nullptr;
+        const size_t cut = split_pieces(window.data(), filled, end_of_stream, window_start, pieces);
+        {
+            // Locked per window, so that live sessions are not held up for a whole file.
+            std::shared_lock<std::shared_mutex> model_lock(model_mutex_);
+            if (!ctx_)
+            {
+                return fail();
+            }
+            if (n_parallel > 1)
+            {
+                if (!transcribe_pieces(pieces, transcription_params, mapping, segments))
+                {
+                    return fail();
+                }
+            }
+            else
+            {
+                std::lock_guard<std::mutex> lock(context_mutex_);
+                if (!run_full(window.data(), cut, transcription_params, prompt_tokens))
+                {
+                    return fail();
+                }
+                read_segments(nullptr, window_start, mapping, transcription_params.token_timestamps, segments);
+                if (!transcription_params.no_context)
+                {
+                    collect_prompt_tokens(prompt_tokens);
+                }
+            }
+        }
 
-        if (transcription_params.fname_out.length() > 0)
+        if (on_segment)
         {
-            fout.open(transcription_params.fname_out);
-            if (!fout.is_open())
+            for (; n_reported < segments.size(); ++n_reported)
             {
-                std::cerr << "Warning: Could not open output file: " << transcription_params.fname_out << std::endl;
+                on_segment(segments[n_reported]);
             }
         }
 
-        const int n_segments = whisper_full_n_segments(ctx_);
-        for (int i = 0; i < n_segments; ++i)
+        std::move(window.begin() + cut, window.begin() + filled, window.begin());
+        filled -= cut;
+        window_start += cut;
+    }
+
+    if (total_samples == 0)
+    {
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
         {
-            const char *text = whisper_full_get_segment_text(ctx_, i);
+            std::cerr << "WhisperInterface Error: Empty audio data provided." << std::endl;
+        }
+        transcription.error = "[Error: Empty audio data]";
+        return transcription;
+    }
+    if (transcription_params.vad && HegemonikonLog::enabled(HegemonikonLogLevel::Debug))
+    {
+        std::cerr << "WhisperInterface: VAD kept " << speech_samples << " of " << total_samples << " samples." << std::endl;
+    }
+    transcription.audio_ms = static_cast<int64_t>(total_samples * 1000 / SAMPLE_RATE);
+    return transcription;
+}
 
-            std::cout << "WhisperInterface: Segment " << i << ": " << text << std::endl;
+/**
+ * @brief Transcribes one buffer into segments, for callers that handle the text themselves.
+ *
+ * Used by streaming sessions, which call it for every window of live audio. With `vad`
+ * set, only the speech of the buffer is transcribed, and a buffer without speech succeeds
+ * with no segment and leaves `next_prompt_tokens` untouched.
+ *
+ * @param pcm_f32_data 16 kHz mono samples.
+ * @param n_samples Number of samples.
+ * @param transcription_params Parameters controlling the transcription process.
+ * @param prompt_tokens Text tokens of the previous window, ignored when `no_context` is set.
+ * @param offset_ms Position of the buffer in the stream, added to the segment times.
+ * @param segments Receives the segments of the buffer.
+ * @param next_prompt_tokens Optional, receives the text tokens to prompt the next window with.
+ * @return true on success; false if the model is not loaded or whisper failed.
+ */
+bool WhisperInterface::transcribe_segments(const float *pcm_f32_data, size_t n_samples,
+                                           const HegemonikonWhisperGenerationParams &transcription_params,
+                                           const std::vector<int32_t> &prompt_tokens, int64_t offset_ms,
+                                           std::vector<HegemonikonWhisperSegment> &segments,
+                                           std::vector<int32_t> *next_prompt_tokens)
+{
+    segments.clear();
+    std::shared_lock<std::shared_mutex> model_lock(model_mutex_);
+    std::lock_guard<std::mutex> lock(context_mutex_);
+    if (!ctx_ || !pcm_f32_data || n_samples == 0)
+    {
+        return false;
+    }
 
-            if (transcription_params.no_timestamps)
-            {
-                result += text;
+    std::vector<float> speech;
+    SpeechTimeline timeline;
+    if (transcription_params.vad)
+    {
+        const VoiceActivityDetector vad(transcription_params.vad_thold, transcription_params.freq_thold);
+        vad.compact(pcm_f32_data, n_samples, 0, speech, timeline);
+        if (speech.empty())
+        {
+            return true;
+        }
+        pcm_f32_data = speech.data();
+        n_samples = speech.size();
+    }
+    if (!run_full(pcm_f32_data, n_samples, transcription_params, prompt_tokens))
+    {
+        return false;
+    }
+
+    read_segments(nullptr, 0, transcription_params.vad ? &timeline : nullptr, transcription_params.token_timestamps, segments);
+    for (HegemonikonWhisperSegment &segment : segments)
+    {
+        segment.t0_ms += offset_ms;
+        segment.t1_ms += offset_ms;
+    }
+    if (next_prompt_tokens)
+    {
+        collect_prompt_tokens(*next_prompt_tokens);
+    }
+    return true;
+}
 
-                // // Optional: still print to stdout if needed
-                // if (transcription_params.print_to_stdout)
-                // {
-                //     printf("%s", text);
-                //     fflush(stdout);
-                // }
+/**
+ * @brief Runs whisper_full over one buffer with the transcription parameters.
+ *
+ * @param prompt_tokens Text tokens prompting the decoder; ignored when `no_context` is set.
+ * @param state The state to run on, nullptr for the default state of the context (the
+ *              caller then holds context_mutex_).
+ * @param record_metrics false to keep the run out of the metrics, as for warm-up runs.
+ * @return true on success.
+ */
+bool WhisperInterface::run_full(const float *samples, size_t n_samples, const HegemonikonWhisperGenerationParams &transcription_params,
+                                const std::vector<int32_t> &prompt_tokens, whisper_state *state, bool record_metrics)
+{
+    whisper_full_params wparams = whisper_full_default_params(transcription_params.beam_size > 1 ? WHISPER_SAMPLING_BEAM_SEARCH : WHISPER_SAMPLING_GREEDY);
 
-                if (fout.is_open())
-                {
-                    fout << text;
-                }
+    wparams.print_progress = false;
+    wparams.print_special = transcription_params.print_special;
+    wparams.print_realtime = false;
+    wparams.print_timestamps = !transcription_params.no_timestamps;
+    wparams.translate = transcription_params.translate;
+    wparams.single_segment = true;
+    wparams.max_tokens = transcription_params.max_tokens;
+    wparams.language = current_model_params_.language.c_str();
+    wparams.n_threads = current_model_params_.n_threads;
+
+    // Held for the whole transcription: the threads whisper spawns inherit the lease CPUs.
+    ComputeLease lease;
+    if (compute_pool_)
+    {
+        lease = compute_pool_->acquire(ComputeEngine::Whisper, current_model_params_.n_threads);
+        lease.bind_current_thread();
+        wparams.n_threads = lease.n_threads();
+    }
+    wparams.beam_search.beam_size = transcription_params.beam_size;
+
+    wparams.audio_ctx = transcription_params.audio_ctx;
+
+    wparams.tdrz_enable = transcription_params.tinydiarize; // [TDRZ]
+
+    wparams.token_timestamps = transcription_params.token_timestamps;
+    wparams.thold_pt = transcription_params.word_thold;
+
+    // disable temperature fallback
+    wparams.temperature_inc = transcription_params.no_fallback ? 0.0f : wparams.temperature_inc;
+    wparams.duration_ms = 1000.0f * n_samples / SAMPLE_RATE;
+
+    wparams.prompt_tokens = transcription_params.no_context || prompt_tokens.empty() ? nullptr : prompt_tokens.data();
+    wparams.prompt_n_tokens = transcription_params.no_context ? 0 : static_cast<int>(prompt_tokens.size());
+
+    MetricsRegistry *metrics = record_metrics ? metrics_.get() : nullptr;
+    WhisperRunTimer timer;
+    if (metrics || TraceRecorder::enabled())
+    {
+        wparams.encoder_begin_callback = WhisperRunTimer::on_encoder_begin;
+        wparams.encoder_begin_callback_user_data = &timer;
+        wparams.logits_filter_callback = WhisperRunTimer::on_logits;
+        wparams.logits_filter_callback_user_data = &timer;
+    }
+    const WhisperRunTimer::clock::time_point start = WhisperRunTimer::clock::now();
+
+    TraceSpan span("whisper_full", "whisper");
+    span.set_arg("n_samples", static_cast<int64_t>(n_samples));
+    const int ret = state ? whisper_full_with_state(ctx_, state, wparams, samples, static_cast<int>(n_samples))
+                          : whisper_full(ctx_, wparams, samples, static_cast<int>(n_samples));
+    const WhisperRunTimer::clock::time_point end = WhisperRunTimer::clock::now();
+    timer.finish(end);
+    span.finish();
+
+    if (metrics)
+    {
+        metrics->record(MetricPhase::Transcription, start, end);
+        if (timer.started)
+        {
+            metrics->record(MetricPhase::WhisperEncode, start, start + timer.encode);
+            metrics->record(MetricPhase::WhisperDecode, start, start + timer.decode);
+        }
+        metrics->add(ret == 0 ? MetricCounter::Transcriptions : MetricCounter::FailedTranscriptions);
+        metrics->add(MetricCounter::AudioSamples, n_samples);
+    }
+    return ret == 0;
+}
+
+/**
+ * @brief Splits audio into pieces of at most one window, cut in pauses.
+ *
+ * @param end_of_audio Whether the audio ends with the buffer; if not, the audio after the
+ *                     last cut is left for the next call.
+ * @param offset Position of the buffer in the stream, recorded in the pieces.
+ * @param pieces Receives the pieces.
+ * @return The number of samples covered by the pieces.
+ */
+size_t WhisperInterface::split_pieces(const float *samples, size_t n_samples, bool end_of_audio, uint64_t offset,
+                                      std::vector<AudioPiece> &pieces)
+{
+    pieces.clear();
+    size_t position = 0;
+    while (position < n_samples)
+    {
+        const size_t remaining = n_samples - position;
+        if (remaining <= STREAM_WINDOW_SAMPLES)
+        {
+            // A short tail waits for more audio, unless it is all there is.
+            if (end_of_audio || pieces.empty())
+            {
+                const size_t length = end_of_audio ? remaining : find_window_cut(samples + position, remaining);
+                pieces.push_back({samples + position, length, offset + position});
+                position += length;
             }
-            else
+            break;
+        }
+        const size_t length = find_window_cut(samples + position, STREAM_WINDOW_SAMPLES);
+        pieces.push_back({samples + position, length, offset + position});
+        position += length;
+    }
+    return position;
+}
+
+/**
+ * @brief Transcribes pieces concurrently, each on its own state, and joins their segments.
+ *
+ * Up to n_processors() workers take the pieces in order; each runs whisper with its own
+ * compute lease. The caller holds model_mutex_ (shared).
+ *
+ * @param pieces The pieces, in stream order.
+ * @param timeline Maps stream positions back to the original audio, null if not compacted.
+ * @param segments Receives the segments of every piece, in stream order.
+ * @return true if every piece was transcribed.
+ */
+bool WhisperInterface::transcribe_pieces(const std::vector<AudioPiece> &pieces, const HegemonikonWhisperGenerationParams &transcription_params,
+                                         const SpeechTimeline *timeline, std::vector<HegemonikonWhisperSegment> &segments)
+{
+    std::vector<std::vector<HegemonikonWhisperSegment>> piece_segments(pieces.size());
+    std::atomic<size_t> next_piece{0};
+    std::atomic<bool> failed{false};
+
+    auto worker = [&]()
+    {
+        whisper_state *state = acquire_state();
+        if (!state)
+        {
+            failed = true;
+            return;
+        }
+        for (size_t i = next_piece++; i < pieces.size() && !failed; i = next_piece++)
+        {
+            if (!run_full(pieces[i].samples, pieces[i].n_samples, transcription_params, {}, state))
             {
-                const int64_t t0 = whisper_full_get_segment_t0(ctx_, i);
-                const int64_t t1 = whisper_full_get_segment_t1(ctx_, i);
+                failed = true;
+                break;
+            }
+            read_segments(state, pieces[i].offset, timeline, transcription_params.token_timestamps, piece_segments[i]);
+        }
+        release_state(state);
+    };
 
-                // Format with timestamps
-                char timestamp_buffer[64];
-                snprintf(timestamp_buffer, sizeof(timestamp_buffer), "[%02d:%02d.%03d --> %02d:%02d.%03d] ",
-                         (int)(t0 / 600000), (int)(t0 / 10000) % 60, (int)(t0 % 10000) / 10,
-                         (int)(t1 / 600000), (int)(t1 / 10000) % 60, (int)(t1 % 10000) / 10);
+    const size_t n_workers = std::min(n_processors(), pieces.size());
+    std::vector<std::thread> workers;
+    workers.reserve(n_workers - 1);
+    for (size_t i = 1; i < n_workers; ++i)
+    {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (std::thread &thread : workers)
+    {
+        thread.join();
+    }
+    if (failed)
+    {
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+        {
+            std::cerr << "WhisperInterface Error: Parallel transcription failed." << std::endl;
+        }
+        return false;
+    }
 
-                std::string output = std::string(timestamp_buffer) + text;
+    for (std::vector<HegemonikonWhisperSegment> &piece : piece_segments)
+    {
+        segments.insert(segments.end(), std::make_move_iterator(piece.begin()), std::make_move_iterator(piece.end()));
+    }
+    return true;
+}
 
-                if (whisper_full_get_segment_speaker_turn_next(ctx_, i))
-                {
-                    output += " [SPEAKER_TURN]";
-                }
+/**
+ * @brief Takes an idle state, creating one over the loaded model if none is left.
+ *
+ * @return The state, or nullptr if it could not be allocated.
+ */
+whisper_state *WhisperInterface::acquire_state()
+{
+    std::lock_guard<std::mutex> lock(states_mutex_);
+    if (!states_.empty())
+    {
+        whisper_state *state = states_.back();
+        states_.pop_back();
+        return state;
+    }
+    whisper_state *state = whisper_init_state(ctx_);
+    if (!state)
+    {
+        if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+        {
+            std::cerr << "WhisperInterface Error: Failed to create a whisper state." << std::endl;
+        }
+    }
+    return state;
+}
 
-                output += "\n";
-                result += output;
+void WhisperInterface::release_state(whisper_state *state)
+{
+    std::lock_guard<std::mutex> lock(states_mutex_);
+    states_.push_back(state);
+}
 
-                // if (transcription_params.print_to_stdout)
-                // {
-                //     printf("%s", output.c_str());
-                //     fflush(stdout);
-                // }
+/**
+ * @brief Number of pieces transcribed concurrently, from the model parameters.
+ */
+size_t WhisperInterface::n_processors() const
+{
+    return static_cast<size_t>(std::max(1, current_model_params_.n_processors));
+}
 
-                if (fout.is_open())
-                {
-                    fout << output;
-                }
+/**
+ * @brief Reads the segments of the last whisper_full run.
+ *
+ * @param state The state that ran, nullptr for the default state of the context.
+ * @param offset_samples Start of the transcribed buffer in the stream, in samples.
+ * @param timeline Maps the stream back to the original audio when silence was cut out of
+ *                 it, null otherwise.
+ * @param with_tokens Whether to read the text tokens of the segments too; special and
+ *                    timestamp tokens are skipped.
+ * @param segments Receives the segments, with times in the original audio.
+ */
+void WhisperInterface::read_segments(whisper_state *state, uint64_t offset_samples, const SpeechTimeline *timeline,
+                                     bool with_tokens, std::vector<HegemonikonWhisperSegment> &segments) const
+{
+    const whisper_token eot = whisper_token_eot(ctx_);
+    const int n_segments = state ? whisper_full_n_segments_from_state(state) : whisper_full_n_segments(ctx_);
+    segments.reserve(segments.size() + static_cast<size_t>(n_segments));
+    for (int i = 0; i < n_segments; ++i)
+    {
+        HegemonikonWhisperSegment segment;
+        if (state)
+        {
+            segment.text = whisper_full_get_segment_text_from_state(state, i);
+            segment.t0_ms = to_stream_ms(whisper_full_get_segment_t0_from_state(state, i), offset_samples, timeline);
+            segment.t1_ms = to_stream_ms(whisper_full_get_segment_t1_from_state(state, i), offset_samples, timeline);
+            segment.speaker_turn_next = whisper_full_get_segment_speaker_turn_next_from_state(state, i);
+            segment.no_speech_prob = whisper_full_get_segment_no_speech_prob_from_state(state, i);
+        }
+        else
+        {
+            segment.text = whisper_full_get_segment_text(ctx_, i);
+            segment.t0_ms = to_stream_ms(whisper_full_get_segment_t0(ctx_, i), offset_samples, timeline);
+            segment.t1_ms = to_stream_ms(whisper_full_get_segment_t1(ctx_, i), offset_samples, timeline);
+            segment.speaker_turn_next = whisper_full_get_segment_speaker_turn_next(ctx_, i);
+            segment.no_speech_prob = whisper_full_get_segment_no_speech_prob(ctx_, i);
+        }
+
+        const int n_tokens = !with_tokens ? 0 : state ? whisper_full_n_tokens_from_state(state, i) : whisper_full_n_tokens(ctx_, i);
+        for (int j = 0; j < n_tokens; ++j)
+        {
+            const whisper_token_data data = state ? whisper_full_get_token_data_from_state(state, i, j) : whisper_full_get_token_data(ctx_, i, j);
+            if (data.id >= eot)
+            {
+                continue;
             }
+            HegemonikonWhisperToken token;
+            token.id = data.id;
+            token.text = state ? whisper_full_get_token_text_from_state(ctx_, state, i, j) : whisper_full_get_token_text(ctx_, i, j);
+            token.t0_ms = data.t0 < 0 ? -1 : to_stream_ms(data.t0, offset_samples, timeline);
+            token.t1_ms = data.t1 < 0 ? -1 : to_stream_ms(data.t1, offset_samples, timeline);
+            token.p = data.p;
+            segment.tokens.push_back(std::move(token));
         }
+        segments.push_back(std::move(segment));
+    }
+}
+
+/**
+ * @brief Formats a transcription as the text returned by transcribe_pcm and transcribe_stream.
+ *
+ * The text starts with `<whisper>` and holds one line per segment with its timestamps
+ * and speaker turn, or the bare segment texts with `no_timestamps`. It is also written to
+ * `fname_out` if set. A failed transcription formats as its error.
+ *
+ * @param transcription_params The parameters the transcription ran with.
+ * @param transcription The transcription.
+ * @return The formatted text, or the error message string.
+ */
+std::string WhisperInterface::format_transcription(const HegemonikonWhisperGenerationParams &transcription_params,
+                                                   const HegemonikonTranscription &transcription)
+{
+    if (!transcription.ok())
+    {
+        return transcription.error;
+    }
 
-        if (fout.is_open())
+    std::string result = "<whisper>";
+    for (const HegemonikonWhisperSegment &segment : transcription.segments)
+    {
+        if (transcription_params.no_timestamps)
         {
-            fout.close();
+            result += segment.text;
+            continue;
         }
 
-        return result;
+        const int64_t t0 = segment.t0_ms;
+        const int64_t t1 = segment.t1_ms;
+
+        // Format with timestamps
+        char timestamp_buffer[64];
+        snprintf(timestamp_buffer, sizeof(timestamp_buffer), "[%02d:%02d.%03d --> %02d:%02d.%03d] ",
+                 (int)(t0 / 60000), (int)(t0 / 1000) % 60, (int)(t0 % 1000),
+                 (int)(t1 / 60000), (int)(t1 / 1000) % 60, (int)(t1 % 1000));
+
+        result += timestamp_buffer;
+        result += segment.text;
+        if (segment.speaker_turn_next)
+        {
+            result += " [SPEAKER_TURN]";
+        }
+        result += "\n";
     }
-}
\ No newline at end of file
+
+    if (transcription_params.fname_out.length() > 0)
+    {
+        std::ofstream fout(transcription_params.fname_out);
+        if (!fout.is_open())
+        {
+            if (HegemonikonLog::enabled(HegemonikonLogLevel::Warning))
+            {
+                std::cerr << "Warning: Could not open output file: " << transcription_params.fname_out << std::endl;
+            }
+        }
+        else
+        {
+            fout << result.substr(std::string("<whisper>").size());
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief Replaces the prompt with the text tokens of the last whisper_full run.
+ *
+ * Special tokens are skipped and only the last MAX_PROMPT_TOKENS are kept, as the
+ * decoder accepts at most half of its text context as prompt.
+ */
+void WhisperInterface::collect_prompt_tokens(std::vector<int32_t> &prompt_tokens) const
+{
+    prompt_tokens.clear();
+    const whisper_token eot = whisper_token_eot(ctx_);
+    const int n_segments = whisper_full_n_segments(ctx_);
+    for (int i = 0; i < n_segments; ++i)
+    {
+        const int n_tokens = whisper_full_n_tokens(ctx_, i);
+        for (int j = 0; j < n_tokens; ++j)
+        {
+            const whisper_token token = whisper_full_get_token_id(ctx_, i, j);
+            if (token < eot)
+            {
+                prompt_tokens.push_back(token);
+            }
+        }
+    }
+    if (prompt_tokens.size() > MAX_PROMPT_TOKENS)
+    {
+        prompt_tokens.erase(prompt_tokens.begin(), prompt_tokens.end() - MAX_PROMPT_TOKENS);
+    }
+}
@@ -0,0 +1,426 @@
+#include "whisper_stream_session.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <iostream>
+
+#include "audio_format_converter.hh"
+#include "hegemonikon_log.hh"
+#include "miniaudio.h"
+
+namespace
+{
+    constexpr int CAPTURE_POLL_MS = 10;
+
+    size_t ms_to_samples(int32_t ms)
+    {
+        return ms > 0 ? static_cast<size_t>(ms) * WhisperInterface::SAMPLE_RATE / 1000 : 0;
+    }
+}
+
+/**
+ * @brief The miniaudio capture device feeding a session.
+ *
+ * The device delivers its native format; the callback converts it and writes the samples
+ * to the ring of the session, without locking or allocating.
+ */
+struct WhisperStreamSession::Capture
+{
+    ma_context context;
+    ma_device device;
+    bool context_ready = false;
+    bool device_ready = false;
+    AudioRingBuffer *ring = nullptr;
+    std::unique_ptr<AudioFormatConverter> converter;
+    std::vector<float> converted;
+
+    ~Capture()
+    {
+        if (device_ready)
+        {
+            ma_device_uninit(&device);
+        }
+        if (context_ready)
+        {
+            ma_context_uninit(&context);
+        }
+    }
+
+    static void on_frames(ma_device *device, void * /*output*/, const void *input, ma_uint32 n_frames)
+    {
+        auto *capture = static_cast<Capture *>(device->pUserData);
+        const size_t frame_size = ma_get_bytes_per_frame(device->capture.format, device->capture.channels);
+        const auto *bytes = static_cast<const uint8_t *>(input);
+        for (size_t frame = 0; frame < n_frames; frame += AudioFormatConverter::MAX_BLOCK_FRAMES)
+        {
+            const size_t n_block = std::min<size_t>(AudioFormatConverter::MAX_BLOCK_FRAMES, n_frames - frame);
+            const size_t n_samples = capture->converter->convert(bytes + frame * frame_size, n_block, capture->converted.data());
+            capture->ring->write(capture->converted.data(), n_samples);
+        }
+    }
+};
+
+/**
+ * @brief Starts the worker thread of a session.
+ *
+ * @param whisper The loaded interface to transcribe with.
+ * @param params `step_ms` (100 ms to 30 s), `length_ms` and `keep_ms` shape the windows; the
+ *               other fields are passed to whisper for every window.
+ * @param on_segment Receives the partial and final segments, on the worker thread.
+ */
+WhisperStreamSession::WhisperStreamSession(std::shared_ptr<WhisperInterface> whisper,
+                                           const HegemonikonWhisperGenerationParams &params,
+                                           whisper_segment_callback_t on_segment)
+    : whisper_(std::move(whisper)), params_(params), on_segment_(std::move(on_segment))
+{
+    worker_ = std::thread([this]()
+                          { run(); });
+}
+
+WhisperStreamSession::~WhisperStreamSession()
+{
+    stop();
+}
+
+/**
+ * @brief Appends audio to the session; thread-safe and non-blocking apart from a short lock.
+ *
+ * @param samples 16 kHz mono samples, copied before the call returns.
+ * @param n_samples Number of samples.
+ */
+void WhisperStreamSession::push(const float *samples, size_t n_samples)
+{
+    if (!samples || n_samples == 0)
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_)
+        {
+            return;
+        }
+        pending_.insert(pending_.end(), samples, samples + n_samples);
+        stats_.samples_received += n_samples;
+        if (pending_.size() > MAX_PENDING_SAMPLES)
+        {
+            const size_t excess = pending_.size() - MAX_PENDING_SAMPLES;
+            pending_.erase(pending_.begin(), pending_.begin() + excess);
+            stats_.samples_dropped += excess;
+        }
+    }
+    pending_ready_.notify_one();
+}
+
+/**
+ * @brief Captures audio from an input device into the session.
+ *
+ * The device is opened in its native channels and rate, and in int16 or float samples;
+ * AudioFormatConverter turns them into 16 kHz mono on the audio thread.
+ *
+ * @param capture_id Index of the capture device, -1 for `params.capture_id` (itself -1 for
+ *                   the default device).
+ * @return true if the device is capturing; false otherwise (see error()).
+ */
+bool WhisperStreamSession::start_capture(int32_t capture_id)
+{
+    std::lock_guard<std::mutex> lock(capture_mutex_);
+    if (capture_)
+    {
+        return true;
+    }
+    if (capture_id < 0)
+    {
+        capture_id = params_.capture_id;
+    }
+
+    auto capture = std::make_unique<Capture>();
+    if (ma_context_init(nullptr, 0, nullptr, &capture->context) != MA_SUCCESS)
+    {
+        fail("[Error: Failed to initialize the audio context]");
+        return false;
+    }
+    capture->context_ready = true;
+
+    // Native format: no conversion inside miniaudio.
+    ma_device_config config = ma_device_config_init(ma_device_type_capture);
+    config.capture.format = ma_format_unknown;
+    config.capture.channels = 0;
+    config.sampleRate = 0;
+    config.dataCallback = &Capture::on_frames;
+    config.pUserData = capture.get();
+
+    ma_device_info *devices = nullptr;
+    ma_uint32 n_devices = 0;
+    if (capture_id >= 0)
+    {
+        if (ma_context_get_devices(&capture->context, nullptr, nullptr, &devices, &n_devices) != MA_SUCCESS ||
+            static_cast<ma_uint32>(capture_id) >= n_devices)
+        {
+            fail("[Error: Capture device " + std::to_string(capture_id) + " not found]");
+            return false;
+        }
+        config.capture.pDeviceID = &devices[capture_id].id;
+    }
+
+    if (ma_device_init(&capture->context, &config, &capture->device) != MA_SUCCESS)
+    {
+        fail("[Error: Failed to open the capture device]");
+        return false;
+    }
+    capture->device_ready = true;
+    if (capture->device.capture.format != ma_format_s16 && capture->device.capture.format != ma_format_f32)
+    {
+        // Other native formats are rare; let miniaudio convert them to int16.
+        ma_device_uninit(&capture->device);
+        capture->device_ready = false;
+        config.capture.format = ma_format_s16;
+        if (ma_device_init(&capture->context, &config, &capture->device) != MA_SUCCESS)
+        {
+            fail("[Error: Failed to open the capture device]");
+            return false;
+        }
+        capture->device_ready = true;
+    }
+
+    capture->ring = &capture_ring_;
+    capture->converter = std::make_unique<AudioFormatConverter>(
+        capture->device.capture.format == ma_format_s16 ? AudioSampleFormat::S16 : AudioSampleFormat::F32,
+        capture->device.capture.channels, capture->device.sampleRate);
+    capture->converted.resize(capture->converter->max_output(AudioFormatConverter::MAX_BLOCK_FRAMES));
+
+    if (ma_device_start(&capture->device) != MA_SUCCESS)
+    {
+        fail("[Error: Failed to start the capture device]");
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> session_lock(mutex_);
+        capturing_ = true;
+    }
+    pending_ready_.notify_one();
+    if (HegemonikonLog::enabled(HegemonikonLogLevel::Info))
+    {
+        std::cerr << "WhisperStreamSession: capturing from " << capture->device.capture.name << " ("
+                  << capture->device.capture.channels << " channels, " << capture->device.sampleRate << " Hz)" << std::endl;
+    }
+    capture_ = std::move(capture);
+    return true;
+}
+
+/**
+ * @brief Stops capturing; audio already captured is still transcribed.
+ */
+void WhisperStreamSession::stop_capture()
+{
+    std::lock_guard<std::mutex> lock(capture_mutex_);
+    capture_.reset();
+    std::lock_guard<std::mutex> session_lock(mutex_);
+    capturing_ = false;
+}
+
+/**
+ * @brief Transcribes the remaining audio as final segments, then ends the session.
+ *
+ * Blocks until the last window has been transcribed. Further pushes are ignored.
+ */
+void WhisperStreamSession::stop()
+{
+    stop_capture();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    pending_ready_.notify_one();
+    if (worker_.joinable())
+    {
+        worker_.join();
+    }
+}
+
+bool WhisperStreamSession::is_running() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return running_;
+}
+
+/**
+ * @brief Returns the error that ended the session, empty if none.
+ */
+std::string WhisperStreamSession::error() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return error_;
+}
+
+HegemonikonWhisperStreamStats WhisperStreamSession::get_stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+/**
+ * @brief Moves the captured samples from the ring to the pending audio; run by the worker.
+ */
+void WhisperStreamSession::drain_capture_locked()
+{
+    const size_t n_available = capture_ring_.read_available();
+    if (n_available > 0)
+    {
+        const size_t n_pending = pending_.size();
+        pending_.resize(n_pending + n_available);
+        capture_ring_.read(pending_.data() + n_pending, n_available);
+        stats_.samples_received += n_available;
+        if (pending_.size() > MAX_PENDING_SAMPLES)
+        {
+            const size_t excess = pending_.size() - MAX_PENDING_SAMPLES;
+            pending_.erase(pending_.begin(), pending_.begin() + excess);
+            stats_.samples_dropped += excess;
+        }
+    }
+    // Samples the callback could not fit in the ring are part of the stream too.
+    const uint64_t dropped = capture_ring_.dropped();
+    stats_.samples_received += dropped - capture_dropped_;
+    stats_.samples_dropped += dropped - capture_dropped_;
+    capture_dropped_ = dropped;
+}
+
+void WhisperStreamSession::fail(const std::string &message)
+{
+    if (HegemonikonLog::enabled(HegemonikonLogLevel::Error))
+    {
+        std::cerr << "WhisperStreamSession Error: " << message << std::endl;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (error_.empty())
+    {
+        error_ = message;
+    }
+}
+
+/**
+ * @brief Worker loop: waits for a step of new audio, transcribes the window, reports segments.
+ */
+void WhisperStreamSession::run()
+{
+    const size_t n_step = std::min(std::max(ms_to_samples(params_.step_ms), static_cast<size_t>(WhisperInterface::SAMPLE_RATE / 10)),
+                                   MAX_PENDING_SAMPLES);
+    const size_t n_len = std::max(ms_to_samples(params_.length_ms), n_step);
+    const size_t n_keep = std::min(ms_to_samples(params_.keep_ms), n_step);
+    const size_t n_new_line = std::max<size_t>(1, n_len / n_step - 1);
+
+    std::vector<float> previous;
+    std::vector<float> fresh;
+    std::vector<float> window;
+    std::vector<int32_t> prompt_tokens;
+    std::vector<HegemonikonWhisperSegment> segments;
+    uint64_t stream_samples = 0;
+    size_t iteration = 0;
+    bool committed = true;
+
+    while (true)
+    {
+        bool stopping = false;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            auto ready = [&]()
+            {
+                drain_capture_locked();
+                return stopping_ || pending_.size() >= n_step;
+            };
+            // The capture callback does not notify: poll its ring while capturing.
+            while (!ready())
+            {
+                if (capturing_)
+                {
+                    pending_ready_.wait_for(lock, std::chrono::milliseconds(CAPTURE_POLL_MS));
+                }
+                else
+                {
+                    pending_ready_.wait(lock);
+                }
+            }
+            stopping = stopping_;
+            fresh.swap(pending_);
+            pending_.clear();
+            stream_samples = stats_.samples_received;
+        }
+
+        if (fresh.empty())
+        {
+            if (committed || !stopping)
+            {
+                break;
+            }
+            // The last window was only reported as partial: report it again as final.
+            window.swap(previous);
+            previous.clear();
+        }
+        else
+        {
+            const size_t n_take = std::min(previous.size(), n_keep + n_len > fresh.size() ? n_keep + n_len - fresh.size() : 0);
+            window.assign(previous.end() - static_cast<std::ptrdiff_t>(n_take), previous.end());
+            window.insert(window.end(), fresh.begin(), fresh.end());
+        }
+
+        ++iteration;
+        const bool final = stopping || iteration % n_new_line == 0;
+        const uint64_t window_start = stream_samples > window.size() ? stream_samples - window.size() : 0;
+        const int64_t offset_ms = static_cast<int64_t>(window_start * 1000 / WhisperInterface::SAMPLE_RATE);
+
+        const auto start = std::chrono::steady_clock::now();
+        const bool ok = whisper_->transcribe_segments(window.data(), window.size(), params_, prompt_tokens, offset_ms, segments,
+                                                      final && !params_.no_context ? &prompt_tokens : nullptr);
+        const double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (!ok)
+        {
+            fail(whisper_->is_model_loaded() ? "[Error: Whisper full processing failed]" : "[Error: Whisper model not loaded]");
+            break;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++stats_.windows_transcribed;
+            stats_.transcribe_ms_total += elapsed_ms;
+            stats_.transcribe_ms_last = elapsed_ms;
+            (final ? stats_.final_segments : stats_.partial_segments) += segments.size();
+        }
+        try
+        {
+            for (HegemonikonWhisperSegment &segment : segments)
+            {
+                segment.partial = !final;
+                if (on_segment_)
+                {
+                    on_segment_(segment);
+                }
+            }
+        }
+        catch (const std::exception &e)
+        {
+            fail(std::string("[Error: Segment callback failed: ") + e.what() + "]");
+            break;
+        }
+
+        if (final)
+        {
+            previous.assign(window.end() - static_cast<std::ptrdiff_t>(std::min(n_keep, window.size())), window.end());
+            committed = true;
+        }
+        else
+        {
+            previous.swap(window);
+            committed = false;
+        }
+        if (stopping && fresh.empty())
+        {
+            break;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = false;
+    stopping_ = true;
+    pending_.clear();
+}
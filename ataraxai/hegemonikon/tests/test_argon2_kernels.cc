@@ -0,0 +1,95 @@
+
+#include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "argon2/argon2.h"
+#include "argon2/argon2-core.h"
+
+struct KnownAnswer
+{
+    const char *type;
+    int (*derive)(Argon2_Context *);
+    uint32_t m_cost;
+    uint32_t lanes;
+    const char *tag;
+};
+
+// Tags of the reference core (argon2-ref-core.cpp) with the kat.cpp inputs: t_cost 3,
+// 32-byte tag, password 32 x 0x01, salt 16 x 0x02, secret 8 x 0x03, ad 12 x 0x04.
+static const KnownAnswer kKnownAnswers[] = {
+    {"Argon2d", Argon2d, 16, 4, "57b0613bfdd4131a0c348834c6729c2c7229921e6bba37665d978c4fe7175ed2"},
+    {"Argon2d", Argon2d, 256, 1, "39f55d549ada7dff82154b8f3b0aa42eefd86d8c4dbfba5552da627bb53287cd"},
+    {"Argon2d", Argon2d, 256, 4, "b8f4876c2241e240464c85636d4f6d6cf112a2b6dc955f0432e42e2705e2b340"},
+    {"Argon2i", Argon2i, 16, 4, "913ba437685b613cf12b944679534037ac46cfa88a02f6c7ba280e08894019f2"},
+    {"Argon2i", Argon2i, 256, 1, "a9f96a856fd1710a3492e53b9f0a4c61e91708e2cb59a06b791a2eba1784581d"},
+    {"Argon2i", Argon2i, 256, 4, "feb0b0f81a4cf7c41e9cf521b5145922b0bdd468699a8b7463515795578a0ae4"},
+    {"Argon2id", Argon2id, 16, 4, "f87c9596bdbf750bfb353a8970e5441a70243eb49030dfe274d9ad4e370e389b"},
+    {"Argon2id", Argon2id, 256, 1, "a7b7c3ca459dd16d95b8b1fa343395836d32848726aeba4a17f61a3f4ab479b7"},
+    {"Argon2id", Argon2id, 256, 4, "10aa32bf25af42e0332fe46713320e6e988dc8a91e2295b8edce4cf9e6d6f2ea"},
+    {"Argon2ds", Argon2ds, 16, 4, "fe5a9ec7d78f5fbbfa6cdc5f50c7b926fc2c6e9437aad3e3601ebbce58922c72"},
+    {"Argon2ds", Argon2ds, 256, 1, "7b59a13966cc77e085d3aeb5411ede5b29c20c8601e8a60dacb3434c7082794c"},
+    {"Argon2ds", Argon2ds, 256, 4, "8a8f32d47936cd5ab078de70882f64e25dcd959eaaae8c6cda76da5a952b02a2"},
+};
+
+static std::string derive_tag(const KnownAnswer &answer)
+{
+    uint8_t out[32], pwd[32], salt[16], secret[8], ad[12];
+    memset(pwd, 1, sizeof(pwd));
+    memset(salt, 2, sizeof(salt));
+    memset(secret, 3, sizeof(secret));
+    memset(ad, 4, sizeof(ad));
+
+    Argon2_Context context(out, sizeof(out), pwd, sizeof(pwd), salt, sizeof(salt),
+                           secret, sizeof(secret), ad, sizeof(ad), 3, answer.m_cost, answer.lanes, answer.lanes,
+                           NULL, NULL, false, false, false, false);
+    REQUIRE(answer.derive(&context) == ARGON2_OK);
+
+    std::string hex;
+    char byte[3];
+    for (uint8_t b : out)
+    {
+        snprintf(byte, sizeof(byte), "%02x", b);
+        hex += byte;
+    }
+    return hex;
+}
+
+TEST_CASE("Argon2 kernels match the reference known answers", "[argon2][unit]")
+{
+    const Argon2_kernel detected = Argon2ActiveKernel();
+    REQUIRE(Argon2KernelSupported(detected));
+    REQUIRE(Argon2KernelSupported(Argon2_kernel_sse2));
+
+    for (Argon2_kernel kernel : {Argon2_kernel_sse2, Argon2_kernel_avx2, Argon2_kernel_avx512})
+    {
+        if (!Argon2KernelSupported(kernel))
+        {
+            REQUIRE_FALSE(Argon2SelectKernel(kernel));
+            continue;
+        }
+        REQUIRE(Argon2SelectKernel(kernel));
+        REQUIRE(Argon2ActiveKernel() == kernel);
+        for (const KnownAnswer &answer : kKnownAnswers)
+        {
+            INFO(Argon2KernelName(kernel) << " " << answer.type << " m_cost " << answer.m_cost << " lanes " << answer.lanes);
+            REQUIRE(derive_tag(answer) == answer.tag);
+        }
+    }
+
+    REQUIRE(Argon2SelectKernel(detected));
+}
+
+TEST_CASE("Argon2 picks the widest supported kernel", "[argon2][unit]")
+{
+    const Argon2_kernel active = Argon2ActiveKernel();
+    if (Argon2KernelSupported(Argon2_kernel_avx512))
+        REQUIRE(active == Argon2_kernel_avx512);
+    else if (Argon2KernelSupported(Argon2_kernel_avx2))
+        REQUIRE(active == Argon2_kernel_avx2);
+    else
+        REQUIRE(active == Argon2_kernel_sse2);
+    REQUIRE(std::string(Argon2KernelName(active)) != "unknown");
+}
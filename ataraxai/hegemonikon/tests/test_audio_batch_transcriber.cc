@@ -0,0 +1,148 @@
+#include <catch2/catch_test_macros.hpp>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+#include "audio_batch_transcriber.hh"
+
+static void write_u32(std::ofstream &out, uint32_t value)
+{
+    out.write(reinterpret_cast<const char *>(&value), 4);
+}
+
+static void write_u16(std::ofstream &out, uint16_t value)
+{
+    out.write(reinterpret_cast<const char *>(&value), 2);
+}
+
+static std::string write_wav(const std::string &name, size_t n_frames)
+{
+    const std::string path = (std::filesystem::temp_directory_path() / ("hegemonikon_batch_" + name + ".wav")).string();
+    std::ofstream out(path, std::ios::binary);
+    const uint32_t data_bytes = static_cast<uint32_t>(n_frames * 2);
+    out.write("RIFF", 4);
+    write_u32(out, 36 + data_bytes);
+    out.write("WAVEfmt ", 8);
+    write_u32(out, 16);
+    write_u16(out, 1);
+    write_u16(out, 1);
+    write_u32(out, 16000);
+    write_u32(out, 16000 * 2);
+    write_u16(out, 2);
+    write_u16(out, 16);
+    out.write("data", 4);
+    write_u32(out, data_bytes);
+    for (size_t i = 0; i < n_frames; ++i)
+    {
+        write_u16(out, static_cast<uint16_t>(static_cast<int16_t>(8000.0 * std::sin(2.0 * 3.14159265 * 440.0 * i / 16000))));
+    }
+    return path;
+}
+
+/**
+ * @brief Stands in for whisper: "transcribes" a stream into its sample count.
+ */
+class CountingWhisperInterface : public WhisperInterface
+{
+public:
+    std::atomic<size_t> calls{0};
+
+    HegemonikonTranscription transcribe_stream_segments(const whisper_pcm_reader_t &reader, const HegemonikonWhisperGenerationParams &,
+                                                        const whisper_segment_callback_t &) override
+    {
+        ++calls;
+        std::vector<float> buffer(WhisperInterface::SAMPLE_RATE * 30);
+        size_t total = 0;
+        while (const size_t n = reader(buffer.data(), buffer.size()))
+        {
+            total += n;
+        }
+        HegemonikonTranscription transcription;
+        HegemonikonWhisperSegment segment;
+        segment.text = std::to_string(total);
+        segment.t1_ms = static_cast<int64_t>(total * 1000 / WhisperInterface::SAMPLE_RATE);
+        transcription.segments.push_back(segment);
+        return transcription;
+    }
+};
+
+TEST_CASE("AudioBatchTranscriber returns every file in order", "[audio][unit]")
+{
+    std::vector<std::string> paths;
+    const std::vector<size_t> lengths = {16000, 4000, 16000 * 70, 8000, 1600};
+    for (size_t i = 0; i < lengths.size(); ++i)
+    {
+        paths.push_back(write_wav(std::to_string(i), lengths[i]));
+    }
+
+    auto whisper = std::make_shared<CountingWhisperInterface>();
+    AudioBatchTranscriber transcriber(whisper, 2, 2);
+    std::mutex seen_mutex;
+    std::set<size_t> seen;
+    const auto results = transcriber.run(paths, HegemonikonWhisperGenerationParams(), [&](const HegemonikonTranscriptionResult &result)
+                                         {
+        std::lock_guard<std::mutex> lock(seen_mutex);
+        seen.insert(result.index); });
+
+    REQUIRE(results.size() == paths.size());
+    REQUIRE(seen.size() == paths.size());
+    REQUIRE(whisper->calls == paths.size());
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        REQUIRE(results[i].ok());
+        REQUIRE(results[i].index == i);
+        REQUIRE(results[i].path == paths[i]);
+        REQUIRE(results[i].text == std::to_string(lengths[i]));
+        REQUIRE(results[i].segments.size() == 1);
+        REQUIRE(results[i].segments[0].t1_ms == static_cast<int64_t>(lengths[i] / 16));
+        std::filesystem::remove(paths[i]);
+    }
+}
+
+TEST_CASE("AudioBatchTranscriber reports unreadable files without stopping", "[audio][unit]")
+{
+    const std::string good = write_wav("good", 16000);
+    const std::string missing = (std::filesystem::temp_directory_path() / "hegemonikon_batch_missing.wav").string();
+    std::filesystem::remove(missing);
+
+    auto whisper = std::make_shared<CountingWhisperInterface>();
+    AudioBatchTranscriber transcriber(whisper);
+    const auto results = transcriber.run({missing, good, missing}, HegemonikonWhisperGenerationParams());
+
+    REQUIRE(results.size() == 3);
+    REQUIRE_FALSE(results[0].ok());
+    REQUIRE(results[0].error.rfind("[Error: Failed to load audio file", 0) == 0);
+    REQUIRE(results[0].text.empty());
+    REQUIRE(results[0].segments.empty());
+    REQUIRE(results[1].ok());
+    REQUIRE(results[1].text == "16000");
+    REQUIRE_FALSE(results[2].ok());
+    REQUIRE(whisper->calls == 1);
+    std::filesystem::remove(good);
+}
+
+TEST_CASE("AudioBatchTranscriber stops and rethrows when the callback throws", "[audio][unit]")
+{
+    std::vector<std::string> paths;
+    for (int i = 0; i < 6; ++i)
+    {
+        paths.push_back(write_wav("throw_" + std::to_string(i), 16000 * 5));
+    }
+
+    auto whisper = std::make_shared<CountingWhisperInterface>();
+    AudioBatchTranscriber transcriber(whisper, 3, 1);
+    REQUIRE_THROWS_AS(transcriber.run(paths, HegemonikonWhisperGenerationParams(), [](const HegemonikonTranscriptionResult &)
+                                      { throw std::runtime_error("stop"); }),
+                      std::runtime_error);
+    REQUIRE(whisper->calls == 1);
+    for (const std::string &path : paths)
+    {
+        std::filesystem::remove(path);
+    }
+}
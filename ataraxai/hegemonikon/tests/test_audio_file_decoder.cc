@@ -0,0 +1,91 @@
+#include <catch2/catch_test_macros.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "audio_file_decoder.hh"
+
+static void write_u32(std::ofstream &out, uint32_t value)
+{
+    out.write(reinterpret_cast<const char *>(&value), 4);
+}
+
+static void write_u16(std::ofstream &out, uint16_t value)
+{
+    out.write(reinterpret_cast<const char *>(&value), 2);
+}
+
+static std::string write_wav(const std::string &name, uint32_t sample_rate, uint16_t channels, size_t n_frames)
+{
+    const std::string path = (std::filesystem::temp_directory_path() / ("hegemonikon_" + name + ".wav")).string();
+    std::ofstream out(path, std::ios::binary);
+    const uint32_t data_bytes = static_cast<uint32_t>(n_frames * channels * 2);
+    out.write("RIFF", 4);
+    write_u32(out, 36 + data_bytes);
+    out.write("WAVEfmt ", 8);
+    write_u32(out, 16);
+    write_u16(out, 1);
+    write_u16(out, channels);
+    write_u32(out, sample_rate);
+    write_u32(out, sample_rate * channels * 2);
+    write_u16(out, static_cast<uint16_t>(channels * 2));
+    write_u16(out, 16);
+    out.write("data", 4);
+    write_u32(out, data_bytes);
+    for (size_t i = 0; i < n_frames; ++i)
+    {
+        const auto sample = static_cast<int16_t>(8000.0 * std::sin(2.0 * 3.14159265 * 440.0 * i / sample_rate));
+        for (uint16_t c = 0; c < channels; ++c)
+            write_u16(out, static_cast<uint16_t>(sample));
+    }
+    return path;
+}
+
+TEST_CASE("AudioFileDecoder decodes a file in bounded chunks", "[audio][unit]")
+{
+    const std::string path = write_wav("decoder_mono", 16000, 1, 40000);
+    AudioFileDecoder decoder;
+    REQUIRE(decoder.open(path));
+
+    std::vector<float> chunk(4096);
+    size_t total = 0;
+    size_t reads = 0;
+    float peak = 0.0f;
+    while (const size_t n = decoder.read(chunk.data(), chunk.size()))
+    {
+        REQUIRE(n <= chunk.size());
+        for (size_t i = 0; i < n; ++i)
+            peak = std::max(peak, std::abs(chunk[i]));
+        total += n;
+        ++reads;
+    }
+    REQUIRE(total == 40000);
+    REQUIRE(reads == 10);
+    REQUIRE(decoder.samples_read() == total);
+    REQUIRE_FALSE(decoder.failed());
+    REQUIRE(peak > 0.2f);
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("AudioFileDecoder resamples and downmixes to 16 kHz mono", "[audio][unit]")
+{
+    const std::string path = write_wav("decoder_stereo", 48000, 2, 48000);
+    AudioFileDecoder decoder;
+    REQUIRE(decoder.open(path));
+
+    std::vector<float> chunk(3000);
+    size_t total = 0;
+    while (const size_t n = decoder.read(chunk.data(), chunk.size()))
+        total += n;
+    // One second of audio; the resampler may drop or pad a few frames at the edges.
+    REQUIRE(total >= 15990);
+    REQUIRE(total <= 16010);
+    std::filesystem::remove(path);
+
+    REQUIRE_FALSE(decoder.open(path));
+    REQUIRE(decoder.failed());
+    REQUIRE(decoder.read(chunk.data(), chunk.size()) == 0);
+}
@@ -0,0 +1,105 @@
+#include <catch2/catch_test_macros.hpp>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "audio_format_converter.hh"
+
+static double tone_amplitude(const std::vector<float> &pcm, double frequency, uint32_t sample_rate)
+{
+    // Correlation with the tone, over whole samples after the first 10 ms.
+    double re = 0.0;
+    double im = 0.0;
+    const size_t start = sample_rate / 100;
+    for (size_t i = start; i < pcm.size(); ++i)
+    {
+        re += pcm[i] * std::cos(2.0 * 3.14159265 * frequency * i / sample_rate);
+        im += pcm[i] * std::sin(2.0 * 3.14159265 * frequency * i / sample_rate);
+    }
+    return 2.0 * std::sqrt(re * re + im * im) / static_cast<double>(pcm.size() - start);
+}
+
+TEST_CASE("AudioFormatConverter converts int16 exactly", "[audio][unit]")
+{
+    const std::vector<int16_t> input = {0, 1, -1, 16384, -16384, 32767, -32768, 100, -100, 7};
+    std::vector<float> output(input.size());
+    AudioFormatConverter::s16_to_f32(input.data(), output.data(), input.size());
+    for (size_t i = 0; i < input.size(); ++i)
+    {
+        CHECK(output[i] == static_cast<float>(input[i]) / 32768.0f);
+    }
+}
+
+TEST_CASE("AudioFormatConverter averages the channels", "[audio][unit]")
+{
+    std::vector<float> stereo;
+    for (int i = 0; i < 11; ++i)
+    {
+        stereo.push_back(static_cast<float>(i));
+        stereo.push_back(static_cast<float>(-3 * i));
+    }
+    std::vector<float> mono(11);
+    AudioFormatConverter::downmix(stereo.data(), 11, 2, mono.data());
+    for (int i = 0; i < 11; ++i)
+    {
+        CHECK(mono[i] == static_cast<float>(-i));
+    }
+
+    const std::vector<float> three = {3, 6, 9, 0, 0, 3};
+    AudioFormatConverter::downmix(three.data(), 2, 3, mono.data());
+    CHECK(mono[0] == 6.0f);
+    CHECK(mono[1] == 1.0f);
+}
+
+TEST_CASE("AudioFormatConverter resamples 48 kHz stereo int16 in blocks", "[audio][unit]")
+{
+    const uint32_t rate = 48000;
+    const size_t n_frames = rate;
+    std::vector<int16_t> input(2 * n_frames);
+    for (size_t i = 0; i < n_frames; ++i)
+    {
+        const auto value = static_cast<int16_t>(16000.0 * std::sin(2.0 * 3.14159265 * 440.0 * i / rate));
+        input[2 * i] = value;
+        input[2 * i + 1] = value;
+    }
+
+    AudioFormatConverter converter(AudioSampleFormat::S16, 2, rate);
+    std::vector<float> output;
+    std::vector<float> block(converter.max_output(480));
+    for (size_t frame = 0; frame < n_frames; frame += 480)
+    {
+        const size_t n = converter.convert(input.data() + 2 * frame, 480, block.data());
+        output.insert(output.end(), block.begin(), block.begin() + static_cast<std::ptrdiff_t>(n));
+    }
+
+    CHECK(output.size() + 1 >= 16000);
+    CHECK(output.size() <= 16001);
+    const double amplitude = tone_amplitude(output, 440.0, 16000);
+    CHECK(amplitude > 0.45);
+    CHECK(amplitude < 0.5);
+}
+
+TEST_CASE("AudioFormatConverter filters out what would alias", "[audio][unit]")
+{
+    // 20 kHz at 48 kHz would fold to 4 kHz at 16 kHz.
+    const uint32_t rate = 48000;
+    std::vector<float> input(rate);
+    for (size_t i = 0; i < input.size(); ++i)
+    {
+        input[i] = static_cast<float>(0.5 * std::sin(2.0 * 3.14159265 * 20000.0 * i / rate));
+    }
+
+    AudioFormatConverter converter(AudioSampleFormat::F32, 1, rate);
+    std::vector<float> output(converter.max_output(input.size()));
+    output.resize(converter.convert(input.data(), input.size(), output.data()));
+
+    CHECK(tone_amplitude(output, 4000.0, 16000) < 0.005);
+}
+
+TEST_CASE("AudioFormatConverter passes 16 kHz mono float through", "[audio][unit]")
+{
+    const std::vector<float> input = {0.1f, -0.2f, 0.3f, 0.4f};
+    AudioFormatConverter converter(AudioSampleFormat::F32, 1, 16000);
+    std::vector<float> output(converter.max_output(input.size()));
+    REQUIRE(converter.convert(input.data(), input.size(), output.data()) == input.size());
+    CHECK(std::vector<float>(output.begin(), output.begin() + 4) == input);
+}
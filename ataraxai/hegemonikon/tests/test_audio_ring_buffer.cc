@@ -0,0 +1,75 @@
+#include <catch2/catch_test_macros.hpp>
+#include <thread>
+#include <vector>
+#include "audio_ring_buffer.hh"
+
+TEST_CASE("AudioRingBuffer rounds its capacity up to a power of two", "[audio][unit]")
+{
+    CHECK(AudioRingBuffer(1000).capacity() == 1024);
+    CHECK(AudioRingBuffer(1024).capacity() == 1024);
+}
+
+TEST_CASE("AudioRingBuffer wraps around and drops what does not fit", "[audio][unit]")
+{
+    AudioRingBuffer ring(8);
+    std::vector<float> samples = {1, 2, 3, 4, 5, 6};
+    std::vector<float> out(8, 0.0f);
+
+    REQUIRE(ring.write(samples.data(), 6) == 6);
+    REQUIRE(ring.read(out.data(), 4) == 4);
+    CHECK(out[3] == 4.0f);
+
+    // 2 left, 6 more wrap past the end of the storage.
+    REQUIRE(ring.write(samples.data(), 6) == 6);
+    REQUIRE(ring.read_available() == 8);
+    CHECK(ring.write(samples.data(), 3) == 0);
+    CHECK(ring.dropped() == 3);
+
+    REQUIRE(ring.read(out.data(), 8) == 8);
+    CHECK(out == std::vector<float>({5, 6, 1, 2, 3, 4, 5, 6}));
+    CHECK(ring.read(out.data(), 8) == 0);
+}
+
+TEST_CASE("AudioRingBuffer hands samples from one thread to another in order", "[audio][unit]")
+{
+    AudioRingBuffer ring(256);
+    const size_t total = 200000;
+
+    std::thread producer([&]()
+                         {
+        std::vector<float> block(37);
+        size_t next = 0;
+        while (next < total)
+        {
+            const size_t n = std::min(block.size(), total - next);
+            for (size_t i = 0; i < n; ++i)
+            {
+                block[i] = static_cast<float>((next + i) % 4096);
+            }
+            // Retry what did not fit, so that nothing is dropped.
+            size_t written = 0;
+            while (written < n)
+            {
+                const size_t free_space = ring.capacity() - ring.read_available();
+                written += ring.write(block.data() + written, std::min(n - written, free_space));
+            }
+            next += n;
+        } });
+
+    std::vector<float> out(64);
+    size_t received = 0;
+    bool in_order = true;
+    while (received < total)
+    {
+        const size_t n = ring.read(out.data(), out.size());
+        for (size_t i = 0; i < n; ++i)
+        {
+            in_order = in_order && out[i] == static_cast<float>((received + i) % 4096);
+        }
+        received += n;
+    }
+    producer.join();
+
+    CHECK(in_order);
+    CHECK(ring.dropped() == 0);
+}
@@ -0,0 +1,71 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "compute_pool.hh"
+
+static HegemonikonCpuTopology hybrid_topology(int32_t n_performance, int32_t n_efficiency)
+{
+    HegemonikonCpuTopology topology;
+    for (int32_t i = 0; i < n_performance + n_efficiency; ++i)
+    {
+        HegemonikonCpuCore core;
+        core.cpu = i;
+        core.core_id = i;
+        core.efficiency = i >= n_performance;
+        topology.cores.push_back(core);
+    }
+    topology.n_logical_cpus = n_performance + n_efficiency;
+    return topology;
+}
+
+TEST_CASE("ComputePool splits the cores between llama and whisper", "[compute_pool][unit]")
+{
+    ComputePool pool(hybrid_topology(8, 0));
+    pool.set_idle_grace_ms(0);
+    REQUIRE(pool.size() == 8);
+    REQUIRE(pool.get_quota(ComputeEngine::Whisper) == 2);
+    REQUIRE(pool.get_quota(ComputeEngine::Llama) == 6);
+
+    {
+        ComputeLease alone = pool.acquire(ComputeEngine::Llama);
+        REQUIRE(alone.n_threads() == 8);
+    }
+
+    ComputeLease whisper = pool.acquire(ComputeEngine::Whisper);
+    REQUIRE(whisper.borrowed());
+    REQUIRE(whisper.n_threads() == 8);
+    whisper = ComputeLease();
+
+    {
+        ComputeLease llama = pool.acquire(ComputeEngine::Llama);
+        pool.set_idle_grace_ms(ComputePool::DEFAULT_IDLE_GRACE_MS);
+        ComputeLease busy_whisper = pool.acquire(ComputeEngine::Whisper);
+        REQUIRE(busy_whisper.n_threads() == 2);
+        REQUIRE_FALSE(busy_whisper.borrowed());
+
+        ComputeLease next_step = pool.acquire(ComputeEngine::Llama, 0);
+        REQUIRE(next_step.n_threads() <= 6);
+        REQUIRE(pool.get_stats().whisper_threads == 2);
+    }
+    REQUIRE(pool.get_stats().whisper_threads == 0);
+}
+
+TEST_CASE("ComputePool keeps llama on performance cores and whisper on efficiency cores", "[compute_pool][unit]")
+{
+    ComputePool pool(hybrid_topology(6, 4));
+    pool.configure(true);
+    REQUIRE(pool.get_quota(ComputeEngine::Whisper) == 4);
+    REQUIRE(pool.get_quota(ComputeEngine::Llama) == 6);
+
+    ComputeLease llama = pool.acquire(ComputeEngine::Llama);
+    REQUIRE(llama.n_threads() == 6);
+    ComputeLease whisper = pool.acquire(ComputeEngine::Whisper, 3);
+    REQUIRE(whisper.n_threads() == 3);
+    for (int32_t cpu : whisper.cpus())
+    {
+        REQUIRE(cpu >= 6);
+    }
+
+    pool.set_quota(ComputeEngine::Llama, 2);
+    ComputeLease capped = pool.acquire(ComputeEngine::Llama);
+    REQUIRE(capped.n_threads() == 1);
+}
@@ -1,5 +1,6 @@
 
 #include <catch2/catch_test_macros.hpp>
+#include <future>
 #include <string>
 #include <vector>
 #include <memory>
@@ -44,6 +45,65 @@ public:
         }
         return true;
     }
+
+    HegemonikonGenerationResult run_generation(const std::string& prompt, const HegemonikonGenerationParams&,
+                                               llama_token_callback on_piece,
+                                               std::shared_ptr<LlamaRequestHandle>) override {
+        HegemonikonGenerationResult result;
+        result.success = true;
+        result.ttft_ms = 10.0;
+        result.decode_duration_ms = 5.0;
+        if (on_piece) {
+            generate_streaming_called = true;
+            for (const char* piece : {"streamed", " ", "response"}) {
+                on_piece(piece);
+                result.text += piece;
+            }
+        } else {
+            generate_completion_called = true;
+            result.text = "mocked completion: " + prompt;
+        }
+        result.tokens_generated = 42;
+        return result;
+    }
+};
+
+// Blocks load_model until released, to hold a background load in progress.
+class GatedLlamaInterface : public LlamaInterface {
+public:
+    GatedLlamaInterface(std::shared_future<void> gate, int* n_loads) : gate_(std::move(gate)), n_loads_(n_loads) {}
+
+    bool load_model(const HegemonikonLlamaModelParams&) override {
+        ++*n_loads_;
+        gate_.wait();
+        return true;
+    }
+
+    void unload_model() override {}
+
+private:
+    std::shared_future<void> gate_;
+    int* n_loads_;
+};
+
+struct LoadGate {
+    std::promise<void> promise;
+    std::shared_future<void> future = promise.get_future().share();
+    bool released = false;
+
+    void release() {
+        if (!released) {
+            released = true;
+            promise.set_value();
+        }
+    }
+
+    // Declared after the service, opens the gate before the service joins its load
+    // thread, so a failed check never leaves it blocked.
+    struct Opener {
+        LoadGate& gate;
+        ~Opener() { gate.release(); }
+    };
 };
 
 class MockWhisperInterface : public WhisperInterface {
@@ -132,14 +192,29 @@ TEST_CASE("CoreAIService with Null Dependencies (Uninitialized State)", "[servic
         HegemonikonGenerationParams gen_params;
         REQUIRE(service.process_prompt("test", gen_params) == "[Error: Llama model not loaded]");
         
-        std::string error_message;
+        std::string streamed;
         bool success = service.stream_prompt("test", gen_params, [&](const std::string& token){
-            error_message = token;
+            streamed += token;
             return true;
         });
         REQUIRE(success == false);
+        REQUIRE(streamed.empty());
+
+        std::string error_message;
+        success = service.stream_prompt("test", gen_params, [&](const std::string& token){
+            streamed += token;
+            return true;
+        }, nullptr, error_message);
+        REQUIRE(success == false);
+        REQUIRE(streamed.empty());
         REQUIRE(error_message == "[Error: Llama model not loaded]");
 
+        auto stream = service.open_prompt_stream("test", gen_params);
+        std::string piece;
+        REQUIRE_FALSE(stream->next(piece));
+        REQUIRE_FALSE(stream->succeeded());
+        REQUIRE(stream->error() == "[Error: Llama model not loaded]");
+
         HegemonikonWhisperGenerationParams whisper_params;
         REQUIRE(service.transcribe_audio_pcm({}, whisper_params) == "[Error: Whisper model not loaded]");
     }
@@ -148,4 +223,59 @@ TEST_CASE("CoreAIService with Null Dependencies (Uninitialized State)", "[servic
         REQUIRE_NOTHROW(service.unload_llama_model());
         REQUIRE_NOTHROW(service.unload_whisper_model());
     }
-}
\ No newline at end of file
+}
+
+TEST_CASE("CoreAIService runs background model loads in order", "[service][unit]") {
+    int n_loads = 0;
+    LoadGate gate;
+    CoreAIService service(std::make_unique<GatedLlamaInterface>(gate.future, &n_loads), nullptr);
+    const LoadGate::Opener opener{gate};
+
+    HegemonikonLlamaModelParams first_params;
+    first_params.model_path = "first.gguf";
+    auto first = service.initialize_llama_model_async(first_params);
+
+    // The second model has no spare interface left and would fail at once, but only
+    // after the first load is done.
+    HegemonikonLlamaModelParams second_params;
+    second_params.model_path = "";
+    auto second = service.initialize_llama_model_async(second_params);
+    REQUIRE_FALSE(second->wait(50.0));
+    REQUIRE_FALSE(first->is_done());
+
+    gate.release();
+    REQUIRE(second->wait(5000.0));
+    REQUIRE(first->is_done());
+    REQUIRE(first->succeeded());
+    REQUIRE(second->state() == LlamaLoadState::Failed);
+    REQUIRE(n_loads == 1);
+
+    // A failed background load leaves the previous model active.
+    REQUIRE(service.is_llama_model_loaded());
+}
+
+TEST_CASE("CoreAIService skips a background load cancelled before it starts", "[service][unit]") {
+    int n_loads = 0;
+    LoadGate gate;
+    CoreAIService service(std::make_unique<GatedLlamaInterface>(gate.future, &n_loads), nullptr);
+    const LoadGate::Opener opener{gate};
+
+    HegemonikonLlamaModelParams first_params;
+    first_params.model_path = "first.gguf";
+    auto first = service.initialize_llama_model_async(first_params);
+
+    HegemonikonLlamaModelParams second_params;
+    second_params.model_path = "second.gguf";
+    auto second = service.initialize_llama_model_async(second_params);
+    second->cancel();
+    REQUIRE(second->state() == LlamaLoadState::Pending);
+
+    gate.release();
+    REQUIRE(second->wait(5000.0));
+    REQUIRE(first->succeeded());
+    REQUIRE(second->state() == LlamaLoadState::Cancelled);
+    REQUIRE(second->error() == "Load cancelled");
+    REQUIRE(n_loads == 1);
+    REQUIRE(service.is_llama_model_loaded());
+    REQUIRE_FALSE(service.is_llama_model_resident(second_params));
+}
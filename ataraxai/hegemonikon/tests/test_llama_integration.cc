@@ -1,8 +1,14 @@
 #include <catch2/catch_test_macros.hpp>
+#include <algorithm>
+#include <cmath>
 #include <filesystem>
 #include <iostream>
+#include <thread>
 
+#include "llama_batch_scheduler.hh"
+#include "llama_context_pool.hh"
 #include "llama_interface.hh"
+#include "llama_microbench.hh"
 
 const std::string REAL_LLAMA_MODEL_PATH = TEST_LLAMA_MODEL_PATH;
 
@@ -24,3 +30,350 @@ TEST_CASE("LlamaInterface can load and use a real GGUF model", "[integration][ll
     llama_service.unload_model();
     REQUIRE(llama_service.is_model_loaded() == false);
 }
+
+TEST_CASE("LlamaInterface shifts a full context instead of stopping", "[integration][llama]") {
+    if (!std::filesystem::exists(REAL_LLAMA_MODEL_PATH)) {
+        WARN("SKIPPING Llama context shift test: Model file not found at " << REAL_LLAMA_MODEL_PATH);
+        return;
+    }
+
+    LlamaInterface llama_service;
+    HegemonikonLlamaModelParams params;
+    params.model_path = REAL_LLAMA_MODEL_PATH;
+    params.n_ctx = 256;
+    params.prefix_cache_slots = 0;
+    params.set_cache_types("q8_0", "f16");
+    REQUIRE(llama_service.load_model(params) == true);
+
+    HegemonikonGenerationParams gen_params;
+    gen_params.n_predict = 400;
+    gen_params.set_context_shift(true, 8);
+
+    std::string long_prompt;
+    for (int i = 0; i < 100; ++i) {
+        long_prompt += "The quick brown fox jumps over the lazy dog. ";
+    }
+    HegemonikonGenerationResult result = llama_service.run_generation(long_prompt, gen_params);
+    REQUIRE(result.success);
+    REQUIRE(result.discarded_tokens > 0);
+    REQUIRE(result.prompt_tokens < params.n_ctx);
+}
+
+TEST_CASE("LlamaInterface embeds a batch of texts with mean pooling", "[integration][llama]") {
+    if (!std::filesystem::exists(REAL_LLAMA_MODEL_PATH)) {
+        WARN("SKIPPING Llama embedding test: Model file not found at " << REAL_LLAMA_MODEL_PATH);
+        return;
+    }
+
+    LlamaInterface llama_service;
+    HegemonikonLlamaModelParams params;
+    params.model_path = REAL_LLAMA_MODEL_PATH;
+    params.n_ctx = 512;
+    params.n_seq_max = 8;
+    params.set_embeddings(true, "mean");
+    REQUIRE(llama_service.load_model(params) == true);
+    REQUIRE(llama_service.get_embedding_size() > 0);
+    REQUIRE(llama_service.start_sequence("Hello", HegemonikonGenerationParams())->result.text == "[Error: Model loaded for embeddings]");
+
+    const std::vector<std::string_view> texts = {"The cat sat on the mat.", "A dog ran in the park.", "The cat sat on the mat."};
+    HegemonikonEmbeddingBatch batch = llama_service.embed_batch(texts, true);
+    REQUIRE(batch.size() == texts.size());
+    REQUIRE(batch.n_failed == 0);
+
+    const size_t n_embd = static_cast<size_t>(batch.n_embd);
+    double norm = 0.0;
+    double max_diff = 0.0;
+    for (size_t j = 0; j < n_embd; ++j) {
+        norm += batch.data[j] * batch.data[j];
+        max_diff = std::max(max_diff, static_cast<double>(std::abs(batch.data[j] - batch.data[2 * n_embd + j])));
+    }
+    REQUIRE(std::abs(norm - 1.0) < 1e-3);
+    REQUIRE(max_diff < 1e-3);
+
+    std::vector<float> single = llama_service.get_embeddings(std::string(texts[1]));
+    REQUIRE(single.size() == n_embd);
+}
+
+TEST_CASE("LlamaBatchScheduler preempts background work for interactive requests", "[integration][llama]") {
+    if (!std::filesystem::exists(REAL_LLAMA_MODEL_PATH)) {
+        WARN("SKIPPING Llama scheduler priority test: Model file not found at " << REAL_LLAMA_MODEL_PATH);
+        return;
+    }
+
+    LlamaInterface llama_service;
+    HegemonikonLlamaModelParams params;
+    params.model_path = REAL_LLAMA_MODEL_PATH;
+    params.n_seq_max = 1;
+    params.prefix_cache_slots = 0;
+    REQUIRE(llama_service.load_model(params) == true);
+
+    LlamaBatchScheduler scheduler(llama_service);
+    HegemonikonGenerationParams background_params;
+    background_params.n_predict = 64;
+    background_params.set_priority(LlamaRequestPriority::Background);
+    auto background = scheduler.submit("Summarize the history of the printing press.", background_params);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    HegemonikonGenerationParams interactive_params;
+    interactive_params.n_predict = 8;
+    auto interactive = scheduler.submit("Hello, how are you?", interactive_params);
+
+    const HegemonikonGenerationResult interactive_result = interactive.get();
+    const HegemonikonGenerationResult background_result = background.get();
+    REQUIRE(interactive_result.success);
+    REQUIRE(background_result.success);
+
+    const HegemonikonSchedulerStats stats = scheduler.get_stats();
+    REQUIRE(stats.interactive.requests_admitted == 1);
+    REQUIRE(stats.background.requests_admitted == 1);
+    REQUIRE(stats.preemptions == stats.resumptions);
+}
+
+TEST_CASE("LlamaContextPool runs requests in parallel on shared weights", "[integration][llama]") {
+    if (!std::filesystem::exists(REAL_LLAMA_MODEL_PATH)) {
+        WARN("SKIPPING Llama context pool test: Model file not found at " << REAL_LLAMA_MODEL_PATH);
+        return;
+    }
+
+    auto primary = std::make_shared<LlamaInterface>();
+    HegemonikonLlamaModelParams params;
+    params.model_path = REAL_LLAMA_MODEL_PATH;
+    params.n_ctx = 1024;
+    REQUIRE(primary->load_model(params) == true);
+
+    LlamaContextPool pool(primary, 2, 512);
+    REQUIRE(pool.size() == 2);
+    REQUIRE(pool.contexts()[1]->get_context_size() == 512);
+
+    HegemonikonGenerationParams gen_params;
+    gen_params.n_predict = 8;
+    gen_params.session_id = "pool-chat";
+    HegemonikonGenerationResult first;
+    HegemonikonGenerationResult second;
+    {
+        LlamaContextLease a = pool.acquire(gen_params.session_id);
+        LlamaContextLease b = pool.acquire();
+        REQUIRE(a.index() != b.index());
+        REQUIRE_FALSE(pool.try_acquire());
+
+        std::thread worker([&]() { second = b->run_generation("Name a color.", HegemonikonGenerationParams()); });
+        first = a->run_generation("Hello, how are you?", gen_params);
+        worker.join();
+    }
+    REQUIRE(first.success);
+    REQUIRE(second.success);
+
+    // The follow-up of the session goes back to the context holding its history.
+    LlamaContextLease again = pool.acquire(gen_params.session_id);
+    REQUIRE(again->has_session(gen_params.session_id));
+    again.release();
+
+    const HegemonikonContextPoolStats stats = pool.get_stats();
+    REQUIRE(stats.leases == 3);
+    REQUIRE(stats.session_hits == 1);
+    REQUIRE(stats.contexts_leased == 0);
+}
+
+TEST_CASE("LlamaInterface prefills a growing prompt ahead of its generation", "[integration][llama]") {
+    if (!std::filesystem::exists(REAL_LLAMA_MODEL_PATH)) {
+        WARN("SKIPPING Llama prefill test: Model file not found at " << REAL_LLAMA_MODEL_PATH);
+        return;
+    }
+
+    LlamaInterface llama_service;
+    HegemonikonLlamaModelParams params;
+    params.model_path = REAL_LLAMA_MODEL_PATH;
+    params.n_ctx = 512;
+    REQUIRE(llama_service.load_model(params) == true);
+
+    HegemonikonGenerationParams gen_params;
+    gen_params.n_predict = 8;
+    gen_params.session_id = "recording";
+    REQUIRE(llama_service.prefill_session("", HegemonikonGenerationParams()) == -1);
+
+    const std::string transcript = "Transcript: the meeting starts at nine. We review the budget. The launch moves to May.";
+    const int32_t n_first = llama_service.prefill_session(transcript.substr(0, 40), gen_params, 4);
+    const int32_t n_second = llama_service.prefill_session(transcript, gen_params, 4);
+    REQUIRE(n_first > 0);
+    REQUIRE(n_second > n_first);
+
+    HegemonikonGenerationResult result = llama_service.run_generation(transcript + "\nSummary:", gen_params);
+    REQUIRE(result.success);
+    REQUIRE(result.reused_tokens >= n_second - 4);
+}
+
+TEST_CASE("LlamaInterface records the phases of a generation in its metrics", "[integration][llama]") {
+    if (!std::filesystem::exists(REAL_LLAMA_MODEL_PATH)) {
+        WARN("SKIPPING Llama metrics test: Model file not found at " << REAL_LLAMA_MODEL_PATH);
+        return;
+    }
+
+    auto metrics = std::make_shared<MetricsRegistry>();
+    LlamaInterface llama_service;
+    llama_service.set_metrics(metrics);
+    HegemonikonLlamaModelParams params;
+    params.model_path = REAL_LLAMA_MODEL_PATH;
+    REQUIRE(llama_service.load_model(params) == true);
+
+    HegemonikonGenerationParams gen_params;
+    gen_params.n_predict = 16;
+    HegemonikonGenerationResult result = llama_service.run_generation("The capital of France is", gen_params);
+    REQUIRE(result.success);
+
+    const HegemonikonMetricsSnapshot snapshot = metrics->snapshot();
+    REQUIRE(snapshot.requests == 1);
+    REQUIRE(snapshot.generated_tokens == static_cast<uint64_t>(result.tokens_generated));
+    REQUIRE(snapshot.prompt_tokens == static_cast<uint64_t>(result.prompt_tokens));
+    REQUIRE(snapshot.find("tokenize")->count == 1);
+    REQUIRE(snapshot.find("prefill")->count >= 1);
+    REQUIRE(snapshot.find("time_to_first_token")->count == 1);
+    REQUIRE(snapshot.find("sample")->count >= static_cast<uint64_t>(result.tokens_generated));
+    if (result.tokens_generated > 1) {
+        REQUIRE(snapshot.find("inter_token")->count >= 1);
+        REQUIRE(snapshot.find("decode")->count >= 1);
+    }
+    REQUIRE(snapshot.find("generation")->count == 1);
+}
+
+TEST_CASE("LlamaMicrobench measures prefill, decode and sampling", "[integration][llama]") {
+    if (!std::filesystem::exists(REAL_LLAMA_MODEL_PATH)) {
+        WARN("SKIPPING Llama microbenchmark test: Model file not found at " << REAL_LLAMA_MODEL_PATH);
+        return;
+    }
+
+    HegemonikonMicrobenchParams params;
+    params.model_params.model_path = REAL_LLAMA_MODEL_PATH;
+    params.prompt_lengths = {64};
+    params.n_generate = 8;
+    params.depths = {0, 128};
+    params.repetitions = 1;
+    params.sampler_iterations = 10;
+
+    const HegemonikonMicrobenchReport report = LlamaMicrobench::run(params);
+    REQUIRE(report.success);
+    REQUIRE(report.samples.size() == 5);
+    REQUIRE(report.samples[0].test == "pp64");
+    REQUIRE(report.samples[1].test == "tg8@d0");
+    REQUIRE(report.samples[2].test == "tg8@d128");
+    REQUIRE(report.samples[3].test == "sampler_greedy");
+    REQUIRE(report.samples[4].test == "sampler_chain");
+    for (const HegemonikonMicrobenchSample &sample : report.samples) {
+        REQUIRE(sample.samples_ms.size() == 1);
+        REQUIRE(sample.tokens_per_second > 0.0);
+    }
+}
+
+TEST_CASE("LlamaInterface verifies prompt-lookup drafts and reports their acceptance", "[integration][llama]") {
+    if (!std::filesystem::exists(REAL_LLAMA_MODEL_PATH)) {
+        WARN("SKIPPING Llama prompt lookup test: Model file not found at " << REAL_LLAMA_MODEL_PATH);
+        return;
+    }
+
+    auto metrics = std::make_shared<MetricsRegistry>();
+    LlamaInterface llama_service;
+    llama_service.set_metrics(metrics);
+    HegemonikonLlamaModelParams params;
+    params.model_path = REAL_LLAMA_MODEL_PATH;
+    params.prefix_cache_slots = 0;
+    REQUIRE(llama_service.load_model(params) == true);
+
+    const std::string prompt =
+        "Context: The Eiffel Tower was completed in 1889 for the World's Fair in Paris.\n"
+        "Question: Repeat the context word for word.\nAnswer: The Eiffel Tower";
+
+    HegemonikonGenerationParams gen_params;
+    gen_params.n_predict = 24;
+    gen_params.temperature = 0.0f;
+    gen_params.repeat_penalty = 1.0f;
+    HegemonikonGenerationResult baseline = llama_service.run_generation(prompt, gen_params);
+    REQUIRE(baseline.success);
+    REQUIRE(baseline.lookup_draft_tokens == 0);
+
+    gen_params.set_prompt_lookup(true, 8, 1, 3);
+    HegemonikonGenerationResult looked_up = llama_service.run_generation(prompt, gen_params);
+    REQUIRE(looked_up.success);
+    REQUIRE(looked_up.tokens_generated > 0);
+    REQUIRE(looked_up.accepted_lookup_tokens <= looked_up.lookup_draft_tokens);
+
+    const HegemonikonMetricsSnapshot snapshot = metrics->snapshot();
+    REQUIRE(snapshot.lookup_drafted_tokens == static_cast<uint64_t>(looked_up.lookup_draft_tokens));
+    REQUIRE(snapshot.lookup_accepted_tokens == static_cast<uint64_t>(looked_up.accepted_lookup_tokens));
+}
+
+TEST_CASE("LlamaInterface speculative decoding keeps the greedy output", "[integration][llama]") {
+    if (!std::filesystem::exists(REAL_LLAMA_MODEL_PATH)) {
+        WARN("SKIPPING Llama speculative decoding test: Model file not found at " << REAL_LLAMA_MODEL_PATH);
+        return;
+    }
+
+    HegemonikonLlamaModelParams params;
+    params.model_path = REAL_LLAMA_MODEL_PATH;
+    params.prefix_cache_slots = 0;
+
+    LlamaInterface plain;
+    REQUIRE(plain.load_model(params) == true);
+
+    // The model drafting for itself agrees with itself, so drafts must be accepted.
+    LlamaInterface speculative;
+    params.set_draft_model_path(REAL_LLAMA_MODEL_PATH);
+    REQUIRE(speculative.load_model(params) == true);
+    REQUIRE(speculative.has_draft_model());
+
+    HegemonikonGenerationParams gen_params;
+    gen_params.n_predict = 32;
+    gen_params.temperature = 0.0f;
+    gen_params.repeat_penalty = 1.0f;
+    gen_params.set_n_draft(4);
+
+    const std::string prompt = "The capital of France is";
+    HegemonikonGenerationResult baseline = plain.run_generation(prompt, gen_params);
+    REQUIRE(baseline.success);
+    REQUIRE(baseline.draft_tokens == 0);
+
+    speculative.reset_speculative_stats();
+    HegemonikonGenerationResult drafted = speculative.run_generation(prompt, gen_params);
+    REQUIRE(drafted.success);
+    REQUIRE(drafted.text == baseline.text);
+    REQUIRE(drafted.tokens_generated == baseline.tokens_generated);
+    REQUIRE(drafted.accepted_draft_tokens > 0);
+    REQUIRE(drafted.accepted_draft_tokens <= drafted.draft_tokens);
+
+    const HegemonikonSpeculativeStats stats = speculative.get_speculative_stats();
+    REQUIRE(stats.verify_steps > 0);
+    REQUIRE(stats.drafted_tokens == static_cast<uint64_t>(drafted.draft_tokens));
+    REQUIRE(stats.accepted_tokens == static_cast<uint64_t>(drafted.accepted_draft_tokens));
+
+    // The draft KV left by the first request must be resynced to the new prompt.
+    const std::string other_prompt = "The capital of Italy is";
+    HegemonikonGenerationResult other_baseline = plain.run_generation(other_prompt, gen_params);
+    HegemonikonGenerationResult other_drafted = speculative.run_generation(other_prompt, gen_params);
+    REQUIRE(other_drafted.success);
+    REQUIRE(other_drafted.text == other_baseline.text);
+    REQUIRE(speculative.get_speculative_stats().drafted_tokens ==
+            static_cast<uint64_t>(drafted.draft_tokens + other_drafted.draft_tokens));
+
+    // Shifting a full context trims the draft sequence along with the main one.
+    params.n_ctx = 256;
+    LlamaInterface plain_shift;
+    params.set_draft_model_path("");
+    REQUIRE(plain_shift.load_model(params) == true);
+    LlamaInterface speculative_shift;
+    params.set_draft_model_path(REAL_LLAMA_MODEL_PATH);
+    REQUIRE(speculative_shift.load_model(params) == true);
+
+    std::string long_prompt;
+    for (int i = 0; i < 20; ++i) {
+        long_prompt += "The quick brown fox jumps over the lazy dog. ";
+    }
+    gen_params.n_predict = 300;
+    gen_params.set_context_shift(true, 8);
+    HegemonikonGenerationResult shifted_baseline = plain_shift.run_generation(long_prompt, gen_params);
+    REQUIRE(shifted_baseline.success);
+    REQUIRE(shifted_baseline.discarded_tokens > 0);
+
+    HegemonikonGenerationResult shifted = speculative_shift.run_generation(long_prompt, gen_params);
+    REQUIRE(shifted.success);
+    REQUIRE(shifted.discarded_tokens > 0);
+    REQUIRE(shifted.text == shifted_baseline.text);
+    REQUIRE(shifted.accepted_draft_tokens > 0);
+}
@@ -0,0 +1,133 @@
+#include <catch2/catch_test_macros.hpp>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "core_ai_service.hh"
+#include "llama_load_benchmarker.hh"
+
+class LoadMockLlamaInterface : public LlamaInterface
+{
+public:
+    bool load_model(const HegemonikonLlamaModelParams &) override
+    {
+        return true;
+    }
+
+    void unload_model() override {}
+
+    HegemonikonGenerationResult run_generation(const std::string &, const HegemonikonGenerationParams &params,
+                                               llama_token_callback on_piece,
+                                               std::shared_ptr<LlamaRequestHandle>) override
+    {
+        HegemonikonGenerationResult result;
+        result.success = true;
+        for (int32_t i = 0; i < params.n_predict; ++i)
+        {
+            result.text += "piece";
+            ++result.tokens_generated;
+            if (on_piece && !on_piece("piece"))
+            {
+                break;
+            }
+        }
+        return result;
+    }
+};
+
+static HegemonikonLoadProfile make_mock_profile()
+{
+    HegemonikonLoadProfile profile;
+    profile.concurrency_levels = {1, 3};
+    profile.requests_per_client = 2;
+    profile.min_prompt_tokens = 8;
+    profile.max_prompt_tokens = 8;
+    profile.min_output_tokens = 4;
+    profile.max_output_tokens = 6;
+    profile.use_scheduler = false;
+    profile.prompts = {"A short prompt."};
+    return profile;
+}
+
+TEST_CASE("HegemonikonLatencyPercentiles uses nearest-rank percentiles", "[load][unit]")
+{
+    const HegemonikonLatencyPercentiles empty = HegemonikonLatencyPercentiles::from_samples({});
+    REQUIRE(empty.count == 0);
+    REQUIRE(empty.p99_ms == 0.0);
+
+    std::vector<double> samples;
+    for (int i = 100; i >= 1; --i)
+    {
+        samples.push_back(static_cast<double>(i));
+    }
+    const HegemonikonLatencyPercentiles percentiles = HegemonikonLatencyPercentiles::from_samples(samples);
+    REQUIRE(percentiles.count == 100);
+    REQUIRE(std::abs(percentiles.mean_ms - 50.5) < 1e-9);
+    REQUIRE(percentiles.p50_ms == 51.0);
+    REQUIRE(percentiles.p95_ms == 95.0);
+    REQUIRE(percentiles.p99_ms == 99.0);
+    REQUIRE(percentiles.max_ms == 100.0);
+}
+
+TEST_CASE("LlamaLoadBenchmarker rejects runs without a model or with an invalid profile", "[load][unit]")
+{
+    CoreAIService unloaded;
+    LlamaLoadBenchmarker no_model(unloaded);
+    HegemonikonLoadBenchmarkResult result = no_model.run(HegemonikonLoadProfile());
+    CHECK_FALSE(result.success);
+    REQUIRE(result.errorMessage == "No Llama model loaded");
+
+    CoreAIService service(std::make_unique<LoadMockLlamaInterface>(), nullptr);
+    REQUIRE(service.initialize_llama_model(HegemonikonLlamaModelParams()));
+    LlamaLoadBenchmarker benchmarker(service);
+    HegemonikonLoadProfile profile = make_mock_profile();
+    profile.max_output_tokens = 1;
+    result = benchmarker.run(profile);
+    CHECK_FALSE(result.success);
+    REQUIRE(result.errorMessage.rfind("Invalid load profile", 0) == 0);
+}
+
+TEST_CASE("LlamaLoadBenchmarker reports every concurrency level", "[load][unit]")
+{
+    CoreAIService service(std::make_unique<LoadMockLlamaInterface>(), nullptr);
+    REQUIRE(service.initialize_llama_model(HegemonikonLlamaModelParams()));
+    LlamaLoadBenchmarker benchmarker(service);
+
+    SECTION("closed loop")
+    {
+        const HegemonikonLoadBenchmarkResult result = benchmarker.run(make_mock_profile());
+        REQUIRE(result.success);
+        REQUIRE(result.levels.size() == 2);
+        REQUIRE(result.levels[0].concurrency == 1);
+        REQUIRE(result.levels[0].requests == 2);
+        REQUIRE(result.levels[1].concurrency == 3);
+        REQUIRE(result.levels[1].requests == 6);
+        for (const HegemonikonLoadLevelResult &level : result.levels)
+        {
+            REQUIRE(level.failed_requests == 0);
+            REQUIRE(level.generated_tokens >= 4 * level.requests);
+            REQUIRE(level.generated_tokens <= 6 * level.requests);
+            REQUIRE(level.ttft.count == level.requests);
+            REQUIRE(level.inter_token.count == level.generated_tokens - level.requests);
+            REQUIRE(level.end_to_end.count == level.requests);
+            REQUIRE(level.peak_memory_mb >= level.start_memory_mb);
+        }
+
+        const std::string csv = result.to_csv();
+        REQUIRE(csv.rfind("concurrency,requests,failed_requests,", 0) == 0);
+        REQUIRE(csv.find("\n1,2,0,") != std::string::npos);
+        REQUIRE(csv.find("\n3,6,0,") != std::string::npos);
+    }
+
+    SECTION("open loop")
+    {
+        HegemonikonLoadProfile profile = make_mock_profile();
+        profile.arrival_rate = 200.0;
+        const HegemonikonLoadBenchmarkResult result = benchmarker.run(profile);
+        REQUIRE(result.success);
+        REQUIRE(result.levels.size() == 2);
+        REQUIRE(result.levels[1].requests == 6);
+        REQUIRE(result.levels[1].failed_requests == 0);
+    }
+}
@@ -0,0 +1,48 @@
+#include <catch2/catch_test_macros.hpp>
+#include <cmath>
+#include <string>
+
+#include "json.hpp"
+#include "llama_microbench.hh"
+
+TEST_CASE("HegemonikonMicrobenchSample reports the throughput of its samples", "[microbench][unit]")
+{
+    HegemonikonMicrobenchSample sample;
+    sample.test = "pp512";
+    sample.n_tokens = 512;
+    sample.samples_ms = {100.0, 200.0};
+    sample.calculate_statistics();
+
+    REQUIRE(std::abs(sample.avg_ms - 150.0) < 1e-9);
+    REQUIRE(std::abs(sample.stdev_ms - std::sqrt(5000.0)) < 1e-6);
+    REQUIRE(std::abs(sample.tokens_per_second - (5120.0 + 2560.0) / 2.0) < 1e-6);
+    REQUIRE(sample.stdev_tokens_per_second > 0.0);
+}
+
+TEST_CASE("LlamaMicrobench reports invalid parameters and missing models", "[microbench][unit]")
+{
+    HegemonikonMicrobenchParams params;
+    params.model_params.model_path = "/nonexistent/model.gguf";
+    params.repetitions = 0;
+    HegemonikonMicrobenchReport report = LlamaMicrobench::run(params);
+    CHECK_FALSE(report.success);
+    REQUIRE(report.errorMessage.rfind("Invalid microbenchmark parameters", 0) == 0);
+
+    params.repetitions = 1;
+    params.model_params.cache_type_v = "f7";
+    report = LlamaMicrobench::run(params);
+    CHECK_FALSE(report.success);
+    REQUIRE(report.errorMessage.rfind("Invalid model parameters", 0) == 0);
+
+    params.model_params.cache_type_v = "f16";
+    report = LlamaMicrobench::run(params);
+    CHECK_FALSE(report.success);
+    REQUIRE(report.errorMessage == "Unable to load model from /nonexistent/model.gguf");
+
+    const nlohmann::json document = nlohmann::json::parse(report.to_json());
+    REQUIRE(document["benchmark"] == "llama_microbench");
+    REQUIRE(document["success"] == false);
+    REQUIRE(document["model"]["path"] == "/nonexistent/model.gguf");
+    REQUIRE_FALSE(document["llama_cpp_version"].get<std::string>().empty());
+    REQUIRE(document["results"].empty());
+}
@@ -0,0 +1,97 @@
+#include <catch2/catch_test_macros.hpp>
+#include <memory>
+#include <string>
+
+#include "llama_model_registry.hh"
+
+class FootprintLlamaInterface : public LlamaInterface
+{
+public:
+    explicit FootprintLlamaInterface(int *n_loads) : n_loads_(n_loads) {}
+
+    bool load_model(const HegemonikonLlamaModelParams &params) override
+    {
+        ++*n_loads_;
+        loaded_ = true;
+        ram_bytes_ = static_cast<uint64_t>(params.n_ctx);
+        return true;
+    }
+
+    void unload_model() override { loaded_ = false; }
+
+    HegemonikonModelFootprint get_memory_footprint() const override
+    {
+        HegemonikonModelFootprint footprint;
+        footprint.ram_bytes = loaded_ ? ram_bytes_ : 0;
+        return footprint;
+    }
+
+private:
+    int *n_loads_;
+    bool loaded_ = false;
+    uint64_t ram_bytes_ = 0;
+};
+
+static HegemonikonLlamaModelParams model_params(const std::string &path, int32_t footprint)
+{
+    HegemonikonLlamaModelParams params;
+    params.model_path = path;
+    params.n_ctx = footprint;
+    return params;
+}
+
+TEST_CASE("LlamaModelRegistry keeps models resident and evicts the least recently used", "[model_registry][unit]")
+{
+    int n_loads = 0;
+    LlamaModelRegistry registry([&n_loads]()
+                                { return std::make_shared<FootprintLlamaInterface>(&n_loads); });
+    registry.set_budget(2048, 0);
+
+    const auto chat = model_params("chat.gguf", 1024);
+    const auto code = model_params("code.gguf", 1024);
+    const auto vision = model_params("vision.gguf", 1024);
+
+    REQUIRE(registry.acquire(chat) != nullptr);
+    REQUIRE(registry.acquire(code) != nullptr);
+    REQUIRE(registry.acquire(chat) != nullptr);
+    REQUIRE(n_loads == 2);
+
+    REQUIRE(registry.acquire(vision) != nullptr);
+    REQUIRE(n_loads == 3);
+    REQUIRE(registry.contains(chat));
+    REQUIRE_FALSE(registry.contains(code));
+
+    const HegemonikonModelRegistryStats stats = registry.get_stats();
+    REQUIRE(stats.resident_models == 2);
+    REQUIRE(stats.ram_bytes == 2048);
+    REQUIRE(stats.hits == 1);
+    REQUIRE(stats.misses == 3);
+    REQUIRE(stats.evictions == 1);
+}
+
+TEST_CASE("LlamaModelRegistry never evicts pinned or in-use models", "[model_registry][unit]")
+{
+    int n_loads = 0;
+    LlamaModelRegistry registry([&n_loads]()
+                                { return std::make_shared<FootprintLlamaInterface>(&n_loads); });
+    registry.set_budget(2048, 0);
+
+    const auto chat = model_params("chat.gguf", 1024);
+    const auto code = model_params("code.gguf", 1024);
+    const auto vision = model_params("vision.gguf", 1024);
+
+    REQUIRE(registry.acquire(chat) != nullptr);
+    REQUIRE(registry.set_pinned(chat, true));
+    std::shared_ptr<LlamaInterface> in_flight = registry.acquire(code);
+    REQUIRE(in_flight != nullptr);
+
+    REQUIRE_FALSE(registry.evict(code));
+    registry.acquire(vision);
+    REQUIRE(registry.contains(chat));
+    REQUIRE(registry.contains(code));
+    REQUIRE(registry.get_stats().models_in_use == 1);
+
+    in_flight.reset();
+    REQUIRE(registry.evict(code));
+    REQUIRE_FALSE(registry.contains(code));
+}
@@ -0,0 +1,89 @@
+#include <catch2/catch_test_macros.hpp>
+#include <vector>
+#include "llama_ngram_lookup.hh"
+
+TEST_CASE("LlamaNgramLookup proposes what followed an earlier occurrence", "[ngram_lookup][unit]")
+{
+    LlamaNgramLookup lookup(2, 3);
+    lookup.sync({1, 2, 3, 4, 5, 6, 7, 9, 2, 3});
+
+    std::vector<llama_token> drafted;
+    REQUIRE(lookup.draft(3, drafted) == 3);
+    REQUIRE(drafted == std::vector<llama_token>{4, 5, 6});
+
+    REQUIRE(lookup.draft(100, drafted) == 7);
+    REQUIRE(drafted == std::vector<llama_token>{4, 5, 6, 7, 9, 2, 3});
+}
+
+TEST_CASE("LlamaNgramLookup prefers the longest and latest match", "[ngram_lookup][unit]")
+{
+    LlamaNgramLookup lookup(1, 3);
+    // "1 2 3" is followed by 20, while the latest "2 3" is followed by 30
+    lookup.sync({2, 3, 10, 1, 2, 3, 20, 8, 2, 3, 30, 1, 2, 3});
+
+    std::vector<llama_token> drafted;
+    REQUIRE(lookup.draft(1, drafted) == 1);
+    REQUIRE(drafted.front() == 20);
+
+    // Now the latest "2 3" is the one that ended the sequence before
+    lookup.push(5);
+    lookup.push(2);
+    lookup.push(3);
+    REQUIRE(lookup.draft(1, drafted) == 1);
+    REQUIRE(drafted.front() == 5);
+}
+
+TEST_CASE("LlamaNgramLookup needs ngram_min matching tokens", "[ngram_lookup][unit]")
+{
+    LlamaNgramLookup lookup(2, 4);
+    lookup.sync({1, 2, 3, 4, 9, 3});
+
+    std::vector<llama_token> drafted;
+    REQUIRE(lookup.draft(4, drafted) == 0);
+    REQUIRE(drafted.empty());
+
+    // The trailing n-gram never matches itself
+    LlamaNgramLookup fresh(1, 1);
+    fresh.push(7);
+    REQUIRE(fresh.draft(4, drafted) == 0);
+    fresh.push(7);
+    REQUIRE(fresh.draft(4, drafted) == 1);
+    REQUIRE(drafted.front() == 7);
+}
+
+TEST_CASE("LlamaNgramLookup rebuilds when the tokens are rewritten", "[ngram_lookup][unit]")
+{
+    LlamaNgramLookup lookup(2, 2);
+    lookup.sync({1, 2, 3, 4, 1, 2});
+    REQUIRE(lookup.size() == 6);
+
+    std::vector<llama_token> drafted;
+    REQUIRE(lookup.draft(1, drafted) == 1);
+    REQUIRE(drafted.front() == 3);
+
+    // Appended tokens are indexed incrementally
+    lookup.sync({1, 2, 3, 4, 1, 2, 5, 3, 4});
+    REQUIRE(lookup.size() == 9);
+    REQUIRE(lookup.draft(2, drafted) == 2);
+    REQUIRE(drafted == std::vector<llama_token>{1, 2});
+
+    // A context shift drops tokens from the middle: the old "3 4 -> 1" is forgotten
+    lookup.sync({1, 2, 5, 3, 4});
+    REQUIRE(lookup.size() == 5);
+    REQUIRE(lookup.draft(2, drafted) == 0);
+
+    lookup.reset();
+    REQUIRE(lookup.size() == 0);
+    REQUIRE(lookup.draft(2, drafted) == 0);
+}
+
+TEST_CASE("LlamaNgramLookup clamps its n-gram lengths", "[ngram_lookup][unit]")
+{
+    LlamaNgramLookup lookup(0, 100);
+    REQUIRE(lookup.ngram_min() == 1);
+    REQUIRE(lookup.ngram_max() == LlamaNgramLookup::MAX_NGRAM);
+
+    lookup.configure(5, 3);
+    REQUIRE(lookup.ngram_min() == 5);
+    REQUIRE(lookup.ngram_max() == 5);
+}
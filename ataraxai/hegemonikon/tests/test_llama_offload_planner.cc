@@ -0,0 +1,78 @@
+#include <catch2/catch_test_macros.hpp>
+#include <vector>
+
+#include "llama_offload_planner.hh"
+
+static constexpr uint64_t MiB = 1024ull * 1024;
+
+static HegemonikonGgufModelInfo small_model()
+{
+    HegemonikonGgufModelInfo info;
+    info.architecture = "llama";
+    info.n_layer = 10;
+    info.n_embd = 256;
+    info.n_head = 8;
+    info.n_head_kv = 8;
+    info.n_embd_head_k = 32;
+    info.n_embd_head_v = 32;
+    info.n_vocab = 1000;
+    info.layer_bytes.assign(10, 100 * MiB);
+    info.input_bytes = 50 * MiB;
+    info.output_bytes = 50 * MiB;
+    return info;
+}
+
+static HegemonikonGpuDevice device(const char *name, uint64_t free_bytes)
+{
+    HegemonikonGpuDevice gpu;
+    gpu.name = name;
+    gpu.free_bytes = free_bytes;
+    gpu.total_bytes = free_bytes;
+    return gpu;
+}
+
+TEST_CASE("LlamaOffloadPlanner fits layers into the free device memory", "[offload_planner][unit]")
+{
+    const HegemonikonGgufModelInfo info = small_model();
+    HegemonikonLlamaModelParams params;
+    params.n_ctx = 512;
+
+    SECTION("No device keeps the model on CPU")
+    {
+        const HegemonikonOffloadPlan plan = LlamaOffloadPlanner::plan(info, params, {}, 0);
+        REQUIRE(plan.n_gpu_layers == 0);
+        REQUIRE(plan.host_bytes >= plan.weights_bytes);
+    }
+
+    SECTION("A large device takes the whole model")
+    {
+        const HegemonikonOffloadPlan plan = LlamaOffloadPlanner::plan(info, params, {device("GPU0", 4096 * MiB)}, 0);
+        REQUIRE(plan.full_offload);
+        REQUIRE(plan.n_gpu_layers == info.n_layer + 1);
+        REQUIRE_FALSE(plan.tensor_split);
+        REQUIRE(plan.device_bytes[0] <= 4096 * MiB);
+    }
+
+    SECTION("A small device takes only the layers that fit, headroom included")
+    {
+        const HegemonikonOffloadPlan plan = LlamaOffloadPlanner::plan(info, params, {device("GPU0", 1024 * MiB)}, 512 * MiB);
+        REQUIRE(plan.n_gpu_layers > 0);
+        REQUIRE(plan.n_gpu_layers < info.n_layer);
+        REQUIRE(plan.device_bytes[0] <= 512 * MiB);
+        REQUIRE(plan.host_bytes > 0);
+    }
+
+    SECTION("Layers are split across devices only when one is not enough")
+    {
+        const HegemonikonOffloadPlan plan = LlamaOffloadPlanner::plan(
+            info, params, {device("GPU0", 700 * MiB), device("GPU1", 700 * MiB)}, 0);
+        REQUIRE(plan.tensor_split);
+        REQUIRE(plan.full_offload);
+
+        const HegemonikonOffloadPlan single = LlamaOffloadPlanner::plan(
+            info, params, {device("GPU0", 4096 * MiB), device("GPU1", 700 * MiB)}, 0);
+        REQUIRE_FALSE(single.tensor_split);
+        REQUIRE(single.main_gpu == 0);
+        REQUIRE(single.full_offload);
+    }
+}
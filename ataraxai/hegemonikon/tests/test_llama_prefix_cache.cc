@@ -0,0 +1,115 @@
+#include <catch2/catch_test_macros.hpp>
+#include <vector>
+#include "llama_prefix_cache.hh"
+
+static std::vector<llama_token> make_prompt(size_t shared, size_t unique, llama_token unique_base)
+{
+    std::vector<llama_token> tokens;
+    for (size_t i = 0; i < shared; ++i)
+        tokens.push_back(static_cast<llama_token>(i + 1));
+    for (size_t i = 0; i < unique; ++i)
+        tokens.push_back(static_cast<llama_token>(unique_base + i));
+    return tokens;
+}
+
+TEST_CASE("LlamaPrefixCache caches the prefix shared by consecutive prompts", "[prefix_cache][unit]")
+{
+    LlamaPrefixCache cache;
+    cache.configure({4, 5}, 1024, 8);
+
+    auto first = make_prompt(20, 10, 1000);
+    auto second = make_prompt(20, 10, 2000);
+
+    llama_seq_id seq = -1;
+    std::vector<llama_seq_id> evicted;
+
+    REQUIRE(cache.lookup(first, first.size() - 1).seq_id == -1);
+    REQUIRE(cache.insert(first, first.size(), seq, evicted) == 0);
+
+    REQUIRE(cache.lookup(second, second.size() - 1).seq_id == -1);
+    REQUIRE(cache.insert(second, second.size(), seq, evicted) == 16);
+    REQUIRE(seq == 4);
+    REQUIRE(evicted.empty());
+
+    auto third = make_prompt(20, 5, 3000);
+    LlamaPrefixMatch match = cache.lookup(third, third.size() - 1);
+    REQUIRE(match.seq_id == 4);
+    REQUIRE(match.n_tokens == 16);
+
+    HegemonikonPrefixCacheStats stats = cache.get_stats();
+    REQUIRE(stats.hits == 1);
+    REQUIRE(stats.misses == 2);
+    REQUIRE(stats.reused_tokens == 16);
+    REQUIRE(stats.cached_tokens == 16);
+    REQUIRE(stats.entries == 1);
+}
+
+TEST_CASE("LlamaPrefixCache does not match across differing blocks", "[prefix_cache][unit]")
+{
+    LlamaPrefixCache cache;
+    cache.configure({2}, 1024, 4);
+
+    llama_seq_id seq = -1;
+    std::vector<llama_seq_id> evicted;
+    auto a = make_prompt(12, 3, 100);
+    cache.insert(a, a.size(), seq, evicted);
+    REQUIRE(cache.insert(a, a.size(), seq, evicted) == 12);
+
+    std::vector<llama_token> other = a;
+    other[1] = 9999;
+    REQUIRE(cache.lookup(other, other.size() - 1).n_tokens == 0);
+
+    std::vector<llama_token> partial = a;
+    partial[5] = 9999;
+    REQUIRE(cache.lookup(partial, partial.size() - 1).n_tokens == 4);
+}
+
+TEST_CASE("LlamaPrefixCache evicts least recently used entries to respect the budget", "[prefix_cache][unit]")
+{
+    LlamaPrefixCache cache;
+    cache.configure({7, 8}, 24, 4);
+
+    llama_seq_id seq = -1;
+    std::vector<llama_seq_id> evicted;
+
+    std::vector<llama_token> a(16, 1);
+    std::vector<llama_token> b(16, 2);
+
+    cache.insert(a, a.size(), seq, evicted);
+    REQUIRE(cache.insert(a, a.size(), seq, evicted) == 16);
+    llama_seq_id seq_a = seq;
+
+    cache.insert(b, b.size(), seq, evicted);
+    REQUIRE(cache.insert(b, b.size(), seq, evicted) == 16);
+    REQUIRE(seq != seq_a);
+    REQUIRE(evicted.size() == 1);
+    REQUIRE(evicted[0] == seq_a);
+    REQUIRE(cache.get_stats().cached_tokens == 16);
+
+    REQUIRE(cache.get_stats().evictions == 1);
+
+    REQUIRE(cache.evict_lru() == seq);
+    REQUIRE(cache.evict_lru() == -1);
+    REQUIRE(cache.get_stats().entries == 0);
+    REQUIRE(cache.get_stats().evictions == 2);
+
+    // Clearing the cache is not an eviction
+    cache.insert(a, a.size(), seq, evicted);
+    REQUIRE(cache.insert(a, a.size(), seq, evicted) == 16);
+    REQUIRE(cache.clear().size() == 1);
+    REQUIRE(cache.get_stats().evictions == 2);
+}
+
+TEST_CASE("LlamaPrefixCache is disabled without reserved sequences", "[prefix_cache][unit]")
+{
+    LlamaPrefixCache cache;
+    cache.configure({}, 1024, 4);
+    REQUIRE_FALSE(cache.enabled());
+
+    llama_seq_id seq = -1;
+    std::vector<llama_seq_id> evicted;
+    std::vector<llama_token> a(16, 1);
+    REQUIRE(cache.insert(a, a.size(), seq, evicted) == 0);
+    REQUIRE(cache.insert(a, a.size(), seq, evicted) == 0);
+    REQUIRE(cache.lookup(a, a.size()).seq_id == -1);
+}
@@ -0,0 +1,34 @@
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include "llama_request_handle.hh"
+
+TEST_CASE("LlamaRequestHandle reports cancellation and token limits", "[request_handle][unit]")
+{
+    LlamaRequestHandle handle;
+    REQUIRE(handle.check(0) == LlamaInterruptReason::None);
+
+    handle.set_token_limit(3);
+    REQUIRE(handle.check(2) == LlamaInterruptReason::None);
+    REQUIRE(handle.check(3) == LlamaInterruptReason::TokenLimit);
+
+    handle.cancel();
+    REQUIRE(handle.is_cancelled());
+    REQUIRE(handle.check(0) == LlamaInterruptReason::Cancelled);
+}
+
+TEST_CASE("LlamaRequestHandle enforces deadlines", "[request_handle][unit]")
+{
+    LlamaRequestHandle handle;
+    REQUIRE_FALSE(handle.has_deadline());
+
+    handle.set_timeout_ms(60000.0);
+    REQUIRE(handle.has_deadline());
+    REQUIRE(handle.check(0) == LlamaInterruptReason::None);
+
+    handle.set_deadline(LlamaRequestHandle::clock::now() - std::chrono::milliseconds(1));
+    REQUIRE(handle.check(0) == LlamaInterruptReason::Deadline);
+
+    handle.set_timeout_ms(0.0);
+    REQUIRE_FALSE(handle.has_deadline());
+    REQUIRE(handle.check(0) == LlamaInterruptReason::None);
+}
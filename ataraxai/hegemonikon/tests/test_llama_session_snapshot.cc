@@ -0,0 +1,110 @@
+#include <catch2/catch_test_macros.hpp>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "llama_session_snapshot.hh"
+#include "memory_locker.hh"
+
+static std::string make_snapshot_dir(const std::string &name)
+{
+    const std::filesystem::path dir = std::filesystem::temp_directory_path() / ("hegemonikon_" + name);
+    std::filesystem::remove_all(dir);
+    return dir.string();
+}
+
+static std::vector<llama_token> make_tokens(size_t n, llama_token base)
+{
+    std::vector<llama_token> tokens;
+    for (size_t i = 0; i < n; ++i)
+        tokens.push_back(static_cast<llama_token>(base + i));
+    return tokens;
+}
+
+TEST_CASE("LlamaSessionSnapshot round-trips and resumes the longest matching prefix", "[session_snapshot][unit]")
+{
+    const std::string dir = make_snapshot_dir("snapshot_plain");
+    const uint64_t model_hash = 0x1234;
+    std::vector<uint8_t> state(3000);
+    for (size_t i = 0; i < state.size(); ++i)
+        state[i] = static_cast<uint8_t>(i * 7);
+
+    std::string path;
+    std::string error;
+    const auto short_history = make_tokens(10, 100);
+    REQUIRE(LlamaSessionSnapshot::write(dir, model_hash, short_history, state, nullptr, path, error));
+    REQUIRE(LlamaSessionSnapshot::list(dir, model_hash).size() == 1);
+
+    // A longer snapshot of the same conversation supersedes the shorter one.
+    const auto long_history = make_tokens(40, 100);
+    REQUIRE(LlamaSessionSnapshot::write(dir, model_hash, long_history, state, nullptr, path, error));
+    REQUIRE(LlamaSessionSnapshot::list(dir, model_hash).size() == 1);
+    REQUIRE(LlamaSessionSnapshot::write(dir, model_hash, make_tokens(20, 900), state, nullptr, path, error));
+    REQUIRE(LlamaSessionSnapshot::list(dir, model_hash).size() == 2);
+
+    auto prompt = make_tokens(45, 100);
+    HegemonikonSessionSnapshotInfo best;
+    REQUIRE(LlamaSessionSnapshot::find_best(dir, model_hash, prompt, nullptr, best));
+    REQUIRE(best.n_tokens == 40);
+    REQUIRE_FALSE(best.encrypted);
+    REQUIRE_FALSE(LlamaSessionSnapshot::find_best(dir, model_hash + 1, prompt, nullptr, best));
+    REQUIRE_FALSE(LlamaSessionSnapshot::find_best(dir, model_hash, make_tokens(45, 500), nullptr, best));
+
+    std::vector<llama_token> tokens;
+    std::vector<uint8_t> restored;
+    REQUIRE(LlamaSessionSnapshot::find_best(dir, model_hash, prompt, nullptr, best));
+    REQUIRE(LlamaSessionSnapshot::read(best.path, model_hash, nullptr, tokens, restored, error));
+    REQUIRE(tokens == long_history);
+    REQUIRE(restored == state);
+    REQUIRE_FALSE(LlamaSessionSnapshot::read(best.path, model_hash + 1, nullptr, tokens, restored, error));
+
+    REQUIRE(LlamaSessionSnapshot::remove_for_model(dir, model_hash) == 2);
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("LlamaSessionSnapshot encrypts and authenticates with a SecureKey", "[session_snapshot][unit]")
+{
+    const std::string dir = make_snapshot_dir("snapshot_encrypted");
+    const uint64_t model_hash = 0x5678;
+    const uint8_t key_bytes[32] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16};
+    const uint8_t other_bytes[32] = {42};
+    SecureKey key(key_bytes, sizeof(key_bytes));
+    SecureKey other(other_bytes, sizeof(other_bytes));
+
+    const std::vector<uint8_t> state(5000, 0xAB);
+    const auto history = make_tokens(64, 7);
+    std::string path;
+    std::string error;
+    REQUIRE(LlamaSessionSnapshot::write(dir, model_hash, history, state, &key, path, error));
+
+    // Neither the plain prefix hash nor the plaintext state appear in the file.
+    REQUIRE(path.find(LlamaSessionSnapshot::file_name(model_hash, LlamaSessionSnapshot::hash_tokens(history.data(), history.size()))) == std::string::npos);
+    std::ifstream in(path, std::ios::binary);
+    const std::string contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    REQUIRE(contents.find(std::string(64, static_cast<char>(0xAB))) == std::string::npos);
+
+    HegemonikonSessionSnapshotInfo best;
+    REQUIRE_FALSE(LlamaSessionSnapshot::find_best(dir, model_hash, history, nullptr, best));
+    REQUIRE_FALSE(LlamaSessionSnapshot::find_best(dir, model_hash, history, &other, best));
+    REQUIRE(LlamaSessionSnapshot::find_best(dir, model_hash, history, &key, best));
+    REQUIRE(best.encrypted);
+
+    std::vector<llama_token> tokens;
+    std::vector<uint8_t> restored;
+    REQUIRE_FALSE(LlamaSessionSnapshot::read(path, model_hash, &other, tokens, restored, error));
+    REQUIRE(tokens.empty());
+    REQUIRE(LlamaSessionSnapshot::read(path, model_hash, &key, tokens, restored, error));
+    REQUIRE(tokens == history);
+    REQUIRE(restored == state);
+
+    {
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekg(-100, std::ios::end);
+        const char byte = static_cast<char>(file.get() ^ 0x01);
+        file.seekp(-100, std::ios::end);
+        file.put(byte);
+    }
+    REQUIRE_FALSE(LlamaSessionSnapshot::read(path, model_hash, &key, tokens, restored, error));
+    std::filesystem::remove_all(dir);
+}
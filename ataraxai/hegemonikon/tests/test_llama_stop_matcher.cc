@@ -0,0 +1,87 @@
+#include <catch2/catch_test_macros.hpp>
+#include <string>
+#include <vector>
+#include "llama_stop_matcher.hh"
+
+static std::string feed_all(LlamaStopMatcher &matcher, const std::vector<std::string> &pieces, bool &stopped)
+{
+    std::string streamed;
+    std::string emitted;
+    stopped = false;
+    for (const auto &piece : pieces)
+    {
+        stopped = matcher.feed(piece, emitted);
+        streamed += emitted;
+        if (stopped)
+            break;
+    }
+    if (!stopped)
+        streamed += matcher.flush();
+    return streamed;
+}
+
+TEST_CASE("LlamaStopMatcher stops on sequences spanning token boundaries", "[stop_matcher][unit]")
+{
+    LlamaStopMatcher matcher({"User:", "</s>"});
+
+    bool stopped = false;
+    std::string out = feed_all(matcher, {"Hello", " there", "\nUs", "er", ": next"}, stopped);
+    REQUIRE(stopped);
+    REQUIRE(out == "Hello there\n");
+}
+
+TEST_CASE("LlamaStopMatcher holds back partial matches and releases them on divergence", "[stop_matcher][unit]")
+{
+    LlamaStopMatcher matcher({"\n\n", "User:"});
+    std::string emitted;
+
+    REQUIRE_FALSE(matcher.feed("answer\n", emitted));
+    REQUIRE(emitted == "answer");
+    REQUIRE(matcher.held_back() == 1);
+
+    REQUIRE_FALSE(matcher.feed("Us", emitted));
+    REQUIRE(emitted == "\n");
+    REQUIRE(matcher.held_back() == 2);
+
+    REQUIRE_FALSE(matcher.feed("ually", emitted));
+    REQUIRE(emitted == "Usually");
+    REQUIRE(matcher.held_back() == 0);
+
+    REQUIRE_FALSE(matcher.feed(" Use", emitted));
+    REQUIRE(emitted == " ");
+    REQUIRE(matcher.flush() == "Use");
+}
+
+TEST_CASE("LlamaStopMatcher handles overlapping patterns via failure links", "[stop_matcher][unit]")
+{
+    LlamaStopMatcher matcher({"abcd", "bc"});
+
+    bool stopped = false;
+    std::string out = feed_all(matcher, {"xa", "bc", "d"}, stopped);
+    REQUIRE(stopped);
+    REQUIRE(out == "xa");
+
+    matcher.configure({"aab"});
+    out = feed_all(matcher, {"a", "a", "a", "b", "z"}, stopped);
+    REQUIRE(stopped);
+    REQUIRE(out == "a");
+}
+
+TEST_CASE("LlamaStopMatcher passes text through without stop sequences", "[stop_matcher][unit]")
+{
+    LlamaStopMatcher matcher({"", ""});
+    REQUIRE(matcher.empty());
+
+    bool stopped = false;
+    REQUIRE(feed_all(matcher, {"a", "b"}, stopped) == "ab");
+    REQUIRE_FALSE(stopped);
+}
+
+TEST_CASE("LlamaStopMatcher checks complete texts for a stop suffix", "[stop_matcher][unit]")
+{
+    LlamaStopMatcher matcher({"</s>", "User:"});
+    REQUIRE(matcher.matches_suffix("hello</s>"));
+    REQUIRE(matcher.matches_suffix("User:"));
+    REQUIRE_FALSE(matcher.matches_suffix("</s>hello"));
+    REQUIRE_FALSE(matcher.matches_suffix(""));
+}
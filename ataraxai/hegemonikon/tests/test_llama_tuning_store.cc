@@ -0,0 +1,168 @@
+#include <catch2/catch_test_macros.hpp>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include "llama_tuning_store.hh"
+#include "model_benchmarker.hh"
+
+static std::string make_store_path(const std::string &name)
+{
+    const std::filesystem::path dir = std::filesystem::temp_directory_path() / ("hegemonikon_" + name);
+    std::filesystem::remove_all(dir);
+    return (dir / "tuning.json").string();
+}
+
+static HegemonikonTunedLlamaParams make_entry(const std::string &model_key, const std::string &machine_key, int32_t n_gpu_layers)
+{
+    HegemonikonTunedLlamaParams entry;
+    entry.model_key = model_key;
+    entry.machine_key = machine_key;
+    entry.objective = "decode_tokens_per_second";
+    entry.score = 42.5;
+    entry.tokens_per_second = 42.5;
+    entry.ttft_ms = 120.0;
+    entry.memory_mb = 4096.0;
+    entry.params.n_gpu_layers = n_gpu_layers;
+    entry.params.n_batch = 256;
+    entry.params.n_ubatch = 256;
+    entry.params.n_threads = 6;
+    entry.params.n_threads_batch = 12;
+    entry.params.cache_type_k = "q8_0";
+    entry.params.cache_type_v = "q8_0";
+    entry.params.flash_attn = "on";
+    return entry;
+}
+
+TEST_CASE("LlamaTuningStore round-trips entries per model and machine", "[tuning][unit]")
+{
+    const std::string path = make_store_path("tuning_store_round_trip");
+    LlamaTuningStore store(path);
+
+    HegemonikonTunedLlamaParams found;
+    CHECK_FALSE(store.lookup("model.gguf:100", "machine-a", found));
+
+    REQUIRE(store.store(make_entry("model.gguf:100", "machine-a", 20)));
+    REQUIRE(store.store(make_entry("model.gguf:100", "machine-b", 0)));
+    REQUIRE(store.store(make_entry("model.gguf:100", "machine-a", 33)));
+    REQUIRE(store.entries().size() == 2);
+
+    LlamaTuningStore reopened(path);
+    REQUIRE(reopened.lookup("model.gguf:100", "machine-a", found));
+    REQUIRE(found.params.n_gpu_layers == 33);
+    REQUIRE(found.params.n_batch == 256);
+    REQUIRE(found.params.n_threads == 6);
+    REQUIRE(found.params.n_threads_batch == 12);
+    REQUIRE(found.params.cache_type_v == "q8_0");
+    REQUIRE(found.params.flash_attn == "on");
+    REQUIRE(found.objective == "decode_tokens_per_second");
+    REQUIRE(std::abs(found.tokens_per_second - 42.5) < 1e-9);
+
+    REQUIRE(reopened.lookup("model.gguf:100", "machine-b", found));
+    REQUIRE(found.params.n_gpu_layers == 0);
+    CHECK_FALSE(reopened.lookup("model.gguf:100", "machine-c", found));
+    CHECK_FALSE(reopened.lookup("other.gguf:100", "machine-a", found));
+}
+
+TEST_CASE("LlamaTuningStore ignores unreadable files and keys models by name and size", "[tuning][unit]")
+{
+    const std::string path = make_store_path("tuning_store_corrupt");
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path());
+    {
+        std::ofstream file(path);
+        file << "{ not json";
+    }
+    LlamaTuningStore store(path);
+    HegemonikonTunedLlamaParams found;
+    CHECK_FALSE(store.lookup("model.gguf:100", "machine-a", found));
+    REQUIRE(store.store(make_entry("model.gguf:100", "machine-a", 10)));
+    REQUIRE(store.lookup("model.gguf:100", "machine-a", found));
+
+    const std::string model_path = (std::filesystem::path(path).parent_path() / "tiny.gguf").string();
+    {
+        std::ofstream model(model_path, std::ios::binary);
+        model << "GGUF1234";
+    }
+    REQUIRE(LlamaTuningStore::model_key(model_path) == "tiny.gguf:8");
+    REQUIRE(LlamaTuningStore::model_key(model_path + ".missing").empty());
+}
+
+TEST_CASE("LlamaTuningStore::apply only replaces the tuned fields", "[tuning][unit]")
+{
+    HegemonikonLlamaModelParams requested("model.gguf", 4096);
+    requested.n_seq_max = 8;
+    requested.draft_model_path = "draft.gguf";
+    const HegemonikonLlamaModelParams tuned = make_entry("model.gguf:100", "machine-a", 24).params;
+
+    const HegemonikonLlamaModelParams applied = LlamaTuningStore::apply(requested, tuned);
+    REQUIRE(applied.model_path == "model.gguf");
+    REQUIRE(applied.n_seq_max == 8);
+    REQUIRE(applied.draft_model_path == "draft.gguf");
+    REQUIRE(applied.n_gpu_layers == 24);
+    REQUIRE(applied.n_batch == 256);
+    REQUIRE(applied.n_threads == 6);
+    REQUIRE(applied.cache_type_k == "q8_0");
+    REQUIRE(applied.flash_attn == "on");
+    REQUIRE(applied.n_ctx == tuned.n_ctx);
+}
+
+TEST_CASE("HegemonikonLlamaBenchmarker expands tuning grids", "[tuning][unit]")
+{
+    HegemonikonLlamaModelParams base("model.gguf", 2048, 0, 0, 512);
+    HegemonikonTuningGrid grid;
+    REQUIRE(HegemonikonLlamaBenchmarker::expandTuningGrid(grid, base).size() == 1);
+    REQUIRE(HegemonikonLlamaBenchmarker::expandTuningGrid(grid, base).front() == base);
+
+    grid.n_gpu_layers = {0, 16, -1};
+    grid.n_batch = {128, 512};
+    grid.cache_types = {"f16", "q8_0"};
+    REQUIRE(grid.size() == 12);
+    const std::vector<HegemonikonLlamaModelParams> configurations = HegemonikonLlamaBenchmarker::expandTuningGrid(grid, base);
+    REQUIRE(configurations.size() == 12);
+    REQUIRE(configurations[0].n_gpu_layers == 0);
+    REQUIRE(configurations[0].n_batch == 128);
+    REQUIRE(configurations[0].n_ubatch == 128);
+    REQUIRE(configurations[1].cache_type_k == "q8_0");
+    REQUIRE(configurations[1].cache_type_v == "q8_0");
+    REQUIRE(configurations[11].n_gpu_layers == -1);
+    REQUIRE(configurations[11].n_batch == 512);
+    REQUIRE(configurations[11].n_ctx == 2048);
+    REQUIRE(configurations[11].model_path == "model.gguf");
+}
+
+TEST_CASE("HegemonikonLlamaBenchmarker ranks feasible configurations first", "[tuning][unit]")
+{
+    auto make_candidate = [](float tokens_per_second, float memory_mb, bool success)
+    {
+        HegemonikonTuningCandidate candidate;
+        candidate.metrics.success = success;
+        candidate.metrics.tokens_per_second = tokens_per_second;
+        candidate.metrics.memory_usage_mb = memory_mb;
+        candidate.metrics.avg_ttft_ms = 100.0f;
+        return candidate;
+    };
+    std::vector<HegemonikonTuningCandidate> candidates = {
+        make_candidate(30.0f, 2000.0f, true),
+        make_candidate(80.0f, 9000.0f, true),
+        make_candidate(50.0f, 3000.0f, true),
+        make_candidate(0.0f, 0.0f, false),
+    };
+
+    HegemonikonTuningParams tuning_params;
+    tuning_params.objective = HegemonikonTuningObjective::DecodeTokensPerSecond;
+    tuning_params.constraints.max_memory_mb = 4096.0f;
+    HegemonikonLlamaBenchmarker::rankTuningCandidates(candidates, tuning_params);
+    REQUIRE(candidates[0].metrics.tokens_per_second == 50.0f);
+    REQUIRE(candidates[0].feasible);
+    REQUIRE(candidates[1].metrics.tokens_per_second == 30.0f);
+    REQUIRE(candidates[2].metrics.tokens_per_second == 80.0f);
+    REQUIRE_FALSE(candidates[2].feasible);
+    REQUIRE_FALSE(candidates[3].metrics.success);
+
+    tuning_params.objective = HegemonikonTuningObjective::Memory;
+    tuning_params.constraints = HegemonikonTuningConstraints();
+    HegemonikonLlamaBenchmarker::rankTuningCandidates(candidates, tuning_params);
+    REQUIRE(candidates[0].metrics.memory_usage_mb == 2000.0f);
+    REQUIRE(candidates[2].metrics.memory_usage_mb == 9000.0f);
+    REQUIRE_FALSE(candidates[3].feasible);
+}
@@ -0,0 +1,36 @@
+#include <catch2/catch_test_macros.hpp>
+#include <string>
+#include "llama_piece_table.hh"
+
+TEST_CASE("LlamaUtf8Accumulator only releases complete code points", "[utf8][unit]")
+{
+    LlamaUtf8Accumulator utf8;
+    std::string out;
+
+    // "é" (C3 A9) followed by "€" (E2 82 AC), split across pieces.
+    utf8.push("ab\xC3", out);
+    REQUIRE(out == "ab");
+    REQUIRE(utf8.pending() == 1);
+
+    utf8.push("\xA9\xE2\x82", out);
+    REQUIRE(out == "ab\xC3\xA9");
+    REQUIRE(utf8.pending() == 2);
+
+    utf8.push("\xAC!", out);
+    REQUIRE(out == "ab\xC3\xA9\xE2\x82\xAC!");
+    REQUIRE(utf8.pending() == 0);
+}
+
+TEST_CASE("LlamaUtf8Accumulator flushes incomplete tails", "[utf8][unit]")
+{
+    LlamaUtf8Accumulator utf8;
+    std::string out;
+
+    utf8.push("x\xF0\x9F", out);
+    REQUIRE(out == "x");
+    REQUIRE(utf8.flush() == "\xF0\x9F");
+    REQUIRE(utf8.pending() == 0);
+
+    REQUIRE(LlamaUtf8Accumulator::complete_length("\xF0\x9F\x98\x80") == 4);
+    REQUIRE(LlamaUtf8Accumulator::complete_length("\x80\x80") == 2);
+}
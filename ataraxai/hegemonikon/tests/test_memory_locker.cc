@@ -7,6 +7,7 @@
 #include <cstring>
 #include <vector>
 #include <iostream>
+#include <set>
 #include "memory_locker.hh"
 
 TEST_CASE("Test secure memset", "[service][unit]") {
@@ -73,6 +74,32 @@ TEST_CASE("Test Derive Key from password", "[service][unit]") {
     REQUIRE(key.size() == 32);
 }
 
+TEST_CASE("Test Derive Key with several lanes", "[service][unit]") {
+    SecureString password("testpassword");
+    std::vector<uint8_t> salt(16, 0x22);
+    KeyDerivationParams params;
+    params.m_cost = 4096;
+    params.lanes = 4;
+
+    params.threads = 1;
+    SecureVector sequential = derive_key_from_password(password, salt, params);
+    params.threads = 4;
+    SecureVector parallel = derive_key_from_password(password, salt, params);
+    params.threads = 0;
+    SecureVector automatic = derive_key_from_password(password, salt, params);
+    REQUIRE(sequential.size() == 32);
+    REQUIRE(parallel == sequential);
+    REQUIRE(automatic == sequential);
+
+    params.lanes = 3;
+    params.threads = 8;
+    SecureVector three_lanes = derive_key_from_password(password, salt, params);
+    REQUIRE(three_lanes != sequential);
+
+    params.lanes = 0;
+    REQUIRE_THROWS_AS(derive_key_from_password(password, salt, params), std::runtime_error);
+}
+
 TEST_CASE("Test Derive Key and protect key", "[service][unit]") {
     SecureString password("anotherpassword");
     std::vector<uint8_t> salt(16, 0x33);
@@ -118,3 +145,103 @@ TEST_CASE("Test SecureKey move assign", "[service][unit]") {
     REQUIRE(k3.size() == 16);
     REQUIRE(k2.size() == 0);
 }
+
+TEST_CASE("Test SecureArena size classes", "[service][unit]") {
+    REQUIRE(SecureArena::block_size(1) == 16);
+    REQUIRE(SecureArena::block_size(16) == 16);
+    REQUIRE(SecureArena::block_size(17) == 32);
+    REQUIRE(SecureArena::block_size(2048) == 2048);
+    const size_t page_size = PlatformMemory::get_page_size();
+    REQUIRE(SecureArena::block_size(2049) == PlatformMemoryUtils::align_size(2049, page_size));
+}
+
+TEST_CASE("Test SecureArena locks a region once for many secrets", "[service][unit]") {
+    SecureArena arena;
+    std::vector<void *> blocks;
+    for (int i = 0; i < 200; ++i) {
+        void *block = arena.allocate(32 + (i % 3) * 40);
+        REQUIRE(block != nullptr);
+        memset(block, 0xAB, 32);
+        blocks.push_back(block);
+    }
+
+    SecureArenaStats stats = arena.get_stats();
+    REQUIRE(stats.regions == 1);
+    REQUIRE(stats.lock_calls == 1);
+    REQUIRE(stats.blocks_in_use == 200);
+    REQUIRE(std::set<void *>(blocks.begin(), blocks.end()).size() == blocks.size());
+
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        arena.deallocate(blocks[i], 32 + (i % 3) * 40);
+    }
+    stats = arena.get_stats();
+    REQUIRE(stats.blocks_in_use == 0);
+    REQUIRE(stats.bytes_in_use == 0);
+    REQUIRE(stats.regions == 1);
+}
+
+TEST_CASE("Test SecureArena zeroes blocks on free and reuses them", "[service][unit]") {
+    SecureArena arena;
+    uint8_t *block = static_cast<uint8_t *>(arena.allocate(64));
+    memset(block, 0x5A, 64);
+    arena.deallocate(block, 64);
+
+    // The first bytes of a free block hold the free-list link; the secret must be gone from the rest
+    for (size_t i = sizeof(void *); i < 64; ++i) {
+        REQUIRE(block[i] == 0);
+    }
+
+    uint8_t *again = static_cast<uint8_t *>(arena.allocate(50));
+    REQUIRE(again == block);
+    for (size_t i = 0; i < 64; ++i) {
+        REQUIRE(again[i] == 0);
+    }
+    arena.deallocate(again, 50);
+}
+
+TEST_CASE("Test SecureArena large blocks", "[service][unit]") {
+    SecureArena arena;
+    void *large = arena.allocate(10000);
+    REQUIRE(large != nullptr);
+    memset(large, 0x11, 10000);
+    SecureArenaStats stats = arena.get_stats();
+    REQUIRE(stats.large_blocks == 1);
+    REQUIRE(stats.regions == 0);
+    arena.deallocate(large, 10000);
+    REQUIRE(arena.get_stats().large_blocks == 0);
+    REQUIRE(arena.get_stats().locked_bytes == 0);
+}
+
+TEST_CASE("Test SecureArena gives empty buffers a block", "[service][unit]") {
+    SecureArena arena;
+    void *empty = arena.allocate(0);
+    REQUIRE(empty != nullptr);
+    REQUIRE(arena.get_stats().bytes_in_use == SecureArena::block_size(0));
+    arena.deallocate(empty, 0);
+    REQUIRE(arena.get_stats().blocks_in_use == 0);
+
+    REQUIRE_NOTHROW(LockedMemory(0));
+    const uint8_t byte = 0;
+    SecureKey key(&byte, 0);
+    REQUIRE(key.size() == 0);
+}
+
+TEST_CASE("Test SecureArena backs the secure types", "[service][unit]") {
+    const SecureArenaStats before = SecureArena::instance().get_stats();
+    {
+        std::vector<SecureString> strings;
+        for (int i = 0; i < 64; ++i) {
+            strings.emplace_back("api-key-" + std::to_string(i));
+        }
+        std::vector<uint8_t> raw(32, 0x42);
+        SecureKey key(raw.data(), raw.size());
+        SecureVector vector(48, 0x01);
+        LockedMemory locked(100);
+
+        const SecureArenaStats during = SecureArena::instance().get_stats();
+        REQUIRE(during.blocks_in_use == before.blocks_in_use + 67);
+        REQUIRE(during.lock_calls - before.lock_calls <= 1);
+        REQUIRE(strcmp(strings[10].c_str(), "api-key-10") == 0);
+    }
+    REQUIRE(SecureArena::instance().get_stats().blocks_in_use == before.blocks_in_use);
+}
@@ -0,0 +1,112 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <cmath>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "metrics_registry.hh"
+
+TEST_CASE("LatencyHistogram buckets stay within 1/16 of the value", "[metrics][unit]")
+{
+    for (uint64_t value : {0ull, 1ull, 15ull, 16ull, 17ull, 1000ull, 123456789ull, 3600000000000ull})
+    {
+        const size_t index = LatencyHistogram::bucket_index(value);
+        REQUIRE(index < LatencyHistogram::N_BUCKETS);
+        const uint64_t upper = LatencyHistogram::bucket_upper_ns(index);
+        REQUIRE(upper >= value);
+        REQUIRE(upper - value <= value / 16);
+        if (index > 0)
+        {
+            REQUIRE(LatencyHistogram::bucket_upper_ns(index - 1) < value);
+        }
+    }
+    REQUIRE(LatencyHistogram::bucket_index(UINT64_MAX) == LatencyHistogram::N_BUCKETS - 1);
+}
+
+TEST_CASE("MetricsRegistry reports percentiles and cumulative buckets", "[metrics][unit]")
+{
+    MetricsRegistry metrics;
+    for (int i = 1; i <= 100; ++i)
+    {
+        metrics.record_ms(MetricPhase::InterToken, static_cast<double>(i));
+    }
+    metrics.add(MetricCounter::GeneratedTokens, 100);
+
+    const HegemonikonMetricsSnapshot snapshot = metrics.snapshot();
+    REQUIRE(snapshot.latencies.size() == static_cast<size_t>(MetricPhase::Count));
+    REQUIRE(snapshot.generated_tokens == 100);
+
+    const HegemonikonLatencySnapshot *inter_token = snapshot.find("inter_token");
+    REQUIRE(inter_token != nullptr);
+    REQUIRE(inter_token->count == 100);
+    REQUIRE(std::abs(inter_token->sum_ms - 5050.0) < 1e-6);
+    REQUIRE(std::abs(inter_token->max_ms - 100.0) < 1e-6);
+    REQUIRE(inter_token->p50_ms >= 50.0);
+    REQUIRE(inter_token->p50_ms <= 50.0 * 17 / 16);
+    REQUIRE(inter_token->p99_ms >= 99.0);
+    REQUIRE(inter_token->p99_ms <= 100.0);
+
+    for (const auto &[bound_ms, count] : inter_token->buckets)
+    {
+        if (bound_ms == 10.0)
+        {
+            REQUIRE(count <= 10);
+            REQUIRE(count >= 9);
+        }
+        if (bound_ms >= 250.0)
+        {
+            REQUIRE(count == 100);
+        }
+    }
+
+    REQUIRE(snapshot.find("tokenize")->count == 0);
+    REQUIRE(snapshot.find("no_such_phase") == nullptr);
+
+    metrics.reset();
+    REQUIRE(metrics.snapshot().find("inter_token")->count == 0);
+    REQUIRE(metrics.snapshot().generated_tokens == 0);
+}
+
+TEST_CASE("MetricsRegistry records from many threads without losing samples", "[metrics][unit]")
+{
+    MetricsRegistry metrics;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&metrics]()
+                             {
+                                 for (int i = 0; i < 10000; ++i)
+                                 {
+                                     MetricsRegistry::ScopedTimer timer(&metrics, MetricPhase::Sample);
+                                     metrics.add(MetricCounter::Requests);
+                                 } });
+    }
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+
+    const HegemonikonMetricsSnapshot snapshot = metrics.snapshot();
+    REQUIRE(snapshot.find("sample")->count == 40000);
+    REQUIRE(snapshot.requests == 40000);
+
+    MetricsRegistry::ScopedTimer ignored(nullptr, MetricPhase::Sample);
+}
+
+TEST_CASE("MetricsRegistry exports the Prometheus text format", "[metrics][unit]")
+{
+    MetricsRegistry metrics;
+    metrics.record_ms(MetricPhase::QueueWait, 2.0);
+    metrics.add(MetricCounter::AudioSamples, 32000);
+
+    const std::string text = metrics.to_prometheus();
+    REQUIRE(text.find("# TYPE hegemonikon_phase_duration_seconds histogram\n") != std::string::npos);
+    REQUIRE(text.find("hegemonikon_phase_duration_seconds_bucket{phase=\"queue_wait\",le=\"0.001\"} 0\n") != std::string::npos);
+    REQUIRE(text.find("hegemonikon_phase_duration_seconds_bucket{phase=\"queue_wait\",le=\"0.0025\"} 1\n") != std::string::npos);
+    REQUIRE(text.find("hegemonikon_phase_duration_seconds_bucket{phase=\"queue_wait\",le=\"+Inf\"} 1\n") != std::string::npos);
+    REQUIRE(text.find("hegemonikon_phase_duration_seconds_sum{phase=\"queue_wait\"} 0.002\n") != std::string::npos);
+    REQUIRE(text.find("hegemonikon_phase_duration_seconds_count{phase=\"queue_wait\"} 1\n") != std::string::npos);
+    REQUIRE(text.find("# TYPE hegemonikon_requests_total counter\nhegemonikon_requests_total 0\n") != std::string::npos);
+    REQUIRE(text.find("hegemonikon_audio_seconds_total 2\n") != std::string::npos);
+}
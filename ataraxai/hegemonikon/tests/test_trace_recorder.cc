@@ -0,0 +1,126 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "hegemonikon_log.hh"
+#include "trace_recorder.hh"
+
+namespace
+{
+    size_t count_occurrences(const std::string &text, const std::string &needle)
+    {
+        size_t count = 0;
+        for (size_t pos = text.find(needle); pos != std::string::npos; pos = text.find(needle, pos + needle.size()))
+        {
+            ++count;
+        }
+        return count;
+    }
+}
+
+TEST_CASE("TraceRecorder exports recorded spans as Chrome trace JSON", "[trace][unit]")
+{
+    TraceRecorder &recorder = TraceRecorder::instance();
+    recorder.start();
+    REQUIRE(TraceRecorder::enabled());
+    {
+        TraceSpan span("test_decode", "llama");
+        span.set_arg("n_tokens", 42);
+    }
+    const uint64_t start_ns = TraceRecorder::now_ns();
+    recorder.record("test_encode", "whisper", start_ns, start_ns + 1500);
+    recorder.stop();
+
+    const std::string json = recorder.to_chrome_trace();
+    REQUIRE(json.rfind("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", 0) == 0);
+    REQUIRE(json.find("\"name\":\"test_decode\",\"cat\":\"llama\"") != std::string::npos);
+    REQUIRE(json.find("\"args\":{\"n_tokens\":42}") != std::string::npos);
+    REQUIRE(json.find("\"name\":\"test_encode\",\"cat\":\"whisper\"") != std::string::npos);
+    REQUIRE(json.find("\"dur\":1.500") != std::string::npos);
+    REQUIRE(json.find("\"name\":\"thread_name\"") != std::string::npos);
+}
+
+TEST_CASE("TraceRecorder records nothing while stopped and drops spans of earlier sessions", "[trace][unit]")
+{
+    TraceRecorder &recorder = TraceRecorder::instance();
+    recorder.start();
+    {
+        TraceSpan span("test_old_session", "llama");
+    }
+    recorder.stop();
+    recorder.start();
+    recorder.stop();
+    {
+        TraceSpan span("test_while_stopped", "llama");
+    }
+    recorder.record("test_while_stopped", "llama", TraceRecorder::now_ns(), TraceRecorder::now_ns());
+
+    const std::string json = recorder.to_chrome_trace();
+    REQUIRE(json.find("test_old_session") == std::string::npos);
+    REQUIRE(json.find("test_while_stopped") == std::string::npos);
+    REQUIRE_FALSE(recorder.get_stats().enabled);
+}
+
+TEST_CASE("TraceRecorder keeps one ring per thread and overwrites the oldest spans", "[trace][unit]")
+{
+    TraceRecorder &recorder = TraceRecorder::instance();
+    const HegemonikonTraceStats before = recorder.get_stats();
+    recorder.start(6);
+    REQUIRE(recorder.get_stats().events_per_thread == 8);
+
+    const int n_threads = 4;
+    const int n_spans = 20;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < n_threads; ++t)
+    {
+        threads.emplace_back([&recorder, t]()
+                             {
+                                 recorder.set_thread_name("worker " + std::to_string(t));
+                                 for (int i = 0; i < n_spans; ++i)
+                                 {
+                                     TraceSpan span("test_worker_span", "test");
+                                     span.set_arg("index", i);
+                                 } });
+    }
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+    recorder.stop();
+
+    const HegemonikonTraceStats stats = recorder.get_stats();
+    REQUIRE(stats.n_threads == before.n_threads + n_threads);
+    REQUIRE(stats.events_recorded == before.events_recorded + n_threads * n_spans);
+    REQUIRE(stats.events_overwritten == before.events_overwritten + n_threads * (n_spans - 8));
+
+    const std::string json = recorder.to_chrome_trace();
+    REQUIRE(count_occurrences(json, "\"name\":\"test_worker_span\"") == static_cast<size_t>(n_threads * 8));
+    REQUIRE(json.find("\"args\":{\"index\":19}") != std::string::npos);
+    REQUIRE(json.find("\"args\":{\"index\":11}") == std::string::npos);
+    REQUIRE(json.find("\"args\":{\"name\":\"worker 3\"}") != std::string::npos);
+    recorder.start();
+    recorder.stop();
+}
+
+TEST_CASE("HegemonikonLog enables the levels up to the configured one", "[trace][unit]")
+{
+    const HegemonikonLogLevel saved = HegemonikonLog::level();
+
+    HegemonikonLog::set_level(HegemonikonLogLevel::Warning);
+    REQUIRE(HegemonikonLog::enabled(HegemonikonLogLevel::Error));
+    REQUIRE(HegemonikonLog::enabled(HegemonikonLogLevel::Warning));
+    REQUIRE_FALSE(HegemonikonLog::enabled(HegemonikonLogLevel::Info));
+    REQUIRE_FALSE(HegemonikonLog::enabled(HegemonikonLogLevel::Debug));
+
+    HegemonikonLog::set_level(HegemonikonLogLevel::Debug);
+    REQUIRE(HegemonikonLog::enabled(HegemonikonLogLevel::Info));
+    REQUIRE(HegemonikonLog::enabled(HegemonikonLogLevel::Debug));
+
+    HegemonikonLog::set_level(HegemonikonLogLevel::Off);
+    REQUIRE_FALSE(HegemonikonLog::enabled(HegemonikonLogLevel::Error));
+    REQUIRE_FALSE(HegemonikonLog::enabled(HegemonikonLogLevel::Off));
+
+    HegemonikonLog::set_level(saved);
+}
@@ -0,0 +1,100 @@
+#include <catch2/catch_test_macros.hpp>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "transcript_prefiller.hh"
+
+/**
+ * @brief Records the prompts it is asked to prefill, optionally holding each call until released.
+ */
+class RecordingLlamaInterface : public LlamaInterface
+{
+public:
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::vector<std::string> prompts;
+    std::vector<std::string> session_ids;
+    bool gated = false;
+    bool fail = false;
+
+    int32_t prefill_session(const std::string &prompt_text, const HegemonikonGenerationParams &params, size_t) override
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        prompts.push_back(prompt_text);
+        session_ids.push_back(params.session_id);
+        changed.notify_all();
+        changed.wait(lock, [this]()
+                     { return !gated; });
+        return fail ? -1 : static_cast<int32_t>(prompt_text.size());
+    }
+
+    void wait_for_calls(size_t n_calls)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&]()
+                     { return prompts.size() >= n_calls; });
+    }
+
+    void open_gate()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        gated = false;
+        changed.notify_all();
+    }
+};
+
+TEST_CASE("TranscriptPrefiller prefills the prefix and the transcript so far", "[transcript_prefiller][unit]")
+{
+    RecordingLlamaInterface llama;
+    HegemonikonGenerationParams params;
+    params.set_session_id("summary");
+    TranscriptPrefiller prefiller(&llama, "Summarize:", params);
+
+    prefiller.append(" Hello");
+    llama.wait_for_calls(1);
+    prefiller.append(" world.");
+    llama.wait_for_calls(2);
+    prefiller.append("");
+
+    CHECK(prefiller.finish() == " Hello world.");
+    CHECK(llama.prompts == std::vector<std::string>({"Summarize: Hello", "Summarize: Hello world."}));
+    CHECK(llama.session_ids == std::vector<std::string>({"summary", "summary"}));
+    CHECK(prefiller.prefilled_tokens() == static_cast<int32_t>(std::string("Summarize: Hello world.").size()));
+}
+
+TEST_CASE("TranscriptPrefiller coalesces text appended during a prefill", "[transcript_prefiller][unit]")
+{
+    RecordingLlamaInterface llama;
+    llama.gated = true;
+    HegemonikonGenerationParams params;
+    params.set_session_id("summary");
+    TranscriptPrefiller prefiller(&llama, "", params);
+
+    prefiller.append("a");
+    llama.wait_for_calls(1);
+    prefiller.append("b");
+    prefiller.append("c");
+    llama.open_gate();
+    llama.wait_for_calls(2);
+
+    CHECK(prefiller.finish() == "abc");
+    CHECK(llama.prompts == std::vector<std::string>({"a", "abc"}));
+}
+
+TEST_CASE("TranscriptPrefiller keeps the transcript when the session cannot be prefilled", "[transcript_prefiller][unit]")
+{
+    RecordingLlamaInterface llama;
+    llama.fail = true;
+    HegemonikonGenerationParams params;
+    params.set_session_id("summary");
+    TranscriptPrefiller prefiller(&llama, "", params);
+
+    prefiller.append(" one");
+    llama.wait_for_calls(1);
+    prefiller.append(" two");
+
+    CHECK(prefiller.finish() == " one two");
+    CHECK(prefiller.finish() == " one two");
+    CHECK(prefiller.prefilled_tokens() == 0);
+}
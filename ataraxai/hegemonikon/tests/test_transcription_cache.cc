@@ -0,0 +1,191 @@
+#include <catch2/catch_test_macros.hpp>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include "transcription_cache.hh"
+
+static std::string make_cache_dir(const std::string &name)
+{
+    const std::filesystem::path dir = std::filesystem::temp_directory_path() / ("hegemonikon_" + name);
+    std::filesystem::remove_all(dir);
+    return dir.string();
+}
+
+static HegemonikonTranscription make_transcription(const std::string &text, size_t n_tokens)
+{
+    HegemonikonTranscription transcription;
+    transcription.audio_ms = 4200;
+    HegemonikonWhisperSegment segment;
+    segment.text = text;
+    segment.t0_ms = 100;
+    segment.t1_ms = 4100;
+    segment.speaker_turn_next = true;
+    segment.no_speech_prob = 0.25f;
+    for (size_t i = 0; i < n_tokens; ++i)
+    {
+        HegemonikonWhisperToken token;
+        token.id = static_cast<int32_t>(1000 + i);
+        token.text = " w" + std::to_string(i);
+        token.t0_ms = static_cast<int64_t>(100 * i);
+        token.t1_ms = static_cast<int64_t>(100 * i + 90);
+        token.p = 0.5f;
+        segment.tokens.push_back(token);
+    }
+    transcription.segments.push_back(segment);
+    return transcription;
+}
+
+TEST_CASE("TranscriptionCache round-trips segments and tokens", "[transcription_cache][unit]")
+{
+    const std::string dir = make_cache_dir("transcription_cache_round_trip");
+    TranscriptionCache cache;
+    std::string error;
+    REQUIRE(cache.open(dir, TranscriptionCache::DEFAULT_MAX_BYTES, error));
+
+    HegemonikonTranscription cached;
+    CHECK_FALSE(cache.lookup("missing", cached));
+    REQUIRE(cache.store("key", make_transcription(" hello world", 3)));
+    REQUIRE(cache.lookup("key", cached));
+
+    REQUIRE(cached.ok());
+    CHECK(cached.audio_ms == 4200);
+    REQUIRE(cached.segments.size() == 1);
+    const HegemonikonWhisperSegment &segment = cached.segments[0];
+    CHECK(segment.text == " hello world");
+    CHECK(segment.t0_ms == 100);
+    CHECK(segment.t1_ms == 4100);
+    CHECK(segment.speaker_turn_next);
+    CHECK(segment.no_speech_prob == 0.25f);
+    REQUIRE(segment.tokens.size() == 3);
+    CHECK(segment.tokens[2].id == 1002);
+    CHECK(segment.tokens[2].text == " w2");
+    CHECK(segment.tokens[2].t1_ms == 290);
+
+    const HegemonikonTranscriptionCacheStats stats = cache.get_stats();
+    CHECK(stats.hits == 1);
+    CHECK(stats.misses == 1);
+    CHECK(stats.insertions == 1);
+    CHECK(stats.entries == 1);
+
+    HegemonikonTranscription failed;
+    failed.error = "[Error: Failed]";
+    CHECK_FALSE(cache.store("failed", failed));
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("TranscriptionCache evicts the least recently used entries beyond its size", "[transcription_cache][unit]")
+{
+    const std::string dir = make_cache_dir("transcription_cache_lru");
+    const std::string probe = (std::filesystem::path(dir).parent_path() / "hegemonikon_transcription_cache_probe").string();
+    REQUIRE(TranscriptionCache::write_file(probe, make_transcription(" entry", 4)));
+    const uint64_t entry_bytes = std::filesystem::file_size(probe);
+    std::filesystem::remove(probe);
+
+    TranscriptionCache cache;
+    std::string error;
+    REQUIRE(cache.open(dir, 2 * entry_bytes, error));
+    REQUIRE(cache.store("a", make_transcription(" entry", 4)));
+    REQUIRE(cache.store("b", make_transcription(" entry", 4)));
+
+    HegemonikonTranscription cached;
+    REQUIRE(cache.lookup("a", cached));
+    REQUIRE(cache.store("c", make_transcription(" entry", 4)));
+
+    CHECK(cache.lookup("a", cached));
+    CHECK_FALSE(cache.lookup("b", cached));
+    CHECK(cache.lookup("c", cached));
+    CHECK(cache.get_stats().evictions == 1);
+    CHECK(cache.get_stats().bytes == 2 * entry_bytes);
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("TranscriptionCache keeps its entries across reopening and drops corrupt ones", "[transcription_cache][unit]")
+{
+    const std::string dir = make_cache_dir("transcription_cache_persist");
+    std::string error;
+    {
+        TranscriptionCache cache;
+        REQUIRE(cache.open(dir, TranscriptionCache::DEFAULT_MAX_BYTES, error));
+        REQUIRE(cache.store("kept", make_transcription(" kept", 1)));
+        REQUIRE(cache.store("corrupt", make_transcription(" corrupt", 1)));
+    }
+    {
+        std::fstream file(dir + "/corrupt" + TranscriptionCache::FILE_EXTENSION, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(-1, std::ios::end);
+        file.put('\x7f');
+    }
+
+    TranscriptionCache cache;
+    REQUIRE(cache.open(dir, TranscriptionCache::DEFAULT_MAX_BYTES, error));
+    CHECK(cache.get_stats().entries == 2);
+
+    HegemonikonTranscription cached;
+    REQUIRE(cache.lookup("kept", cached));
+    CHECK(cached.text() == " kept");
+    CHECK_FALSE(cache.lookup("corrupt", cached));
+    CHECK(cache.get_stats().entries == 1);
+    CHECK_FALSE(std::filesystem::exists(dir + "/corrupt" + TranscriptionCache::FILE_EXTENSION));
+
+    CHECK(cache.clear() == 1);
+    CHECK(cache.get_stats().bytes == 0);
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("TranscriptionCache keys files by content and parameters", "[transcription_cache][unit]")
+{
+    const std::string dir = make_cache_dir("transcription_cache_keys");
+    std::filesystem::create_directories(dir);
+    const std::string a = dir + "/a.wav";
+    const std::string b = dir + "/b.wav";
+    const std::string c = dir + "/c.wav";
+    std::ofstream(a, std::ios::binary) << std::string(3 << 20, 'x');
+    std::ofstream(b, std::ios::binary) << std::string(3 << 20, 'x');
+    std::ofstream(c, std::ios::binary) << std::string(3 << 20, 'y');
+
+    std::string digest_a, digest_b, digest_c, error;
+    REQUIRE(TranscriptionCache::hash_file(a, digest_a, error));
+    REQUIRE(TranscriptionCache::hash_file(b, digest_b, error));
+    REQUIRE(TranscriptionCache::hash_file(c, digest_c, error));
+    CHECK(digest_a.size() == 32);
+    CHECK(digest_a == digest_b);
+    CHECK(digest_a != digest_c);
+    CHECK_FALSE(TranscriptionCache::hash_file(dir + "/missing.wav", digest_a, error));
+
+    HegemonikonWhisperModelParams model_params;
+    model_params.model = a;
+    HegemonikonWhisperGenerationParams params;
+    const std::string key = TranscriptionCache::make_key(digest_b, model_params, params);
+    CHECK(key == TranscriptionCache::make_key(digest_b, model_params, params));
+    params.set_translate(true);
+    CHECK(key != TranscriptionCache::make_key(digest_b, model_params, params));
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("TranscriptionCache keys only on the parameters that change the transcript", "[transcription_cache][unit]")
+{
+    const std::string dir = make_cache_dir("transcription_cache_key_fields");
+    TranscriptionCache cache;
+    std::string error;
+    REQUIRE(cache.open(dir, TranscriptionCache::DEFAULT_MAX_BYTES, error));
+
+    HegemonikonWhisperModelParams model_params;
+    HegemonikonWhisperGenerationParams params;
+    const std::string digest(32, '0');
+    REQUIRE(cache.store(TranscriptionCache::make_key(digest, model_params, params), make_transcription(" cached", 2)));
+
+    HegemonikonTranscription cached;
+    HegemonikonWhisperModelParams other_model = model_params;
+    other_model.set_n_threads(model_params.n_threads + 1).set_warmup(!model_params.warmup).set_keep_resident(true);
+    HegemonikonWhisperGenerationParams other_window = params;
+    other_window.set_step_ms(params.step_ms + 500);
+    other_window.fname_out = "out.txt";
+    CHECK(cache.lookup(TranscriptionCache::make_key(digest, other_model, other_window), cached));
+
+    HegemonikonWhisperGenerationParams other_ctx = params;
+    other_ctx.audio_ctx = 512;
+    CHECK_FALSE(cache.lookup(TranscriptionCache::make_key(digest, model_params, other_ctx), cached));
+    HegemonikonWhisperGenerationParams other_thold = params;
+    other_thold.word_thold = 0.5f;
+    CHECK_FALSE(cache.lookup(TranscriptionCache::make_key(digest, model_params, other_thold), cached));
+    std::filesystem::remove_all(dir);
+}
@@ -0,0 +1,129 @@
+#include <catch2/catch_test_macros.hpp>
+#include <cmath>
+#include <vector>
+#include "voice_activity_detector.hh"
+
+static constexpr size_t SECOND = VoiceActivityDetector::SAMPLE_RATE;
+
+static void append_tone(std::vector<float> &pcm, double frequency, double amplitude, size_t n_samples)
+{
+    const size_t start = pcm.size();
+    for (size_t i = 0; i < n_samples; ++i)
+    {
+        pcm.push_back(static_cast<float>(amplitude * std::sin(2.0 * 3.14159265 * frequency * (start + i) / SECOND)));
+    }
+}
+
+static void append_silence(std::vector<float> &pcm, size_t n_samples)
+{
+    pcm.insert(pcm.end(), n_samples, 0.0f);
+}
+
+TEST_CASE("VoiceActivityDetector finds the speech between silences", "[vad]")
+{
+    std::vector<float> pcm;
+    append_silence(pcm, SECOND);
+    append_tone(pcm, 440.0, 0.3, SECOND);
+    append_silence(pcm, 2 * SECOND);
+    append_tone(pcm, 440.0, 0.3, SECOND);
+    append_silence(pcm, SECOND);
+
+    const VoiceActivityDetector vad(0.6f, 100.0f);
+    const auto regions = vad.detect(pcm.data(), pcm.size());
+
+    REQUIRE(regions.size() == 2);
+    const size_t tolerance = VoiceActivityDetector::PAD_SAMPLES + VoiceActivityDetector::FRAME_SAMPLES;
+    CHECK(regions[0].start + tolerance >= SECOND);
+    CHECK(regions[0].start <= SECOND);
+    CHECK(regions[0].end >= 2 * SECOND);
+    CHECK(regions[0].end <= 2 * SECOND + tolerance);
+    CHECK(regions[1].start <= 4 * SECOND);
+    CHECK(regions[1].end >= 5 * SECOND);
+}
+
+TEST_CASE("VoiceActivityDetector finds nothing in silence", "[vad]")
+{
+    std::vector<float> pcm(3 * SECOND, 0.0f);
+    const VoiceActivityDetector vad(0.6f, 100.0f);
+    CHECK(vad.detect(pcm.data(), pcm.size()).empty());
+
+    std::vector<float> out;
+    SpeechTimeline timeline;
+    CHECK(vad.compact(pcm.data(), pcm.size(), 0, out, timeline) == 0);
+    CHECK(out.empty());
+    CHECK(timeline.empty());
+}
+
+TEST_CASE("VoiceActivityDetector bridges short pauses and drops clicks", "[vad]")
+{
+    std::vector<float> pcm;
+    append_silence(pcm, SECOND);
+    append_tone(pcm, 440.0, 0.3, SECOND / 2);
+    append_silence(pcm, SECOND / 5);
+    append_tone(pcm, 440.0, 0.3, SECOND / 2);
+    append_silence(pcm, 2 * SECOND);
+    append_tone(pcm, 440.0, 0.3, VoiceActivityDetector::FRAME_SAMPLES);
+    append_silence(pcm, 2 * SECOND);
+
+    const VoiceActivityDetector vad(0.6f, 100.0f);
+    const auto regions = vad.detect(pcm.data(), pcm.size());
+
+    REQUIRE(regions.size() == 1);
+    CHECK(regions[0].start <= SECOND);
+    CHECK(regions[0].end >= SECOND + SECOND / 2 + SECOND / 5 + SECOND / 2);
+    CHECK(regions[0].end < 4 * SECOND);
+}
+
+TEST_CASE("VoiceActivityDetector high-pass filter ignores mains hum", "[vad]")
+{
+    std::vector<float> pcm;
+    append_silence(pcm, SECOND);
+    append_tone(pcm, 440.0, 0.3, SECOND);
+    append_silence(pcm, SECOND);
+    for (size_t i = 0; i < pcm.size(); ++i)
+    {
+        pcm[i] += static_cast<float>(0.3 * std::sin(2.0 * 3.14159265 * 50.0 * i / SECOND));
+    }
+
+    const VoiceActivityDetector filtered(0.6f, 100.0f);
+    const auto regions = filtered.detect(pcm.data(), pcm.size());
+    REQUIRE(regions.size() == 1);
+    CHECK(regions[0].length() < 2 * SECOND);
+
+    const VoiceActivityDetector unfiltered(0.6f, 0.0f);
+    const auto all = unfiltered.detect(pcm.data(), pcm.size());
+    REQUIRE(all.size() == 1);
+    CHECK(all[0].length() == pcm.size());
+}
+
+TEST_CASE("VoiceActivityDetector compact maps positions back to the original audio", "[vad]")
+{
+    std::vector<float> pcm;
+    append_silence(pcm, SECOND);
+    append_tone(pcm, 440.0, 0.3, SECOND);
+    append_silence(pcm, 2 * SECOND);
+    append_tone(pcm, 440.0, 0.3, SECOND);
+    append_silence(pcm, SECOND);
+
+    const VoiceActivityDetector vad(0.6f, 100.0f);
+    const auto regions = vad.detect(pcm.data(), pcm.size());
+    REQUIRE(regions.size() == 2);
+
+    const uint64_t offset = 10 * SECOND;
+    std::vector<float> out;
+    SpeechTimeline timeline;
+    const size_t n_speech = vad.compact(pcm.data(), pcm.size(), offset, out, timeline);
+
+    CHECK(n_speech == regions[0].length() + regions[1].length());
+    CHECK(out.size() == n_speech + VoiceActivityDetector::GAP_SAMPLES);
+    CHECK(timeline.compact_size() == out.size());
+    CHECK(out.size() < pcm.size());
+
+    CHECK(timeline.to_original(0) == offset + regions[0].start);
+    CHECK(timeline.to_original(100) == offset + regions[0].start + 100);
+    const uint64_t second_start = regions[0].length() + VoiceActivityDetector::GAP_SAMPLES;
+    CHECK(timeline.to_original(second_start) == offset + regions[1].start);
+    CHECK(timeline.to_original(second_start + 500) == offset + regions[1].start + 500);
+    CHECK(timeline.to_original(regions[0].length() + 10) == offset + regions[0].end);
+    CHECK(out[second_start + 500] == pcm[regions[1].start + 500]);
+}
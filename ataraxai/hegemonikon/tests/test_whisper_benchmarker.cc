@@ -0,0 +1,126 @@
+#include <catch2/catch_test_macros.hpp>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "whisper_benchmarker.hh"
+
+static void write_u32(std::ofstream &out, uint32_t value)
+{
+    out.write(reinterpret_cast<const char *>(&value), 4);
+}
+
+static void write_u16(std::ofstream &out, uint16_t value)
+{
+    out.write(reinterpret_cast<const char *>(&value), 2);
+}
+
+static std::string write_silence_wav(const std::string &name, size_t n_frames)
+{
+    const std::string path = (std::filesystem::temp_directory_path() / ("hegemonikon_" + name + ".wav")).string();
+    std::ofstream out(path, std::ios::binary);
+    const uint32_t data_bytes = static_cast<uint32_t>(n_frames * 2);
+    out.write("RIFF", 4);
+    write_u32(out, 36 + data_bytes);
+    out.write("WAVEfmt ", 8);
+    write_u32(out, 16);
+    write_u16(out, 1);
+    write_u16(out, 1);
+    write_u32(out, 16000);
+    write_u32(out, 16000 * 2);
+    write_u16(out, 2);
+    write_u16(out, 16);
+    out.write("data", 4);
+    write_u32(out, data_bytes);
+    for (size_t i = 0; i < n_frames; ++i)
+        write_u16(out, 0);
+    return path;
+}
+
+TEST_CASE("HegemonikonWhisperBenchmarker expands benchmark grids", "[whisper][benchmark][unit]")
+{
+    HegemonikonWhisperModelParams base_model("models/ggml-base.en.bin", "en", false, false, 0, 4);
+    HegemonikonWhisperGenerationParams base_generation;
+    base_generation.beam_size = -1;
+
+    HegemonikonWhisperBenchmarkGrid grid;
+    REQUIRE(HegemonikonWhisperBenchmarker::expandGrid(grid, base_model, base_generation).size() == 1);
+    REQUIRE(HegemonikonWhisperBenchmarker::expandGrid(grid, base_model, base_generation).front().model_params == base_model);
+
+    grid.models = {"tiny.bin", "small.bin"};
+    grid.n_threads = {2, 8};
+    grid.beam_size = {1, 5};
+    grid.flash_attn = {true};
+    grid.audio_ctx = {0, 768};
+    REQUIRE(grid.size() == 16);
+    const std::vector<HegemonikonWhisperBenchmarkConfiguration> configurations =
+        HegemonikonWhisperBenchmarker::expandGrid(grid, base_model, base_generation);
+    REQUIRE(configurations.size() == 16);
+    REQUIRE(configurations[0].model_params.model == "tiny.bin");
+    REQUIRE(configurations[0].model_params.n_threads == 2);
+    REQUIRE(configurations[0].model_params.flash_attn);
+    REQUIRE(configurations[0].generation_params.beam_size == 1);
+    REQUIRE(configurations[1].generation_params.audio_ctx == 768);
+    REQUIRE(configurations[1].model_params.audio_ctx == 768);
+    REQUIRE(configurations[15].model_params.model == "small.bin");
+    REQUIRE(configurations[15].model_params.n_threads == 8);
+    REQUIRE(configurations[15].generation_params.beam_size == 5);
+    REQUIRE(configurations[15].model_params.language == "en");
+    REQUIRE_FALSE(configurations[15].model_params.use_gpu);
+}
+
+TEST_CASE("HegemonikonWhisperBenchmarkResult aggregates its repetitions", "[whisper][benchmark][unit]")
+{
+    HegemonikonWhisperBenchmarkResult result("ggml-base.en.bin");
+    result.metrics.success = true;
+    result.metrics.audio_seconds = 10.0f;
+    result.metrics.transcription_time_history_ms = {1000.0f, 2000.0f, 3000.0f};
+    result.metrics.real_time_factor_history = {0.1f, 0.2f, 0.3f};
+    result.metrics.encode_time_history_ms = {600.0f, 700.0f, 800.0f};
+    result.metrics.decode_time_history_ms = {300.0f, 400.0f, 500.0f};
+    result.calculateStatistics();
+
+    REQUIRE(std::abs(result.metrics.avg_transcription_time_ms - 2000.0f) < 1e-3f);
+    REQUIRE(std::abs(result.metrics.stdev_transcription_time_ms - 1000.0f) < 1e-1f);
+    REQUIRE(result.metrics.p50_transcription_time_ms == 2000.0f);
+    REQUIRE(std::abs(result.metrics.real_time_factor - 0.2f) < 1e-6f);
+    REQUIRE(std::abs(result.metrics.avg_encode_time_ms - 700.0f) < 1e-3f);
+    REQUIRE(std::abs(result.metrics.avg_decode_time_ms - 400.0f) < 1e-3f);
+
+    const json document = result.to_json();
+    REQUIRE(document["model_id"] == "ggml-base.en.bin");
+    REQUIRE(document["metrics"]["success"] == true);
+    REQUIRE(document["metrics"]["transcription_time_history_ms"].size() == 3);
+    REQUIRE(std::abs(document["metrics"]["real_time_factor"].get<double>() - 0.2) < 1e-6);
+
+    const std::string path = (std::filesystem::temp_directory_path() / "hegemonikon_whisper_benchmark" / "results.json").string();
+    std::filesystem::remove_all(std::filesystem::path(path).parent_path());
+    REQUIRE(HegemonikonWhisperBenchmarker::saveResultsJson({result}, path));
+    std::ifstream file(path);
+    const json saved = json::parse(file, nullptr, false);
+    REQUIRE_FALSE(saved.is_discarded());
+    REQUIRE(saved["benchmark"] == "whisper");
+    REQUIRE(saved["results"].size() == 1);
+}
+
+TEST_CASE("HegemonikonWhisperBenchmarker decodes its corpus once and reports failures", "[whisper][benchmark][unit]")
+{
+    HegemonikonWhisperBenchmarker benchmarker;
+    const std::string clip = write_silence_wav("whisper_benchmark_clip", 8000);
+    CHECK_FALSE(benchmarker.loadCorpus({clip, clip + ".missing"}));
+    REQUIRE(benchmarker.getCorpusSize() == 1);
+    REQUIRE(std::abs(benchmarker.getCorpusSeconds() - 0.5) < 1e-3);
+
+    HegemonikonWhisperModelParams model_params;
+    model_params.model = clip + ".missing.bin";
+    HegemonikonWhisperBenchmarkResult result = benchmarker.benchmarkSingleModel(model_params, HegemonikonWhisperBenchmarkParams());
+    CHECK_FALSE(result.metrics.success);
+    REQUIRE(result.metrics.errorMessage.rfind("Model file does not exist", 0) == 0);
+
+    benchmarker.setCorpus({});
+    result = benchmarker.benchmarkSingleModel(model_params, HegemonikonWhisperBenchmarkParams());
+    CHECK_FALSE(result.metrics.success);
+    REQUIRE(result.metrics.errorMessage == "No audio corpus loaded.");
+}
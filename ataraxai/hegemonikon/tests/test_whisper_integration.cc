@@ -2,9 +2,14 @@
 #include <filesystem>
 #include <iostream>
 #include <vector>
+#include <chrono>
+#include <thread>
 #include <cmath>
+#include <algorithm>
 
 #include "whisper_interface.hh"
+#include "whisper_stream_session.hh"
+#include "core_ai_service.hh"
 
 const std::string REAL_WHISPER_MODEL_PATH = TEST_WHISPER_MODEL_PATH;
 
@@ -34,4 +39,249 @@ TEST_CASE("WhisperInterface can load and use a real GGUF model", "[integration][
 
     REQUIRE(!result.empty());
     std::cout << "Whisper integration test response: " << result << std::endl;
-}
\ No newline at end of file
+}
+TEST_CASE("WhisperInterface transcribes a stream window by window", "[integration][whisper]")
+{
+    if (!std::filesystem::exists(REAL_WHISPER_MODEL_PATH))
+    {
+        WARN("SKIPPING Whisper streaming test: Model file not found at " << REAL_WHISPER_MODEL_PATH);
+        return;
+    }
+
+    WhisperInterface whisper_service;
+    HegemonikonWhisperModelParams params;
+    params.model = REAL_WHISPER_MODEL_PATH;
+    REQUIRE(whisper_service.load_model(params) == true);
+
+    // 70 s of audio, produced on demand: more than two windows, never held in memory at once.
+    const size_t total_samples = 70 * WhisperInterface::SAMPLE_RATE;
+    size_t produced = 0;
+    size_t largest_read = 0;
+    auto reader = [&](float *buffer, size_t max_samples)
+    {
+        const size_t n = std::min(max_samples, total_samples - produced);
+        for (size_t i = 0; i < n; ++i)
+        {
+            buffer[i] = 0.5f * sin(2.0f * 3.14159f * 440.0f * (produced + i) / 16000.0f);
+        }
+        produced += n;
+        largest_read = std::max(largest_read, max_samples);
+        return n;
+    };
+
+    HegemonikonWhisperGenerationParams gen_params;
+    std::string result = whisper_service.transcribe_stream(reader, gen_params);
+
+    REQUIRE(result.rfind("<whisper>", 0) == 0);
+    REQUIRE(produced == total_samples);
+    REQUIRE(largest_read <= 30 * WhisperInterface::SAMPLE_RATE);
+}
+
+TEST_CASE("WhisperStreamSession reports partial then final segments", "[integration][whisper]")
+{
+    if (!std::filesystem::exists(REAL_WHISPER_MODEL_PATH))
+    {
+        WARN("SKIPPING Whisper stream session test: Model file not found at " << REAL_WHISPER_MODEL_PATH);
+        return;
+    }
+
+    auto whisper = std::make_shared<WhisperInterface>();
+    HegemonikonWhisperModelParams params;
+    params.model = REAL_WHISPER_MODEL_PATH;
+    REQUIRE(whisper->load_model(params) == true);
+
+    HegemonikonWhisperGenerationParams gen_params;
+    gen_params.step_ms = 1000;
+    gen_params.length_ms = 4000;
+    std::vector<HegemonikonWhisperSegment> segments;
+    WhisperStreamSession session(whisper, gen_params, [&](const HegemonikonWhisperSegment &segment)
+                                 { segments.push_back(segment); });
+
+    std::vector<float> step(WhisperInterface::SAMPLE_RATE);
+    for (int s = 0; s < 8; ++s)
+    {
+        for (size_t i = 0; i < step.size(); ++i)
+        {
+            step[i] = 0.5f * sin(2.0f * 3.14159f * 440.0f * i / 16000.0f);
+        }
+        session.push(step.data(), step.size());
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    session.stop();
+
+    REQUIRE(session.error().empty());
+    const HegemonikonWhisperStreamStats stats = session.get_stats();
+    REQUIRE(stats.windows_transcribed >= 1);
+    REQUIRE(stats.samples_received == 8 * step.size());
+    for (const HegemonikonWhisperSegment &segment : segments)
+    {
+        REQUIRE(segment.t0_ms <= segment.t1_ms);
+        REQUIRE(segment.t1_ms <= 8000 + 1000);
+    }
+}
+
+TEST_CASE("WhisperInterface transcribes only the speech with VAD", "[integration][whisper]")
+{
+    if (!std::filesystem::exists(REAL_WHISPER_MODEL_PATH))
+    {
+        WARN("SKIPPING Whisper VAD test: Model file not found at " << REAL_WHISPER_MODEL_PATH);
+        return;
+    }
+
+    WhisperInterface whisper_service;
+    HegemonikonWhisperModelParams params;
+    params.model = REAL_WHISPER_MODEL_PATH;
+    REQUIRE(whisper_service.load_model(params) == true);
+
+    // 10 s of silence, 3 s of tone, 20 s of silence.
+    std::vector<float> pcm(33 * WhisperInterface::SAMPLE_RATE, 0.0f);
+    for (size_t i = 10 * WhisperInterface::SAMPLE_RATE; i < 13 * WhisperInterface::SAMPLE_RATE; ++i)
+    {
+        pcm[i] = 0.5f * sin(2.0f * 3.14159f * 440.0f * i / 16000.0f);
+    }
+
+    HegemonikonWhisperGenerationParams gen_params;
+    gen_params.vad = true;
+    std::string result = whisper_service.transcribe_pcm(pcm, gen_params);
+    REQUIRE(result.rfind("<whisper>", 0) == 0);
+
+    std::vector<HegemonikonWhisperSegment> segments;
+    REQUIRE(whisper_service.transcribe_segments(pcm.data(), pcm.size(), gen_params, {}, 0, segments));
+    for (const HegemonikonWhisperSegment &segment : segments)
+    {
+        REQUIRE(segment.t0_ms >= 9000);
+        REQUIRE(segment.t1_ms <= 14000);
+    }
+
+    std::vector<float> silence(5 * WhisperInterface::SAMPLE_RATE, 0.0f);
+    REQUIRE(whisper_service.transcribe_segments(silence.data(), silence.size(), gen_params, {}, 0, segments));
+    REQUIRE(segments.empty());
+}
+
+TEST_CASE("WhisperInterface transcribes long audio on parallel states", "[integration][whisper]")
+{
+    if (!std::filesystem::exists(REAL_WHISPER_MODEL_PATH))
+    {
+        WARN("SKIPPING Whisper parallel test: Model file not found at " << REAL_WHISPER_MODEL_PATH);
+        return;
+    }
+
+    WhisperInterface whisper_service;
+    HegemonikonWhisperModelParams params;
+    params.model = REAL_WHISPER_MODEL_PATH;
+    params.n_processors = 3;
+    REQUIRE(whisper_service.load_model(params) == true);
+
+    // 90 s of tone interrupted by a second of silence every 10 s.
+    std::vector<float> pcm(90 * WhisperInterface::SAMPLE_RATE, 0.0f);
+    for (size_t i = 0; i < pcm.size(); ++i)
+    {
+        if ((i / WhisperInterface::SAMPLE_RATE) % 10 != 9)
+        {
+            pcm[i] = 0.5f * sin(2.0f * 3.14159f * 440.0f * i / 16000.0f);
+        }
+    }
+
+    HegemonikonWhisperGenerationParams gen_params;
+    std::string parallel = whisper_service.transcribe_pcm(pcm, gen_params);
+    REQUIRE(parallel.rfind("<whisper>", 0) == 0);
+
+    size_t position = 0;
+    auto reader = [&](float *buffer, size_t max_samples)
+    {
+        const size_t n = std::min(max_samples, pcm.size() - position);
+        std::copy(pcm.begin() + position, pcm.begin() + position + n, buffer);
+        position += n;
+        return n;
+    };
+    std::string streamed = whisper_service.transcribe_stream(reader, gen_params);
+    REQUIRE(streamed.rfind("<whisper>", 0) == 0);
+    REQUIRE(position == pcm.size());
+}
+
+TEST_CASE("WhisperInterface returns segments with token timestamps", "[integration][whisper]")
+{
+    if (!std::filesystem::exists(REAL_WHISPER_MODEL_PATH))
+    {
+        WARN("SKIPPING Whisper segments test: Model file not found at " << REAL_WHISPER_MODEL_PATH);
+        return;
+    }
+
+    WhisperInterface whisper_service;
+    HegemonikonWhisperModelParams params;
+    params.model = REAL_WHISPER_MODEL_PATH;
+    REQUIRE(whisper_service.load_model(params) == true);
+
+    std::vector<float> pcm(5 * WhisperInterface::SAMPLE_RATE);
+    for (size_t i = 0; i < pcm.size(); ++i)
+    {
+        pcm[i] = 0.5f * sin(2.0f * 3.14159f * 440.0f * i / 16000.0f);
+    }
+
+    HegemonikonWhisperGenerationParams gen_params;
+    gen_params.token_timestamps = true;
+    const HegemonikonTranscription transcription = whisper_service.transcribe_pcm_segments(pcm.data(), pcm.size(), gen_params);
+    REQUIRE(transcription.ok());
+    REQUIRE(transcription.audio_ms == 5000);
+    for (const HegemonikonWhisperSegment &segment : transcription.segments)
+    {
+        REQUIRE(segment.t0_ms <= segment.t1_ms);
+        REQUIRE(segment.t1_ms <= transcription.audio_ms + 10);
+        for (const HegemonikonWhisperToken &token : segment.tokens)
+        {
+            REQUIRE(token.p >= 0.0f);
+            REQUIRE(token.p <= 1.0f);
+            REQUIRE(token.t0_ms >= 0);
+            REQUIRE(token.t0_ms <= token.t1_ms);
+        }
+    }
+
+    const std::string text = WhisperInterface::format_transcription(gen_params, transcription);
+    REQUIRE(text.rfind("<whisper>", 0) == 0);
+    REQUIRE(transcription.text().size() <= text.size());
+
+    HegemonikonWhisperGenerationParams empty_params;
+    REQUIRE_FALSE(whisper_service.transcribe_pcm_segments(nullptr, 0, empty_params).ok());
+}
+
+TEST_CASE("CoreAIService keeps a warm Whisper model resident across services", "[integration][whisper]")
+{
+    if (!std::filesystem::exists(REAL_WHISPER_MODEL_PATH))
+    {
+        WARN("SKIPPING Whisper residency test: Model file not found at " << REAL_WHISPER_MODEL_PATH);
+        return;
+    }
+
+    HegemonikonWhisperModelParams params;
+    params.model = REAL_WHISPER_MODEL_PATH;
+    params.set_n_processors(2).set_keep_resident(true);
+
+    auto timed_init = [&params](CoreAIService &service)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        REQUIRE(service.initialize_whisper_model(params));
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    double load_ms = 0.0;
+    {
+        CoreAIService first;
+        load_ms = timed_init(first);
+        HegemonikonWhisperGenerationParams beam_params;
+        beam_params.set_beam_size(5);
+        REQUIRE(first.warm_up_whisper_model(beam_params));
+        REQUIRE(timed_init(first) < load_ms);
+    }
+
+    // Toggling a load-behaviour flag still reuses the resident model.
+    params.set_warmup(false);
+    CoreAIService second;
+    const double reuse_ms = timed_init(second);
+    REQUIRE(reuse_ms < load_ms);
+    std::vector<float> silence(WhisperInterface::SAMPLE_RATE, 0.0f);
+    REQUIRE(second.transcribe_audio_pcm_segments(silence.data(), silence.size(), HegemonikonWhisperGenerationParams()).ok());
+
+    second.unload_whisper_model();
+    CoreAIService::release_resident_whisper_model();
+    REQUIRE_FALSE(second.is_whisper_model_loaded());
+}
@@ -0,0 +1,45 @@
+#include <catch2/catch_test_macros.hpp>
+#include <memory>
+#include <vector>
+#include "whisper_stream_session.hh"
+
+TEST_CASE("WhisperStreamSession ends with an error without a loaded model", "[whisper_stream][unit]")
+{
+    auto whisper = std::make_shared<WhisperInterface>();
+    HegemonikonWhisperGenerationParams params;
+    params.step_ms = 500;
+    params.length_ms = 2000;
+
+    size_t segments = 0;
+    WhisperStreamSession session(whisper, params, [&](const HegemonikonWhisperSegment &)
+                                 { ++segments; });
+    const std::vector<float> silence(WhisperInterface::SAMPLE_RATE, 0.0f);
+    session.push(silence.data(), silence.size());
+    session.stop();
+
+    REQUIRE_FALSE(session.is_running());
+    REQUIRE(session.error() == "[Error: Whisper model not loaded]");
+    REQUIRE(segments == 0);
+
+    // Audio pushed after the end is ignored.
+    session.push(silence.data(), silence.size());
+    REQUIRE(session.get_stats().samples_received == silence.size());
+}
+
+TEST_CASE("WhisperStreamSession drops the oldest audio when it falls behind", "[whisper_stream][unit]")
+{
+    auto whisper = std::make_shared<WhisperInterface>();
+    HegemonikonWhisperGenerationParams params;
+    params.step_ms = 60000;
+    params.length_ms = 60000;
+
+    WhisperStreamSession session(whisper, params, nullptr);
+    const std::vector<float> chunk(WhisperInterface::SAMPLE_RATE * 20, 0.0f);
+    session.push(chunk.data(), chunk.size());
+    session.push(chunk.data(), chunk.size());
+
+    const HegemonikonWhisperStreamStats stats = session.get_stats();
+    REQUIRE(stats.samples_received == 2 * chunk.size());
+    REQUIRE(stats.samples_dropped == 2 * chunk.size() - WhisperStreamSession::MAX_PENDING_SAMPLES);
+    session.stop();
+}
@@ -70,7 +70,9 @@ class StandardChatTask(BaseTask):
 
         # print(f"Final prompt: {final_prompt}")
 
-        model_response_text = await core_ai_service_manager.process_prompt(final_prompt)
+        model_response_text = await core_ai_service_manager.process_prompt(
+            final_prompt, session_id=str(session_id), priority="interactive"
+        )
 
         assistant_response = model_response_text.strip()
         if not assistant_response:
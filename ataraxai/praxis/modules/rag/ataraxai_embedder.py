@@ -1,31 +1,49 @@
 from sentence_transformers import (
     SentenceTransformer,
 )
-from typing import Dict, Any
+from typing import Dict, Any, Optional
 from chromadb.api.types import EmbeddingFunction, Documents, Embeddings
 
 
 class AtaraxAIEmbedder(EmbeddingFunction):
-    def __init__(self, model_name: str = "sentence-transformers/all-MiniLM-L6-v2"):
+    def __init__(
+        self,
+        model_name: str = "sentence-transformers/all-MiniLM-L6-v2",
+        core_ai_service: Optional[Any] = None,
+        normalize: bool = True,
+    ):
         """
         Initializes the AtaraxAIEmbedder with a specified SentenceTransformer model.
 
         Args:
             model_name (str, optional): The name or path of the pre-trained SentenceTransformer model to use.
                 Defaults to "sentence-transformers/all-MiniLM-L6-v2".
+            core_ai_service (CoreAIService, optional): A hegemonikon service with an embedding GGUF
+                loaded through `initialize_embedding_model`. When given, documents are embedded
+                natively in batched decodes and no SentenceTransformer is loaded.
+            normalize (bool, optional): Whether the native embeddings are L2-normalized. Defaults to True.
 
         Attributes:
-            model (SentenceTransformer): The loaded SentenceTransformer model.
+            model (SentenceTransformer): The loaded SentenceTransformer model, None on the native path.
             model_name (str): The name or path of the model used.
 
         Prints:
             Confirmation message indicating which model has been initialized.
         """
-        self.model = SentenceTransformer(model_name)
+        self.core_ai_service = core_ai_service
+        self.normalize = normalize
         self.model_name = model_name
+        if core_ai_service is not None:
+            if not core_ai_service.is_embedding_model_loaded():
+                raise ValueError("core_ai_service has no embedding model loaded")
+            self.model = None
+        else:
+            self.model = SentenceTransformer(model_name)
         print(f"AtaraxAIEmbedder: Initialized with model '{self.model_name}'.")
 
     def __call__(self, input: Documents) -> Embeddings:
+        if self.core_ai_service is not None:
+            return list(self.core_ai_service.embed(list(input), self.normalize))  # type: ignore
         return self.model.encode(list(input)).tolist() # type: ignore
 
     def name(self) -> str: # type: ignore[override]
@@ -34,5 +52,5 @@ class AtaraxAIEmbedder(EmbeddingFunction):
     def get_config(self) -> Dict[str, Any]: # type: ignore[override]
         return {
             "model_name": self.model_name,
-            "model_type": "sentence-transformers",
+            "model_type": "hegemonikon" if self.core_ai_service is not None else "sentence-transformers",
         }
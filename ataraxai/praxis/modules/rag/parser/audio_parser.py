@@ -150,9 +150,12 @@ class AudioParser(DocumentParser):
             try:
                 print(f"Transcribing chunk {i+1}/{len(chunk_paths)}")
 
-                chunk_text = self.core_ai_service.transcribe_audio_file(  # type: ignore
+                transcription = self.core_ai_service.transcribe_audio_file_segments(  # type: ignore
                     str(chunk_path), self.transcription_params  # type: ignore
                 )
+                if not transcription.ok():  # type: ignore
+                    raise RuntimeError(transcription.error)  # type: ignore
+                chunk_text = transcription.text()  # type: ignore
 
                 if chunk_text and chunk_text.strip():  # type: ignore
                     if i > 0 and transcriptions:
@@ -226,9 +229,14 @@ class AudioParser(DocumentParser):
                 print(
                     f"File {audio_path.name} is small enough for direct transcription"
                 )
-                audio_text = self.core_ai_service.transcribe_audio_file(  # type: ignore
+                transcription = self.core_ai_service.transcribe_audio_file_segments(  # type: ignore
                     str(audio_path), self.transcription_params  # type: ignore
                 )
+                if not transcription.ok():  # type: ignore
+                    raise ValueError(
+                        f"Transcription failed for {audio_path}: {transcription.error}"  # type: ignore
+                    )
+                audio_text = transcription.text()  # type: ignore
 
             if not audio_text or not audio_text.strip():  # type: ignore
                 raise ValueError(
@@ -241,6 +249,33 @@ class AudioParser(DocumentParser):
             print(f"Transcription error for {audio_path}: {e}")
             raise
 
+    def transcribe_batch(self, audio_paths: List[Path], n_decoders: int = 2) -> Dict[Path, str]:
+        """
+        Transcribes many audio files with the native batch pipeline.
+
+        Upcoming files are decoded and resampled on background threads while whisper
+        transcribes the current one, instead of decoding and transcribing one file after
+        the other. Files are streamed from disk, so large files need no chunking.
+
+        Args:
+            audio_paths (List[Path]): The audio files to transcribe.
+            n_decoders (int, optional): Number of files decoded ahead of the transcription. Defaults to 2.
+
+        Returns:
+            Dict[Path, str]: The transcription of each file that succeeded; failures are
+                printed and left out.
+        """
+        transcriptions: Dict[Path, str] = {}
+        results = self.core_ai_service.transcribe_batch(  # type: ignore
+            [str(path) for path in audio_paths], self.transcription_params, None, n_decoders  # type: ignore
+        )
+        for path, result in zip(audio_paths, results):  # type: ignore
+            if result.ok() and result.text.strip():  # type: ignore
+                transcriptions[path] = result.text.strip()  # type: ignore
+            else:
+                print(f"Warning: Transcription failed for {path}: {result.error or 'no text returned'}")  # type: ignore
+        return transcriptions
+
     def parse(self, path: Path) -> List[DocumentChunk]:
         """
         Parses an audio file to extract metadata and optionally transcribe audio to text.
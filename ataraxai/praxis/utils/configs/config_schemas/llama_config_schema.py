@@ -14,12 +14,21 @@ class LlamaModelParams(BaseModel):
         None, description="Model information including local path and metadata."
     )
     n_ctx: int = Field(default=2048, description="Context size for the model.")
-    n_gpu_layers: int = Field(default=0, description="Number of GPU layers to use.")
+    n_gpu_layers: int = Field(default=0, description="Number of GPU layers to use, -1 to plan the offload automatically.")
     main_gpu: int = Field(default=0, description="Main GPU to use.")
+    n_batch: int = Field(default=512, description="Maximum number of tokens per decode call.")
+    n_ubatch: int = Field(default=512, description="Physical batch size used by llama.cpp.")
     tensor_split: bool = Field(default=False, description="Whether to use tensor splitting.")
     vocab_only: bool = Field(default=False, description="Whether to use vocabulary only.")
-    use_map: bool = Field(default=False, description="Whether to use memory mapping.")
+    use_map: bool = Field(default=True, description="Whether to use memory mapping.")
     use_mlock: bool = Field(default=False, description="Whether to use mlock.")
+    warmup: bool = Field(default=True, description="Whether to run a warm-up decode right after loading.")
+    draft_model_path: str = Field(
+        default="", description="Path to a small draft GGUF with the same vocabulary, enables speculative decoding."
+    )
+    draft_n_gpu_layers: int = Field(default=0, description="Number of draft model layers to use on GPU.")
+    cache_type_k: str = Field(default="f16", description="Type of the K cache (f16, q8_0, q4_0, ...).")
+    cache_type_v: str = Field(default="f16", description="Type of the V cache (f16, q8_0, q4_0, ...).")
 
     @computed_field
     def model_path(self) -> str:
@@ -52,8 +61,34 @@ class GenerationParams(BaseModel):
         default_factory=lambda: ["</s>", "\n\n", "User:"],
         description="Sequences that will stop generation.",
     )
-    n_batch: int = Field(default=1, description="Batch size for generation.")
+    n_batch: int = Field(
+        default=512, description="Maximum prompt tokens prefilled per step (0 uses the context batch size)."
+    )
     n_threads: int = Field(default=4, description="Number of threads to use for generation.")
+    n_draft: int = Field(
+        default=4, description="Tokens proposed per speculative step when a draft model is loaded (0 disables)."
+    )
+    timeout_ms: int = Field(
+        default=0, description="Wall-clock budget of a request in milliseconds (0 for no limit)."
+    )
+    context_shift: bool = Field(
+        default=False, description="Discard the oldest tokens instead of stopping when the context is full."
+    )
+    n_keep: int = Field(
+        default=0, description="Number of leading tokens kept by a context shift (system prompt)."
+    )
+    prompt_lookup: bool = Field(
+        default=False, description="Draft tokens by matching the last tokens against the context (no draft model needed)."
+    )
+    n_lookup_draft: int = Field(
+        default=8, description="Maximum tokens proposed per prompt-lookup step."
+    )
+    lookup_ngram_min: int = Field(
+        default=2, description="Shortest run of tokens matched by prompt lookup."
+    )
+    lookup_ngram_max: int = Field(
+        default=4, description="Longest run of tokens matched by prompt lookup."
+    )
 
     def is_setup_complete(self) -> bool:
         return (
@@ -3,6 +3,7 @@ from ataraxai.hegemonikon_py import HegemonikonWhisperModelParams, HegemonikonWh
 
 class WhisperModelParams(BaseModel):
     n_threads: int = Field(default=0, description="Number of threads to use for processing.")
+    n_processors: int = Field(default=1, description="Number of pieces of long audio transcribed concurrently.")
     use_gpu: bool = Field(default=True, description="Whether to use GPU for processing.")
     flash_attn: bool = Field(default=True, description="Whether to use flash attention.")
     audio_ctx: int = Field(default=0, description="Audio context size.")
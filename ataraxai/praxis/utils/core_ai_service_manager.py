@@ -1,12 +1,19 @@
 import asyncio
+import codecs
 import logging
 from pathlib import Path
-from typing import Any, Dict, List, Optional
+from typing import Any, AsyncIterator, Dict, List, Optional, Sequence, Tuple, Union
+
+import numpy as np
 
 from ataraxai import hegemonikon_py  # type: ignore
 
 from ataraxai.praxis.utils.configuration_manager import ConfigurationManager
-from ataraxai.praxis.utils.exceptions import ServiceInitializationError, ValidationError
+from ataraxai.praxis.utils.exceptions import (
+    CoreAIServiceError,
+    ServiceInitializationError,
+    ValidationError,
+)
 from ataraxai.praxis.utils.service_status import ServiceStatus
 
 
@@ -55,13 +62,22 @@ class CoreAIServiceManager:
 
         return self.core_ai_service
 
-    async def process_prompt(self, prompt: str) -> str:
+    async def process_prompt(
+        self, prompt: str, session_id: Optional[str] = None, priority: Optional[str] = None
+    ) -> str:
         """
         Processes a prompt using the core AI service.
 
+        The generation is bound to a request handle: if the awaiting task is cancelled
+        (client disconnect, timeout), the native generation is stopped within one decode
+        step instead of running to n_predict in the background.
+
         Args:
             prompt (str): The prompt to process.
-            generation_params (Any): The parameters for generation.
+            session_id (Optional[str]): Chat session whose KV cache is reused across turns.
+            priority (Optional[str]): "interactive", "batch" or "background". When set, the
+                request goes through the native batching scheduler, where background work
+                is held and preempted while interactive requests are decoding.
 
         Returns:
             str: The processed response from the core AI service.
@@ -70,15 +86,85 @@ class CoreAIServiceManager:
             raise ServiceInitializationError("Core AI service is not initialized")
         
         llama_generation_params = self.config_manager.llama_config_manager.get_generation_params()
+        hegemonikon_params = llama_generation_params.to_hegemonikon() # type: ignore
+        if session_id:
+            hegemonikon_params.session_id = str(session_id)
 
-        response = await asyncio.to_thread(
-            self.core_ai_service.process_prompt,
-            prompt.encode("utf-8"),
-            llama_generation_params.to_hegemonikon() # type: ignore
-        )
+        handle = hegemonikon_py.LlamaRequestHandle()  # type: ignore
+        try:
+            if priority is None:
+                response = await asyncio.to_thread(
+                    self.core_ai_service.process_prompt,
+                    prompt.encode("utf-8"),
+                    hegemonikon_params,
+                    handle,
+                )
+            else:
+                hegemonikon_params.priority = getattr(
+                    hegemonikon_py.LlamaRequestPriority, priority.upper()  # type: ignore
+                )
+                result = await asyncio.to_thread(
+                    self.core_ai_service.process_prompt_batched,
+                    prompt.encode("utf-8"),
+                    hegemonikon_params,
+                    handle,
+                )
+                response = result.text
+        except asyncio.CancelledError:
+            handle.cancel()
+            raise
 
         return response
 
+    async def stream_prompt(
+        self, prompt: str, session_id: Optional[str] = None
+    ) -> AsyncIterator[str]:
+        """
+        Streams the completion of a prompt piece by piece as it is generated.
+
+        The native iterator releases the GIL while waiting for each token, and each
+        wait runs in a worker thread so the event loop is never blocked.
+
+        Args:
+            prompt (str): The prompt to process.
+            session_id (Optional[str]): Chat session whose KV cache is reused across turns.
+
+        Yields:
+            str: Decoded text pieces, in order.
+
+        Raises:
+            ServiceInitializationError: If the core AI service is not initialized.
+            CoreAIServiceError: If the generation fails, possibly after some pieces
+                have been yielded. The error is never yielded as text.
+        """
+        if not self.core_ai_service:
+            raise ServiceInitializationError("Core AI service is not initialized")
+
+        llama_generation_params = self.config_manager.llama_config_manager.get_generation_params()
+        hegemonikon_params = llama_generation_params.to_hegemonikon() # type: ignore
+        if session_id:
+            hegemonikon_params.session_id = str(session_id)
+
+        stream = self.core_ai_service.open_prompt_stream(
+            prompt.encode("utf-8"), hegemonikon_params
+        )
+        decoder = codecs.getincrementaldecoder("utf-8")(errors="replace")
+        try:
+            while True:
+                piece = await asyncio.to_thread(next, stream, None)
+                if piece is None:
+                    break
+                text = decoder.decode(piece)
+                if text:
+                    yield text
+            tail = decoder.decode(b"", final=True)
+            if tail:
+                yield tail
+            if not stream.succeeded():
+                raise CoreAIServiceError(stream.error() or "[Error: Generation failed]")
+        finally:
+            stream.cancel()
+
     def get_llama_cpp_model_context_size(self) -> int:
         """
         Retrieves the context size of the Llama model from the core AI service.
@@ -260,18 +346,58 @@ class CoreAIServiceManager:
         #     self.logger.error(f"Error initializing Whisper model: {e}")
         return service  # type: ignore
 
-    def tokenize(self, text: str) -> List[int]:
+    def tokenize(self, text: str) -> np.ndarray:
+        """
+        Tokenizes a text with the active Llama model.
+
+        Args:
+            text (str): The text to tokenize.
+
+        Returns:
+            np.ndarray: The int32 tokens; slices can be passed back to ``decode``.
+        """
         if not self.core_ai_service:
             raise ServiceInitializationError("Core AI service is not initialized")
 
         return self.core_ai_service.tokenization(text.encode("utf-8"))
 
-    def decode(self, tokens: List[int]) -> str:
+    def tokenize_batch(self, texts: Sequence[str]) -> Tuple[np.ndarray, np.ndarray]:
+        """
+        Tokenizes many texts in a single native call, in parallel.
+
+        Args:
+            texts (Sequence[str]): The texts to tokenize.
+
+        Returns:
+            Tuple[np.ndarray, np.ndarray]: The flat int32 token array and the int64 offsets;
+            the tokens of ``texts[i]`` are ``tokens[offsets[i]:offsets[i + 1]]``.
+        """
+        if not self.core_ai_service:
+            raise ServiceInitializationError("Core AI service is not initialized")
+
+        return self.core_ai_service.tokenize_batch(list(texts))
+
+    def count_tokens(self, texts: Sequence[str]) -> np.ndarray:
+        """
+        Counts the tokens of many texts without materializing them, e.g. for chunk sizing.
+
+        Args:
+            texts (Sequence[str]): The texts to measure.
+
+        Returns:
+            np.ndarray: The int32 token count of each text (-1 on failure).
+        """
+        if not self.core_ai_service:
+            raise ServiceInitializationError("Core AI service is not initialized")
+
+        return self.core_ai_service.count_tokens(list(texts))
+
+    def decode(self, tokens: Union[List[int], np.ndarray]) -> str:
         """
         Decodes a list of tokens into a string using the core AI service.
 
         Args:
-            tokens (List[int]): The list of tokens to decode.
+            tokens (Union[List[int], np.ndarray]): The tokens to decode.
 
         Returns:
             str: The decoded string.
@@ -9,11 +9,11 @@ class LlamaCPPConfigAPI(BaseModel):
         None, description="Model information including local path and metadata."
     )
     n_ctx: int = Field(default=2048, description="Context size for the model.")
-    n_gpu_layers: int = Field(default=0, description="Number of GPU layers to use.")
+    n_gpu_layers: int = Field(default=0, description="Number of GPU layers to use, -1 to plan the offload automatically.")
     main_gpu: int = Field(default=0, description="Main GPU to use.")
     tensor_split: bool = Field(default=False, description="Whether to use tensor splitting.")
     vocab_only: bool = Field(default=False, description="Whether to use vocabulary only.")
-    use_map: bool = Field(default=False, description="Whether to use memory mapping.")
+    use_map: bool = Field(default=True, description="Whether to use memory mapping.")
     use_mlock: bool = Field(default=False, description="Whether to use mlock.")
 
     @field_validator("model_info")
@@ -25,12 +25,19 @@ class LlamaCPPConfigAPI(BaseModel):
             raise ValueError("Model path cannot be empty.")
         return v
     
-    @field_validator("n_ctx", "n_gpu_layers", "main_gpu")
+    @field_validator("n_ctx", "main_gpu")
     @classmethod
     def validate_positive(cls, v: int) -> int:
         if v < 0:
             raise ValueError("Value must be non-negative.")
         return v
+
+    @field_validator("n_gpu_layers")
+    @classmethod
+    def validate_gpu_layers(cls, v: int) -> int:
+        if v < -1:
+            raise ValueError("Number of GPU layers must be -1 (automatic) or non-negative.")
+        return v
     
     
 class LlamaCPPConfigResponse(BaseModel):
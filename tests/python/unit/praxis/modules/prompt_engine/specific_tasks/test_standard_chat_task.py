@@ -53,7 +53,9 @@ async def test_execute_returns_assistant_response():
     )
     prompt_manager.load_template.assert_called_once_with("standard_chat")
     prompt_manager.build_prompt_within_limit.assert_awaited()
-    core_ai_service_manager.process_prompt.assert_awaited_with("Final prompt")
+    core_ai_service_manager.process_prompt.assert_awaited_with(
+        "Final prompt", session_id="session123", priority="interactive"
+    )
 
 
 @pytest.mark.asyncio
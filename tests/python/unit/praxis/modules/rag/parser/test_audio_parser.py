@@ -21,6 +21,13 @@ def parser(mock_core_ai_service, dummy_transcription_params):
         transcription_params=dummy_transcription_params,
     )
 
+def make_transcription(text, error=""):
+    transcription = mock.Mock()
+    transcription.ok.return_value = not error
+    transcription.text.return_value = text
+    transcription.error = error
+    return transcription
+
 @pytest.fixture
 def fake_mp3_path(tmp_path):
     file = tmp_path / "test.mp3"
@@ -161,7 +168,10 @@ def test_transcribe_chunks_success(parser, tmp_path):
     chunk2 = tmp_path / "chunk2.wav"
     chunk1.write_bytes(b"data")
     chunk2.write_bytes(b"data")
-    parser.core_ai_service.transcribe_audio_file.side_effect = ["hello world", "world again"]
+    parser.core_ai_service.transcribe_audio_file_segments.side_effect = [
+        make_transcription("hello world"),
+        make_transcription("world again"),
+    ]
     # Patch remove_overlap to just concatenate
     parser.remove_overlap = lambda prev, curr: curr
     result = parser.transcribe_chunks([chunk1, chunk2])
@@ -170,7 +180,7 @@ def test_transcribe_chunks_success(parser, tmp_path):
 def test_transcribe_chunks_all_fail(parser, tmp_path):
     chunk1 = tmp_path / "chunk1.wav"
     chunk1.write_bytes(b"data")
-    parser.core_ai_service.transcribe_audio_file.side_effect = Exception("fail")
+    parser.core_ai_service.transcribe_audio_file_segments.side_effect = Exception("fail")
     with pytest.raises(ValueError):
         parser.transcribe_chunks([chunk1])
 
@@ -195,12 +205,20 @@ def test_transcribe_should_use_chunking(parser, fake_mp3_path):
 
 def test_transcribe_direct(parser, fake_mp3_path):
     with mock.patch.object(parser, "should_use_chunking", return_value=False):
-        parser.core_ai_service.transcribe_audio_file.return_value = "direct text"
+        parser.core_ai_service.transcribe_audio_file_segments.return_value = make_transcription(" direct text")
         result = parser.transcribe(fake_mp3_path)
         assert result == "direct text"
 
 def test_transcribe_raises_on_empty(parser, fake_mp3_path):
     with mock.patch.object(parser, "should_use_chunking", return_value=False):
-        parser.core_ai_service.transcribe_audio_file.return_value = ""
+        parser.core_ai_service.transcribe_audio_file_segments.return_value = make_transcription("")
+        with pytest.raises(ValueError):
+            parser.transcribe(fake_mp3_path)
+
+def test_transcribe_raises_on_error(parser, fake_mp3_path):
+    with mock.patch.object(parser, "should_use_chunking", return_value=False):
+        parser.core_ai_service.transcribe_audio_file_segments.return_value = make_transcription(
+            "", "[Error: Failed to load audio file]"
+        )
         with pytest.raises(ValueError):
             parser.transcribe(fake_mp3_path)
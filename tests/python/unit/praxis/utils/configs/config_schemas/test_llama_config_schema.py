@@ -38,7 +38,7 @@ def test_generation_params_defaults():
     assert params.penalty_freq == 0.7
     assert params.penalty_present == 0.0
     assert params.stop_sequences == ["</s>", "\n\n", "User:"]
-    assert params.n_batch == 1
+    assert params.n_batch == 512
     assert params.n_threads == 4
     assert params.is_setup_complete()
 
@@ -1,7 +1,11 @@
 import pytest
 from unittest import mock
 from pathlib import Path
-from ataraxai.praxis.utils.exceptions import ServiceInitializationError, ValidationError
+from ataraxai.praxis.utils.exceptions import (
+    CoreAIServiceError,
+    ServiceInitializationError,
+    ValidationError,
+)
 from ataraxai.praxis.utils.service_status import ServiceStatus
 
 from ataraxai.praxis.utils.core_ai_service_manager import (
@@ -110,6 +114,58 @@ async def test_process_prompt_raises_if_not_initialized(manager):
     with pytest.raises(ServiceInitializationError):
         await manager.process_prompt("prompt")
 
+class FakeTokenStream:
+    def __init__(self, pieces, succeeded, error=""):
+        self._pieces = list(pieces)
+        self._succeeded = succeeded
+        self._error = error
+        self.cancelled = False
+
+    def __iter__(self):
+        return self
+
+    def __next__(self):
+        if not self._pieces:
+            raise StopIteration
+        return self._pieces.pop(0)
+
+    def succeeded(self):
+        return self._succeeded
+
+    def error(self):
+        return self._error
+
+    def cancel(self):
+        self.cancelled = True
+
+@pytest.mark.asyncio
+async def test_stream_prompt_yields_pieces(manager):
+    stream = FakeTokenStream([b"Hel", b"lo \xc3", b"\xa9"], succeeded=True)
+    manager.core_ai_service = mock.MagicMock()
+    manager.core_ai_service.open_prompt_stream.return_value = stream
+    pieces = [piece async for piece in manager.stream_prompt("prompt", session_id="chat")]
+    assert "".join(pieces) == "Hello \u00e9"
+    assert stream.cancelled
+
+@pytest.mark.asyncio
+async def test_stream_prompt_raises_on_failure_without_yielding_the_error(manager):
+    stream = FakeTokenStream([b"partial"], succeeded=False, error="[Error: Failed to decode]")
+    manager.core_ai_service = mock.MagicMock()
+    manager.core_ai_service.open_prompt_stream.return_value = stream
+    pieces = []
+    with pytest.raises(CoreAIServiceError, match="Failed to decode"):
+        async for piece in manager.stream_prompt("prompt"):
+            pieces.append(piece)
+    assert pieces == ["partial"]
+    assert stream.cancelled
+
+@pytest.mark.asyncio
+async def test_stream_prompt_raises_if_not_initialized(manager):
+    manager.core_ai_service = None
+    with pytest.raises(ServiceInitializationError):
+        async for _ in manager.stream_prompt("prompt"):
+            pass
+
 def test_get_llama_cpp_model_context_size(manager):
     manager.core_ai_service = mock.Mock()
     manager.config_manager.llama_config_manager.get_llama_cpp_params.return_value.n_ctx = 4096